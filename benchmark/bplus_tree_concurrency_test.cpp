@@ -40,6 +40,10 @@ struct Stat
   int64_t scan_open_failed_count = 0;
   int64_t mismatch_count         = 0;
   int64_t scan_other_count       = 0;
+
+  int64_t get_success_count   = 0;
+  int64_t get_not_exist_count = 0;
+  int64_t get_other_count     = 0;
 };
 
 class BenchmarkBase : public Fixture
@@ -150,6 +154,21 @@ public:
     }
   }
 
+  void Get(uint32_t value, Stat &stat)
+  {
+    const char *key = reinterpret_cast<const char *>(&value);
+    list<RID>   rids;
+
+    RC rc = handler_.get_entry(key, sizeof(value), rids);
+    if (rc != RC::SUCCESS) {
+      stat.get_other_count++;
+    } else if (rids.empty()) {
+      stat.get_not_exist_count++;
+    } else {
+      stat.get_success_count++;
+    }
+  }
+
   void Scan(uint32_t begin, uint32_t end, Stat &stat)
   {
     const char *begin_key = reinterpret_cast<const char *>(&begin);
@@ -208,7 +227,7 @@ BENCHMARK_DEFINE_F(InsertionBenchmark, Insertion)(State &state)
   state.counters["other"]     = Counter(stat.insert_other_count, Counter::kIsRate);
 }
 
-BENCHMARK_REGISTER_F(InsertionBenchmark, Insertion)->Threads(10);
+BENCHMARK_REGISTER_F(InsertionBenchmark, Insertion)->Threads(64);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -247,7 +266,7 @@ BENCHMARK_DEFINE_F(DeletionBenchmark, Deletion)(State &state)
   state.counters["other"]     = Counter(stat.delete_other_count, Counter::kIsRate);
 }
 
-BENCHMARK_REGISTER_F(DeletionBenchmark, Deletion)->Threads(10)->Arg(4 * 10000);
+BENCHMARK_REGISTER_F(DeletionBenchmark, Deletion)->Threads(64)->Arg(4 * 10000);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -290,7 +309,7 @@ BENCHMARK_DEFINE_F(ScanBenchmark, Scan)(State &state)
   state.counters["other"]                 = Counter(stat.scan_other_count, Counter::kIsRate);
 }
 
-BENCHMARK_REGISTER_F(ScanBenchmark, Scan)->Threads(10)->Arg(4 * 10000);
+BENCHMARK_REGISTER_F(ScanBenchmark, Scan)->Threads(64)->Arg(4 * 10000);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -344,7 +363,154 @@ BENCHMARK_DEFINE_F(MixtureBenchmark, Mixture)(State &state)
       {"scan_open_failed", Counter(stat.scan_open_failed_count, Counter::kIsRate)}});
 }
 
-BENCHMARK_REGISTER_F(MixtureBenchmark, Mixture)->Threads(10)->Arg(4 * 10000);
+BENCHMARK_REGISTER_F(MixtureBenchmark, Mixture)->Threads(64)->Arg(4 * 10000);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief 读多写少的场景，95%的点查询，5%的插入和删除
+ * @details 点查询不加锁(乐观读)，只有与写操作修改同一个页面时才需要重试
+ */
+class ReadMostlyBenchmark : public BenchmarkBase
+{
+public:
+  string Name() const override { return "read_mostly"; }
+
+  void SetUp(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    BenchmarkBase::SetUp(state);
+
+    uint32_t max = GetRangeMax(state);
+    ASSERT(max > 0, "invalid argument count. %ld", state.range(0));
+    FillUp(0, max);
+  }
+};
+
+BENCHMARK_DEFINE_F(ReadMostlyBenchmark, ReadMostly)(State &state)
+{
+  IntegerGenerator data_generator(0, GetRangeMax(state));
+  IntegerGenerator operation_generator(0, 99);
+
+  Stat stat;
+
+  for (auto _ : state) {
+    uint32_t value          = static_cast<uint32_t>(data_generator.next());
+    int64_t  operation_type = operation_generator.next();
+    if (operation_type < 95) {
+      Get(value, stat);
+    } else if (operation_type % 2 == 0) {
+      Insert(value, stat);
+    } else {
+      Delete(value, stat);
+    }
+  }
+
+  state.counters.insert({{"get_success", Counter(stat.get_success_count, Counter::kIsRate)},
+      {"get_not_exist", Counter(stat.get_not_exist_count, Counter::kIsRate)},
+      {"get_other", Counter(stat.get_other_count, Counter::kIsRate)},
+      {"insert_success", Counter(stat.insert_success_count, Counter::kIsRate)},
+      {"insert_duplicate", Counter(stat.duplicate_count, Counter::kIsRate)},
+      {"insert_other", Counter(stat.insert_other_count, Counter::kIsRate)},
+      {"delete_success", Counter(stat.delete_success_count, Counter::kIsRate)},
+      {"delete_not_exist", Counter(stat.not_exist_count, Counter::kIsRate)},
+      {"delete_other", Counter(stat.delete_other_count, Counter::kIsRate)}});
+}
+
+BENCHMARK_REGISTER_F(ReadMostlyBenchmark, ReadMostly)->Threads(64)->Arg(4 * 10000);
+
+////////////////////////////////////////////////////////////////////////////////
+
+/**
+ * @brief 长字符串键值的点查询
+ * @details 键值有很长的公共前缀(比如带前缀的账号、URL)。内部节点做了前缀压缩和后缀截断，
+ * 每个节点可以放更多的子节点，树的高度更低。结果中的 height 是树的高度。
+ */
+class LongKeyLookupBenchmark : public Fixture
+{
+public:
+  static constexpr int ATTR_LENGTH = 128;
+
+  void SetUp(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    bpm_.init(make_unique<VacuousDoubleWriteBuffer>());
+
+    LoggerFactory::init_default("long_key_lookup.log", LOG_LEVEL_INFO);
+    ::remove("long_key_lookup.btree");
+
+    // 使用默认的节点大小，内部节点按照空间判断是否已满
+    RC rc = handler_.create(log_handler_, bpm_, "long_key_lookup.btree", AttrType::CHARS, ATTR_LENGTH);
+    if (rc != RC::SUCCESS) {
+      throw runtime_error("failed to create btree handler");
+    }
+
+    char key[ATTR_LENGTH];
+    for (uint32_t value = 0; value < static_cast<uint32_t>(state.range(0)); value++) {
+      MakeKey(value, key);
+      RID rid(value, value);
+
+      rc = handler_.insert_entry(key, &rid);
+      ASSERT(rc == RC::SUCCESS, "failed to insert entry into btree. key=%" PRIu32, value);
+    }
+  }
+
+  void TearDown(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    handler_.close();
+  }
+
+  static void MakeKey(uint32_t value, char *key)
+  {
+    memset(key, 0, ATTR_LENGTH);
+    snprintf(key, ATTR_LENGTH, "https://www.example.com/user/profile/%060d/%010" PRIu32, 0, value);
+  }
+
+protected:
+  BufferPoolManager bpm_{512};
+  BplusTreeHandler  handler_;
+  VacuousLogHandler log_handler_;
+};
+
+BENCHMARK_DEFINE_F(LongKeyLookupBenchmark, Lookup)(State &state)
+{
+  IntegerGenerator generator(0, state.range(0) - 1);
+  Stat             stat;
+
+  char key[ATTR_LENGTH];
+  for (auto _ : state) {
+    MakeKey(static_cast<uint32_t>(generator.next()), key);
+
+    list<RID> rids;
+    RC        rc = handler_.get_entry(key, static_cast<int>(strlen(key)), rids);
+    if (rc != RC::SUCCESS) {
+      stat.get_other_count++;
+    } else if (rids.empty()) {
+      stat.get_not_exist_count++;
+    } else {
+      stat.get_success_count++;
+    }
+  }
+
+  int height = 0;
+  handler_.tree_height(height);
+  state.counters.insert({{"get_success", Counter(stat.get_success_count, Counter::kIsRate)},
+      {"get_not_exist", Counter(stat.get_not_exist_count, Counter::kIsRate)},
+      {"get_other", Counter(stat.get_other_count, Counter::kIsRate)},
+      {"height", Counter(height, Counter::kAvgThreads)}});
+}
+
+BENCHMARK_REGISTER_F(LongKeyLookupBenchmark, Lookup)->Threads(8)->Arg(20 * 10000);
 
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -0,0 +1,125 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+
+#include "common/lang/filesystem.h"
+#include "common/lang/stdexcept.h"
+#include "common/log/log.h"
+#include "common/math/crc.h"
+#include "storage/buffer/disk_buffer_pool.h"
+#include "storage/buffer/double_write_buffer.h"
+#include "storage/clog/vacuous_log_handler.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 测试刷新页面的吞吐量
+ * @details 参数为0时使用 VacuousDoubleWriteBuffer，直接写页面的原始位置；
+ * 参数为1时使用 DiskDoubleWriteBuffer，由后台线程写回页面；
+ * 参数为2时使用只有16个槽位的 DiskDoubleWriteBuffer，并且每加入16个页面就在当前线程中写回并 fsync，
+ * 与改成环形缓冲区之前的行为相同，作为对比。
+ */
+class DoubleWriteBufferBenchmark : public Fixture
+{
+public:
+  static constexpr int PAGE_NUM = 1024;
+
+  /// 参数为2时，每加入这么多页面就同步写回一次
+  static constexpr int SYNC_FLUSH_PAGES = 16;
+
+  void SetUp(const State &state) override
+  {
+    LoggerFactory::init_default("double_write_buffer_performance_test.log", LOG_LEVEL_INFO);
+
+    directory_ = "double_write_buffer_benchmark";
+    filesystem::remove_all(directory_);
+    filesystem::create_directories(directory_);
+
+    bpm_ = make_unique<BufferPoolManager>();
+    if (state.range(0) == 0) {
+      bpm_->init(make_unique<VacuousDoubleWriteBuffer>());
+    } else {
+      sync_flush_ = (state.range(0) == 2);
+      auto dblwr  = sync_flush_ ? make_unique<DiskDoubleWriteBuffer>(*bpm_, SYNC_FLUSH_PAGES)
+                                : make_unique<DiskDoubleWriteBuffer>(*bpm_);
+      if (OB_FAIL(dblwr->open_file((directory_ / "dblwr.db").c_str()))) {
+        throw runtime_error("failed to open double write buffer file");
+      }
+      bpm_->init(std::move(dblwr));
+    }
+
+    filesystem::path bp_file = directory_ / "buffer_pool.bp";
+    if (OB_FAIL(bpm_->create_file(bp_file.c_str())) ||
+        OB_FAIL(bpm_->open_file(log_handler_, bp_file.c_str(), buffer_pool_))) {
+      throw runtime_error("failed to open buffer pool file");
+    }
+
+    for (int i = 0; i < PAGE_NUM; i++) {
+      Frame *frame = nullptr;
+      if (OB_FAIL(buffer_pool_->allocate_page(&frame))) {
+        throw runtime_error("failed to allocate page");
+      }
+      page_nums_.push_back(frame->page_num());
+      buffer_pool_->unpin_page(frame);
+    }
+    buffer_pool_->purge_all_pages();
+
+    memset(&page_, 0, sizeof(page_));
+  }
+
+  void TearDown(const State &state) override
+  {
+    buffer_pool_->close_file();
+    bpm_.reset();
+    page_nums_.clear();
+    filesystem::remove_all(directory_);
+  }
+
+protected:
+  filesystem::path              directory_;
+  VacuousLogHandler             log_handler_;
+  unique_ptr<BufferPoolManager> bpm_;
+  DiskBufferPool               *buffer_pool_ = nullptr;
+  vector<PageNum>               page_nums_;
+  Page                          page_;
+  bool                          sync_flush_ = false;
+};
+
+BENCHMARK_DEFINE_F(DoubleWriteBufferBenchmark, FlushPage)(State &state)
+{
+  DoubleWriteBuffer *dblwr = bpm_->get_dblwr_buffer();
+
+  int64_t count = 0;
+  for (auto _ : state) {
+    memcpy(page_.data, &count, sizeof(count));
+    page_.check_sum = crc32(page_.data, BP_PAGE_DATA_SIZE);
+    if (OB_FAIL(dblwr->add_page(buffer_pool_, page_nums_[count % PAGE_NUM], page_))) {
+      state.SkipWithError("failed to add page");
+      break;
+    }
+    count++;
+
+    if (sync_flush_ && count % SYNC_FLUSH_PAGES == 0 &&
+        OB_FAIL(static_cast<DiskDoubleWriteBuffer *>(dblwr)->flush_page())) {
+      state.SkipWithError("failed to flush pages");
+      break;
+    }
+  }
+
+  state.SetItemsProcessed(count);
+  state.SetBytesProcessed(count * BP_PAGE_SIZE);
+}
+
+BENCHMARK_REGISTER_F(DoubleWriteBufferBenchmark, FlushPage)->Arg(0)->Arg(1)->Arg(2);
+
+BENCHMARK_MAIN();
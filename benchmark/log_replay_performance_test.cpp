@@ -0,0 +1,204 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+
+#include "common/lang/filesystem.h"
+#include "common/lang/stdexcept.h"
+#include "common/log/log.h"
+#include "storage/buffer/disk_buffer_pool.h"
+#include "storage/buffer/double_write_buffer.h"
+#include "storage/clog/disk_log_handler.h"
+#include "storage/clog/integrated_log_replayer.h"
+#include "storage/record/record_manager.h"
+#include "storage/trx/vacuous_trx.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 测试恢复时回放日志的耗时
+ * @details 先在多个文件中插入记录，保留插入之前的文件和所有日志，每次迭代都从插入之前的文件开始回放全部日志。
+ * 参数是并行回放的线程数，0 表示在当前线程中回放。
+ * 只统计回放日志的时间，不包括复制文件和回放之后刷新脏页的时间。
+ */
+class LogReplayBenchmark : public Fixture
+{
+public:
+  static constexpr int FILE_NUM            = 8;
+  static constexpr int RECORD_NUM_PER_FILE = 20000;
+  static constexpr int RECORD_SIZE         = 100;
+
+  static const filesystem::path directory_;
+
+  void SetUp(const State &state) override
+  {
+    LoggerFactory::init_default("log_replay_performance_test.log", LOG_LEVEL_INFO);
+
+    if (!prepared_) {
+      prepare();
+      prepared_ = true;
+    }
+  }
+
+  void replay(State &state)
+  {
+    state.PauseTiming();
+    filesystem::path run_directory = directory_ / "run";
+    filesystem::remove_all(run_directory);
+    filesystem::copy(directory_ / "init", run_directory);
+
+    BufferPoolManager bpm;
+    DiskLogHandler    log_handler;
+    if (OB_FAIL(bpm.init(make_unique<VacuousDoubleWriteBuffer>()))) {
+      throw runtime_error("failed to init buffer pool manager");
+    }
+    for (int i = 0; i < FILE_NUM; i++) {
+      DiskBufferPool *buffer_pool = nullptr;
+      if (OB_FAIL(bpm.open_file(log_handler, file_path(run_directory, i).c_str(), buffer_pool))) {
+        throw runtime_error("failed to open buffer pool file");
+      }
+    }
+    if (OB_FAIL(log_handler.init((directory_ / "clog").c_str()))) {
+      throw runtime_error("failed to init log handler");
+    }
+
+    state.ResumeTiming();
+    bool success = true;
+    {
+      IntegratedLogReplayer replayer(bpm, make_unique<VacuousTrxLogReplayer>(), static_cast<int>(state.range(0)));
+      success = OB_SUCC(log_handler.replay(replayer, 0)) && OB_SUCC(replayer.on_done());
+    }
+    if (success) {
+      state.PauseTiming();
+    } else {
+      state.SkipWithError("failed to replay log");
+    }
+
+    log_handler.start();
+    log_handler.stop();
+    log_handler.await_termination();
+    for (int i = 0; i < FILE_NUM; i++) {
+      bpm.close_file(file_path(run_directory, i).c_str());
+    }
+
+    if (success) {
+      state.ResumeTiming();
+    }
+  }
+
+  static int64_t log_bytes() { return log_bytes_; }
+
+private:
+  static filesystem::path file_path(const filesystem::path &directory, int index)
+  {
+    return directory / ("table_" + to_string(index) + ".bp");
+  }
+
+  /**
+   * @brief 生成数据文件和日志
+   * @details init 目录中是插入记录之前的文件，日志在 clog 目录中
+   */
+  void prepare()
+  {
+    filesystem::remove_all(directory_);
+    filesystem::create_directories(directory_ / "init");
+    filesystem::create_directories(directory_ / "data");
+
+    BufferPoolManager bpm;
+    DiskLogHandler    log_handler;
+    if (OB_FAIL(bpm.init(make_unique<VacuousDoubleWriteBuffer>())) ||
+        OB_FAIL(log_handler.init((directory_ / "clog").c_str()))) {
+      throw runtime_error("failed to init buffer pool manager or log handler");
+    }
+
+    IntegratedLogReplayer replayer(bpm);
+    if (OB_FAIL(log_handler.replay(replayer, 0)) || OB_FAIL(log_handler.start())) {
+      throw runtime_error("failed to start log handler");
+    }
+
+    vector<unique_ptr<RecordFileHandler>> record_file_handlers;
+    for (int i = 0; i < FILE_NUM; i++) {
+      filesystem::path data_file = file_path(directory_ / "data", i);
+      DiskBufferPool  *buffer_pool = nullptr;
+      if (OB_FAIL(bpm.create_file(data_file.c_str()))) {
+        throw runtime_error("failed to create buffer pool file");
+      }
+      filesystem::copy_file(data_file, file_path(directory_ / "init", i));
+
+      auto record_file_handler = make_unique<RecordFileHandler>(StorageFormat::ROW_FORMAT);
+      if (OB_FAIL(bpm.open_file(log_handler, data_file.c_str(), buffer_pool)) ||
+          OB_FAIL(record_file_handler->init(*buffer_pool, log_handler, nullptr, nullptr))) {
+        throw runtime_error("failed to open record file");
+      }
+      record_file_handlers.push_back(std::move(record_file_handler));
+    }
+
+    // 交替插入各个文件，日志中相邻的条目属于不同的文件
+    char record[RECORD_SIZE] = "log replay benchmark";
+    for (int i = 0; i < RECORD_NUM_PER_FILE; i++) {
+      for (auto &record_file_handler : record_file_handlers) {
+        RID rid;
+        if (OB_FAIL(record_file_handler->insert_record(record, RECORD_SIZE, &rid))) {
+          throw runtime_error("failed to insert record");
+        }
+      }
+    }
+
+    log_handler.stop();
+    log_handler.await_termination();
+    record_file_handlers.clear();
+    for (int i = 0; i < FILE_NUM; i++) {
+      bpm.close_file(file_path(directory_ / "data", i).c_str());
+    }
+
+    log_bytes_ = 0;
+    for (const auto &entry : filesystem::directory_iterator(directory_ / "clog")) {
+      log_bytes_ += static_cast<int64_t>(entry.file_size());
+    }
+  }
+
+private:
+  static bool    prepared_;
+  static int64_t log_bytes_;
+};
+
+const filesystem::path LogReplayBenchmark::directory_ = "log_replay_benchmark";
+bool                   LogReplayBenchmark::prepared_  = false;
+int64_t                LogReplayBenchmark::log_bytes_ = 0;
+
+BENCHMARK_DEFINE_F(LogReplayBenchmark, Replay)(State &state)
+{
+  for (auto _ : state) {
+    replay(state);
+  }
+
+  state.SetBytesProcessed(state.iterations() * log_bytes());
+}
+
+BENCHMARK_REGISTER_F(LogReplayBenchmark, Replay)
+    ->ArgName("threads")
+    ->Arg(0)
+    ->Arg(1)
+    ->Arg(2)
+    ->Arg(4)
+    ->Arg(8)
+    ->Unit(kMillisecond)
+    ->UseRealTime();
+
+int main(int argc, char **argv)
+{
+  Initialize(&argc, argv);
+  RunSpecifiedBenchmarks();
+  Shutdown();
+  filesystem::remove_all(LogReplayBenchmark::directory_);
+  return 0;
+}
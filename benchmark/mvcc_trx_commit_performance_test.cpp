@@ -0,0 +1,125 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <benchmark/benchmark.h>
+
+#include "common/lang/algorithm.h"
+#include "common/lang/chrono.h"
+#include "common/lang/filesystem.h"
+#include "common/lang/stdexcept.h"
+#include "common/lang/vector.h"
+#include "common/log/log.h"
+#include "storage/clog/disk_log_handler.h"
+#include "storage/trx/mvcc_trx.h"
+
+using namespace std;
+using namespace common;
+using namespace benchmark;
+
+/**
+ * @brief 测试多个会话同时提交事务时 MvccTrx::commit 的延迟，以及平均每次 sync 日志文件提交了多少个事务
+ * @details 参数0是 group_commit_delay_us，参数1表示是否开启 pipelined_sync。
+ * 事务中没有修改数据，提交时只写一条 COMMIT 日志并等待它刷盘。
+ */
+class MvccTrxCommitBenchmark : public Fixture
+{
+public:
+  void SetUp(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    LoggerFactory::init_default("mvcc_trx_commit_performance_test.log", LOG_LEVEL_INFO);
+
+    directory_ = "mvcc_trx_commit_benchmark";
+    filesystem::remove_all(directory_);
+
+    DiskLogHandlerOptions options;
+    options.group_commit_delay_us = static_cast<int>(state.range(0));
+    options.group_commit_size     = state.threads();
+    options.pipelined_sync        = state.range(1) != 0;
+
+    log_handler_ = make_unique<DiskLogHandler>();
+    if (OB_FAIL(log_handler_->init(directory_.c_str(), options)) || OB_FAIL(trx_kit_.init()) ||
+        OB_FAIL(log_handler_->start())) {
+      throw runtime_error("failed to start log handler");
+    }
+  }
+
+  void TearDown(const State &state) override
+  {
+    if (0 != state.thread_index()) {
+      return;
+    }
+
+    log_handler_->stop();
+    log_handler_->await_termination();
+    log_handler_.reset();
+    filesystem::remove_all(directory_);
+  }
+
+protected:
+  filesystem::path           directory_;
+  unique_ptr<DiskLogHandler> log_handler_;
+  MvccTrxKit                 trx_kit_;
+};
+
+BENCHMARK_DEFINE_F(MvccTrxCommitBenchmark, Commit)(State &state)
+{
+  // 只有0号线程执行 SetUp，开始循环时所有线程才同步，所以事务在循环中创建
+  Trx *trx = nullptr;
+
+  vector<int64_t> latencies;
+  for (auto _ : state) {
+    if (trx == nullptr) {
+      trx = trx_kit_.create_trx(*log_handler_);
+    }
+    trx->start_if_need();
+
+    auto begin = chrono::steady_clock::now();
+    if (OB_FAIL(trx->commit())) {
+      state.SkipWithError("failed to commit");
+      break;
+    }
+    latencies.push_back(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - begin).count());
+  }
+
+  if (trx != nullptr) {
+    trx_kit_.destroy_trx(trx);
+  }
+
+  int64_t total_latency = 0;
+  for (int64_t latency : latencies) {
+    total_latency += latency;
+  }
+  sort(latencies.begin(), latencies.end());
+  const double avg_latency = latencies.empty() ? 0 : static_cast<double>(total_latency) / latencies.size();
+  const double p99_latency = latencies.empty() ? 0 : latencies[latencies.size() * 99 / 100];
+
+  // 每个线程提交的事务数除以 sync 的次数，所有线程加起来就是平均每次 sync 提交的事务数
+  const int64_t sync_count = max<int64_t>(log_handler_->sync_count(), 1);
+
+  state.counters["commits"]          = Counter(latencies.size(), Counter::kIsRate);
+  state.counters["avg_latency_us"]   = Counter(avg_latency, Counter::kAvgThreads);
+  state.counters["p99_latency_us"]   = Counter(p99_latency, Counter::kAvgThreads);
+  state.counters["commits_per_sync"] = Counter(static_cast<double>(latencies.size()) / sync_count);
+}
+
+BENCHMARK_REGISTER_F(MvccTrxCommitBenchmark, Commit)
+    ->Threads(64)
+    ->ArgNames({"delay_us", "pipelined"})
+    ->Args({0, 0})
+    ->Args({0, 1})
+    ->Args({200, 1})
+    ->Args({1000, 1})
+    ->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,730 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "common/io/async_io.h"
+#include "common/io/io.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/deque.h"
+#include "common/lang/thread.h"
+#include "common/log/log.h"
+#include "common/thread/thread_util.h"
+
+namespace common {
+
+bool async_io_type_from_name(const string &name, AsyncIOType &type)
+{
+  string lower_name = name;
+  str_to_lower(lower_name);
+  if (lower_name == "thread_pool") {
+    type = AsyncIOType::THREAD_POOL;
+  } else if (lower_name == "io_uring") {
+    type = AsyncIOType::IO_URING;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AsyncIOBatch
+
+size_t AsyncIOBatch::Request::total_size() const
+{
+  size_t size = 0;
+  for (int i = 0; i < iov_count(); i++) {
+    size += iov_array()[i].iov_len;
+  }
+  return size;
+}
+
+AsyncIOBatch::~AsyncIOBatch()
+{
+  // 请求中引用了当前对象，不能在完成之前销毁
+  (void)wait();
+}
+
+void AsyncIOBatch::add_read(int fd, void *buf, size_t size, int64_t offset)
+{
+  Request &request = requests_.emplace_back();
+  request.op       = Op::READ;
+  request.fd       = fd;
+  request.iov      = {buf, size};
+  request.offset   = offset;
+}
+
+void AsyncIOBatch::add_readv(int fd, const iovec *iovs, int iovcnt, int64_t offset)
+{
+  Request &request = requests_.emplace_back();
+  request.op       = Op::READ;
+  request.fd       = fd;
+  request.iovs     = iovs;
+  request.iovcnt   = iovcnt;
+  request.offset   = offset;
+}
+
+void AsyncIOBatch::add_write(int fd, const void *buf, size_t size, int64_t offset)
+{
+  Request &request = requests_.emplace_back();
+  request.op       = Op::WRITE;
+  request.fd       = fd;
+  request.iov      = {const_cast<void *>(buf), size};
+  request.offset   = offset;
+}
+
+void AsyncIOBatch::add_writev(int fd, const iovec *iovs, int iovcnt, int64_t offset)
+{
+  Request &request = requests_.emplace_back();
+  request.op       = Op::WRITE;
+  request.fd       = fd;
+  request.iovs     = iovs;
+  request.iovcnt   = iovcnt;
+  request.offset   = offset;
+}
+
+void AsyncIOBatch::add_fsync(int fd, bool data_only /* = true */)
+{
+  Request &request = requests_.emplace_back();
+  request.op       = data_only ? Op::FDATASYNC : Op::FSYNC;
+  request.fd       = fd;
+}
+
+int AsyncIOBatch::wait()
+{
+  unique_lock<mutex> guard(mutex_);
+  cv_.wait(guard, [this]() { return !running_; });
+  return result_;
+}
+
+void AsyncIOBatch::clear()
+{
+  requests_.clear();
+  result_ = 0;
+}
+
+size_t AsyncIOBatch::stage_end(size_t index) const
+{
+  if (index >= requests_.size()) {
+    return requests_.size();
+  }
+
+  const bool sync = requests_[index].is_sync();
+  size_t     end  = index + 1;
+  while (end < requests_.size() && requests_[end].is_sync() == sync) {
+    end++;
+  }
+  return end;
+}
+
+int AsyncIOBatch::execute_sync(const Request &request, size_t done_size /* = 0 */)
+{
+  switch (request.op) {
+    case Op::FSYNC: return ::fsync(request.fd) == 0 ? 0 : errno;
+    case Op::FDATASYNC: return ::fdatasync(request.fd) == 0 ? 0 : errno;
+    default: break;
+  }
+
+  // preadvn/pwritevn 会修改 iovec，并且需要跳过已经完成的部分
+  vector<iovec> iovs;
+  iovs.reserve(request.iov_count());
+  size_t skip_size = done_size;
+  for (int i = 0; i < request.iov_count(); i++) {
+    iovec iov = request.iov_array()[i];
+    if (skip_size >= iov.iov_len) {
+      skip_size -= iov.iov_len;
+      continue;
+    }
+    iov.iov_base = static_cast<char *>(iov.iov_base) + skip_size;
+    iov.iov_len -= skip_size;
+    skip_size = 0;
+    iovs.push_back(iov);
+  }
+
+  if (iovs.empty()) {
+    return 0;
+  }
+
+  const int64_t offset = request.offset + static_cast<int64_t>(done_size);
+  if (request.op == Op::READ) {
+    return preadvn(request.fd, iovs.data(), static_cast<int>(iovs.size()), offset);
+  }
+  return pwritevn(request.fd, iovs.data(), static_cast<int>(iovs.size()), offset);
+}
+
+void AsyncIOBatch::start()
+{
+  lock_guard<mutex> guard(mutex_);
+  for (Request &request : requests_) {
+    request.result = 0;
+    request.batch  = this;
+  }
+  running_       = !requests_.empty();
+  submitted_end_ = 0;
+  pending_       = 0;
+  result_        = 0;
+}
+
+pair<size_t, size_t> AsyncIOBatch::next_stage()
+{
+  lock_guard<mutex> guard(mutex_);
+  const size_t begin = submitted_end_;
+  submitted_end_     = stage_end(begin);
+  pending_ += submitted_end_ - begin;
+  return {begin, submitted_end_};
+}
+
+bool AsyncIOBatch::complete(Request &request, int result)
+{
+  lock_guard<mutex> guard(mutex_);
+  request.result = result;
+  if (result != 0 && result_ == 0) {
+    result_ = result;
+  }
+
+  if (--pending_ > 0) {
+    return false;
+  }
+
+  if (submitted_end_ < requests_.size() && result_ == 0) {
+    return true;
+  }
+
+  // 要在锁内通知，wait 返回后当前对象可能马上就被销毁了
+  running_ = false;
+  cv_.notify_all();
+  return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// AsyncIOEngine
+
+void AsyncIOEngine::submit(AsyncIOBatch &batch)
+{
+  batch.start();
+  if (!batch.empty()) {
+    submit_next_stage(batch);
+  }
+}
+
+int AsyncIOEngine::execute(AsyncIOBatch &batch)
+{
+  submit(batch);
+  return batch.wait();
+}
+
+int AsyncIOEngine::read(int fd, void *buf, size_t size, int64_t offset)
+{
+  AsyncIOBatch batch;
+  batch.add_read(fd, buf, size, offset);
+  return execute(batch);
+}
+
+int AsyncIOEngine::write(int fd, const void *buf, size_t size, int64_t offset)
+{
+  AsyncIOBatch batch;
+  batch.add_write(fd, buf, size, offset);
+  return execute(batch);
+}
+
+void AsyncIOEngine::on_complete(AsyncIOBatch::Request &request, int result)
+{
+  AsyncIOBatch &batch = *request.batch;
+  if (batch.complete(request, result)) {
+    submit_next_stage(batch);
+  }
+}
+
+void AsyncIOEngine::submit_next_stage(AsyncIOBatch &batch)
+{
+  auto [begin, end] = batch.next_stage();
+  submit_requests(batch, begin, end);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// ThreadPoolAsyncIO
+
+/**
+ * @brief 使用线程池实现的异步IO
+ * @details 每个线程从队列中取出一个请求，同步执行。
+ * 没有使用 ThreadPoolExecutor，因为它的线程在队列为空时会睡眠一段时间，IO请求的延迟太大
+ */
+class ThreadPoolAsyncIO final : public AsyncIOEngine
+{
+public:
+  explicit ThreadPoolAsyncIO(int thread_num)
+  {
+    running_ = true;
+    for (int i = 0; i < max(thread_num, 1); i++) {
+      threads_.emplace_back(&ThreadPoolAsyncIO::thread_func, this);
+    }
+    LOG_INFO("async io with thread pool started. threads=%d", static_cast<int>(threads_.size()));
+  }
+
+  ~ThreadPoolAsyncIO() override
+  {
+    {
+      lock_guard<mutex> guard(mutex_);
+      running_ = false;
+      cv_.notify_all();
+    }
+    for (thread &t : threads_) {
+      t.join();
+    }
+  }
+
+  AsyncIOType type() const override { return AsyncIOType::THREAD_POOL; }
+  const char *name() const override { return "thread_pool"; }
+
+  int execute(AsyncIOBatch &batch) override
+  {
+    // 调用者反正要等待，只有一个请求时就不交给其它线程了
+    if (batch.size() == 1) {
+      AsyncIOBatch::Request &request = batch.request(0);
+      request.result                 = AsyncIOBatch::execute_sync(request);
+      return request.result;
+    }
+    return AsyncIOEngine::execute(batch);
+  }
+
+protected:
+  void submit_requests(AsyncIOBatch &batch, size_t begin, size_t end) override
+  {
+    lock_guard<mutex> guard(mutex_);
+    for (size_t i = begin; i < end; i++) {
+      requests_.push_back(&batch.request(i));
+    }
+    if (end - begin > 1) {
+      cv_.notify_all();
+    } else {
+      cv_.notify_one();
+    }
+  }
+
+private:
+  void thread_func()
+  {
+    thread_set_name("AsyncIO");
+
+    unique_lock<mutex> guard(mutex_);
+    while (true) {
+      cv_.wait(guard, [this]() { return !running_ || !requests_.empty(); });
+      if (requests_.empty()) {
+        break;
+      }
+
+      AsyncIOBatch::Request *request = requests_.front();
+      requests_.pop_front();
+      guard.unlock();
+
+      on_complete(*request, AsyncIOBatch::execute_sync(*request));
+
+      guard.lock();
+    }
+  }
+
+private:
+  vector<thread>                  threads_;
+  mutex                           mutex_;
+  condition_variable              cv_;
+  bool                            running_ = false;  /// 由 mutex_ 保护
+  deque<AsyncIOBatch::Request *>  requests_;         /// 等待执行的请求，由 mutex_ 保护
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// IoUringAsyncIO
+
+#ifdef HAVE_IO_URING
+
+/**
+ * @brief 使用 io_uring 实现的异步IO
+ * @details 没有依赖 liburing，直接使用系统调用。
+ * 提交请求的线程把请求放到提交队列(SQ)中，调用 io_uring_enter 提交；一个后台线程等待完成队列(CQ)中的事件。
+ * 与线程池一样，一组请求都成功完成后，后台线程才会提交下一组，有请求失败时后面的请求不会执行。
+ * 没有使用 IOSQE_IO_DRAIN，它会让其它批次的请求也等待。
+ * 正在执行的请求个数不超过完成队列的大小，避免完成事件溢出。后台线程提交时如果没有空间，
+ * 请求先放到 backlog_ 中，等有请求完成后再提交，不能等待自己去释放空间。
+ */
+class IoUringAsyncIO final : public AsyncIOEngine
+{
+public:
+  IoUringAsyncIO() = default;
+
+  ~IoUringAsyncIO() override
+  {
+    if (thread_.joinable()) {
+      // 提交一个 user_data 为0的空请求，通知后台线程退出
+      {
+        unique_lock<mutex> guard(mutex_);
+        space_cv_.wait(guard, [this]() { return inflight_ < cq_entries_; });
+        io_uring_sqe &sqe = next_sqe();
+        sqe.opcode        = IORING_OP_NOP;
+        sqe.user_data     = 0;
+        inflight_++;
+        flush_sqes(1);
+      }
+      thread_.join();
+    }
+
+    if (sqes_ != nullptr) {
+      munmap(sqes_, sqes_size_);
+    }
+    if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+    if (sq_ring_ != nullptr) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+      ::close(ring_fd_);
+    }
+  }
+
+  /**
+   * @return 0 表示成功，否则是 errno
+   */
+  int init(int queue_depth)
+  {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring_fd_ = static_cast<int>(syscall(__NR_io_uring_setup, max(queue_depth, 1), &params));
+    if (ring_fd_ < 0) {
+      return errno;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                    IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+      sq_ring_ = nullptr;
+      return errno;
+    }
+
+    if (single_mmap) {
+      cq_ring_ = sq_ring_;
+    } else {
+      cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                      IORING_OFF_CQ_RING);
+      if (cq_ring_ == MAP_FAILED) {
+        cq_ring_ = nullptr;
+        return errno;
+      }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void *sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_,
+                      IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+      return errno;
+    }
+    sqes_ = static_cast<io_uring_sqe *>(sqes);
+
+    char *sq_ring = static_cast<char *>(sq_ring_);
+    sq_head_      = reinterpret_cast<unsigned *>(sq_ring + params.sq_off.head);
+    sq_tail_      = reinterpret_cast<unsigned *>(sq_ring + params.sq_off.tail);
+    sq_mask_      = *reinterpret_cast<unsigned *>(sq_ring + params.sq_off.ring_mask);
+    sq_array_     = reinterpret_cast<unsigned *>(sq_ring + params.sq_off.array);
+    sq_entries_   = params.sq_entries;
+
+    char *cq_ring = static_cast<char *>(cq_ring_);
+    cq_head_      = reinterpret_cast<unsigned *>(cq_ring + params.cq_off.head);
+    cq_tail_      = reinterpret_cast<unsigned *>(cq_ring + params.cq_off.tail);
+    cq_mask_      = *reinterpret_cast<unsigned *>(cq_ring + params.cq_off.ring_mask);
+    cqes_         = reinterpret_cast<io_uring_cqe *>(cq_ring + params.cq_off.cqes);
+    cq_entries_   = params.cq_entries;
+
+    thread_ = thread(&IoUringAsyncIO::thread_func, this);
+    LOG_INFO("async io with io_uring started. sq entries=%u, cq entries=%u", sq_entries_, cq_entries_);
+    return 0;
+  }
+
+  AsyncIOType type() const override { return AsyncIOType::IO_URING; }
+  const char *name() const override { return "io_uring"; }
+
+protected:
+  void submit_requests(AsyncIOBatch &batch, size_t begin, size_t end) override
+  {
+    unique_lock<mutex> guard(mutex_);
+    if (this_thread::get_id() == thread_.get_id()) {
+      for (size_t i = begin; i < end; i++) {
+        backlog_.push_back(&batch.request(i));
+      }
+      submit_backlog();
+      return;
+    }
+
+    unsigned to_submit = 0;
+    for (size_t i = begin; i < end; i++) {
+      if (inflight_ >= cq_entries_ || to_submit >= sq_entries_) {
+        flush_sqes(to_submit);
+        to_submit = 0;
+        space_cv_.wait(guard, [this]() { return inflight_ < cq_entries_; });
+      }
+
+      prepare_sqe(next_sqe(), batch.request(i));
+      inflight_++;
+      to_submit++;
+    }
+    flush_sqes(to_submit);
+  }
+
+private:
+  /**
+   * @brief 在后台线程中提交 backlog_ 中的请求，直到没有空间
+   */
+  void submit_backlog()
+  {
+    unsigned to_submit = 0;
+    while (!backlog_.empty() && inflight_ < cq_entries_ && to_submit < sq_entries_) {
+      prepare_sqe(next_sqe(), *backlog_.front());
+      backlog_.pop_front();
+      inflight_++;
+      to_submit++;
+    }
+    flush_sqes(to_submit);
+  }
+
+  io_uring_sqe &next_sqe()
+  {
+    const unsigned tail  = *sq_tail_ + pushed_;
+    const unsigned index = tail & sq_mask_;
+    sq_array_[index]     = index;
+    pushed_++;
+
+    io_uring_sqe &sqe = sqes_[index];
+    memset(&sqe, 0, sizeof(sqe));
+    return sqe;
+  }
+
+  void prepare_sqe(io_uring_sqe &sqe, AsyncIOBatch::Request &request)
+  {
+    using Op = AsyncIOBatch::Op;
+    switch (request.op) {
+      case Op::READ: sqe.opcode = IORING_OP_READV; break;
+      case Op::WRITE: sqe.opcode = IORING_OP_WRITEV; break;
+      case Op::FSYNC:
+      case Op::FDATASYNC: {
+        sqe.opcode      = IORING_OP_FSYNC;
+        sqe.fsync_flags = request.op == Op::FDATASYNC ? IORING_FSYNC_DATASYNC : 0;
+      } break;
+    }
+
+    sqe.fd        = request.fd;
+    sqe.user_data = reinterpret_cast<uintptr_t>(&request);
+    if (!request.is_sync()) {
+      sqe.addr = reinterpret_cast<uintptr_t>(request.iov_array());
+      sqe.len  = static_cast<unsigned>(request.iov_count());
+      sqe.off  = static_cast<uint64_t>(request.offset);
+    }
+  }
+
+  /**
+   * @brief 提交 next_sqe 准备好的请求
+   * @details 提交失败并且不能重试时，内核还没有取走的请求直接以这个错误完成
+   */
+  void flush_sqes(unsigned to_submit)
+  {
+    if (to_submit == 0) {
+      return;
+    }
+
+    __atomic_store_n(sq_tail_, *sq_tail_ + pushed_, __ATOMIC_RELEASE);
+    pushed_ = 0;
+
+    while (to_submit > 0) {
+      int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, to_submit, 0, 0, nullptr, 0));
+      if (ret > 0) {
+        to_submit -= ret;
+        continue;
+      }
+
+      const int err = errno;
+      if (err == EINTR || err == EAGAIN || err == EBUSY) {
+        this_thread::yield();
+        continue;
+      }
+
+      LOG_ERROR("failed to submit io_uring requests. requests=%u, error=%s", to_submit, strerror(err));
+      fail_unsubmitted(err);
+      return;
+    }
+  }
+
+  /**
+   * @brief 把内核还没有取走的请求从提交队列中收回，以 err 完成
+   * @details 这些请求失败后，它们所在的批次不会再提交后面的请求，on_complete 不会再调用 submit_requests
+   */
+  void fail_unsubmitted(int err)
+  {
+    const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    const unsigned tail = *sq_tail_;
+    __atomic_store_n(sq_tail_, head, __ATOMIC_RELEASE);
+
+    for (unsigned i = head; i != tail; i++) {
+      const io_uring_sqe &sqe = sqes_[sq_array_[i & sq_mask_]];
+      inflight_--;
+      if (sqe.user_data != 0) {
+        on_complete(*reinterpret_cast<AsyncIOBatch::Request *>(sqe.user_data), err);
+      }
+    }
+    space_cv_.notify_all();
+  }
+
+  void thread_func()
+  {
+    thread_set_name("AsyncIO");
+
+    vector<pair<AsyncIOBatch::Request *, int>> completed;
+
+    bool running = true;
+    while (running) {
+      int ret = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0));
+      if (ret < 0 && errno != EINTR) {
+        LOG_WARN("failed to wait io_uring events. error=%s", strerror(errno));
+      }
+
+      completed.clear();
+      unsigned       head   = *cq_head_;
+      const unsigned tail   = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      unsigned       reaped = 0;
+      for (; head != tail; head++, reaped++) {
+        const io_uring_cqe &cqe = cqes_[head & cq_mask_];
+        if (cqe.user_data == 0) {
+          running = false;
+          continue;
+        }
+        completed.emplace_back(reinterpret_cast<AsyncIOBatch::Request *>(cqe.user_data), cqe.res);
+      }
+      __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+
+      if (reaped == 0) {
+        continue;
+      }
+
+      {
+        lock_guard<mutex> guard(mutex_);
+        inflight_ -= reaped;
+        space_cv_.notify_all();
+      }
+
+      // 先释放完成队列的空间再回调，回调中可能会提交下一组请求
+      for (auto [request, res] : completed) {
+        on_complete(*request, result_of(*request, res));
+      }
+
+      lock_guard<mutex> guard(mutex_);
+      submit_backlog();
+    }
+  }
+
+  static int result_of(const AsyncIOBatch::Request &request, int res)
+  {
+    if (res < 0) {
+      return -res;
+    }
+    if (request.is_sync()) {
+      return 0;
+    }
+
+    // 只读写了一部分，剩下的同步完成
+    const size_t done_size = static_cast<size_t>(res);
+    if (done_size >= request.total_size()) {
+      return 0;
+    }
+    if (request.op == AsyncIOBatch::Op::READ && done_size == 0) {
+      return -1;
+    }
+    return AsyncIOBatch::execute_sync(request, done_size);
+  }
+
+private:
+  int    ring_fd_      = -1;
+  void  *sq_ring_      = nullptr;
+  void  *cq_ring_      = nullptr;
+  size_t sq_ring_size_ = 0;
+  size_t cq_ring_size_ = 0;
+  size_t sqes_size_    = 0;
+
+  io_uring_sqe *sqes_       = nullptr;
+  unsigned     *sq_head_    = nullptr;
+  unsigned     *sq_tail_    = nullptr;
+  unsigned     *sq_array_   = nullptr;
+  unsigned      sq_mask_    = 0;
+  unsigned      sq_entries_ = 0;
+
+  io_uring_cqe *cqes_       = nullptr;
+  unsigned     *cq_head_    = nullptr;
+  unsigned     *cq_tail_    = nullptr;
+  unsigned      cq_mask_    = 0;
+  unsigned      cq_entries_ = 0;
+
+  mutex              mutex_;         /// 保护提交队列和 inflight_
+  condition_variable space_cv_;      /// 有请求完成，可以提交新的请求了
+  unsigned           pushed_   = 0;  /// 放到提交队列中但是还没有更新 sq_tail_ 的请求个数
+  unsigned           inflight_ = 0;  /// 已经提交还没有完成的请求个数
+  thread             thread_;        /// 等待完成事件的线程
+
+  deque<AsyncIOBatch::Request *> backlog_;  /// 后台线程提交时没有空间，等待提交的请求，由 mutex_ 保护
+};
+
+#endif  // HAVE_IO_URING
+
+////////////////////////////////////////////////////////////////////////////////
+
+unique_ptr<AsyncIOEngine> AsyncIOEngine::create(const AsyncIOOptions &options)
+{
+#ifdef HAVE_IO_URING
+  if (options.type == AsyncIOType::IO_URING) {
+    auto engine = make_unique<IoUringAsyncIO>();
+    int  ret    = engine->init(options.queue_depth);
+    if (ret == 0) {
+      return engine;
+    }
+    LOG_WARN("io_uring is not available, use thread pool instead. error=%s", strerror(ret));
+  }
+#else
+  if (options.type == AsyncIOType::IO_URING) {
+    LOG_WARN("io_uring is not supported on this platform, use thread pool instead");
+  }
+#endif
+
+  return make_unique<ThreadPoolAsyncIO>(options.thread_num);
+}
+
+static AsyncIOOptions &default_options()
+{
+  static AsyncIOOptions options;
+  return options;
+}
+
+void AsyncIOEngine::set_default_options(const AsyncIOOptions &options) { default_options() = options; }
+
+AsyncIOEngine &AsyncIOEngine::instance()
+{
+  static unique_ptr<AsyncIOEngine> engine = create(default_options());
+  return *engine;
+}
+
+}  // namespace common
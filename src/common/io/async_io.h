@@ -0,0 +1,228 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include <sys/uio.h>
+
+#include "common/lang/condition_variable.h"
+#include "common/lang/memory.h"
+#include "common/lang/mutex.h"
+#include "common/lang/string.h"
+#include "common/lang/utility.h"
+#include "common/lang/vector.h"
+
+namespace common {
+
+class AsyncIOEngine;
+
+/**
+ * @brief 异步IO引擎的类型
+ */
+enum class AsyncIOType
+{
+  THREAD_POOL,  ///< 在后台线程中执行同步的 pread/pwrite/fsync
+  IO_URING,     ///< 使用 io_uring。内核不支持时使用 THREAD_POOL
+};
+
+/**
+ * @brief 根据名字获取异步IO引擎的类型，不区分大小写，支持 thread_pool 和 io_uring
+ * @return 是否识别了这个名字
+ */
+bool async_io_type_from_name(const string &name, AsyncIOType &type);
+
+/**
+ * @brief 异步IO引擎的配置
+ */
+struct AsyncIOOptions
+{
+  AsyncIOType type        = AsyncIOType::THREAD_POOL;
+  int         queue_depth = 256;  ///< io_uring 的队列深度
+  int         thread_num  = 4;    ///< 线程池的线程个数
+};
+
+/**
+ * @brief 一批异步IO请求
+ * @details 先添加请求，然后交给 AsyncIOEngine::submit 提交，再调用 wait 等待全部完成。
+ * 读写请求之间没有顺序，可以并行执行。fsync 请求在它前面添加的所有请求都完成之后才会执行，
+ * 它后面的请求也要等它完成才会执行，相邻的多个 fsync 之间没有顺序。有请求失败时，后面还没有执行的请求都不会再执行。
+ * 请求中的缓冲区由调用者管理，在 wait 返回之前都要保持有效。
+ * wait 返回后可以调用 clear 复用这个对象。
+ */
+class AsyncIOBatch final
+{
+public:
+  enum class Op
+  {
+    READ,
+    WRITE,
+    FSYNC,
+    FDATASYNC,
+  };
+
+  /**
+   * @brief 一个IO请求
+   */
+  struct Request
+  {
+    Op            op;
+    int           fd     = -1;
+    iovec         iov    = {nullptr, 0};  ///< 只有一个缓冲区时使用
+    const iovec  *iovs   = nullptr;       ///< 多个缓冲区，由调用者管理
+    int           iovcnt = 0;
+    int64_t       offset = 0;
+    int           result = 0;        ///< 0 表示成功，-1 表示读到了文件尾，其它是 errno
+    AsyncIOBatch *batch  = nullptr;  ///< 请求所在的批次
+
+    bool         is_sync() const { return op == Op::FSYNC || op == Op::FDATASYNC; }
+    const iovec *iov_array() const { return iovs != nullptr ? iovs : &iov; }
+    int          iov_count() const { return iovs != nullptr ? iovcnt : 1; }
+    size_t       total_size() const;
+  };
+
+public:
+  AsyncIOBatch() = default;
+  ~AsyncIOBatch();
+
+  AsyncIOBatch(const AsyncIOBatch &)            = delete;
+  AsyncIOBatch &operator=(const AsyncIOBatch &) = delete;
+
+  void add_read(int fd, void *buf, size_t size, int64_t offset);
+  void add_readv(int fd, const iovec *iovs, int iovcnt, int64_t offset);
+  void add_write(int fd, const void *buf, size_t size, int64_t offset);
+  void add_writev(int fd, const iovec *iovs, int iovcnt, int64_t offset);
+  void add_fsync(int fd, bool data_only = true);
+
+  /**
+   * @brief 等待所有请求完成
+   * @return 0 表示全部成功，否则返回第一个失败的请求的结果
+   */
+  int wait();
+
+  /**
+   * @brief 清空所有请求。不能在请求还没有完成时调用
+   */
+  void clear();
+
+  bool     empty() const { return requests_.empty(); }
+  size_t   size() const { return requests_.size(); }
+  Request &request(size_t index) { return requests_[index]; }
+
+  /**
+   * @brief 以 index 开始的一组请求的结束位置
+   * @details 相邻的读写请求是一组，相邻的 fsync 请求是一组。同一组的请求可以并行执行，
+   * 一组请求都完成后才能执行下一组
+   */
+  size_t stage_end(size_t index) const;
+
+  /**
+   * @brief 在当前线程中同步执行一个请求
+   * @param done_size 已经读写完成的字节数，只需要读写剩下的部分
+   */
+  static int execute_sync(const Request &request, size_t done_size = 0);
+
+private:
+  friend class AsyncIOEngine;
+
+  /**
+   * @brief 开始执行前重置状态，由 AsyncIOEngine 调用
+   */
+  void start();
+
+  /**
+   * @brief 记录下一组请求已经提交
+   * @return 下一组请求的范围 [begin, end)
+   */
+  pair<size_t, size_t> next_stage();
+
+  /**
+   * @brief 一个请求完成，由 AsyncIOEngine 调用
+   * @details 有请求失败时不会再执行后面的请求
+   * @return 是否需要提交下一组请求
+   */
+  bool complete(Request &request, int result);
+
+private:
+  vector<Request> requests_;
+
+  mutex              mutex_;
+  condition_variable cv_;
+  bool               running_       = false;  /// 是否提交了还没有完成
+  size_t             submitted_end_ = 0;      /// 已经提交的请求的结束位置
+  size_t             pending_       = 0;      /// 已经提交还没有完成的请求个数
+  int                result_        = 0;      /// 第一个失败的请求的结果
+};
+
+/**
+ * @brief 异步IO引擎
+ * @details 数据文件、double write buffer 和日志文件的读写都通过它执行。
+ * 调用者可以一次提交一批请求，然后等待它们完成，而不是一个一个地同步读写。
+ * 有两个实现：io_uring 和线程池。编译环境中没有 io_uring 的头文件，或者运行时内核不支持 io_uring
+ * (比如版本太低或者被 seccomp 禁止)时，使用线程池实现，在后台线程中同步执行 pread/pwrite/fsync。
+ */
+class AsyncIOEngine
+{
+public:
+  virtual ~AsyncIOEngine() = default;
+
+  /**
+   * @brief 创建异步IO引擎
+   * @details 指定了 io_uring 但是不可用时，使用线程池
+   */
+  static unique_ptr<AsyncIOEngine> create(const AsyncIOOptions &options);
+
+  /**
+   * @brief 设置全局异步IO引擎的配置，需要在第一次调用 instance 之前设置
+   */
+  static void set_default_options(const AsyncIOOptions &options);
+
+  /**
+   * @brief 全局共享的异步IO引擎，第一次调用时创建
+   */
+  static AsyncIOEngine &instance();
+
+  virtual AsyncIOType type() const = 0;
+  virtual const char *name() const = 0;
+
+  /**
+   * @brief 提交一批请求，不等待完成。需要再调用 AsyncIOBatch::wait 等待完成并获取结果
+   */
+  void submit(AsyncIOBatch &batch);
+
+  /**
+   * @brief 提交一批请求并等待完成
+   * @details 只有一个请求时，线程池实现会直接在当前线程中执行，避免线程切换
+   */
+  virtual int execute(AsyncIOBatch &batch);
+
+  /**
+   * @brief 读写一个缓冲区并等待完成，相当于只有一个请求的 execute
+   * @return 0 表示成功，-1 表示读到了文件尾，其它是 errno
+   */
+  int read(int fd, void *buf, size_t size, int64_t offset);
+  int write(int fd, const void *buf, size_t size, int64_t offset);
+
+protected:
+  /**
+   * @brief 提交请求 [begin, end)
+   * @details 没有提交成功的请求，实现类要调用 on_complete 设置错误码
+   */
+  virtual void submit_requests(AsyncIOBatch &batch, size_t begin, size_t end) = 0;
+
+  /**
+   * @brief 实现类在一个请求完成时调用，会在一组请求全部完成后提交下一组
+   */
+  void on_complete(AsyncIOBatch::Request &request, int result);
+
+private:
+  void submit_next_stage(AsyncIOBatch &batch);
+};
+
+}  // namespace common
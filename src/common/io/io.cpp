@@ -367,6 +367,24 @@ int writen(int fd, const void *buf, int size)
   return 0;
 }
 
+int pwriten(int fd, const void *buf, int size, int64_t offset)
+{
+  const char *tmp = (const char *)buf;
+  while (size > 0) {
+    const ssize_t ret = ::pwrite(fd, tmp, size, offset);
+    if (ret >= 0) {
+      tmp += ret;
+      size -= ret;
+      offset += ret;
+      continue;
+    }
+    const int err = errno;
+    if (EAGAIN != err && EINTR != err)
+      return err;
+  }
+  return 0;
+}
+
 int readn(int fd, void *buf, int size)
 {
   char *tmp = (char *)buf;
@@ -386,4 +404,57 @@ int readn(int fd, void *buf, int size)
   }
   return 0;
 }
+
+int preadvn(int fd, struct iovec *iov, int iovcnt, int64_t offset)
+{
+  while (iovcnt > 0) {
+    ssize_t ret = ::preadv(fd, iov, iovcnt, offset);
+    if (ret == 0) {
+      return -1;
+    }
+    if (ret < 0) {
+      const int err = errno;
+      if (EAGAIN != err && EINTR != err)
+        return err;
+      continue;
+    }
+
+    offset += ret;
+    while (iovcnt > 0 && ret >= static_cast<ssize_t>(iov->iov_len)) {
+      ret -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + ret;
+      iov->iov_len -= ret;
+    }
+  }
+  return 0;
+}
+
+int pwritevn(int fd, struct iovec *iov, int iovcnt, int64_t offset)
+{
+  while (iovcnt > 0) {
+    ssize_t ret = ::pwritev(fd, iov, iovcnt, offset);
+    if (ret < 0) {
+      const int err = errno;
+      if (EAGAIN != err && EINTR != err)
+        return err;
+      continue;
+    }
+
+    offset += ret;
+    while (iovcnt > 0 && ret >= static_cast<ssize_t>(iov->iov_len)) {
+      ret -= iov->iov_len;
+      iov++;
+      iovcnt--;
+    }
+    if (iovcnt > 0) {
+      iov->iov_base = static_cast<char *>(iov->iov_base) + ret;
+      iov->iov_len -= ret;
+    }
+  }
+  return 0;
+}
 }  // namespace common
@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <sys/uio.h>
 #include <vector>
 
 #include "common/defs.h"
@@ -67,6 +68,17 @@ int getFileSize(const char *filePath, int64_t &fileLen);
  */
 int writen(int fd, const void *buf, int size);
 
+/**
+ * @brief 在指定的位置一次性写入所有指定数据，不会修改文件的偏移量
+ *
+ * @param fd  写入的描述符
+ * @param buf 写入的数据
+ * @param size 写入多少数据
+ * @param offset 写入的位置
+ * @return int 0 表示成功，否则返回errno
+ */
+int pwriten(int fd, const void *buf, int size, int64_t offset);
+
 /**
  * @brief 一次性读取指定长度的数据
  *
@@ -77,4 +89,27 @@ int writen(int fd, const void *buf, int size);
  */
 int readn(int fd, void *buf, int size);
 
+/**
+ * @brief 从指定的位置一次性读取数据到多个缓冲区，不会修改文件的偏移量
+ * @details 只发起一次 preadv 系统调用，除非被打断或者只读到了一部分数据
+ *
+ * @param fd  读取的描述符
+ * @param iov 缓冲区数组，读取过程中会被修改
+ * @param iovcnt 缓冲区个数，不能超过 IOV_MAX
+ * @param offset 读取的位置
+ * @return int 返回0表示成功。-1 表示读取到文件尾，并且没有读满所有缓冲区，其它表示errno
+ */
+int preadvn(int fd, struct iovec *iov, int iovcnt, int64_t offset);
+
+/**
+ * @brief 在指定的位置一次性写入多个缓冲区的数据，不会修改文件的偏移量
+ *
+ * @param fd  写入的描述符
+ * @param iov 缓冲区数组，写入过程中会被修改
+ * @param iovcnt 缓冲区个数，不能超过 IOV_MAX
+ * @param offset 写入的位置
+ * @return int 0 表示成功，否则返回errno
+ */
+int pwritevn(int fd, struct iovec *iov, int iovcnt, int64_t offset);
+
 }  // namespace common
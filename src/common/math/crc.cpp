@@ -12,6 +12,8 @@ See the Mulan PSL v2 for more details. */
 // Created by Wenbin on 2024/3/25.
 //
 
+#include "common/math/crc.h"
+
 unsigned int crc_table[] = {0x00000000,
     0x77073096,
     0xEE0E612C,
@@ -269,9 +271,10 @@ unsigned int crc_table[] = {0x00000000,
     0x5A05DF1B,
     0x2D02EF8D};
 
-unsigned int crc32(const char *buffer, unsigned int size)
+unsigned int crc32(const char *buffer, unsigned int size) { return crc32(0xffffffff, buffer, size); }
+
+unsigned int crc32(unsigned int crc, const char *buffer, unsigned int size)
 {
-  unsigned int crc = 0xffffffff;
   for (unsigned int i = 0; i < size; i++) {
     crc = crc_table[(crc ^ buffer[i]) & 0xff] ^ (crc >> 8);
   }
@@ -16,3 +16,6 @@ See the Mulan PSL v2 for more details. */
 
 /// 计算buffer的crc校验码
 unsigned int crc32(const char *buffer, unsigned int size);
+
+/// 在已有的校验码 crc 上继续计算buffer的crc校验码，用于计算分成多段的数据的校验码
+unsigned int crc32(unsigned int crc, const char *buffer, unsigned int size);
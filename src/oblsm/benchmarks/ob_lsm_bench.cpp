@@ -1,2 +1,469 @@
-// TODO: add oblsm bench tool, reference leveldb db_bench
-int main() { return 0; }
\ No newline at end of file
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+// A simple oblsm bench tool, reference leveldb db_bench.
+//
+// Usage: oblsm_bench [--flag=value ...]
+//   --benchmarks=fillseq,fillrandom   comma separated list of benchmarks to run,
+//                                     fillbatch writes sequential keys with batch_put,
+//                                     readrandom/readmissing read existing/missing keys
+//                                     after loading --num entries, and print a latency histogram
+//   --num=N                           number of entries to write in each benchmark
+//   --value_size=N                    size of each value
+//   --batch_size=N                    number of entries per batch_put in fillbatch
+//   --threads=1,2,4,8                 run every benchmark once with each thread count
+//   --memtable_size=N                 ObLsmOptions::memtable_size
+//   --table_size=N                    ObLsmOptions::table_size
+//   --l1_level_size=N                 ObLsmOptions::default_l1_level_size
+//   --compaction_threads=N            ObLsmOptions::compaction_threads
+//   --background_write_rate=N         ObLsmOptions::background_write_rate, bytes per second
+//   --block_restart_interval=N        ObLsmOptions::block_restart_interval
+//   --compression=none|lz4            codec of the levels below level 0
+//   --compression_ratio=F             the values compress to about F of their size
+//   --mmap=0|1                        ObLsmOptions::use_mmap_reads
+//   --sync=0|1                        ObLsmOptions::force_sync_new_log
+//   --db=path                         directory of the database
+
+#include <stdio.h>
+#include <string.h>
+
+#include "common/lang/algorithm.h"
+#include "common/lang/atomic.h"
+#include "common/lang/chrono.h"
+#include "common/lang/cmath.h"
+#include "common/lang/filesystem.h"
+#include "common/lang/functional.h"
+#include "common/lang/string.h"
+#include "common/lang/thread.h"
+#include "common/lang/utility.h"
+#include "common/lang/vector.h"
+#include "common/math/random_generator.h"
+#include "oblsm/include/ob_lsm.h"
+#include "oblsm/include/ob_lsm_options.h"
+
+using namespace oceanbase;
+
+namespace {
+
+string         FLAGS_benchmarks            = "fillseq,fillrandom";
+int            FLAGS_num                   = 200000;
+int            FLAGS_value_size            = 100;
+int            FLAGS_batch_size            = 100;
+vector<int>    FLAGS_threads               = {1, 2, 4, 8, 16, 32};
+size_t         FLAGS_memtable_size         = 64 * 1024 * 1024;
+size_t         FLAGS_table_size            = ObLsmOptions().table_size;
+size_t         FLAGS_l1_level_size         = ObLsmOptions().default_l1_level_size;
+size_t         FLAGS_compaction_threads    = ObLsmOptions().compaction_threads;
+size_t         FLAGS_background_write_rate = ObLsmOptions().background_write_rate;
+size_t         FLAGS_restart_interval      = ObLsmOptions().block_restart_interval;
+bool           FLAGS_compression           = true;
+double         FLAGS_compression_ratio     = 0.5;
+bool           FLAGS_mmap                  = false;
+bool           FLAGS_sync                  = false;
+string         FLAGS_db                    = "oblsm_bench_db";
+constexpr int  KEY_SIZE                    = 16;
+
+vector<string> split(const string &s, char delim)
+{
+  vector<string> result;
+  size_t         begin = 0;
+  while (begin <= s.size()) {
+    size_t end = s.find(delim, begin);
+    if (end == string::npos) {
+      end = s.size();
+    }
+    if (end > begin) {
+      result.emplace_back(s.substr(begin, end - begin));
+    }
+    begin = end + 1;
+  }
+  return result;
+}
+
+string make_key(uint64_t k)
+{
+  char buf[KEY_SIZE + 1];
+  snprintf(buf, sizeof(buf), "%016lu", k);
+  return string(buf, KEY_SIZE);
+}
+
+// generates values which compress to about `FLAGS_compression_ratio` of their size
+class ValueGenerator
+{
+public:
+  ValueGenerator()
+  {
+    common::RandomGenerator rnd;
+    const size_t            random_len = max(1, static_cast<int>(100 * FLAGS_compression_ratio));
+    while (data_.size() < max<size_t>(1048576, FLAGS_value_size)) {
+      // pieces of 100 bytes, each is a random string repeated
+      for (size_t i = 0; i < 100; i++) {
+        data_.push_back(i < random_len ? static_cast<char>(' ' + rnd.next(95)) : data_[data_.size() - random_len]);
+      }
+    }
+  }
+
+  string_view generate(size_t len)
+  {
+    if (pos_ + len > data_.size()) {
+      pos_ = 0;
+    }
+    pos_ += len;
+    return string_view(data_.data() + pos_ - len, len);
+  }
+
+private:
+  string data_;
+  size_t pos_ = 0;
+};
+
+// latency histogram with 4 buckets per power of 2 microseconds
+class Histogram
+{
+public:
+  void add(double micros)
+  {
+    int bucket = micros < 1 ? 0 : min(BUCKET_NUM - 1, 1 + static_cast<int>(log2(micros) * 4));
+    buckets_[bucket]++;
+    count_++;
+    sum_ += micros;
+    max_ = max(max_, micros);
+  }
+
+  void merge(const Histogram &other)
+  {
+    for (int i = 0; i < BUCKET_NUM; i++) {
+      buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = max(max_, other.max_);
+  }
+
+  // upper bound of the bucket where the p-th percentile falls
+  double percentile(double p) const
+  {
+    double  threshold = count_ * p / 100.0;
+    int64_t sum       = 0;
+    for (int i = 0; i < BUCKET_NUM; i++) {
+      sum += buckets_[i];
+      if (sum >= threshold) {
+        return min(max_, upper_bound(i));
+      }
+    }
+    return max_;
+  }
+
+  void print() const
+  {
+    if (count_ == 0) {
+      return;
+    }
+    fprintf(stdout,
+        "  latency(us): count=%ld avg=%.2f p50=%.2f p90=%.2f p99=%.2f p99.9=%.2f max=%.2f\n",
+        count_,
+        sum_ / count_,
+        percentile(50),
+        percentile(90),
+        percentile(99),
+        percentile(99.9),
+        max_);
+  }
+
+private:
+  static double upper_bound(int bucket) { return bucket == 0 ? 1 : exp2(bucket / 4.0); }
+
+  static constexpr int BUCKET_NUM = 100;
+
+  int64_t buckets_[BUCKET_NUM] = {0};
+  int64_t count_               = 0;
+  double  sum_                 = 0;
+  double  max_                 = 0;
+};
+
+class Benchmark
+{
+public:
+  void run()
+  {
+    print_header();
+    for (const string &name : split(FLAGS_benchmarks, ',')) {
+      function<void(int, int)> method;
+      if (name == "fillseq") {
+        method = [this](int tid, int threads) { write(tid, threads, false /*random*/); };
+      } else if (name == "fillrandom") {
+        method = [this](int tid, int threads) { write(tid, threads, true /*random*/); };
+      } else if (name == "fillbatch") {
+        method = [this](int tid, int threads) { write_batch(tid, threads); };
+      } else if (name == "readrandom") {
+        method = [this](int tid, int threads) { read(tid, threads, false /*missing*/); };
+      } else if (name == "readmissing") {
+        method = [this](int tid, int threads) { read(tid, threads, true /*missing*/); };
+      } else {
+        fprintf(stderr, "unknown benchmark '%s'\n", name.c_str());
+        continue;
+      }
+
+      for (int threads : FLAGS_threads) {
+        run_benchmark(name, threads, method);
+      }
+    }
+  }
+
+private:
+  void print_header()
+  {
+    fprintf(stdout, "Keys:       %d bytes each\n", KEY_SIZE);
+    fprintf(stdout, "Values:     %d bytes each\n", FLAGS_value_size);
+    fprintf(stdout, "Entries:    %d\n", FLAGS_num);
+    fprintf(stdout, "Memtable:   %zu bytes\n", FLAGS_memtable_size);
+    fprintf(stdout, "Table:      %zu bytes\n", FLAGS_table_size);
+    fprintf(stdout, "L1:         %zu bytes\n", FLAGS_l1_level_size);
+    fprintf(stdout, "Compaction: %zu threads\n", FLAGS_compaction_threads);
+    fprintf(stdout, "Restart:    %zu entries\n", FLAGS_restart_interval);
+    fprintf(stdout, "Codec:      %s\n", FLAGS_compression ? "lz4" : "none");
+    fprintf(stdout, "Batch:      %d entries\n", FLAGS_batch_size);
+    fprintf(stdout, "Reads:      %s\n", FLAGS_mmap ? "mmap" : "pread");
+    fprintf(stdout, "Sync:       %s\n", FLAGS_sync ? "true" : "false");
+    fprintf(stdout, "------------------------------------------------\n");
+  }
+
+  void open_db()
+  {
+    filesystem::remove_all(FLAGS_db);
+    filesystem::create_directory(FLAGS_db);
+    ObLsmOptions options;
+    options.memtable_size          = FLAGS_memtable_size;
+    options.table_size             = FLAGS_table_size;
+    options.default_l1_level_size  = FLAGS_l1_level_size;
+    options.compaction_threads     = FLAGS_compaction_threads;
+    options.background_write_rate  = FLAGS_background_write_rate;
+    options.block_restart_interval = FLAGS_restart_interval;
+    options.use_mmap_reads         = FLAGS_mmap;
+    options.force_sync_new_log     = FLAGS_sync;
+    options.compression_per_level  = {
+        ObCompressionType::NONE, FLAGS_compression ? ObCompressionType::LZ4 : ObCompressionType::NONE};
+    RC rc                          = ObLsm::open(options, FLAGS_db, &db_);
+    if (OB_FAIL(rc)) {
+      fprintf(stderr, "open db failed. rc=%s\n", strrc(rc));
+      exit(1);
+    }
+  }
+
+  void close_db()
+  {
+    delete db_;
+    db_ = nullptr;
+    filesystem::remove_all(FLAGS_db);
+  }
+
+  size_t sstable_bytes() const
+  {
+    size_t bytes = 0;
+    for (const auto &entry : filesystem::directory_iterator(FLAGS_db)) {
+      if (entry.path().extension() == SSTABLE_SUFFIX) {
+        bytes += entry.file_size();
+      }
+    }
+    return bytes;
+  }
+
+  // load the data of read benchmarks, it's not timed
+  void load()
+  {
+    ValueGenerator gen;
+    for (int i = 0; i < FLAGS_num; i += FLAGS_batch_size) {
+      vector<pair<string, string>> kvs;
+      for (int j = i; j < min(FLAGS_num, i + FLAGS_batch_size); j++) {
+        kvs.emplace_back(make_key(j), gen.generate(FLAGS_value_size));
+      }
+      RC rc = db_->batch_put(kvs);
+      if (OB_FAIL(rc)) {
+        fprintf(stderr, "batch_put failed. rc=%s\n", strrc(rc));
+        exit(1);
+      }
+    }
+  }
+
+  void run_benchmark(const string &name, int threads, const function<void(int, int)> &method)
+  {
+    open_db();
+    if (name.rfind("read", 0) == 0) {
+      load();
+    }
+    histograms_.assign(threads, Histogram());
+    found_ = 0;
+
+    vector<thread> workers;
+    auto           start = chrono::steady_clock::now();
+    for (int i = 0; i < threads; i++) {
+      workers.emplace_back(method, i, threads);
+    }
+    for (thread &worker : workers) {
+      worker.join();
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    int64_t done = (FLAGS_num / threads) * threads;
+    double  mb   = static_cast<double>(done) * (KEY_SIZE + FLAGS_value_size) / 1048576.0;
+    fprintf(stdout,
+        "%-12s : threads=%-3d %11.3f micros/op; %10.0f ops/sec; %7.1f MB/s\n",
+        name.c_str(),
+        threads,
+        seconds * 1e6 / done,
+        done / seconds,
+        mb / seconds);
+    Histogram histogram;
+    for (const Histogram &h : histograms_) {
+      histogram.merge(h);
+    }
+    if (name.rfind("read", 0) == 0) {
+      fprintf(stdout, "  found %ld of %ld\n", found_.load(), done);
+    }
+    histogram.print();
+    ObLsmWriteStallStats stalls = db_->write_stall_stats();
+    if (stalls.stall_micros > 0) {
+      fprintf(stdout,
+          "  stalls: %.3f seconds; l0 slowdown=%lu stop=%lu; pending bytes slowdown=%lu stop=%lu; memtable stop=%lu\n",
+          stalls.stall_micros / 1e6,
+          stalls.l0_slowdown_count,
+          stalls.l0_stop_count,
+          stalls.pending_bytes_slowdown_count,
+          stalls.pending_bytes_stop_count,
+          stalls.memtable_stop_count);
+    }
+    fprintf(stdout, "  sstables: %.1f MB\n", sstable_bytes() / 1048576.0);
+    fflush(stdout);
+
+    close_db();
+  }
+
+  void write(int tid, int threads, bool random)
+  {
+    common::RandomGenerator rnd;
+    ValueGenerator          gen;
+    const int               ops   = FLAGS_num / threads;
+    const uint64_t          begin = static_cast<uint64_t>(tid) * ops;
+    Histogram              &hist  = histograms_[tid];
+    for (int i = 0; i < ops; i++) {
+      const uint64_t k = random ? rnd.next(FLAGS_num) : begin + i;
+      // random keys may repeat, make each (key, seq) unique is the job of oblsm
+      auto start = chrono::steady_clock::now();
+      RC   rc    = db_->put(make_key(k), gen.generate(FLAGS_value_size));
+      hist.add(chrono::duration<double, std::micro>(chrono::steady_clock::now() - start).count());
+      if (OB_FAIL(rc)) {
+        fprintf(stderr, "put failed. rc=%s\n", strrc(rc));
+        exit(1);
+      }
+    }
+  }
+
+  void write_batch(int tid, int threads)
+  {
+    ValueGenerator gen;
+    const int      ops   = FLAGS_num / threads;
+    const uint64_t begin = static_cast<uint64_t>(tid) * ops;
+    for (int i = 0; i < ops; i += FLAGS_batch_size) {
+      vector<pair<string, string>> kvs;
+      for (int j = i; j < min(ops, i + FLAGS_batch_size); j++) {
+        kvs.emplace_back(make_key(begin + j), gen.generate(FLAGS_value_size));
+      }
+      RC rc = db_->batch_put(kvs);
+      if (OB_FAIL(rc)) {
+        fprintf(stderr, "batch_put failed. rc=%s\n", strrc(rc));
+        exit(1);
+      }
+    }
+  }
+
+  void read(int tid, int threads, bool missing)
+  {
+    common::RandomGenerator rnd;
+    string                  value;
+    const int               ops   = FLAGS_num / threads;
+    Histogram              &hist  = histograms_[tid];
+    int64_t                 found = 0;
+    for (int i = 0; i < ops; i++) {
+      // a missing key sorts between two existing keys, so only the bloom filters can rule it out
+      string key   = missing ? make_key(rnd.next(FLAGS_num)) + "." : make_key(rnd.next(FLAGS_num));
+      auto   start = chrono::steady_clock::now();
+      RC     rc    = db_->get(key, &value);
+      hist.add(chrono::duration<double, std::micro>(chrono::steady_clock::now() - start).count());
+      if (OB_SUCC(rc)) {
+        found++;
+      } else if (rc != RC::NOT_EXIST) {
+        fprintf(stderr, "get failed. rc=%s\n", strrc(rc));
+        exit(1);
+      }
+    }
+    found_ += found;
+  }
+
+private:
+  ObLsm            *db_ = nullptr;
+  vector<Histogram> histograms_;
+  atomic<int64_t>   found_{0};
+};
+
+}  // namespace
+
+int main(int argc, char **argv)
+{
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    int         n   = 0;
+    long long   ll  = 0;
+    double      d   = 0;
+    char        junk;
+    if (strncmp(arg, "--benchmarks=", 13) == 0) {
+      FLAGS_benchmarks = arg + 13;
+    } else if (sscanf(arg, "--num=%d%c", &n, &junk) == 1) {
+      FLAGS_num = n;
+    } else if (sscanf(arg, "--value_size=%d%c", &n, &junk) == 1) {
+      FLAGS_value_size = n;
+    } else if (sscanf(arg, "--batch_size=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_batch_size = n;
+    } else if (sscanf(arg, "--memtable_size=%lld%c", &ll, &junk) == 1) {
+      FLAGS_memtable_size = static_cast<size_t>(ll);
+    } else if (sscanf(arg, "--table_size=%lld%c", &ll, &junk) == 1 && ll > 0) {
+      FLAGS_table_size = static_cast<size_t>(ll);
+    } else if (sscanf(arg, "--l1_level_size=%lld%c", &ll, &junk) == 1 && ll > 0) {
+      FLAGS_l1_level_size = static_cast<size_t>(ll);
+    } else if (sscanf(arg, "--compaction_threads=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_compaction_threads = n;
+    } else if (sscanf(arg, "--background_write_rate=%lld%c", &ll, &junk) == 1 && ll >= 0) {
+      FLAGS_background_write_rate = static_cast<size_t>(ll);
+    } else if (sscanf(arg, "--block_restart_interval=%d%c", &n, &junk) == 1 && n > 0) {
+      FLAGS_restart_interval = n;
+    } else if (strcmp(arg, "--compression=none") == 0 || strcmp(arg, "--compression=lz4") == 0) {
+      FLAGS_compression = strcmp(arg, "--compression=lz4") == 0;
+    } else if (sscanf(arg, "--compression_ratio=%lf%c", &d, &junk) == 1 && d > 0 && d <= 1) {
+      FLAGS_compression_ratio = d;
+    } else if (sscanf(arg, "--mmap=%d%c", &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_mmap = n == 1;
+    } else if (sscanf(arg, "--sync=%d%c", &n, &junk) == 1 && (n == 0 || n == 1)) {
+      FLAGS_sync = n == 1;
+    } else if (strncmp(arg, "--threads=", 10) == 0) {
+      FLAGS_threads.clear();
+      for (const string &t : split(arg + 10, ',')) {
+        FLAGS_threads.push_back(max(1, atoi(t.c_str())));
+      }
+    } else if (strncmp(arg, "--db=", 5) == 0) {
+      FLAGS_db = arg + 5;
+    } else {
+      fprintf(stderr, "Invalid flag '%s'\n", arg);
+      exit(1);
+    }
+  }
+
+  Benchmark benchmark;
+  benchmark.run();
+  return 0;
+}
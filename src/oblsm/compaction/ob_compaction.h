@@ -68,6 +68,12 @@ public:
    */
   const vector<shared_ptr<ObSSTable>> &inputs(int which) const { return inputs_[which]; }
 
+  /**
+   * @brief Whether the compaction can be done by moving the only input SSTable to `level_ + 1`,
+   * which is possible if no SSTable of `level_ + 1` overlaps with it.
+   */
+  bool is_trivial_move() const { return level_ > 0 && inputs_[0].size() == 1 && inputs_[1].empty(); }
+
 private:
   /// Each compaction reads inputs from "level_" and "level_+1"
   std::vector<shared_ptr<ObSSTable>> inputs_[2];
@@ -9,7 +9,9 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #include "oblsm/compaction/ob_compaction_picker.h"
+#include "common/lang/algorithm.h"
 #include "common/log/log.h"
+#include "oblsm/util/ob_coding.h"
 
 namespace oceanbase {
 
@@ -31,11 +33,142 @@ unique_ptr<ObCompaction> TiredCompactionPicker::pick(SSTablesPtr sstables)
   return compaction;
 }
 
+double LeveledCompactionPicker::max_bytes_for_level(size_t level) const
+{
+  double result = options_->default_l1_level_size;
+  for (size_t i = 1; i < level; ++i) {
+    result *= options_->default_level_ratio;
+  }
+  return result;
+}
+
+size_t LeveledCompactionPicker::pending_compaction_bytes(const SSTablesPtr &sstables) const
+{
+  size_t pending_bytes = 0;
+  for (size_t i = 0; i + 1 < sstables->size(); ++i) {
+    const vector<shared_ptr<ObSSTable>> &level_i     = (*sstables)[i];
+    size_t                               level_bytes = 0;
+    for (const auto &sstable : level_i) {
+      level_bytes += sstable->size();
+    }
+    if (i == 0) {
+      if (options_->default_l0_file_num > 0 && level_i.size() >= options_->default_l0_file_num) {
+        pending_bytes += level_bytes;
+      }
+    } else if (level_bytes > max_bytes_for_level(i)) {
+      pending_bytes += level_bytes - static_cast<size_t>(max_bytes_for_level(i));
+    }
+  }
+  return pending_bytes;
+}
+
+unique_ptr<ObCompaction> LeveledCompactionPicker::pick(SSTablesPtr sstables)
+{
+  const size_t levels = sstables->size();
+  if (levels < 2) {
+    return nullptr;
+  }
+  compact_pointers_.resize(levels);
+
+  // the last level has no limit
+  int    best_level = -1;
+  double best_score = 0;
+  for (size_t i = 0; i + 1 < levels; ++i) {
+    const vector<shared_ptr<ObSSTable>> &level_i = (*sstables)[i];
+    double                               score   = 0;
+    if (i == 0) {
+      score = options_->default_l0_file_num == 0 ? 0 : static_cast<double>(level_i.size()) / options_->default_l0_file_num;
+    } else {
+      size_t level_bytes = 0;
+      for (const auto &sstable : level_i) {
+        level_bytes += sstable->size();
+      }
+      score = level_bytes / max_bytes_for_level(i);
+    }
+    // level 0 is compacted once it reaches the limit, the others after they exceed it.
+    bool need_compaction = i == 0 ? score >= 1 : score > 1;
+    if (need_compaction && score > best_score) {
+      best_score = score;
+      best_level = i;
+    }
+  }
+  if (best_level < 0) {
+    return nullptr;
+  }
+
+  unique_ptr<ObCompaction>             compaction(new ObCompaction(best_level));
+  const vector<shared_ptr<ObSSTable>> &level_i = (*sstables)[best_level];
+  if (best_level == 0) {
+    compaction->inputs_[0] = level_i;
+  } else {
+    // the sstables of the level are sorted, pick the first one after the compact pointer.
+    const string &pointer = compact_pointers_[best_level];
+    auto          iter    = level_i.begin();
+    if (!pointer.empty()) {
+      iter = find_if(level_i.begin(), level_i.end(), [this, &pointer](const shared_ptr<ObSSTable> &sstable) {
+        return comparator_.compare(sstable->first_key(), pointer) > 0;
+      });
+      if (iter == level_i.end()) {
+        iter = level_i.begin();
+      }
+    }
+    // the versions of a user key may be split into adjacent sstables, they must be compacted together,
+    // otherwise the newer versions could be pushed to a deeper level than the older ones.
+    const ObComparator *user_comparator = comparator_.user_comparator();
+    auto                first           = iter;
+    auto                last            = iter;
+    while (first != level_i.begin() && user_comparator->compare(extract_user_key((*(first - 1))->last_key()),
+                                           extract_user_key((*first)->first_key())) == 0) {
+      --first;
+    }
+    while (last + 1 != level_i.end() && user_comparator->compare(extract_user_key((*last)->last_key()),
+                                            extract_user_key((*(last + 1))->first_key())) == 0) {
+      ++last;
+    }
+    compaction->inputs_[0].assign(first, last + 1);
+    compact_pointers_[best_level] = (*last)->last_key();
+  }
+
+  // the user key range of the inputs
+  const ObComparator *user_comparator = comparator_.user_comparator();
+  bool                has_range       = false;
+  string              smallest;
+  string              largest;
+  for (const auto &sstable : compaction->inputs_[0]) {
+    if (sstable->block_count() == 0) {
+      continue;
+    }
+    string first = string(extract_user_key(sstable->first_key()));
+    string last  = string(extract_user_key(sstable->last_key()));
+    if (!has_range || user_comparator->compare(first, smallest) < 0) {
+      smallest = first;
+    }
+    if (!has_range || user_comparator->compare(last, largest) > 0) {
+      largest = last;
+    }
+    has_range = true;
+  }
+  if (has_range) {
+    for (const auto &sstable : (*sstables)[best_level + 1]) {
+      if (sstable->block_count() == 0 ||
+          user_comparator->compare(extract_user_key(sstable->last_key()), smallest) < 0 ||
+          user_comparator->compare(extract_user_key(sstable->first_key()), largest) > 0) {
+        continue;
+      }
+      compaction->inputs_[1].emplace_back(sstable);
+    }
+  }
+  LOG_DEBUG("pick compaction. level=%d, score=%.2f, inputs=%lu+%lu",
+      best_level, best_score, compaction->inputs_[0].size(), compaction->inputs_[1].size());
+  return compaction;
+}
+
 ObCompactionPicker *ObCompactionPicker::create(CompactionType type, ObLsmOptions *options)
 {
 
   switch (type) {
     case CompactionType::TIRED: return new TiredCompactionPicker(options);
+    case CompactionType::LEVELED: return new LeveledCompactionPicker(options);
     default: return nullptr;
   }
   return nullptr;
@@ -41,6 +41,12 @@ public:
    */
   virtual unique_ptr<ObCompaction> pick(SSTablesPtr sstables) = 0;
 
+  /**
+   * @brief Estimates the bytes that have to be compacted before `pick` returns nullptr.
+   * @details It is used to slow down the writes when the compaction falls behind.
+   */
+  virtual size_t pending_compaction_bytes(const SSTablesPtr &sstables) const { return 0; }
+
   /**
    * @brief Static factory method to create a specific compaction picker.
    * @param type The type of compaction strategy (e.g., tiered, leveled).
@@ -76,4 +82,53 @@ public:
 private:
 };
 
+/**
+ * @class LeveledCompactionPicker
+ * @brief A class implementing the leveled compaction strategy.
+ *
+ * Every level has a size limit: level 0 is limited by the number of its SSTables
+ * (`default_l0_file_num`), level 1 by `default_l1_level_size` bytes and every next level
+ * by `default_level_ratio` times the limit of the previous one. The level which exceeds
+ * its limit the most is picked:
+ * - from level 0, all the SSTables are picked, because they may overlap with each other.
+ * - from other levels, one SSTable is picked. The levels are compacted round-robin, starting
+ *   after the last key compacted from the level.
+ *
+ * The SSTables of the next level which overlap with the picked ones are added to the compaction.
+ * The picker remembers the round-robin position of each level, so it should be reused.
+ */
+class LeveledCompactionPicker : public ObCompactionPicker
+{
+public:
+  /**
+   * @param options Pointer to the LSM-Tree options configuration.
+   */
+  LeveledCompactionPicker(ObLsmOptions *options) : ObCompactionPicker(options) {}
+
+  ~LeveledCompactionPicker() = default;
+
+  /**
+   * @brief Implementation of the pick method for leveled compaction.
+   * @details The input of level i is widened to the adjacent sstables which share its first or
+   * last user key, so all the versions of a user key are always compacted together.
+   * @return nullptr if all levels are within their limits.
+   */
+  unique_ptr<ObCompaction> pick(SSTablesPtr sstables) override;
+
+  /**
+   * @brief The bytes of level 0 if it reaches its limit, plus the bytes beyond the limit of each other level.
+   */
+  size_t pending_compaction_bytes(const SSTablesPtr &sstables) const override;
+
+private:
+  /**
+   * @brief The size limit in bytes of `level` (level > 0).
+   */
+  double max_bytes_for_level(size_t level) const;
+
+  ObInternalKeyComparator comparator_;
+  // the largest internal key of the last compaction of each level
+  vector<string>          compact_pointers_;
+};
+
 }  // namespace oceanbase
\ No newline at end of file
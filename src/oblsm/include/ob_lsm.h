@@ -20,6 +20,20 @@ See the Mulan PSL v2 for more details. */
 namespace oceanbase {
 
 class ObLsmTransaction;
+
+/**
+ * @brief Counters of the writes delayed or stopped to let flush and compaction catch up.
+ * @see ObLsmOptions::l0_slowdown_writes_trigger
+ */
+struct ObLsmWriteStallStats
+{
+  uint64_t stall_micros                 = 0;  ///< Total time writers were delayed or stopped.
+  uint64_t l0_slowdown_count            = 0;  ///< Writes delayed by the number of level 0 files.
+  uint64_t l0_stop_count                = 0;  ///< Writes stopped by the number of level 0 files.
+  uint64_t pending_bytes_slowdown_count = 0;  ///< Writes delayed by the pending compaction bytes.
+  uint64_t pending_bytes_stop_count     = 0;  ///< Writes stopped by the pending compaction bytes.
+  uint64_t memtable_stop_count          = 0;  ///< Writes stopped until the immutable memtable is flushed.
+};
 /**
  * @brief ObLsm is a key-value storage engine for educational purpose.
  * ObLsm learned a lot about design from leveldb and streamlined it.
@@ -88,6 +102,22 @@ public:
   // TODO: distinguish transaction interface and non-transaction interface, refer to rocksdb
   virtual ObLsmTransaction *begin_transaction() = 0;
 
+  /**
+   * @brief Takes a snapshot of the current state of the LSM-Tree.
+   *
+   * Compactions keep every version of a key that a live snapshot may read, so the iterators
+   * created with `ObLsmReadOptions::seq` set to the snapshot keep seeing the same data.
+   *
+   * @return The sequence number of the snapshot.
+   * @note The snapshot must be released by `release_snapshot`, a transaction holds one until it is deleted.
+   */
+  virtual uint64_t get_snapshot() = 0;
+
+  /**
+   * @brief Releases a snapshot returned by `get_snapshot`.
+   */
+  virtual void release_snapshot(uint64_t seq) = 0;
+
   /**
    * @brief Creates a new iterator for traversing the LSM-Tree database.
    *
@@ -117,6 +147,11 @@ public:
    * LSM-Tree for debugging or inspection purposes.
    */
   virtual void dump_sstables() = 0;
+
+  /**
+   * @brief Returns the counters of write stalls since the LSM-Tree is opened.
+   */
+  virtual ObLsmWriteStallStats write_stall_stats() const = 0;
 };
 
 }  // namespace oceanbase
@@ -12,6 +12,8 @@ See the Mulan PSL v2 for more details. */
 
 #include <cstddef>
 #include <cstdint>
+#include "common/lang/algorithm.h"
+#include "common/lang/vector.h"
 #include "oblsm/ob_lsm_define.h"
 
 namespace oceanbase {
@@ -34,6 +36,23 @@ struct ObLsmOptions
   size_t default_level_ratio   = 10;
   size_t default_l0_file_num   = 3;
 
+  // the max number of subcompactions of a compaction, they run in parallel on a background pool
+  // of this size. A compaction is split into key ranges of at least `table_size` bytes.
+  size_t compaction_threads = 2;
+
+  // write stalls: a write is delayed by `slowdown_write_micros` when level 0 has
+  // `l0_slowdown_writes_trigger` sstables or the bytes to compact reach `soft_pending_compaction_bytes_limit`,
+  // and stopped until compaction catches up at `l0_stop_writes_trigger` or `hard_pending_compaction_bytes_limit`.
+  // 0 disables a trigger. The bytes to compact are the bytes of the levels beyond their limits.
+  size_t l0_slowdown_writes_trigger          = 8;
+  size_t l0_stop_writes_trigger              = 12;
+  size_t soft_pending_compaction_bytes_limit = 64 * 1024 * 1024;
+  size_t hard_pending_compaction_bytes_limit = 256 * 1024 * 1024;
+  size_t slowdown_write_micros               = 1000;
+
+  // bytes per second written by flush and compaction, 0 means unlimited.
+  size_t background_write_rate = 0;
+
   // tired compaction
   size_t default_run_num = 7;
 
@@ -42,6 +61,34 @@ struct ObLsmOptions
 
   // it is used to control whether the WAL is forced to be written to the disk every time a new key is written.
   bool force_sync_new_log = true;
+
+  // bits per user key of the bloom filter in each sstable, 0 means no filter is built.
+  // 10 bits per key gives a false positive rate about 1%.
+  size_t bloom_bits_per_key = 10;
+
+  // number of entries between two restart points of a data block. The keys between restart points
+  // are prefix compressed, a larger interval makes the blocks smaller but the seeks slower.
+  size_t block_restart_interval = 16;
+
+  // codec of the data blocks of each level, the levels beyond the vector use its last element.
+  // The sstables flushed from memtables are in level 0, the ones built by compaction are in the
+  // output level. Keeping the hot levels uncompressed saves the cpu of the frequent rewrites.
+  vector<ObCompressionType> compression_per_level = {ObCompressionType::NONE, ObCompressionType::LZ4};
+
+  ObCompressionType compression_of_level(size_t level) const
+  {
+    if (compression_per_level.empty()) {
+      return ObCompressionType::NONE;
+    }
+    return compression_per_level[min(level, compression_per_level.size() - 1)];
+  }
+
+  // whether the sstables are read through mmap instead of pread. The uncompressed blocks then
+  // reference the mapped file directly instead of being copied to the heap.
+  bool use_mmap_reads = false;
+
+  // capacity in bytes of the block cache shared by all sstables, 0 disables the cache.
+  size_t block_cache_size = 8 * 1024 * 1024;
 };
 
 // TODO: UNIMPLEMENTED
@@ -46,7 +46,10 @@ public:
    */
   ObLsmTransaction(ObLsm *db, uint64_t ts);
 
-  ~ObLsmTransaction() = default;
+  /**
+   * @brief Destructor, releases the snapshot of the transaction.
+   */
+  ~ObLsmTransaction();
 
   /*
    * @brief Retrieves the value associated with a given key.
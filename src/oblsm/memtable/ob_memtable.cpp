@@ -41,7 +41,27 @@ void ObMemTable::put(uint64_t seq, const string_view &key, const string_view &va
   memcpy(p, &val_size, sizeof(size_t));
   p += sizeof(size_t);
   memcpy(p, value.data(), val_size);
-  table_.insert(buf);
+  table_.insert_concurrently(buf);
+}
+
+RC ObMemTable::get(const string_view &lookup_key, string *value)
+{
+  Table::Iterator iter(&table_);
+  iter.seek(lookup_key.data());
+  if (!iter.valid()) {
+    return RC::NOTFOUND;
+  }
+  // the first entry >= lookup key is the newest visible version if its user key matches.
+  string_view internal_key = get_length_prefixed_string(iter.key());
+  if (extract_user_key(internal_key) != extract_user_key_from_lookup_key(lookup_key)) {
+    return RC::NOTFOUND;
+  }
+  string_view val = get_length_prefixed_string(internal_key.data() + internal_key.size());
+  if (val.empty()) {
+    return RC::NOT_EXIST;
+  }
+  value->assign(val.data(), val.size());
+  return RC::SUCCESS;
 }
 
 int ObMemTable::KeyComparator::operator()(const char *a, const char *b) const
@@ -54,6 +54,8 @@ public:
    * Each entry is versioned using the provided `seq` number. If the same key is
    * inserted multiple times, the version with the highest sequence number will
    * take precedence when queried.
+   * It is safe to call `put` from multiple threads concurrently, the arena and
+   * the skiplist insert are both lock-free.
    *
    * @param seq A sequence number used for versioning the key-value entry.
    * @param key The key to be inserted.
@@ -61,6 +63,16 @@ public:
    */
   void put(uint64_t seq, const string_view &key, const string_view &value);
 
+  /**
+   * @brief Looks up the newest version of a key which is visible to the sequence in the lookup key.
+   *
+   * @param lookup_key The lookup key (see `extract_user_key_from_lookup_key`).
+   * @param value The value of the key if it is found.
+   * @return `RC::SUCCESS` if a value is found, `RC::NOT_EXIST` if the key is deleted,
+   * `RC::NOTFOUND` if the memtable has no visible version of the key.
+   */
+  RC get(const string_view &lookup_key, string *value);
+
   /**
    * @brief Estimates the memory usage of the memtable.
    *
@@ -17,7 +17,10 @@ See the Mulan PSL v2 for more details. */
 // Thread safety
 // -------------
 //
-// Writes require external synchronization, most likely a mutex.
+// insert() requires external synchronization, most likely a mutex.
+// insert_concurrently() may be called by multiple writers at the same
+// time, every link is published with a CAS, so it doesn't need any
+// external synchronization (but must not be mixed with insert()).
 // Reads require a guarantee that the ObSkipList will not be destroyed
 // while the read is in progress. Apart from that, reads progress
 // without any internal locking or synchronization.
@@ -65,6 +68,12 @@ public:
    */
   void insert(const Key &key);
 
+  /**
+   * @brief Insert key into the list, it is safe to be called by multiple writers concurrently.
+   * @details Each level is linked with a CAS on the predecessor's next pointer, and the splice
+   * of a level is recomputed from the predecessor if the CAS fails because of a racing writer.
+   * REQUIRES: nothing that compares equal to key is currently in the list
+   */
   void insert_concurrently(const Key &key);
 
   /**
@@ -143,6 +152,9 @@ private:
   int   random_height();
   bool  equal(const Key &a, const Key &b) const { return (compare_(a, b) == 0); }
 
+  // Return true if key is greater than the data stored in "n"
+  bool key_is_after_node(const Key &key, Node *n) const { return (n != nullptr) && (compare_(n->key, key) < 0); }
+
   // Return the earliest node that comes at or after key.
   // Return nullptr if there is no such node.
   //
@@ -150,6 +162,10 @@ private:
   // node at "level" for every level in [0..max_height_-1].
   Node *find_greater_or_equal(const Key &key, Node **prev) const;
 
+  // Starting at "before", walk forward on "level" and return the pair of nodes
+  // that key should be linked between: *out_prev < key <= *out_next.
+  void find_splice_for_level(const Key &key, Node *before, int level, Node **out_prev, Node **out_next) const;
+
   // Return the latest node with a key < key.
   // Return head_ if there is no such node.
   Node *find_less_than(const Key &key) const;
@@ -163,15 +179,16 @@ private:
 
   Node *const head_;
 
-  // Modified only by insert().  Read racily by readers, but stale
-  // values are ok.
+  // Modified only by insert() and insert_concurrently().  Read racily by
+  // readers, but stale values are ok.
   atomic<int> max_height_;  // Height of the entire list
 
-  static common::RandomGenerator rnd;
+  // thread local, so concurrent writers don't race on the generator state.
+  static thread_local common::RandomGenerator rnd;
 };
 
 template <typename Key, class ObComparator>
-common::RandomGenerator ObSkipList<Key, ObComparator>::rnd = common::RandomGenerator();
+thread_local common::RandomGenerator ObSkipList<Key, ObComparator>::rnd = common::RandomGenerator();
 
 // Implementation details follow
 template <typename Key, class ObComparator>
@@ -306,8 +323,41 @@ template <typename Key, class ObComparator>
 typename ObSkipList<Key, ObComparator>::Node *ObSkipList<Key, ObComparator>::find_greater_or_equal(
     const Key &key, Node **prev) const
 {
-  // your code here
-  return nullptr;
+  Node *x     = head_;
+  int   level = get_max_height() - 1;
+  while (true) {
+    Node *next = x->next(level);
+    if (key_is_after_node(key, next)) {
+      // Keep searching in this list
+      x = next;
+    } else {
+      if (prev != nullptr) {
+        prev[level] = x;
+      }
+      if (level == 0) {
+        return next;
+      } else {
+        // Switch to next list
+        level--;
+      }
+    }
+  }
+}
+
+template <typename Key, class ObComparator>
+void ObSkipList<Key, ObComparator>::find_splice_for_level(
+    const Key &key, Node *before, int level, Node **out_prev, Node **out_next) const
+{
+  while (true) {
+    Node *next = before->next(level);
+    if (key_is_after_node(key, next)) {
+      before = next;
+    } else {
+      *out_prev = before;
+      *out_next = next;
+      return;
+    }
+  }
 }
 
 template <typename Key, class ObComparator>
@@ -376,12 +426,75 @@ ObSkipList<Key, ObComparator>::~ObSkipList()
 
 template <typename Key, class ObComparator>
 void ObSkipList<Key, ObComparator>::insert(const Key &key)
-{}
+{
+  Node *prev[kMaxHeight];
+  Node *x = find_greater_or_equal(key, prev);
+
+  // Our data structure does not allow duplicate insertion
+  ASSERT(x == nullptr || !equal(key, x->key), "duplicate key inserted into skiplist");
+
+  int height = random_height();
+  if (height > get_max_height()) {
+    for (int i = get_max_height(); i < height; i++) {
+      prev[i] = head_;
+    }
+    // It is ok to mutate max_height_ without any synchronization
+    // with concurrent readers.  A concurrent reader that observes
+    // the new value of max_height_ will see either the old value of
+    // new level pointers from head_ (nullptr), or a new value set in
+    // the loop below.  In the former case the reader will
+    // immediately drop to the next level since nullptr sorts after all
+    // keys.  In the latter case the reader will use the new node.
+    max_height_.store(height, std::memory_order_relaxed);
+  }
+
+  x = new_node(key, height);
+  for (int i = 0; i < height; i++) {
+    // nobarrier_set_next() suffices since we will add a barrier when
+    // we publish a pointer to "x" in prev[i].
+    x->nobarrier_set_next(i, prev[i]->nobarrier_next(i));
+    prev[i]->set_next(i, x);
+  }
+}
 
 template <typename Key, class ObComparator>
 void ObSkipList<Key, ObComparator>::insert_concurrently(const Key &key)
 {
-  // your code here
+  int   height = random_height();
+  Node *x      = new_node(key, height);
+
+  // Raise max_height_ first, so the splice computed below covers every level of the new node.
+  // Readers that observe the new height before the node is linked just drop down from head_.
+  int max_height = get_max_height();
+  while (height > max_height) {
+    if (max_height_.compare_exchange_weak(max_height, height)) {
+      max_height = height;
+      break;
+    }
+  }
+
+  Node *prev[kMaxHeight];
+  Node *next[kMaxHeight];
+  Node *before = head_;
+  for (int level = max_height - 1; level >= 0; level--) {
+    find_splice_for_level(key, before, level, &prev[level], &next[level]);
+    before = prev[level];
+  }
+
+  ASSERT(next[0] == nullptr || !equal(key, next[0]->key), "duplicate key inserted into skiplist");
+
+  // Link the node bottom-up, a node reachable from level i is always reachable from level 0.
+  for (int i = 0; i < height; i++) {
+    while (true) {
+      x->nobarrier_set_next(i, next[i]);
+      if (prev[i]->cas_next(i, next[i], x)) {
+        break;
+      }
+      // Another writer linked a node between prev[i] and next[i], recompute the splice of this level.
+      // prev[i] is still before key, so it is a valid place to restart the search.
+      find_splice_for_level(key, prev[i], i, &prev[i], &next[i]);
+    }
+  }
 }
 
 template <typename Key, class ObComparator>
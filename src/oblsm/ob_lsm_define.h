@@ -9,6 +9,9 @@ MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
 See the Mulan PSL v2 for more details. */
 
 #pragma once
+
+#include <stdint.h>
+
 namespace oceanbase {
 
 static constexpr const char *SSTABLE_SUFFIX  = ".sst";
@@ -26,4 +29,14 @@ enum class CompactionType
   UNKNOWN,
 };
 
+/**
+ * @enum ObCompressionType
+ * @brief The codecs of SSTable data blocks, the values are persisted in the block metas.
+ */
+enum class ObCompressionType : uint8_t
+{
+  NONE = 0,
+  LZ4  = 1,
+};
+
 }  // namespace oceanbase
\ No newline at end of file
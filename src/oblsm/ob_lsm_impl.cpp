@@ -10,6 +10,12 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/ob_lsm_impl.h"
 
+#include "common/lang/algorithm.h"
+#include "common/lang/chrono.h"
+#include "common/lang/limits.h"
+#include "common/lang/system_error.h"
+#include "common/lang/thread.h"
+#include "common/lang/unordered_set.h"
 #include "common/log/log.h"
 #include "common/sys/rc.h"
 #include "oblsm/include/ob_lsm.h"
@@ -35,9 +41,17 @@ ObLsmImpl::ObLsmImpl(const ObLsmOptions &options, const string &path)
     sstables_->resize(options_.default_levels);
   }
 
-  executor_.init("ObLsmBackground", 1, 1, 60 * 1000);
-  block_cache_ =
-      std::unique_ptr<ObLRUCache<uint64_t, shared_ptr<ObBlock>>>{new ObLRUCache<uint64_t, shared_ptr<ObBlock>>(1024)};
+  picker_.reset(ObCompactionPicker::create(options_.type, &options_));
+  install_version();
+
+  // one thread flushes the immutable memtable, the other one runs the compaction.
+  executor_.init("ObLsmBackground", 2, 2, 60 * 1000);
+  int compaction_threads = static_cast<int>(max<size_t>(1, options_.compaction_threads));
+  compaction_executor_.init("ObLsmCompaction", compaction_threads, compaction_threads, 60 * 1000);
+  rate_limiter_ = make_unique<ObRateLimiter>(options_.background_write_rate);
+  // the capacity of the block cache is charged by the memory size of blocks.
+  block_cache_ = std::unique_ptr<ObLRUCache<uint64_t, shared_ptr<ObBlock>>>{
+      new ObLRUCache<uint64_t, shared_ptr<ObBlock>>(options_.block_cache_size)};
 }
 
 RC ObLsmImpl::recover()
@@ -61,8 +75,9 @@ RC ObLsmImpl::recover()
   }
 
   // Recover Oblsm's state from snapshot.
+  std::vector<std::vector<uint64_t>> sstable_ids(options_.default_levels);
   if (snapshot_record) {
-    rc = load_manifest_snapshot(*snapshot_record);
+    rc = load_manifest_snapshot(*snapshot_record, sstable_ids);
     if (rc != RC::SUCCESS) {
       LOG_ERROR("Failed to load manifest snapshot, rc=%s", strrc(rc));
       return rc;
@@ -70,14 +85,31 @@ RC ObLsmImpl::recover()
   }
 
   // Recover ObLsm's state from compaction records.
-  rc = recover_from_manifest_records(compaction_records);
+  rc = recover_from_manifest_records(compaction_records, sstable_ids);
   if (rc != RC::SUCCESS) {
     LOG_ERROR("Failed to recover from manifest compaction records, rc=%s", strrc(rc));
     return rc;
   }
 
+  rc = load_manifest_sstable(sstable_ids);
+  if (rc != RC::SUCCESS) {
+    LOG_ERROR("Failed to load sstables, rc=%s", strrc(rc));
+    return rc;
+  }
+  remove_obsolete_files();
+
   // Recover memtable from WAL file.
-  wal_ = std::make_unique<WAL>();
+  wal_ = std::make_shared<WAL>();
+  rc   = wal_->open(get_wal_path(memtable_id_.load()));
+  if (rc != RC::SUCCESS) {
+    LOG_ERROR("Failed to open wal file, rc=%s", strrc(rc));
+    return rc;
+  }
+
+  {
+    lock_guard<mutex> guard(mu_);
+    install_version();
+  }
 
   // After recover from the old manifest file, write the snapshot into a new manifest file.
   if (!compaction_records.empty()) {
@@ -102,61 +134,143 @@ RC ObLsm::open(const ObLsmOptions &options, const string &path, ObLsm **dbptr)
 
 RC ObLsmImpl::put(const string_view &key, const string_view &value)
 {
-  // TODO: if put rate is too high, slow down writes is needed.
-  // currently, the writes is stopped when the memtable is full.
   LOG_TRACE("begin to put key=%s, value=%s", key.data(), value.data());
-  RC rc = RC::SUCCESS;
-  // TODO: currenttly the memtable use skiplist as the underlying data structure,
-  // and the skiplist concurently write is not thread safe, so we use mutex here,
-  // if the skiplist support `insert_concurrently()` interface, can we remove the mutex?
-  unique_lock<mutex> lock(mu_);
-  uint64_t           seq = seq_.fetch_add(1);
-  // Write WAL
-  rc = wal_->put(seq, key, value);
-  if (rc != RC::SUCCESS) {
-    return rc;
+  maybe_stall_write();
+  RC     rc       = RC::SUCCESS;
+  size_t mem_size = 0;
+  {
+    // Writers only share `mem_lock_`, so the WAL append and the skiplist insert of different
+    // writers run in parallel (the memtable is lock-free and the WAL group-commits concurrent
+    // appends). Holding it guarantees the memtable and WAL can't be switched under us.
+    shared_lock<shared_mutex> mem_guard(mem_lock_);
+    uint64_t                  seq = seq_.fetch_add(1);
+    // Write WAL
+    rc = wal_->put(seq, key, value, options_.force_sync_new_log);
+    if (rc != RC::SUCCESS) {
+      LOG_ERROR("Failed to write wal logs, rc=%s", strrc(rc));
+      return rc;
+    }
+    // write memtable
+    mem_table_->put(seq, key, value);
+    mem_size = mem_table_->appro_memory_usage();
   }
 
-  if (options_.force_sync_new_log) {
-    rc = wal_->sync();
+  return maybe_freeze_memtable(mem_size);
+}
+
+RC ObLsmImpl::batch_put(const vector<pair<string, string>> &kvs)
+{
+  if (kvs.empty()) {
+    return RC::SUCCESS;
+  }
+  maybe_stall_write();
+  size_t mem_size = 0;
+  {
+    shared_lock<shared_mutex> mem_guard(mem_lock_);
+    // reserve a continuous range of sequences, the whole batch is logged by one WAL append (and one sync).
+    uint64_t first_seq = seq_.fetch_add(kvs.size());
+    RC       rc        = wal_->batch_put(first_seq, kvs, options_.force_sync_new_log);
     if (rc != RC::SUCCESS) {
-      LOG_ERROR("Failed to sync wal logs, rc=%s", strrc(rc));
+      LOG_ERROR("Failed to write wal logs, rc=%s", strrc(rc));
       return rc;
     }
+    for (size_t i = 0; i < kvs.size(); i++) {
+      mem_table_->put(first_seq + i, kvs[i].first, kvs[i].second);
+    }
+    mem_size = mem_table_->appro_memory_usage();
   }
-  // write memtable
-  mem_table_->put(seq, key, value);
-  size_t mem_size = mem_table_->appro_memory_usage();
+
+  return maybe_freeze_memtable(mem_size);
+}
+
+RC ObLsmImpl::maybe_freeze_memtable(size_t mem_size)
+{
+  RC rc = RC::SUCCESS;
   if (mem_size > options_.memtable_size) {
+    unique_lock<mutex> lock(mu_);
     // Thinking point: here vector is used to store imems,
     // but only one imem is stored at most. Is it possible
     // to store more than one imem and what are the implications
     // of storing more than one imem.
-    if (imem_tables_.size() >= 1) {
-      cv_.wait(lock);
+    if (!imem_tables_.empty()) {
+      memtable_stop_count_.fetch_add(1);
+      auto start = chrono::steady_clock::now();
+      cv_.wait(lock, [this]() { return imem_tables_.empty(); });
+      stall_micros_.fetch_add(
+          chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
     }
     // check again after get lock(maybe freeze memtable by another thread)
     if (mem_table_->appro_memory_usage() > options_.memtable_size) {
-      manifest_.latest_seq = seq;
-      try_freeze_memtable();
-    } else {
-      // if there are multi put threads waiting here, need to notify one thread to
-      // continue to write to memtable.
-      cv_.notify_one();
+      rc = try_freeze_memtable();
     }
   }
   return rc;
 }
 
-RC ObLsmImpl::batch_put(const vector<pair<string, string>> &kvs) { return RC::UNIMPLEMENTED; }
+void ObLsmImpl::maybe_stall_write()
+{
+  auto l0_reached = [this](size_t trigger) { return trigger > 0 && l0_file_count_.load() >= trigger; };
+  auto pending_bytes_reached = [this](size_t limit) {
+    return limit > 0 && pending_compaction_bytes_.load() >= limit;
+  };
+
+  auto start = chrono::steady_clock::now();
+  if (l0_reached(options_.l0_stop_writes_trigger) || pending_bytes_reached(options_.hard_pending_compaction_bytes_limit)) {
+    // the triggers are reached only if there is something to compact, make sure it is going to be compacted.
+    maybe_schedule_compaction();
+    unique_lock<mutex> lock(mu_);
+    auto               should_stop = [&]() {
+      return l0_reached(options_.l0_stop_writes_trigger) ||
+             pending_bytes_reached(options_.hard_pending_compaction_bytes_limit);
+    };
+    if (!should_stop()) {
+      return;
+    }
+    if (l0_reached(options_.l0_stop_writes_trigger)) {
+      l0_stop_count_.fetch_add(1);
+    } else {
+      pending_bytes_stop_count_.fetch_add(1);
+    }
+    LOG_DEBUG("stop writes. l0 files=%lu, pending compaction bytes=%lu",
+        l0_file_count_.load(), pending_compaction_bytes_.load());
+    // the compaction notifies `cv_` after installing its result.
+    cv_.wait(lock, [&]() { return !should_stop(); });
+  } else if (l0_reached(options_.l0_slowdown_writes_trigger)) {
+    l0_slowdown_count_.fetch_add(1);
+    std::this_thread::sleep_for(chrono::microseconds(options_.slowdown_write_micros));
+  } else if (pending_bytes_reached(options_.soft_pending_compaction_bytes_limit)) {
+    pending_bytes_slowdown_count_.fetch_add(1);
+    std::this_thread::sleep_for(chrono::microseconds(options_.slowdown_write_micros));
+  } else {
+    return;
+  }
+  stall_micros_.fetch_add(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count());
+}
+
+ObLsmWriteStallStats ObLsmImpl::write_stall_stats() const
+{
+  ObLsmWriteStallStats stats;
+  stats.stall_micros                 = stall_micros_.load();
+  stats.l0_slowdown_count            = l0_slowdown_count_.load();
+  stats.l0_stop_count                = l0_stop_count_.load();
+  stats.pending_bytes_slowdown_count = pending_bytes_slowdown_count_.load();
+  stats.pending_bytes_stop_count     = pending_bytes_stop_count_.load();
+  stats.memtable_stop_count          = memtable_stop_count_.load();
+  return stats;
+}
 
 RC ObLsmImpl::remove(const string_view &key) { return RC::UNIMPLEMENTED; }
 
 RC ObLsmImpl::try_freeze_memtable()
 {
   RC rc = RC::SUCCESS;
+  // wait for the in-flight writers of the current memtable, and block new ones until switched.
+  unique_lock<shared_mutex> mem_guard(mem_lock_);
+  // every writer which got a sequence has inserted it into the memtable being frozen, so the
+  // flushed sstable never holds a sequence beyond the persisted one.
+  manifest_.latest_seq = seq_.load();
   imem_tables_.emplace_back(mem_table_);
-  mem_table_ = make_unique<ObMemTable>();
+  mem_table_ = make_shared<ObMemTable>();
   // frozen previous wal
   if (!options_.force_sync_new_log) {
     rc = wal_->sync();
@@ -167,9 +281,16 @@ RC ObLsmImpl::try_freeze_memtable()
   }
 
   frozen_wals_.emplace_back(std::move(wal_));
-  wal_                     = std::make_unique<WAL>();
+  wal_                     = std::make_shared<WAL>();
   uint64_t new_memtable_id = memtable_id_.fetch_add(1) + 1;
-  wal_->open(get_wal_path(new_memtable_id));
+  rc                       = wal_->open(get_wal_path(new_memtable_id));
+  if (rc != RC::SUCCESS) {
+    LOG_ERROR("Failed to open wal file, rc=%s", strrc(rc));
+    return rc;
+  }
+  install_version();
+  mem_guard.unlock();
+
   std::shared_ptr<ObLsmBgCompactCtx> background_compaction_ctx = make_shared<ObLsmBgCompactCtx>(new_memtable_id);
   auto bg_task = [this, background_compaction_ctx]() { this->background_compaction(background_compaction_ctx); };
   int  ret     = executor_.execute(bg_task);
@@ -191,98 +312,354 @@ void ObLsmImpl::background_compaction(std::shared_ptr<ObLsmBgCompactCtx> ctx)
     build_sstable(imem);
     imem_tables_.pop_back();
     frozen_wals_.pop_back();
+    install_version();
     manifest_.push(ObManifestNewMemtable{ctx->new_memtable_id});
 
     ::remove(frozen_wal->filename().c_str());
 
     lock.unlock();
-    cv_.notify_one();
+    // several writers may be waiting for the immutable memtable to be flushed.
+    cv_.notify_all();
 
     // TODO: trig compaction at more scenarios, for example,
     // seek compaction in
     // leveldb(https://github.com/google/leveldb/blob/578eeb702ec0fbb6b9780f3d4147b1076630d633/db/version_set.cc#L650).
-    if (!compacting_) {
-      compacting_.store(true);
-      try_major_compaction();
-      compacting_.store(false);
-    }
+    maybe_schedule_compaction();
     return;
   }
 }
 
-void ObLsmImpl::try_major_compaction()
+void ObLsmImpl::maybe_schedule_compaction()
 {
-  unique_lock<mutex>             lock(mu_);
-  unique_ptr<ObCompactionPicker> picker(ObCompactionPicker::create(options_.type, &options_));
-  unique_ptr<ObCompaction>       picked = picker->pick(sstables_);
-  ObManifestCompaction           mf_record;
-  lock.unlock();
-  if (picked == nullptr || picked->size() == 0) {
+  lock_guard<mutex> guard(mu_);
+  if (picker_ == nullptr || compaction_scheduled_) {
     return;
   }
-  vector<shared_ptr<ObSSTable>> results = do_compaction(picked.get());
+  compaction_scheduled_ = true;
+  if (executor_.execute([this]() { try_major_compaction(); }) != 0) {
+    compaction_scheduled_ = false;
+    LOG_WARN("fail to execute background compaction task");
+  }
+}
 
-  SSTablesPtr new_sstables = make_shared<vector<vector<shared_ptr<ObSSTable>>>>();
-  lock.lock();
-  size_t levels_size        = sstables_->size();
-  bool   insert_new_sstable = false;
-  auto   find_sstable       = [](const vector<shared_ptr<ObSSTable>> &picked, const shared_ptr<ObSSTable> &sstable) {
-    for (auto &p : picked) {
-      if (p->sst_id() == sstable->sst_id()) {
-        return true;
-      }
+void ObLsmImpl::try_major_compaction()
+{
+  // the task is done once nothing is picked, `compaction_scheduled_` is reset in the same critical
+  // section, so a flush after it will schedule a new task.
+  auto finish = [this](unique_lock<mutex> &lock) {
+    if (!lock.owns_lock()) {
+      lock.lock();
     }
-    return false;
+    compaction_scheduled_ = false;
+    lock.unlock();
+    // wake up the writers stopped by the compaction.
+    cv_.notify_all();
   };
 
-  vector<shared_ptr<ObSSTable>> picked_sstables;
-  picked_sstables      = picked->inputs(0);
-  const auto &level_i1 = picked->inputs(1);
-  if (level_i1.size() > 0) {
+  while (true) {
+    unique_lock<mutex> lock(mu_);
+    if (picker_ == nullptr) {
+      return finish(lock);
+    }
+    unique_ptr<ObCompaction> picked = picker_->pick(sstables_);
+    if (picked == nullptr || picked->size() == 0) {
+      return finish(lock);
+    }
+
+    vector<shared_ptr<ObSSTable>> picked_sstables = picked->inputs(0);
+    const auto                   &level_i1        = picked->inputs(1);
     picked_sstables.insert(picked_sstables.end(), level_i1.begin(), level_i1.end());
-  }
-  // TODO: unify the new sstables logic in all compaction type
-  if (options_.type == CompactionType::TIRED) {
-    for (int i = levels_size - 1; i >= 0; --i) {
-      const vector<shared_ptr<ObSSTable>> &level_i = sstables_->at(i);
-      for (auto &sstable : level_i) {
-        if (find_sstable(picked_sstables, sstable)) {
-          if (!insert_new_sstable) {
-            new_sstables->insert(new_sstables->begin(), results);
-            insert_new_sstable = true;
+
+    const bool                    trivial_move = options_.type == CompactionType::LEVELED && picked->is_trivial_move();
+    vector<shared_ptr<ObSSTable>> results;
+    if (trivial_move) {
+      results = picked->inputs(0);
+    } else {
+      // deleted keys can be dropped if no deeper level may contain them.
+      bool drop_deletions = true;
+      if (options_.type == CompactionType::LEVELED) {
+        for (size_t i = picked->level() + 2; i < sstables_->size(); ++i) {
+          drop_deletions = drop_deletions && sstables_->at(i).empty();
+        }
+      }
+      const uint64_t smallest_snapshot = snapshots_.empty() ? seq_.load() : *snapshots_.begin();
+      lock.unlock();
+      RC rc = do_compaction(picked.get(), drop_deletions, smallest_snapshot, results);
+      if (OB_FAIL(rc)) {
+        LOG_WARN("Failed to do compaction, rc=%s", strrc(rc));
+        for (auto &sstable : results) {
+          sstable->mark_obsolete();
+        }
+        return finish(lock);
+      }
+      lock.lock();
+    }
+
+    ObManifestCompaction mf_record;
+    mf_record.compaction_type = options_.type;
+    SSTablesPtr new_sstables  = make_shared<vector<vector<shared_ptr<ObSSTable>>>>();
+    auto        find_sstable  = [](const vector<shared_ptr<ObSSTable>> &picked, const shared_ptr<ObSSTable> &sstable) {
+      for (auto &p : picked) {
+        if (p->sst_id() == sstable->sst_id()) {
+          return true;
+        }
+      }
+      return false;
+    };
+
+    // TODO: unify the new sstables logic in all compaction type
+    if (options_.type == CompactionType::TIRED) {
+      size_t levels_size        = sstables_->size();
+      bool   insert_new_sstable = false;
+      for (int i = levels_size - 1; i >= 0; --i) {
+        const vector<shared_ptr<ObSSTable>> &level_i = sstables_->at(i);
+        for (auto &sstable : level_i) {
+          if (find_sstable(picked_sstables, sstable)) {
+            if (!insert_new_sstable) {
+              new_sstables->insert(new_sstables->begin(), results);
+              insert_new_sstable = true;
+            }
+          } else {
+            new_sstables->insert(new_sstables->begin(), level_i);
+            break;
           }
-        } else {
-          new_sstables->insert(new_sstables->begin(), level_i);
-          break;
         }
       }
+    } else if (options_.type == CompactionType::LEVELED) {
+      // copy on write, level 0 may have got new sstables during the compaction.
+      *new_sstables   = *sstables_;
+      const int level = picked->level();
+      for (int which = 0; which < 2; ++which) {
+        vector<shared_ptr<ObSSTable>> &level_tables = new_sstables->at(level + which);
+        for (const auto &sstable : picked->inputs(which)) {
+          mf_record.deleted_tables.emplace_back(sstable->sst_id(), level + which);
+        }
+        level_tables.erase(remove_if(level_tables.begin(),
+                               level_tables.end(),
+                               [&](const shared_ptr<ObSSTable> &sstable) {
+                                 return find_sstable(picked->inputs(which), sstable);
+                               }),
+            level_tables.end());
+      }
+
+      vector<shared_ptr<ObSSTable>> &output_level = new_sstables->at(level + 1);
+      for (const auto &sstable : results) {
+        mf_record.added_tables.emplace_back(sstable->sst_id(), level + 1);
+        output_level.emplace_back(sstable);
+      }
+      sort(output_level.begin(), output_level.end(), [this](const shared_ptr<ObSSTable> &a, const shared_ptr<ObSSTable> &b) {
+        return internal_key_comparator_.compare(a->first_key(), b->first_key()) < 0;
+      });
+    }
+
+    // the manifest must be updated before the inputs are removed.
+    mf_record.sstable_sequence_id = sstable_id_.load();
+    mf_record.seq_id              = manifest_.latest_seq;
+    RC rc                         = manifest_.push(mf_record);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("Failed to push compaction record into manifest, rc=%s", strrc(rc));
+      for (auto &sstable : results) {
+        sstable->mark_obsolete();
+      }
+      return finish(lock);
+    }
+
+    sstables_ = new_sstables;
+    install_version();
+    lock.unlock();
+    cv_.notify_all();
+
+    LOG_INFO("compaction done. level=%d, inputs=%lu, outputs=%lu, trivial_move=%d",
+        picked->level(), picked_sstables.size(), results.size(), trivial_move);
+    if (!trivial_move) {
+      // the files are removed once the readers of the old versions are done.
+      for (auto &sstable : picked_sstables) {
+        sstable->mark_obsolete();
+      }
     }
-  } else if (options_.type == CompactionType::LEVELED) {
-    // TODO: apply the compaction results to sstable
   }
+}
 
-  sstables_ = new_sstables;
-  lock.unlock();
+RC ObLsmImpl::do_compaction(
+    ObCompaction *picked, bool drop_deletions, uint64_t smallest_snapshot, vector<shared_ptr<ObSSTable>> &results)
+{
+  // split the key range of the inputs by the first keys of their blocks,
+  // so the subcompactions get about the same number of blocks.
+  size_t         total_size = 0;
+  vector<string> block_keys;
+  for (int which = 0; which < 2; ++which) {
+    for (const auto &sstable : picked->inputs(which)) {
+      total_size += sstable->size();
+      for (uint32_t i = 0; i < sstable->block_count(); ++i) {
+        block_keys.emplace_back(extract_user_key(sstable->block_meta(i).first_key_));
+      }
+    }
+  }
+  sort(block_keys.begin(), block_keys.end(), [this](const string &a, const string &b) {
+    return default_comparator_.compare(a, b) < 0;
+  });
 
-  // remove from disk
-  for (auto &sstable : picked_sstables) {
-    sstable->remove();
+  size_t subcompaction_num = max<size_t>(1, options_.compaction_threads);
+  if (options_.table_size > 0) {
+    subcompaction_num = min(subcompaction_num, max<size_t>(1, total_size / options_.table_size));
+  }
+  // nothing to split by if the inputs have no blocks, run a single subcompaction.
+  if (block_keys.empty()) {
+    subcompaction_num = 1;
+  }
+  vector<string> boundaries;
+  for (size_t i = 1; i < subcompaction_num; ++i) {
+    const string &key = block_keys[i * block_keys.size() / subcompaction_num];
+    // the first key can't be a boundary, otherwise the first range is empty.
+    if (default_comparator_.compare(key, block_keys.front()) > 0 &&
+        (boundaries.empty() || default_comparator_.compare(key, boundaries.back()) > 0)) {
+      boundaries.emplace_back(key);
+    }
   }
 
-  mf_record.sstable_sequence_id = sstable_id_.load();
-  mf_record.seq_id              = manifest_.latest_seq;
-  manifest_.push(std::move(mf_record));
-  try_major_compaction();
+  const size_t                          range_num = boundaries.size() + 1;
+  vector<vector<shared_ptr<ObSSTable>>> outputs(range_num);
+  vector<RC>                            rcs(range_num, RC::SUCCESS);
+  mutex                                 done_mutex;
+  condition_variable                    done_cv;
+  size_t                                running = range_num;
+  for (size_t i = 0; i < range_num; ++i) {
+    const string *begin = i == 0 ? nullptr : &boundaries[i - 1];
+    const string *end   = i + 1 == range_num ? nullptr : &boundaries[i];
+    auto          task  = [&, i, begin, end]() {
+      rcs[i] = do_subcompaction(picked, begin, end, drop_deletions, smallest_snapshot, outputs[i]);
+      lock_guard<mutex> guard(done_mutex);
+      if (--running == 0) {
+        done_cv.notify_all();
+      }
+    };
+    if (compaction_executor_.execute(task) != 0) {
+      LOG_WARN("fail to execute subcompaction task, run it in the current thread");
+      task();
+    }
+  }
+  {
+    unique_lock<mutex> lock(done_mutex);
+    done_cv.wait(lock, [&running]() { return running == 0; });
+  }
+
+  RC rc = RC::SUCCESS;
+  for (size_t i = 0; i < range_num; ++i) {
+    results.insert(results.end(), outputs[i].begin(), outputs[i].end());
+    if (OB_FAIL(rcs[i])) {
+      rc = rcs[i];
+    }
+  }
+  LOG_DEBUG("compaction of level %d is split into %lu subcompactions", picked->level(), range_num);
+  return rc;
 }
 
-vector<shared_ptr<ObSSTable>> ObLsmImpl::do_compaction(ObCompaction *picked) { return {}; }
+RC ObLsmImpl::do_subcompaction(ObCompaction *picked, const string *begin, const string *end, bool drop_deletions,
+    uint64_t smallest_snapshot, vector<shared_ptr<ObSSTable>> &results)
+{
+  vector<unique_ptr<ObLsmIterator>> iters;
+  for (int which = 0; which < 2; ++which) {
+    for (const auto &sstable : picked->inputs(which)) {
+      if (sstable->block_count() > 0) {
+        sstable->advise_sequential_reads();
+        iters.emplace_back(sstable->new_iterator());
+      }
+    }
+  }
+  unique_ptr<ObLsmIterator> iter(new_merging_iterator(&internal_key_comparator_, std::move(iters)));
+  if (begin == nullptr) {
+    iter->seek_to_first();
+  } else {
+    // the newest version of `begin` is the first one
+    string lookup_key;
+    put_numeric<uint64_t>(&lookup_key, begin->size() + SEQ_SIZE);
+    lookup_key.append(*begin);
+    put_numeric<uint64_t>(&lookup_key, numeric_limits<uint64_t>::max());
+    iter->seek(lookup_key);
+  }
+
+  RC                           rc = RC::SUCCESS;
+  unique_ptr<ObSSTableBuilder> builder;
+  string                       last_user_key;
+  bool                         has_last_user_key = false;
+  // the sequence of the newer version of the current user key, the max value if there is none.
+  uint64_t                     last_sequence_for_key = numeric_limits<uint64_t>::max();
+  auto                         finish_table      = [&]() {
+    RC rc = builder->finish();
+    if (OB_SUCC(rc)) {
+      results.emplace_back(builder->get_built_table());
+    }
+    builder.reset();
+    return rc;
+  };
+
+  for (; iter->valid(); iter->next()) {
+    string_view user_key = extract_user_key(iter->key());
+    if (end != nullptr && default_comparator_.compare(user_key, *end) >= 0) {
+      break;
+    }
+    const bool new_user_key = !has_last_user_key || default_comparator_.compare(user_key, last_user_key) != 0;
+    if (new_user_key) {
+      last_user_key.assign(user_key.data(), user_key.size());
+      has_last_user_key     = true;
+      last_sequence_for_key = numeric_limits<uint64_t>::max();
+    }
+    // the versions come from the newest to the oldest. if a newer version is visible to all the
+    // snapshots, no one can read this version any more.
+    const uint64_t sequence = extract_sequence(iter->key());
+    const bool     hidden   = last_sequence_for_key <= smallest_snapshot;
+    last_sequence_for_key   = sequence;
+    if (hidden) {
+      continue;
+    }
+    // a tombstone visible to all the snapshots hides nothing if no deeper level may contain the key.
+    if (drop_deletions && iter->value().empty() && sequence <= smallest_snapshot) {
+      continue;
+    }
+
+    // an output table is only cut between two user keys, all the versions of a user key kept for
+    // the snapshots stay in one table, so a later compaction never splits them into different levels.
+    if (builder != nullptr && new_user_key && builder->approximate_size() >= options_.table_size) {
+      rc = finish_table();
+      if (OB_FAIL(rc)) {
+        break;
+      }
+    }
+    if (builder == nullptr) {
+      builder             = make_unique<ObSSTableBuilder>(&default_comparator_, block_cache_.get(), options_);
+      builder->set_rate_limiter(rate_limiter_.get());
+      builder->set_compression(options_.compression_of_level(picked->level() + 1));
+      uint64_t sstable_id = sstable_id_.fetch_add(1);
+      rc                  = builder->open(get_sstable_path(sstable_id), sstable_id);
+      if (OB_FAIL(rc)) {
+        break;
+      }
+    }
+    rc = builder->add(iter->key(), iter->value());
+    if (OB_FAIL(rc)) {
+      break;
+    }
+  }
+  if (OB_SUCC(rc) && builder != nullptr) {
+    rc = finish_table();
+  }
+  if (OB_FAIL(rc)) {
+    LOG_WARN("Failed to build sstable in compaction, rc=%s", strrc(rc));
+  }
+  return rc;
+}
 
 void ObLsmImpl::build_sstable(shared_ptr<ObMemTable> imem)
 {
-  unique_ptr<ObSSTableBuilder> tb = make_unique<ObSSTableBuilder>(&default_comparator_, block_cache_.get());
+  unique_ptr<ObSSTableBuilder> tb = make_unique<ObSSTableBuilder>(&default_comparator_, block_cache_.get(), options_);
+  tb->set_rate_limiter(rate_limiter_.get());
+  tb->set_compression(options_.compression_of_level(0));
 
   uint64_t sstable_id = sstable_id_.fetch_add(1);
-  tb->build(imem, get_sstable_path(sstable_id), sstable_id);
+  RC       rc         = tb->build(imem, get_sstable_path(sstable_id), sstable_id);
+  if (OB_FAIL(rc)) {
+    LOG_ERROR("Failed to build sstable %lu, rc=%s", sstable_id, strrc(rc));
+  }
   // unique_lock<mutex> lock(mu_);
 
   ObManifestCompaction record;
@@ -290,16 +667,19 @@ void ObLsmImpl::build_sstable(shared_ptr<ObMemTable> imem)
   record.sstable_sequence_id = sstable_id_.load();
   record.seq_id              = manifest_.latest_seq;
 
+  // copy on write, the current `sstables_` may be referenced by readers.
+  SSTablesPtr new_sstables = make_shared<vector<vector<shared_ptr<ObSSTable>>>>(*sstables_);
   // TODO: unify the build sstable logic in all compaction type
   if (options_.type == CompactionType::TIRED) {
     // TODO: record the changes for tired compaction
     // here we use `level_i` to store `run_i`
-    sstables_->insert(sstables_->begin(), {tb->get_built_table()});
+    new_sstables->insert(new_sstables->begin(), {tb->get_built_table()});
   } else if (options_.type == CompactionType::LEVELED) {
-    sstables_->at(0).emplace_back(tb->get_built_table());
+    new_sstables->at(0).emplace_back(tb->get_built_table());
     record.added_tables.emplace_back(sstable_id, 0);
     manifest_.push(std::move(record));
   }
+  sstables_ = new_sstables;
 }
 
 string ObLsmImpl::get_sstable_path(uint64_t sstable_id)
@@ -312,52 +692,123 @@ string ObLsmImpl::get_wal_path(uint64_t memtable_id)
   return filesystem::path(path_) / (to_string(memtable_id) + WAL_SUFFIX);
 }
 
+void ObLsmImpl::install_version()
+{
+  auto version      = make_shared<ObLsmVersion>();
+  version->mem      = mem_table_;
+  version->imm      = imem_tables_.empty() ? nullptr : imem_tables_.back();
+  version->sstables = sstables_;
+
+  l0_file_count_.store(options_.type == CompactionType::LEVELED && !sstables_->empty() ? sstables_->at(0).size() : 0);
+  pending_compaction_bytes_.store(picker_ == nullptr ? 0 : picker_->pending_compaction_bytes(sstables_));
+
+  lock_guard<mutex> guard(version_mu_);
+  version_ = std::move(version);
+}
+
+shared_ptr<const ObLsmVersion> ObLsmImpl::current_version()
+{
+  lock_guard<mutex> guard(version_mu_);
+  return version_;
+}
+
 RC ObLsmImpl::get(const string_view &key, string *value)
 {
-  RC                 rc = RC::SUCCESS;
-  unique_lock<mutex> lock(mu_);
-  auto               iter = unique_ptr<ObLsmIterator>(new_iterator(ObLsmReadOptions{}));
-  iter->seek(key);
-  if (iter->valid() && iter->key() == key) {
-    if (iter->value().empty()) {
-      rc = RC::NOT_EXIST;
+  // Probe the sources from the newest to the oldest and stop at the first version of the key:
+  // memtable -> immutable memtable -> level 0 (newest file first) -> one sstable of each level.
+  shared_ptr<const ObLsmVersion> version = current_version();
+
+  string lookup_key;
+  lookup_key.reserve(LOOKUP_KEY_PREFIX_SIZE + key.size() + SEQ_SIZE);
+  put_numeric<uint64_t>(&lookup_key, key.size() + SEQ_SIZE);
+  lookup_key.append(key.data(), key.size());
+  put_numeric<uint64_t>(&lookup_key, seq_.load());
+
+  RC rc = version->mem->get(lookup_key, value);
+  if (rc != RC::NOTFOUND) {
+    return rc;
+  }
+  if (version->imm != nullptr) {
+    rc = version->imm->get(lookup_key, value);
+    if (rc != RC::NOTFOUND) {
+      return rc;
+    }
+  }
+
+  // -1: key < range of sst, 0: key in range, 1: key > range
+  auto compare_range = [this, &key](const shared_ptr<ObSSTable> &sst) {
+    if (sst->block_count() == 0 || default_comparator_.compare(key, extract_user_key(sst->first_key())) < 0) {
+      return -1;
+    }
+    return default_comparator_.compare(key, extract_user_key(sst->last_key())) > 0 ? 1 : 0;
+  };
+
+  const vector<vector<shared_ptr<ObSSTable>>> &levels = *version->sstables;
+  for (size_t i = 0; i < levels.size(); i++) {
+    const vector<shared_ptr<ObSSTable>> &level = levels[i];
+    if (i == 0 && options_.type == CompactionType::LEVELED) {
+      // files of level 0 may overlap, the newer one is appended later.
+      for (auto iter = level.rbegin(); iter != level.rend(); ++iter) {
+        if (compare_range(*iter) != 0) {
+          continue;
+        }
+        rc = (*iter)->get(lookup_key, value);
+        if (rc != RC::NOTFOUND) {
+          return rc;
+        }
+      }
     } else {
-      value->assign(iter->value());
+      // files of a level (or a run) are sorted and don't overlap, only one may contain the key.
+      auto iter = lower_bound(level.begin(), level.end(), key,
+          [&](const shared_ptr<ObSSTable> &sst, const string_view &) { return compare_range(sst) > 0; });
+      if (iter != level.end() && compare_range(*iter) == 0) {
+        rc = (*iter)->get(lookup_key, value);
+        if (rc != RC::NOTFOUND) {
+          return rc;
+        }
+      }
     }
-  } else {
-    rc = RC::NOT_EXIST;
   }
-  return rc;
+  return RC::NOT_EXIST;
 }
 
 ObLsmIterator *ObLsmImpl::new_iterator(ObLsmReadOptions options)
 {
-  unique_lock<mutex>     lock(mu_);
-  shared_ptr<ObMemTable> mem = mem_table_;
-
-  shared_ptr<ObMemTable> imm = nullptr;
-  if (!imem_tables_.empty()) {
-    imm = imem_tables_.back();
-  }
-  vector<shared_ptr<ObSSTable>> sstables;
-  for (auto &level : *sstables_) {
-    sstables.insert(sstables.end(), level.begin(), level.end());
-  }
-  lock.unlock();
+  shared_ptr<const ObLsmVersion>    version = current_version();
   vector<unique_ptr<ObLsmIterator>> iters;
-  iters.emplace_back(mem->new_iterator());
-  if (imm != nullptr) {
-    iters.emplace_back(imm->new_iterator());
+  iters.emplace_back(version->mem->new_iterator());
+  if (version->imm != nullptr) {
+    iters.emplace_back(version->imm->new_iterator());
   }
-  for (const auto &sst : sstables) {
-    iters.emplace_back(sst->new_iterator());
+  for (const auto &level : *version->sstables) {
+    for (const auto &sst : level) {
+      iters.emplace_back(sst->new_iterator());
+    }
   }
 
   return new_user_iterator(
       new_merging_iterator(&internal_key_comparator_, std::move(iters)), options.seq == -1 ? seq_.load() : options.seq);
 }
 
-ObLsmTransaction *ObLsmImpl::begin_transaction() { return new ObLsmTransaction(this, seq_.load()); }
+ObLsmTransaction *ObLsmImpl::begin_transaction() { return new ObLsmTransaction(this, get_snapshot()); }
+
+uint64_t ObLsmImpl::get_snapshot()
+{
+  // the sequence is reserved, so the writes after the snapshot always get bigger ones.
+  lock_guard<mutex> guard(mu_);
+  uint64_t          seq = seq_.fetch_add(1);
+  snapshots_.insert(seq);
+  return seq;
+}
+
+void ObLsmImpl::release_snapshot(uint64_t seq)
+{
+  lock_guard<mutex> guard(mu_);
+  auto              iter = snapshots_.find(seq);
+  if (iter != snapshots_.end()) {
+    snapshots_.erase(iter);
+  }
+}
 
 void ObLsmImpl::dump_sstables()
 {
@@ -374,12 +825,9 @@ void ObLsmImpl::dump_sstables()
   }
 }
 
-RC ObLsmImpl::recover_from_manifest_records(const std::vector<ObManifestCompaction> &records)
+RC ObLsmImpl::recover_from_manifest_records(
+    const std::vector<ObManifestCompaction> &records, std::vector<std::vector<uint64_t>> &sstables)
 {
-  std::vector<std::vector<uint64_t>> tmp_sstables;
-  for (size_t i = 0; i < options_.default_levels; i++) {
-    tmp_sstables.emplace_back();
-  }
   for (auto &record : records) {
     // assert(sstable_id_ < record.sstable_sequence_id);
     sstable_id_ = record.sstable_sequence_id;
@@ -389,50 +837,91 @@ RC ObLsmImpl::recover_from_manifest_records(const std::vector<ObManifestCompacti
       uint32_t level      = info.level;
       uint64_t sstable_id = info.sstable_id;
       ASSERT(level < options_.default_levels, "level shouldn't greater than or equal to default level size");
-      tmp_sstables[level].push_back(sstable_id);
+      sstables[level].push_back(sstable_id);
     }
     // Deleted tables
     for (auto &info : record.deleted_tables) {
       uint32_t level = info.level;
-      uint32_t sid   = info.sstable_id;
+      uint64_t sid   = info.sstable_id;
       ASSERT(level < options_.default_levels, "level shouldn't greater than or equal to default level size");
-      auto del_iter = std::find(tmp_sstables[level].begin(), tmp_sstables[level].end(), sid);
-      tmp_sstables[level].erase(del_iter);
+      auto del_iter = std::find(sstables[level].begin(), sstables[level].end(), sid);
+      if (del_iter == sstables[level].end()) {
+        LOG_ERROR("Failed to find deleted sstable %lu in level %u", sid, level);
+        return RC::INTERNAL;
+      }
+      sstables[level].erase(del_iter);
     }
   }
-
-  RC rc = load_manifest_sstable(tmp_sstables);
-  if (rc != RC::SUCCESS) {
-    LOG_ERROR("Failed to load sstables, rc=%s", strrc(rc));
-    return rc;
-  }
   return RC::SUCCESS;
 }
 
-RC ObLsmImpl::load_manifest_snapshot(const ObManifestSnapshot &snapshot)
+RC ObLsmImpl::load_manifest_snapshot(const ObManifestSnapshot &snapshot, std::vector<std::vector<uint64_t>> &sstables)
 {
   seq_        = snapshot.seq;
   sstable_id_ = snapshot.sstable_id;
-  RC rc       = load_manifest_sstable(snapshot.sstables);
-  return rc;
+  sstables    = snapshot.sstables;
+  if (sstables.size() < options_.default_levels) {
+    sstables.resize(options_.default_levels);
+  }
+  return RC::SUCCESS;
 }
 
 RC ObLsmImpl::load_manifest_sstable(const std::vector<std::vector<uint64_t>> &sstables)
 {
   // After Getting the final state of lsm tree, recovering the system's state from tmp_sstables
+  if (sstables_->size() < sstables.size()) {
+    sstables_->resize(sstables.size());
+  }
   size_t cur_level_idx = 0;
   for (auto &sst_ids : sstables) {
     auto &cur_level = sstables_->at(cur_level_idx++);
     for (auto &sst_id : sst_ids) {
       auto filename = get_sstable_path(sst_id);
-      auto sstable  = std::make_shared<ObSSTable>(sst_id, filename, &default_comparator_, block_cache_.get());
-      sstable->init();
+      auto sstable  = std::make_shared<ObSSTable>(
+          sst_id, filename, &default_comparator_, block_cache_.get(), options_.use_mmap_reads);
+      RC   rc       = sstable->init();
+      if (OB_FAIL(rc)) {
+        LOG_ERROR("Failed to init sstable %s, rc=%s", filename.c_str(), strrc(rc));
+        return rc;
+      }
       cur_level.emplace_back(sstable);
     }
+    // the sstables of a level (except level 0) are searched by key, the order in manifest is the order of changes.
+    if (options_.type == CompactionType::LEVELED && cur_level_idx > 1) {
+      sort(cur_level.begin(), cur_level.end(), [this](const shared_ptr<ObSSTable> &a, const shared_ptr<ObSSTable> &b) {
+        return internal_key_comparator_.compare(a->first_key(), b->first_key()) < 0;
+      });
+    }
   }
   return RC::SUCCESS;
 }
 
+void ObLsmImpl::remove_obsolete_files()
+{
+  unordered_set<uint64_t> live_sstables;
+  for (const auto &level : *sstables_) {
+    for (const auto &sstable : level) {
+      live_sstables.insert(sstable->sst_id());
+    }
+  }
+
+  error_code ec;
+  for (const auto &entry : filesystem::directory_iterator(path_, ec)) {
+    const filesystem::path &file = entry.path();
+    if (file.extension() != SSTABLE_SUFFIX) {
+      continue;
+    }
+    char    *end_ptr    = nullptr;
+    string   stem       = file.stem().string();
+    uint64_t sstable_id = strtoull(stem.c_str(), &end_ptr, 10);
+    if (end_ptr == stem.c_str() || *end_ptr != '\0' || live_sstables.count(sstable_id) > 0) {
+      continue;
+    }
+    LOG_INFO("remove obsolete sstable file %s", file.c_str());
+    filesystem::remove(file, ec);
+  }
+}
+
 RC ObLsmImpl::write_manifest_snapshot()
 {
   ObManifestSnapshot    snapshot;
@@ -16,13 +16,16 @@ See the Mulan PSL v2 for more details. */
 #include "common/lang/atomic.h"
 #include "common/lang/memory.h"
 #include "common/lang/condition_variable.h"
+#include "common/lang/set.h"
 #include "common/lang/utility.h"
 #include "common/thread/thread_pool_executor.h"
 #include "oblsm/include/ob_lsm_transaction.h"
 #include "oblsm/memtable/ob_memtable.h"
 #include "oblsm/table/ob_sstable.h"
 #include "oblsm/util/ob_lru_cache.h"
+#include "oblsm/util/ob_rate_limiter.h"
 #include "oblsm/compaction/ob_compaction.h"
+#include "oblsm/compaction/ob_compaction_picker.h"
 #include "oblsm/ob_manifest.h"
 #include "oblsm/wal/ob_lsm_wal.h"
 
@@ -35,6 +38,20 @@ struct ObLsmBgCompactCtx
   uint64_t new_memtable_id;
 };
 
+/**
+ * @brief An immutable view of the memtables and sstables of `ObLsmImpl`.
+ *
+ * Readers take a reference of the current version instead of holding `mu_`, so they are not
+ * blocked by flush or compaction. A new version is installed whenever the memtables or
+ * sstables change, the old one is freed when its last reader is done.
+ */
+struct ObLsmVersion
+{
+  shared_ptr<ObMemTable> mem;
+  shared_ptr<ObMemTable> imm;  // may be null
+  SSTablesPtr            sstables;
+};
+
 class ObLsmImpl : public ObLsm
 {
 public:
@@ -46,6 +63,8 @@ public:
     }
     executor_.shutdown();
     executor_.await_termination();
+    compaction_executor_.shutdown();
+    compaction_executor_.await_termination();
   }
 
   RC put(const string_view &key, const string_view &value) override;
@@ -56,9 +75,13 @@ public:
 
   ObLsmTransaction *begin_transaction() override;
 
+  uint64_t get_snapshot() override;
+
+  void release_snapshot(uint64_t seq) override;
+
   ObLsmIterator *new_iterator(ObLsmReadOptions options) override;
 
-  SSTablesPtr get_sstables() { return sstables_; }
+  SSTablesPtr get_sstables() { return current_version()->sstables; }
 
   RC recover();
   RC batch_put(const std::vector<pair<string, string>> &kvs) override;
@@ -66,12 +89,23 @@ public:
   // used for debug
   void dump_sstables() override;
 
+  ObLsmWriteStallStats write_stall_stats() const override;
+
 private:
   RC recover_from_wal();
-  RC recover_from_manifest_records(const std::vector<ObManifestCompaction> &records);
-  RC load_manifest_snapshot(const ObManifestSnapshot &snapshot);
+  /**
+   * @brief Applies the sstable changes of the compaction records to the ids of sstables of each level.
+   */
+  RC recover_from_manifest_records(
+      const std::vector<ObManifestCompaction> &records, std::vector<std::vector<uint64_t>> &sstables);
+  RC load_manifest_snapshot(const ObManifestSnapshot &snapshot, std::vector<std::vector<uint64_t>> &sstables);
   RC load_manifest_sstable(const std::vector<std::vector<uint64_t>> &sstables);
   RC write_manifest_snapshot();
+  /**
+   * @brief Removes the sstable files which are not referenced by the manifest, they are the
+   * outputs of an unfinished compaction or the inputs of a finished one.
+   */
+  void remove_obsolete_files();
 
 private:
   /**
@@ -85,6 +119,43 @@ private:
    */
   RC try_freeze_memtable();
 
+  /**
+   * @brief Freezes the active MemTable if a write has pushed it beyond `memtable_size`.
+   *
+   * Called by the write paths after they released `mem_lock_`. It waits for the previous
+   * immutable MemTable to be flushed before freezing the active one.
+   *
+   * @param mem_size The memory usage of the active MemTable observed by the writer.
+   */
+  RC maybe_freeze_memtable(size_t mem_size);
+
+  /**
+   * @brief Delays or stops the writer if the flush or compaction falls behind.
+   *
+   * Called by the write paths before they write anything. A writer sleeps `slowdown_write_micros`
+   * if a slowdown trigger is reached, and waits on `cv_` until compaction brings the LSM-Tree
+   * below the stop triggers if a stop trigger is reached.
+   */
+  void maybe_stall_write();
+
+  /**
+   * @brief Schedules a compaction task on `executor_` unless one is scheduled already.
+   */
+  void maybe_schedule_compaction();
+
+  /**
+   * @brief Publishes the current memtables and sstables as a new `ObLsmVersion`.
+   * It also refreshes the statistics checked by `maybe_stall_write`.
+   * @note The caller must hold `mu_`. `sstables_` must be replaced rather than modified in place,
+   * because it is shared with the published versions.
+   */
+  void install_version();
+
+  /**
+   * @brief Returns a reference of the current version.
+   */
+  shared_ptr<const ObLsmVersion> current_version();
+
   /**
    * @brief Performs compaction on the SSTables selected by the compaction strategy.
    *
@@ -93,23 +164,38 @@ private:
    * compacted, merges their data, and writes the merged data into new SSTable files.
    *
    * @param picked A pointer to the compaction plan that specifies the input SSTables to merge.
-   *               If `picked` is `nullptr`, no compaction is performed and an empty result is returned.
-   *
-   * @return vector<shared_ptr<ObSSTable>> A vector of shared pointers to the newly created SSTables
-   *                                       resulting from the compaction process.
+   * @param drop_deletions Whether the deleted keys can be dropped, it is true if no older
+   *                       SSTable out of the compaction may contain the keys.
+   * @param smallest_snapshot The sequence of the oldest live snapshot, or the current sequence if there is none.
+   * @param results The newly created SSTables, sorted by key.
    *
    * @details
-   * - The function retrieves the inputs (SSTables) from the `picked` compaction plan.
-   * - For each SSTable, it creates a new iterator to sequentially scan its data.
-   * - It merges the iterators using a merging iterator (`ObLsmIterator`).
-   * - It writes the merged key-value pairs into new SSTable files using `ObSSTableBuilder`.
-   * - If the size of the new SSTable exceeds a predefined size (`options_.table_size`),
-   *   the builder finalizes the current SSTable and starts a new one.
+   * - The key range of the inputs is split into at most `options_.compaction_threads` ranges of
+   *   similar size by the first keys of the input blocks.
+   * - Each range is a subcompaction running on `compaction_executor_`, see `do_subcompaction`.
+   * - The outputs of the subcompactions are concatenated in key order.
    *
    * @warning Ensure that the `picked` object is properly populated with valid inputs.
    *
    */
-  vector<shared_ptr<ObSSTable>> do_compaction(ObCompaction *compaction);
+  RC do_compaction(ObCompaction *picked, bool drop_deletions, uint64_t smallest_snapshot,
+      vector<shared_ptr<ObSSTable>> &results);
+
+  /**
+   * @brief Merges the user keys in [`begin`, `end`) of the compaction inputs into new SSTables.
+   *
+   * - It merges the inputs using a merging iterator (`ObLsmIterator`). A version of a user key is
+   *   dropped only if a newer version is visible to all the snapshots, i.e. its sequence is not
+   *   greater than `smallest_snapshot`, so every version newer than the oldest snapshot is kept.
+   * - It writes the merged key-value pairs into new SSTable files using `ObSSTableBuilder`.
+   * - If the size of the new SSTable exceeds `options_.table_size`, the builder finalizes the
+   *   current SSTable and starts a new one.
+   *
+   * @param begin The first user key of the range, nullptr means unbounded.
+   * @param end The user key after the range, nullptr means unbounded.
+   */
+  RC do_subcompaction(ObCompaction *picked, const string *begin, const string *end, bool drop_deletions,
+      uint64_t smallest_snapshot, vector<shared_ptr<ObSSTable>> &results);
 
   /**
    * @brief Initiates a major compaction process.
@@ -118,6 +204,10 @@ private:
    * SSTable, which reduces storage fragmentation and improves read performance.
    * This process typically runs periodically or when triggered by specific conditions.
    *
+   * It repeats until the picker finds nothing to compact. The result of each compaction is
+   * recorded in the manifest before it is installed, then the inputs are marked obsolete and
+   * their files are removed once no reader uses them.
+   *
    * @note This function should be called with care, as major compaction is a resource-intensive
    *       operation and may affect system performance during execution.
    */
@@ -160,23 +250,50 @@ private:
 
   ObLsmOptions                      options_;
   string                            path_;
+  // protects the memtable switch/freeze and the sstables, it is not held by the write path of `put`.
   mutex                             mu_;
+  // `put` holds it shared while writing `wal_` and `mem_table_`, freeze holds it exclusively to switch them.
+  shared_mutex                      mem_lock_;
+  // only protects `version_` itself, it is held just to copy or replace the pointer.
+  mutex                             version_mu_;
+  shared_ptr<const ObLsmVersion>    version_;
   std::shared_ptr<WAL>              wal_;
   std::vector<std::shared_ptr<WAL>> frozen_wals_;
   shared_ptr<ObMemTable>            mem_table_;
   vector<shared_ptr<ObMemTable>>    imem_tables_;
   SSTablesPtr                       sstables_;
+  // flushes the immutable memtables and runs the compaction tasks, one thread for each
   common::ThreadPoolExecutor        executor_;
+  // runs the subcompactions
+  common::ThreadPoolExecutor        compaction_executor_;
+  // protected by `mu_`
+  unique_ptr<ObCompactionPicker>    picker_;
   ObManifest                        manifest_;
   atomic<uint64_t>                  seq_{0};
+  // the sequences of the live snapshots, protected by `mu_`
+  multiset<uint64_t>                snapshots_;
   atomic<uint64_t>                  sstable_id_{0};
   atomic<uint64_t>                  memtable_id_{0};
   condition_variable                cv_;
   // TODO: use global variable?
   const ObDefaultComparator                                  default_comparator_;
   const ObInternalKeyComparator                              internal_key_comparator_;
-  atomic<bool>                                               compacting_ = false;
+  // whether a compaction task is scheduled or running, protected by `mu_`
+  bool                                                       compaction_scheduled_ = false;
   std::unique_ptr<ObLRUCache<uint64_t, shared_ptr<ObBlock>>> block_cache_;
+  // limits the writes of flush and compaction
+  unique_ptr<ObRateLimiter>                                  rate_limiter_;
+
+  // statistics of the current version, checked by the writers without `mu_`
+  atomic<size_t>   l0_file_count_{0};
+  atomic<size_t>   pending_compaction_bytes_{0};
+  // write stall counters, see `ObLsmWriteStallStats`
+  atomic<uint64_t> stall_micros_{0};
+  atomic<uint64_t> l0_slowdown_count_{0};
+  atomic<uint64_t> l0_stop_count_{0};
+  atomic<uint64_t> pending_bytes_slowdown_count_{0};
+  atomic<uint64_t> pending_bytes_stop_count_{0};
+  atomic<uint64_t> memtable_stop_count_{0};
 };
 
 }  // namespace oceanbase
\ No newline at end of file
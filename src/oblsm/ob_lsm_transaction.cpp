@@ -40,10 +40,13 @@ private:
   unique_ptr<ObLsmIterator> right_;
 };
 
-ObLsmTransaction::ObLsmTransaction(ObLsm *db, uint64_t ts) : db_(db), ts_(ts)
+ObLsmTransaction::ObLsmTransaction(ObLsm *db, uint64_t ts) : db_(db), ts_(ts) {}
+
+ObLsmTransaction::~ObLsmTransaction()
 {
-  (void)db_;
-  (void)ts_;
+  if (db_ != nullptr) {
+    db_->release_snapshot(ts_);
+  }
 }
 
 RC ObLsmTransaction::get(const string_view &key, string *value) { return RC::UNIMPLEMENTED; }
@@ -11,31 +11,150 @@ See the Mulan PSL v2 for more details. */
 #include "oblsm/table/ob_block.h"
 #include "oblsm/util/ob_coding.h"
 #include "common/lang/memory.h"
+#include "common/log/log.h"
+#include "common/math/crc.h"
 
 namespace oceanbase {
 
-RC ObBlock::decode(const string &data)
+RC ObBlock::decode(string &&data)
 {
-  return RC::UNIMPLEMENTED;
+  buf_ = std::move(data);
+  owner_.reset();
+  return init(buf_);
 }
 
-string_view ObBlock::get_entry(uint32_t offset) const
+RC ObBlock::decode(string_view data, shared_ptr<const void> owner)
 {
-  uint32_t    curr_begin = offsets_[offset];
-  uint32_t    curr_end   = offset == offsets_.size() - 1 ? data_.size() : offsets_[offset + 1];
-  string_view curr       = string_view(data_.data() + curr_begin, curr_end - curr_begin);
-  return curr;
+  buf_.clear();
+  owner_ = std::move(owner);
+  return init(data);
 }
 
-ObLsmIterator *ObBlock::new_iterator() const { return new BlockIterator(comparator_, this, size()); }
+RC ObBlock::init(string_view data)
+{
+  // | entries | restart 1 | .. | restart k | restart count(k) | entry count(n) | crc32 |
+  if (data.size() < 3 * sizeof(uint32_t)) {
+    LOG_WARN("block is too small, size=%lu", data.size());
+    return RC::INTERNAL;
+  }
+  const char    *trailer = data.data() + data.size() - 3 * sizeof(uint32_t);
+  const uint32_t crc     = get_numeric<uint32_t>(trailer + 2 * sizeof(uint32_t));
+  if (crc32(data.data(), data.size() - sizeof(uint32_t)) != crc) {
+    LOG_WARN("block checksum mismatch, size=%lu", data.size());
+    return RC::INTERNAL;
+  }
+  uint32_t restart_count = get_numeric<uint32_t>(trailer);
+  uint32_t entry_count   = get_numeric<uint32_t>(trailer + sizeof(uint32_t));
+  if ((restart_count + 3ULL) * sizeof(uint32_t) > data.size() || (restart_count == 0 && entry_count != 0)) {
+    LOG_WARN("invalid block, size=%lu, restart count=%u, entry count=%u", data.size(), restart_count, entry_count);
+    return RC::INTERNAL;
+  }
+  data_            = data;
+  restarts_offset_ = data.size() - (restart_count + 3) * sizeof(uint32_t);
+  restart_count_   = restart_count;
+  entry_count_     = entry_count;
+  for (uint32_t i = 0; i < restart_count_; i++) {
+    if (restart_offset(i) >= restarts_offset_) {
+      LOG_WARN("invalid block, restart %u is out of range, offset=%u", i, restart_offset(i));
+      return RC::INTERNAL;
+    }
+  }
+  return RC::SUCCESS;
+}
+
+ObLsmIterator *ObBlock::new_iterator() const { return new BlockIterator(comparator_, this); }
+
+int BlockIterator::compare(const string_view &a, const string_view &b) const
+{
+  int r = comparator_->compare(extract_user_key(a), extract_user_key(b));
+  if (r == 0) {
+    uint64_t aseq = extract_sequence(a);
+    uint64_t bseq = extract_sequence(b);
+    r             = aseq > bseq ? -1 : (aseq < bseq ? 1 : 0);
+  }
+  return r;
+}
+
+void BlockIterator::seek_to_restart(uint32_t index)
+{
+  key_.clear();
+  next_ = data_->restart_offset(index);
+}
+
+bool BlockIterator::parse_next_entry()
+{
+  current_ = next_;
+  if (current_ >= entries_.size()) {
+    current_ = entries_.size();
+    return false;
+  }
+  const char *p          = entries_.data() + current_;
+  const char *limit      = entries_.data() + entries_.size();
+  uint32_t    shared     = 0;
+  uint32_t    non_shared = 0;
+  uint32_t    value_size = 0;
+  if ((p = get_varint32(p, limit, &shared)) == nullptr || (p = get_varint32(p, limit, &non_shared)) == nullptr ||
+      (p = get_varint32(p, limit, &value_size)) == nullptr ||
+      static_cast<size_t>(limit - p) < static_cast<size_t>(non_shared) + value_size || shared > key_.size()) {
+    LOG_WARN("corrupted block entry, offset=%u", current_);
+    current_ = entries_.size();
+    return false;
+  }
+  key_.resize(shared);
+  key_.append(p, non_shared);
+  value_ = string_view(p + non_shared, value_size);
+  next_  = p + non_shared + value_size - entries_.data();
+  return true;
+}
+
+void BlockIterator::seek_to_first()
+{
+  if (data_->restart_count() == 0) {
+    current_ = entries_.size();
+    return;
+  }
+  seek_to_restart(0);
+  parse_next_entry();
+}
 
-void BlockIterator::parse_entry()
+void BlockIterator::seek_to_last()
 {
-  curr_entry_         = data_->get_entry(index_);
-  uint32_t key_size   = get_numeric<uint32_t>(curr_entry_.data());
-  key_                = string_view(curr_entry_.data() + sizeof(uint32_t), key_size);
-  uint32_t value_size = get_numeric<uint32_t>(curr_entry_.data() + sizeof(uint32_t) + key_size);
-  value_              = string_view(curr_entry_.data() + 2 * sizeof(uint32_t) + key_size, value_size);
+  if (data_->restart_count() == 0) {
+    current_ = entries_.size();
+    return;
+  }
+  seek_to_restart(data_->restart_count() - 1);
+  while (parse_next_entry() && next_ < entries_.size()) {}
+}
+
+void BlockIterator::seek(const string_view &lookup_key)
+{
+  const string_view target = extract_internal_key(lookup_key);
+  if (data_->restart_count() == 0) {
+    current_ = entries_.size();
+    return;
+  }
+  // find the last restart point whose key < target
+  uint32_t left  = 0;
+  uint32_t right = data_->restart_count() - 1;
+  while (left < right) {
+    uint32_t mid = (left + right + 1) / 2;
+    seek_to_restart(mid);
+    if (!parse_next_entry()) {
+      return;
+    }
+    if (compare(key_, target) < 0) {
+      left = mid;
+    } else {
+      right = mid - 1;
+    }
+  }
+  seek_to_restart(left);
+  while (parse_next_entry()) {
+    if (compare(key_, target) >= 0) {
+      return;
+    }
+  }
 }
 
 string BlockMeta::encode() const
@@ -47,6 +166,7 @@ string BlockMeta::encode() const
   ret.append(last_key_);
   put_numeric<uint32_t>(&ret, offset_);
   put_numeric<uint32_t>(&ret, size_);
+  put_numeric<uint8_t>(&ret, static_cast<uint8_t>(compression_));
   return ret;
 }
 
@@ -65,18 +185,9 @@ RC BlockMeta::decode(const string &data)
   offset_ = get_numeric<uint32_t>(data_ptr);
   data_ptr += sizeof(uint32_t);
   size_ = get_numeric<uint32_t>(data_ptr);
+  data_ptr += sizeof(uint32_t);
+  compression_ = static_cast<ObCompressionType>(get_numeric<uint8_t>(data_ptr));
   return rc;
 }
 
-void BlockIterator::seek(const string_view &lookup_key)
-{
-   index_ = 0;
-   while(valid()) {
-    parse_entry();
-    if (comparator_->compare(extract_user_key(key_), extract_user_key_from_lookup_key(lookup_key)) >= 0) {
-      break;
-    }
-    index_++;
-   }
-}
 }  // namespace oceanbase
@@ -10,10 +10,13 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/lang/memory.h"
 #include "common/lang/string.h"
 #include "common/lang/vector.h"
 #include "oblsm/include/ob_lsm_iterator.h"
 #include "oblsm/util/ob_comparator.h"
+#include "oblsm/util/ob_coding.h"
+#include "oblsm/ob_lsm_define.h"
 
 namespace oceanbase {
 
@@ -27,24 +30,27 @@ namespace oceanbase {
 //      ├─────────────────┤    │
 //      │    entry n      │◄─┐ │
 //      ├─────────────────┤  │ │
-// ┌───►│  offset size(n) │  │ │
-// │    ├─────────────────┤  │ │
-// │    │    offset 1     ├──┼─┘
-// │    ├─────────────────┤  │
-// │    │      ..         │  │
-// │    ├─────────────────┤  │
-// │    │    offset n     ├──┘
-// │    ├─────────────────┤
-// └────┤  offset start   │
+//      │   restart 1     ├──┼─┘
+//      ├─────────────────┤  │
+//      │      ..         │  │
+//      ├─────────────────┤  │
+//      │   restart k     ├──┘
+//      ├─────────────────┤
+//      │ restart count(k)│
+//      ├─────────────────┤
+//      │ entry count(n)  │
+//      ├─────────────────┤
+//      │     crc32       │
 //      └─────────────────┘
+// entry: | shared key size(varint) | unshared key size(varint) | value size(varint) | unshared key | value |
+// The restart entries store the full key (shared key size is 0), the crc32 covers all the bytes before it.
 /**
  * @class ObBlock
  * @brief Represents a data block in the LSM-Tree.
  *
- * The `ObBlock` class manages a block of serialized key-value pairs, along with
- * their offsets, for efficient storage and retrieval. It provides methods to decode
- * serialized data, access individual entries, and create iterators for traversing
- * the block contents.
+ * The `ObBlock` class manages a block of serialized key-value pairs, the keys are prefix compressed
+ * against the previous key and restart from a full key at every restart point. It provides methods
+ * to decode serialized data and create iterators for traversing the block contents.
  */
 class ObBlock
 {
@@ -52,87 +58,130 @@ class ObBlock
 public:
   ObBlock(const ObComparator *comparator) : comparator_(comparator) {}
 
-  void add_offset(uint32_t offset) { offsets_.push_back(offset); }
+  /**
+   * @brief The number of entries in the block.
+   */
+  int size() const { return entry_count_; }
+
+  /**
+   * @brief The entries of the block, without the restart array and the trailer.
+   */
+  string_view entries() const { return string_view(data_.data(), restarts_offset_); }
 
-  uint32_t get_offset(int index) const { return offsets_[index]; }
+  uint32_t restart_count() const { return restart_count_; }
 
-  string_view get_entry(uint32_t offset) const;
+  /**
+   * @brief The offset in `entries()` of the `index`-th restart point.
+   */
+  uint32_t restart_offset(uint32_t index) const
+  {
+    return get_numeric<uint32_t>(data_.data() + restarts_offset_ + index * sizeof(uint32_t));
+  }
 
-  int size() const { return offsets_.size(); }
+  /**
+   * @brief The memory used by the decoded block, it is the charge of the block in the block cache.
+   * A block referencing a mapped file only charges itself, the file memory belongs to the page cache.
+   */
+  size_t memory_size() const { return sizeof(ObBlock) + buf_.size(); }
 
   /**
    * @brief Decodes serialized block data.
    *
-   * This function parses and decodes the serialized string data to reconstruct
-   * the block's structure, including all key-value offsets and entries.
+   * This function verifies the checksum of the serialized data and locates the restart array.
    * The decoded data format can reference ObBlockBuilder.
-   * @param data The serialized block data as a string.
-   * @return RC The result code indicating the success or failure of the decode operation.
+   * @param data The serialized block data as a string, the block takes it over.
+   * @return RC The result code indicating the success or failure of the decode operation,
+   * it fails if the block is malformed or the checksum doesn't match.
+   */
+  RC decode(string &&data);
+  RC decode(const string &data) { return decode(string(data)); }
+
+  /**
+   * @brief Decodes the block data without copying it, e.g. the data is in a mapped file.
+   * @param owner It keeps `data` alive as long as the block.
    */
-  RC decode(const string &data);
+  RC decode(string_view data, shared_ptr<const void> owner);
 
   ObLsmIterator *new_iterator() const;
 
 private:
-  string           data_;
-  vector<uint32_t> offsets_;
+  RC init(string_view data);
+
+private:
+  // the serialized block, it is `buf_` or the memory kept alive by `owner_`
+  string_view            data_;
+  string                 buf_;
+  shared_ptr<const void> owner_;
+  uint32_t               restarts_offset_ = 0;
+  uint32_t               restart_count_   = 0;
+  uint32_t               entry_count_     = 0;
   // TODO: remove
-  const ObComparator *comparator_;
+  const ObComparator    *comparator_;
 };
 
+/**
+ * @brief Iterates the entries of an `ObBlock`, the keys are decoded into `key_`.
+ */
 class BlockIterator : public ObLsmIterator
 {
 public:
-  BlockIterator(const ObComparator *comparator, const ObBlock *data, uint32_t count)
-      : comparator_(comparator), data_(data), count_(count)
+  BlockIterator(const ObComparator *comparator, const ObBlock *data)
+      : comparator_(comparator), data_(data), entries_(data->entries()), current_(entries_.size())
   {}
   BlockIterator(const BlockIterator &)            = delete;
   BlockIterator &operator=(const BlockIterator &) = delete;
 
   ~BlockIterator() override = default;
 
+  /**
+   * @brief Moves to the first entry whose internal key >= the internal key of `lookup_key`.
+   * @details It binary searches the restart points for the last one before the key, then
+   * scans the entries from there.
+   */
   void seek(const string_view &lookup_key) override;
-  void seek_to_first() override
-  {
-    index_ = 0;
-    parse_entry();
-  }
-  void seek_to_last() override
-  {
-    index_ = count_ - 1;
-    parse_entry();
-  }
+  void seek_to_first() override;
+  void seek_to_last() override;
 
-  bool valid() const override { return index_ < count_; }
-  void next() override
-  {
-    index_++;
-    if (valid()) {
-      parse_entry();
-    }
-  }
+  bool valid() const override { return current_ < entries_.size(); }
+  void next() override { parse_next_entry(); }
   string_view key() const override { return key_; };
   string_view value() const override { return value_; }
 
 private:
-  void parse_entry();
+  /**
+   * @brief Moves to the `index`-th restart point, the next `parse_next_entry` decodes its entry.
+   */
+  void seek_to_restart(uint32_t index);
+
+  /**
+   * @brief Decodes the entry at `next_`, the iterator becomes invalid at the end or on corruption.
+   */
+  bool parse_next_entry();
+
+  /**
+   * @brief Compares two internal keys, by user key ascending and sequence descending.
+   */
+  int compare(const string_view &a, const string_view &b) const;
 
 private:
   const ObComparator  *comparator_;
   const ObBlock *const data_;
-  string_view          curr_entry_;
-  string_view          key_;
+  const string_view    entries_;
+  // offset of the current entry, `entries_.size()` if it is invalid
+  uint32_t             current_;
+  // offset of the entry after the current one
+  uint32_t             next_ = 0;
+  string               key_;
   string_view          value_;
-  uint32_t             count_ = 0;
-  uint32_t             index_ = 0;
 };
 
 class BlockMeta
 {
 public:
   BlockMeta() {}
-  BlockMeta(const string &first_key, const string &last_key, uint32_t offset, uint32_t size)
-      : first_key_(first_key), last_key_(last_key), offset_(offset), size_(size)
+  BlockMeta(const string &first_key, const string &last_key, uint32_t offset, uint32_t size,
+      ObCompressionType compression = ObCompressionType::NONE)
+      : first_key_(first_key), last_key_(last_key), offset_(offset), size_(size), compression_(compression)
   {}
   string encode() const;
   RC     decode(const string &data);
@@ -142,6 +191,9 @@ public:
 
   // Offset of ObBlock in SSTable
   uint32_t offset_;
+  // Size of the block on disk, it is the compressed size if the block is compressed
   uint32_t size_;
+
+  ObCompressionType compression_ = ObCompressionType::NONE;
 };
 }  // namespace oceanbase
@@ -10,53 +10,69 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/table/ob_block_builder.h"
 #include "oblsm/util/ob_coding.h"
+#include "common/lang/algorithm.h"
 #include "common/log/log.h"
+#include "common/math/crc.h"
 
 namespace oceanbase {
 
 void ObBlockBuilder::reset()
 {
-  offsets_.clear();
+  restarts_.clear();
+  counter_     = 0;
+  entry_count_ = 0;
   data_.clear();
-  // first_key_.clear();
+  last_key_.clear();
 }
 
 RC ObBlockBuilder::add(const string_view &key, const string_view &value)
 {
-  RC rc = RC::SUCCESS;
-  if (appro_size() + key.size() + value.size() + 2 * sizeof(uint32_t) > BLOCK_SIZE) {
+  RC     rc     = RC::SUCCESS;
+  size_t shared = 0;
+  if (counter_ < restart_interval_ && entry_count_ > 0) {
+    const size_t min_length = std::min(last_key_.size(), key.size());
+    while (shared < min_length && last_key_[shared] == key[shared]) {
+      shared++;
+    }
+  }
+  const size_t non_shared = key.size() - shared;
+  // 3 varints of 5 bytes at most, and a restart offset if it starts a restart point.
+  const size_t entry_size = 3 * 5 + non_shared + value.size() + (shared == 0 ? sizeof(uint32_t) : 0);
+  if (appro_size() + entry_size > BLOCK_SIZE) {
     // TODO: support large kv pair.
-    if (offsets_.empty()) {
+    if (empty()) {
       LOG_ERROR("block is empty, but kv pair is too large, key size: %lu, value size: %lu", key.size(), value.size());
       return RC::UNIMPLEMENTED;
     }
     LOG_TRACE("block is full, can't add more kv pair");
     rc = RC::FULL;
   } else {
-    offsets_.push_back(data_.size());
-    put_numeric<uint32_t>(&data_, key.size());
-    data_.append(key.data(), key.size());
-    put_numeric<uint32_t>(&data_, value.size());
+    if (entry_count_ == 0 || counter_ >= restart_interval_) {
+      restarts_.push_back(data_.size());
+      counter_ = 0;
+    }
+    put_varint32(&data_, shared);
+    put_varint32(&data_, non_shared);
+    put_varint32(&data_, value.size());
+    data_.append(key.data() + shared, non_shared);
     data_.append(value.data(), value.size());
+
+    last_key_.resize(shared);
+    last_key_.append(key.data() + shared, non_shared);
+    counter_++;
+    entry_count_++;
   }
   return rc;
 }
 
-string ObBlockBuilder::last_key() const
-{
-  string_view last_kv(data_.data() + offsets_.back(), data_.size() - offsets_.back());
-  uint32_t    key_length = get_numeric<uint32_t>(last_kv.data());
-  return string(last_kv.data() + sizeof(uint32_t), key_length);
-}
-
 string_view ObBlockBuilder::finish()
 {
-  uint32_t data_size = data_.size();
-  put_numeric<uint32_t>(&data_, offsets_.size());
-  for (size_t i = 0; i < offsets_.size(); i++) {
-    put_numeric<uint32_t>(&data_, offsets_[i]);
+  for (uint32_t restart : restarts_) {
+    put_numeric<uint32_t>(&data_, restart);
   }
-  put_numeric<uint32_t>(&data_, data_size);
+  put_numeric<uint32_t>(&data_, restarts_.size());
+  put_numeric<uint32_t>(&data_, entry_count_);
+  put_numeric<uint32_t>(&data_, crc32(data_.data(), data_.size()));
   return string_view(data_.data(), data_.size());
 }
 
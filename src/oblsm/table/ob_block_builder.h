@@ -19,31 +19,44 @@ namespace oceanbase {
 
 /**
  * @brief Build a ObBlock in SSTable
+ *
+ * The keys are prefix compressed, each entry only stores the part of its key that differs
+ * from the previous key. Every `restart_interval` entries the full key is stored, it is a
+ * restart point, so a reader can binary search the restart points and decode the entries
+ * from there. The format is described in `ObBlock`.
  */
 class ObBlockBuilder
 {
 
 public:
+  explicit ObBlockBuilder(uint32_t restart_interval = 16)
+      : restart_interval_(restart_interval == 0 ? 1 : restart_interval)
+  {}
+
   RC add(const string_view &key, const string_view &value);
 
   string_view finish();
 
   void reset();
 
-  string last_key() const;
+  string last_key() const { return last_key_; }
+
+  bool empty() const { return entry_count_ == 0; }
 
-  uint32_t appro_size() { return data_.size() + offsets_.size() * sizeof(uint32_t); }
+  uint32_t appro_size() { return data_.size() + (restarts_.size() + 3) * sizeof(uint32_t); }
 
 private:
   static const uint32_t BLOCK_SIZE = 4 * 1024;  // 4KB
-  // Offsets of key-value pairs.
-  vector<uint32_t> offsets_;
-  // key-value pairs
-  // TODO: use block as data container
-  // TODO: add checksum
-  string data_;
 
-  // string first_key_;
+  uint32_t restart_interval_;
+  // Offsets of the restart points.
+  vector<uint32_t> restarts_;
+  // Entries added since the last restart point.
+  uint32_t counter_     = 0;
+  uint32_t entry_count_ = 0;
+  // prefix compressed key-value pairs
+  string data_;
+  string last_key_;
 };
 
 }  // namespace oceanbase
@@ -10,49 +10,222 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/table/ob_sstable.h"
 #include "oblsm/util/ob_coding.h"
+#include "oblsm/util/ob_compression.h"
 #include "common/log/log.h"
 #include "common/lang/filesystem.h"
+#include "common/lang/algorithm.h"
 namespace oceanbase {
 
-void ObSSTable::init()
+RC ObSSTable::init()
 {
-  // your code here
+  file_reader_ = ObFileReader::create_file_reader(file_name_, use_mmap_);
+  if (file_reader_ == nullptr) {
+    return RC::IOERR_OPEN;
+  }
+
+  const uint32_t footer_size = 3 * sizeof(uint32_t);
+  uint32_t       file_size   = file_reader_->file_size();
+  if (file_size < footer_size + sizeof(uint32_t)) {
+    LOG_WARN("sstable %s is too small, size=%u", file_name_.c_str(), file_size);
+    return RC::INTERNAL;
+  }
+  string footer = file_reader_->read_pos(file_size - footer_size, footer_size);
+  if (footer.size() != footer_size) {
+    return RC::IOERR_READ;
+  }
+  uint32_t filter_offset = get_numeric<uint32_t>(footer.data());
+  uint32_t filter_size   = get_numeric<uint32_t>(footer.data() + sizeof(uint32_t));
+  uint32_t meta_offset   = get_numeric<uint32_t>(footer.data() + 2 * sizeof(uint32_t));
+  if (meta_offset + sizeof(uint32_t) > file_size - footer_size || filter_offset + filter_size > meta_offset) {
+    LOG_WARN("invalid footer of sstable %s, filter offset=%u, filter size=%u, meta offset=%u",
+             file_name_.c_str(), filter_offset, filter_size, meta_offset);
+    return RC::INTERNAL;
+  }
+
+  // block metas
+  string metas = file_reader_->read_pos(meta_offset, file_size - footer_size - meta_offset);
+  if (metas.empty()) {
+    return RC::IOERR_READ;
+  }
+  const char *p   = metas.data();
+  const char *end = metas.data() + metas.size();
+  uint32_t    cnt = get_numeric<uint32_t>(p);
+  p += sizeof(uint32_t);
+  block_metas_.clear();
+  block_metas_.reserve(cnt);
+  for (uint32_t i = 0; i < cnt; i++) {
+    if (p + sizeof(uint32_t) > end) {
+      return RC::INTERNAL;
+    }
+    uint32_t meta_size = get_numeric<uint32_t>(p);
+    p += sizeof(uint32_t);
+    if (p + meta_size > end) {
+      return RC::INTERNAL;
+    }
+    BlockMeta meta;
+    RC        rc = meta.decode(string(p, meta_size));
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    block_metas_.emplace_back(std::move(meta));
+    p += meta_size;
+  }
+
+  // bloom filter
+  filter_.reset();
+  if (filter_size > 0) {
+    string data = file_reader_->read_pos(filter_offset, filter_size);
+    if (data.size() != filter_size) {
+      return RC::IOERR_READ;
+    }
+    filter_ = make_unique<ObBloomfilter>();
+    RC rc   = filter_->decode(data);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("Failed to decode bloom filter of sstable %s, rc=%s", file_name_.c_str(), strrc(rc));
+      filter_.reset();
+      return rc;
+    }
+  }
+  return RC::SUCCESS;
 }
 
-shared_ptr<ObBlock> ObSSTable::read_block_with_cache(uint32_t block_idx) const
+RC ObSSTable::read_block_with_cache(uint32_t block_idx, ObLRUCache<uint64_t, shared_ptr<ObBlock>>::Handle &handle) const
 {
-  // your code here
-  return nullptr;
+  uint64_t cache_key = (static_cast<uint64_t>(sst_id_) << 32) | block_idx;
+  handle             = block_cache_->lookup(cache_key);
+  if (!handle.valid()) {
+    shared_ptr<ObBlock> block = read_block(block_idx);
+    if (block == nullptr) {
+      return RC::IOERR_READ;
+    }
+    handle = block_cache_->insert(cache_key, block, block->memory_size());
+  }
+  return RC::SUCCESS;
 }
 
 shared_ptr<ObBlock> ObSSTable::read_block(uint32_t block_idx) const
 {
-  // your code here
-  return nullptr;
+  const BlockMeta &meta = block_metas_[block_idx];
+  // in mmap mode `data` references the file, otherwise it is read into `buf`
+  string      buf;
+  string_view data;
+  bool        referenced = file_reader_->mmapped();
+  if (referenced) {
+    data = file_reader_->read_view(meta.offset_, meta.size_);
+  } else {
+    buf  = file_reader_->read_pos(meta.offset_, meta.size_);
+    data = buf;
+  }
+  if (data.size() != meta.size_) {
+    LOG_WARN("Failed to read block %u of sstable %s", block_idx, file_name_.c_str());
+    return nullptr;
+  }
+  // the block cache only holds decompressed blocks
+  if (meta.compression_ != ObCompressionType::NONE) {
+    const ObCompressor *compressor = ObCompressor::get(meta.compression_);
+    string              raw;
+    if (compressor == nullptr || OB_FAIL(compressor->decompress(data, &raw))) {
+      LOG_WARN("Failed to decompress block %u of sstable %s, compression=%d",
+          block_idx, file_name_.c_str(), static_cast<int>(meta.compression_));
+      return nullptr;
+    }
+    buf.swap(raw);
+    data       = buf;
+    referenced = false;
+  }
+  shared_ptr<ObBlock> block = make_shared<ObBlock>(comparator_);
+  // a block referencing the file keeps the mapping alive
+  RC rc = referenced ? block->decode(data, file_reader_) : block->decode(std::move(buf));
+  if (OB_FAIL(rc)) {
+    LOG_WARN("Failed to decode block %u of sstable %s, rc=%s", block_idx, file_name_.c_str(), strrc(rc));
+    return nullptr;
+  }
+  return block;
+}
+
+RC ObSSTable::get(const string_view &lookup_key, string *value) const
+{
+  string_view user_key = extract_user_key_from_lookup_key(lookup_key);
+  if (!may_contain(user_key)) {
+    return RC::NOTFOUND;
+  }
+
+  // the first block whose last key >= the internal key is the only one may contain the key.
+  string_view internal_key = extract_internal_key(lookup_key);
+  auto        meta_iter    = lower_bound(
+      block_metas_.begin(), block_metas_.end(), internal_key, [this](const BlockMeta &meta, const string_view &key) {
+        return internal_comparator_.compare(meta.last_key_, key) < 0;
+      });
+  if (meta_iter == block_metas_.end()) {
+    return RC::NOTFOUND;
+  }
+
+  ObLRUCache<uint64_t, shared_ptr<ObBlock>>::Handle handle;
+  RC rc = read_block_with_cache(meta_iter - block_metas_.begin(), handle);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+  unique_ptr<ObLsmIterator> iter(handle.value()->new_iterator());
+  const uint64_t            seq = extract_sequence(internal_key);
+  for (iter->seek(lookup_key); iter->valid(); iter->next()) {
+    if (comparator_->compare(extract_user_key(iter->key()), user_key) != 0) {
+      return RC::NOTFOUND;
+    }
+    if (extract_sequence(iter->key()) <= seq) {
+      if (iter->value().empty()) {
+        return RC::NOT_EXIST;
+      }
+      value->assign(iter->value().data(), iter->value().size());
+      return RC::SUCCESS;
+    }
+  }
+  return RC::NOTFOUND;
+}
+
+void ObSSTable::advise_sequential_reads()
+{
+  if (file_reader_ != nullptr && !block_metas_.empty()) {
+    file_reader_->advise(ObFileReader::Advice::SEQUENTIAL, 0, block_metas_.back().offset_ + block_metas_.back().size_);
+  }
+}
+
+ObSSTable::~ObSSTable()
+{
+  if (obsolete_.load()) {
+    file_reader_.reset();
+    remove();
+  }
 }
 
 void ObSSTable::remove() { filesystem::remove(file_name_); }
 
 ObLsmIterator *ObSSTable::new_iterator() { return new TableIterator(get_shared_ptr()); }
 
-void TableIterator::read_block_with_cache()
+bool TableIterator::read_block_with_cache()
 {
-  block_ = sst_->read_block_with_cache(curr_block_idx_);
-  block_iterator_.reset(block_->new_iterator());
+  // the iterator references the block, destroy it before the block is released
+  block_iterator_.reset();
+  if (OB_FAIL(sst_->read_block_with_cache(curr_block_idx_, block_handle_))) {
+    return false;
+  }
+  block_iterator_.reset(block_handle_.value()->new_iterator());
+  return true;
 }
 
 void TableIterator::seek_to_first()
 {
   curr_block_idx_ = 0;
-  read_block_with_cache();
-  block_iterator_->seek_to_first();
+  if (read_block_with_cache()) {
+    block_iterator_->seek_to_first();
+  }
 }
 
 void TableIterator::seek_to_last()
 {
   curr_block_idx_ = block_cnt_ - 1;
-  read_block_with_cache();
-  block_iterator_->seek_to_last();
+  if (read_block_with_cache()) {
+    block_iterator_->seek_to_last();
+  }
 }
 
 void TableIterator::next()
@@ -61,8 +234,9 @@ void TableIterator::next()
   if (block_iterator_->valid()) {
   } else if (curr_block_idx_ < block_cnt_ - 1) {
     curr_block_idx_++;
-    read_block_with_cache();
-    block_iterator_->seek_to_first();
+    if (read_block_with_cache()) {
+      block_iterator_->seek_to_first();
+    }
   }
 }
 
@@ -80,8 +254,17 @@ void TableIterator::seek(const string_view &lookup_key)
     block_iterator_ = nullptr;
     return;
   }
-  read_block_with_cache();
+  if (!read_block_with_cache()) {
+    return;
+  }
   block_iterator_->seek(lookup_key);
+  // the versions of the user key in this block may all be newer than the lookup key
+  if (!block_iterator_->valid() && curr_block_idx_ < block_cnt_ - 1) {
+    curr_block_idx_++;
+    if (read_block_with_cache()) {
+      block_iterator_->seek_to_first();
+    }
+  }
 };
 
 }  // namespace oceanbase
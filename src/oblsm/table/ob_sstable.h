@@ -11,9 +11,11 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include "oblsm/util/ob_file_reader.h"
+#include "common/lang/atomic.h"
 #include "common/lang/memory.h"
 #include "common/sys/rc.h"
 #include "oblsm/table/ob_block.h"
+#include "oblsm/util/ob_bloomfilter.h"
 #include "oblsm/util/ob_comparator.h"
 #include "oblsm/util/ob_lru_cache.h"
 
@@ -28,20 +30,28 @@ namespace oceanbase {
 //    ├─────────────────┤   │
 //    │    block n      │◄┐ │
 //    ├─────────────────┤ │ │
-// ┌─►│  meta size(n)   │ │ │
+// ┌─►│  filter block   │ │ │
 // │  ├─────────────────┤ │ │
-// │  │block meta 1 size│ │ │
-// │  ├─────────────────┤ │ │
-// │  │  block meta 1   ┼─┼─┘
-// │  ├─────────────────┤ │
-// │  │      ..         │ │
-// │  ├─────────────────┤ │
-// │  │block meta n size│ │
-// │  ├─────────────────┤ │
-// │  │  block meta n   ┼─┘
-// │  ├─────────────────┤
-// └──┼                 │
+// │┌►│  meta size(n)   │ │ │
+// ││ ├─────────────────┤ │ │
+// ││ │block meta 1 size│ │ │
+// ││ ├─────────────────┤ │ │
+// ││ │  block meta 1   ┼─┼─┘
+// ││ ├─────────────────┤ │
+// ││ │      ..         │ │
+// ││ ├─────────────────┤ │
+// ││ │block meta n size│ │
+// ││ ├─────────────────┤ │
+// ││ │  block meta n   ┼─┘
+// ││ ├─────────────────┤
+// └┼─┼ filter offset   │
+//  │ ├─────────────────┤
+//  │ │  filter size    │
+//  │ ├─────────────────┤
+//  └─┼  meta offset    │
 //    └─────────────────┘
+// The filter block is a `ObBloomfilter` of the user keys in the sstable,
+// its size is 0 if the sstable is built without filter.
 
 /**
  * @class ObSSTable
@@ -63,33 +73,68 @@ public:
    * @param sst_id A unique identifier for the SSTable.
    * @param file_name The name of the file storing the SSTable data.
    * @param comparator A pointer to the comparator used for key comparison.
-   * @param block_cache A pointer to the LRU block cache for caching block-level data.
+   * @param block_cache A pointer to the LRU block cache for caching block-level data. If it is
+   * null the blocks are not cached, they are only pinned by the handles of their readers.
+   * @param use_mmap Whether the file is mapped into memory, the uncompressed blocks then
+   * reference the file memory instead of copies of it.
    */
   ObSSTable(uint32_t sst_id, const string &file_name, const ObComparator *comparator,
-      ObLRUCache<uint64_t, shared_ptr<ObBlock>> *block_cache)
+      ObLRUCache<uint64_t, shared_ptr<ObBlock>> *block_cache, bool use_mmap = false)
       : sst_id_(sst_id),
         file_name_(file_name),
         comparator_(comparator),
+        use_mmap_(use_mmap),
         file_reader_(nullptr),
         block_cache_(block_cache)
   {
-    (void)block_cache_;
+    if (block_cache_ == nullptr) {
+      // a cache with capacity 0 keeps nothing, the handle returned by insert owns the block
+      uncached_blocks_ = make_unique<ObLRUCache<uint64_t, shared_ptr<ObBlock>>>(0);
+      block_cache_     = uncached_blocks_.get();
+    }
   }
 
-  ~ObSSTable() = default;
+  /**
+   * @brief Removes the file of the SSTable if it has been marked obsolete.
+   */
+  ~ObSSTable();
 
   /**
    * @brief Initializes the SSTable instance.
    *
    * This function is responsible for performing setup tasks required for the SSTable,
-   * such as preparing file readers or pre-loading block_metas_.
+   * such as preparing file readers or pre-loading block_metas_ and the bloom filter.
    *
    * @warning This function must be called before performing any operations on the SSTable.
    */
-  void init();
+  RC init();
+
+  /**
+   * @brief Checks the bloom filter of the SSTable.
+   *
+   * @param user_key The user key (without sequence) to look up.
+   * @return `false` if the key is definitely not in the SSTable, `true` if it may be
+   * (or the SSTable has no filter).
+   */
+  bool may_contain(const string_view &user_key) const
+  {
+    return filter_ == nullptr || filter_->contains(user_key);
+  }
 
   uint32_t sst_id() const { return sst_id_; }
 
+  /**
+   * @brief Looks up the newest version of a key which is visible to the sequence in the lookup key.
+   *
+   * Checks the bloom filter first, then reads the only block which may contain the key.
+   *
+   * @param lookup_key The lookup key (see `extract_user_key_from_lookup_key`).
+   * @param value The value of the key if it is found.
+   * @return `RC::SUCCESS` if a value is found, `RC::NOT_EXIST` if the key is deleted,
+   * `RC::NOTFOUND` if the SSTable has no visible version of the key.
+   */
+  RC get(const string_view &lookup_key, string *value) const;
+
   shared_ptr<ObSSTable> get_shared_ptr() { return shared_from_this(); }
 
   ObLsmIterator *new_iterator();
@@ -101,10 +146,12 @@ public:
    * in the cache, it will load the block from the SSTable file and update the cache.
    *
    * @param block_idx The index of the block to read.
+   * @param handle Pins the block in the cache until the handle is released, so a block in use
+   * is never evicted. The block is accessed through `handle.value()`.
    *
-   * @return shared_ptr<ObBlock> A shared pointer to the requested block.
+   * @return RC::SUCCESS if the block is read, RC::IOERR_READ otherwise.
    */
-  shared_ptr<ObBlock> read_block_with_cache(uint32_t block_idx) const;
+  RC read_block_with_cache(uint32_t block_idx, ObLRUCache<uint64_t, shared_ptr<ObBlock>>::Handle &handle) const;
 
   /**
    * @brief Reads a block directly from the SSTable file.
@@ -124,20 +171,39 @@ public:
 
   const BlockMeta block_meta(int i) const { return block_metas_[i]; }
 
+  /**
+   * @brief Hints that the data blocks are going to be scanned in order, e.g. by a compaction.
+   */
+  void advise_sequential_reads();
+
   const ObComparator *comparator() const { return comparator_; }
 
   void   remove();
+
+  /**
+   * @brief Marks the SSTable as no longer a part of the LSM-Tree (e.g. it has been compacted).
+   * @details The file is removed when the last reference of the SSTable is released, so the
+   * readers which still use an old version of the LSM-Tree are not affected.
+   */
+  void   mark_obsolete() { obsolete_.store(true); }
   string first_key() const { return block_metas_.empty() ? "" : block_metas_[0].first_key_; }
   string last_key() const { return block_metas_.empty() ? "" : block_metas_.back().last_key_; }
 
 private:
-  uint32_t                 sst_id_;
-  string                   file_name_;
-  const ObComparator      *comparator_ = nullptr;
-  unique_ptr<ObFileReader> file_reader_;
-  vector<BlockMeta>        block_metas_;
+  uint32_t                  sst_id_;
+  string                    file_name_;
+  const ObComparator       *comparator_ = nullptr;
+  bool                      use_mmap_   = false;
+  // shared with the blocks which reference the mapped file
+  shared_ptr<ObFileReader>  file_reader_;
+  vector<BlockMeta>         block_metas_;
+  unique_ptr<ObBloomfilter> filter_;
+  ObInternalKeyComparator   internal_comparator_;
+  atomic<bool>              obsolete_{false};
 
   ObLRUCache<uint64_t, shared_ptr<ObBlock>> *block_cache_;
+  // used as `block_cache_` if no block cache is given
+  unique_ptr<ObLRUCache<uint64_t, shared_ptr<ObBlock>>> uncached_blocks_;
 };
 
 class TableIterator : public ObLsmIterator
@@ -155,13 +221,18 @@ public:
   string_view value() const override { return block_iterator_->value(); }
 
 private:
-  void read_block_with_cache();
+  /**
+   * @brief Reads the current block and creates the iterator of it.
+   * @return false if the block can't be read, the iterator is then invalid.
+   */
+  bool read_block_with_cache();
 
   const shared_ptr<ObSSTable> sst_;
   uint32_t                    block_cnt_      = 0;
   uint32_t                    curr_block_idx_ = 0;
-  shared_ptr<ObBlock>         block_;
-  unique_ptr<ObLsmIterator>   block_iterator_;
+  // pins the current block in the block cache while iterating it
+  ObLRUCache<uint64_t, shared_ptr<ObBlock>>::Handle block_handle_;
+  unique_ptr<ObLsmIterator>                         block_iterator_;
 };
 
 using SSTablesPtr = shared_ptr<vector<vector<shared_ptr<ObSSTable>>>>;
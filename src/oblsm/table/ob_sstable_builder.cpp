@@ -10,31 +10,155 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/table/ob_sstable_builder.h"
 #include "oblsm/util/ob_coding.h"
+#include "oblsm/util/ob_bloomfilter.h"
+#include "oblsm/util/ob_compression.h"
+#include "common/log/log.h"
 
 namespace oceanbase {
 
 // TODO: refactor build with mem_table/iterator logic.
 RC ObSSTableBuilder::build(shared_ptr<ObMemTable> mem_table, const std::string &file_name, uint32_t sst_id)
 {
-  return RC::UNIMPLEMENTED;
+  RC rc = open(file_name, sst_id);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  unique_ptr<ObLsmIterator> iter(mem_table->new_iterator());
+  for (iter->seek_to_first(); iter->valid(); iter->next()) {
+    rc = add(iter->key(), iter->value());
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+  return finish();
+}
+
+RC ObSSTableBuilder::open(const string &file_name, uint32_t sst_id)
+{
+  reset();
+  sst_id_      = sst_id;
+  file_writer_ = ObFileWriter::create_file_writer(file_name, false /*append*/);
+  if (file_writer_ == nullptr) {
+    LOG_WARN("Failed to create sstable file %s", file_name.c_str());
+    return RC::IOERR_OPEN;
+  }
+  file_writer_->set_rate_limiter(rate_limiter_);
+  return RC::SUCCESS;
+}
+
+RC ObSSTableBuilder::add(const string_view &key, const string_view &value)
+{
+  if (block_builder_.empty()) {
+    curr_blk_first_key_.assign(key.data(), key.size());
+  }
+  RC rc = block_builder_.add(key, value);
+  if (rc == RC::FULL) {
+    rc = finish_build_block();
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    curr_blk_first_key_.assign(key.data(), key.size());
+    rc = block_builder_.add(key, value);
+  }
+  if (OB_FAIL(rc)) {
+    LOG_WARN("Failed to add kv to sstable %u, rc=%s", sst_id_, strrc(rc));
+    return rc;
+  }
+
+  // several versions of a user key are adjacent, only hash it once.
+  if (options_.bloom_bits_per_key > 0) {
+    string_view user_key = extract_user_key(key);
+    if (key_hashes_.empty() || user_key != last_user_key_) {
+      key_hashes_.push_back(ObBloomfilter::hash(user_key));
+      last_user_key_.assign(user_key.data(), user_key.size());
+    }
+  }
+  return RC::SUCCESS;
 }
 
-void ObSSTableBuilder::finish_build_block()
+RC ObSSTableBuilder::finish_build_block()
 {
-  string      last_key       = block_builder_.last_key();
-  string_view block_contents = block_builder_.finish();
-  file_writer_->write(block_contents);
-  block_metas_.push_back(BlockMeta(curr_blk_first_key_, last_key, curr_offset_, block_contents.size()));
+  string            last_key       = block_builder_.last_key();
+  string_view       block_contents = block_builder_.finish();
+  ObCompressionType compression    = ObCompressionType::NONE;
+  if (const ObCompressor *compressor = ObCompressor::get(compression_); compressor != nullptr) {
+    compressor->compress(block_contents, &compressed_);
+    if (compressed_.size() < block_contents.size() - block_contents.size() / 8) {
+      block_contents = compressed_;
+      compression    = compression_;
+    }
+  }
+  RC rc = file_writer_->write(block_contents);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("Failed to write block of sstable %u, rc=%s", sst_id_, strrc(rc));
+    return rc;
+  }
+  block_metas_.push_back(BlockMeta(curr_blk_first_key_, last_key, curr_offset_, block_contents.size(), compression));
   // TODO: block aligned to BLOCK_SIZE
   curr_offset_ += block_contents.size();
   block_builder_.reset();
+  return RC::SUCCESS;
+}
+
+RC ObSSTableBuilder::finish()
+{
+  RC rc = RC::SUCCESS;
+  if (!block_builder_.empty()) {
+    rc = finish_build_block();
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+
+  string tail;
+  // filter block
+  uint32_t filter_offset = curr_offset_;
+  uint32_t filter_size   = 0;
+  if (options_.bloom_bits_per_key > 0) {
+    ObBloomfilter filter = ObBloomfilter::create(key_hashes_.size(), options_.bloom_bits_per_key);
+    for (uint64_t h : key_hashes_) {
+      filter.insert_hash(h);
+    }
+    tail        = filter.encode();
+    filter_size = tail.size();
+  }
+
+  // block metas
+  uint32_t meta_offset = filter_offset + filter_size;
+  put_numeric<uint32_t>(&tail, block_metas_.size());
+  for (const BlockMeta &meta : block_metas_) {
+    string encoded = meta.encode();
+    put_numeric<uint32_t>(&tail, encoded.size());
+    tail.append(encoded);
+  }
+
+  // footer
+  put_numeric<uint32_t>(&tail, filter_offset);
+  put_numeric<uint32_t>(&tail, filter_size);
+  put_numeric<uint32_t>(&tail, meta_offset);
+
+  rc = file_writer_->write(tail);
+  if (OB_SUCC(rc)) {
+    rc = file_writer_->sync();
+  }
+  if (OB_FAIL(rc)) {
+    LOG_WARN("Failed to finish sstable %u, rc=%s", sst_id_, strrc(rc));
+    return rc;
+  }
+  file_size_ = curr_offset_ + tail.size();
+  return RC::SUCCESS;
 }
 
 shared_ptr<ObSSTable> ObSSTableBuilder::get_built_table()
 {
   // TODO: sstable should have more metadata
-  shared_ptr<ObSSTable> sstable = make_shared<ObSSTable>(sst_id_, file_writer_->file_name(), comparator_, block_cache_);
-  sstable->init();
+  shared_ptr<ObSSTable> sstable = make_shared<ObSSTable>(
+      sst_id_, file_writer_->file_name(), comparator_, block_cache_, options_.use_mmap_reads);
+  RC rc = sstable->init();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("Failed to init sstable %u, rc=%s", sst_id_, strrc(rc));
+  }
   return sstable;
 }
 
@@ -46,6 +170,8 @@ void ObSSTableBuilder::reset()
     file_writer_.reset(nullptr);
   }
   block_metas_.clear();
+  key_hashes_.clear();
+  last_user_key_.clear();
   curr_offset_ = 0;
   sst_id_      = 0;
   file_size_   = 0;
@@ -18,6 +18,7 @@ See the Mulan PSL v2 for more details. */
 #include "oblsm/table/ob_block.h"
 #include "oblsm/table/ob_sstable.h"
 #include "oblsm/util/ob_lru_cache.h"
+#include "oblsm/include/ob_lsm_options.h"
 
 namespace oceanbase {
 
@@ -27,8 +28,12 @@ namespace oceanbase {
 class ObSSTableBuilder
 {
 public:
-  ObSSTableBuilder(const ObComparator *comparator, ObLRUCache<uint64_t, shared_ptr<ObBlock>> *block_cache)
-      : comparator_(comparator), block_cache_(block_cache)
+  ObSSTableBuilder(const ObComparator *comparator, ObLRUCache<uint64_t, shared_ptr<ObBlock>> *block_cache,
+      const ObLsmOptions &options = ObLsmOptions())
+      : comparator_(comparator),
+        options_(options),
+        block_builder_(options.block_restart_interval),
+        block_cache_(block_cache)
   {}
   ~ObSSTableBuilder() = default;
 
@@ -50,18 +55,58 @@ public:
   shared_ptr<ObSSTable> get_built_table();
   void                  reset();
 
+  /**
+   * @brief Starts building an SSTable incrementally, the entries are appended by `add()`
+   * and the SSTable is completed by `finish()`.
+   */
+  RC open(const string &file_name, uint32_t sst_id);
+
+  /**
+   * @brief Appends an entry, the keys must be internal keys in ascending order.
+   */
+  RC add(const string_view &key, const string_view &value);
+
+  /**
+   * @brief Writes the last block, the filter block, the block metas and the footer.
+   */
+  RC finish();
+
+  /**
+   * @brief The size of the data added so far, it doesn't include the filter and the metas.
+   */
+  size_t approximate_size() { return curr_offset_ + block_builder_.appro_size(); }
+
+  /**
+   * @brief Limits the write rate of the SSTables built afterwards, nullptr means unlimited.
+   */
+  void set_rate_limiter(ObRateLimiter *rate_limiter) { rate_limiter_ = rate_limiter; }
+
+  /**
+   * @brief Sets the codec of the data blocks of the SSTables built afterwards. A block is stored
+   * uncompressed if it doesn't shrink by 1/8.
+   */
+  void set_compression(ObCompressionType compression) { compression_ = compression; }
+
 private:
-  void finish_build_block();
+  RC finish_build_block();
 
   const ObComparator      *comparator_ = nullptr;
+  ObLsmOptions             options_;
   ObBlockBuilder           block_builder_;
   string                   curr_blk_first_key_;
   unique_ptr<ObFileWriter> file_writer_;
   vector<BlockMeta>        block_metas_;
+  // hashes of the user keys, the bloom filter is sized by their count in `finish()`
+  vector<uint64_t>         key_hashes_;
+  string                   last_user_key_;
+  ObCompressionType        compression_ = ObCompressionType::NONE;
+  // buffer of the compressed block
+  string                   compressed_;
   uint32_t                 curr_offset_ = 0;
   uint32_t                 sst_id_      = 0;
   size_t                   file_size_   = 0;
 
-  ObLRUCache<uint64_t, shared_ptr<ObBlock>> *block_cache_ = nullptr;
+  ObLRUCache<uint64_t, shared_ptr<ObBlock>> *block_cache_  = nullptr;
+  ObRateLimiter                             *rate_limiter_ = nullptr;
 };
 }  // namespace oceanbase
@@ -6,12 +6,16 @@
 
 namespace oceanbase {
 
-ObArena::ObArena() : memory_usage_(0) {}
+ObArena::ObArena() : blocks_(nullptr), memory_usage_(0) {}
 
 ObArena::~ObArena()
 {
-  for (size_t i = 0; i < blocks_.size(); i++) {
-    delete[] blocks_[i];
+  char *block = blocks_.load(std::memory_order_acquire);
+  while (block != nullptr) {
+    char *next = nullptr;
+    memcpy(&next, block, sizeof(char *));
+    delete[] block;
+    block = next;
   }
 }
 
@@ -11,8 +11,8 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include <cassert>
+#include <cstring>
 #include "common/lang/atomic.h"
-#include "common/lang/vector.h"
 
 namespace oceanbase {
 
@@ -20,7 +20,8 @@ namespace oceanbase {
  * @brief a simple memory allocator.
  * @todo optimize fractional memory allocation
  * @note 1. alloc memory from arena, no need to free it.
- *       2. not thread-safe.
+ *       2. thread-safe, every block is pushed into a lock-free list, so it can be
+ *          used by concurrent memtable writers.
  */
 class ObArena
 {
@@ -34,14 +35,15 @@ public:
 
   char *alloc(size_t bytes);
 
-  size_t memory_usage() const { return memory_usage_; }
+  size_t memory_usage() const { return memory_usage_.load(std::memory_order_relaxed); }
 
 private:
-  // Array of new[] allocated memory blocks
-  vector<char *> blocks_;
+  // Singly linked list of new[] allocated memory blocks, the first
+  // sizeof(char *) bytes of each block point to the next block.
+  atomic<char *> blocks_;
 
   // Total memory usage of the arena.
-  size_t memory_usage_;
+  atomic<size_t> memory_usage_;
 };
 
 inline char *ObArena::alloc(size_t bytes)
@@ -49,10 +51,13 @@ inline char *ObArena::alloc(size_t bytes)
   if (bytes <= 0) {
     return nullptr;
   }
-  char *result = new char[bytes];
-  blocks_.push_back(result);
-  memory_usage_ += bytes + sizeof(char *);
-  return result;
+  char *block = new char[sizeof(char *) + bytes];
+  char *head  = blocks_.load(std::memory_order_relaxed);
+  do {
+    memcpy(block, &head, sizeof(char *));
+  } while (!blocks_.compare_exchange_weak(head, block, std::memory_order_release, std::memory_order_relaxed));
+  memory_usage_.fetch_add(bytes + sizeof(char *), std::memory_order_relaxed);
+  return block + sizeof(char *);
 }
 
 }  // namespace oceanbase
@@ -10,4 +10,135 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/util/ob_bloomfilter.h"
 
-namespace oceanbase {}  // namespace oceanbase
+#include "common/lang/algorithm.h"
+#include "common/log/log.h"
+#include "oblsm/util/ob_coding.h"
+
+namespace oceanbase {
+
+ObBloomfilter::ObBloomfilter(size_t hash_func_count, size_t totoal_bits)
+    : hash_func_count_(max<size_t>(1, hash_func_count)),
+      block_count_(max<size_t>(1, (totoal_bits + BLOCK_BITS - 1) / BLOCK_BITS)),
+      words_(block_count_ * BLOCK_WORDS)
+{}
+
+ObBloomfilter ObBloomfilter::create(size_t key_count, size_t bits_per_key)
+{
+  // 0.69 =~ ln(2)
+  size_t hash_func_count = min<size_t>(30, max<size_t>(1, static_cast<size_t>(bits_per_key * 0.69)));
+  return ObBloomfilter(hash_func_count, key_count * bits_per_key);
+}
+
+ObBloomfilter::ObBloomfilter(ObBloomfilter &&other) noexcept
+    : hash_func_count_(other.hash_func_count_),
+      block_count_(other.block_count_),
+      words_(std::move(other.words_)),
+      object_count_(other.object_count_.load())
+{}
+
+ObBloomfilter &ObBloomfilter::operator=(ObBloomfilter &&other) noexcept
+{
+  if (this != &other) {
+    hash_func_count_ = other.hash_func_count_;
+    block_count_     = other.block_count_;
+    words_           = std::move(other.words_);
+    object_count_.store(other.object_count_.load());
+  }
+  return *this;
+}
+
+uint64_t ObBloomfilter::hash(string_view object)
+{
+  // FNV-1a followed by the murmur3 finalizer to spread the bits.
+  uint64_t h = 14695981039346656037ULL;
+  for (char c : object) {
+    h ^= static_cast<uint8_t>(c);
+    h *= 1099511628211ULL;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdULL;
+  h ^= h >> 33;
+  h *= 0xc4ceb9fe1a85ec53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+void ObBloomfilter::insert_hash(uint64_t h)
+{
+  atomic<uint64_t> *block = &words_[(h >> 32) % block_count_ * BLOCK_WORDS];
+  // double hashing inside the block, like leveldb does for the whole filter.
+  uint32_t h1    = static_cast<uint32_t>(h);
+  uint32_t delta = (h1 >> 17) | (h1 << 15);
+  for (size_t i = 0; i < hash_func_count_; i++) {
+    uint32_t bit = h1 % BLOCK_BITS;
+    block[bit / 64].fetch_or(1ULL << (bit % 64), std::memory_order_relaxed);
+    h1 += delta;
+  }
+  object_count_.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool ObBloomfilter::contains_hash(uint64_t h) const
+{
+  const atomic<uint64_t> *block = &words_[(h >> 32) % block_count_ * BLOCK_WORDS];
+  uint32_t                h1    = static_cast<uint32_t>(h);
+  uint32_t                delta = (h1 >> 17) | (h1 << 15);
+  for (size_t i = 0; i < hash_func_count_; i++) {
+    uint32_t bit = h1 % BLOCK_BITS;
+    if ((block[bit / 64].load(std::memory_order_relaxed) & (1ULL << (bit % 64))) == 0) {
+      return false;
+    }
+    h1 += delta;
+  }
+  return true;
+}
+
+void ObBloomfilter::clear()
+{
+  for (auto &word : words_) {
+    word.store(0, std::memory_order_relaxed);
+  }
+  object_count_.store(0);
+}
+
+string ObBloomfilter::encode() const
+{
+  string ret;
+  ret.reserve(sizeof(uint32_t) * 2 + sizeof(uint64_t) * (1 + words_.size()));
+  put_numeric<uint32_t>(&ret, hash_func_count_);
+  put_numeric<uint32_t>(&ret, block_count_);
+  put_numeric<uint64_t>(&ret, object_count());
+  for (const auto &word : words_) {
+    put_numeric<uint64_t>(&ret, word.load(std::memory_order_relaxed));
+  }
+  return ret;
+}
+
+RC ObBloomfilter::decode(string_view data)
+{
+  const size_t header_size = sizeof(uint32_t) * 2 + sizeof(uint64_t);
+  if (data.size() < header_size) {
+    LOG_WARN("invalid bloom filter, size=%lu", data.size());
+    return RC::INTERNAL;
+  }
+  uint32_t hash_func_count = get_numeric<uint32_t>(data.data());
+  uint32_t block_count     = get_numeric<uint32_t>(data.data() + sizeof(uint32_t));
+  uint64_t object_count    = get_numeric<uint64_t>(data.data() + sizeof(uint32_t) * 2);
+  if (hash_func_count == 0 || block_count == 0 ||
+      data.size() != header_size + sizeof(uint64_t) * BLOCK_WORDS * block_count) {
+    LOG_WARN("invalid bloom filter, size=%lu, block count=%u", data.size(), block_count);
+    return RC::INTERNAL;
+  }
+
+  hash_func_count_ = hash_func_count;
+  block_count_     = block_count;
+  words_           = vector<atomic<uint64_t>>(block_count_ * BLOCK_WORDS);
+  const char *p    = data.data() + header_size;
+  for (auto &word : words_) {
+    word.store(get_numeric<uint64_t>(p), std::memory_order_relaxed);
+    p += sizeof(uint64_t);
+  }
+  object_count_.store(object_count);
+  return RC::SUCCESS;
+}
+
+}  // namespace oceanbase
@@ -10,12 +10,25 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/lang/atomic.h"
 #include "common/lang/string.h"
+#include "common/lang/string_view.h"
+#include "common/lang/vector.h"
+#include "common/sys/rc.h"
+
 namespace oceanbase {
 
 /**
  * @class ObBloomfilter
- * @brief A simple Bloom filter implementation(Need to support concurrency).
+ * @brief A cache-line-blocked Bloom filter.
+ *
+ * The bit array is split into blocks of one cache line (512 bits). The high half of a key's
+ * hash selects the block, all the `hash_func_count` probes of the key are then made inside
+ * that block. So a lookup touches exactly one cache line, no matter how many hash functions
+ * are used, at the cost of a slightly higher false positive rate than a standard filter of
+ * the same size.
+ *
+ * `insert` and `contains` can be called concurrently, bits are set with atomic or.
  */
 class ObBloomfilter
 {
@@ -24,23 +37,45 @@ public:
    * @brief Constructs a Bloom filter with specified parameters.
    *
    * @param hash_func_count Number of hash functions to use. Default is 4.
-   * @param totoal_bits Total number of bits in the Bloom filter. Default is 65536.
+   * @param totoal_bits Total number of bits in the Bloom filter, rounded up to a multiple of
+   * the block size. Default is 65536.
+   */
+  ObBloomfilter(size_t hash_func_count = 4, size_t totoal_bits = 65536);
+
+  /**
+   * @brief Creates a filter sized for `key_count` keys with `bits_per_key` bits each.
+   * @details The number of hash functions is `bits_per_key * ln(2)`, which minimizes the
+   * false positive rate.
    */
-  ObBloomfilter(size_t hash_func_count = 4, size_t totoal_bits = 65536) {}
+  static ObBloomfilter create(size_t key_count, size_t bits_per_key);
+
+  ObBloomfilter(ObBloomfilter &&other) noexcept;
+  ObBloomfilter &operator=(ObBloomfilter &&other) noexcept;
+
+  /**
+   * @brief The hash function used by the filter, it is stable across processes
+   * so the hashes can be persisted.
+   */
+  static uint64_t hash(string_view object);
 
   /**
    * @brief Inserts an object into the Bloom filter.
    * @details This method computes hash values for the given object and sets corresponding bits in the filter.
    * @param object The object to be inserted.
    */
-  void insert(const string &object) {}
+  void insert(string_view object) { insert_hash(hash(object)); }
+
+  /**
+   * @brief Inserts an object by its hash value computed by `hash()`.
+   */
+  void insert_hash(uint64_t h);
 
   /**
    * @brief Clears all entries in the Bloom filter.
    *
    * @details Resets the filter, removing all previously inserted objects.
    */
-  void clear() {}
+  void clear();
 
   /**
    * @brief Checks if an object is possibly in the Bloom filter.
@@ -48,12 +83,17 @@ public:
    * @param object The object to be checked.
    * @return true if the object might be in the filter, false if definitely not.
    */
-  bool contains(const string &object) const { return false; }
+  bool contains(string_view object) const { return contains_hash(hash(object)); }
+
+  /**
+   * @brief Checks an object by its hash value computed by `hash()`.
+   */
+  bool contains_hash(uint64_t h) const;
 
   /**
    * @brief Returns the count of objects inserted into the Bloom filter.
    */
-  size_t object_count() const { return 0; }
+  size_t object_count() const { return object_count_.load(std::memory_order_relaxed); }
 
   /**
    * @brief Checks if the Bloom filter is empty.
@@ -61,7 +101,25 @@ public:
    */
   bool empty() const { return 0 == object_count(); }
 
+  /**
+   * @brief Serializes the filter.
+   * @details Format: | hash_func_count(u32) | block_count(u32) | object_count(u64) | words(u64 * 8 * block_count) |
+   */
+  string encode() const;
+
+  /**
+   * @brief Rebuilds the filter from the data produced by `encode()`.
+   */
+  RC decode(string_view data);
+
 private:
+  static constexpr size_t BLOCK_BITS  = 512;
+  static constexpr size_t BLOCK_WORDS = BLOCK_BITS / 64;
+
+  size_t                   hash_func_count_ = 0;
+  size_t                   block_count_     = 0;
+  vector<atomic<uint64_t>> words_;
+  atomic<size_t>           object_count_{0};
 };
 
 }  // namespace oceanbase
@@ -51,6 +51,37 @@ T get_numeric(const char *src)
   return value;
 }
 
+/**
+ * @brief Appends a 32-bit value in variable length format, 7 bits per byte with the high bit
+ * set on all the bytes but the last one. It takes 1 byte for values below 128 and 5 bytes at most.
+ */
+inline void put_varint32(string *dst, uint32_t v)
+{
+  while (v >= 0x80) {
+    dst->push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  dst->push_back(static_cast<char>(v));
+}
+
+/**
+ * @brief Decodes a value written by `put_varint32` from [`p`, `limit`).
+ * @return The position after the value, or nullptr if the value is truncated or malformed.
+ */
+inline const char *get_varint32(const char *p, const char *limit, uint32_t *value)
+{
+  uint32_t result = 0;
+  for (uint32_t shift = 0; shift <= 28 && p < limit; shift += 7) {
+    uint32_t byte = static_cast<unsigned char>(*p++);
+    result |= (byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) {
+      *value = result;
+      return p;
+    }
+  }
+  return nullptr;
+}
+
 /**
  * @brief Extracts the user key portion from an internal key.
  *
@@ -0,0 +1,196 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "oblsm/util/ob_compression.h"
+
+#include "common/lang/algorithm.h"
+#include "common/lang/vector.h"
+#include "common/log/log.h"
+#include "oblsm/util/ob_coding.h"
+
+namespace oceanbase {
+
+namespace {
+
+constexpr size_t   MIN_MATCH     = 4;
+constexpr size_t   MAX_OFFSET    = 65535;
+// a match doesn't cover the last bytes and doesn't start close to the end, like LZ4.
+constexpr size_t   LAST_LITERALS = 5;
+constexpr size_t   MF_LIMIT      = 12;
+constexpr uint32_t HASH_LOG      = 12;
+constexpr uint32_t SKIP_TRIGGER  = 6;
+constexpr uint8_t  RUN_MASK      = 15;
+
+inline uint32_t load32(const char *p) { return get_numeric<uint32_t>(p); }
+
+inline uint32_t hash4(uint32_t v) { return (v * 2654435761U) >> (32 - HASH_LOG); }
+
+inline void put_length(string *dst, size_t len)
+{
+  for (; len >= 255; len -= 255) {
+    dst->push_back(static_cast<char>(255));
+  }
+  dst->push_back(static_cast<char>(len));
+}
+
+void put_sequence(string *dst, const char *literals, size_t literal_len, size_t offset, size_t match_len)
+{
+  const size_t match_code = match_len - MIN_MATCH;
+  uint8_t      token      = static_cast<uint8_t>(min<size_t>(literal_len, RUN_MASK) << 4);
+  token |= static_cast<uint8_t>(min<size_t>(match_code, RUN_MASK));
+  dst->push_back(static_cast<char>(token));
+  if (literal_len >= RUN_MASK) {
+    put_length(dst, literal_len - RUN_MASK);
+  }
+  dst->append(literals, literal_len);
+  put_numeric<uint16_t>(dst, static_cast<uint16_t>(offset));
+  if (match_code >= RUN_MASK) {
+    put_length(dst, match_code - RUN_MASK);
+  }
+}
+
+void put_last_literals(string *dst, const char *literals, size_t literal_len)
+{
+  dst->push_back(static_cast<char>(min<size_t>(literal_len, RUN_MASK) << 4));
+  if (literal_len >= RUN_MASK) {
+    put_length(dst, literal_len - RUN_MASK);
+  }
+  dst->append(literals, literal_len);
+}
+
+// returns false if the length runs beyond `limit`
+inline bool get_length(const char *&p, const char *limit, size_t *len)
+{
+  uint8_t byte = 255;
+  while (byte == 255) {
+    if (p >= limit) {
+      return false;
+    }
+    byte = static_cast<uint8_t>(*p++);
+    *len += byte;
+  }
+  return true;
+}
+
+}  // namespace
+
+const ObCompressor *ObCompressor::get(ObCompressionType type)
+{
+  static const ObLz4Compressor lz4;
+  switch (type) {
+    case ObCompressionType::LZ4: return &lz4;
+    default: return nullptr;
+  }
+}
+
+void ObLz4Compressor::compress(string_view input, string *output) const
+{
+  output->clear();
+  output->reserve(input.size() + input.size() / 255 + 16);
+  put_varint32(output, input.size());
+
+  const char  *src    = input.data();
+  const size_t size   = input.size();
+  size_t       anchor = 0;
+  if (size > MF_LIMIT) {
+    // positions + 1 of the last 4-byte prefixes with each hash, 0 means empty
+    vector<uint32_t> table(1 << HASH_LOG, 0);
+    const size_t     match_start_limit = size - MF_LIMIT;
+    const size_t     match_end_limit   = size - LAST_LITERALS;
+    size_t           pos               = 0;
+    while (pos < match_start_limit) {
+      const uint32_t seq       = load32(src + pos);
+      const uint32_t h         = hash4(seq);
+      const size_t   candidate = table[h];
+      table[h]                 = pos + 1;
+      if (candidate == 0 || pos + 1 - candidate > MAX_OFFSET || load32(src + candidate - 1) != seq) {
+        // skip faster in the data which doesn't compress
+        pos += 1 + ((pos - anchor) >> SKIP_TRIGGER);
+        continue;
+      }
+      size_t match = candidate - 1;
+      // extend the match backwards over the pending literals
+      while (pos > anchor && match > 0 && src[pos - 1] == src[match - 1]) {
+        pos--;
+        match--;
+      }
+      size_t match_len = MIN_MATCH;
+      while (pos + match_len < match_end_limit && src[match + match_len] == src[pos + match_len]) {
+        match_len++;
+      }
+      put_sequence(output, src + anchor, pos - anchor, pos - match, match_len);
+      pos += match_len;
+      anchor = pos;
+      // the position before the next one is likely the start of a match too
+      if (pos - 2 < match_start_limit) {
+        table[hash4(load32(src + pos - 2))] = pos - 1;
+      }
+    }
+  }
+  put_last_literals(output, src + anchor, size - anchor);
+}
+
+RC ObLz4Compressor::decompress(string_view input, string *output) const
+{
+  const char *p        = input.data();
+  const char *limit    = input.data() + input.size();
+  uint32_t    raw_size = 0;
+  if ((p = get_varint32(p, limit, &raw_size)) == nullptr) {
+    LOG_WARN("corrupted compressed data, invalid raw size");
+    return RC::INTERNAL;
+  }
+  output->clear();
+  output->reserve(raw_size);
+  while (p < limit) {
+    const uint8_t token       = static_cast<uint8_t>(*p++);
+    size_t        literal_len = token >> 4;
+    if (literal_len == RUN_MASK && !get_length(p, limit, &literal_len)) {
+      break;
+    }
+    if (static_cast<size_t>(limit - p) < literal_len || output->size() + literal_len > raw_size) {
+      break;
+    }
+    output->append(p, literal_len);
+    p += literal_len;
+    if (p == limit) {
+      // the last sequence has literals only
+      if (output->size() == raw_size) {
+        return RC::SUCCESS;
+      }
+      break;
+    }
+
+    if (limit - p < 2) {
+      break;
+    }
+    const size_t offset = get_numeric<uint16_t>(p);
+    p += 2;
+    size_t match_len = token & RUN_MASK;
+    if (match_len == RUN_MASK && !get_length(p, limit, &match_len)) {
+      break;
+    }
+    match_len += MIN_MATCH;
+    if (offset == 0 || offset > output->size() || output->size() + match_len > raw_size) {
+      break;
+    }
+    // the match may overlap the bytes it produces, copy it in pieces of at most `offset` bytes
+    size_t from = output->size() - offset;
+    while (match_len > 0) {
+      const size_t n = min(match_len, offset);
+      output->append(*output, from, n);
+      from += n;
+      match_len -= n;
+    }
+  }
+  LOG_WARN("corrupted compressed data, raw size=%u, decompressed=%lu", raw_size, output->size());
+  return RC::INTERNAL;
+}
+
+}  // namespace oceanbase
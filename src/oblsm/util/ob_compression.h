@@ -0,0 +1,70 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/string.h"
+#include "common/lang/string_view.h"
+#include "common/sys/rc.h"
+#include "oblsm/ob_lsm_define.h"
+
+namespace oceanbase {
+
+/**
+ * @class ObCompressor
+ * @brief Compresses the data blocks of SSTables.
+ *
+ * Each `ObCompressionType` but `NONE` has a compressor, the type is persisted with the block
+ * so a block can always be decompressed no matter what the options are when it is read.
+ */
+class ObCompressor
+{
+public:
+  virtual ~ObCompressor() = default;
+
+  virtual ObCompressionType type() const = 0;
+
+  /**
+   * @brief Compresses `input` into `output`, the previous content of `output` is discarded.
+   */
+  virtual void compress(string_view input, string *output) const = 0;
+
+  /**
+   * @brief Decompresses the data produced by `compress` into `output`.
+   * @return RC::INTERNAL if the data is corrupted.
+   */
+  virtual RC decompress(string_view input, string *output) const = 0;
+
+  /**
+   * @brief Returns the compressor of `type`, nullptr for `NONE` or an unknown type.
+   */
+  static const ObCompressor *get(ObCompressionType type);
+};
+
+/**
+ * @class ObLz4Compressor
+ * @brief A byte-oriented LZ77 codec in the style of the LZ4 block format.
+ *
+ * Format: | raw size(varint) | sequence 1 | .. | sequence n |
+ * sequence: | token | literal length extension | literals | match offset(u16) | match length extension |
+ * The high 4 bits of the token is the literal length and the low 4 bits is the match length minus 4,
+ * 15 means the length continues with bytes of 255 until one is less than 255. The last sequence
+ * has literals only. Matches are found with a hash table of 4-byte prefixes in a 64KB window,
+ * it trades compression ratio for speed like LZ4.
+ */
+class ObLz4Compressor : public ObCompressor
+{
+public:
+  ObCompressionType type() const override { return ObCompressionType::LZ4; }
+  void              compress(string_view input, string *output) const override;
+  RC                decompress(string_view input, string *output) const override;
+};
+
+}  // namespace oceanbase
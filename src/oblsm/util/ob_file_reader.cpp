@@ -10,7 +10,10 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/util/ob_file_reader.h"
 #include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
+#include "common/lang/algorithm.h"
 #include "common/lang/filesystem.h"
 
 #include "common/log/log.h"
@@ -21,6 +24,15 @@ ObFileReader::~ObFileReader() { close_file(); }
 
 string ObFileReader::read_pos(uint32_t pos, uint32_t size)
 {
+  if (mmapped()) {
+    string_view view = read_view(pos, size);
+    if (view.size() != size) {
+      LOG_WARN("Failed to read file %s, pos=%u, size=%u, file size=%u", filename_.c_str(), pos, size, mapped_size_);
+      return "";
+    }
+    return string(view);
+  }
+
   string buf;
   buf.resize(size);
   ssize_t read_size = ::pread(fd_, buf.data(), size, static_cast<off_t>(pos));
@@ -32,14 +44,45 @@ string ObFileReader::read_pos(uint32_t pos, uint32_t size)
   return buf;
 }
 
+string_view ObFileReader::read_view(uint32_t pos, uint32_t size) const
+{
+  if (!mmapped() || static_cast<uint64_t>(pos) + size > mapped_size_) {
+    return string_view();
+  }
+  return string_view(mapped_ + pos, size);
+}
+
+void ObFileReader::advise(Advice advice, uint32_t pos, uint32_t size)
+{
+  if (mmapped()) {
+    if (pos >= mapped_size_) {
+      return;
+    }
+    // madvise needs a page aligned address
+    const uintptr_t page_size = ::sysconf(_SC_PAGESIZE);
+    const uint64_t  limit     = min<uint64_t>(static_cast<uint64_t>(pos) + size, mapped_size_);
+    const uintptr_t begin     = reinterpret_cast<uintptr_t>(mapped_ + pos) & ~(page_size - 1);
+    const uintptr_t end       = reinterpret_cast<uintptr_t>(mapped_ + limit);
+    const int       flag      = advice == Advice::SEQUENTIAL ? MADV_SEQUENTIAL : MADV_RANDOM;
+    if (::madvise(reinterpret_cast<void *>(begin), end - begin, flag) != 0) {
+      LOG_DEBUG("Failed to madvise file %s, errno=%d", filename_.c_str(), errno);
+    }
+  } else if (fd_ >= 0) {
+    ::posix_fadvise(fd_, pos, size, advice == Advice::SEQUENTIAL ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+  }
+}
+
 uint32_t ObFileReader::file_size()
 {
+  if (mmapped()) {
+    return mapped_size_;
+  }
   return filesystem::file_size(filename_);
 }
 
-unique_ptr<ObFileReader> ObFileReader::create_file_reader(const string &filename)
+unique_ptr<ObFileReader> ObFileReader::create_file_reader(const string &filename, bool use_mmap)
 {
-  unique_ptr<ObFileReader> reader(new ObFileReader(filename));
+  unique_ptr<ObFileReader> reader(new ObFileReader(filename, use_mmap));
   if (OB_FAIL(reader->open_file())) {
     LOG_WARN("Failed to open file %s", filename.c_str());
     return nullptr;
@@ -53,14 +96,41 @@ RC ObFileReader::open_file()
   fd_ = ::open(filename_.c_str(), O_RDONLY);
   if (fd_ < 0) {
     LOG_WARN("Failed to open file %s", filename_.c_str());
-    rc = RC::INTERNAL;
+    return RC::INTERNAL;
+  }
+  if (use_mmap_) {
+    struct stat st;
+    if (::fstat(fd_, &st) != 0) {
+      LOG_WARN("Failed to stat file %s, errno=%d", filename_.c_str(), errno);
+      return RC::IOERR_ACCESS;
+    }
+    // an empty file can't be mapped, it is read by pread
+    if (st.st_size > 0) {
+      void *addr = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd_, 0);
+      if (addr == MAP_FAILED) {
+        LOG_WARN("Failed to mmap file %s, size=%ld, errno=%d", filename_.c_str(), st.st_size, errno);
+        return RC::IOERR_ACCESS;
+      }
+      mapped_      = static_cast<char *>(addr);
+      mapped_size_ = st.st_size;
+      // most of the reads are point lookups, don't read ahead by default
+      advise(Advice::RANDOM, 0, mapped_size_);
+    }
   }
   return rc;
 }
 
 void ObFileReader::close_file()
 {
-  ::close(fd_);
+  if (mapped_ != nullptr) {
+    ::munmap(mapped_, mapped_size_);
+    mapped_      = nullptr;
+    mapped_size_ = 0;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
 }
 
 }  // namespace oceanbase
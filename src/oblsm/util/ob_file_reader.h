@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 #include "common/lang/memory.h"
 #include "common/lang/sstream.h"
 #include "common/lang/string.h"
+#include "common/lang/string_view.h"
 #include "common/sys/rc.h"
 #include "common/lang/mutex.h"
 
@@ -27,6 +28,10 @@ namespace oceanbase {
  * opening, closing, and reading specific portions of a file while also exposing
  * the file size for external use. This class is intended for use in scenarios where
  * file-based data storage, such as SSTables, is accessed.
+ *
+ * In mmap mode the whole file is mapped read-only when it is opened, `read_view` then returns
+ * the file memory directly without any copy. The file must not change while it is mapped,
+ * which is true for SSTables.
  */
 class ObFileReader
 {
@@ -39,7 +44,7 @@ public:
    *
    * @param filename The name of the file to be read.
    */
-  ObFileReader(const string &filename) : filename_(filename) {}
+  ObFileReader(const string &filename, bool use_mmap = false) : filename_(filename), use_mmap_(use_mmap) {}
 
   ~ObFileReader();
 
@@ -72,6 +77,27 @@ public:
    */
   string read_pos(uint32_t pos, uint32_t size);
 
+  /**
+   * @brief Returns `size` bytes of the mapped file starting from `pos` without copying them.
+   * @details Only valid in mmap mode, the view is valid as long as the reader. An empty view
+   * is returned if the range is out of the file.
+   */
+  string_view read_view(uint32_t pos, uint32_t size) const;
+
+  bool mmapped() const { return mapped_ != nullptr; }
+
+  enum class Advice
+  {
+    RANDOM,      ///< point reads, the kernel doesn't read ahead
+    SEQUENTIAL,  ///< scans, the kernel reads ahead aggressively
+  };
+
+  /**
+   * @brief Tells the kernel how [`pos`, `pos` + `size`) will be read, it is `madvise` in mmap mode
+   * and `posix_fadvise` otherwise. It is only a hint, failures are ignored.
+   */
+  void advise(Advice advice, uint32_t pos, uint32_t size);
+
   /**
    * @brief Returns the size of the file.
    *
@@ -91,7 +117,7 @@ public:
    * @param filename The name of the file to be read.
    * @return A `unique_ptr` to the created `ObFileReader` object.
    */
-  static unique_ptr<ObFileReader> create_file_reader(const string &filename);
+  static unique_ptr<ObFileReader> create_file_reader(const string &filename, bool use_mmap = false);
 
 private:
   /**
@@ -109,6 +135,11 @@ private:
    * If no file is open, it is set to `-1`.
    */
   int fd_ = -1;
+
+  bool     use_mmap_    = false;
+  // the mapped file in mmap mode, it is mapped in `open_file` and unmapped in `close_file`
+  char    *mapped_      = nullptr;
+  uint32_t mapped_size_ = 0;
 };
 
 }  // namespace oceanbase
@@ -10,52 +10,80 @@ See the Mulan PSL v2 for more details. */
 
 #include "oblsm/util/ob_file_writer.h"
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "common/io/io.h"
+#include "common/log/log.h"
+
 namespace oceanbase {
 
 ObFileWriter::~ObFileWriter() { close_file(); }
 
 RC ObFileWriter::write(const string_view &data)
 {
-  RC rc = RC::SUCCESS;
-  file_  << data;
-  if (!file_.good()) {
-    rc = RC::IOERR_WRITE;
+  if (fd_ < 0) {
+    return RC::FILE_NOT_OPENED;
+  }
+  buffer_.append(data.data(), data.size());
+  if (buffer_.size() >= BUFFER_SIZE) {
+    return flush();
   }
-  return rc;
+  return RC::SUCCESS;
 }
 
 RC ObFileWriter::flush()
 {
-  RC rc = RC::SUCCESS;
-  file_.flush();
-  if (!file_.good()) {
-    rc = RC::IOERR_SYNC;
+  if (fd_ < 0) {
+    return RC::FILE_NOT_OPENED;
+  }
+  if (buffer_.empty()) {
+    return RC::SUCCESS;
+  }
+  if (rate_limiter_ != nullptr) {
+    rate_limiter_->request(buffer_.size());
+  }
+  if (common::writen(fd_, buffer_.data(), buffer_.size()) != 0) {
+    LOG_WARN("Failed to write file %s, errno=%d:%s", filename_.c_str(), errno, strerror(errno));
+    return RC::IOERR_WRITE;
   }
-  return rc;
+  buffer_.clear();
+  return RC::SUCCESS;
 }
 
-RC ObFileWriter::open_file()
+RC ObFileWriter::sync()
 {
-  RC rc = RC::SUCCESS;
-  if (file_.is_open()) {
+  RC rc = flush();
+  if (OB_FAIL(rc)) {
     return rc;
   }
-  if (append_) {
-    file_.open(filename_, std::ios::app | std::ios::binary);
-  } else {
-    file_.open(filename_, std::ios::out | std::ios::trunc | std::ios::binary);
+  if (::fdatasync(fd_) != 0) {
+    LOG_WARN("Failed to sync file %s, errno=%d:%s", filename_.c_str(), errno, strerror(errno));
+    return RC::IOERR_SYNC;
+  }
+  return RC::SUCCESS;
+}
+
+RC ObFileWriter::open_file()
+{
+  if (fd_ >= 0) {
+    return RC::SUCCESS;
   }
-  if (!file_.good()) {
-    rc = RC::IOERR_OPEN;
+  int flags = O_WRONLY | O_CREAT | (append_ ? O_APPEND : O_TRUNC);
+  fd_       = ::open(filename_.c_str(), flags, 0644);
+  if (fd_ < 0) {
+    LOG_WARN("Failed to open file %s, errno=%d:%s", filename_.c_str(), errno, strerror(errno));
+    return RC::IOERR_OPEN;
   }
-  return rc;
+  return RC::SUCCESS;
 }
 
 void ObFileWriter::close_file()
 {
-  if (file_.is_open()) {
-    file_.flush();
-    file_.close();
+  if (fd_ >= 0) {
+    flush();
+    ::close(fd_);
+    fd_ = -1;
   }
 }
 
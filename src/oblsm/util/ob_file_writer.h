@@ -10,11 +10,11 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
-#include "common/lang/fstream.h"
 #include "common/lang/string.h"
 #include "common/lang/string_view.h"
 #include "common/lang/memory.h"
 #include "common/sys/rc.h"
+#include "oblsm/util/ob_rate_limiter.h"
 
 namespace oceanbase {
 
@@ -26,7 +26,8 @@ namespace oceanbase {
  * It supports creating and opening files for writing, appending data to existing files,
  * and flushing buffered data to disk. The class ensures proper resource management by
  * providing methods for explicitly closing the file.
- * TODO: use posix
+ * Data written by `write()` is buffered in user space, `flush()` hands it to the operating
+ * system and `sync()` additionally makes it durable with `fdatasync`.
  */
 class ObFileWriter
 {
@@ -84,12 +85,22 @@ public:
    */
   RC flush();
 
+  /**
+   * @brief Flushes buffered data and forces it to the storage device.
+   *
+   * Unlike `flush()`, the data is guaranteed to survive an operating system crash
+   * or a power loss once this method returns successfully.
+   *
+   * @return An RC (return code) indicating the success or failure of the sync operation.
+   */
+  RC sync();
+
   /**
    * @brief Checks if the file is currently open.
    *
    * @return `true` if the file is open, `false` otherwise.
    */
-  bool is_open() const { return file_.is_open(); }
+  bool is_open() const { return fd_ >= 0; }
 
   /**
    * @brief Returns the name of the file being written to.
@@ -98,6 +109,13 @@ public:
    */
   string file_name() const { return filename_; }
 
+  /**
+   * @brief Limits the rate of writing the data to the operating system, nullptr means unlimited.
+   * @details It is used by the background jobs (flush and compaction) so they don't eat up the
+   * bandwidth of the device. The limiter must outlive the writer.
+   */
+  void set_rate_limiter(ObRateLimiter *rate_limiter) { rate_limiter_ = rate_limiter; }
+
   /**
    * @brief Creates a new `ObFileWriter` instance.
    *
@@ -125,8 +143,23 @@ private:
   bool append_;
 
   /**
-   * @brief The file stream used for writing data.
+   * @brief The file descriptor of the opened file, `-1` if the file is not open.
+   */
+  int fd_ = -1;
+
+  /**
+   * @brief Data written but not handed to the operating system yet.
+   */
+  string buffer_;
+
+  /**
+   * @brief Limits the rate of `flush()`, may be null.
+   */
+  ObRateLimiter *rate_limiter_ = nullptr;
+
+  /**
+   * @brief `buffer_` is flushed once it grows beyond this size.
    */
-  ofstream file_;
+  static constexpr size_t BUFFER_SIZE = 64 * 1024;
 };
 }  // namespace oceanbase
@@ -13,6 +13,13 @@ See the Mulan PSL v2 for more details. */
 #include <stdint.h>
 #include <cstddef>
 
+#include "common/lang/atomic.h"
+#include "common/lang/functional.h"
+#include "common/lang/memory.h"
+#include "common/lang/mutex.h"
+#include "common/lang/unordered_map.h"
+#include "common/lang/utility.h"
+
 namespace oceanbase {
 
 /**
@@ -23,19 +30,104 @@ namespace oceanbase {
  * entries when the cache exceeds its capacity. It supports thread-safe operations for
  * inserting, retrieving, and checking the existence of cache entries.
  *
+ * The capacity is a budget of "charge": every entry is inserted with a charge (1 by default,
+ * so the capacity is a number of entries, the block cache charges the size of a block in bytes).
+ *
+ * The cache is split into shards by the hash of the key, each shard has its own mutex and
+ * LRU list, so lookups of different keys rarely contend. Small caches use a single shard to
+ * keep the exact LRU order.
+ *
+ * `lookup` and `insert` return a `Handle` which pins the entry: a pinned entry is never
+ * evicted (it may be replaced or erased, the handle still keeps the value alive).
+ *
  * @tparam KeyType The type of keys used to identify cache entries.
  * @tparam ValueType The type of values stored in the cache.
  */
 template <typename KeyType, typename ValueType>
 class ObLRUCache
 {
+private:
+  struct Entry
+  {
+    KeyType   key;
+    ValueType value;
+    size_t    charge   = 0;
+    uint32_t  refs     = 0;      ///< references from handles, plus one if `in_cache`
+    bool      in_cache = false;  ///< whether the entry is in the table of its shard
+    Entry    *prev     = nullptr;
+    Entry    *next     = nullptr;
+  };
+
+  class Shard;
+
 public:
+  /**
+   * @brief Pins an entry of the cache, it is released when the handle is destroyed or reset.
+   */
+  class Handle
+  {
+  public:
+    Handle() = default;
+    Handle(const Handle &)            = delete;
+    Handle &operator=(const Handle &) = delete;
+    Handle(Handle &&other) noexcept : shard_(other.shard_), entry_(other.entry_)
+    {
+      other.shard_ = nullptr;
+      other.entry_ = nullptr;
+    }
+    Handle &operator=(Handle &&other) noexcept
+    {
+      if (this != &other) {
+        reset();
+        std::swap(shard_, other.shard_);
+        std::swap(entry_, other.entry_);
+      }
+      return *this;
+    }
+    ~Handle() { reset(); }
+
+    bool             valid() const { return entry_ != nullptr; }
+    const ValueType &value() const { return entry_->value; }
+
+    void reset()
+    {
+      if (entry_ != nullptr) {
+        shard_->release(entry_);
+        shard_ = nullptr;
+        entry_ = nullptr;
+      }
+    }
+
+  private:
+    friend class ObLRUCache;
+    Handle(Shard *shard, Entry *entry) : shard_(shard), entry_(entry) {}
+
+    Shard *shard_ = nullptr;
+    Entry *entry_ = nullptr;
+  };
+
   /**
    * @brief Constructs an `ObLRUCache` with a specified capacity.
    *
-   * @param capacity The maximum number of elements the cache can hold.
+   * @param capacity The maximum total charge the cache can hold.
+   * @param num_shard_bits The cache is split into `2^num_shard_bits` shards,
+   * a negative value chooses it by the capacity.
    */
-  ObLRUCache(size_t capacity) : capacity_(capacity) {}
+  ObLRUCache(size_t capacity, int num_shard_bits = -1) : capacity_(capacity)
+  {
+    if (num_shard_bits < 0) {
+      num_shard_bits = 0;
+      while (num_shard_bits < MAX_SHARD_BITS && (capacity >> (num_shard_bits + 1)) >= MIN_SHARD_CAPACITY) {
+        num_shard_bits++;
+      }
+    }
+    num_shard_bits_ = num_shard_bits;
+    size_t num      = size_t(1) << num_shard_bits_;
+    shards_         = make_unique<Shard[]>(num);
+    for (size_t i = 0; i < num; i++) {
+      shards_[i].init(this, (capacity + num - 1) / num);
+    }
+  }
 
   /**
    * @brief Retrieves a value from the cache using the specified key.
@@ -48,7 +140,15 @@ public:
    * @param value A reference to store the value associated with the key.
    * @return `true` if the key is found and the value is retrieved; `false` otherwise.
    */
-  bool get(const KeyType &key, ValueType &value) { return false; }
+  bool get(const KeyType &key, ValueType &value)
+  {
+    Handle handle = lookup(key);
+    if (!handle.valid()) {
+      return false;
+    }
+    value = handle.value();
+    return true;
+  }
 
   /**
    * @brief Inserts a key-value pair into the cache.
@@ -59,8 +159,9 @@ public:
    *
    * @param key The key to insert into the cache.
    * @param value The value to associate with the specified key.
+   * @param charge The part of the capacity taken by the entry.
    */
-  void put(const KeyType &key, const ValueType &value) {}
+  void put(const KeyType &key, const ValueType &value, size_t charge = 1) { insert(key, value, charge); }
 
   /**
    * @brief Checks whether the specified key exists in the cache.
@@ -68,13 +169,227 @@ public:
    * @param key The key to check in the cache.
    * @return `true` if the key exists; `false` otherwise.
    */
-  bool contains(const KeyType &key) const { return false; }
+  bool contains(const KeyType &key) const { return shard(key).contains(key); }
+
+  /**
+   * @brief Looks up the key and pins the entry if found.
+   * @return A valid handle if the key is found, otherwise an invalid one.
+   */
+  Handle lookup(const KeyType &key)
+  {
+    Shard &s = shard(key);
+    return Handle(&s, s.lookup(key));
+  }
+
+  /**
+   * @brief Inserts a key-value pair (replacing the existing one) and pins the new entry.
+   */
+  Handle insert(const KeyType &key, const ValueType &value, size_t charge = 1)
+  {
+    Shard &s = shard(key);
+    return Handle(&s, s.insert(key, value, charge));
+  }
+
+  /**
+   * @brief Removes the key from the cache, handles of it are still valid.
+   */
+  void erase(const KeyType &key) { shard(key).erase(key); }
+
+  size_t capacity() const { return capacity_; }
+
+  /**
+   * @brief The total charge of the entries in the cache, pinned ones included.
+   */
+  size_t usage() const
+  {
+    size_t total = 0;
+    for (size_t i = 0; i < (size_t(1) << num_shard_bits_); i++) {
+      total += shards_[i].usage();
+    }
+    return total;
+  }
+
+  uint64_t hit_count() const { return hit_count_.load(std::memory_order_relaxed); }
+  uint64_t miss_count() const { return miss_count_.load(std::memory_order_relaxed); }
+  uint64_t eviction_count() const { return eviction_count_.load(std::memory_order_relaxed); }
 
 private:
   /**
-   * @brief The maximum number of elements the cache can hold.
+   * @brief A LRU cache protected by its own mutex.
+   * @details Entries which are only referenced by the shard itself are linked in `lru_`
+   * (the oldest is next to the head), pinned entries are unlinked so they are never evicted.
+   */
+  class Shard
+  {
+  public:
+    Shard() { lru_.prev = lru_.next = &lru_; }
+    ~Shard()
+    {
+      for (auto &[key, entry] : table_) {
+        // all handles must have been released before the cache is destroyed
+        delete entry;
+      }
+    }
+
+    void init(ObLRUCache *owner, size_t capacity)
+    {
+      owner_    = owner;
+      capacity_ = capacity;
+    }
+
+    size_t usage() const
+    {
+      lock_guard<mutex> guard(mutex_);
+      return usage_;
+    }
+
+    bool contains(const KeyType &key) const
+    {
+      lock_guard<mutex> guard(mutex_);
+      return table_.count(key) > 0;
+    }
+
+    Entry *lookup(const KeyType &key)
+    {
+      lock_guard<mutex> guard(mutex_);
+      auto              iter = table_.find(key);
+      if (iter == table_.end()) {
+        owner_->miss_count_.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+      }
+      owner_->hit_count_.fetch_add(1, std::memory_order_relaxed);
+      ref(iter->second);
+      return iter->second;
+    }
+
+    Entry *insert(const KeyType &key, const ValueType &value, size_t charge)
+    {
+      Entry *entry  = new Entry;
+      entry->key    = key;
+      entry->value  = value;
+      entry->charge = charge;
+      entry->refs   = 1;  // for the returned handle
+
+      lock_guard<mutex> guard(mutex_);
+      if (capacity_ > 0) {
+        entry->refs++;  // for the cache
+        entry->in_cache = true;
+        usage_ += charge;
+        auto iter = table_.find(key);
+        if (iter != table_.end()) {
+          finish_erase(iter->second);
+          iter->second = entry;
+        } else {
+          table_.emplace(key, entry);
+        }
+      }  // else don't cache
+
+      while (usage_ > capacity_ && lru_.next != &lru_) {
+        Entry *old = lru_.next;
+        table_.erase(old->key);
+        finish_erase(old);
+        owner_->eviction_count_.fetch_add(1, std::memory_order_relaxed);
+      }
+      return entry;
+    }
+
+    void erase(const KeyType &key)
+    {
+      lock_guard<mutex> guard(mutex_);
+      auto              iter = table_.find(key);
+      if (iter != table_.end()) {
+        Entry *entry = iter->second;
+        table_.erase(iter);
+        finish_erase(entry);
+      }
+    }
+
+    void release(Entry *entry)
+    {
+      lock_guard<mutex> guard(mutex_);
+      unref(entry);
+    }
+
+  private:
+    void ref(Entry *entry)
+    {
+      if (entry->refs == 1 && entry->in_cache) {
+        // pinned, remove it from the lru list
+        list_remove(entry);
+      }
+      entry->refs++;
+    }
+
+    void unref(Entry *entry)
+    {
+      entry->refs--;
+      if (entry->refs == 0) {
+        delete entry;
+      } else if (entry->in_cache && entry->refs == 1) {
+        // no longer pinned, it becomes the most recently used one
+        list_append(entry);
+      }
+    }
+
+    // the entry has been removed from `table_`
+    void finish_erase(Entry *entry)
+    {
+      if (entry->refs == 1) {
+        list_remove(entry);
+      }
+      entry->in_cache = false;
+      usage_ -= entry->charge;
+      unref(entry);
+    }
+
+    void list_remove(Entry *entry)
+    {
+      entry->next->prev = entry->prev;
+      entry->prev->next = entry->next;
+    }
+
+    void list_append(Entry *entry)
+    {
+      entry->next       = &lru_;
+      entry->prev       = lru_.prev;
+      entry->prev->next = entry;
+      entry->next->prev = entry;
+    }
+
+  private:
+    mutable mutex                   mutex_;
+    ObLRUCache                     *owner_    = nullptr;
+    size_t                          capacity_ = 0;
+    size_t                          usage_    = 0;
+    Entry                           lru_;
+    unordered_map<KeyType, Entry *> table_;
+  };
+
+  Shard &shard(const KeyType &key) const
+  {
+    if (num_shard_bits_ == 0) {
+      return shards_[0];
+    }
+    uint64_t h = hash<KeyType>()(key);
+    // mix the bits, `hash` of integers is the identity
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    return shards_[h >> (64 - num_shard_bits_)];
+  }
+
+  static constexpr int    MAX_SHARD_BITS     = 4;
+  static constexpr size_t MIN_SHARD_CAPACITY = 512 * 1024;
+
+  /**
+   * @brief The maximum total charge the cache can hold.
    */
-  size_t capacity_;
+  size_t              capacity_;
+  int                 num_shard_bits_ = 0;
+  unique_ptr<Shard[]> shards_;
+  atomic<uint64_t>    hit_count_{0};
+  atomic<uint64_t>    miss_count_{0};
+  atomic<uint64_t>    eviction_count_{0};
 };
 
 /**
@@ -91,7 +406,7 @@ private:
 template <typename Key, typename Value>
 ObLRUCache<Key, Value> *new_lru_cache(uint32_t capacity)
 {
-  return nullptr;
+  return new ObLRUCache<Key, Value>(capacity);
 }
 
 }  // namespace oceanbase
@@ -0,0 +1,75 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "oblsm/util/ob_rate_limiter.h"
+
+#include "common/lang/algorithm.h"
+#include "common/lang/thread.h"
+
+namespace oceanbase {
+
+ObRateLimiter::ObRateLimiter(int64_t bytes_per_second, int64_t refill_period_us)
+    : refill_period_us_(max<int64_t>(1, refill_period_us)),
+      bytes_per_second_(max<int64_t>(0, bytes_per_second)),
+      last_refill_(chrono::steady_clock::now())
+{
+  available_ = burst_bytes();
+}
+
+int64_t ObRateLimiter::burst_bytes() const
+{
+  return max<int64_t>(1, bytes_per_second() * refill_period_us_ / 1000000);
+}
+
+void ObRateLimiter::refill(chrono::steady_clock::time_point now)
+{
+  double elapsed_us = chrono::duration<double, std::micro>(now - last_refill_).count();
+  last_refill_      = now;
+  available_        = min<double>(burst_bytes(), available_ + elapsed_us * bytes_per_second() / 1e6);
+}
+
+void ObRateLimiter::set_bytes_per_second(int64_t bytes_per_second)
+{
+  lock_guard<mutex> guard(mutex_);
+  refill(chrono::steady_clock::now());
+  bytes_per_second_.store(max<int64_t>(0, bytes_per_second), std::memory_order_relaxed);
+  available_ = min<double>(available_, burst_bytes());
+}
+
+void ObRateLimiter::request(int64_t bytes)
+{
+  total_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+  if (bytes_per_second() == 0) {
+    return;
+  }
+
+  auto              start = chrono::steady_clock::now();
+  lock_guard<mutex> guard(mutex_);
+  while (bytes > 0) {
+    const int64_t rate = bytes_per_second();
+    if (rate == 0) {
+      break;
+    }
+    refill(chrono::steady_clock::now());
+    const int64_t piece = min(bytes, burst_bytes());
+    if (available_ >= piece) {
+      available_ -= piece;
+      bytes -= piece;
+      continue;
+    }
+    // sleep with the mutex held, so the waiters are served one by one.
+    std::this_thread::sleep_for(chrono::microseconds(static_cast<int64_t>((piece - available_) * 1e6 / rate) + 1));
+  }
+
+  auto waited = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - start).count();
+  total_wait_micros_.fetch_add(waited, std::memory_order_relaxed);
+}
+
+}  // namespace oceanbase
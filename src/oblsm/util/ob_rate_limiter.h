@@ -0,0 +1,72 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/atomic.h"
+#include "common/lang/chrono.h"
+#include "common/lang/mutex.h"
+
+namespace oceanbase {
+
+/**
+ * @class ObRateLimiter
+ * @brief A token bucket limiting the bytes per second written by the background jobs.
+ *
+ * The bucket is refilled continuously at `bytes_per_second` and holds at most the tokens of
+ * one refill period, so an idle limiter allows a short burst. `request` blocks the caller
+ * until the bytes are granted, large requests are granted in pieces of at most one burst.
+ * It is thread safe, the callers are served in the order they get the internal mutex.
+ */
+class ObRateLimiter
+{
+public:
+  /**
+   * @param bytes_per_second The rate limit, 0 means unlimited.
+   * @param refill_period_us The period whose tokens the bucket can hold.
+   */
+  explicit ObRateLimiter(int64_t bytes_per_second, int64_t refill_period_us = 100 * 1000);
+
+  /**
+   * @brief Blocks until `bytes` are granted.
+   */
+  void request(int64_t bytes);
+
+  /**
+   * @brief Changes the rate limit, 0 means unlimited.
+   */
+  void set_bytes_per_second(int64_t bytes_per_second);
+
+  int64_t bytes_per_second() const { return bytes_per_second_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief The total bytes granted.
+   */
+  int64_t total_bytes() const { return total_bytes_.load(std::memory_order_relaxed); }
+
+  /**
+   * @brief The total time in microseconds the callers were blocked.
+   */
+  int64_t total_wait_micros() const { return total_wait_micros_.load(std::memory_order_relaxed); }
+
+private:
+  int64_t burst_bytes() const;
+  void    refill(chrono::steady_clock::time_point now);
+
+  const int64_t                    refill_period_us_;
+  atomic<int64_t>                  bytes_per_second_{0};
+  atomic<int64_t>                  total_bytes_{0};
+  atomic<int64_t>                  total_wait_micros_{0};
+  mutex                            mutex_;
+  double                           available_ = 0;  // tokens in the bucket, protected by `mutex_`
+  chrono::steady_clock::time_point last_refill_;    // protected by `mutex_`
+};
+
+}  // namespace oceanbase
@@ -11,15 +11,172 @@
 #include "oblsm/wal/ob_lsm_wal.h"
 #include "common/log/log.h"
 #include "oblsm/util/ob_file_reader.h"
+#include "oblsm/util/ob_coding.h"
 
 namespace oceanbase {
+RC WAL::open(const std::string &filename)
+{
+  lock_guard<mutex> guard(mu_);
+  filename_ = filename;
+  writer_   = ObFileWriter::create_file_writer(filename, true /*append*/);
+  if (writer_ == nullptr) {
+    LOG_WARN("Failed to open wal file %s", filename.c_str());
+    return RC::IOERR_OPEN;
+  }
+  return RC::SUCCESS;
+}
+
 RC WAL::recover(const std::string &wal_file, std::vector<WalRecord> &wal_records)
 {
-  return RC::UNIMPLEMENTED;
+  unique_ptr<ObFileReader> reader = ObFileReader::create_file_reader(wal_file);
+  if (reader == nullptr) {
+    return RC::IOERR_OPEN;
+  }
+  uint32_t file_size = reader->file_size();
+  if (file_size == 0) {
+    return RC::SUCCESS;
+  }
+  string data = reader->read_pos(0, file_size);
+  if (data.size() != file_size) {
+    LOG_WARN("Failed to read wal file %s", wal_file.c_str());
+    return RC::IOERR_READ;
+  }
+
+  const size_t header_size = sizeof(uint64_t) + sizeof(size_t);
+  size_t       pos         = 0;
+  while (pos + header_size <= data.size()) {
+    uint64_t seq     = get_numeric<uint64_t>(data.data() + pos);
+    size_t   key_len = get_numeric<size_t>(data.data() + pos + sizeof(uint64_t));
+    pos += header_size;
+    if (pos + key_len + sizeof(size_t) > data.size()) {
+      break;
+    }
+    string key(data.data() + pos, key_len);
+    pos += key_len;
+    size_t val_len = get_numeric<size_t>(data.data() + pos);
+    pos += sizeof(size_t);
+    if (pos + val_len > data.size()) {
+      break;
+    }
+    string val(data.data() + pos, val_len);
+    pos += val_len;
+    wal_records.emplace_back(seq, std::move(key), std::move(val));
+  }
+  if (pos != data.size()) {
+    // the tail record is torn by a crash, it was never acknowledged, so just ignore it.
+    LOG_WARN("Ignore incomplete record at the tail of wal file %s, offset=%lu, size=%lu",
+             wal_file.c_str(), pos, data.size());
+  }
+  return RC::SUCCESS;
+}
+
+void WAL::encode_record(string *dst, uint64_t seq, string_view key, string_view val)
+{
+  put_numeric<uint64_t>(dst, seq);
+  put_numeric<size_t>(dst, key.size());
+  dst->append(key.data(), key.size());
+  put_numeric<size_t>(dst, val.size());
+  dst->append(val.data(), val.size());
+}
+
+RC WAL::put(uint64_t seq, string_view key, string_view val, bool sync)
+{
+  // serialize the record outside the lock
+  Writer w;
+  w.sync = sync;
+  w.records.reserve(sizeof(uint64_t) + sizeof(size_t) * 2 + key.size() + val.size());
+  encode_record(&w.records, seq, key, val);
+  return write(w);
 }
 
-RC WAL::put(uint64_t seq, string_view key, string_view val)
+RC WAL::batch_put(uint64_t first_seq, const vector<pair<string, string>> &kvs, bool sync)
 {
-  return RC::UNIMPLEMENTED;
+  Writer w;
+  w.sync      = sync;
+  size_t size = 0;
+  for (const auto &kv : kvs) {
+    size += sizeof(uint64_t) + sizeof(size_t) * 2 + kv.first.size() + kv.second.size();
+  }
+  w.records.reserve(size);
+  for (size_t i = 0; i < kvs.size(); i++) {
+    encode_record(&w.records, first_seq + i, kvs[i].first, kvs[i].second);
+  }
+  return write(w);
+}
+
+RC WAL::sync()
+{
+  Writer w;
+  w.sync = true;
+  return write(w);
+}
+
+RC WAL::write(Writer &w)
+{
+  unique_lock<mutex> lock(mu_);
+  writers_.push_back(&w);
+  while (!w.done && &w != writers_.front()) {
+    w.cv.wait(lock);
+  }
+  if (w.done) {
+    // committed by another leader
+    return w.rc;
+  }
+
+  // `w` is the leader now, group the queued writers behind it.
+  RC rc = RC::SUCCESS;
+  if (writer_ == nullptr) {
+    rc = RC::FILE_NOT_OPENED;
+  }
+
+  Writer *last = &w;
+  bool    sync = w.sync;
+  string  group;
+  size_t  size = w.records.size();
+  for (auto it = writers_.begin() + 1; it != writers_.end(); ++it) {
+    Writer *follower = *it;
+    if (size + follower->records.size() > MAX_GROUP_SIZE) {
+      break;
+    }
+    size += follower->records.size();
+    if (group.empty()) {
+      group.reserve(size);
+      group.append(w.records);
+    }
+    group.append(follower->records);
+    sync = sync || follower->sync;
+    last = follower;
+  }
+  string_view data = (last == &w) ? string_view(w.records) : string_view(group);
+
+  // The file is only touched by the leader, others can be queued while it's writing.
+  lock.unlock();
+  if (OB_SUCC(rc) && !data.empty()) {
+    rc = writer_->write(data);
+  }
+  if (OB_SUCC(rc)) {
+    rc = sync ? writer_->sync() : writer_->flush();
+  }
+  if (OB_FAIL(rc)) {
+    LOG_WARN("Failed to write wal file %s, rc=%s", filename_.c_str(), strrc(rc));
+  }
+  lock.lock();
+
+  while (true) {
+    Writer *ready = writers_.front();
+    writers_.pop_front();
+    if (ready != &w) {
+      ready->rc   = rc;
+      ready->done = true;
+      ready->cv.notify_one();
+    }
+    if (ready == last) {
+      break;
+    }
+  }
+  if (!writers_.empty()) {
+    writers_.front()->cv.notify_one();
+  }
+  return rc;
 }
-}  // namespace oceanbase
\ No newline at end of file
+}  // namespace oceanbase
@@ -13,7 +13,11 @@
 //
 #pragma once
 
+#include "common/lang/condition_variable.h"
+#include "common/lang/deque.h"
 #include "common/lang/mutex.h"
+#include "common/lang/utility.h"
+#include "common/lang/vector.h"
 #include "common/sys/rc.h"
 #include "oblsm/util/ob_file_writer.h"
 
@@ -62,6 +66,13 @@ struct WalRecord
  *
  * The data is written to the file in the order: key length, key, value length, value.
  * After writing the data, the system performs a `flush()` operation to ensure the data is persisted.
+ *
+ * ### Group Commit:
+ * `put`, `batch_put` and `sync` are thread-safe. Concurrent callers are queued, the caller at
+ * the head of the queue becomes the leader: it appends the records of all queued callers (up to
+ * `MAX_GROUP_SIZE` bytes) with one write, issues a single `fdatasync` if any of them asked for
+ * durability and then wakes the followers up. So N concurrent sync writers cost one fsync
+ * instead of N.
  */
 class WAL
 {
@@ -85,7 +96,7 @@ public:
    * @param filename The name of the WAL file to write logs.
    * @return `RC::SUCCESS` if the file was successfully opened, or an error code if it failed.
    */
-  RC open(const std::string &filename) { return RC::UNIMPLEMENTED; }
+  RC open(const std::string &filename);
 
   /**
    * @brief Recovers data from a specified WAL file.
@@ -107,9 +118,22 @@ public:
    * @param seq The sequence number of the record.
    * @param key The key to write.
    * @param val The value associated with the key.
+   * @param sync Whether the record must be durable when this function returns.
    * @return `RC::SUCCESS` if the write operation is successful, or an error code if it fails.
    */
-  RC put(uint64_t seq, std::string_view key, std::string_view val);
+  RC put(uint64_t seq, std::string_view key, std::string_view val, bool sync = false);
+
+  /**
+   * @brief Writes a batch of key-value pairs to the WAL with one append.
+   *
+   * The i-th pair is logged with sequence number `first_seq + i`.
+   *
+   * @param first_seq The sequence number of the first pair.
+   * @param kvs The key-value pairs to write.
+   * @param sync Whether the records must be durable when this function returns.
+   * @return `RC::SUCCESS` if the write operation is successful, or an error code if it fails.
+   */
+  RC batch_put(uint64_t first_seq, const vector<pair<string, string>> &kvs, bool sync = false);
 
   /**
    * @brief Synchronizes the WAL to disk.
@@ -117,11 +141,38 @@ public:
    *
    * @return `RC::SUCCESS` if the sync operation is successful, or an error code if it fails.
    */
-  RC sync() { return RC::UNIMPLEMENTED; }
+  RC sync();
 
   const string &filename() const { return filename_; }
 
 private:
-  string filename_;
+  /**
+   * @brief A caller waiting in the group commit queue.
+   */
+  struct Writer
+  {
+    string             records;       ///< serialized records, may be empty for a pure sync request
+    bool               sync = false;  ///< whether `records` must be durable
+    bool               done = false;  ///< set by the leader which wrote `records`
+    RC                 rc   = RC::SUCCESS;
+    condition_variable cv;
+  };
+
+  static void encode_record(string *dst, uint64_t seq, string_view key, string_view val);
+
+  /**
+   * @brief Queues the writer and waits until it is committed by itself or by another leader.
+   */
+  RC write(Writer &w);
+
+  /**
+   * @brief The upper bound of bytes a leader groups into one write.
+   */
+  static constexpr size_t MAX_GROUP_SIZE = 1 << 20;
+
+  string                   filename_;
+  mutex                    mu_;
+  deque<Writer *>          writers_;
+  unique_ptr<ObFileWriter> writer_;
 };
 }  // namespace oceanbase
@@ -15,6 +15,7 @@ See the Mulan PSL v2 for more details. */
 #include "common/init.h"
 
 #include "common/conf/ini.h"
+#include "common/io/async_io.h"
 #include "common/lang/string.h"
 #include "common/lang/iostream.h"
 #include "common/log/log.h"
@@ -134,8 +135,28 @@ int prepare_init_seda()
   return 0;
 }
 
+/**
+ * @brief 按照配置文件 [IO] 中的参数设置异步IO引擎，要在打开数据库之前调用
+ */
+void init_async_io(Ini &properties)
+{
+  AsyncIOOptions options;
+
+  string type_name = properties.get("ENGINE", "thread_pool", "IO");
+  if (!async_io_type_from_name(type_name, options.type)) {
+    LOG_WARN("unknown async io engine %s, use thread_pool", type_name.c_str());
+  }
+  str_to_val(properties.get("QUEUE_DEPTH", "256", "IO"), options.queue_depth);
+  str_to_val(properties.get("THREADS", "4", "IO"), options.thread_num);
+
+  AsyncIOEngine::set_default_options(options);
+  LOG_INFO("async io engine is %s", AsyncIOEngine::instance().name());
+}
+
 int init_global_objects(ProcessParam *process_param, Ini &properties)
 {
+  init_async_io(properties);
+
   GCTX.handler_ = new DefaultHandler();
 
   int ret = 0;
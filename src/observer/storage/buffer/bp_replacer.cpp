@@ -0,0 +1,211 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/buffer/bp_replacer.h"
+
+#include "common/log/log.h"
+
+RC bp_replacer_type_from_name(const string &name, BPReplacerType &type)
+{
+  string lower_name = name;
+  common::str_to_lower(lower_name);
+  if (lower_name == "lru") {
+    type = BPReplacerType::LRU;
+  } else if (lower_name == "clock") {
+    type = BPReplacerType::CLOCK;
+  } else if (lower_name == "2q") {
+    type = BPReplacerType::TWO_Q;
+  } else {
+    LOG_WARN("unknown buffer pool replacer: %s", name.c_str());
+    return RC::INVALID_ARGUMENT;
+  }
+  return RC::SUCCESS;
+}
+
+unique_ptr<BPReplacer> BPReplacer::create(BPReplacerType type)
+{
+  switch (type) {
+    case BPReplacerType::CLOCK: return make_unique<ClockReplacer>();
+    case BPReplacerType::TWO_Q: return make_unique<TwoQReplacer>();
+    default: return make_unique<LruReplacer>();
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void LruReplacer::insert(Frame *frame, BPAccessHint /*hint*/)
+{
+  lru_list_.push_front(frame);
+  nodes_[frame] = lru_list_.begin();
+}
+
+void LruReplacer::access(Frame *frame, BPAccessHint /*hint*/)
+{
+  auto iter = nodes_.find(frame);
+  if (iter != nodes_.end()) {
+    lru_list_.splice(lru_list_.begin(), lru_list_, iter->second);
+  }
+}
+
+void LruReplacer::remove(Frame *frame)
+{
+  auto iter = nodes_.find(frame);
+  if (iter != nodes_.end()) {
+    lru_list_.erase(iter->second);
+    nodes_.erase(iter);
+  }
+}
+
+void LruReplacer::foreach_victim(const function<bool(Frame *)> &visitor)
+{
+  for (auto iter = lru_list_.rbegin(); iter != lru_list_.rend(); ++iter) {
+    if (!visitor(*iter)) {
+      break;
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void ClockReplacer::insert(Frame *frame, BPAccessHint hint)
+{
+  // 插入到指针的后面，也就是指针转一圈后才会检查到的位置
+  Ring::iterator iter = ring_.insert(hand_, Node{frame, hint == BPAccessHint::NORMAL});
+  nodes_[frame]       = iter;
+  if (hand_ == ring_.end()) {
+    hand_ = ring_.begin();
+  }
+}
+
+void ClockReplacer::access(Frame *frame, BPAccessHint hint)
+{
+  if (hint == BPAccessHint::SCAN) {
+    return;
+  }
+
+  auto iter = nodes_.find(frame);
+  if (iter != nodes_.end()) {
+    iter->second->referenced = true;
+  }
+}
+
+void ClockReplacer::remove(Frame *frame)
+{
+  auto iter = nodes_.find(frame);
+  if (iter == nodes_.end()) {
+    return;
+  }
+
+  if (hand_ == iter->second) {
+    advance_hand();
+  }
+  ring_.erase(iter->second);
+  nodes_.erase(iter);
+  if (ring_.empty()) {
+    hand_ = ring_.end();
+  }
+}
+
+void ClockReplacer::advance_hand()
+{
+  ++hand_;
+  if (hand_ == ring_.end()) {
+    hand_ = ring_.begin();
+  }
+}
+
+void ClockReplacer::foreach_victim(const function<bool(Frame *)> &visitor)
+{
+  // 转两圈，第一圈清除的访问标记，第二圈就可以淘汰了
+  const size_t max_steps = ring_.size() * 2;
+  for (size_t step = 0; step < max_steps; step++) {
+    Node &node = *hand_;
+    advance_hand();
+    if (node.referenced) {
+      node.referenced = false;
+      continue;
+    }
+
+    if (!visitor(node.frame)) {
+      break;
+    }
+  }
+}
+
+void ClockReplacer::peek_victims(const function<bool(Frame *)> &visitor)
+{
+  // 指针转一圈，没有访问标记的页帧就是接下来会被淘汰的
+  Ring::iterator iter = hand_;
+  for (size_t step = 0; step < ring_.size(); step++) {
+    if (!iter->referenced && !visitor(iter->frame)) {
+      break;
+    }
+    if (++iter == ring_.end()) {
+      iter = ring_.begin();
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void TwoQReplacer::insert(Frame *frame, BPAccessHint /*hint*/)
+{
+  probation_list_.push_front(frame);
+  nodes_[frame] = Node{false, probation_list_.begin()};
+}
+
+void TwoQReplacer::access(Frame *frame, BPAccessHint hint)
+{
+  auto iter = nodes_.find(frame);
+  if (iter == nodes_.end()) {
+    return;
+  }
+
+  Node &node = iter->second;
+  if (node.hot) {
+    hot_list_.splice(hot_list_.begin(), hot_list_, node.iter);
+  } else if (hint == BPAccessHint::NORMAL) {
+    hot_list_.splice(hot_list_.begin(), probation_list_, node.iter);
+    node.hot = true;
+  }
+}
+
+void TwoQReplacer::remove(Frame *frame)
+{
+  auto iter = nodes_.find(frame);
+  if (iter == nodes_.end()) {
+    return;
+  }
+
+  Node &node = iter->second;
+  if (node.hot) {
+    hot_list_.erase(node.iter);
+  } else {
+    probation_list_.erase(node.iter);
+  }
+  nodes_.erase(iter);
+}
+
+void TwoQReplacer::foreach_victim(const function<bool(Frame *)> &visitor)
+{
+  list<Frame *> *first  = &hot_list_;
+  list<Frame *> *second = &probation_list_;
+  if (probation_list_.size() * KIN_RATIO > nodes_.size()) {
+    swap(first, second);
+  }
+
+  for (list<Frame *> *frames : {first, second}) {
+    for (auto iter = frames->rbegin(); iter != frames->rend(); ++iter) {
+      if (!visitor(*iter)) {
+        return;
+      }
+    }
+  }
+}
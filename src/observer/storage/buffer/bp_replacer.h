@@ -0,0 +1,179 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/functional.h"
+#include "common/lang/list.h"
+#include "common/lang/memory.h"
+#include "common/lang/string.h"
+#include "common/lang/unordered_map.h"
+#include "common/sys/rc.h"
+
+class Frame;
+
+/**
+ * @brief 访问页面的方式
+ * @ingroup BufferPool
+ * @details 顺序扫描(比如全表扫描)访问的页面通常只会访问一次，淘汰策略可以据此让这些页面
+ * 尽快被淘汰，而不是把经常访问的页面(比如B+树的内部节点)挤出内存。
+ */
+enum class BPAccessHint
+{
+  NORMAL,  ///< 普通访问
+  SCAN,    ///< 顺序扫描
+};
+
+/**
+ * @brief 页面淘汰策略的类型
+ * @ingroup BufferPool
+ */
+enum class BPReplacerType
+{
+  LRU,    ///< 最近最少使用
+  CLOCK,  ///< 时钟算法，每个页帧有一个访问标记
+  TWO_Q,  ///< 2Q，新页面先进入试用队列，再次访问才进入热队列
+};
+
+/**
+ * @brief 根据名字(不区分大小写)获取淘汰策略的类型，可以是 lru、clock 或 2q
+ */
+RC bp_replacer_type_from_name(const string &name, BPReplacerType &type);
+
+/**
+ * @brief 页面淘汰策略
+ * @ingroup BufferPool
+ * @details 记录页帧的访问情况，并在需要淘汰页面时，按照淘汰的优先顺序给出候选的页帧。
+ * 每个 BPFrameManager 的分片有一个淘汰策略对象，它的所有接口都在分片的锁内调用，
+ * 所以不需要考虑并发。
+ */
+class BPReplacer
+{
+public:
+  virtual ~BPReplacer() = default;
+
+  /**
+   * @brief 一个新的页帧加入
+   */
+  virtual void insert(Frame *frame, BPAccessHint hint) = 0;
+
+  /**
+   * @brief 访问了一个已经存在的页帧
+   */
+  virtual void access(Frame *frame, BPAccessHint hint) = 0;
+
+  /**
+   * @brief 页帧被释放
+   */
+  virtual void remove(Frame *frame) = 0;
+
+  /**
+   * @brief 按照淘汰的优先顺序遍历页帧，直到 visitor 返回 false 或者遍历结束
+   * @details 遍历过程中不能调用 insert/access/remove。有些策略(比如CLOCK)在遍历时会修改页帧的状态。
+   */
+  virtual void foreach_victim(const function<bool(Frame *)> &visitor) = 0;
+
+  /**
+   * @brief 与 foreach_victim 类似，但是不会修改页帧的状态，后台刷脏页时用来查看接下来会淘汰哪些页帧
+   */
+  virtual void peek_victims(const function<bool(Frame *)> &visitor) { foreach_victim(visitor); }
+
+  virtual size_t size() const = 0;
+
+  static unique_ptr<BPReplacer> create(BPReplacerType type);
+};
+
+/**
+ * @brief LRU 淘汰策略，不考虑访问方式
+ * @ingroup BufferPool
+ */
+class LruReplacer : public BPReplacer
+{
+public:
+  void insert(Frame *frame, BPAccessHint hint) override;
+  void access(Frame *frame, BPAccessHint hint) override;
+  void remove(Frame *frame) override;
+  void foreach_victim(const function<bool(Frame *)> &visitor) override;
+
+  size_t size() const override { return nodes_.size(); }
+
+private:
+  list<Frame *>                                   lru_list_;  /// 头部是最近访问的页帧
+  unordered_map<Frame *, list<Frame *>::iterator> nodes_;
+};
+
+/**
+ * @brief CLOCK 淘汰策略
+ * @ingroup BufferPool
+ * @details 页帧组成一个环，每个页帧有一个访问标记。淘汰时从时钟指针开始转动，遇到有访问标记的页帧
+ * 就清除标记并跳过，没有标记的页帧就是候选。
+ * 顺序扫描访问的页帧不会设置访问标记，所以指针第一次经过时就可以被淘汰。
+ */
+class ClockReplacer : public BPReplacer
+{
+public:
+  void insert(Frame *frame, BPAccessHint hint) override;
+  void access(Frame *frame, BPAccessHint hint) override;
+  void remove(Frame *frame) override;
+  void foreach_victim(const function<bool(Frame *)> &visitor) override;
+  void peek_victims(const function<bool(Frame *)> &visitor) override;
+
+  size_t size() const override { return nodes_.size(); }
+
+private:
+  struct Node
+  {
+    Frame *frame      = nullptr;
+    bool   referenced = false;
+  };
+
+  using Ring = list<Node>;
+
+  void advance_hand();
+
+private:
+  Ring                                   ring_;
+  Ring::iterator                         hand_ = ring_.end();  /// 时钟指针，指向下一个要检查的页帧
+  unordered_map<Frame *, Ring::iterator> nodes_;
+};
+
+/**
+ * @brief 2Q 淘汰策略
+ * @ingroup BufferPool
+ * @details 新加入的页帧先进入试用队列(A1，先进先出)，在试用队列中再次被普通访问时，才会移动到热队列
+ * (Am，LRU)。顺序扫描的访问不会把页帧移入热队列，所以一次大的扫描只会冲刷试用队列。
+ * 当试用队列的页帧数量超过总数的 1/4 时，优先淘汰试用队列中的页帧，否则优先淘汰热队列中的页帧，
+ * 以免新页面还没有机会被再次访问就被淘汰。
+ */
+class TwoQReplacer : public BPReplacer
+{
+public:
+  void insert(Frame *frame, BPAccessHint hint) override;
+  void access(Frame *frame, BPAccessHint hint) override;
+  void remove(Frame *frame) override;
+  void foreach_victim(const function<bool(Frame *)> &visitor) override;
+
+  size_t size() const override { return nodes_.size(); }
+
+private:
+  struct Node
+  {
+    bool                    hot = false;
+    list<Frame *>::iterator iter;
+  };
+
+  /// 试用队列的页帧数量超过总数的 1/KIN_RATIO 时，优先淘汰试用队列
+  static constexpr size_t KIN_RATIO = 4;
+
+private:
+  list<Frame *>                probation_list_;  /// 试用队列，头部是最新加入的页帧
+  list<Frame *>                hot_list_;        /// 热队列，头部是最近访问的页帧
+  unordered_map<Frame *, Node> nodes_;
+};
@@ -13,14 +13,22 @@ See the Mulan PSL v2 for more details. */
 //
 #include <errno.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "common/io/async_io.h"
 #include "common/io/io.h"
 #include "common/lang/mutex.h"
 #include "common/lang/algorithm.h"
+#include "common/lang/bitset.h"
+#include "common/lang/defer.h"
+#include "common/lang/sstream.h"
 #include "common/log/log.h"
 #include "common/math/crc.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/buffer/buffer_pool_log.h"
+#include "storage/buffer/page_cleaner.h"
+#include "storage/buffer/read_ahead.h"
 #include "storage/db/db.h"
 
 using namespace common;
@@ -29,47 +37,106 @@ static const int MEM_POOL_ITEM_NUM = 20;
 
 ////////////////////////////////////////////////////////////////////////////////
 
+RC BPFileHeader::validate() const
+{
+  if (magic != MAGIC) {
+    LOG_ERROR("invalid buffer pool file header. magic=%x, expected=%x", magic, MAGIC);
+    return RC::BUFFERPOOL_INVALID_FILE;
+  }
+  if (version != VERSION) {
+    LOG_ERROR("unsupported buffer pool file version. version=%d, expected=%d", version, VERSION);
+    return RC::BUFFERPOOL_INVALID_FILE;
+  }
+  if (extent_count < 1 || extent_count > MAX_EXTENT_NUM || page_count < 1 ||
+      page_count > extent_count * BP_EXTENT_PAGES || allocated_pages < 1 || allocated_pages > page_count) {
+    LOG_ERROR("corrupted buffer pool file header. %s", to_string().c_str());
+    return RC::BUFFERPOOL_INVALID_FILE;
+  }
+  return RC::SUCCESS;
+}
+
 string BPFileHeader::to_string() const
 {
   stringstream ss;
-  ss << "pageCount:" << page_count << ", allocatedCount:" << allocated_pages;
+  ss << "version:" << version << ", pageCount:" << page_count << ", allocatedCount:" << allocated_pages << ", extentCount:" << extent_count;
   return ss.str();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 
-BPFrameManager::BPFrameManager(const char *name) : allocator_(name) {}
+string BPFrameStats::to_string() const
+{
+  stringstream ss;
+  ss << "free:" << free_frames << ", clean:" << clean_frames << ", dirty:" << dirty_frames;
+  return ss.str();
+}
+
+BPFrameManager::BPFrameManager(const char *name, int shard_num /* = DEFAULT_SHARD_NUM */) : allocator_(name)
+{
+  shards_.reserve(max(shard_num, 1));
+  for (int i = 0; i < max(shard_num, 1); i++) {
+    shards_.push_back(make_unique<Shard>());
+  }
+}
 
-RC BPFrameManager::init(int pool_num)
+RC BPFrameManager::init(int pool_num, BPReplacerType replacer_type /* = BPReplacerType::TWO_Q */)
 {
   int ret = allocator_.init(false, pool_num);
-  if (ret == 0) {
-    return RC::SUCCESS;
+  if (ret != 0) {
+    return RC::NOMEM;
   }
-  return RC::NOMEM;
+
+  for (unique_ptr<Shard> &shard : shards_) {
+    shard->replacer = BPReplacer::create(replacer_type);
+  }
+  return RC::SUCCESS;
 }
 
 RC BPFrameManager::cleanup()
 {
-  if (frames_.count() > 0) {
+  if (frame_num() > 0) {
     return RC::INTERNAL;
   }
 
-  frames_.destroy();
+  for (unique_ptr<Shard> &shard : shards_) {
+    shard->frames.clear();
+  }
   return RC::SUCCESS;
 }
 
-int BPFrameManager::purge_frames(int count, function<RC(Frame *frame)> purger)
+size_t BPFrameManager::frame_num() const
 {
-  lock_guard<mutex> lock_guard(lock_);
+  size_t num = 0;
+  for (const unique_ptr<Shard> &shard : shards_) {
+    lock_guard<mutex> lock_guard(shard->lock);
+    num += shard->frames.size();
+  }
+  return num;
+}
 
-  vector<Frame *> frames_can_purge;
+int BPFrameManager::purge_frames(int count, function<RC(Frame *frame)> purger)
+{
   if (count <= 0) {
     count = 1;
   }
+
+  const size_t start_shard = next_purge_shard_.fetch_add(1) % shards_.size();
+
+  int freed_count = 0;
+  for (size_t i = 0; i < shards_.size() && freed_count < count; i++) {
+    Shard &shard = *shards_[(start_shard + i) % shards_.size()];
+    freed_count += purge_shard(shard, count - freed_count, purger);
+  }
+  LOG_INFO("purge frame done. number=%d", freed_count);
+  return freed_count;
+}
+
+int BPFrameManager::purge_shard(Shard &shard, int count, function<RC(Frame *frame)> &purger)
+{
+  vector<Frame *> frames_can_purge;
   frames_can_purge.reserve(count);
 
-  auto purge_finder = [&frames_can_purge, count](const FrameId &frame_id, Frame *const frame) {
+  auto purge_finder = [&frames_can_purge, count](Frame *frame) {
     if (frame->can_purge()) {
       frame->pin();
       frames_can_purge.push_back(frame);
@@ -80,53 +147,162 @@ int BPFrameManager::purge_frames(int count, function<RC(Frame *frame)> purger)
     return true;  // true continue to look up
   };
 
-  frames_.foreach_reverse(purge_finder);
-  LOG_INFO("purge frames find %ld pages total", frames_can_purge.size());
+  {
+    lock_guard<mutex> lock_guard(shard.lock);
+    shard.replacer->foreach_victim(purge_finder);
+  }
+  LOG_DEBUG("purge frames find %ld pages in shard", frames_can_purge.size());
 
-  /// 当前还在frameManager的锁内，而 purger 是一个非常耗时的操作
-  /// 他需要把脏页数据刷新到磁盘上去，所以这里会极大地降低并发度
-  int freed_count = 0;
+  /// purger 是一个非常耗时的操作，他需要把脏页数据刷新到磁盘上去，所以不能持有分片的锁。
+  /// 页帧已经pin住了，不会被其它线程淘汰
+  vector<RC> purge_rcs;
+  purge_rcs.reserve(frames_can_purge.size());
   for (Frame *frame : frames_can_purge) {
-    RC rc = purger(frame);
-    if (RC::SUCCESS == rc) {
-      free_internal(frame->frame_id(), frame);
+    purge_rcs.push_back(purger(frame));
+  }
+
+  /// 刷盘的过程中其它线程可能又访问或者修改了这个页面，这时候就不能淘汰了
+  int               freed_count = 0;
+  lock_guard<mutex> lock_guard(shard.lock);
+  for (size_t i = 0; i < frames_can_purge.size(); i++) {
+    Frame *frame = frames_can_purge[i];
+    if (RC::SUCCESS == purge_rcs[i] && frame->pin_count() == 1 && !frame->dirty() && !frame->disposed()) {
+      free_internal(shard, frame->frame_id(), frame);
       freed_count++;
     } else {
-      frame->unpin();
-      LOG_WARN("failed to purge frame. frame_id=%s, rc=%s", 
-               frame->frame_id().to_string().c_str(), strrc(rc));
+      unpin(frame);
+      if (RC::SUCCESS != purge_rcs[i]) {
+        LOG_WARN("failed to purge frame. frame_id=%s, rc=%s", 
+                 frame->frame_id().to_string().c_str(), strrc(purge_rcs[i]));
+      }
     }
   }
-  LOG_INFO("purge frame done. number=%d", freed_count);
   return freed_count;
 }
 
-Frame *BPFrameManager::get(int buffer_pool_id, PageNum page_num)
+list<Frame *> BPFrameManager::pin_dirty_victims(int count)
 {
-  FrameId                     frame_id(buffer_pool_id, page_num);
+  list<Frame *> frames;
+  if (count <= 0) {
+    return frames;
+  }
 
-  lock_guard<mutex> lock_guard(lock_);
-  return get_internal(frame_id);
+  // 每个分片都找一些，分片之间的淘汰顺序没法比较
+  const size_t count_per_shard = (count + shards_.size() - 1) / shards_.size();
+  for (unique_ptr<Shard> &shard : shards_) {
+    lock_guard<mutex> lock_guard(shard->lock);
+
+    size_t found = 0;
+    shard->replacer->peek_victims([&frames, &found, count_per_shard](Frame *frame) {
+      if (frame->can_purge() && frame->dirty()) {
+        frame->pin();
+        frames.push_back(frame);
+        found++;
+      }
+      return found < count_per_shard;
+    });
+  }
+  return frames;
 }
 
-Frame *BPFrameManager::get_internal(const FrameId &frame_id)
+int BPFrameManager::evict_clean_frames(int count)
+{
+  const size_t start_shard = next_purge_shard_.fetch_add(1) % shards_.size();
+
+  int freed_count = 0;
+  for (size_t i = 0; i < shards_.size() && freed_count < count; i++) {
+    Shard &shard = *shards_[(start_shard + i) % shards_.size()];
+
+    lock_guard<mutex> lock_guard(shard.lock);
+
+    vector<Frame *> clean_frames;
+    shard.replacer->foreach_victim([&clean_frames, need = count - freed_count](Frame *frame) {
+      if (frame->can_purge() && !frame->dirty()) {
+        frame->pin();
+        clean_frames.push_back(frame);
+      }
+      return clean_frames.size() < static_cast<size_t>(need);
+    });
+
+    for (Frame *frame : clean_frames) {
+      free_internal(shard, frame->frame_id(), frame);
+    }
+    freed_count += static_cast<int>(clean_frames.size());
+  }
+  return freed_count;
+}
+
+BPFrameStats BPFrameManager::frame_stats() const
+{
+  BPFrameStats stats;
+  for (const unique_ptr<Shard> &shard : shards_) {
+    lock_guard<mutex> lock_guard(shard->lock);
+    for (const auto &[frame_id, frame] : shard->frames) {
+      if (frame->dirty()) {
+        stats.dirty_frames++;
+      } else {
+        stats.clean_frames++;
+      }
+    }
+  }
+  stats.free_frames = free_frame_num();
+  return stats;
+}
+
+LSN BPFrameManager::min_recovery_lsn() const
+{
+  LSN min_lsn = 0;
+  for (const unique_ptr<Shard> &shard : shards_) {
+    lock_guard<mutex> lock_guard(shard->lock);
+    for (const auto &[frame_id, frame] : shard->frames) {
+      const LSN recovery_lsn = frame->recovery_lsn();
+      if (frame->dirty() && recovery_lsn > 0 && (min_lsn == 0 || recovery_lsn < min_lsn)) {
+        min_lsn = recovery_lsn;
+      }
+    }
+  }
+  return min_lsn;
+}
+
+Frame *BPFrameManager::get(int buffer_pool_id, PageNum page_num, BPAccessHint hint /* = BPAccessHint::NORMAL */)
+{
+  FrameId frame_id(buffer_pool_id, page_num);
+  Shard  &shard = shard_of(frame_id);
+
+  lock_guard<mutex> lock_guard(shard.lock);
+  return get_internal(shard, frame_id, hint);
+}
+
+bool BPFrameManager::contains(int buffer_pool_id, PageNum page_num)
+{
+  FrameId frame_id(buffer_pool_id, page_num);
+  Shard  &shard = shard_of(frame_id);
+
+  lock_guard<mutex> lock_guard(shard.lock);
+  return shard.frames.find(frame_id) != shard.frames.end();
+}
+
+Frame *BPFrameManager::get_internal(Shard &shard, const FrameId &frame_id, BPAccessHint hint)
 {
   Frame *frame = nullptr;
-  (void)frames_.get(frame_id, frame);
-  if (frame != nullptr) {
+  auto   iter  = shard.frames.find(frame_id);
+  if (iter != shard.frames.end()) {
+    frame = iter->second;
+    shard.replacer->access(frame, hint);
     frame->pin();
     LOG_DEBUG("got a frame. frame=%s", frame->to_string().c_str());
   }
   return frame;
 }
 
-Frame *BPFrameManager::alloc(int buffer_pool_id, PageNum page_num)
+Frame *BPFrameManager::alloc(int buffer_pool_id, PageNum page_num, BPAccessHint hint /* = BPAccessHint::NORMAL */)
 {
   FrameId frame_id(buffer_pool_id, page_num);
+  Shard  &shard = shard_of(frame_id);
 
-  lock_guard<mutex> lock_guard(lock_);
+  lock_guard<mutex> lock_guard(shard.lock);
 
-  Frame                      *frame = get_internal(frame_id);
+  Frame *frame = get_internal(shard, frame_id, hint);
   if (frame != nullptr) {
     return frame;
   }
@@ -138,48 +314,120 @@ Frame *BPFrameManager::alloc(int buffer_pool_id, PageNum page_num)
     frame->set_buffer_pool_id(buffer_pool_id);
     frame->set_page_num(page_num);
     frame->pin();
-    frames_.put(frame_id, frame);
+    shard.frames.emplace(frame_id, frame);
+    shard.replacer->insert(frame, hint);
+    used_frame_num_++;
     LOG_DEBUG("allocate a new frame. frame=%s", frame->to_string().c_str());
   }
   return frame;
 }
 
+Frame *BPFrameManager::alloc_free_frame()
+{
+  Frame *frame = allocator_.alloc();
+  if (frame != nullptr) {
+    ASSERT(frame->pin_count() == 0, "got an invalid frame that pin count is not 0. frame=%s", 
+           frame->to_string().c_str());
+    frame->pin();
+    used_frame_num_++;
+  }
+  return frame;
+}
+
+bool BPFrameManager::install_frame(Frame *frame, BPAccessHint hint)
+{
+  const FrameId frame_id = frame->frame_id();
+  Shard        &shard    = shard_of(frame_id);
+
+  lock_guard<mutex> lock_guard(shard.lock);
+  if (shard.frames.find(frame_id) != shard.frames.end()) {
+    return false;
+  }
+
+  shard.frames.emplace(frame_id, frame);
+  shard.replacer->insert(frame, hint);
+  frame->unpin();
+  return true;
+}
+
+void BPFrameManager::release_free_frame(Frame *frame)
+{
+  frame->set_page_num(-1);
+  frame->unpin();
+  allocator_.free(frame);
+  used_frame_num_--;
+}
+
 RC BPFrameManager::free(int buffer_pool_id, PageNum page_num, Frame *frame)
 {
   FrameId frame_id(buffer_pool_id, page_num);
+  Shard  &shard = shard_of(frame_id);
+
+  lock_guard<mutex> lock_guard(shard.lock);
+  if (frame->pin_count() > 1) {
+    LOG_DEBUG("frame is still pinned by others, dispose it. frame=%s", frame->to_string().c_str());
+    auto iter = shard.frames.find(frame_id);
+    if (iter != shard.frames.end() && iter->second == frame) {
+      shard.replacer->remove(frame);
+      shard.frames.erase(iter);
+    }
+    frame->clear_dirty();
+    frame->set_disposed(true);
+    unpin(frame);
+    return RC::SUCCESS;
+  }
+  return free_internal(shard, frame_id, frame);
+}
 
-  lock_guard<mutex> lock_guard(lock_);
-  return free_internal(frame_id, frame);
+void BPFrameManager::unpin(Frame *frame)
+{
+  // 先标记再unpin，所以最后一个unpin的线程一定能看到标记
+  if (frame->unpin() == 0 && frame->disposed()) {
+    release_disposed_frame(frame);
+  }
+}
+
+void BPFrameManager::release_disposed_frame(Frame *frame)
+{
+  LOG_DEBUG("release disposed frame. frame=%s", frame->to_string().c_str());
+  frame->set_disposed(false);
+  frame->set_page_num(-1);
+  allocator_.free(frame);
+  used_frame_num_--;
 }
 
-RC BPFrameManager::free_internal(const FrameId &frame_id, Frame *frame)
+RC BPFrameManager::free_internal(Shard &shard, const FrameId &frame_id, Frame *frame)
 {
-  Frame                *frame_source = nullptr;
-  [[maybe_unused]] bool found        = frames_.get(frame_id, frame_source);
+  auto                  iter         = shard.frames.find(frame_id);
+  [[maybe_unused]] bool found        = iter != shard.frames.end();
+  Frame                *frame_source = found ? iter->second : nullptr;
   ASSERT(found && frame == frame_source && frame->pin_count() == 1,
       "failed to free frame. found=%d, frameId=%s, frame_source=%p, frame=%p, pinCount=%d, lbt=%s",
       found, frame_id.to_string().c_str(), frame_source, frame, frame->pin_count(), lbt());
 
   frame->set_page_num(-1);
   frame->unpin();
-  frames_.remove(frame_id);
+  shard.replacer->remove(frame);
+  if (found) {
+    shard.frames.erase(iter);
+  }
   allocator_.free(frame);
+  used_frame_num_--;
   return RC::SUCCESS;
 }
 
 list<Frame *> BPFrameManager::find_list(int buffer_pool_id)
 {
-  lock_guard<mutex> lock_guard(lock_);
-
   list<Frame *> frames;
-  auto               fetcher = [&frames, buffer_pool_id](const FrameId &frame_id, Frame *const frame) -> bool {
-    if (buffer_pool_id == frame_id.buffer_pool_id()) {
-      frame->pin();
-      frames.push_back(frame);
+  for (unique_ptr<Shard> &shard : shards_) {
+    lock_guard<mutex> lock_guard(shard->lock);
+    for (auto &[frame_id, frame] : shard->frames) {
+      if (buffer_pool_id == frame_id.buffer_pool_id()) {
+        frame->pin();
+        frames.push_back(frame);
+      }
     }
-    return true;
-  };
-  frames_.foreach (fetcher);
+  }
   return frames;
 }
 
@@ -188,7 +436,9 @@ BufferPoolIterator::BufferPoolIterator() {}
 BufferPoolIterator::~BufferPoolIterator() {}
 RC BufferPoolIterator::init(DiskBufferPool &bp, PageNum start_page /* = 0 */)
 {
-  bitmap_.init(bp.file_header_->bitmap, bp.file_header_->page_count);
+  buffer_pool_ = &bp;
+  page_count_  = bp.file_header_->page_count;
+  extent_      = -1;
   if (start_page <= 0) {
     current_page_num_ = -1;
   } else {
@@ -197,11 +447,11 @@ RC BufferPoolIterator::init(DiskBufferPool &bp, PageNum start_page /* = 0 */)
   return RC::SUCCESS;
 }
 
-bool BufferPoolIterator::has_next() { return bitmap_.next_setted_bit(current_page_num_ + 1) != -1; }
+bool BufferPoolIterator::has_next() { return find_next(current_page_num_ + 1) != -1; }
 
 PageNum BufferPoolIterator::next()
 {
-  PageNum next_page = bitmap_.next_setted_bit(current_page_num_ + 1);
+  PageNum next_page = find_next(current_page_num_ + 1);
   if (next_page != -1) {
     current_page_num_ = next_page;
   }
@@ -214,6 +464,31 @@ RC BufferPoolIterator::reset()
   return RC::SUCCESS;
 }
 
+PageNum BufferPoolIterator::find_next(PageNum start)
+{
+  while (start < page_count_) {
+    const int extent = start / BP_EXTENT_PAGES;
+    if (extent != extent_) {
+      RC rc = buffer_pool_->copy_extent_bitmap(extent, extent_bitmap_);
+      if (OB_FAIL(rc)) {
+        LOG_WARN("failed to copy extent bitmap. file=%s, extent=%d, rc=%s", buffer_pool_->filename(), extent, strrc(rc));
+        return -1;
+      }
+      extent_ = extent;
+    }
+
+    const PageNum first_page = extent * BP_EXTENT_PAGES;
+    Bitmap        bitmap(extent_bitmap_, min(BP_EXTENT_PAGES, page_count_ - first_page));
+    // 区的位图页不是数据页
+    int index = bitmap.next_setted_bit(max(start - first_page, extent > 0 ? 1 : 0));
+    if (index != -1) {
+      return first_page + index;
+    }
+    start = first_page + BP_EXTENT_PAGES;
+  }
+  return -1;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 DiskBufferPool::DiskBufferPool(
     BufferPoolManager &bp_manager, BPFrameManager &frame_manager, DoubleWriteBuffer &dblwr_manager, LogHandler &log_handler)
@@ -270,6 +545,15 @@ RC DiskBufferPool::open_file(const char *file_name)
   }
 
   file_header_ = (BPFileHeader *)hdr_frame_->data();
+  if (OB_FAIL(rc = file_header_->validate())) {
+    LOG_ERROR("Failed to open %s, it is not a buffer pool file of the current format.", file_name);
+    file_header_ = nullptr;
+    purge_frame(BP_HEADER_PAGE, hdr_frame_);
+    hdr_frame_ = nullptr;
+    close(fd);
+    file_desc_ = -1;
+    return rc;
+  }
 
   LOG_INFO("Successfully open %s. file_desc=%d, hdr_frame=%p, file header=%s",
            file_name, file_desc_, hdr_frame_, file_header_->to_string().c_str());
@@ -283,6 +567,8 @@ RC DiskBufferPool::close_file()
     return rc;
   }
 
+  bp_manager_.cancel_read_ahead(this);
+
   hdr_frame_->unpin();
 
   // TODO: 理论上是在回放时回滚未提交事务，但目前没有undo log，因此不下刷数据page，只通过redo log回放
@@ -311,40 +597,76 @@ RC DiskBufferPool::close_file()
   return RC::SUCCESS;
 }
 
-RC DiskBufferPool::get_this_page(PageNum page_num, Frame **frame)
+RC DiskBufferPool::get_this_page(PageNum page_num, Frame **frame, BPAccessHint hint /* = BPAccessHint::NORMAL */)
+{
+  bool missed = false;
+  RC   rc     = fetch_page(page_num, frame, hint, missed);
+  if (OB_SUCC(rc)) {
+    // 预读可能会在当前线程中执行，需要先释放页面的锁
+    check_read_ahead(page_num, missed, hint);
+  }
+  return rc;
+}
+
+RC DiskBufferPool::fetch_page(PageNum page_num, Frame **frame, BPAccessHint hint, bool &missed)
 {
   RC rc  = RC::SUCCESS;
   *frame = nullptr;
+  missed = false;
 
-  Frame *used_match_frame = frame_manager_.get(id(), page_num);
+  Frame *used_match_frame = frame_manager_.get(id(), page_num, hint);
   if (used_match_frame != nullptr) {
     used_match_frame->access();
     *frame = used_match_frame;
     return RC::SUCCESS;
   }
 
-  scoped_lock lock_guard(lock_);  // 直接加了一把大锁，其实可以根据访问的页面来细化提高并行度
+  // 只锁住当前页面对应的锁，加载其它页面的线程不会被阻塞
+  scoped_lock lock_guard(page_locks_[page_num % PAGE_LOCK_NUM]);
 
-  // Allocate one page and load the data into this page
-  Frame *allocated_frame = nullptr;
+  while (true) {
+    // 等锁的过程中，其它线程可能已经把这个页面加载进来了，不能再从磁盘加载覆盖掉它
+    used_match_frame = frame_manager_.get(id(), page_num, hint);
+    if (used_match_frame != nullptr) {
+      used_match_frame->access();
+      *frame = used_match_frame;
+      return RC::SUCCESS;
+    }
 
-  rc = allocate_frame(page_num, &allocated_frame);
-  if (rc != RC::SUCCESS) {
-    LOG_ERROR("Failed to alloc frame %s:%d, due to failed to alloc page.", file_name_.c_str(), page_num);
-    return rc;
-  }
+    /*
+     * 先把数据加载到一个还没有放到分片中的页帧里，再让其它线程看到它。上面第一次查找页帧时没有加锁，
+     * 如果先放到分片中再加载，其它线程(比如不加锁的B+树乐观读)可能拿到还没有加载完的页帧，读到上一个页面的数据
+     */
+    Frame *allocated_frame = nullptr;
 
-  allocated_frame->set_buffer_pool_id(id());
-  // allocated_frame->pin(); // pined in manager::get
-  allocated_frame->access();
+    rc = allocate_free_frame(&allocated_frame);
+    if (rc != RC::SUCCESS) {
+      LOG_ERROR("Failed to alloc frame %s:%d, due to failed to alloc page.", file_name_.c_str(), page_num);
+      return rc;
+    }
 
-  if ((rc = load_page(page_num, allocated_frame)) != RC::SUCCESS) {
-    LOG_ERROR("Failed to load page %s:%d", file_name_.c_str(), page_num);
-    purge_frame(page_num, allocated_frame);
-    return rc;
-  }
+    allocated_frame->set_buffer_pool_id(id());
+    allocated_frame->set_page_num(page_num);
 
-  *frame = allocated_frame;
+    if ((rc = load_page(page_num, allocated_frame)) != RC::SUCCESS) {
+      LOG_ERROR("Failed to load page %s:%d", file_name_.c_str(), page_num);
+      frame_manager_.release_free_frame(allocated_frame);
+      return rc;
+    }
+
+    // install_frame 会unpin一次，返回给调用者的页帧还要保持pin住
+    allocated_frame->pin();
+    if (frame_manager_.install_frame(allocated_frame, hint)) {
+      allocated_frame->access();
+      *frame = allocated_frame;
+      missed = true;
+      return RC::SUCCESS;
+    }
+
+    // 预读的线程已经把这个页面加载进来了，使用它加载的页帧
+    allocated_frame->unpin();
+    frame_manager_.release_free_frame(allocated_frame);
+  }
   return RC::SUCCESS;
 }
 
@@ -354,51 +676,80 @@ RC DiskBufferPool::allocate_page(Frame **frame)
 
   lock_.lock();
 
-  int byte = 0, bit = 0;
-  if ((file_header_->allocated_pages) < (file_header_->page_count)) {
-    // There is one free page
-    for (int i = 0; i < file_header_->page_count; i++) {
-      byte = i / 8;
-      bit  = i % 8;
-      if (((file_header_->bitmap[byte]) & (1 << bit)) == 0) {
-        (file_header_->allocated_pages)++;
-        file_header_->bitmap[byte] |= (1 << bit);
-        // TODO,  do we need clean the loaded page's data?
-        hdr_frame_->mark_dirty();
-        LSN lsn = 0;
-        rc = log_handler_.allocate_page(i, lsn);
-        if (OB_FAIL(rc)) {
-          LOG_ERROR("Failed to log allocate page %d, rc=%s", i, strrc(rc));
-          // 忽略了错误
-        }
-
-        hdr_frame_->set_lsn(lsn);
-
-        LOG_DEBUG("allocate a new page without extend buffer pool. page num=%d, buffer pool=%d", i, id());
+  // 先在区的摘要中找到一个没有满的区，再从这个区的位图中找空闲页面
+  Bitmap summary(file_header_->full_extents(), file_header_->extent_count);
+  Frame *extent_frame = nullptr;
+  char  *bitmap       = nullptr;
+  int    extent       = summary.next_unsetted_bit(first_free_extent_);
+  int    index        = -1;
+  for (; extent != -1; extent = summary.next_unsetted_bit(extent + 1)) {
+    rc = get_extent_bitmap(extent, extent_frame, bitmap);
+    if (OB_FAIL(rc)) {
+      LOG_ERROR("Failed to get extent bitmap. file=%s, extent=%d, rc=%s", file_name_.c_str(), extent, strrc(rc));
+      lock_.unlock();
+      return rc;
+    }
 
-        lock_.unlock();
-        return get_this_page(i, frame);
-      }
+    index = Bitmap(bitmap, BP_EXTENT_PAGES).next_unsetted_bit(0);
+    if (index != -1) {
+      break;
     }
+
+    // 摘要可能不准确，比如重做日志之后，这里修正一下
+    update_extent_summary(extent, bitmap);
+    extent_frame->unpin();
   }
 
-  if (file_header_->page_count >= BPFileHeader::MAX_PAGE_NUM) {
-    LOG_WARN("file buffer pool is full. page count %d, max page count %d",
-        file_header_->page_count, BPFileHeader::MAX_PAGE_NUM);
-    lock_.unlock();
-    return RC::BUFFERPOOL_NOBUF;
+  const bool new_extent = (extent == -1);
+  if (new_extent) {
+    extent = file_header_->extent_count;
+    index  = 1;  // 第0个页面是区的位图页
+    if (extent >= BPFileHeader::MAX_EXTENT_NUM) {
+      LOG_WARN("file buffer pool is full. page count %d, max page count %d",
+          file_header_->page_count, BPFileHeader::MAX_PAGE_NUM);
+      lock_.unlock();
+      return RC::BUFFERPOOL_NOBUF;
+    }
   }
+  first_free_extent_ = extent;
 
-  LSN lsn = 0;
-  rc = log_handler_.allocate_page(file_header_->page_count, lsn);
+  PageNum page_num = extent * BP_EXTENT_PAGES + index;
+  LSN     lsn      = 0;
+  rc = log_handler_.allocate_page(page_num, lsn);
   if (OB_FAIL(rc)) {
-    LOG_ERROR("Failed to log allocate page %d, rc=%s", file_header_->page_count, strrc(rc));
+    LOG_ERROR("Failed to log allocate page %d, rc=%s", page_num, strrc(rc));
     // 忽略了错误
   }
+
+  if (new_extent) {
+    rc = create_extent(extent, lsn, extent_frame, bitmap);
+    if (OB_FAIL(rc)) {
+      LOG_ERROR("Failed to create extent. file=%s, extent=%d, rc=%s", file_name_.c_str(), extent, strrc(rc));
+      lock_.unlock();
+      return rc;
+    }
+  }
+
+  Bitmap(bitmap, BP_EXTENT_PAGES).set_bit(index);
+  extent_frame->set_lsn(lsn);
+  extent_frame->mark_dirty();
+
+  file_header_->allocated_pages++;
+  update_extent_summary(extent, bitmap);
   hdr_frame_->set_lsn(lsn);
+  hdr_frame_->mark_dirty();
+  extent_frame->unpin();
+
+  if (page_num < file_header_->page_count) {
+    // TODO,  do we need clean the loaded page's data?
+    LOG_DEBUG("allocate a new page without extend buffer pool. page num=%d, buffer pool=%d", page_num, id());
+
+    lock_.unlock();
+    return get_this_page(page_num, frame);
+  }
 
-  PageNum page_num        = file_header_->page_count;
-  Frame  *allocated_frame = nullptr;
+  // 区中第一个空闲的页面在文件尾，扩展文件
+  Frame *allocated_frame = nullptr;
   if ((rc = allocate_frame(page_num, &allocated_frame)) != RC::SUCCESS) {
     LOG_ERROR("Failed to allocate frame %s, due to no free page.", file_name_.c_str());
     lock_.unlock();
@@ -408,18 +759,12 @@ RC DiskBufferPool::allocate_page(Frame **frame)
   LOG_INFO("allocate new page by extending bufferpool. buffer_pool_id=%d, pageNum=%d, pin=%d",
            id(), page_num, allocated_frame->pin_count());
 
-  file_header_->allocated_pages++;
-  file_header_->page_count++;
-
-  byte = page_num / 8;
-  bit  = page_num % 8;
-  file_header_->bitmap[byte] |= (1 << bit);
-  hdr_frame_->mark_dirty();
+  file_header_->page_count = page_num + 1;
 
   allocated_frame->set_buffer_pool_id(id());
   allocated_frame->access();
   allocated_frame->clear_page();
-  allocated_frame->set_page_num(file_header_->page_count - 1);
+  allocated_frame->set_page_num(page_num);
 
   // Use flush operation to extension file
   if ((rc = flush_page_internal(*allocated_frame)) != RC::SUCCESS) {
@@ -436,12 +781,19 @@ RC DiskBufferPool::allocate_page(Frame **frame)
 
 RC DiskBufferPool::dispose_page(PageNum page_num)
 {
-  if (page_num == 0) {
-    LOG_ERROR("Failed to dispose page %d, because it is the first page. filename=%s", page_num, file_name_.c_str());
+  if (page_num == 0 || is_extent_page(page_num)) {
+    LOG_ERROR("Failed to dispose page %d, because it is the header or an extent page. filename=%s", 
+              page_num, file_name_.c_str());
     return RC::INTERNAL;
   }
   
   scoped_lock lock_guard(lock_);
+  if (page_num >= file_header_->page_count) {
+    LOG_ERROR("Failed to dispose page %d, because it is not exist. filename=%s, page count=%d", 
+              page_num, file_name_.c_str(), file_header_->page_count);
+    return RC::BUFFERPOOL_INVALID_PAGE_NUM;
+  }
+
   Frame           *used_frame = frame_manager_.get(id(), page_num);
   if (used_frame != nullptr) {
     ASSERT("the page try to dispose is in use. frame:%s", used_frame->to_string().c_str());
@@ -450,24 +802,38 @@ RC DiskBufferPool::dispose_page(PageNum page_num)
     LOG_DEBUG("page not found in memory while disposing it. pageNum=%d", page_num);
   }
 
+  const int extent       = page_num / BP_EXTENT_PAGES;
+  Frame    *extent_frame = nullptr;
+  char     *bitmap       = nullptr;
+  RC        rc           = get_extent_bitmap(extent, extent_frame, bitmap);
+  if (OB_FAIL(rc)) {
+    LOG_ERROR("Failed to get extent bitmap. file=%s, extent=%d, rc=%s", file_name_.c_str(), extent, strrc(rc));
+    return rc;
+  }
+
   LSN lsn = 0;
-  RC rc = log_handler_.deallocate_page(page_num, lsn);
+  rc = log_handler_.deallocate_page(page_num, lsn);
   if (OB_FAIL(rc)) {
     LOG_ERROR("Failed to log deallocate page %d, rc=%s", page_num, strrc(rc));
     // ignore error handle
   }
 
+  Bitmap(bitmap, BP_EXTENT_PAGES).clear_bit(page_num % BP_EXTENT_PAGES);
+  extent_frame->set_lsn(lsn);
+  extent_frame->mark_dirty();
+
   hdr_frame_->set_lsn(lsn);
   hdr_frame_->mark_dirty();
   file_header_->allocated_pages--;
-  char tmp = 1 << (page_num % 8);
-  file_header_->bitmap[page_num / 8] &= ~tmp;
+  update_extent_summary(extent, bitmap);
+  first_free_extent_ = min(first_free_extent_, extent);
+  extent_frame->unpin();
   return RC::SUCCESS;
 }
 
 RC DiskBufferPool::unpin_page(Frame *frame)
 {
-  frame->unpin();
+  frame_manager_.unpin(frame);
   return RC::SUCCESS;
 }
 
@@ -547,6 +913,11 @@ RC DiskBufferPool::flush_page_internal(Frame &frame)
   // The better way is use mmap the block into memory,
   // so it is easier to flush data to file.
 
+  // 页面已经释放了，可能已经分配给了其它数据，不能再写回
+  if (frame.disposed()) {
+    return RC::SUCCESS;
+  }
+
   RC rc = log_handler_.flush_page(frame.page());
   if (OB_FAIL(rc)) {
     LOG_ERROR("Failed to log flush frame= %s, rc=%s", frame.to_string().c_str(), strrc(rc));
@@ -580,33 +951,87 @@ RC DiskBufferPool::flush_all_pages()
   return RC::SUCCESS;
 }
 
+RC DiskBufferPool::flush_frames(vector<Frame *> &frames, int &flushed_num)
+{
+  flushed_num = 0;
+  sort(frames.begin(), frames.end(), [](const Frame *a, const Frame *b) { return a->page_num() < b->page_num(); });
+
+  vector<Frame *> latched_frames;
+  latched_frames.reserve(frames.size());
+  Frame *max_lsn_frame = nullptr;
+  for (Frame *frame : frames) {
+    // 后台刷页不等待正在被修改的页面，下一轮再刷新
+    if (!frame->try_read_latch()) {
+      continue;
+    }
+    // 拿到读锁之后页面的LSN就不会再变了
+    latched_frames.push_back(frame);
+    if (max_lsn_frame == nullptr || frame->lsn() > max_lsn_frame->lsn()) {
+      max_lsn_frame = frame;
+    }
+  }
+
+  if (max_lsn_frame == nullptr) {
+    return RC::SUCCESS;
+  }
+
+  // 等待日志刷盘的时候不拿着 BufferPool 的锁，以免阻塞其它线程分配和读取页面
+  RC rc = log_handler_.flush_page(max_lsn_frame->page());
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to wait log flushed. frame=%s, rc=%s", max_lsn_frame->to_string().c_str(), strrc(rc));
+  }
+
+  scoped_lock lock_guard(lock_);
+  for (Frame *frame : latched_frames) {
+    if (OB_SUCC(rc) && frame->dirty()) {
+      rc = flush_page_internal(*frame);
+      if (OB_SUCC(rc)) {
+        flushed_num++;
+      } else {
+        LOG_WARN("failed to flush page. frame=%s, rc=%s", frame->to_string().c_str(), strrc(rc));
+      }
+    }
+    frame->read_unlatch();
+  }
+  return rc;
+}
+
 RC DiskBufferPool::recover_page(PageNum page_num)
 {
-  int byte = 0, bit = 0;
-  byte = page_num / 8;
-  bit  = page_num % 8;
+  const int extent = page_num / BP_EXTENT_PAGES;
+  if (page_num <= 0 || is_extent_page(page_num) || extent >= BPFileHeader::MAX_EXTENT_NUM) {
+    LOG_WARN("invalid page num to recover. file=%s, page num=%d", file_name_.c_str(), page_num);
+    return RC::BUFFERPOOL_INVALID_PAGE_NUM;
+  }
 
   scoped_lock lock_guard(lock_);
-  if (!(file_header_->bitmap[byte] & (1 << bit))) {
-    file_header_->bitmap[byte] |= (1 << bit);
+  Frame *extent_frame = nullptr;
+  char  *bitmap       = nullptr;
+  RC     rc           = redo_get_extent_bitmap(extent, extent_frame, bitmap);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  Bitmap    extent_bitmap(bitmap, BP_EXTENT_PAGES);
+  const int index = page_num % BP_EXTENT_PAGES;
+  if (!extent_bitmap.get_bit(index)) {
+    extent_bitmap.set_bit(index);
+    extent_frame->mark_dirty();
     file_header_->allocated_pages++;
-    file_header_->page_count++;
+    file_header_->page_count = max(file_header_->page_count, page_num + 1);
+    update_extent_summary(extent, bitmap);
     hdr_frame_->mark_dirty();
   }
+  extent_frame->unpin();
   return RC::SUCCESS;
 }
 
 RC DiskBufferPool::write_page(PageNum page_num, Page &page)
 {
-  scoped_lock lock_guard(wr_lock_);
-  int64_t     offset = ((int64_t)page_num) * sizeof(Page);
-  if (lseek(file_desc_, offset, SEEK_SET) == -1) {
-    LOG_ERROR("Failed to write page %lld of %d due to failed to seek %s.", offset, file_desc_, strerror(errno));
-    return RC::IOERR_SEEK;
-  }
-
-  if (writen(file_desc_, &page, sizeof(Page)) != 0) {
-    LOG_ERROR("Failed to write page %lld of %d due to %s.", offset, file_desc_, strerror(errno));
+  int64_t offset = ((int64_t)page_num) * sizeof(Page);
+  int     ret    = common::AsyncIOEngine::instance().write(file_desc_, &page, sizeof(Page), offset);
+  if (ret != 0) {
+    LOG_ERROR("Failed to write page %lld of %d due to %s.", offset, file_desc_, strerror(ret));
     return RC::IOERR_WRITE;
   }
 
@@ -614,78 +1039,264 @@ RC DiskBufferPool::write_page(PageNum page_num, Page &page)
   return RC::SUCCESS;
 }
 
+void DiskBufferPool::add_write_page(common::AsyncIOBatch &batch, PageNum page_num, const Page &page)
+{
+  batch.add_write(file_desc_, &page, sizeof(Page), ((int64_t)page_num) * sizeof(Page));
+  LOG_TRACE("add write page: buffer_pool_id:%d, page_num:%d, lsn=%d, check_sum=%d", id(), page_num, page.lsn, page.check_sum);
+}
+
 RC DiskBufferPool::redo_allocate_page(LSN lsn, PageNum page_num)
 {
-  if (hdr_frame_->lsn() >= lsn) {
-    return RC::SUCCESS;
+  const int extent = page_num / BP_EXTENT_PAGES;
+  const int index  = page_num % BP_EXTENT_PAGES;
+  if (page_num <= 0 || is_extent_page(page_num) || extent >= BPFileHeader::MAX_EXTENT_NUM) {
+    LOG_WARN("invalid page num to allocate. file=%s, page num=%d", file_name_.c_str(), page_num);
+    return RC::INTERNAL;
   }
 
   // scoped_lock lock_guard(lock_); // redo 过程中可以不加锁
-  if (page_num < file_header_->page_count) {
-    Bitmap bitmap(file_header_->bitmap, file_header_->page_count);
-    if (bitmap.get_bit(page_num)) {
+  // 文件头和区的位图页可能不是同时写到磁盘上的，按照各自的LSN判断是否需要重做
+  const bool redo_header  = hdr_frame_->lsn() < lsn;
+  Frame     *extent_frame = nullptr;
+  char      *bitmap       = nullptr;
+  RC         rc           = redo_get_extent_bitmap(extent, extent_frame, bitmap);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  Bitmap extent_bitmap(bitmap, BP_EXTENT_PAGES);
+  if (extent_frame->lsn() < lsn) {
+    if (extent_bitmap.get_bit(index)) {
       LOG_WARN("page %d has been allocated. file=%s", page_num, file_name_.c_str());
-      return RC::SUCCESS;
     }
+    extent_bitmap.set_bit(index);
+    extent_frame->set_lsn(lsn);
+    extent_frame->mark_dirty();
+  }
 
-    bitmap.set_bit(page_num);
+  // 新分配的页面可能还没有写到磁盘上，文件头落盘了也不能说明文件足够大。后面回放这个页面的日志时需要读取它，所以先扩展文件
+  struct stat st;
+  const int64_t file_size = static_cast<int64_t>(page_num + 1) * BP_PAGE_SIZE;
+  if (fstat(file_desc_, &st) != 0 || (st.st_size < file_size && ftruncate(file_desc_, file_size) != 0)) {
+    LOG_ERROR("failed to extend file. file=%s, page num=%d, error=%s", file_name_.c_str(), page_num, strerror(errno));
+    extent_frame->unpin();
+    return RC::IOERR_WRITE;
+  }
+
+  if (redo_header) {
     file_header_->allocated_pages++;
+    file_header_->page_count = max(file_header_->page_count, page_num + 1);
+    update_extent_summary(extent, bitmap);
+    hdr_frame_->set_lsn(lsn);
     hdr_frame_->mark_dirty();
-    return RC::SUCCESS;
   }
 
-  if (page_num > file_header_->page_count) {
-    LOG_WARN("page %d is not continuous. file=%s, page_count=%d",
-             page_num, file_name_.c_str(), file_header_->page_count);
+  extent_frame->unpin();
+  LOG_TRACE("[redo] allocate page. file=%s, pageNum=%d", file_name_.c_str(), page_num);
+  return RC::SUCCESS;
+}
+
+RC DiskBufferPool::redo_deallocate_page(LSN lsn, PageNum page_num)
+{
+  const int extent = page_num / BP_EXTENT_PAGES;
+  const int index  = page_num % BP_EXTENT_PAGES;
+  if (page_num >= file_header_->page_count || page_num <= 0 || is_extent_page(page_num)) {
+    LOG_WARN("page %d is not exist. file=%s", page_num, file_name_.c_str());
     return RC::INTERNAL;
   }
 
-  // page_num == file_header_->page_count
-  if (file_header_->page_count >= BPFileHeader::MAX_PAGE_NUM) {
-    LOG_WARN("file buffer pool is full. page count %d, max page count %d",
-        file_header_->page_count, BPFileHeader::MAX_PAGE_NUM);
-    return RC::INTERNAL;
+  const bool redo_header  = hdr_frame_->lsn() < lsn;
+  Frame     *extent_frame = nullptr;
+  char      *bitmap       = nullptr;
+  RC         rc           = redo_get_extent_bitmap(extent, extent_frame, bitmap);
+  if (OB_FAIL(rc)) {
+    return rc;
   }
 
-  file_header_->allocated_pages++;
-  file_header_->page_count++;
-  hdr_frame_->set_lsn(lsn);
-  hdr_frame_->mark_dirty();
-  
-  // TODO 应该检查文件是否足够大，包含了当前新分配的页面
+  Bitmap extent_bitmap(bitmap, BP_EXTENT_PAGES);
+  if (extent_frame->lsn() < lsn) {
+    if (!extent_bitmap.get_bit(index)) {
+      LOG_WARN("page %d has been deallocated. file=%s", page_num, file_name_.c_str());
+      extent_frame->unpin();
+      return RC::INTERNAL;
+    }
+    extent_bitmap.clear_bit(index);
+    extent_frame->set_lsn(lsn);
+    extent_frame->mark_dirty();
+  }
+
+  if (redo_header) {
+    file_header_->allocated_pages--;
+    update_extent_summary(extent, bitmap);
+    hdr_frame_->set_lsn(lsn);
+    hdr_frame_->mark_dirty();
+  }
 
-  Bitmap bitmap(file_header_->bitmap, file_header_->page_count);
-  bitmap.set_bit(page_num);
-  LOG_TRACE("[redo] allocate new page. file=%s, pageNum=%d", file_name_.c_str(), page_num);
+  extent_frame->unpin();
+  LOG_TRACE("[redo] deallocate page. file=%s, pageNum=%d", file_name_.c_str(), page_num);
   return RC::SUCCESS;
 }
 
-RC DiskBufferPool::redo_deallocate_page(LSN lsn, PageNum page_num)
+RC DiskBufferPool::get_extent_bitmap(int extent, Frame *&frame, char *&bitmap)
 {
-  if (hdr_frame_->lsn() >= lsn) {
+  if (extent == 0) {
+    frame = hdr_frame_;
+    frame->pin();
+    bitmap = file_header_->bitmap;
     return RC::SUCCESS;
   }
 
-  if (page_num >= file_header_->page_count) {
-    LOG_WARN("page %d is not exist. file=%s", page_num, file_name_.c_str());
-    return RC::INTERNAL;
+  if (extent >= file_header_->extent_count) {
+    LOG_WARN("extent is not created. file=%s, extent=%d, extent count=%d", 
+             file_name_.c_str(), extent, file_header_->extent_count);
+    return RC::BUFFERPOOL_INVALID_PAGE_NUM;
   }
 
-  Bitmap bitmap(file_header_->bitmap, file_header_->page_count);
-  if (!bitmap.get_bit(page_num)) {
-    LOG_WARN("page %d has been deallocated. file=%s", page_num, file_name_.c_str());
+  // 不能预读，预读会通过 BufferPoolIterator 获取区的位图
+  bool missed = false;
+  RC   rc     = fetch_page(extent * BP_EXTENT_PAGES, &frame, BPAccessHint::NORMAL, missed);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  auto *extent_page = reinterpret_cast<BPExtentPage *>(frame->data());
+  if (extent_page->extent != extent) {
+    LOG_ERROR("invalid extent page. file=%s, extent=%d, extent in page=%d", 
+              file_name_.c_str(), extent, extent_page->extent);
+    frame->unpin();
     return RC::INTERNAL;
   }
 
-  bitmap.clear_bit(page_num);
-  file_header_->allocated_pages--;
-  hdr_frame_->set_lsn(lsn);
-  hdr_frame_->mark_dirty();
-  LOG_TRACE("[redo] deallocate page. file=%s, pageNum=%d", file_name_.c_str(), page_num);
+  bitmap = extent_page->bitmap;
+  return RC::SUCCESS;
+}
+
+RC DiskBufferPool::create_extent(int extent, LSN lsn, Frame *&frame, char *&bitmap)
+{
+  const PageNum page_num = extent * BP_EXTENT_PAGES;
+
+  RC rc = allocate_frame(page_num, &frame);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  frame->set_buffer_pool_id(id());
+  frame->access();
+  frame->clear_page();
+  frame->set_page_num(page_num);
+
+  auto *extent_page   = reinterpret_cast<BPExtentPage *>(frame->data());
+  extent_page->extent = extent;
+  Bitmap(extent_page->bitmap, BP_EXTENT_PAGES).set_bit(0);
+
+  file_header_->extent_count = extent + 1;
+  file_header_->allocated_pages++;
+  file_header_->page_count = page_num + 1;
+
+  // 与扩展数据页一样先写一次来扩展文件。这时页面的LSN还是0，不需要等待日志落盘
+  frame->mark_dirty();
+  if ((rc = flush_page_internal(*frame)) != RC::SUCCESS) {
+    LOG_WARN("Failed to flush extent page. file=%s, extent=%d, rc=%s", file_name_.c_str(), extent, strrc(rc));
+  }
+
+  frame->set_lsn(lsn);
+  frame->mark_dirty();
+  bitmap = extent_page->bitmap;
+
+  LOG_INFO("create extent. file=%s, extent=%d, page num=%d", file_name_.c_str(), extent, page_num);
   return RC::SUCCESS;
 }
 
-RC DiskBufferPool::allocate_frame(PageNum page_num, Frame **buffer)
+RC DiskBufferPool::redo_get_extent_bitmap(int extent, Frame *&frame, char *&bitmap)
+{
+  if (extent == 0) {
+    return get_extent_bitmap(extent, frame, bitmap);
+  }
+
+  const PageNum page_num = extent * BP_EXTENT_PAGES;
+
+  frame      = nullptr;
+  bool valid = false;
+  if (page_num < file_header_->page_count) {
+    bool missed = false;
+    RC   rc     = fetch_page(page_num, &frame, BPAccessHint::NORMAL, missed);
+    if (OB_SUCC(rc)) {
+      valid = reinterpret_cast<BPExtentPage *>(frame->data())->extent == extent;
+    } else {
+      frame = nullptr;
+      LOG_INFO("[redo] extent page is not in the file. file=%s, extent=%d, rc=%s", 
+               file_name_.c_str(), extent, strrc(rc));
+    }
+  }
+
+  if (frame == nullptr) {
+    RC rc = allocate_frame(page_num, &frame);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    frame->set_buffer_pool_id(id());
+    frame->access();
+    frame->set_page_num(page_num);
+  }
+
+  auto *extent_page = reinterpret_cast<BPExtentPage *>(frame->data());
+  if (!valid) {
+    // LSN 是0，这个区所有的分配和释放日志都会重做
+    frame->clear_page();
+    extent_page->extent = extent;
+    Bitmap(extent_page->bitmap, BP_EXTENT_PAGES).set_bit(0);
+    frame->mark_dirty();
+    LOG_INFO("[redo] init extent page. file=%s, extent=%d", file_name_.c_str(), extent);
+  }
+
+  if (extent >= file_header_->extent_count) {
+    file_header_->extent_count = extent + 1;
+    file_header_->allocated_pages++;
+    file_header_->page_count = max(file_header_->page_count, page_num + 1);
+    hdr_frame_->mark_dirty();
+  }
+
+  bitmap = extent_page->bitmap;
+  return RC::SUCCESS;
+}
+
+void DiskBufferPool::update_extent_summary(int extent, char *bitmap)
+{
+  Bitmap summary(file_header_->full_extents(), BPFileHeader::MAX_EXTENT_NUM);
+  if (Bitmap(bitmap, BP_EXTENT_PAGES).next_unsetted_bit(0) == -1) {
+    summary.set_bit(extent);
+  } else {
+    summary.clear_bit(extent);
+  }
+}
+
+RC DiskBufferPool::copy_extent_bitmap(int extent, char *bitmap)
+{
+  scoped_lock lock_guard(lock_);
+
+  Frame *frame         = nullptr;
+  char  *extent_bitmap = nullptr;
+  RC     rc            = get_extent_bitmap(extent, frame, extent_bitmap);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  memcpy(bitmap, extent_bitmap, BP_EXTENT_BITMAP_SIZE);
+  frame->unpin();
+  return RC::SUCCESS;
+}
+
+RC DiskBufferPool::allocate_frame(PageNum page_num, Frame **buffer, BPAccessHint hint /* = BPAccessHint::NORMAL */)
+{
+  return allocate_frame([this, page_num, hint]() { return frame_manager_.alloc(id(), page_num, hint); }, buffer);
+}
+
+RC DiskBufferPool::allocate_free_frame(Frame **buffer)
+{
+  return allocate_frame([this]() { return frame_manager_.alloc_free_frame(); }, buffer);
+}
+
+RC DiskBufferPool::allocate_frame(const function<Frame *()> &allocator, Frame **buffer)
 {
   auto purger = [this](Frame *frame) {
     if (!frame->dirty()) {
@@ -706,10 +1317,11 @@ RC DiskBufferPool::allocate_frame(PageNum page_num, Frame **buffer)
   };
 
   while (true) {
-    Frame *frame = frame_manager_.alloc(id(), page_num);
+    Frame *frame = allocator();
     if (frame != nullptr) {
+      bp_manager_.wakeup_page_cleaner();
       *buffer = frame;
-      LOG_DEBUG("allocate frame %p, page num %d, frame=%s", frame, page_num, frame->to_string().c_str());
+      LOG_DEBUG("allocate frame %p, frame=%s", frame, frame->to_string().c_str());
       return RC::SUCCESS;
     }
 
@@ -721,11 +1333,22 @@ RC DiskBufferPool::allocate_frame(PageNum page_num, Frame **buffer)
 
 RC DiskBufferPool::check_page_num(PageNum page_num)
 {
-  if (page_num >= file_header_->page_count) {
+  if (page_num >= file_header_->page_count || is_extent_page(page_num)) {
     LOG_ERROR("Invalid pageNum:%d, file's name:%s", page_num, file_name_.c_str());
     return RC::BUFFERPOOL_INVALID_PAGE_NUM;
   }
-  if ((file_header_->bitmap[page_num / 8] & (1 << (page_num % 8))) == 0) {
+
+  scoped_lock lock_guard(lock_);
+  Frame *frame  = nullptr;
+  char  *bitmap = nullptr;
+  RC     rc     = get_extent_bitmap(page_num / BP_EXTENT_PAGES, frame, bitmap);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  const bool allocated = Bitmap(bitmap, BP_EXTENT_PAGES).get_bit(page_num % BP_EXTENT_PAGES);
+  frame->unpin();
+  if (!allocated) {
     LOG_ERROR("Invalid pageNum:%d, file's name:%s", page_num, file_name_.c_str());
     return RC::BUFFERPOOL_INVALID_PAGE_NUM;
   }
@@ -740,18 +1363,11 @@ RC DiskBufferPool::load_page(PageNum page_num, Frame *frame)
     return rc;
   }
 
-  scoped_lock lock_guard(wr_lock_);
-  int64_t          offset = ((int64_t)page_num) * BP_PAGE_SIZE;
-  if (lseek(file_desc_, offset, SEEK_SET) == -1) {
-    LOG_ERROR("Failed to load page %s:%d, due to failed to lseek:%s.", file_name_.c_str(), page_num, strerror(errno));
-
-    return RC::IOERR_SEEK;
-  }
-
-  int ret = readn(file_desc_, &page, BP_PAGE_SIZE);
+  int64_t offset = ((int64_t)page_num) * BP_PAGE_SIZE;
+  int     ret    = common::AsyncIOEngine::instance().read(file_desc_, &page, BP_PAGE_SIZE, offset);
   if (ret != 0) {
     LOG_ERROR("Failed to load page %s, file_desc:%d, page num:%d, due to failed to read data:%s, ret=%d, page count=%d",
-              file_name_.c_str(), file_desc_, page_num, strerror(errno), ret, file_header_->allocated_pages);
+              file_name_.c_str(), file_desc_, page_num, ret > 0 ? strerror(ret) : "eof", ret, file_header_->allocated_pages);
     return RC::IOERR_READ;
   }
 
@@ -762,22 +1378,188 @@ RC DiskBufferPool::load_page(PageNum page_num, Frame *frame)
   return RC::SUCCESS;
 }
 
+void DiskBufferPool::check_read_ahead(PageNum page_num, bool missed, BPAccessHint hint)
+{
+  BPReadAheader *read_aheader = bp_manager_.read_aheader();
+  if (read_aheader == nullptr || read_aheader->pages() <= 0) {
+    return;
+  }
+
+  // 顺序访问到了上次预读的中间位置，接着预读后面的页面，这样访问到后面的页面时它们已经在内存中了
+  PageNum trigger_page = page_num;
+  PageNum after_page   = page_num;
+  bool    need_read    = read_ahead_trigger_.load(memory_order_relaxed) == page_num &&
+                   read_ahead_trigger_.compare_exchange_strong(trigger_page, -1);
+  if (need_read) {
+    after_page = read_ahead_last_.load();
+  } else if (missed) {
+    // 上次预读的页面还没有加载完，或者又被淘汰了，不需要重复预读
+    const PageNum last_miss_page = last_miss_page_.exchange(page_num);
+    const bool    in_last_read   = page_num >= read_ahead_first_.load() && page_num <= read_ahead_last_.load();
+    need_read = !in_last_read && (hint == BPAccessHint::SCAN || last_miss_page + 1 == page_num);
+  }
+
+  if (!need_read) {
+    return;
+  }
+
+  vector<PageNum> pages;
+  pages.reserve(read_aheader->pages());
+
+  BufferPoolIterator iterator;
+  iterator.init(*this, after_page + 1);
+  while (static_cast<int>(pages.size()) < read_aheader->pages()) {
+    const PageNum next_page = iterator.next();
+    if (next_page == -1) {
+      break;
+    }
+    pages.push_back(next_page);
+  }
+
+  if (pages.empty()) {
+    return;
+  }
+
+  read_ahead_first_.store(pages.front());
+  read_ahead_last_.store(pages.back());
+  read_ahead_trigger_.store(pages[pages.size() / 2]);
+  read_aheader->submit(this, std::move(pages));
+}
+
+RC DiskBufferPool::read_ahead(const vector<PageNum> &pages, int &reads_num, int &loaded_num, int &discarded_num)
+{
+  reads_num     = 0;
+  loaded_num    = 0;
+  discarded_num = 0;
+
+  // 页面放到 BPFrameManager 之前一直持有加载页面的锁。否则访问线程可能同时从磁盘加载这个页面，
+  // 修改、刷盘并淘汰之后，预读又放进去一个旧版本。只尝试加锁，拿不到锁说明有线程正在加载，跳过这个页面
+  bitset<PAGE_LOCK_NUM> locked;
+  DEFER(for (int i = 0; i < PAGE_LOCK_NUM; i++) {
+    if (locked.test(i)) {
+      page_locks_[i].unlock();
+    }
+  });
+
+  vector<PageNum> missing_pages;
+  missing_pages.reserve(pages.size());
+  for (PageNum page_num : pages) {
+    const int lock_index = page_num % PAGE_LOCK_NUM;
+    if (!locked.test(lock_index)) {
+      if (!page_locks_[lock_index].try_lock()) {
+        continue;
+      }
+      locked.set(lock_index);
+    }
+
+    if (!frame_manager_.contains(id(), page_num)) {
+      missing_pages.push_back(page_num);
+    }
+  }
+
+  // 预读不应该让访问线程等待刷脏页，所以只释放干净的页帧
+  const int lacking_num = static_cast<int>(missing_pages.size()) - frame_manager_.free_frame_num();
+  if (lacking_num > 0) {
+    frame_manager_.evict_clean_frames(lacking_num);
+  }
+
+  vector<Frame *> frames;
+  frames.reserve(missing_pages.size());
+  for (PageNum page_num : missing_pages) {
+    Frame *frame = frame_manager_.alloc_free_frame();
+    if (frame == nullptr) {
+      break;
+    }
+    frame->set_buffer_pool_id(id());
+    frame->set_page_num(page_num);
+    frames.push_back(frame);
+  }
+
+  // 每一段页号连续的页面是一个 readv 请求，所有请求一起提交，由异步IO引擎并行地读
+  unique_ptr<Page>      discard_page;  // 已经从 double write buffer 读到数据的页面，磁盘上的旧数据读到这里丢掉
+  vector<iovec>         iovs(frames.size());
+  vector<size_t>        run_begins;
+  common::AsyncIOBatch  batch;
+  for (size_t run_begin = 0, run_end = 0; run_begin < frames.size(); run_begin = run_end) {
+    for (run_end = run_begin; run_end < frames.size(); run_end++) {
+      Frame *frame = frames[run_end];
+      if (run_end > run_begin && frame->page_num() != frames[run_end - 1]->page_num() + 1) {
+        break;
+      }
+
+      void *buf = &frame->page();
+      if (OB_SUCC(dblwr_manager_.read_page(this, frame->page_num(), frame->page()))) {
+        if (!discard_page) {
+          discard_page = make_unique<Page>();
+        }
+        buf = discard_page.get();
+      }
+      iovs[run_end] = iovec{buf, BP_PAGE_SIZE};
+    }
+
+    const int64_t offset = static_cast<int64_t>(frames[run_begin]->page_num()) * BP_PAGE_SIZE;
+    batch.add_readv(file_desc_, &iovs[run_begin], static_cast<int>(run_end - run_begin), offset);
+    run_begins.push_back(run_begin);
+  }
+  run_begins.push_back(frames.size());
+
+  RC rc = RC::SUCCESS;
+  if (!batch.empty()) {
+    (void)common::AsyncIOEngine::instance().execute(batch);
+    reads_num = static_cast<int>(batch.size());
+  }
+
+  for (size_t run = 0; run < batch.size(); run++) {
+    const int ret = batch.request(run).result;
+    if (ret != 0) {
+      LOG_WARN("failed to read ahead pages. file=%s, first page=%d, pages=%d, ret=%d, error=%s",
+               file_name_.c_str(), frames[run_begins[run]]->page_num(),
+               static_cast<int>(run_begins[run + 1] - run_begins[run]), ret, ret > 0 ? strerror(ret) : "eof");
+      rc = RC::IOERR_READ;
+      continue;
+    }
+
+    for (size_t i = run_begins[run]; i < run_begins[run + 1]; i++) {
+      if (frame_manager_.install_frame(frames[i], BPAccessHint::SCAN)) {
+        loaded_num++;
+      } else {
+        frame_manager_.release_free_frame(frames[i]);
+        discarded_num++;
+      }
+      frames[i] = nullptr;
+    }
+  }
+
+  for (Frame *frame : frames) {
+    if (frame != nullptr) {
+      frame_manager_.release_free_frame(frame);
+    }
+  }
+
+  LOG_DEBUG("read ahead done. file=%s, pages=%d, reads=%d, loaded=%d, discarded=%d, rc=%s",
+            file_name_.c_str(), static_cast<int>(pages.size()), reads_num, loaded_num, discarded_num, strrc(rc));
+  return rc;
+}
+
 int DiskBufferPool::file_desc() const { return file_desc_; }
 
 ////////////////////////////////////////////////////////////////////////////////
-BufferPoolManager::BufferPoolManager(int memory_size /* = 0 */)
+BufferPoolManager::BufferPoolManager(int memory_size /* = 0 */, BPReplacerType replacer_type /* = BPReplacerType::TWO_Q */)
 {
   if (memory_size <= 0) {
     memory_size = MEM_POOL_ITEM_NUM * DEFAULT_ITEM_NUM_PER_POOL * BP_PAGE_SIZE;
   }
   const int pool_num = max(memory_size / BP_PAGE_SIZE / DEFAULT_ITEM_NUM_PER_POOL, 1);
-  frame_manager_.init(pool_num);
+  frame_manager_.init(pool_num, replacer_type);
   LOG_INFO("buffer pool manager init with memory size %d, page num: %d, pool num: %d",
            memory_size, pool_num * DEFAULT_ITEM_NUM_PER_POOL, pool_num);
 }
 
 BufferPoolManager::~BufferPoolManager()
 {
+  stop_page_cleaner();
+  stop_read_ahead();
+
   unordered_map<string, DiskBufferPool *> tmp_bps;
   tmp_bps.swap(buffer_pools_);
 
@@ -815,8 +1597,11 @@ RC BufferPoolManager::create_file(const char *file_name)
   memset(&page, 0, BP_PAGE_SIZE);
 
   BPFileHeader *file_header    = (BPFileHeader *)page.data;
+  file_header->magic           = BPFileHeader::MAGIC;
+  file_header->version         = BPFileHeader::VERSION;
   file_header->allocated_pages = 1;
   file_header->page_count      = 1;
+  file_header->extent_count    = 1;
   file_header->buffer_pool_id  = next_buffer_pool_id_.fetch_add(1);
 
   char *bitmap = file_header->bitmap;
@@ -905,6 +1690,73 @@ RC BufferPoolManager::flush_page(Frame &frame)
   return bp->flush_page(frame);
 }
 
+RC BufferPoolManager::flush_frames(int32_t buffer_pool_id, vector<Frame *> &frames, int &flushed_num)
+{
+  flushed_num = 0;
+
+  scoped_lock lock_guard(lock_);
+  auto             iter = id_to_buffer_pools_.find(buffer_pool_id);
+  if (iter == id_to_buffer_pools_.end()) {
+    LOG_WARN("unknown buffer pool of id %d", buffer_pool_id);
+    return RC::INTERNAL;
+  }
+
+  DiskBufferPool *bp = iter->second;
+  return bp->flush_frames(frames, flushed_num);
+}
+
+RC BufferPoolManager::start_page_cleaner(const BPPageCleanerOptions &options)
+{
+  if (page_cleaner_) {
+    LOG_WARN("page cleaner has already been started");
+    return RC::INTERNAL;
+  }
+
+  page_cleaner_ = make_unique<BPPageCleaner>(*this, options);
+  return page_cleaner_->start();
+}
+
+RC BufferPoolManager::stop_page_cleaner()
+{
+  if (!page_cleaner_) {
+    return RC::SUCCESS;
+  }
+  return page_cleaner_->stop();
+}
+
+void BufferPoolManager::wakeup_page_cleaner()
+{
+  if (page_cleaner_ && page_cleaner_->below_low_water()) {
+    page_cleaner_->wakeup();
+  }
+}
+
+RC BufferPoolManager::start_read_ahead(const BPReadAheadOptions &options)
+{
+  if (read_aheader_) {
+    LOG_WARN("read ahead has already been started");
+    return RC::INTERNAL;
+  }
+
+  read_aheader_ = make_unique<BPReadAheader>(options);
+  return read_aheader_->start();
+}
+
+RC BufferPoolManager::stop_read_ahead()
+{
+  if (read_aheader_) {
+    return read_aheader_->stop();
+  }
+  return RC::SUCCESS;
+}
+
+void BufferPoolManager::cancel_read_ahead(DiskBufferPool *bp)
+{
+  if (read_aheader_) {
+    read_aheader_->cancel(bp);
+  }
+}
+
 RC BufferPoolManager::get_buffer_pool(int32_t id, DiskBufferPool *&bp)
 {
   bp = nullptr;
@@ -25,23 +25,33 @@ See the Mulan PSL v2 for more details. */
 #include <time.h>
 #include <optional>
 
+#include "common/lang/atomic.h"
 #include "common/lang/bitmap.h"
-#include "common/lang/lru_cache.h"
 #include "common/lang/mutex.h"
 #include "common/lang/memory.h"
 #include "common/lang/unordered_map.h"
+#include "common/lang/vector.h"
 #include "common/mm/mem_pool.h"
 #include "common/sys/rc.h"
 #include "common/types.h"
+#include "storage/buffer/bp_replacer.h"
 #include "storage/buffer/frame.h"
 #include "storage/buffer/page.h"
 #include "storage/buffer/buffer_pool_log.h"
 
+namespace common {
+class AsyncIOBatch;
+}  // namespace common
+
 class BufferPoolManager;
 class DiskBufferPool;
 class DoubleWriteBuffer;
 class LogHandler;
 class BufferPoolLogHandler;
+class BPPageCleaner;
+struct BPPageCleanerOptions;
+class BPReadAheader;
+struct BPReadAheadOptions;
 
 /**
  * @brief BufferPool 的实现
@@ -51,28 +61,102 @@ class BufferPoolLogHandler;
 #define BP_FILE_SUB_HDR_SIZE (sizeof(BPFileSubHeader))
 
 /**
- * @brief BufferPool的文件第一个页面，存放一些元数据信息，包括了后面每页的分配信息。
+ * @brief 区(extent)中页面分配位图的字节数
+ * @ingroup BufferPool
+ * @details 文件按照 BP_EXTENT_PAGES 个页面划分成多个区，每个区的分配情况记录在一个位图中。
+ * 第0个区的位图放在文件头页面中，其它区的位图放在区的第一个页面中(参考 BPExtentPage)。
+ */
+static constexpr int BP_EXTENT_BITMAP_SIZE = 1024;
+
+/**
+ * @brief 一个区包含的页面个数，包括区的位图页
+ * @ingroup BufferPool
+ */
+static constexpr int BP_EXTENT_PAGES = BP_EXTENT_BITMAP_SIZE * 8;
+
+/**
+ * @brief BufferPool的文件第一个页面，存放一些元数据信息，包括第0个区中每页的分配信息。
  * @ingroup BufferPool
  * @details
+ * 文件被划分成多个区，每个区有 BP_EXTENT_PAGES 个页面。第0个区的位图在当前页面中，
+ * 第 n 个区(n>0)的第一个页面 n * BP_EXTENT_PAGES 是这个区的位图页，参考 BPExtentPage。
+ * 区的位图页在分配区中的第一个页面时创建，因此只有最后一个区可能没有用满文件空间。
+ * full_extents 是区的摘要，每个区一位，区中页面都已经分配时为1，从 FULL_EXTENTS_OFFSET 开始一直到页面的末尾。
+ * 分配页面时先在摘要中找到一个没有满的区，再在这个区的位图中找空闲页面，不需要扫描所有页面的分配位图。
+ * magic 和 version 用来识别文件格式，打开文件时不是当前格式的文件会被拒绝，而不是按照错误的布局解析。
  * @code
- * TODO 1. 当前的做法，只能分配比较少的页面，你可以扩展一下，支持更多的页面或无限多的页面吗？
- *         可以参考Linux ext(n)和Windows NTFS等文件系统
- *      2. 当前使用bitmap存放页面分配情况，但是这种方法在页面非常多的时候，查找空闲页面的
- *         效率非常低，你有办法优化吗？
+ * | magic | version | buffer_pool_id | page_count | allocated_pages | extent_count | bitmap(区0) | full_extents |
  * @endcode
  */
 struct BPFileHeader
 {
-  int32_t buffer_pool_id;   //! buffer pool id
-  int32_t page_count;       //! 当前文件一共有多少个页面
-  int32_t allocated_pages;  //! 已经分配了多少个页面
-  char    bitmap[0];        //! 页面分配位图, 第0个页面(就是当前页面)，总是1
+  static constexpr uint32_t MAGIC   = 0x4F425046;  ///< "OBPF"
+  static constexpr int32_t  VERSION = 1;           ///< 文件格式变化时需要修改
+
+  uint32_t magic;                         //! 文件格式标识，总是 MAGIC
+  int32_t  version;                       //! 文件格式版本
+  int32_t  buffer_pool_id;                //! buffer pool id
+  int32_t  page_count;                    //! 当前文件一共有多少个页面，包括区的位图页
+  int32_t  allocated_pages;               //! 已经分配了多少个页面，包括当前页面和区的位图页
+  int32_t  extent_count;                  //! 已经创建了多少个区
+  char     bitmap[BP_EXTENT_BITMAP_SIZE];  //! 第0个区的页面分配位图, 第0个页面(就是当前页面)，总是1
 
   /**
-   * 能够分配的最大的页面个数，即bitmap的字节数 乘以8
+   * 区的摘要位图在页面中的偏移，紧跟在上面的字段后面
    */
-  static const int MAX_PAGE_NUM =
-      (BP_PAGE_DATA_SIZE - sizeof(buffer_pool_id) - sizeof(page_count) - sizeof(allocated_pages)) * 8;
+  static constexpr int FULL_EXTENTS_OFFSET = sizeof(magic) + sizeof(version) + sizeof(buffer_pool_id) +
+                                             sizeof(page_count) + sizeof(allocated_pages) + sizeof(extent_count) +
+                                             BP_EXTENT_BITMAP_SIZE;
+
+  /**
+   * 能够创建的最大的区的个数，即 full_extents 的字节数 乘以8
+   */
+  static const int MAX_EXTENT_NUM = (BP_PAGE_DATA_SIZE - FULL_EXTENTS_OFFSET) * 8;
+
+  /**
+   * 能够分配的最大的页面个数
+   */
+  static const int MAX_PAGE_NUM = MAX_EXTENT_NUM * BP_EXTENT_PAGES;
+
+  /**
+   * @brief 区的摘要位图，区中的页面都已经分配时为1
+   */
+  char       *full_extents() { return reinterpret_cast<char *>(this) + FULL_EXTENTS_OFFSET; }
+  const char *full_extents() const { return reinterpret_cast<const char *>(this) + FULL_EXTENTS_OFFSET; }
+
+  /**
+   * @brief 检查是不是当前格式的文件头，以及各个字段是否在合法的范围内
+   * @details 打开文件时调用。不检查的话，旧格式或者损坏的文件会被按照错误的布局解析，
+   * 比如错误的 extent_count 会让访问区的位图时越界
+   */
+  RC validate() const;
+
+  string to_string() const;
+};
+
+static_assert(BPFileHeader::FULL_EXTENTS_OFFSET == sizeof(BPFileHeader), "full_extents must follow the header");
+static_assert(BPFileHeader::FULL_EXTENTS_OFFSET < BP_PAGE_DATA_SIZE, "header page is too small");
+
+/**
+ * @brief 区的位图页，第0个区之外的每个区的第一个页面
+ * @ingroup BufferPool
+ * @details 位图页不是数据页，BufferPoolIterator 会跳过它，也不能释放它。
+ */
+struct BPExtentPage
+{
+  int32_t extent;                         //! 区的编号，用来检查页面是否已经初始化
+  char    bitmap[BP_EXTENT_BITMAP_SIZE];  //! 区中页面的分配位图，第0个页面(就是当前页面)，总是1
+};
+
+/**
+ * @brief 页帧的统计信息
+ * @ingroup BufferPool
+ */
+struct BPFrameStats
+{
+  int free_frames  = 0;  ///< 还没有使用的页帧
+  int clean_frames = 0;  ///< 已经使用并且不是脏页的页帧
+  int dirty_frames = 0;  ///< 脏页
 
   string to_string() const;
 };
@@ -84,23 +168,39 @@ struct BPFileHeader
  * 当内存中的页帧不够用时，需要从内存中淘汰一些页帧，以便为新的页帧腾出空间。
  * 这个管理器负责为所有的BufferPool提供页帧管理服务，也就是所有的BufferPool磁盘文件
  * 在访问时都使用这个管理器映射到内存。
+ * 页帧按照 FrameId::hash() 划分到多个分片(shard)中，每个分片有自己的锁和淘汰策略(BPReplacer)，
+ * 访问不同分片的页面时不会相互竞争。页帧的内存仍然从同一个分配器中申请。
  */
 class BPFrameManager
 {
 public:
-  BPFrameManager(const char *tag);
+  static constexpr int DEFAULT_SHARD_NUM = 16;
+
+  BPFrameManager(const char *tag, int shard_num = DEFAULT_SHARD_NUM);
 
-  RC init(int pool_num);
+  /**
+   * @param pool_num      页帧内存池的个数
+   * @param replacer_type 页面淘汰策略
+   */
+  RC init(int pool_num, BPReplacerType replacer_type = BPReplacerType::TWO_Q);
   RC cleanup();
 
   /**
    * @brief 获取指定的页面
+   * @details 只会加页面所在分片的锁
    *
    * @param buffer_pool_id buffer Pool标识
    * @param page_num  页面号
+   * @param hint      访问方式，淘汰策略会参考
    * @return Frame* 页帧指针
    */
-  Frame *get(int buffer_pool_id, PageNum page_num);
+  Frame *get(int buffer_pool_id, PageNum page_num, BPAccessHint hint = BPAccessHint::NORMAL);
+
+  /**
+   * @brief 页面是否在内存中
+   * @details 不会pin页帧，也不会影响淘汰策略
+   */
+  bool contains(int buffer_pool_id, PageNum page_num);
 
   /**
    * @brief 列出所有指定文件的页面
@@ -115,35 +215,93 @@ public:
    *
    * @param buffer_pool_id buffer Pool标识
    * @param page_num 页面编号
+   * @param hint     访问方式，淘汰策略会参考
    * @return Frame* 页帧指针
    */
-  Frame *alloc(int buffer_pool_id, PageNum page_num);
+  Frame *alloc(int buffer_pool_id, PageNum page_num, BPAccessHint hint = BPAccessHint::NORMAL);
+
+  /**
+   * @brief 申请一个空闲的页帧，但是不放到任何分片中
+   * @details 先把页面数据读到页帧中，再调用 install_frame 让其它线程看到，
+   * 这样其它线程不会拿到还没有加载完的页面。没有空闲页帧时返回空，不会淘汰页面
+   * @return Frame* pin count 为1的页帧
+   */
+  Frame *alloc_free_frame();
+
+  /**
+   * @brief 把 alloc_free_frame 申请的页帧放到页面所在的分片中，并且unpin
+   * @details 如果其它线程已经加载了这个页面，就什么都不做，调用者需要用 release_free_frame 释放页帧
+   * @return 是否放到了分片中
+   */
+  bool install_frame(Frame *frame, BPAccessHint hint);
+
+  /**
+   * @brief 释放 alloc_free_frame 申请的、没有放到分片中的页帧
+   */
+  void release_free_frame(Frame *frame);
 
   /**
    * 尽管frame中已经包含了buffer_pool_id和page_num，但是依然要求
    * 传入，因为frame可能忘记初始化或者没有初始化
+   * @note 如果还有其它线程pin着这个页帧(比如B+树乐观读的线程)，就把页帧从分片中移除并标记为已释放，
+   * 同时清除脏标记，这样它不会再被刷到磁盘上，也不会影响 min_recovery_lsn。最后一个 unpin 的线程回收页帧
    */
   RC free(int buffer_pool_id, PageNum page_num, Frame *frame);
 
+  /**
+   * @brief 释放页帧的一个引用
+   * @details 与 Frame::unpin 相同，另外还会回收最后一个引用也释放了的已释放页帧
+   */
+  void unpin(Frame *frame);
+
   /**
    * 如果不能从空闲链表中分配新的页面，就使用这个接口，
    * 尝试从pin count=0的页面中淘汰一些
+   * @details 从一个轮转的分片开始，依次按照各个分片的淘汰策略查找可以淘汰的页面，
+   * 同一时刻只会持有一个分片的锁。找到的页面先pin住，释放分片的锁之后再调用 purger，
+   * 最后重新加锁把没有被其它线程再次访问或修改的页帧释放掉
    * @param count 想要purge多少个页面
    * @param purger 需要在释放frame之前，对页面做些什么操作。当前是刷新脏数据到磁盘
    * @return 返回本次清理了多少个页面
    */
   int purge_frames(int count, function<RC(Frame *frame)> purger);
 
-  size_t frame_num() const { return frames_.count(); }
+  /**
+   * @brief 按照淘汰策略的顺序，找出接下来可能被淘汰的脏页，并pin住它们
+   * @details 后台刷脏页时使用，不会修改淘汰策略的状态。调用者需要负责unpin返回的页帧
+   * @param count 最多找多少个页面
+   */
+  list<Frame *> pin_dirty_victims(int count);
+
+  /**
+   * @brief 按照淘汰策略的顺序，释放最多count个不是脏页的页帧
+   * @details 与 purge_frames 不同，不会刷新脏页，所以不会访问磁盘
+   * @return 释放的页帧个数
+   */
+  int evict_clean_frames(int count);
+
+  size_t frame_num() const;
+
+  /**
+   * @brief 还没有使用的页帧个数
+   */
+  int free_frame_num() const { return allocator_.get_size() - used_frame_num_.load(); }
+
+  BPFrameStats frame_stats() const;
+
+  /**
+   * @brief 所有脏页中最小的 recovery lsn，参考 Frame::recovery_lsn
+   * @details 只会同时持有一个分片的锁，所以结果不是某一时刻的快照。调用者需要自己处理扫描期间新修改的页面
+   * @return 没有记录了LSN的脏页时返回0
+   */
+  LSN min_recovery_lsn() const;
 
   /**
    * 测试使用。返回已经从内存申请的个数
    */
   size_t total_frame_num() const { return allocator_.get_size(); }
 
-private:
-  Frame *get_internal(const FrameId &frame_id);
-  RC     free_internal(const FrameId &frame_id, Frame *frame);
+  int shard_num() const { return static_cast<int>(shards_.size()); }
 
 private:
   class BPFrameIdHasher
@@ -152,12 +310,31 @@ private:
     size_t operator()(const FrameId &frame_id) const { return frame_id.hash(); }
   };
 
-  using FrameLruCache  = common::LruCache<FrameId, Frame *, BPFrameIdHasher>;
+  using FrameMap       = unordered_map<FrameId, Frame *, BPFrameIdHasher>;
   using FrameAllocator = common::MemPoolSimple<Frame>;
 
-  mutex          lock_;
-  FrameLruCache  frames_;
-  FrameAllocator allocator_;
+  /**
+   * @brief 一个分片，管理一部分页帧
+   */
+  struct Shard
+  {
+    mutable mutex          lock;
+    FrameMap               frames;
+    unique_ptr<BPReplacer> replacer;
+  };
+
+  Shard &shard_of(const FrameId &frame_id) { return *shards_[frame_id.hash() % shards_.size()]; }
+
+  Frame *get_internal(Shard &shard, const FrameId &frame_id, BPAccessHint hint);
+  RC     free_internal(Shard &shard, const FrameId &frame_id, Frame *frame);
+  void   release_disposed_frame(Frame *frame);
+  int    purge_shard(Shard &shard, int count, function<RC(Frame *frame)> &purger);
+
+private:
+  vector<unique_ptr<Shard>> shards_;
+  atomic<size_t>            next_purge_shard_{0};  /// 下次从哪个分片开始淘汰，避免总是淘汰同一个分片
+  atomic<int>               used_frame_num_{0};    /// 已经从分配器中申请的页帧个数
+  FrameAllocator            allocator_;
 };
 
 /**
@@ -176,8 +353,18 @@ public:
   RC      reset();
 
 private:
-  common::Bitmap bitmap_;
-  PageNum        current_page_num_ = -1;
+  /**
+   * @brief 从 start 开始查找下一个已经分配的数据页，需要时复制下一个区的位图
+   * @return 没有找到时返回 -1
+   */
+  PageNum find_next(PageNum start);
+
+private:
+  DiskBufferPool *buffer_pool_      = nullptr;
+  PageNum         page_count_       = 0;   /// 初始化时文件的页面个数，不会遍历之后扩展出来的页面
+  int             extent_           = -1;  /// extent_bitmap_ 是哪个区的位图
+  char            extent_bitmap_[BP_EXTENT_BITMAP_SIZE];  /// 当前区位图的副本，不需要一直pin住位图页
+  PageNum         current_page_num_ = -1;
 };
 
 /**
@@ -205,8 +392,9 @@ public:
 
   /**
    * 根据文件ID和页号获取指定页面到缓冲区，返回页面句柄指针。
+   * 顺序扫描时 hint 使用 BPAccessHint::SCAN，避免扫描的页面把经常访问的页面挤出内存。
    */
-  RC get_this_page(PageNum page_num, Frame **frame);
+  RC get_this_page(PageNum page_num, Frame **frame, BPAccessHint hint = BPAccessHint::NORMAL);
 
   /**
    * @brief 在指定文件中分配一个新的页面，并将其放入缓冲区，返回页面句柄指针。
@@ -256,6 +444,16 @@ public:
    */
   RC flush_all_pages();
 
+  /**
+   * @brief 后台刷脏页使用，批量刷新当前文件的多个页面
+   * @details 页面按照页号的顺序写入。先等待这批页面中最大的LSN刷盘(WAL)，而不是每个页面等待一次，
+   * 等待日志时不持有文件的锁，只有写页面时才持有。
+   * 正在被其它线程修改(拿不到读锁)的页面会跳过，等下一轮再刷新。
+   * @param frames 已经被pin住的页帧，调用者负责unpin
+   * @param flushed_num 实际刷新的页面个数
+   */
+  RC flush_frames(vector<Frame *> &frames, int &flushed_num);
+
   /**
    * 回放日志时处理page0中已被认定为不存在的page
    */
@@ -266,16 +464,44 @@ public:
    */
   RC write_page(PageNum page_num, Page &page);
 
+  /**
+   * @brief 把写页面的请求加到 batch 中，由调用者提交
+   * @details 与 write_page 相同，但是可以与其它页面的写请求以及 fsync 一起提交，
+   * 例如 double write buffer 批量写回页面。batch 完成之前 page 要保持有效
+   */
+  void add_write_page(common::AsyncIOBatch &batch, PageNum page_num, const Page &page);
+
   RC redo_allocate_page(LSN lsn, PageNum page_num);
   RC redo_deallocate_page(LSN lsn, PageNum page_num);
 
+  /**
+   * @brief 把指定的页面读到空闲页帧中，由 BPReadAheader 调用
+   * @details 已经在内存中的页面、正在被其它线程加载的页面会跳过。页号连续的页面是一个 readv 请求，直接读到页帧中，所有请求一起提交给 AsyncIOEngine，
+   * 读完之后再放到 BPFrameManager 中。没有空闲页帧时会释放一些干净的页帧，不会刷脏页。
+   * 页面如果还在 double write buffer 中，就使用 double write buffer 中的数据，与 load_page 相同。
+   * @param pages 页号递增
+   * @param reads_num 读文件的次数
+   * @param loaded_num 加载到内存的页面个数
+   * @param discarded_num 读出来之后发现已经被其它线程加载而丢弃的页面个数
+   */
+  RC read_ahead(const vector<PageNum> &pages, int &reads_num, int &loaded_num, int &discarded_num);
+
 public:
   int32_t id() const { return buffer_pool_id_; }
 
   const char *filename() const { return file_name_.c_str(); }
 
+  const BPFileHeader *file_header() const { return file_header_; }
+
 protected:
-  RC allocate_frame(PageNum page_num, Frame **buf);
+  RC allocate_frame(PageNum page_num, Frame **buf, BPAccessHint hint = BPAccessHint::NORMAL);
+
+  /**
+   * @brief 申请一个不在任何分片中的页帧，其它线程看不到它，加载完数据后再调用 install_frame
+   * @details 与 allocate_frame 一样，没有空闲页帧时会淘汰页面
+   */
+  RC allocate_free_frame(Frame **buf);
+  RC allocate_frame(const function<Frame *()> &allocator, Frame **buf);
 
   /**
    * 刷新指定页面到磁盘(flush)，并且释放关联的Frame
@@ -283,11 +509,54 @@ protected:
   RC purge_frame(PageNum page_num, Frame *used_frame);
   RC check_page_num(PageNum page_num);
 
+  /**
+   * @brief 获取页面，与 get_this_page 相同，但是不会预读
+   * @param missed 页面是否是从磁盘加载的
+   */
+  RC fetch_page(PageNum page_num, Frame **frame, BPAccessHint hint, bool &missed);
+
+  /**
+   * @brief 获取区的位图，调用者需要持有 lock_
+   * @param frame 位图所在的页帧，已经pin住，用完后需要unpin
+   */
+  RC get_extent_bitmap(int extent, Frame *&frame, char *&bitmap);
+
+  /**
+   * @brief 创建一个新的区，即初始化区的位图页并扩展文件，调用者需要持有 lock_
+   */
+  RC create_extent(int extent, LSN lsn, Frame *&frame, char *&bitmap);
+
+  /**
+   * @brief 重做日志时获取区的位图
+   * @details 区的位图页可能还没有写到磁盘上，这时会重新初始化它，之后重做的日志会恢复它的内容
+   */
+  RC redo_get_extent_bitmap(int extent, Frame *&frame, char *&bitmap);
+
+  /**
+   * @brief 根据区的位图更新文件头中区的摘要
+   */
+  void update_extent_summary(int extent, char *bitmap);
+
+  /**
+   * @brief 复制区的位图，由 BufferPoolIterator 调用
+   */
+  RC copy_extent_bitmap(int extent, char *bitmap);
+
+  static bool is_extent_page(PageNum page_num) { return page_num > 0 && page_num % BP_EXTENT_PAGES == 0; }
+
   /**
    * 加载指定页面的数据到内存中
    */
   RC load_page(PageNum page_num, Frame *frame);
 
+  /**
+   * @brief 访问页面后检查是否需要预读
+   * @details 访问到了上次预读的页面中间的那个页面，或者在上次预读的范围之外，
+   * 连续两次从磁盘加载了相邻的页面、使用 BPAccessHint::SCAN 从磁盘加载页面，都会预读后面的页面
+   * @param missed 页面是否是从磁盘加载的
+   */
+  void check_read_ahead(PageNum page_num, bool missed, BPAccessHint hint);
+
   /**
    * 如果页面是脏的，就将数据刷新到磁盘
    */
@@ -301,15 +570,25 @@ private:
 
   int file_desc_ = -1;  /// 文件描述符
   /// 由于在最开始打开文件时，没有正确的buffer pool id不能加载header frame，所以单独从文件中读取此标识
-  int32_t       buffer_pool_id_ = -1;
-  Frame        *hdr_frame_      = nullptr;  /// 文件头页面
-  BPFileHeader *file_header_    = nullptr;  /// 文件头
-  set<PageNum>  disposed_pages_;            /// 已经释放的页面
+  int32_t       buffer_pool_id_    = -1;
+  Frame        *hdr_frame_         = nullptr;  /// 文件头页面
+  BPFileHeader *file_header_       = nullptr;  /// 文件头
+  set<PageNum>  disposed_pages_;               /// 已经释放的页面
+  int           first_free_extent_ = 0;        /// 编号更小的区都已经分配满了，由 lock_ 保护
 
   string file_name_;  /// 文件名
 
+  static constexpr int PAGE_LOCK_NUM = 64;
+
   common::Mutex lock_;
-  common::Mutex wr_lock_;
+  /// 加载页面时使用的锁，按照页面号分成多个，加载不同的页面时不会相互阻塞
+  common::Mutex page_locks_[PAGE_LOCK_NUM];
+
+  /// 预读状态。只用来判断是否需要预读，多个线程同时修改时判断不准确也没有关系
+  atomic<PageNum> last_miss_page_{-1};      /// 最近一次从磁盘加载的页面
+  atomic<PageNum> read_ahead_first_{-1};    /// 最近一次预读的第一个页面
+  atomic<PageNum> read_ahead_last_{-1};     /// 最近一次预读的最后一个页面
+  atomic<PageNum> read_ahead_trigger_{-1};  /// 访问到这个页面时预读下一批页面
 
 private:
   friend class BufferPoolIterator;
@@ -322,7 +601,11 @@ private:
 class BufferPoolManager final
 {
 public:
-  BufferPoolManager(int memory_size = 0);
+  /**
+   * @param memory_size   页帧使用的内存大小，0 表示使用默认值
+   * @param replacer_type 页面淘汰策略
+   */
+  BufferPoolManager(int memory_size = 0, BPReplacerType replacer_type = BPReplacerType::TWO_Q);
   ~BufferPoolManager();
 
   RC init(unique_ptr<DoubleWriteBuffer> dblwr_buffer);
@@ -333,6 +616,39 @@ public:
 
   RC flush_page(Frame &frame);
 
+  /**
+   * @brief 刷新同一个BufferPool的多个页帧，参考 DiskBufferPool::flush_frames
+   */
+  RC flush_frames(int32_t buffer_pool_id, vector<Frame *> &frames, int &flushed_num);
+
+  /**
+   * @brief 启动后台刷脏页，参考 BPPageCleaner
+   */
+  RC start_page_cleaner(const BPPageCleanerOptions &options);
+  RC stop_page_cleaner();
+
+  /**
+   * @brief 空闲页帧低于低水位时，唤醒后台刷脏页的线程
+   */
+  void wakeup_page_cleaner();
+
+  BPPageCleaner *page_cleaner() { return page_cleaner_.get(); }
+
+  /**
+   * @brief 启动预读，参考 BPReadAheader。没有启动时不会预读
+   */
+  RC start_read_ahead(const BPReadAheadOptions &options);
+  RC stop_read_ahead();
+
+  /**
+   * @brief 丢弃指定文件还没有执行的预读请求，并等待正在执行的请求结束。关闭文件前调用
+   */
+  void cancel_read_ahead(DiskBufferPool *bp);
+
+  BPReadAheader *read_aheader() { return read_aheader_.get(); }
+  BPFrameStats   frame_stats() const { return frame_manager_.frame_stats(); }
+  LSN            min_recovery_lsn() const { return frame_manager_.min_recovery_lsn(); }
+
   BPFrameManager    &get_frame_manager() { return frame_manager_; }
   DoubleWriteBuffer *get_dblwr_buffer() { return dblwr_buffer_.get(); }
 
@@ -348,6 +664,8 @@ private:
   BPFrameManager frame_manager_{"BufPool"};
 
   unique_ptr<DoubleWriteBuffer> dblwr_buffer_;
+  unique_ptr<BPPageCleaner>     page_cleaner_;
+  unique_ptr<BPReadAheader>     read_aheader_;
 
   common::Mutex                            lock_;
   unordered_map<string, DiskBufferPool *>  buffer_pools_;
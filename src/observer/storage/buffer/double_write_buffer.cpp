@@ -15,10 +15,13 @@ See the Mulan PSL v2 for more details. */
 
 #include "storage/buffer/double_write_buffer.h"
 #include "storage/buffer/disk_buffer_pool.h"
+#include "common/io/async_io.h"
 #include "common/io/io.h"
 #include "common/log/log.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/chrono.h"
 #include "common/math/crc.h"
-#include <algorithm>
+#include "common/thread/thread_util.h"
 
 using namespace common;
 
@@ -26,34 +29,58 @@ struct DoubleWritePage
 {
 public:
   DoubleWritePage() = default;
-  DoubleWritePage(int32_t buffer_pool_id, PageNum page_num, int32_t page_index, Page &page);
 
 public:
   DoubleWritePageKey key;
   int32_t            page_index = -1; /// 页面在double write buffer文件中的页索引
   bool               valid = true; /// 表示页面是否有效，在页面被删除时，需要同时标记磁盘上的值。
+  uint64_t           seq   = 0;    /// 页面加入double write buffer的序号，重启时同一个页面以序号最大的为准
   Page               page;
 
   static const int32_t SIZE;
 };
 
-DoubleWritePage::DoubleWritePage(int32_t buffer_pool_id, PageNum page_num, int32_t page_index, Page &_page)
-  : key{buffer_pool_id, page_num}, page_index(page_index), page(_page)
-{}
-
 const int32_t DoubleWritePage::SIZE = sizeof(DoubleWritePage);
 
 const int32_t DoubleWriteBufferHeader::SIZE = sizeof(DoubleWriteBufferHeader);
 
-DiskDoubleWriteBuffer::DiskDoubleWriteBuffer(BufferPoolManager &bp_manager, int max_pages /*=16*/) 
-  : max_pages_(max_pages), bp_manager_(bp_manager)
+struct DiskDoubleWriteBuffer::Slot
 {
+  DoubleWritePage page;                  /// 与文件中槽位的内容一致
+  DiskBufferPool *buffer_pool = nullptr;  /// 页面所属的buffer pool，写回页面时使用
+};
+
+DiskDoubleWriteBuffer::DiskDoubleWriteBuffer(BufferPoolManager &bp_manager, int max_pages /*=DEFAULT_MAX_PAGES*/)
+  : max_pages_(max(max_pages, 1)), bp_manager_(bp_manager), slots_(make_unique<Slot[]>(max_pages_))
+{
+  for (int i = 0; i < max_pages_; i++) {
+    slots_[i].page.page_index = i;
+    slots_[i].page.valid      = false;
+  }
 }
 
 DiskDoubleWriteBuffer::~DiskDoubleWriteBuffer()
 {
+  if (thread_) {
+    {
+      lock_guard<mutex> guard(lock_);
+      running_ = false;
+      writer_cv_.notify_all();
+    }
+    thread_->join();
+    thread_.reset();
+  }
+
   flush_page();
-  close(file_desc_);
+
+  for (auto &[key, dblwr_page] : recovered_pages_) {
+    delete dblwr_page;
+  }
+  recovered_pages_.clear();
+
+  if (file_desc_ >= 0) {
+    close(file_desc_);
+  }
 }
 
 RC DiskDoubleWriteBuffer::open_file(const char *filename)
@@ -70,166 +97,264 @@ RC DiskDoubleWriteBuffer::open_file(const char *filename)
   }
 
   file_desc_ = fd;
-  return load_pages();
-}
-
-RC DiskDoubleWriteBuffer::flush_page()
-{
-  sync();
+  RC rc = load_pages();
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
 
-  for (const auto &pair : dblwr_pages_) {
-    RC rc = write_page(pair.second);
-    if (rc != RC::SUCCESS) {
+  // 有需要恢复的页面时，等 recover 写回这些页面之后再清空文件
+  if (recovered_pages_.empty()) {
+    rc = reset_file();
+    if (OB_FAIL(rc)) {
       return rc;
     }
-    pair.second->valid = false;
-    write_page_internal(pair.second);
-    delete pair.second;
   }
 
-  dblwr_pages_.clear();
-  header_.page_cnt = 0;
-
+  running_ = true;
+  thread_  = make_unique<thread>(&DiskDoubleWriteBuffer::thread_func, this);
   return RC::SUCCESS;
 }
 
+RC DiskDoubleWriteBuffer::flush_page()
+{
+  return write_back();
+}
+
 RC DiskDoubleWriteBuffer::add_page(DiskBufferPool *bp, PageNum page_num, Page &page)
 {
-  scoped_lock lock_guard(lock_);
-  DoubleWritePageKey key{bp->id(), page_num};
-  auto iter = dblwr_pages_.find(key);
-  if (iter != dblwr_pages_.end()) {
-    iter->second->page = page;
-    LOG_TRACE("[cache hit]add page into double write buffer. buffer_pool_id:%d,page_num:%d,lsn=%d, dwb size=%d",
-              bp->id(), page_num, page.lsn, static_cast<int>(dblwr_pages_.size()));
-    return write_page_internal(iter->second);
+  unique_lock<mutex> guard(lock_);
+  while (head_ - tail_ >= static_cast<uint64_t>(max_pages_)) {
+    stats_.full_waits++;
+    if (!running_) {
+      // 后台线程没有运行，只能自己写回
+      guard.unlock();
+      RC rc = write_back();
+      guard.lock();
+      if (OB_FAIL(rc)) {
+        return rc;
+      }
+    } else {
+      writer_cv_.notify_one();
+      space_cv_.wait(guard);
+    }
   }
 
-  int64_t          page_cnt   = dblwr_pages_.size();
-  DoubleWritePage *dblwr_page = new DoubleWritePage(bp->id(), page_num, page_cnt, page);
-  dblwr_pages_.insert(pair<DoubleWritePageKey, DoubleWritePage *>(key, dblwr_page));
-  LOG_TRACE("insert page into double write buffer. buffer_pool_id:%d,page_num:%d,lsn=%d, dwb size:%d",
-            bp->id(), page_num, page.lsn, static_cast<int>(dblwr_pages_.size()));
-
-  RC rc = write_page_internal(dblwr_page);
+  const uint64_t     seq  = head_++;
+  Slot              &slot = slots_[seq % max_pages_];
+  DoubleWritePageKey key{bp->id(), page_num};
+  slot.page.key    = key;
+  slot.page.valid  = true;
+  slot.page.seq    = seq;
+  slot.page.page   = page;
+  slot.buffer_pool = bp;
+  pending_pages_[key] = seq;
+  stats_.added_pages++;
+  LOG_TRACE("add page into double write buffer. buffer_pool_id:%d,page_num:%d,lsn=%d, seq=%lu, pending pages:%d",
+            bp->id(), page_num, page.lsn, seq, static_cast<int>(pending_pages_.size()));
+
+  RC rc = write_slot(slot);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to write page into double write buffer. rc=%s buffer_pool_id:%d,page_num:%d,lsn=%d.",
         strrc(rc), bp->id(), page_num, page.lsn);
     return rc;
   }
 
-  if (page_cnt + 1 > header_.page_cnt) {
-    header_.page_cnt = page_cnt + 1;
-    if (lseek(file_desc_, 0, SEEK_SET) == -1) {
-      LOG_ERROR("Failed to add page header due to failed to seek %s.", strerror(errno));
-      return RC::IOERR_SEEK;
-    }
+  if (head_ - tail_ >= batch_pages()) {
+    writer_cv_.notify_one();
+  }
+  return RC::SUCCESS;
+}
 
-    if (writen(file_desc_, &header_, sizeof(header_)) != 0) {
-      LOG_ERROR("Failed to add page header due to %s.", strerror(errno));
-      return RC::IOERR_WRITE;
-    }
+/**
+ * @brief 执行写回页面的一批请求，有请求失败时返回第一个失败的请求对应的错误码
+ */
+static RC execute_write_back(AsyncIOBatch &batch)
+{
+  if (AsyncIOEngine::instance().execute(batch) == 0) {
+    return RC::SUCCESS;
   }
 
-  if (static_cast<int>(dblwr_pages_.size()) >= max_pages_) {
-    RC rc = flush_page();
-    if (rc != RC::SUCCESS) {
-      LOG_ERROR("Failed to flush pages in double write buffer");
-      return rc;
+  for (size_t i = 0; i < batch.size(); i++) {
+    const AsyncIOBatch::Request &request = batch.request(i);
+    if (request.result == 0) {
+      continue;
     }
+
+    if (request.is_sync()) {
+      LOG_ERROR("Failed to sync file. fd=%d, error=%s", request.fd, strerror(request.result));
+      return RC::IOERR_SYNC;
+    }
+    LOG_ERROR("Failed to write page. fd=%d, offset=%ld, error=%s", request.fd, request.offset, strerror(request.result));
+    return RC::IOERR_WRITE;
   }
+  return RC::IOERR_WRITE;
+}
 
+RC DiskDoubleWriteBuffer::write_slot(const Slot &slot)
+{
+  const int64_t offset = int64_t(slot.page.page_index) * DoubleWritePage::SIZE + DoubleWriteBufferHeader::SIZE;
+  int ret = AsyncIOEngine::instance().write(file_desc_, &slot.page, DoubleWritePage::SIZE, offset);
+  if (ret != 0) {
+    LOG_ERROR("Failed to add page %ld of %d due to %s.", offset, file_desc_, strerror(ret));
+    return RC::IOERR_WRITE;
+  }
   return RC::SUCCESS;
 }
 
-RC DiskDoubleWriteBuffer::write_page_internal(DoubleWritePage *page)
+void DiskDoubleWriteBuffer::thread_func()
 {
-  int32_t page_index = page->page_index;
-  int64_t offset = page_index * DoubleWritePage::SIZE + DoubleWriteBufferHeader::SIZE;
-  if (lseek(file_desc_, offset, SEEK_SET) == -1) {
-    LOG_ERROR("Failed to add page %lld of %d due to failed to seek %s.", offset, file_desc_, strerror(errno));
-    return RC::IOERR_SEEK;
-  }
+  thread_set_name("DblWrBuffer");
+  LOG_INFO("double write buffer thread started");
+
+  unique_lock<mutex> guard(lock_);
+  while (running_) {
+    // 页面足够多时马上写回，否则最多等待一段时间，把这段时间内加入的页面作为一批
+    writer_cv_.wait_for(guard, chrono::milliseconds(WRITE_BACK_INTERVAL_MS), [this]() {
+      return !running_ || head_ - tail_ >= batch_pages();
+    });
+    if (head_ == tail_) {
+      continue;
+    }
 
-  if (writen(file_desc_, page, DoubleWritePage::SIZE) != 0) {
-    LOG_ERROR("Failed to add page %lld of %d due to %s.", offset, file_desc_, strerror(errno));
-    return RC::IOERR_WRITE;
+    guard.unlock();
+    RC rc = write_back();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to write back pages in double write buffer. rc=%s", strrc(rc));
+    }
+    guard.lock();
   }
 
-  return RC::SUCCESS;
+  LOG_INFO("double write buffer thread stopped");
 }
 
-RC DiskDoubleWriteBuffer::write_page(DoubleWritePage *dblwr_page)
+RC DiskDoubleWriteBuffer::write_back()
 {
-  DiskBufferPool *disk_buffer = nullptr;
-  // skip invalid page
-  if (!dblwr_page->valid) {
-    LOG_TRACE("double write buffer write page invalid. buffer_pool_id:%d,page_num:%d,lsn=%d",
-              dblwr_page->key.buffer_pool_id, dblwr_page->key.page_num, dblwr_page->page.lsn);
-    return RC::SUCCESS;
+  lock_guard<mutex> write_back_guard(write_back_lock_);
+
+  vector<Slot *> slots;
+  uint64_t       end = 0;
+  {
+    lock_guard<mutex> guard(lock_);
+    end = head_;
+    for (uint64_t seq = tail_; seq < end; seq++) {
+      Slot &slot = slots_[seq % max_pages_];
+      // 同一个页面后来又加入过，只需要写回最新的
+      auto iter = pending_pages_.find(slot.page.key);
+      if (iter != pending_pages_.end() && iter->second == seq) {
+        slots.push_back(&slot);
+      }
+    }
+
+    if (tail_ == end) {
+      return RC::SUCCESS;
+    }
   }
-  RC rc = bp_manager_.get_buffer_pool(dblwr_page->key.buffer_pool_id, disk_buffer);
-  ASSERT(OB_SUCC(rc) && disk_buffer != nullptr, "failed to get disk buffer pool of %d", dblwr_page->key.buffer_pool_id);
 
-  LOG_TRACE("double write buffer write page. buffer_pool_id:%d,page_num:%d,lsn=%d",
-            dblwr_page->key.buffer_pool_id, dblwr_page->key.page_num, dblwr_page->page.lsn);
+  // 按照文件和页号的顺序写
+  sort(slots.begin(), slots.end(), [](const Slot *a, const Slot *b) {
+    if (a->page.key.buffer_pool_id != b->page.key.buffer_pool_id) {
+      return a->page.key.buffer_pool_id < b->page.key.buffer_pool_id;
+    }
+    return a->page.key.page_num < b->page.key.page_num;
+  });
+
+  // 一起提交给异步IO引擎：先持久化共享文件，才能写原始位置；所有页面并行地写，然后并行地持久化每个文件。
+  // 原始位置也持久化之后，槽位才能复用
+  AsyncIOBatch batch;
+  batch.add_fsync(file_desc_);
+  vector<DiskBufferPool *> buffer_pools;
+  for (Slot *slot : slots) {
+    slot->buffer_pool->add_write_page(batch, slot->page.key.page_num, slot->page.page);
+    if (buffer_pools.empty() || buffer_pools.back() != slot->buffer_pool) {
+      buffer_pools.push_back(slot->buffer_pool);
+    }
+  }
+  for (DiskBufferPool *buffer_pool : buffer_pools) {
+    batch.add_fsync(buffer_pool->file_desc());
+  }
+
+  RC rc = execute_write_back(batch);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
 
-  return disk_buffer->write_page(dblwr_page->key.page_num, dblwr_page->page);
+  {
+    lock_guard<mutex> guard(lock_);
+    for (Slot *slot : slots) {
+      auto iter = pending_pages_.find(slot->page.key);
+      if (iter != pending_pages_.end() && iter->second == slot->page.seq) {
+        pending_pages_.erase(iter);
+      }
+    }
+    tail_ = end;
+    stats_.batches++;
+    stats_.written_pages += slots.size();
+  }
+  space_cv_.notify_all();
+
+  LOG_TRACE("double write buffer write back %d pages", static_cast<int>(slots.size()));
+  return RC::SUCCESS;
 }
 
 RC DiskDoubleWriteBuffer::read_page(DiskBufferPool *bp, PageNum page_num, Page &page)
 {
-  scoped_lock lock_guard(lock_);
+  lock_guard<mutex>  guard(lock_);
   DoubleWritePageKey key{bp->id(), page_num};
-  auto iter = dblwr_pages_.find(key);
-  if (iter != dblwr_pages_.end()) {
-    page = iter->second->page;
+  auto               iter = pending_pages_.find(key);
+  if (iter != pending_pages_.end()) {
+    page = slots_[iter->second % max_pages_].page.page;
     LOG_TRACE("double write buffer read page success. bp id=%d, page_num:%d, lsn:%d", bp->id(), page_num, page.lsn);
     return RC::SUCCESS;
   }
 
+  auto recovered_iter = recovered_pages_.find(key);
+  if (recovered_iter != recovered_pages_.end()) {
+    if (home_page_is_newer(bp, page_num, recovered_iter->second->page)) {
+      delete recovered_iter->second;
+      recovered_pages_.erase(recovered_iter);
+      return RC::BUFFERPOOL_INVALID_PAGE_NUM;
+    }
+    page = recovered_iter->second->page;
+    LOG_TRACE("double write buffer read recovered page. bp id=%d, page_num:%d, lsn:%d", bp->id(), page_num, page.lsn);
+    return RC::SUCCESS;
+  }
+
   return RC::BUFFERPOOL_INVALID_PAGE_NUM;
 }
 
 RC DiskDoubleWriteBuffer::clear_pages(DiskBufferPool *buffer_pool)
 {
-  vector<DoubleWritePage *> spec_pages;
-  
-  auto remove_pred = [&spec_pages, buffer_pool](const pair<DoubleWritePageKey, DoubleWritePage *> &pair) {
-    DoubleWritePage *dbl_page = pair.second;
-    if (buffer_pool->id() == dbl_page->key.buffer_pool_id) {
-      spec_pages.push_back(dbl_page);
-      return true;
-    }
-    return false;
-  };
-
-  lock_.lock();
-  erase_if(dblwr_pages_, remove_pred);
-  lock_.unlock();
-
-  LOG_INFO("clear pages in double write buffer. file name=%s, page count=%d",
-           buffer_pool->filename(), spec_pages.size());
-
-  // 页面从小到大排序，防止出现小页面还没有写入，而页面编号更大的seek失败的情况
-  sort(spec_pages.begin(), spec_pages.end(), [](DoubleWritePage *a, DoubleWritePage *b) {
-    return a->key.page_num < b->key.page_num;
-  });
+  RC rc = write_back();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("Failed to write back pages of %s. rc=%s", buffer_pool->filename(), strrc(rc));
+    return rc;
+  }
 
-  RC rc = RC::SUCCESS;
-  for (DoubleWritePage *dbl_page : spec_pages) {
-    rc = buffer_pool->write_page(dbl_page->key.page_num, dbl_page->page);
-    if (OB_FAIL(rc)) {
-      LOG_WARN("Failed to write page %s:%d to disk buffer pool. rc=%s",
-               buffer_pool->filename(), dbl_page->key.page_num, strrc(rc));
-      break;
+  int cleared_num = 0;
+  {
+    lock_guard<mutex> guard(lock_);
+    for (int i = 0; i < max_pages_; i++) {
+      Slot &slot = slots_[i];
+      if (!slot.page.valid || slot.page.key.buffer_pool_id != buffer_pool->id()) {
+        continue;
+      }
+
+      slot.page.valid  = false;
+      slot.buffer_pool = nullptr;
+      rc               = write_slot(slot);
+      if (OB_FAIL(rc)) {
+        return rc;
+      }
+      cleared_num++;
     }
-    dbl_page->valid = false;
-    write_page_internal(dbl_page);
   }
 
-  for_each(spec_pages.begin(), spec_pages.end(), [](DoubleWritePage *dbl_page) { delete dbl_page; });
+  if (cleared_num > 0 && fdatasync(file_desc_) != 0) {
+    LOG_ERROR("Failed to sync double write buffer file. error=%s", strerror(errno));
+    return RC::IOERR_SYNC;
+  }
 
+  LOG_INFO("clear pages in double write buffer. file name=%s, page count=%d", buffer_pool->filename(), cleared_num);
   return RC::SUCCESS;
 }
 
@@ -240,7 +365,7 @@ RC DiskDoubleWriteBuffer::load_pages()
     return RC::BUFFERPOOL_OPEN;
   }
 
-  if (!dblwr_pages_.empty()) {
+  if (!recovered_pages_.empty()) {
     LOG_ERROR("Failed to load pages, due to double write buffer is not empty. opened?");
     return RC::BUFFERPOOL_OPEN;
   }
@@ -250,26 +375,25 @@ RC DiskDoubleWriteBuffer::load_pages()
     return RC::IOERR_SEEK;
   }
 
-  int ret = readn(file_desc_, &header_, sizeof(header_));
+  DoubleWriteBufferHeader header;
+  int ret = readn(file_desc_, &header, sizeof(header));
   if (ret != 0 && ret != -1) {
     LOG_ERROR("Failed to load page header, file_desc:%d, due to failed to read data:%s, ret=%d",
                 file_desc_, strerror(errno), ret);
     return RC::IOERR_READ;
   }
 
-  for (int page_num = 0; page_num < header_.page_cnt; page_num++) {
-    int64_t offset = ((int64_t)page_num) * DoubleWritePage::SIZE + DoubleWriteBufferHeader::SIZE;
-
-    if (lseek(file_desc_, offset, SEEK_SET) == -1) {
-      LOG_ERROR("Failed to load page %d, offset=%ld, due to failed to lseek:%s.", page_num, offset, strerror(errno));
-      return RC::IOERR_SEEK;
-    }
-
+  uint64_t max_seq = 0;
+  for (int page_num = 0; page_num < header.page_cnt; page_num++) {
     auto dblwr_page = make_unique<DoubleWritePage>();
     Page &page     = dblwr_page->page;
     page.check_sum = (CheckSum)-1;
 
     ret = readn(file_desc_, dblwr_page.get(), DoubleWritePage::SIZE);
+    if (ret == -1) {
+      LOG_WARN("double write buffer file is shorter than expected. page count=%d, read=%d", header.page_cnt, page_num);
+      break;
+    }
     if (ret != 0) {
       LOG_ERROR("Failed to load page, file_desc:%d, page num:%d, due to failed to read data:%s, ret=%d, page count=%d",
                 file_desc_, page_num, strerror(errno), ret, page_num);
@@ -277,21 +401,152 @@ RC DiskDoubleWriteBuffer::load_pages()
     }
 
     const CheckSum check_sum = crc32(page.data, BP_PAGE_DATA_SIZE);
-    if (check_sum == page.check_sum) {
-      DoubleWritePageKey key = dblwr_page->key;
-      dblwr_pages_.insert(pair<DoubleWritePageKey, DoubleWritePage *>(key, dblwr_page.release()));
-    } else {
-      LOG_TRACE("got a page with an invalid checksum. on disk:%d, in memory:%d", page.check_sum, check_sum);
+    if (!dblwr_page->valid || check_sum != page.check_sum) {
+      LOG_TRACE("skip an invalid page. valid=%d, checksum on disk:%d, in memory:%d",
+                dblwr_page->valid, page.check_sum, check_sum);
+      continue;
+    }
+
+    max_seq = max(max_seq, dblwr_page->seq);
+
+    DoubleWritePageKey key  = dblwr_page->key;
+    auto               iter = recovered_pages_.find(key);
+    if (iter == recovered_pages_.end()) {
+      recovered_pages_.emplace(key, dblwr_page.release());
+    } else if (iter->second->seq < dblwr_page->seq) {
+      delete iter->second;
+      iter->second = dblwr_page.release();
     }
   }
 
-  LOG_INFO("double write buffer load pages done. page num=%d", dblwr_pages_.size());
+  // 新的页面序号接着文件中最大的序号，保证重启后同一个页面的新版本序号更大
+  if (!recovered_pages_.empty()) {
+    head_ = tail_ = max_seq + 1;
+  }
+
+  LOG_INFO("double write buffer load pages done. page num=%d", recovered_pages_.size());
+  return RC::SUCCESS;
+}
+
+bool DiskDoubleWriteBuffer::home_page_is_newer(DiskBufferPool *bp, PageNum page_num, const Page &copy) const
+{
+  Page          home;
+  const int64_t offset = static_cast<int64_t>(page_num) * BP_PAGE_SIZE;
+  int           ret    = AsyncIOEngine::instance().read(bp->file_desc(), &home, BP_PAGE_SIZE, offset);
+  if (ret != 0) {
+    // 页面还没有写回过，文件中没有这个页面
+    return false;
+  }
+  if (crc32(home.data, BP_PAGE_DATA_SIZE) != home.check_sum || home.lsn < copy.lsn) {
+    return false;
+  }
+
+  LOG_TRACE("skip a stale page in double write buffer. buffer_pool_id:%d,page_num:%d,lsn=%d,home lsn=%d",
+            bp->id(), page_num, copy.lsn, home.lsn);
+  return true;
+}
+
+RC DiskDoubleWriteBuffer::reset_file()
+{
+  DoubleWriteBufferHeader header;
+  header.page_cnt = max_pages_;
+
+  const int64_t file_size = DoubleWriteBufferHeader::SIZE + int64_t(max_pages_) * DoubleWritePage::SIZE;
+  if (ftruncate(file_desc_, 0) != 0 || ftruncate(file_desc_, file_size) != 0) {
+    LOG_ERROR("Failed to truncate double write buffer file. error=%s", strerror(errno));
+    return RC::IOERR_WRITE;
+  }
+
+  if (pwriten(file_desc_, &header, sizeof(header), 0) != 0) {
+    LOG_ERROR("Failed to write double write buffer header. error=%s", strerror(errno));
+    return RC::IOERR_WRITE;
+  }
+
+  if (fdatasync(file_desc_) != 0) {
+    LOG_ERROR("Failed to sync double write buffer file. error=%s", strerror(errno));
+    return RC::IOERR_SYNC;
+  }
+
+  lock_guard<mutex> guard(lock_);
+  for (int i = 0; i < max_pages_; i++) {
+    slots_[i].page.valid  = false;
+    slots_[i].buffer_pool = nullptr;
+  }
   return RC::SUCCESS;
 }
 
 RC DiskDoubleWriteBuffer::recover()
 {
-  return flush_page();
+  RC rc = write_back();
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  if (recovered_pages_.empty()) {
+    return RC::SUCCESS;
+  }
+
+  vector<DoubleWritePage *> pages;
+  pages.reserve(recovered_pages_.size());
+  for (auto &[key, dblwr_page] : recovered_pages_) {
+    pages.push_back(dblwr_page);
+  }
+  sort(pages.begin(), pages.end(), [](const DoubleWritePage *a, const DoubleWritePage *b) {
+    if (a->key.buffer_pool_id != b->key.buffer_pool_id) {
+      return a->key.buffer_pool_id < b->key.buffer_pool_id;
+    }
+    return a->key.page_num < b->key.page_num;
+  });
+
+  AsyncIOBatch             batch;
+  vector<DiskBufferPool *> buffer_pools;
+  int                      recovered_num = 0;
+  for (DoubleWritePage *dblwr_page : pages) {
+    DiskBufferPool *buffer_pool = nullptr;
+    rc = bp_manager_.get_buffer_pool(dblwr_page->key.buffer_pool_id, buffer_pool);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("skip the page of a buffer pool which is not opened. buffer_pool_id:%d,page_num:%d",
+               dblwr_page->key.buffer_pool_id, dblwr_page->key.page_num);
+      continue;
+    }
+
+    if (home_page_is_newer(buffer_pool, dblwr_page->key.page_num, dblwr_page->page)) {
+      continue;
+    }
+
+    LOG_TRACE("double write buffer recover page. buffer_pool_id:%d,page_num:%d,lsn=%d",
+              dblwr_page->key.buffer_pool_id, dblwr_page->key.page_num, dblwr_page->page.lsn);
+    buffer_pool->add_write_page(batch, dblwr_page->key.page_num, dblwr_page->page);
+    recovered_num++;
+    if (buffer_pools.empty() || buffer_pools.back() != buffer_pool) {
+      buffer_pools.push_back(buffer_pool);
+    }
+  }
+  for (DiskBufferPool *buffer_pool : buffer_pools) {
+    batch.add_fsync(buffer_pool->file_desc());
+  }
+
+  rc = execute_write_back(batch);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  {
+    lock_guard<mutex> guard(lock_);
+    for (auto &[key, dblwr_page] : recovered_pages_) {
+      delete dblwr_page;
+    }
+    recovered_pages_.clear();
+  }
+  LOG_INFO("double write buffer recovered %d pages, skipped %d stale pages",
+           recovered_num, static_cast<int>(pages.size()) - recovered_num);
+  return reset_file();
+}
+
+DoubleWriteBufferStats DiskDoubleWriteBuffer::stats() const
+{
+  lock_guard<mutex> guard(lock_);
+  return stats_;
 }
 
 ////////////////////////////////////////////////////////////////
@@ -14,7 +14,10 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/lang/condition_variable.h"
+#include "common/lang/memory.h"
 #include "common/lang/mutex.h"
+#include "common/lang/thread.h"
 #include "common/lang/unordered_map.h"
 #include "common/types.h"
 #include "common/sys/rc.h"
@@ -45,7 +48,7 @@ public:
 
 struct DoubleWriteBufferHeader
 {
-  int32_t page_cnt = 0;
+  int32_t page_cnt = 0;  ///< 文件中页面槽位的个数
 
   static const int32_t SIZE;
 };
@@ -70,6 +73,18 @@ struct DoubleWritePageKeyHash
   }
 };
 
+/**
+ * @brief double write buffer 的统计信息
+ * @ingroup BufferPool
+ */
+struct DoubleWriteBufferStats
+{
+  uint64_t added_pages   = 0;  ///< 加入的页面个数
+  uint64_t written_pages = 0;  ///< 写回到原始位置的页面个数。同一个页面多次加入时，只写回最新的
+  uint64_t batches       = 0;  ///< 批量写回的次数，每一批只 fsync 一次 double write buffer 文件
+  uint64_t full_waits    = 0;  ///< 环形缓冲区满了，add_page 等待的次数
+};
+
 /**
  * @brief 页面二次缓冲区，为了解决页面原子写入的问题
  * @ingroup BufferPool
@@ -80,33 +95,42 @@ struct DoubleWritePageKeyHash
  * 当我们从磁盘中读取页面时，会校验页面的checksum，如果校验失败，则说明页面写入不完整，这时候可以从
  * DoubleWriteBuffer中读取数据。
  *
+ * 共享文件是一个环形缓冲区，有 max_pages 个页面槽位。每个加入的页面有一个递增的序号，写入序号对应的槽位。
+ * 后台线程每次取出所有还没有写回的页面作为一批，先 fsync 一次共享文件，再按照文件和页号的顺序写回页面的
+ * 原始位置并 fsync，之后这些槽位就可以复用了。add_page 只有在环形缓冲区满的时候才需要等待。
+ * 页面写回之前，read_page 可以从缓冲区中读到最新的数据。
+ * 重启时，同一个页面以序号最大的为准。两次写回之间槽位的覆盖没有顺序保证，文件中保留的副本可能比
+ * 已经写回的页面还旧，所以恢复页面之前要读取原始位置的页面，它完整并且LSN不小于副本时，就不使用副本。
+ *
  * @note 每次都要保证，不管在内存中还是在文件中，这里的数据都是最新的，都比Buffer pool中的数据要新
  */
 class DiskDoubleWriteBuffer : public DoubleWriteBuffer
 {
 public:
+  static constexpr int DEFAULT_MAX_PAGES = 512;
+
   /**
    * @brief 构造函数
    *
    * @param bp_manager 关联的buffer pool manager
-   * @param max_pages  内存中保存的最大页面数
+   * @param max_pages  环形缓冲区的页面个数
    */
-  DiskDoubleWriteBuffer(BufferPoolManager &bp_manager, int max_pages = 16);
+  DiskDoubleWriteBuffer(BufferPoolManager &bp_manager, int max_pages = DEFAULT_MAX_PAGES);
   virtual ~DiskDoubleWriteBuffer();
 
   /**
-   * 打开磁盘中的共享表空间文件
+   * 打开磁盘中的共享表空间文件，并启动后台写回页面的线程
    */
   RC open_file(const char *filename);
 
   /**
-   * 将buffer中的页全部写入磁盘，并且清空buffer
-   * TODO 目前的解决方案是等buffer装满后再刷盘，可能会导致程序卡住一段时间
+   * 将buffer中的页全部写回到原始位置
    */
   RC flush_page();
 
   /**
    * 将页面加入buffer，并且写入磁盘中的共享表空间
+   * @details 只有环形缓冲区满了才会等待后台线程写回页面
    */
   RC add_page(DiskBufferPool *bp, PageNum page_num, Page &page) override;
 
@@ -114,40 +138,79 @@ public:
 
   /**
    * @brief 清空所有与指定buffer pool关联的页面
+   * @details 写回所有页面，并将文件中属于这个buffer pool的槽位标记为无效，以免以后的buffer pool使用相同的ID
    */
   RC clear_pages(DiskBufferPool *bp) override;
 
   /**
-   * 将共享表空间的页读入buffer
+   * 将启动时从共享表空间中读取的页面写回到原始位置，然后清空共享表空间
    */
   RC recover();
 
+  DoubleWriteBufferStats stats() const;
+
 private:
+  struct Slot;
+
+  /// 后台线程没有被唤醒时，每隔这么久写回一次页面
+  static constexpr int WRITE_BACK_INTERVAL_MS = 100;
+
+  /// 积攒了这么多页面后，马上唤醒后台线程写回
+  uint64_t batch_pages() const { return max_pages_ >= 8 ? max_pages_ / 8 : 1; }
+
+  /**
+   * @brief 后台线程，在有足够多的页面或者超时后写回页面
+   */
+  void thread_func();
+
   /**
-   * 将buffer中的页面写入对应的磁盘
+   * @brief 将当前所有还没有写回的页面写回到原始位置
+   * @details 先 fsync 共享文件，再写页面的原始位置并 fsync，最后释放槽位
    */
-  RC write_page(DoubleWritePage *page);
+  RC write_back();
 
   /**
-   * 将页面写到当前double write buffer文件中
-   * @details 每次页面更新都应该写入到磁盘中。保证double write buffer
-   * 内存和文件中的数据都是最新的。
+   * 将槽位的页面写到当前double write buffer文件中
    */
-  RC write_page_internal(DoubleWritePage *page);
+  RC write_slot(const Slot &slot);
 
   /**
    * @brief 将磁盘文件中的内容加载到内存中。在启动时调用
    */
   RC load_pages();
 
-private:
-  int                     file_desc_ = -1;
-  int                     max_pages_ = 0;
-  common::Mutex           lock_;
-  BufferPoolManager      &bp_manager_;
-  DoubleWriteBufferHeader header_;
+  /**
+   * @brief 原始位置的页面是否完整并且不比启动时加载的副本旧，这时副本不需要写回
+   */
+  bool home_page_is_newer(DiskBufferPool *bp, PageNum page_num, const Page &copy) const;
 
-  unordered_map<DoubleWritePageKey, DoubleWritePage *, DoubleWritePageKeyHash> dblwr_pages_;
+  /**
+   * @brief 清空共享文件，并按照当前的槽位个数重新写入文件头
+   */
+  RC reset_file();
+
+private:
+  int                file_desc_ = -1;
+  int                max_pages_ = 0;
+  BufferPoolManager &bp_manager_;
+
+  mutable mutex      lock_;           /// 保护下面的环形缓冲区状态
+  condition_variable writer_cv_;      /// 唤醒后台线程
+  condition_variable space_cv_;       /// 有槽位被释放
+  mutex              write_back_lock_;  /// 同时只有一个线程写回页面
+
+  unique_ptr<Slot[]> slots_;     /// 与文件中的槽位一一对应
+  uint64_t           head_ = 0;  /// 下一个页面的序号
+  uint64_t           tail_ = 0;  /// 小于这个序号的页面都已经写回，槽位可以复用
+  /// 还没有写回的页面最新的序号
+  unordered_map<DoubleWritePageKey, uint64_t, DoubleWritePageKeyHash> pending_pages_;
+  /// 启动时从文件中加载的页面，recover 时写回
+  unordered_map<DoubleWritePageKey, DoubleWritePage *, DoubleWritePageKeyHash> recovered_pages_;
+
+  unique_ptr<thread> thread_;
+  bool               running_ = false;  /// 后台线程是否还要运行，由 lock_ 保护
+
+  DoubleWriteBufferStats stats_;  /// 由 lock_ 保护
 };
 
 class VacuousDoubleWriteBuffer : public DoubleWriteBuffer
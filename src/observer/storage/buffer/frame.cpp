@@ -75,6 +75,9 @@ void Frame::write_latch(intptr_t xid)
   }
 
   lock_.lock();
+  if (write_latch_depth_++ == 0) {
+    version_.fetch_add(1, std::memory_order_acq_rel);
+  }
 
 #ifdef DEBUG
   write_locker_ = xid;
@@ -110,6 +113,9 @@ void Frame::write_unlatch(intptr_t xid)
   }
   debug_lock_.unlock();
 
+  if (--write_latch_depth_ == 0) {
+    version_.fetch_add(1, std::memory_order_release);
+  }
   lock_.unlock();
 }
 
@@ -208,6 +214,19 @@ void Frame::read_unlatch(intptr_t xid)
   lock_.unlock_shared();
 }
 
+bool Frame::begin_optimistic_read(uint64_t &version) const
+{
+  version = version_.load(std::memory_order_acquire);
+  return (version & 1) == 0;
+}
+
+bool Frame::validate_optimistic_read(uint64_t version) const
+{
+  // 保证前面读页面数据的操作不会被重排到读版本号之后
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return version_.load(std::memory_order_relaxed) == version;
+}
+
 void Frame::pin()
 {
   scoped_lock debug_lock(debug_lock_);
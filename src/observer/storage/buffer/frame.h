@@ -75,7 +75,7 @@ public:
    * @details 在 MemPoolSimple 分配和释放一个Frame对象时，不会调用构造函数和析构函数，
    * 而是调用reinit和reset。
    */
-  void reinit() {}
+  void reinit() { recovery_lsn_.store(0); }
   void reset() {}
 
   void clear_page() { memset(&page_, 0, sizeof(page_)); }
@@ -104,7 +104,23 @@ public:
    * 序列号要小，那就可以从日志中读取这些更大序列号的日志，做重做操作，将页面恢复到最新状态，也就是redo。
    */
   LSN  lsn() const { return page_.lsn; }
-  void set_lsn(LSN lsn) { page_.lsn = lsn; }
+  void set_lsn(LSN lsn)
+  {
+    page_.lsn = lsn;
+
+    LSN no_lsn = 0;
+    if (lsn > 0) {
+      recovery_lsn_.compare_exchange_strong(no_lsn, lsn);
+    }
+  }
+
+  /**
+   * @brief 页面上一次刷到磁盘之后，第一次修改对应的日志的LSN
+   * @details 恢复时至少要从这条日志开始重做，才能把这个页面恢复到最新的状态。
+   * 做检查点时，所有脏页中最小的 recovery lsn 之前的日志都不需要了(参考 Db::checkpoint)。
+   * 页面刷新之后清零，0 表示没有需要重做的日志
+   */
+  LSN recovery_lsn() const { return recovery_lsn_.load(); }
 
   /**
    * @brief 页面校验和
@@ -132,9 +148,21 @@ public:
    * @brief 重置“脏”标记
    * @details 如果页面已经被写入磁盘文件，则应调用此函数。
    */
-  void clear_dirty() { dirty_ = false; }
+  void clear_dirty()
+  {
+    dirty_ = false;
+    recovery_lsn_.store(0);
+  }
   bool dirty() const { return dirty_; }
 
+  /**
+   * @brief 页面已经释放，但是页帧还被其它线程pin着
+   * @details 这样的页帧已经从 BPFrameManager 中移除，不会再被找到、刷盘或者淘汰，
+   * 最后一个 unpin 的线程负责回收，参考 BPFrameManager::free
+   */
+  void set_disposed(bool disposed) { disposed_.store(disposed); }
+  bool disposed() const { return disposed_.load(); }
+
   char *data() { return page_.data; }
 
   bool can_purge() { return pin_count_.load() == 0; }
@@ -166,13 +194,29 @@ public:
   void read_unlatch();
   void read_unlatch(intptr_t xid);
 
+  /**
+   * @brief 乐观读(不加锁)开始时获取页面的版本号
+   * @details 加写锁时版本号变成奇数，释放写锁时再变成偶数，所以版本号没有变化说明读的过程中没有人修改过页面。
+   * 乐观读的线程依然需要pin住页面，防止页帧被淘汰后给其它页面使用。
+   * @return 有线程拿着写锁时返回false，这时不能读
+   */
+  bool begin_optimistic_read(uint64_t &version) const;
+
+  /**
+   * @brief 检查从 begin_optimistic_read 之后页面是否被修改过
+   * @details 读到的数据只有在检查通过之后才能使用，检查失败时调用者需要重新读
+   */
+  bool validate_optimistic_read(uint64_t version) const;
+
   string to_string() const;
 
 private:
   friend class BufferPool;
 
   bool          dirty_ = false;
+  atomic<LSN>   recovery_lsn_{0};
   atomic<int>   pin_count_{0};
+  atomic<bool>  disposed_{false};
   unsigned long acc_time_ = 0;
   FrameId       frame_id_;
   Page          page_;
@@ -180,6 +224,11 @@ private:
   /// 在非并发编译时，加锁解锁动作将什么都不做
   common::RecursiveSharedMutex lock_;
 
+  /// 乐观读使用的版本号，拿着写锁时是奇数
+  atomic<uint64_t> version_{0};
+  /// 写锁的递归次数，只有拿着写锁的线程访问。最外层的加锁和解锁才修改版本号
+  int              write_latch_depth_ = 0;
+
   /// 使用一些手段来做测试，提前检测出头疼的死锁问题
   /// 如果编译时没有增加调试选项，这些代码什么都不做
   common::DebugMutex           debug_lock_;
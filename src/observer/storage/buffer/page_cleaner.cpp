@@ -0,0 +1,201 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/buffer/page_cleaner.h"
+
+#include "common/lang/algorithm.h"
+#include "common/lang/chrono.h"
+#include "common/lang/map.h"
+#include "common/lang/sstream.h"
+#include "common/lang/vector.h"
+#include "common/log/log.h"
+#include "common/thread/thread_util.h"
+#include "storage/buffer/disk_buffer_pool.h"
+
+string BPPageCleanerStats::to_string() const
+{
+  stringstream ss;
+  ss << "rounds:" << rounds << ", flushed pages:" << flushed_pages << ", evicted frames:" << evicted_frames;
+  return ss.str();
+}
+
+BPPageCleaner::BPPageCleaner(BufferPoolManager &bp_manager, const BPPageCleanerOptions &options)
+    : bp_manager_(bp_manager), options_(options)
+{
+  const int total_frames = static_cast<int>(bp_manager_.get_frame_manager().total_frame_num());
+  low_water_frames_      = total_frames * min(max(options_.low_water_percent, 0), 100) / 100;
+  high_water_frames_     = max(low_water_frames_, total_frames * min(max(options_.high_water_percent, 0), 100) / 100);
+}
+
+BPPageCleaner::~BPPageCleaner() { stop(); }
+
+RC BPPageCleaner::start()
+{
+  if (thread_) {
+    LOG_ERROR("page cleaner has already been started");
+    return RC::INTERNAL;
+  }
+
+  if (options_.thread_num <= 0) {
+    LOG_INFO("page cleaner is disabled");
+    return RC::SUCCESS;
+  }
+
+#ifndef CONCURRENCY
+  LOG_WARN("page cleaner is not started as CONCURRENCY is off");
+  return RC::SUCCESS;
+#endif
+
+  if (options_.thread_num > 1) {
+    executor_ = make_unique<common::ThreadPoolExecutor>();
+    int ret   = executor_->init("PageCleaner", options_.thread_num, options_.thread_num, 60 * 1000);
+    if (ret != 0) {
+      LOG_ERROR("failed to init page cleaner executor. ret=%d", ret);
+      executor_.reset();
+      return RC::INTERNAL;
+    }
+  }
+
+  running_.store(true);
+  thread_ = make_unique<thread>(&BPPageCleaner::thread_func, this);
+  LOG_INFO("page cleaner started. threads=%d, low water frames=%d, high water frames=%d",
+           options_.thread_num, low_water_frames_, high_water_frames_);
+  return RC::SUCCESS;
+}
+
+RC BPPageCleaner::stop()
+{
+  if (!thread_) {
+    return RC::SUCCESS;
+  }
+
+  {
+    lock_guard<mutex> guard(mutex_);
+    running_.store(false);
+    cv_.notify_all();
+  }
+
+  thread_->join();
+  thread_.reset();
+
+  if (executor_) {
+    executor_->shutdown();
+    executor_->await_termination();
+    executor_.reset();
+  }
+
+  LOG_INFO("page cleaner stopped. %s", stats().to_string().c_str());
+  return RC::SUCCESS;
+}
+
+void BPPageCleaner::wakeup()
+{
+  if (!running_.load()) {
+    return;
+  }
+
+  lock_guard<mutex> guard(mutex_);
+  wakeup_flag_ = true;
+  cv_.notify_one();
+}
+
+bool BPPageCleaner::below_low_water() const
+{
+  return bp_manager_.get_frame_manager().free_frame_num() < low_water_frames_;
+}
+
+BPPageCleanerStats BPPageCleaner::stats() const
+{
+  BPPageCleanerStats stats;
+  stats.rounds         = rounds_.load();
+  stats.flushed_pages  = flushed_pages_.load();
+  stats.evicted_frames = evicted_frames_.load();
+  return stats;
+}
+
+void BPPageCleaner::thread_func()
+{
+  common::thread_set_name("PageCleaner");
+  LOG_INFO("page cleaner thread started");
+
+  while (running_.load()) {
+    {
+      unique_lock<mutex> guard(mutex_);
+      cv_.wait_for(guard, chrono::milliseconds(options_.interval_ms), [this]() {
+        return wakeup_flag_ || !running_.load();
+      });
+      wakeup_flag_ = false;
+    }
+
+    if (running_.load()) {
+      run_once();
+    }
+  }
+
+  LOG_INFO("page cleaner thread stopped");
+}
+
+int BPPageCleaner::run_once()
+{
+  if (!below_low_water()) {
+    return 0;
+  }
+
+  const int need = high_water_frames_ - bp_manager_.get_frame_manager().free_frame_num();
+  return clean(max(need, 1));
+}
+
+int BPPageCleaner::clean(int need)
+{
+  BPFrameManager &frame_manager = bp_manager_.get_frame_manager();
+
+  // 同一个文件的页面一起刷新，DiskBufferPool::flush_frames 会按照页号排序
+  map<int32_t, vector<Frame *>> file_frames;
+  for (Frame *frame : frame_manager.pin_dirty_victims(need)) {
+    file_frames[frame->buffer_pool_id()].push_back(frame);
+  }
+
+  mutex              done_mutex;
+  condition_variable done_cv;
+  size_t             pending = file_frames.size();
+  for (auto &[buffer_pool_id, frames] : file_frames) {
+    auto flush_task = [this, buffer_pool_id, &frames, &done_mutex, &done_cv, &pending]() {
+      int flushed_num = 0;
+      RC  rc          = bp_manager_.flush_frames(buffer_pool_id, frames, flushed_num);
+      if (OB_FAIL(rc)) {
+        LOG_WARN("failed to flush dirty pages. buffer pool id=%d, rc=%s", buffer_pool_id, strrc(rc));
+      }
+      flushed_pages_ += flushed_num;
+      for (Frame *frame : frames) {
+        bp_manager_.get_frame_manager().unpin(frame);
+      }
+
+      lock_guard<mutex> guard(done_mutex);
+      if (--pending == 0) {
+        done_cv.notify_one();
+      }
+    };
+
+    if (!executor_ || executor_->execute(flush_task) != 0) {
+      flush_task();
+    }
+  }
+
+  {
+    unique_lock<mutex> guard(done_mutex);
+    done_cv.wait(guard, [&pending]() { return pending == 0; });
+  }
+
+  const int evicted = frame_manager.evict_clean_frames(need);
+  evicted_frames_ += evicted;
+  rounds_++;
+  LOG_DEBUG("page cleaner round done. need=%d, evicted=%d, %s", need, evicted, stats().to_string().c_str());
+  return evicted;
+}
@@ -0,0 +1,121 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/atomic.h"
+#include "common/lang/condition_variable.h"
+#include "common/lang/memory.h"
+#include "common/lang/mutex.h"
+#include "common/lang/string.h"
+#include "common/lang/thread.h"
+#include "common/sys/rc.h"
+#include "common/thread/thread_pool_executor.h"
+
+class BufferPoolManager;
+
+/**
+ * @brief 后台刷脏页的配置
+ * @ingroup BufferPool
+ */
+struct BPPageCleanerOptions
+{
+  int thread_num         = 0;    ///< 刷脏页的线程数，0 表示不启动后台刷脏页
+  int low_water_percent  = 10;   ///< 空闲页帧低于总数的这个百分比时，开始刷脏页并释放页帧
+  int high_water_percent = 20;   ///< 每一轮刷脏页后，希望空闲页帧达到总数的这个百分比
+  int interval_ms        = 100;  ///< 没有被唤醒时，检查空闲页帧的时间间隔
+};
+
+/**
+ * @brief 后台刷脏页的统计信息
+ * @ingroup BufferPool
+ */
+struct BPPageCleanerStats
+{
+  uint64_t rounds         = 0;  ///< 空闲页帧不足而执行刷脏页的轮数
+  uint64_t flushed_pages  = 0;  ///< 刷新的脏页个数
+  uint64_t evicted_frames = 0;  ///< 提前释放的页帧个数
+
+  string to_string() const;
+};
+
+/**
+ * @brief 后台刷脏页
+ * @ingroup BufferPool
+ * @details 缓冲池满了以后，DiskBufferPool::allocate_frame 需要淘汰一个页帧，如果被淘汰的是脏页，
+ * 就要在查询线程中刷新这个页面，导致查询的延迟抖动。
+ * BPPageCleaner 在后台保持一定数量的空闲页帧：空闲页帧低于低水位时，按照淘汰策略的顺序找出接下来会被淘汰的
+ * 脏页，按照文件分组，每个文件的页面按页号顺序批量刷新，然后释放一些干净的页帧，直到空闲页帧达到高水位。
+ * 刷新页面之前需要等待页面上最大的LSN对应的日志刷盘(WAL)，参考 DiskBufferPool::flush_frames。
+ * 一个协调线程负责检查空闲页帧并分组，不同文件的页面由线程池并行刷新。
+ */
+class BPPageCleaner final
+{
+public:
+  BPPageCleaner(BufferPoolManager &bp_manager, const BPPageCleanerOptions &options);
+  ~BPPageCleaner();
+
+  /**
+   * @brief 启动后台线程
+   * @details thread_num 是 0 时不启动。没有打开 CONCURRENCY 编译选项时，BufferPool 的锁和页面的锁都不会生效，
+   * 所以也不会启动后台线程
+   */
+  RC start();
+
+  /**
+   * @brief 停止后台线程，并等待正在执行的任务结束
+   */
+  RC stop();
+
+  /**
+   * @brief 空闲页帧低于低水位时唤醒后台线程，不需要等到下一次定时检查
+   */
+  void wakeup();
+
+  /**
+   * @brief 空闲页帧是否低于低水位
+   */
+  bool below_low_water() const;
+
+  /**
+   * @brief 如果空闲页帧低于低水位，就在当前线程执行一轮刷脏页
+   * @details 后台线程调用，也可以在没有启动后台线程时直接调用
+   * @return 这一轮增加的空闲页帧个数
+   */
+  int run_once();
+
+  BPPageCleanerStats stats() const;
+
+private:
+  void thread_func();
+
+  /**
+   * @brief 执行一轮刷脏页
+   * @param need 希望增加的空闲页帧个数
+   */
+  int clean(int need);
+
+private:
+  BufferPoolManager   &bp_manager_;
+  BPPageCleanerOptions options_;
+  int                  low_water_frames_  = 0;  /// 空闲页帧的低水位
+  int                  high_water_frames_ = 0;  /// 空闲页帧的高水位
+
+  unique_ptr<thread>                     thread_;              /// 协调线程
+  atomic_bool                            running_{false};      /// 是否还要继续运行
+  unique_ptr<common::ThreadPoolExecutor> executor_;            /// 刷新脏页的线程池，为空时在当前线程刷新
+  mutex                                  mutex_;
+  condition_variable                     cv_;
+  bool                                   wakeup_flag_ = false;  /// 有线程请求刷脏页，由 mutex_ 保护
+
+  atomic<uint64_t> rounds_{0};
+  atomic<uint64_t> flushed_pages_{0};
+  atomic<uint64_t> evicted_frames_{0};
+};
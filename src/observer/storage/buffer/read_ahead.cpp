@@ -0,0 +1,160 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include "storage/buffer/read_ahead.h"
+
+#include "common/lang/sstream.h"
+#include "common/log/log.h"
+#include "common/thread/thread_util.h"
+#include "storage/buffer/disk_buffer_pool.h"
+
+string BPReadAheadStats::to_string() const
+{
+  stringstream ss;
+  ss << "requests:" << requests << ", dropped:" << dropped << ", reads:" << reads << ", loaded pages:" << loaded_pages
+     << ", discarded pages:" << discarded_pages;
+  return ss.str();
+}
+
+BPReadAheader::BPReadAheader(const BPReadAheadOptions &options) : options_(options) {}
+
+BPReadAheader::~BPReadAheader() { stop(); }
+
+RC BPReadAheader::start()
+{
+  if (thread_) {
+    LOG_ERROR("read ahead thread has already been started");
+    return RC::INTERNAL;
+  }
+
+  if (options_.pages <= 0 || !options_.background) {
+    LOG_INFO("read ahead runs in the accessing thread. pages=%d", options_.pages);
+    return RC::SUCCESS;
+  }
+
+#ifndef CONCURRENCY
+  LOG_WARN("read ahead thread is not started as CONCURRENCY is off");
+  return RC::SUCCESS;
+#endif
+
+  running_ = true;
+  thread_  = make_unique<thread>(&BPReadAheader::thread_func, this);
+  LOG_INFO("read ahead thread started. pages=%d, max pending=%d", options_.pages, options_.max_pending);
+  return RC::SUCCESS;
+}
+
+RC BPReadAheader::stop()
+{
+  if (!thread_) {
+    return RC::SUCCESS;
+  }
+
+  {
+    lock_guard<mutex> guard(mutex_);
+    running_ = false;
+    dropped_num_ += requests_.size();
+    requests_.clear();
+    request_cv_.notify_all();
+  }
+
+  thread_->join();
+  thread_.reset();
+
+  LOG_INFO("read ahead thread stopped. %s", stats().to_string().c_str());
+  return RC::SUCCESS;
+}
+
+void BPReadAheader::submit(DiskBufferPool *bp, vector<PageNum> &&pages)
+{
+  Request request{bp, std::move(pages)};
+  if (!thread_) {
+    execute(request);
+    return;
+  }
+
+  lock_guard<mutex> guard(mutex_);
+  if (!running_ || static_cast<int>(requests_.size()) >= options_.max_pending) {
+    dropped_num_++;
+    return;
+  }
+
+  requests_.push_back(std::move(request));
+  request_cv_.notify_one();
+}
+
+void BPReadAheader::cancel(DiskBufferPool *bp)
+{
+  unique_lock<mutex> guard(mutex_);
+  for (auto iter = requests_.begin(); iter != requests_.end();) {
+    if (iter->bp == bp) {
+      iter = requests_.erase(iter);
+      dropped_num_++;
+    } else {
+      ++iter;
+    }
+  }
+
+  done_cv_.wait(guard, [this, bp]() { return running_bp_ != bp; });
+}
+
+BPReadAheadStats BPReadAheader::stats() const
+{
+  BPReadAheadStats stats;
+  stats.requests        = requests_num_.load();
+  stats.dropped         = dropped_num_.load();
+  stats.reads           = reads_num_.load();
+  stats.loaded_pages    = loaded_pages_.load();
+  stats.discarded_pages = discarded_pages_.load();
+  return stats;
+}
+
+void BPReadAheader::thread_func()
+{
+  common::thread_set_name("ReadAhead");
+  LOG_INFO("read ahead thread started");
+
+  unique_lock<mutex> guard(mutex_);
+  while (running_) {
+    request_cv_.wait(guard, [this]() { return !requests_.empty() || !running_; });
+    if (!running_) {
+      break;
+    }
+
+    Request request = std::move(requests_.front());
+    requests_.pop_front();
+    running_bp_ = request.bp;
+    guard.unlock();
+
+    execute(request);
+
+    guard.lock();
+    running_bp_ = nullptr;
+    done_cv_.notify_all();
+  }
+
+  LOG_INFO("read ahead thread stopped");
+}
+
+void BPReadAheader::execute(Request &request)
+{
+  int reads_num     = 0;
+  int loaded_num    = 0;
+  int discarded_num = 0;
+  RC  rc            = request.bp->read_ahead(request.pages, reads_num, loaded_num, discarded_num);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to read ahead. file=%s, first page=%d, pages=%d, rc=%s",
+             request.bp->filename(), request.pages.front(), static_cast<int>(request.pages.size()), strrc(rc));
+  }
+
+  requests_num_++;
+  reads_num_ += reads_num;
+  loaded_pages_ += loaded_num;
+  discarded_pages_ += discarded_num;
+}
@@ -0,0 +1,126 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/atomic.h"
+#include "common/lang/condition_variable.h"
+#include "common/lang/deque.h"
+#include "common/lang/memory.h"
+#include "common/lang/mutex.h"
+#include "common/lang/string.h"
+#include "common/lang/thread.h"
+#include "common/lang/vector.h"
+#include "common/sys/rc.h"
+#include "common/types.h"
+
+class DiskBufferPool;
+
+/**
+ * @brief 预读的配置
+ * @ingroup BufferPool
+ */
+struct BPReadAheadOptions
+{
+  int  pages       = 0;     ///< 每次预读的页面个数，0 表示不预读
+  bool background  = true;  ///< 是否在后台线程中预读，否则在访问页面的线程中同步预读
+  int  max_pending = 16;    ///< 排队的预读请求个数上限，超过时丢弃新的请求
+};
+
+/**
+ * @brief 预读的统计信息
+ * @ingroup BufferPool
+ */
+struct BPReadAheadStats
+{
+  uint64_t requests        = 0;  ///< 执行的预读请求个数
+  uint64_t dropped         = 0;  ///< 因为排队太多而丢弃的请求个数
+  uint64_t reads           = 0;  ///< 读文件的次数，一次请求中连续的页面只读一次
+  uint64_t loaded_pages    = 0;  ///< 预读加载到内存的页面个数
+  uint64_t discarded_pages = 0;  ///< 读出来之后发现已经在内存中而丢弃的页面个数
+
+  string to_string() const;
+};
+
+/**
+ * @brief 顺序扫描时预读后面的页面
+ * @ingroup BufferPool
+ * @details 何时预读由 DiskBufferPool 决定：连续访问了相邻的页面，或者扫描时使用了 BPAccessHint::SCAN，
+ * 就按照文件头中的页面位图找出后面 pages 个已经分配的页面，提交给 BPReadAheader。
+ * BPReadAheader 在后台线程中调用 DiskBufferPool::read_ahead，把这些页面读到空闲页帧中，
+ * 连续的页面只发起一次 preadv。
+ * 访问线程不需要等待预读完成，预读还没有完成时访问到的页面由访问线程自己加载。
+ */
+class BPReadAheader final
+{
+public:
+  explicit BPReadAheader(const BPReadAheadOptions &options);
+  ~BPReadAheader();
+
+  /**
+   * @brief 启动后台线程
+   * @details 没有打开 CONCURRENCY 编译选项时，BufferPool 的锁和页面的锁都不会生效，所以不会启动后台线程，
+   * 而是在访问页面的线程中同步预读
+   */
+  RC start();
+
+  /**
+   * @brief 停止后台线程，丢弃还在排队的请求
+   */
+  RC stop();
+
+  /**
+   * @brief 每次预读的页面个数
+   */
+  int pages() const { return options_.pages; }
+
+  /**
+   * @brief 提交一个预读请求
+   * @details 后台线程没有启动时，直接在当前线程中执行
+   * @param bp    页面所在的文件
+   * @param pages 需要预读的页面，按照页号递增
+   */
+  void submit(DiskBufferPool *bp, vector<PageNum> &&pages);
+
+  /**
+   * @brief 丢弃指定文件还在排队的请求，并等待正在执行的请求结束
+   * @details 关闭文件之前调用
+   */
+  void cancel(DiskBufferPool *bp);
+
+  BPReadAheadStats stats() const;
+
+private:
+  struct Request
+  {
+    DiskBufferPool *bp = nullptr;
+    vector<PageNum> pages;
+  };
+
+  void thread_func();
+  void execute(Request &request);
+
+private:
+  BPReadAheadOptions options_;
+
+  unique_ptr<thread> thread_;                  /// 后台读线程
+  bool               running_    = false;      /// 是否还要继续运行，由 mutex_ 保护
+  DiskBufferPool    *running_bp_ = nullptr;    /// 正在预读的文件，由 mutex_ 保护
+  deque<Request>     requests_;                /// 排队的请求，由 mutex_ 保护
+  mutex              mutex_;
+  condition_variable request_cv_;              /// 有新的请求或者需要停止
+  condition_variable done_cv_;                 /// 一个请求执行完成
+
+  atomic<uint64_t> requests_num_{0};
+  atomic<uint64_t> dropped_num_{0};
+  atomic<uint64_t> reads_num_{0};
+  atomic<uint64_t> loaded_pages_{0};
+  atomic<uint64_t> discarded_pages_{0};
+};
@@ -12,6 +12,9 @@ See the Mulan PSL v2 for more details. */
 // Created by wangyunlai on 2024/01/30
 //
 
+#include "common/conf/ini.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/string.h"
 #include "common/thread/thread_util.h"
 #include "storage/clog/disk_log_handler.h"
 #include "storage/clog/log_file.h"
@@ -25,8 +28,34 @@ using namespace common;
 
 RC DiskLogHandler::init(const char *path)
 {
-  const int max_entry_number_per_file = 1000;
-  return file_manager_.init(path, max_entry_number_per_file);
+  DiskLogHandlerOptions options;
+  if (get_properties() != nullptr) {
+    str_to_val(get_properties()->get("GROUP_COMMIT_DELAY_US", "0", "CLOG"), options.group_commit_delay_us);
+    str_to_val(get_properties()->get("GROUP_COMMIT_SIZE", "64", "CLOG"), options.group_commit_size);
+    str_to_val(get_properties()->get("PIPELINED_SYNC", "1", "CLOG"), options.pipelined_sync);
+
+    int64_t file_size_mb = options.file_size / (1024 * 1024);
+    str_to_val(get_properties()->get("FILE_SIZE_MB", std::to_string(file_size_mb), "CLOG"), file_size_mb);
+    options.file_size = file_size_mb * 1024 * 1024;
+    str_to_val(get_properties()->get("RECYCLED_FILES", std::to_string(options.recycled_files), "CLOG"), options.recycled_files);
+    str_to_val(get_properties()->get("DIRECT_IO", "0", "CLOG"), options.direct_io);
+  }
+  return init(path, options);
+}
+
+RC DiskLogHandler::init(const char *path, const DiskLogHandlerOptions &options)
+{
+  options_ = options;
+  options_.group_commit_delay_us = max(options_.group_commit_delay_us, 0);
+  options_.group_commit_size     = max(options_.group_commit_size, 1);
+  options_.file_size             = max<int64_t>(options_.file_size, 0);
+  options_.recycled_files        = max(options_.recycled_files, 0);
+  LOG_INFO("init disk log handler. group commit delay=%dus, group commit size=%d, pipelined sync=%d, "
+           "file size=%ld, recycled files=%d, direct io=%d",
+           options_.group_commit_delay_us, options_.group_commit_size, options_.pipelined_sync,
+           options_.file_size, options_.recycled_files, options_.direct_io);
+
+  return file_manager_.init(path, options_.file_size, options_.recycled_files, options_.direct_io);
 }
 
 RC DiskLogHandler::start()
@@ -36,8 +65,16 @@ RC DiskLogHandler::start()
     return RC::INTERNAL;
   }
 
+  written_file_.reset();
+  written_lsn_    = entry_buffer_.flushed_lsn();
+  synced_lsn_     = written_lsn_;
+  writer_stopped_ = false;
+
   running_.store(true);
   thread_ = make_unique<thread>(&DiskLogHandler::thread_func, this);
+  if (options_.pipelined_sync) {
+    sync_thread_ = make_unique<thread>(&DiskLogHandler::sync_thread_func, this);
+  }
   LOG_INFO("log handler started");
   return RC::SUCCESS;
 }
@@ -51,6 +88,16 @@ RC DiskLogHandler::stop()
 
   running_.store(false);
 
+  // 唤醒等待日志的刷新线程和等待刷盘的线程
+  {
+    lock_guard guard(append_mutex_);
+  }
+  append_cond_.notify_all();
+  {
+    lock_guard guard(flushed_mutex_);
+  }
+  flushed_cond_.notify_all();
+
   LOG_INFO("log handler stopped");
   return RC::SUCCESS;
 }
@@ -69,13 +116,19 @@ RC DiskLogHandler::await_termination()
 
   thread_->join();
   thread_.reset();
+  if (sync_thread_) {
+    sync_thread_->join();
+    sync_thread_.reset();
+  }
+  written_file_.reset();
   LOG_INFO("log handler joined");
   return RC::SUCCESS;
 }
 
 RC DiskLogHandler::replay(LogReplayer &replayer, LSN start_lsn)
 {
-  LSN max_lsn = 0;
+  // 检查点之前的日志不会回放，但是它们的LSN已经用过了
+  LSN max_lsn = start_lsn > 0 ? start_lsn - 1 : 0;
   auto replay_callback = [&replayer, &max_lsn](LogEntry &entry) -> RC {
     if (entry.lsn() > max_lsn) {
       max_lsn = entry.lsn();
@@ -133,26 +186,42 @@ RC DiskLogHandler::iterate(function<RC(LogEntry&)> consumer, LSN start_lsn)
   return RC::SUCCESS;
 }
 
-RC DiskLogHandler::_append(LSN &lsn, LogModule module, vector<char> &&data)
+RC DiskLogHandler::purge(LSN lsn)
+{
+  int removed_num = 0;
+  RC  rc          = file_manager_.remove_files_before(lsn, removed_num);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to remove log files. lsn=%ld, rc=%s", lsn, strrc(rc));
+    return rc;
+  }
+
+  LOG_INFO("purge log files before checkpoint. lsn=%ld, removed files=%d", lsn, removed_num);
+  return RC::SUCCESS;
+}
+
+RC DiskLogHandler::_append(LSN &lsn, LogModule module, span<const char> data)
 {
   ASSERT(running_.load(), "log handler is not running. lsn=%ld, module=%s, size=%d", 
         lsn, module.name(), data.size());
 
-  RC rc = entry_buffer_.append(lsn, module, std::move(data));
+  RC rc = entry_buffer_.append(lsn, module, data);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to append log entry to buffer. rc=%s", strrc(rc));
     return rc;
   }
 
+  // 先加锁再通知，避免刷新线程检查完缓冲区之后、开始等待之前错过这次通知
+  {
+    lock_guard guard(append_mutex_);
+  }
+  append_cond_.notify_one();
   return RC::SUCCESS;
 }
 
 RC DiskLogHandler::wait_lsn(LSN lsn)
 {
-  // 直接强制等待。在生产系统中，我们可能会使用条件变量来等待。
-  while (running_.load() && current_flushed_lsn() < lsn) {
-    this_thread::sleep_for(chrono::milliseconds(100));
-  }
+  unique_lock lock(flushed_mutex_);
+  flushed_cond_.wait(lock, [this, lsn]() { return !running_.load() || current_flushed_lsn() >= lsn; });
 
   if (current_flushed_lsn() >= lsn) {
     return RC::SUCCESS;
@@ -161,26 +230,88 @@ RC DiskLogHandler::wait_lsn(LSN lsn)
   }
 }
 
+void DiskLogHandler::wait_for_entries()
+{
+  unique_lock lock(append_mutex_);
+  append_cond_.wait(lock, [this]() { return !running_.load() || entry_buffer_.entry_number() > 0; });
+
+  // 组提交：再等一会儿，让更多的事务日志进入同一批，共用一次 sync
+  if (options_.group_commit_delay_us > 0 && entry_buffer_.entry_number() < options_.group_commit_size) {
+    append_cond_.wait_for(lock, chrono::microseconds(options_.group_commit_delay_us), [this]() {
+      return !running_.load() || entry_buffer_.entry_number() >= options_.group_commit_size;
+    });
+  }
+}
+
+void DiskLogHandler::notify_written(const shared_ptr<LogFileWriter> &file_writer, LSN lsn)
+{
+  {
+    lock_guard guard(sync_mutex_);
+    written_file_ = file_writer;
+    written_lsn_  = lsn;
+  }
+  sync_cond_.notify_one();
+}
+
+RC DiskLogHandler::sync_written()
+{
+  shared_ptr<LogFileWriter> file_writer;
+  LSN                       lsn = 0;
+  {
+    lock_guard guard(sync_mutex_);
+    file_writer = written_file_;
+    lsn         = written_lsn_;
+  }
+
+  if (!file_writer || lsn <= synced_lsn_) {
+    return RC::SUCCESS;
+  }
+
+  // 写满的文件在切换到下一个文件之前已经 sync 过了，这里只需要 sync 最后写入的文件。
+  // sync 期间写线程可能又写入了一些日志，它们也会被刷到磁盘，不过要等下一次 sync 才会通知
+  RC rc = file_writer->sync();
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  synced_lsn_ = lsn;
+  sync_count_++;
+  entry_buffer_.set_flushed_lsn(lsn);
+
+  {
+    lock_guard guard(flushed_mutex_);
+  }
+  flushed_cond_.notify_all();
+  return RC::SUCCESS;
+}
+
 void DiskLogHandler::thread_func()
 {
   /*
-  这个线程一直不停的循环，检查日志缓冲区中是否有日志在内存中，如果在内存中就刷新到磁盘。
-  这种做法很粗暴简单，与生产数据库的做法不同。生产数据库通常会在内存达到一定量，或者一定时间
-  之后，会刷新一下磁盘。这样做的好处是减少磁盘的IO次数，提高性能。
+  这个线程一直不停的循环，每次从日志缓冲区中取出所有已经填充完成的连续日志，使用一次 writev 写到文件中，
+  然后释放缓冲区的空间。写文件时新的日志会追加到缓冲区的其它位置，下一次就可以一起写下去。
+  开启 pipelined_sync 时，写完一批日志就通知 sync 线程，然后马上开始写下一批。
   */
   thread_set_name("LogHandler");
   LOG_INFO("log handler thread started");
 
-  LogFileWriter file_writer;
-  
+  shared_ptr<LogFileWriter> file_writer;
+  // 下一条要写到文件中的日志，切换文件时作为新文件的名字
+  LSN next_lsn = entry_buffer_.flushed_lsn() + 1;
+
   RC rc = RC::SUCCESS;
   while (running_.load() || entry_buffer_.entry_number() > 0) {
-    if (!file_writer.valid() || rc == RC::LOG_FILE_FULL) {
+    if (!file_writer || rc == RC::LOG_FILE_FULL) {
+      auto new_file_writer = make_shared<LogFileWriter>();
       if (rc == RC::LOG_FILE_FULL) {
         // 我们在这里判断日志文件是否写满了。
-        rc = file_manager_.next_file(file_writer);
+        // sync 线程只会 sync 最后写入的文件，所以切换文件之前先把写满的文件刷到磁盘
+        rc = file_writer->sync();
+        if (OB_SUCC(rc)) {
+          rc = file_manager_.next_file(*new_file_writer, next_lsn);
+        }
       } else {
-        rc = file_manager_.last_file(file_writer);
+        rc = file_manager_.last_file(*new_file_writer, next_lsn);
       }
       if (OB_FAIL(rc)) {
         LOG_WARN("failed to open log file. rc=%s", strrc(rc));
@@ -189,20 +320,84 @@ void DiskLogHandler::thread_func()
         this_thread::sleep_for(chrono::milliseconds(100));
         continue;
       }
-      LOG_INFO("open log file success. file=%s", file_writer.to_string().c_str());
+      file_writer = std::move(new_file_writer);
+      LOG_INFO("open log file success. file=%s", file_writer->to_string().c_str());
     }
 
-    int flush_count = 0;
-    rc = entry_buffer_.flush(file_writer, flush_count);
-    if (OB_FAIL(rc) && RC::LOG_FILE_FULL != rc) {
-      LOG_WARN("failed to flush log entry buffer. rc=%s", strrc(rc));
+    LogBufferRegion region;
+    entry_buffer_.peek(region, file_writer->remain_bytes(), file_writer->offset() == 0);
+    if (region.empty()) {
+      if (entry_buffer_.entry_number() == 0) {
+        wait_for_entries();
+      } else if (region.limited) {
+        rc = RC::LOG_FILE_FULL;
+      } else {
+        // 下一条日志已经预留了空间，但是还没有填充完成
+        this_thread::yield();
+      }
+      continue;
     }
 
-    if (flush_count == 0 && rc == RC::SUCCESS) {
+    rc = file_writer->write(region.iovs, region.iovcnt, region.first_lsn, region.last_lsn);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to write log entries. rc=%s", strrc(rc));
       this_thread::sleep_for(chrono::milliseconds(100));
       continue;
     }
+
+    entry_buffer_.release(region);
+    next_lsn = region.last_lsn + 1;
+    notify_written(file_writer, region.last_lsn);
+    if (!options_.pipelined_sync) {
+      RC sync_rc = sync_written();
+      if (OB_FAIL(sync_rc)) {
+        LOG_WARN("failed to sync log file. rc=%s", strrc(sync_rc));
+      }
+    }
+
+    // 剩下的空间放不下下一条日志，下一次切换到新的文件
+    if (region.limited) {
+      rc = RC::LOG_FILE_FULL;
+    }
   }
 
+  if (!options_.pipelined_sync) {
+    // 最后一批日志 sync 失败时再尝试一次
+    RC sync_rc = sync_written();
+    if (OB_FAIL(sync_rc)) {
+      LOG_WARN("failed to sync log file. rc=%s", strrc(sync_rc));
+    }
+  }
+
+  {
+    lock_guard guard(sync_mutex_);
+    writer_stopped_ = true;
+  }
+  sync_cond_.notify_one();
+
   LOG_INFO("log handler thread stopped");
 }
+
+void DiskLogHandler::sync_thread_func()
+{
+  thread_set_name("LogSync");
+  LOG_INFO("log sync thread started");
+
+  while (true) {
+    {
+      unique_lock lock(sync_mutex_);
+      sync_cond_.wait(lock, [this]() { return written_lsn_ > synced_lsn_ || writer_stopped_; });
+      if (written_lsn_ <= synced_lsn_ && writer_stopped_) {
+        break;
+      }
+    }
+
+    RC rc = sync_written();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to sync log file. rc=%s", strrc(rc));
+      this_thread::sleep_for(chrono::milliseconds(100));
+    }
+  }
+
+  LOG_INFO("log sync thread stopped");
+}
@@ -20,6 +20,9 @@ See the Mulan PSL v2 for more details. */
 #include "common/lang/deque.h"
 #include "common/lang/memory.h"
 #include "common/lang/thread.h"
+#include "common/lang/mutex.h"
+#include "common/lang/condition_variable.h"
+#include "common/lang/atomic.h"
 #include "storage/clog/log_module.h"
 #include "storage/clog/log_file.h"
 #include "storage/clog/log_buffer.h"
@@ -27,12 +30,39 @@ See the Mulan PSL v2 for more details. */
 
 class LogReplayer;
 
+/**
+ * @brief 组提交和日志文件的配置
+ * @ingroup CLog
+ * @details 对应配置文件中的 [CLOG] 部分
+ */
+struct DiskLogHandlerOptions
+{
+  /// 缓冲区中有日志之后，最多再等待多少微秒凑够一批再写文件。0 表示不等待
+  int group_commit_delay_us = 0;
+  /// 缓冲区中的日志达到这么多条时不再等待，立即写文件
+  int group_commit_size = 64;
+  /// 是否使用单独的线程 sync 日志文件。开启后，一批日志在 sync 时，下一批日志可以同时写入文件
+  bool pipelined_sync = true;
+  /// 一个日志文件的大小，创建时预先分配空间。配置文件中的单位是MB
+  int64_t file_size = 64 * 1024 * 1024;
+  /// 最多保留多少个检查点之前的日志文件用于重用，重用的文件不需要重新创建和分配空间
+  int recycled_files = 4;
+  /// 是否使用 O_DIRECT 写日志文件，日志不经过 page cache
+  bool direct_io = false;
+};
+
 /**
  * @brief 对外提供服务的CLog模块
  * @ingroup CLog
  * @details 该模块负责日志的写入、读取、回放等功能。
  * 会在后台开启一个线程，一直尝试刷新内存中的日志到磁盘。
- * 所有的CLog日志文件都存放在指定的目录下，每个日志文件按照日志条数来划分。
+ * 所有的CLog日志文件都存放在指定的目录下，每个日志文件按照字节数来划分，写满之后切换到下一个文件。
+ *
+ * 刷新日志时使用组提交：后台线程每次从环形缓冲区中取出所有已经填充完成的连续日志，
+ * 使用一次 writev 写到文件中，再调用一次 fdatasync，这一批日志对应的事务共用一次 sync。
+ * 可以配置在缓冲区中有日志之后等待一小段时间，让更多的事务进入同一批。
+ * 开启 pipelined_sync 时，sync 由另一个线程执行，写线程不用等待 sync 完成就可以写下一批日志。
+ * 等待日志刷盘的线程使用条件变量等待，sync 完成后被唤醒。
  * 调用的顺序应该是：
  * @code {.cpp}
  * DiskLogHandler handler;
@@ -53,10 +83,11 @@ public:
 
   /**
    * @brief 初始化日志模块
-   *
+   * @details 组提交和日志文件的参数从配置文件的 [CLOG] 部分读取
    * @param path 日志文件存放的目录
    */
   RC init(const char *path) override;
+  RC init(const char *path, const DiskLogHandlerOptions &options);
 
   /**
    * @brief 启动线程刷新日志到磁盘
@@ -77,6 +108,8 @@ public:
    * @brief 回放日志
    * @details 日志回放后，会记录当前日志的最新状态，包括当前最大的LSN。
    * 所以这个接口应该在启动之前调用一次。
+   * start_lsn 之前的日志文件可能已经删除了，start_lsn 之后也可能没有日志，这时当前最大的LSN是 start_lsn - 1，
+   * 新的日志不会使用更小的LSN。
    * @param replayer 回放日志接口
    * @param start_lsn 从哪个位置开始回放
    */
@@ -102,6 +135,16 @@ public:
   /// @brief 当前刷新到哪个日志
   LSN current_flushed_lsn() const { return entry_buffer_.flushed_lsn(); }
 
+  /**
+   * @brief 删除只包含检查点之前的日志的文件，参考 LogFileManager::remove_files_before
+   */
+  RC purge(LSN lsn) override;
+
+  /// @brief 一共 sync 了多少次日志文件
+  int64_t sync_count() const { return sync_count_.load(); }
+
+  const DiskLogHandlerOptions &options() const { return options_; }
+
 private:
   /**
    * @brief 在缓存中增加一条日志
@@ -110,20 +153,60 @@ private:
    * @param[in] module  日志模块
    * @param[in] data    日志数据。具体的数据由各个模块自己定义
    */
-  RC _append(LSN &lsn, LogModule module, vector<char> &&data) override;
+  RC _append(LSN &lsn, LogModule module, span<const char> data) override;
 
 private:
   /**
    * @brief 刷新日志的线程函数
+   * @details 从缓冲区中取出日志写到文件中，然后释放缓冲区的空间。没有开启 pipelined_sync 时也负责 sync
    */
   void thread_func();
 
+  /**
+   * @brief sync 日志文件的线程函数
+   */
+  void sync_thread_func();
+
+  /**
+   * @brief 等待缓冲区中有日志
+   * @details 配置了 group_commit_delay_us 时，再等待一段时间或者等到日志足够多
+   */
+  void wait_for_entries();
+
+  /**
+   * @brief 记录写到文件中的最后一条日志，通知sync线程
+   */
+  void notify_written(const shared_ptr<LogFileWriter> &file_writer, LSN lsn);
+
+  /**
+   * @brief sync 最近写入日志的文件，然后唤醒等待这些日志的线程
+   */
+  RC sync_written();
+
 private:
+  DiskLogHandlerOptions options_;
+
   unique_ptr<thread> thread_;          /// 刷新日志的线程
+  unique_ptr<thread> sync_thread_;     /// sync 日志文件的线程
   atomic_bool        running_{false};  /// 是否还要继续运行
 
   LogFileManager file_manager_;  /// 管理所有的日志文件
   LogEntryBuffer entry_buffer_;  /// 缓存日志
 
+  mutex              append_mutex_;  /// 配合 append_cond_ 使用
+  condition_variable append_cond_;   /// 有新的日志时通知刷新日志的线程
+
+  mutex                     sync_mutex_;
+  condition_variable        sync_cond_;              /// 有新写入的日志时通知sync线程
+  shared_ptr<LogFileWriter> written_file_;           /// 最后一条日志写到了哪个文件
+  LSN                       written_lsn_    = 0;      /// 写到文件中的最后一条日志
+  LSN                       synced_lsn_     = 0;      /// sync 过的最后一条日志。只有执行sync的线程访问
+  bool                      writer_stopped_ = false;  /// 刷新日志的线程已经退出，sync线程处理完剩下的日志后退出
+
+  mutex              flushed_mutex_;  /// 配合 flushed_cond_ 使用
+  condition_variable flushed_cond_;   /// 日志刷盘后唤醒 wait_lsn 的线程
+
+  atomic<int64_t> sync_count_{0};  /// sync 日志文件的次数
+
   string path_;  /// 日志文件存放的目录
 };
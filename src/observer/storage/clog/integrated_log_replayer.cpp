@@ -13,7 +13,127 @@ See the Mulan PSL v2 for more details. */
 //
 
 #include "storage/clog/integrated_log_replayer.h"
+#include "common/lang/condition_variable.h"
+#include "common/lang/deque.h"
+#include "common/lang/functional.h"
+#include "common/lang/memory.h"
+#include "common/lang/mutex.h"
+#include "common/lang/serializer.h"
+#include "common/lang/string.h"
+#include "common/lang/thread.h"
+#include "common/thread/thread_util.h"
+#include "storage/buffer/page.h"
 #include "storage/clog/log_entry.h"
+#include "storage/index/bplus_tree_log_entry.h"
+
+/**
+ * @brief 并行回放页面日志的线程
+ * @details 每个线程有自己的队列，按照分发的顺序回放。队列满了时分发线程等待，避免日志文件很大时占用太多内存。
+ * 回放出错后，后面分发过来的日志直接丢弃，错误在分发下一条日志或者等待回放完成时返回。
+ */
+class IntegratedLogReplayer::Worker
+{
+public:
+  Worker(IntegratedLogReplayer &owner, int index) : owner_(owner), index_(index) {}
+  ~Worker() { stop(); }
+
+  void start()
+  {
+    running_ = true;
+    thread_  = make_unique<thread>(&Worker::thread_func, this);
+  }
+
+  /**
+   * @brief 停止线程，丢弃还没有回放的日志
+   */
+  void stop()
+  {
+    if (!thread_) {
+      return;
+    }
+
+    {
+      lock_guard guard(mutex_);
+      running_ = false;
+      entries_.clear();
+    }
+    entry_cv_.notify_all();
+    thread_->join();
+    thread_.reset();
+  }
+
+  RC push(LogEntry &&entry)
+  {
+    unique_lock guard(mutex_);
+    idle_cv_.wait(guard, [this]() { return static_cast<int>(entries_.size()) < max_pending_; });
+    if (OB_FAIL(rc_)) {
+      return rc_;
+    }
+
+    entries_.push_back(std::move(entry));
+    entry_cv_.notify_one();
+    return RC::SUCCESS;
+  }
+
+  RC wait()
+  {
+    unique_lock guard(mutex_);
+    idle_cv_.wait(guard, [this]() { return entries_.empty() && !busy_; });
+    return rc_;
+  }
+
+private:
+  void thread_func()
+  {
+    common::thread_set_name("LogReplay");
+
+    unique_lock guard(mutex_);
+    while (true) {
+      entry_cv_.wait(guard, [this]() { return !entries_.empty() || !running_; });
+      if (!running_) {
+        break;
+      }
+
+      LogEntry entry = std::move(entries_.front());
+      entries_.pop_front();
+      busy_ = true;
+      guard.unlock();
+
+      // 出错之后的日志不再回放，只是从队列中取出来，避免分发线程一直等待
+      RC rc = RC::SUCCESS;
+      if (OB_SUCC(rc_)) {
+        rc = owner_.replay_entry(entry);
+        if (OB_FAIL(rc)) {
+          LOG_WARN("failed to replay log entry. worker=%d, entry=%s, rc=%s", index_, entry.to_string().c_str(), strrc(rc));
+        }
+      }
+
+      guard.lock();
+      if (OB_FAIL(rc) && OB_SUCC(rc_)) {
+        rc_ = rc;
+      }
+      busy_ = false;
+      idle_cv_.notify_all();
+    }
+  }
+
+private:
+  static constexpr int max_pending_ = 1024;  ///< 队列中最多有多少条日志
+
+  IntegratedLogReplayer &owner_;
+  int                    index_ = 0;
+
+  unique_ptr<thread> thread_;
+  mutex              mutex_;
+  condition_variable entry_cv_;  ///< 有新的日志或者需要停止
+  condition_variable idle_cv_;   ///< 回放完一条日志
+  deque<LogEntry>    entries_;   ///< 等待回放的日志，由 mutex_ 保护
+  bool               running_ = false;
+  bool               busy_    = false;        ///< 是否有正在回放的日志，由 mutex_ 保护
+  RC                 rc_      = RC::SUCCESS;  ///< 遇到的第一个错误，由 mutex_ 保护
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 IntegratedLogReplayer::IntegratedLogReplayer(BufferPoolManager &bpm)
     : buffer_pool_log_replayer_(bpm),
@@ -22,14 +142,62 @@ IntegratedLogReplayer::IntegratedLogReplayer(BufferPoolManager &bpm)
       trx_log_replayer_(nullptr)
 {}
 
-IntegratedLogReplayer::IntegratedLogReplayer(BufferPoolManager &bpm, unique_ptr<LogReplayer> trx_log_replayer)
+IntegratedLogReplayer::IntegratedLogReplayer(
+    BufferPoolManager &bpm, unique_ptr<LogReplayer> trx_log_replayer, int worker_num /* = 0 */)
     : buffer_pool_log_replayer_(bpm),
       record_log_replayer_(bpm),
       bplus_tree_log_replayer_(bpm),
       trx_log_replayer_(std::move(trx_log_replayer))
-{}
+{
+  if (worker_num <= 0) {
+    return;
+  }
+
+#ifndef CONCURRENCY
+  LOG_WARN("log entries are replayed in one thread as CONCURRENCY is off");
+  return;
+#endif
+
+  for (int i = 0; i < worker_num; i++) {
+    workers_.push_back(make_unique<Worker>(*this, i));
+    workers_.back()->start();
+  }
+  LOG_INFO("replay log entries in parallel. worker num=%d", worker_num);
+}
+
+IntegratedLogReplayer::~IntegratedLogReplayer() { stop_workers(); }
 
 RC IntegratedLogReplayer::replay(const LogEntry &entry)
+{
+  if (workers_.empty()) {
+    return replay_entry(entry);
+  }
+
+  // 事务日志重做时不访问页面，不需要等待页面日志
+  if (entry.module().id() == LogModule::Id::TRANSACTION) {
+    return replay_entry(entry);
+  }
+
+  const int index = worker_index(entry);
+  if (index < 0) {
+    RC rc = wait_workers();
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    return replay_entry(entry);
+  }
+
+  // 传进来的日志对象会被日志文件读取器复用，所以复制一份
+  LogEntry copy;
+  RC rc = copy.init(entry.lsn(), entry.module(), vector<char>(entry.data(), entry.data() + entry.payload_size()));
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to copy log entry. entry=%s, rc=%s", entry.to_string().c_str(), strrc(rc));
+    return rc;
+  }
+  return workers_[index]->push(std::move(copy));
+}
+
+RC IntegratedLogReplayer::replay_entry(const LogEntry &entry)
 {
   switch (entry.module().id()) {
     case LogModule::Id::BUFFER_POOL: return buffer_pool_log_replayer_.replay(entry);
@@ -40,9 +208,87 @@ RC IntegratedLogReplayer::replay(const LogEntry &entry)
   }
 }
 
+int IntegratedLogReplayer::worker_index(const LogEntry &entry) const
+{
+  int32_t buffer_pool_id = -1;
+  PageNum page_num       = BP_INVALID_PAGE_NUM;
+  switch (entry.module().id()) {
+    case LogModule::Id::RECORD_MANAGER: {
+      if (entry.payload_size() < RecordLogHeader::SIZE) {
+        return -1;
+      }
+      auto header    = reinterpret_cast<const RecordLogHeader *>(entry.data());
+      buffer_pool_id = header->buffer_pool_id;
+      page_num       = header->page_num;
+    } break;
+    case LogModule::Id::BPLUS_TREE: {
+      // 一条 B+ 树日志的开头是 buffer pool id，后面是它修改的多个页面。
+      // 只修改一个节点页面的日志(比如不需要分裂的插入)按照页面分配，
+      // 修改多个页面或者修改索引文件头的日志(分裂、合并、更新根节点)在分发线程中回放
+      common::Deserializer buffer(entry.data(), entry.payload_size());
+      if (buffer.read_int32(buffer_pool_id) != 0) {
+        return -1;
+      }
+      while (buffer.remain() > 0) {
+        unique_ptr<bplus_tree::LogEntryHandler> handler;
+        if (OB_FAIL(bplus_tree::LogEntryHandler::from_buffer(buffer, handler))) {
+          return -1;
+        }
+
+        using OperationType      = bplus_tree::LogOperation::Type;
+        const OperationType type = handler->operation_type().type();
+        if (type == OperationType::INIT_HEADER_PAGE || type == OperationType::UPDATE_ROOT_PAGE) {
+          return -1;
+        }
+        if (page_num != BP_INVALID_PAGE_NUM && page_num != handler->page_num()) {
+          return -1;
+        }
+        page_num = handler->page_num();
+      }
+      if (page_num == BP_INVALID_PAGE_NUM) {
+        return -1;
+      }
+    } break;
+    default: {
+      return -1;
+    }
+  }
+
+  const uint64_t key = (static_cast<uint64_t>(static_cast<uint32_t>(buffer_pool_id)) << 32) |
+                       static_cast<uint32_t>(page_num);
+  return static_cast<int>(std::hash<uint64_t>()(key) % workers_.size());
+}
+
+RC IntegratedLogReplayer::wait_workers()
+{
+  RC rc = RC::SUCCESS;
+  for (auto &worker : workers_) {
+    RC worker_rc = worker->wait();
+    if (OB_FAIL(worker_rc) && OB_SUCC(rc)) {
+      rc = worker_rc;
+    }
+  }
+  return rc;
+}
+
+void IntegratedLogReplayer::stop_workers()
+{
+  for (auto &worker : workers_) {
+    worker->stop();
+  }
+  workers_.clear();
+}
+
 RC IntegratedLogReplayer::on_done()
 {
-  RC rc = buffer_pool_log_replayer_.on_done();
+  RC rc = wait_workers();
+  stop_workers();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to replay page log entries in parallel. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  rc = buffer_pool_log_replayer_.on_done();
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to do buffer pool log replay. rc=%s", strrc(rc));
     return rc;
@@ -66,4 +312,4 @@ RC IntegratedLogReplayer::on_done()
   }
 
   return RC::SUCCESS;
-}
\ No newline at end of file
+}
@@ -14,6 +14,8 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include "common/lang/memory.h"
+#include "common/lang/vector.h"
 #include "storage/clog/log_replayer.h"
 #include "storage/buffer/buffer_pool_log.h"
 #include "storage/record/record_log.h"
@@ -25,7 +27,16 @@ class BufferPoolManager;
 /**
  * @brief 整体日志回放类
  * @ingroup Clog
- * @details 负责回放所有日志，是其它各模块日志回放的分发器
+ * @details 负责回放所有日志，是其它各模块日志回放的分发器。
+ * 默认在调用 replay 的线程中逐条回放日志。指定了回放线程数时，使用并行回放：
+ * 调用 replay 的线程负责从日志文件中解析日志并分发，record manager 的日志只修改一个页面，
+ * 按照 (buffer_pool_id, page_num) 分配给回放线程；B+ 树日志只修改一个节点页面时也按照页面分配，
+ * 修改多个页面或者索引文件头的 B+ 树日志(分裂、合并、更新根节点)和下面的缓冲池日志一样，是一个屏障。
+ * 同一个页面的日志总是由同一个线程按照LSN顺序回放，不同页面的日志可以同时回放。
+ * 缓冲池的日志会修改文件头页面，并且后面的日志依赖它分配的页面，所以是一个屏障：
+ * 等待所有回放线程处理完已经分发的日志后，在分发线程中回放。
+ * 事务日志在重做时不访问页面，只记录事务的状态，在分发线程中按顺序回放，不需要等待；
+ * 在 on_done 中回滚未提交的事务之前，会等待所有页面日志回放完成。
  */
 class IntegratedLogReplayer : public LogReplayer
 {
@@ -42,9 +53,10 @@ public:
    * @brief 构造函数
    * @details
    * 区别于另一个构造函数，这个构造函数可以指定不同的事务日志回放器。比如进程启动时可以指定选择使用VacuousTrx还是MvccTrx。
+   * @param worker_num 并行回放页面日志的线程数。0 表示在调用 replay 的线程中回放
    */
-  IntegratedLogReplayer(BufferPoolManager &bpm, unique_ptr<LogReplayer> trx_log_replayer);
-  virtual ~IntegratedLogReplayer() = default;
+  IntegratedLogReplayer(BufferPoolManager &bpm, unique_ptr<LogReplayer> trx_log_replayer, int worker_num = 0);
+  virtual ~IntegratedLogReplayer();
 
   //! @copydoc LogReplayer::replay
   RC replay(const LogEntry &entry) override;
@@ -52,9 +64,36 @@ public:
   //! @copydoc LogReplayer::on_done
   RC on_done() override;
 
+  /// @brief 并行回放页面日志的线程数。没有开启 CONCURRENCY 时总是 0
+  int worker_num() const { return static_cast<int>(workers_.size()); }
+
+private:
+  class Worker;
+
+  /**
+   * @brief 在当前线程中回放一条日志
+   */
+  RC replay_entry(const LogEntry &entry);
+
+  /**
+   * @brief 找到负责回放这条页面日志的线程
+   * @return 不是单个页面的日志或者日志不完整时返回 -1，这时等待回放线程空闲后在分发线程中回放，由各个模块报告错误
+   */
+  int worker_index(const LogEntry &entry) const;
+
+  /**
+   * @brief 等待所有回放线程处理完已经分发的日志
+   * @return 回放线程遇到的第一个错误
+   */
+  RC wait_workers();
+
+  void stop_workers();
+
 private:
   BufferPoolLogReplayer   buffer_pool_log_replayer_;  ///< 缓冲池日志回放器
   RecordLogReplayer       record_log_replayer_;       ///< record manager 日志回放器
   BplusTreeLogReplayer    bplus_tree_log_replayer_;   ///< bplus tree 日志回放器
   unique_ptr<LogReplayer> trx_log_replayer_;          ///< trx 日志回放器
-};
\ No newline at end of file
+
+  vector<unique_ptr<Worker>> workers_;  ///< 并行回放页面日志的线程
+};
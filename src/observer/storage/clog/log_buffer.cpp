@@ -14,93 +14,210 @@ See the Mulan PSL v2 for more details. */
 
 #include "storage/clog/log_buffer.h"
 #include "storage/clog/log_file.h"
+#include "common/lang/algorithm.h"
 #include "common/lang/chrono.h"
+#include "common/lang/thread.h"
+#include "common/log/log.h"
 
 using namespace common;
 
+static constexpr int32_t DEFAULT_LOG_BUFFER_BYTES = 4 * 1024 * 1024;
+
+LogEntryBuffer::LogEntryBuffer() { init(0, DEFAULT_LOG_BUFFER_BYTES); }
+
 RC LogEntryBuffer::init(LSN lsn, int32_t max_bytes /*= 0*/)
 {
-  current_lsn_.store(lsn);
-  flushed_lsn_.store(lsn);
-
   if (max_bytes > 0) {
-    max_bytes_ = max_bytes;
+    // 缓冲区至少能放下一条最大的日志，大小是2的幂，位置对 2^32 取模之后仍然可以直接计算下标
+    uint32_t capacity = 1;
+    while (capacity < static_cast<uint32_t>(max(max_bytes, LogEntry::max_size()))) {
+      capacity <<= 1;
+    }
+
+    if (capacity != buffer_.size()) {
+      buffer_.assign(capacity, 0);
+      mask_ = capacity - 1;
+
+      // 每条日志至少有一个日志头，缓冲区中最多有 capacity / LogHeader::SIZE 条日志
+      uint32_t slot_num = 1;
+      while (slot_num < capacity / LogHeader::SIZE) {
+        slot_num <<= 1;
+      }
+      slots_     = vector<atomic<LSN>>(slot_num);
+      slot_mask_ = slot_num - 1;
+    }
+  }
+
+  for (atomic<LSN> &slot : slots_) {
+    slot.store(0, memory_order_relaxed);
   }
+
+  reserved_.store(make_reserved(static_cast<uint32_t>(lsn), 0));
+  released_lsn_.store(lsn);
+  released_pos_.store(0);
+  flushed_lsn_.store(lsn);
   return RC::SUCCESS;
 }
 
-RC LogEntryBuffer::append(LSN &lsn, LogModule::Id module_id, vector<char> &&data)
+RC LogEntryBuffer::append(LSN &lsn, LogModule::Id module_id, span<const char> data)
 {
-  return append(lsn, LogModule(module_id), std::move(data));
+  return append(lsn, LogModule(module_id), data);
 }
 
-RC LogEntryBuffer::append(LSN &lsn, LogModule module, vector<char> &&data)
+RC LogEntryBuffer::append(LSN &lsn, LogModule module, span<const char> data)
 {
-  /// 控制当前buffer使用的内存
-  /// 简单粗暴，强制原地等待
-  /// 但是如果当前想要新插入的日志比较大，不会做控制。所以理论上容纳的最大buffer内存是2*max_bytes_
-  while (bytes_.load() >= max_bytes_) {
-    this_thread::sleep_for(chrono::milliseconds(10));
+  if (data.size() > static_cast<size_t>(LogEntry::max_payload_size())) {
+    LOG_WARN("log entry is too large. size=%ld, max payload size=%d", data.size(), LogEntry::max_payload_size());
+    return RC::INVALID_ARGUMENT;
   }
 
-  LogEntry entry;
-  RC rc = entry.init(lsn, module, std::move(data));
-  if (OB_FAIL(rc)) {
-    LOG_WARN("failed to init log entry. rc=%s", strrc(rc));
-    return rc;
+  const uint32_t size = static_cast<uint32_t>(LogHeader::SIZE + data.size());
+
+  // 预留LSN和空间。released_lsn_ 要在预留之前读取，保证它不大于预留的LSN
+  const LSN base_lsn = released_lsn_.load(memory_order_acquire);
+  uint64_t  reserved = reserved_.load(memory_order_relaxed);
+  while (!reserved_.compare_exchange_weak(
+      reserved, make_reserved(reserved_lsn(reserved) + 1, reserved_pos(reserved) + size), memory_order_acq_rel)) {
+  }
+
+  lsn                = full_lsn(base_lsn, reserved_lsn(reserved) + 1);
+  const uint32_t pos = reserved_pos(reserved);
+
+  /// 控制当前buffer使用的内存
+  /// 缓冲区满了就等待刷新线程释放空间。释放的速度取决于写文件的速度，所以等待一会儿之后就不再让出CPU而是休眠
+  for (int i = 0; pos + size - released_pos_.load(memory_order_acquire) > capacity(); i++) {
+    if (i < 100) {
+      this_thread::yield();
+    } else {
+      this_thread::sleep_for(chrono::milliseconds(1));
+    }
   }
 
-  lock_guard guard(mutex_);
-  lsn = ++current_lsn_;
-  entry.set_lsn(lsn);
+  LogHeader header;
+  header.lsn       = lsn;
+  header.size      = static_cast<int32_t>(data.size());
+  header.module_id = module.index();
+  header.check_sum = header.calc_check_sum(data.data());
+  write_at(pos, reinterpret_cast<const char *>(&header), LogHeader::SIZE);
+  write_at(pos + LogHeader::SIZE, data.data(), static_cast<uint32_t>(data.size()));
 
-  entries_.push_back(std::move(entry));
-  bytes_ += entry.total_size();
+  slots_[lsn & slot_mask_].store(lsn, memory_order_release);
   return RC::SUCCESS;
 }
 
+void LogEntryBuffer::peek(LogBufferRegion &region, int64_t max_bytes, bool at_least_one /*= false*/)
+{
+  const LSN      first_lsn = released_lsn_.load(memory_order_relaxed) + 1;
+  const uint32_t first_pos = released_pos_.load(memory_order_relaxed);
+
+  region.limited = false;
+
+  LSN      lsn = first_lsn;
+  uint32_t pos = first_pos;
+  while (slots_[lsn & slot_mask_].load(memory_order_acquire) == lsn) {
+    LogHeader header;
+    read_at(pos, reinterpret_cast<char *>(&header), LogHeader::SIZE);
+    ASSERT(header.lsn == lsn && header.size >= 0, "invalid log entry in buffer. lsn=%ld, header=%s", 
+           lsn, header.to_string().c_str());
+
+    const uint32_t entry_bytes = LogHeader::SIZE + header.size;
+    if (static_cast<uint32_t>(pos - first_pos) + static_cast<int64_t>(entry_bytes) > max_bytes &&
+        !(at_least_one && lsn == first_lsn)) {
+      region.limited = true;
+      break;
+    }
+
+    pos += entry_bytes;
+    lsn++;
+  }
+
+  region.first_lsn = first_lsn;
+  region.last_lsn  = lsn - 1;
+  region.entry_num = static_cast<int32_t>(lsn - first_lsn);
+  region.bytes     = static_cast<uint32_t>(pos - first_pos);
+
+  const uint32_t start = first_pos & mask_;
+  const uint32_t first_part = static_cast<uint32_t>(min<int64_t>(region.bytes, capacity() - start));
+  region.iovs[0] = {buffer_.data() + start, first_part};
+  region.iovcnt  = 1;
+  if (first_part < region.bytes) {
+    region.iovs[1] = {buffer_.data(), static_cast<size_t>(region.bytes - first_part)};
+    region.iovcnt  = 2;
+  }
+}
+
+void LogEntryBuffer::release(const LogBufferRegion &region)
+{
+  if (region.empty()) {
+    return;
+  }
+
+  ASSERT(region.first_lsn == released_lsn_.load() + 1, "release log entries out of order. first lsn=%ld, released lsn=%ld", 
+         region.first_lsn, released_lsn_.load());
+  // 先更新位置再更新LSN，追加日志的线程使用 released_lsn_ 还原完整的LSN，只要求它不大于预留的LSN
+  released_pos_.store(released_pos_.load(memory_order_relaxed) + static_cast<uint32_t>(region.bytes), memory_order_release);
+  released_lsn_.store(region.last_lsn, memory_order_release);
+}
+
 RC LogEntryBuffer::flush(LogFileWriter &writer, int &count)
 {
   count = 0;
 
-  while (entry_number() > 0) {
-    LogEntry entry;
-    {
-      lock_guard guard(mutex_);
-      if (entries_.empty()) {
-        break;
-      }
+  LogBufferRegion region;
+  peek(region, writer.remain_bytes(), writer.offset() == 0);
+  if (region.empty()) {
+    return region.limited ? RC::LOG_FILE_FULL : RC::SUCCESS;
+  }
 
-      LogEntry &front_entry = entries_.front();
-      ASSERT(front_entry.lsn() > 0 && front_entry.payload_size() > 0, "invalid log entry");
-      entry = std::move(entries_.front());
-      ASSERT(entry.payload_size() > 0 && entry.lsn() > 0, "invalid log entry");
-      entries_.pop_front();
-      bytes_ -= entry.total_size();
-    }
-    
-    RC rc = writer.write(entry);
-    if (OB_FAIL(rc)) {
-      lock_guard guard(mutex_);
-      entries_.emplace_front(std::move(entry));
-      LogEntry &front_entry = entries_.front();
-      ASSERT(front_entry.lsn() > 0 && front_entry.payload_size() > 0, "invalid log entry");
-      return rc;
-    } else {
-      ++count;
-      flushed_lsn_ = entry.lsn();
-    }
+  RC rc = writer.write(region.iovs, region.iovcnt, region.first_lsn, region.last_lsn);
+  if (OB_FAIL(rc)) {
+    return rc;
   }
-  
+  release(region);
+
+  // 写入的日志都 sync 到磁盘之后才算刷新完成
+  rc = writer.sync();
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+  flushed_lsn_ = region.last_lsn;
+  count        = region.entry_num;
   return RC::SUCCESS;
 }
 
 int64_t LogEntryBuffer::bytes() const
 {
-  return bytes_.load();
+  const uint32_t released_pos = released_pos_.load();
+  return static_cast<uint32_t>(reserved_pos(reserved_.load()) - released_pos);
 }
 
 int32_t LogEntryBuffer::entry_number() const
 {
-  return entries_.size();
+  const LSN released_lsn = released_lsn_.load();
+  return static_cast<int32_t>(full_lsn(released_lsn, reserved_lsn(reserved_.load())) - released_lsn);
+}
+
+LSN LogEntryBuffer::current_lsn() const
+{
+  return full_lsn(released_lsn_.load(), reserved_lsn(reserved_.load()));
+}
+
+void LogEntryBuffer::write_at(uint32_t pos, const char *data, uint32_t size)
+{
+  const uint32_t start      = pos & mask_;
+  const uint32_t first_part = min(size, static_cast<uint32_t>(capacity() - start));
+  memcpy(buffer_.data() + start, data, first_part);
+  if (first_part < size) {
+    memcpy(buffer_.data(), data + first_part, size - first_part);
+  }
+}
+
+void LogEntryBuffer::read_at(uint32_t pos, char *data, uint32_t size) const
+{
+  const uint32_t start      = pos & mask_;
+  const uint32_t first_part = min(size, static_cast<uint32_t>(capacity() - start));
+  memcpy(data, buffer_.data() + start, first_part);
+  if (first_part < size) {
+    memcpy(data + first_part, buffer_.data(), size - first_part);
+  }
 }
@@ -14,37 +14,70 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <sys/uio.h>
+
 #include "common/sys/rc.h"
 #include "common/types.h"
-#include "common/lang/mutex.h"
-#include "common/lang/vector.h"
-#include "common/lang/deque.h"
 #include "common/lang/atomic.h"
+#include "common/lang/span.h"
+#include "common/lang/vector.h"
 #include "storage/clog/log_module.h"
 #include "storage/clog/log_entry.h"
 
 class LogFileWriter;
 
+/**
+ * @brief 环形缓冲区中一段连续的、已经填充完成的日志
+ * @ingroup CLog
+ * @details 缓冲区绕回时数据分成两段
+ */
+struct LogBufferRegion
+{
+  LSN     first_lsn = 0;  /// 第一条日志的LSN。没有日志时是下一条要刷新的日志
+  LSN     last_lsn  = 0;  /// 最后一条日志的LSN
+  int32_t entry_num = 0;  /// 一共多少条日志
+  int64_t bytes     = 0;  /// 一共多少字节，包括日志头
+  iovec   iovs[2];        /// 日志数据在缓冲区中的位置
+  int     iovcnt = 0;
+  bool    limited = false;  /// 下一条日志已经填充完成，但是超过了 peek 允许的字节数，通常表示当前日志文件写满了
+
+  bool empty() const { return entry_num == 0; }
+};
+
 /**
  * @brief 日志数据缓冲区
  * @ingroup CLog
  * @details 缓存一部分日志在内存中而不是直接写入磁盘。
- * 这里的缓存没有考虑高性能操作，比如使用预分配内存、环形缓冲池等。
- * 在生产数据库中，通常会使用预分配内存形式的缓存来提高性能，并且可以减少内存碎片。
+ * 缓冲区是一块预先分配的环形内存，日志按照LSN的顺序连续存放，格式与日志文件中的格式相同(日志头+数据)。
+ * 追加日志时不加锁：
+ * 1. 使用一次CAS同时预留LSN和缓冲区中的一段空间。LSN和空间的位置打包在一个64位整数中，
+ *    所以LSN的顺序与日志在缓冲区中的顺序总是一致的；
+ * 2. 等待预留的空间被刷新线程释放(缓冲区满时才需要等待)；
+ * 3. 把日志头和数据直接复制到预留的位置，每条日志不需要再申请内存；
+ * 4. 在 LSN 对应的槽位上记录这条日志已经填充完成。
+ * 刷新线程从上次写到的位置开始，检查后面的日志是否已经填充完成，取出连续的一段，使用一次 writev 写到文件中。
+ * 槽位的个数不少于缓冲区中最多能放下的日志条数，所以同一个槽位不会被两条没有刷新的日志使用。
+ * @note 只能有一个线程调用 peek/release/flush
  */
 class LogEntryBuffer
 {
 public:
-  LogEntryBuffer()  = default;
+  LogEntryBuffer();
   ~LogEntryBuffer() = default;
 
+  /**
+   * @brief 初始化
+   * @details 不能与 append 同时调用
+   * @param lsn 当前最大的LSN，新的日志从 lsn+1 开始
+   * @param max_bytes 缓冲区大小，会向上取整到2的幂，并且至少能放下一条最大的日志
+   */
   RC init(LSN lsn, int32_t max_bytes = 0);
 
   /**
    * @brief 在缓冲区中追加一条日志
    */
-  RC append(LSN &lsn, LogModule::Id module_id, vector<char> &&data);
-  RC append(LSN &lsn, LogModule module, vector<char> &&data);
+  RC append(LSN &lsn, LogModule::Id module_id, span<const char> data);
+  RC append(LSN &lsn, LogModule module, span<const char> data);
 
   /**
    * @brief 刷新缓冲区中的日志到磁盘
@@ -55,25 +88,64 @@ public:
   RC flush(LogFileWriter &file_writer, int &count);
 
   /**
-   * @brief 当前缓冲区中有多少字节的日志
+   * @brief 获取缓冲区头部已经填充完成的一段连续的日志
+   * @param region 日志的位置
+   * @param max_bytes 最多获取多少字节(包括日志头)，通常是当前日志文件剩余的空间
+   * @param at_least_one 第一条日志超过 max_bytes 时也获取它。写空文件时使用，否则比文件还大的日志永远也写不进去
+   */
+  void peek(LogBufferRegion &region, int64_t max_bytes, bool at_least_one = false);
+
+  /**
+   * @brief 释放 peek 获取的日志占用的空间
+   * @details 日志写到文件中之后调用，等待空间的线程就可以继续追加日志
+   */
+  void release(const LogBufferRegion &region);
+
+  /**
+   * @brief 设置已经刷新到磁盘的日志
+   * @details 使用 peek 获取日志的调用者写完并 sync 之后调用
+   */
+  void set_flushed_lsn(LSN lsn) { flushed_lsn_.store(lsn); }
+
+  /**
+   * @brief 当前缓冲区中有多少字节的日志，包括还在填充的日志
    */
   int64_t bytes() const;
 
   /**
-   * @brief 当前缓冲区中有多少条日志
+   * @brief 当前缓冲区中有多少条日志，包括还在填充的日志
    */
   int32_t entry_number() const;
 
-  LSN current_lsn() const { return current_lsn_.load(); }
+  LSN current_lsn() const;
   LSN flushed_lsn() const { return flushed_lsn_.load(); }
 
+  int64_t capacity() const { return static_cast<int64_t>(mask_) + 1; }
+
+private:
+  /// 预留的LSN和位置打包在一起，高32位是LSN，低32位是位置，都是对 2^32 取模的值
+  static uint32_t reserved_lsn(uint64_t reserved) { return static_cast<uint32_t>(reserved >> 32); }
+  static uint32_t reserved_pos(uint64_t reserved) { return static_cast<uint32_t>(reserved); }
+  static uint64_t make_reserved(uint32_t lsn, uint32_t pos) { return (static_cast<uint64_t>(lsn) << 32) | pos; }
+
+  /**
+   * @brief 根据比它小的一个LSN，把对 2^32 取模的LSN还原成完整的LSN
+   */
+  static LSN full_lsn(LSN base, uint32_t lsn) { return base + static_cast<uint32_t>(lsn - static_cast<uint32_t>(base)); }
+
+  /// @brief 按照环形缓冲区的方式读写数据，pos 超过缓冲区大小时会绕回
+  void write_at(uint32_t pos, const char *data, uint32_t size);
+  void read_at(uint32_t pos, char *data, uint32_t size) const;
+
 private:
-  mutex           mutex_;  /// 当前数据结构一定会在多线程中访问，所以强制使用有效的锁，而不是有条件生效的common::Mutex
-  deque<LogEntry> entries_;  /// 日志缓冲区
-  atomic<int64_t> bytes_;    /// 当前缓冲区中的日志数据大小
+  vector<char>        buffer_;  /// 环形缓冲区
+  uint32_t            mask_ = 0;  /// 缓冲区大小减一，缓冲区大小总是2的幂
+  vector<atomic<LSN>> slots_;   /// 记录哪些日志已经填充完成，LSN为 lsn 的日志使用第 lsn & slot_mask_ 个槽位
+  uint32_t            slot_mask_ = 0;
 
-  atomic<LSN> current_lsn_{0};
-  atomic<LSN> flushed_lsn_{0};
+  atomic<uint64_t> reserved_{0};       /// 已经预留的最后一条日志的LSN和下一条日志的位置
+  atomic<LSN>      released_lsn_{0};   /// 刷新线程已经写到文件中的最后一条日志，它之前的空间都可以重用
+  atomic<uint32_t> released_pos_{0};   /// released_lsn_ 之后的第一条日志在缓冲区中的位置
 
-  int32_t max_bytes_ = 4 * 1024 * 1024;  /// 缓冲区最大字节数
+  atomic<LSN> flushed_lsn_{0};  /// 已经刷新到磁盘的最后一条日志
 };
@@ -12,31 +12,37 @@ See the Mulan PSL v2 for more details. */
 // Created by wangyunlai on 2024/01/31
 //
 
+#include <stddef.h>
+
 #include "storage/clog/log_entry.h"
 #include "common/log/log.h"
+#include "common/math/crc.h"
 
 ////////////////////////////////////////////////////////////////////////////////
 // struct LogHeader
 
 const int32_t LogHeader::SIZE = sizeof(LogHeader);
 
+CheckSum LogHeader::calc_check_sum(const char *data) const
+{
+  CheckSum crc = crc32(reinterpret_cast<const char *>(this), offsetof(LogHeader, check_sum));
+  return crc32(crc, data, static_cast<unsigned int>(size));
+}
+
 string LogHeader::to_string() const
 {
   stringstream ss;
   ss << "lsn=" << lsn 
      << ", size=" << size 
-     << ", module_id=" << module_id << ":" << LogModule(module_id).name();
+     << ", module_id=" << module_id << ":" << LogModule(module_id).name()
+     << ", check_sum=" << check_sum;
 
   return ss.str();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 // class LogEntry
-LogEntry::LogEntry()
-{
-  header_.lsn = 0;
-  header_.size = 0;
-}
+LogEntry::LogEntry() = default;
 
 LogEntry::LogEntry(LogEntry &&other)
 {
@@ -77,6 +83,7 @@ RC LogEntry::init(LSN lsn, LogModule module, vector<char> &&data)
   header_.lsn = lsn;
   header_.module_id = module.index();
   header_.size = static_cast<int32_t>(data.size());
+  header_.check_sum = header_.calc_check_sum(data.data());
   data_ = std::move(data);
   return RC::SUCCESS;
 }
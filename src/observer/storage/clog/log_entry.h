@@ -24,15 +24,25 @@ See the Mulan PSL v2 for more details. */
 /**
  * @brief 描述一条日志头
  * @ingroup CLog
+ * @details 日志文件是预先分配好空间的，还可能是重用的旧文件，文件尾部可能是0或者旧的日志，
+ * 也可能是写了一半的日志。读取日志时使用校验码和连续的LSN判断日志是否有效。
  */
 struct LogHeader final
 {
-  LSN     lsn;        /// 日志序列号 log sequence number
-  int32_t size;       /// 日志数据大小，不包含日志头
-  int32_t module_id;  /// 日志模块编号
+  LSN      lsn       = 0;  /// 日志序列号 log sequence number
+  int32_t  size      = 0;  /// 日志数据大小，不包含日志头
+  int32_t  module_id = 0;  /// 日志模块编号
+  CheckSum check_sum = 0;  /// 日志头(check_sum之前的部分)和日志数据的校验码
+  int32_t  reserved  = 0;  /// 保留字段，保证日志头中没有未初始化的填充字节
 
   static const int32_t SIZE;  /// 日志头大小
 
+  /**
+   * @brief 计算校验码
+   * @param data 日志数据，长度是 size
+   */
+  CheckSum calc_check_sum(const char *data) const;
+
   string to_string() const;
 };
 
@@ -13,16 +13,24 @@ See the Mulan PSL v2 for more details. */
 //
 
 #include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
+#include "common/lang/algorithm.h"
+#include "common/lang/limits.h"
 #include "common/lang/string_view.h"
 #include "common/lang/charconv.h"
 #include "common/log/log.h"
 #include "storage/clog/log_file.h"
 #include "storage/clog/log_entry.h"
+#include "common/io/async_io.h"
 #include "common/io/io.h"
 
 using namespace common;
 
+/// 使用 O_DIRECT 时写入的位置和大小按这个大小对齐
+static constexpr int64_t LOG_FILE_BLOCK_SIZE = 4096;
+
 RC LogFileReader::open(const char *filename)
 {
   filename_ = filename;
@@ -50,37 +58,36 @@ RC LogFileReader::close()
 
 RC LogFileReader::iterate(function<RC(LogEntry &)> callback, LSN start_lsn /*=0*/)
 {
-  RC rc = skip_to(start_lsn);
-  if (OB_FAIL(rc)) {
-    return rc;
+  if (fd_ < 0) {
+    return RC::FILE_NOT_OPENED;
   }
 
-  LogHeader header;
+  off_t pos = lseek(fd_, 0, SEEK_SET);
+  if (off_t(-1) == pos) {
+    LOG_WARN("seek file failed. seek to the beginning. filename=%s, error=%s", filename_.c_str(), strerror(errno));
+    return RC::IOERR_SEEK;
+  }
+
+  last_lsn_   = 0;
+  end_offset_ = 0;
+
   while (true) {
-    int ret = readn(fd_, reinterpret_cast<char *>(&header), LogHeader::SIZE);
-    if (0 != ret) {
-      if (-1 == ret) {
-        // EOF
-        break;
-      }
-      LOG_WARN("read file failed. filename=%s, ret = %d, error=%s", filename_.c_str(), ret, strerror(errno));
-      return RC::IOERR_READ;
+    LogEntry entry;
+    bool     valid = false;
+    RC       rc    = read_entry(entry, valid);
+    if (OB_FAIL(rc)) {
+      return rc;
     }
-
-    if (header.size < 0 || header.size > LogEntry::max_payload_size()) {
-      LOG_WARN("invalid log entry size. filename=%s, size=%d", filename_.c_str(), header.size);
-      return RC::IOERR_READ;
+    if (!valid) {
+      break;
     }
 
-    vector<char> data(header.size);
-    ret = readn(fd_, data.data(), header.size);
-    if (0 != ret) {
-      LOG_WARN("read file failed. filename=%s, size=%d, ret=%d, error=%s", filename_.c_str(), header.size, ret, strerror(errno));
-      return RC::IOERR_READ;
+    last_lsn_ = entry.lsn();
+    end_offset_ += entry.total_size();
+    if (entry.lsn() < start_lsn) {
+      continue;
     }
 
-    LogEntry entry;
-    entry.init(header.lsn, LogModule(header.module_id), std::move(data));
     rc = callback(entry);
     if (OB_FAIL(rc)) {
       LOG_INFO("iterate log entry failed. entry=%s, rc=%s", entry.to_string().c_str(), strrc(rc));
@@ -92,53 +99,56 @@ RC LogFileReader::iterate(function<RC(LogEntry &)> callback, LSN start_lsn /*=0*
   return RC::SUCCESS;
 }
 
-RC LogFileReader::skip_to(LSN start_lsn)
+RC LogFileReader::read_entry(LogEntry &entry, bool &valid)
 {
-  if (fd_ < 0) {
-    return RC::FILE_NOT_OPENED;
-  }
-
-  off_t pos = lseek(fd_, 0, SEEK_SET);
-  if (off_t(-1) == pos) {
-    LOG_WARN("seek file failed. seek to the beginning. filename=%s, error=%s", filename_.c_str(), strerror(errno));
-    return RC::IOERR_SEEK;
-  }
+  valid = false;
 
   LogHeader header;
-  while (true) {
-    int ret = readn(fd_, reinterpret_cast<char *>(&header), LogHeader::SIZE);
-    if (0 != ret) {
-      if (-1 == ret) {
-        // EOF
-        break;
-      }
-      LOG_WARN("read file failed. filename=%s, ret = %d, error=%s", filename_.c_str(), ret, strerror(errno));
-      return RC::IOERR_READ;
+  int ret = readn(fd_, reinterpret_cast<char *>(&header), LogHeader::SIZE);
+  if (0 != ret) {
+    if (-1 == ret) {
+      // EOF
+      return RC::SUCCESS;
     }
+    LOG_WARN("read file failed. filename=%s, ret = %d, error=%s", filename_.c_str(), ret, strerror(errno));
+    return RC::IOERR_READ;
+  }
 
-    if (header.lsn >= start_lsn) {
-      off_t pos = lseek(fd_, -LogHeader::SIZE, SEEK_CUR);
-      if (off_t(-1) == pos) {
-        LOG_WARN("seek file failed. skip back log header. filename=%s, error=%s", filename_.c_str(), strerror(errno));
-        return RC::IOERR_SEEK;
-      }
-      break;
-    }
+  // 预分配的空间是0，重用的文件中旧日志的LSN比较小，都和前一条日志接不上
+  if (header.lsn <= 0 || (last_lsn_ > 0 && header.lsn != last_lsn_ + 1) ||
+      header.size < 0 || header.size > LogEntry::max_payload_size()) {
+    LOG_TRACE("reach the end of valid log entries. filename=%s, offset=%ld, last_lsn=%ld, header=%s",
+              filename_.c_str(), end_offset_, last_lsn_, header.to_string().c_str());
+    return RC::SUCCESS;
+  }
 
-    if (header.size < 0 || header.size > LogEntry::max_payload_size()) {
-      LOG_WARN("invalid log entry size. filename=%s, size=%d", filename_.c_str(), header.size);
-      return RC::IOERR_READ;
+  vector<char> data(header.size);
+  ret = readn(fd_, data.data(), header.size);
+  if (0 != ret) {
+    if (-1 == ret) {
+      LOG_WARN("log entry is incomplete. filename=%s, offset=%ld, header=%s", 
+               filename_.c_str(), end_offset_, header.to_string().c_str());
+      return RC::SUCCESS;
     }
+    LOG_WARN("read file failed. filename=%s, size=%d, ret=%d, error=%s", filename_.c_str(), header.size, ret, strerror(errno));
+    return RC::IOERR_READ;
+  }
 
-    pos = lseek(fd_, header.size, SEEK_CUR);
-    if (off_t(-1) == pos) {
-      LOG_WARN("seek file failed. skip log entry payload. filename=%s, error=%s", filename_.c_str(), strerror(errno));
-      return RC::IOERR_SEEK;
-    }
+  // 日志只写了一部分时校验码是不对的
+  if (header.check_sum != header.calc_check_sum(data.data())) {
+    LOG_WARN("log entry check sum mismatch. filename=%s, offset=%ld, header=%s", 
+             filename_.c_str(), end_offset_, header.to_string().c_str());
+    return RC::SUCCESS;
   }
 
+  RC rc = entry.init(header.lsn, LogModule(header.module_id), std::move(data));
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+  valid = true;
   return RC::SUCCESS;
 }
+
 ////////////////////////////////////////////////////////////////////////////////
 // LogFileWriter
 LogFileWriter::~LogFileWriter()
@@ -146,25 +156,129 @@ LogFileWriter::~LogFileWriter()
   (void)this->close();
 }
 
-RC LogFileWriter::open(const char *filename, int end_lsn)
+RC LogFileWriter::open(const char *filename, int64_t file_size /*= 0*/, bool direct_io /*= false*/)
 {
   if (fd_ >= 0) {
     return RC::FILE_OPEN;
   }
 
-  filename_ = filename;
-  end_lsn_ = end_lsn;
+  filename_  = filename;
+  file_size_ = file_size;
+  direct_io_ = direct_io;
+  offset_    = 0;
+  last_lsn_  = 0;
+
+  // 从最后一条有效的日志后面开始写。新创建的文件和重用的文件中没有有效的日志
+  if (filesystem::exists(filename_)) {
+    LogFileReader reader;
+    RC rc = reader.open(filename);
+    if (OB_SUCC(rc)) {
+      rc = reader.iterate([](LogEntry &) { return RC::SUCCESS; });
+      reader.close();
+    }
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to find the end of log file. filename=%s, rc=%s", filename, strrc(rc));
+      return rc;
+    }
+    offset_   = reader.end_offset();
+    last_lsn_ = reader.last_lsn();
+  }
 
-  fd_ = ::open(filename, O_WRONLY | O_APPEND | O_CREAT | O_SYNC, 0644);
+  const int flags = O_WRONLY | O_CREAT;
+#ifdef O_DIRECT
+  if (direct_io_) {
+    fd_ = ::open(filename, flags | O_DIRECT, 0644);
+    if (fd_ < 0 && EINVAL == errno) {
+      LOG_WARN("file system does not support O_DIRECT, use buffered io. filename=%s", filename);
+      direct_io_ = false;
+    }
+  }
+#else
+  direct_io_ = false;
+#endif
+  if (fd_ < 0) {
+    fd_ = ::open(filename, flags, 0644);
+  }
   if (fd_ < 0) {
     LOG_WARN("open file failed. filename=%s, error=%s", filename, strerror(errno));
     return RC::FILE_OPEN;
   }
 
-  LOG_INFO("open file success. filename=%s, fd=%d", filename, fd_);
+  preallocate();
+
+  if (direct_io_) {
+    RC rc = load_tail_block();
+    if (OB_FAIL(rc)) {
+      (void)close();
+      return rc;
+    }
+  }
+
+  LOG_INFO("open file success. filename=%s, fd=%d, offset=%ld, last_lsn=%ld, direct_io=%d", 
+           filename, fd_, offset_, last_lsn_, direct_io_);
   return RC::SUCCESS;
 }
 
+void LogFileWriter::preallocate()
+{
+  struct stat st;
+  if (file_size_ <= 0 || fstat(fd_, &st) != 0 || st.st_size >= file_size_) {
+    return;
+  }
+
+#ifdef __linux__
+  // 预先分配空间后，写日志时不需要再修改文件大小，fdatasync 不用同步文件的元数据
+  if (fallocate(fd_, 0, 0, file_size_) != 0) {
+    LOG_WARN("failed to preallocate log file. filename=%s, size=%ld, error=%s", 
+             filename_.c_str(), file_size_, strerror(errno));
+  }
+#endif
+}
+
+RC LogFileWriter::load_tail_block()
+{
+  const int64_t tail_bytes = offset_ % LOG_FILE_BLOCK_SIZE;
+  if (tail_bytes == 0) {
+    return RC::SUCCESS;
+  }
+
+  // fd_ 是只写的，使用普通的方式读取最后一个块中已经写入的数据
+  int fd = ::open(filename_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    LOG_WARN("open file failed. filename=%s, error=%s", filename_.c_str(), strerror(errno));
+    return RC::FILE_OPEN;
+  }
+
+  char         *buffer = direct_buffer(LOG_FILE_BLOCK_SIZE, 0);
+  const ssize_t ret    = ::pread(fd, buffer, tail_bytes, offset_ - tail_bytes);
+  ::close(fd);
+  if (ret != tail_bytes) {
+    LOG_WARN("read the tail block of log file failed. filename=%s, offset=%ld, ret=%ld, error=%s", 
+             filename_.c_str(), offset_, ret, strerror(errno));
+    return RC::IOERR_READ;
+  }
+  return RC::SUCCESS;
+}
+
+char *LogFileWriter::direct_buffer(int64_t size, int64_t keep_bytes)
+{
+  if (size > direct_buffer_capacity_) {
+    const int64_t capacity = max(size, direct_buffer_capacity_ * 2);
+
+    vector<char> buffer(capacity + LOG_FILE_BLOCK_SIZE);
+    const auto   address = reinterpret_cast<uintptr_t>(buffer.data());
+    char *data = buffer.data() + (LOG_FILE_BLOCK_SIZE - address % LOG_FILE_BLOCK_SIZE) % LOG_FILE_BLOCK_SIZE;
+    if (keep_bytes > 0) {
+      memcpy(data, direct_buffer_data_, keep_bytes);
+    }
+
+    direct_buffer_          = std::move(buffer);
+    direct_buffer_data_     = data;
+    direct_buffer_capacity_ = capacity;
+  }
+  return direct_buffer_data_;
+}
+
 RC LogFileWriter::close()
 {
   if (fd_ < 0) {
@@ -178,39 +292,107 @@ RC LogFileWriter::close()
 
 RC LogFileWriter::write(LogEntry &entry)
 {
-  // 一个日志文件写的日志条数是有限制的
-  if (entry.lsn() > end_lsn_) {
-    return RC::LOG_FILE_FULL;
-  }
+  iovec iovs[2] = {
+      {const_cast<LogHeader *>(&entry.header()), static_cast<size_t>(LogHeader::SIZE)},
+      {const_cast<char *>(entry.data()), static_cast<size_t>(entry.payload_size())},
+  };
+  const int iovcnt = entry.payload_size() > 0 ? 2 : 1;
+  return write(iovs, iovcnt, entry.lsn(), entry.lsn());
+}
 
+RC LogFileWriter::write(const iovec *iovs, int iovcnt, LSN first_lsn, LSN last_lsn)
+{
   if (fd_ < 0) {
     return RC::FILE_NOT_OPENED;
   }
 
-  if (entry.lsn() <= last_lsn_) {
-    LOG_WARN("write log entry failed. lsn is too small. filename=%s, last_lsn=%ld, entry=%s", 
-             filename_.c_str(), last_lsn_, entry.to_string().c_str());
+  // 读取日志时遇到不连续的LSN就认为日志结束了，所以同一个文件中的日志必须是连续的
+  if (first_lsn > last_lsn || first_lsn <= last_lsn_ || (last_lsn_ > 0 && first_lsn != last_lsn_ + 1)) {
+    LOG_WARN("write log entries failed. invalid lsn. filename=%s, last_lsn=%ld, first_lsn=%ld, last_lsn=%ld", 
+             filename_.c_str(), this->last_lsn(), first_lsn, last_lsn);
     return RC::INVALID_ARGUMENT;
   }
 
-  /// WARNING 这里需要处理日志写一半的情况
-  /// 日志只写成功一部分到文件中非常难处理
-  int ret = writen(fd_, reinterpret_cast<const char *>(&entry.header()), LogHeader::SIZE);
-  if (0 != ret) {
-    LOG_WARN("write log entry header failed. filename=%s, ret = %d, error=%s, entry=%s", 
-             filename_.c_str(), ret, strerror(errno), entry.to_string().c_str());
-    return RC::IOERR_WRITE;
+  int64_t size = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    size += iovs[i].iov_len;
+  }
+
+  // 空文件总是可以写入，否则比文件还大的日志永远也写不进去
+  if (size > remain_bytes() && offset_ > 0) {
+    return RC::LOG_FILE_FULL;
+  }
+
+  /// WARNING 日志可能只写成功一部分到文件中
+  /// 读取日志时通过校验码发现写了一半的日志，把它当作有效日志的结尾，重新打开文件后会覆盖它
+  if (direct_io_) {
+    RC rc = write_direct(iovs, iovcnt, size);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  } else {
+    AsyncIOBatch batch;
+    batch.add_writev(fd_, iovs, iovcnt, offset_);
+    int ret = AsyncIOEngine::instance().execute(batch);
+    if (0 != ret) {
+      LOG_WARN("write log entries failed. filename=%s, ret = %d, error=%s, first_lsn=%ld, last_lsn=%ld", 
+               filename_.c_str(), ret, strerror(ret), first_lsn, last_lsn);
+      return RC::IOERR_WRITE;
+    }
+  }
+
+  offset_ += size;
+  last_lsn_ = last_lsn;
+  LOG_TRACE("write log entries success. filename=%s, first_lsn=%ld, last_lsn=%ld", filename_.c_str(), first_lsn, last_lsn);
+  return RC::SUCCESS;
+}
+
+RC LogFileWriter::write_direct(const iovec *iovs, int iovcnt, int64_t size)
+{
+  // 从 offset_ 所在的块开始写。这个块中已经写入的数据保存在缓冲区的开头，新的数据接在后面，最后补0对齐到块
+  const int64_t head_bytes   = offset_ % LOG_FILE_BLOCK_SIZE;
+  const int64_t block_offset = offset_ - head_bytes;
+  const int64_t total_bytes  = (head_bytes + size + LOG_FILE_BLOCK_SIZE - 1) / LOG_FILE_BLOCK_SIZE * LOG_FILE_BLOCK_SIZE;
+
+  char *buffer = direct_buffer(total_bytes, head_bytes);
+  char *pos    = buffer + head_bytes;
+  for (int i = 0; i < iovcnt; i++) {
+    memcpy(pos, iovs[i].iov_base, iovs[i].iov_len);
+    pos += iovs[i].iov_len;
   }
+  memset(pos, 0, buffer + total_bytes - pos);
 
-  ret = writen(fd_, entry.data(), entry.payload_size());
+  AsyncIOBatch batch;
+  batch.add_write(fd_, buffer, total_bytes, block_offset);
+  int ret = AsyncIOEngine::instance().execute(batch);
   if (0 != ret) {
-    LOG_WARN("write log entry payload failed. filename=%s, ret = %d, error=%s, entry=%s", 
-             filename_.c_str(), ret, strerror(errno), entry.to_string().c_str());
+    LOG_WARN("write log entries with direct io failed. filename=%s, offset=%ld, size=%ld, ret=%d, error=%s", 
+             filename_.c_str(), block_offset, total_bytes, ret, strerror(ret));
     return RC::IOERR_WRITE;
   }
 
-  last_lsn_ = entry.lsn();
-  LOG_TRACE("write log entry success. filename=%s, entry=%s", filename_.c_str(), entry.to_string().c_str());
+  // 新的最后一个块中已经写入的数据移到缓冲区开头，下次和新的日志一起写
+  const int64_t end        = offset_ + size;
+  const int64_t tail_bytes = end % LOG_FILE_BLOCK_SIZE;
+  if (tail_bytes > 0 && end - tail_bytes > block_offset) {
+    memmove(buffer, buffer + (end - tail_bytes - block_offset), tail_bytes);
+  }
+  return RC::SUCCESS;
+}
+
+RC LogFileWriter::sync()
+{
+  if (fd_ < 0) {
+    return RC::FILE_NOT_OPENED;
+  }
+
+  AsyncIOBatch batch;
+  batch.add_fsync(fd_);
+  int ret = AsyncIOEngine::instance().execute(batch);
+  if (0 != ret) {
+    LOG_WARN("sync log file failed. filename=%s, ret=%d, error=%s", filename_.c_str(), ret, strerror(ret));
+    return RC::IOERR_SYNC;
+  }
   return RC::SUCCESS;
 }
 
@@ -221,7 +403,15 @@ bool LogFileWriter::valid() const
 
 bool LogFileWriter::full() const
 {
-  return last_lsn_ >= end_lsn_;
+  return remain_bytes() < LogHeader::SIZE;
+}
+
+int64_t LogFileWriter::remain_bytes() const
+{
+  if (file_size_ <= 0) {
+    return numeric_limits<int64_t>::max();
+  }
+  return max<int64_t>(file_size_ - offset_, 0);
 }
 
 string LogFileWriter::to_string() const
@@ -232,10 +422,12 @@ string LogFileWriter::to_string() const
 ////////////////////////////////////////////////////////////////////////////////
 // LogFileManager
 
-RC LogFileManager::init(const char *directory, int max_entry_number_per_file)
+RC LogFileManager::init(const char *directory, int64_t file_size, int max_free_files /*= 0*/, bool direct_io /*= false*/)
 {
-  directory_ = filesystem::absolute(filesystem::path(directory));
-  max_entry_number_per_file_ = max_entry_number_per_file;
+  directory_      = filesystem::absolute(filesystem::path(directory));
+  file_size_      = file_size;
+  max_free_files_ = max_free_files;
+  direct_io_      = direct_io;
 
   // 检查目录是否存在，不存在就创建出来
   if (!filesystem::is_directory(directory_)) {
@@ -249,13 +441,25 @@ RC LogFileManager::init(const char *directory, int max_entry_number_per_file)
     }
   }
 
-  // 列出所有的日志文件
+  // 列出所有的日志文件和空闲文件
+  map<int64_t, filesystem::path> free_files;
   for (const filesystem::directory_entry &dir_entry : filesystem::directory_iterator(directory_)) {
     if (!dir_entry.is_regular_file()) {
       continue;
     }
 
     string filename = dir_entry.path().filename().string();
+    if (filename.starts_with(free_file_prefix_) && filename.ends_with(file_suffix_)) {
+      string_view seq_str(filename.data() + strlen(free_file_prefix_), 
+                          filename.length() - strlen(free_file_prefix_) - strlen(file_suffix_));
+      int64_t seq = 0;
+      from_chars_result result = from_chars(seq_str.data(), seq_str.data() + seq_str.size(), seq);
+      if (result.ec == errc()) {
+        free_files.emplace(seq, dir_entry.path());
+      }
+      continue;
+    }
+
     LSN lsn = 0;
     RC rc = get_lsn_from_filename(filename, lsn);
     if (OB_FAIL(rc)) {
@@ -272,8 +476,17 @@ RC LogFileManager::init(const char *directory, int max_entry_number_per_file)
     log_files_.emplace(lsn, dir_entry.path());
   }
 
-  LOG_INFO("init log file manager success. directory=%s, log files=%d", 
-           directory_.c_str(), static_cast<int>(log_files_.size()));
+  // 超过 max_free_files 的空闲文件不会被重用，但是这里不删除，只读取日志的工具也会初始化 LogFileManager
+  for (auto &[seq, file_path] : free_files) {
+    free_file_seq_ = seq;
+    if (static_cast<int>(free_files_.size()) < max_free_files_) {
+      free_files_.emplace_back(file_path);
+    }
+  }
+
+  LOG_INFO("init log file manager success. directory=%s, log files=%d, free files=%d, file size=%ld, direct_io=%d", 
+           directory_.c_str(), static_cast<int>(log_files_.size()), static_cast<int>(free_files_.size()), 
+           file_size_, direct_io_);
   return RC::SUCCESS;
 }
 
@@ -298,42 +511,164 @@ RC LogFileManager::list_files(vector<string> &files, LSN start_lsn)
 {
   files.clear();
 
-  // 这里的代码是AI自动生成的
-  // 其实写的不好，我们只需要找到比start_lsn相等或者小的第一个日志文件就可以了
-  for (auto &file : log_files_) {
-    if (file.first + max_entry_number_per_file_ - 1 >= start_lsn) {
-      files.emplace_back(file.second.string());
-    }
+  lock_guard guard(lock_);
+  // 文件中日志的条数不固定，从第一个LSN不大于start_lsn的最后一个文件开始
+  auto iter = log_files_.upper_bound(start_lsn);
+  if (iter != log_files_.begin()) {
+    --iter;
+  }
+  for (; iter != log_files_.end(); ++iter) {
+    files.emplace_back(iter->second.string());
   }
 
   return RC::SUCCESS;
 }
 
-RC LogFileManager::last_file(LogFileWriter &file_writer)
+RC LogFileManager::last_file(LogFileWriter &file_writer, LSN next_lsn)
 {
-  if (log_files_.empty()) {
-    return next_file(file_writer);
-  }
-
   file_writer.close();
 
-  auto last_file_item = log_files_.rbegin();
-  return file_writer.open(last_file_item->second.c_str(), 
-                          last_file_item->first + max_entry_number_per_file_ - 1);
+  unique_lock guard(lock_);
+  if (!log_files_.empty()) {
+    auto last_file_item = log_files_.rbegin();
+    RC rc = file_writer.open(last_file_item->second.c_str(), file_size_, direct_io_);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    // 文件中还没有日志时，下一条日志应该是文件名中的LSN
+    const LSN expected_lsn = file_writer.last_lsn() > 0 ? file_writer.last_lsn() + 1 : last_file_item->first;
+    if (expected_lsn == next_lsn) {
+      return RC::SUCCESS;
+    }
+
+    LOG_WARN("the last log file does not end before next lsn, create a new one. file=%s, expected lsn=%ld, next lsn=%ld",
+             last_file_item->second.c_str(), expected_lsn, next_lsn);
+    file_writer.close();
+  }
+
+  guard.unlock();
+  return next_file(file_writer, next_lsn);
 }
 
-RC LogFileManager::next_file(LogFileWriter &file_writer)
+RC LogFileManager::next_file(LogFileWriter &file_writer, LSN first_lsn)
 {
   file_writer.close();
 
-  LSN lsn = 0;
-  if (!log_files_.empty()) {
-    lsn = log_files_.rbegin()->first + max_entry_number_per_file_;
+  lock_guard guard(lock_);
+  if (!log_files_.empty() && first_lsn <= log_files_.rbegin()->first) {
+    LOG_WARN("invalid first lsn of next log file. first lsn=%ld, last file=%s", 
+             first_lsn, log_files_.rbegin()->second.c_str());
+    return RC::INVALID_ARGUMENT;
   }
 
-  string filename = file_prefix_ + to_string(lsn) + file_suffix_;
+  string filename = file_prefix_ + to_string(first_lsn) + file_suffix_;
   filesystem::path file_path = directory_ / filename;
-  log_files_.emplace(lsn, file_path);
 
-  return file_writer.open(file_path.c_str(), lsn + max_entry_number_per_file_ - 1);
+  // 重用空闲文件，它的空间已经分配好了
+  while (!free_files_.empty()) {
+    filesystem::path free_file = free_files_.front();
+    free_files_.pop_front();
+
+    error_code ec;
+    filesystem::rename(free_file, file_path, ec);
+    if (!ec) {
+      LOG_INFO("reuse free log file. free file=%s, log file=%s", free_file.c_str(), file_path.c_str());
+      break;
+    }
+    LOG_WARN("failed to rename free log file. free file=%s, log file=%s, error=%s", 
+             free_file.c_str(), file_path.c_str(), ec.message().c_str());
+  }
+
+  RC rc = file_writer.open(file_path.c_str(), file_size_, direct_io_);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+  log_files_.emplace(first_lsn, file_path);
+
+  // 新文件的名字也要持久化，否则崩溃后可能找不到这个文件
+  return sync_directory();
+}
+
+RC LogFileManager::remove_files_before(LSN lsn, int &removed_num)
+{
+  removed_num = 0;
+
+  lock_guard guard(lock_);
+  // 下一个文件的第一个LSN不大于 lsn 时，这个文件中的日志都小于 lsn
+  while (log_files_.size() > 1 && next(log_files_.begin())->first <= lsn) {
+    const filesystem::path &file_path = log_files_.begin()->second;
+
+    if (static_cast<int>(free_files_.size()) < max_free_files_) {
+      RC rc = recycle_file(file_path);
+      if (OB_FAIL(rc)) {
+        return rc;
+      }
+    } else {
+      error_code ec;
+      if (!filesystem::remove(file_path, ec) && ec) {
+        LOG_WARN("failed to remove log file. file=%s, error=%s", file_path.c_str(), ec.message().c_str());
+        return RC::FILE_REMOVE;
+      }
+      LOG_INFO("remove log file before checkpoint. file=%s, checkpoint lsn=%ld", file_path.c_str(), lsn);
+    }
+
+    log_files_.erase(log_files_.begin());
+    removed_num++;
+  }
+
+  if (removed_num > 0) {
+    return sync_directory();
+  }
+  return RC::SUCCESS;
+}
+
+RC LogFileManager::recycle_file(const filesystem::path &file_path)
+{
+  int fd = ::open(file_path.c_str(), O_WRONLY);
+  if (fd < 0) {
+    LOG_WARN("failed to open log file. file=%s, error=%s", file_path.c_str(), strerror(errno));
+    return RC::FILE_OPEN;
+  }
+
+  char zero_block[LOG_FILE_BLOCK_SIZE] = {0};
+  int  ret = writen(fd, zero_block, sizeof(zero_block));
+  if (0 == ret && fdatasync(fd) != 0) {
+    ret = errno;
+  }
+  ::close(fd);
+  if (0 != ret) {
+    LOG_WARN("failed to clear log file. file=%s, error=%s", file_path.c_str(), strerror(ret));
+    return RC::IOERR_WRITE;
+  }
+
+  filesystem::path free_file = directory_ / (free_file_prefix_ + to_string(++free_file_seq_) + file_suffix_);
+
+  error_code ec;
+  filesystem::rename(file_path, free_file, ec);
+  if (ec) {
+    LOG_WARN("failed to rename log file. file=%s, free file=%s, error=%s", 
+             file_path.c_str(), free_file.c_str(), ec.message().c_str());
+    return RC::FILE_NAME;
+  }
+
+  free_files_.emplace_back(free_file);
+  LOG_INFO("recycle log file. file=%s, free file=%s", file_path.c_str(), free_file.c_str());
+  return RC::SUCCESS;
+}
+
+RC LogFileManager::sync_directory()
+{
+  int fd = ::open(directory_.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) {
+    LOG_WARN("failed to open log directory. directory=%s, error=%s", directory_.c_str(), strerror(errno));
+    return RC::IOERR_OPEN;
+  }
+
+  int ret = fsync(fd);
+  if (ret != 0) {
+    LOG_WARN("failed to sync log directory. directory=%s, error=%s", directory_.c_str(), strerror(errno));
+  }
+  ::close(fd);
+  return ret == 0 ? RC::SUCCESS : RC::IOERR_SYNC;
 }
@@ -14,9 +14,14 @@ See the Mulan PSL v2 for more details. */
 
 #pragma once
 
+#include <sys/uio.h>
+
 #include "common/sys/rc.h"
 #include "common/types.h"
 #include "common/lang/map.h"
+#include "common/lang/deque.h"
+#include "common/lang/vector.h"
+#include "common/lang/mutex.h"
 #include "common/lang/functional.h"
 #include "common/lang/filesystem.h"
 #include "common/lang/fstream.h"
@@ -27,7 +32,9 @@ class LogEntry;
 /**
  * @brief 负责处理一个日志文件，包括读取和写入
  * @ingroup CLog
- * @details 日志文件中的日志是按照LSN从小到大排列的
+ * @details 日志文件中的日志是按照LSN从小到大排列的。
+ * 日志文件的空间是预先分配的，也可能是重用的旧文件，所以有效的日志后面可能是0、旧的日志或者写了一半的日志。
+ * 读取时遇到校验码不对或者LSN不连续的日志就认为有效的日志结束了。
  */
 class LogFileReader
 {
@@ -38,24 +45,38 @@ public:
   RC open(const char *filename);
   RC close();
 
+  /**
+   * @brief 从头遍历文件中所有有效的日志，对LSN不小于start_lsn的日志调用callback
+   */
   RC iterate(function<RC(LogEntry &)> callback, LSN start_lsn = 0);
 
+  /// @brief 最后一次遍历时读到的最后一条有效日志的LSN，没有有效日志时是0
+  LSN last_lsn() const { return last_lsn_; }
+  /// @brief 最后一次遍历时有效日志在文件中的结束位置
+  int64_t end_offset() const { return end_offset_; }
+
 private:
   /**
-   * @brief 跳到第一条不小于start_lsn的日志
+   * @brief 读取下一条日志
    *
-   * @param start_lsn 期望开始的第一条日志的LSN
+   * @param[out] entry 读取到的日志
+   * @param[out] valid 是否读到了有效的日志。遇到文件尾或者无效的日志时是false
    */
-  RC skip_to(LSN start_lsn);
+  RC read_entry(LogEntry &entry, bool &valid);
 
 private:
-  int    fd_ = -1;
-  string filename_;
+  int     fd_ = -1;
+  string  filename_;
+  LSN     last_lsn_   = 0;
+  int64_t end_offset_ = 0;
 };
 
 /**
  * @brief 负责写入一个日志文件
  * @ingroup CLog
+ * @details 日志文件按照字节数划分，打开时会预先分配好整个文件的空间，写日志时不需要再修改文件的大小。
+ * 开启 direct_io 时使用 O_DIRECT 写文件，日志不经过 page cache。O_DIRECT 要求写入的位置和长度都按块对齐，
+ * 所以会把文件最后一个没有写满的块保存在内存中，和新的日志一起补齐成完整的块后写入，这个块会被写多次。
  */
 class LogFileWriter
 {
@@ -65,10 +86,12 @@ public:
 
   /**
    * @brief 打开一个日志文件
+   * @details 文件中已经有日志时，从最后一条有效的日志后面继续写
    * @param filename 日志文件名
-   * @param end_lsn 当前日志文件允许的最大LSN（包含）
+   * @param file_size 日志文件的大小，文件小于这个大小时预先分配空间。0 表示不限制大小
+   * @param direct_io 是否使用 O_DIRECT 写文件。文件系统不支持时使用普通的方式写
    */
-  RC open(const char *filename, int end_lsn);
+  RC open(const char *filename, int64_t file_size = 0, bool direct_io = false);
 
   /// @brief 关闭当前文件
   RC close();
@@ -76,32 +99,85 @@ public:
   /// @brief 写入一条日志
   RC write(LogEntry &entry);
 
+  /**
+   * @brief 写入一段连续的日志
+   * @details 数据已经是日志文件中的格式(日志头+数据)，使用一次 writev 写入
+   * @param iovs 日志数据
+   * @param first_lsn 第一条日志的LSN，必须紧跟着上一条写入的日志
+   * @param last_lsn 最后一条日志的LSN
+   * @return 文件剩余的空间放不下这些日志时返回 LOG_FILE_FULL。空文件总是可以写入
+   */
+  RC write(const iovec *iovs, int iovcnt, LSN first_lsn, LSN last_lsn);
+
+  /**
+   * @brief 把写入的日志刷新到磁盘
+   * @details 写日志时不再使用 O_SYNC，写一批日志之后调用一次 sync，多个事务共用一次 fdatasync
+   */
+  RC sync();
+
   /**
    * @brief 当前文件是否已经打开
    */
   bool valid() const;
 
   /**
-   * @brief 文件是否已经写满。当前是按照日志条数来判断的
+   * @brief 文件是否已经写满，剩余的空间连一个日志头都放不下
    */
   bool full() const;
 
+  /**
+   * @brief 文件还可以写入多少字节
+   */
+  int64_t remain_bytes() const;
+
   string to_string() const;
 
   const char *filename() const { return filename_.c_str(); }
 
+  /// @brief 写入的最后一条日志的LSN
+  LSN last_lsn() const { return last_lsn_; }
+  /// @brief 下一条日志写入的位置
+  int64_t offset() const { return offset_; }
+  /// @brief 是否在使用 O_DIRECT 写文件
+  bool direct_io() const { return direct_io_; }
+
 private:
-  string filename_;       /// 日志文件名
-  int    fd_       = -1;  /// 日志文件描述符
-  int    last_lsn_ = 0;   /// 写入的最后一条日志LSN
-  int    end_lsn_  = 0;   /// 当前日志文件中允许写入的最大的LSN，包括这条日志
+  /// @brief 文件小于 file_size_ 时，预先分配文件的空间
+  void preallocate();
+
+  /// @brief 使用 O_DIRECT 时，读取文件最后一个没有写满的块
+  RC load_tail_block();
+
+  /// @brief 使用 O_DIRECT 把数据按块对齐后写入 offset_ 的位置
+  RC write_direct(const iovec *iovs, int iovcnt, int64_t size);
+
+  /**
+   * @brief 获取 O_DIRECT 使用的按块对齐的缓冲区
+   * @param size 至少需要多大的缓冲区
+   * @param keep_bytes 缓冲区扩大时，需要保留原来缓冲区开头的多少字节
+   */
+  char *direct_buffer(int64_t size, int64_t keep_bytes);
+
+private:
+  string  filename_;            /// 日志文件名
+  int     fd_        = -1;      /// 日志文件描述符
+  int64_t offset_    = 0;       /// 下一条日志写入的位置
+  LSN     last_lsn_  = 0;       /// 写入的最后一条日志LSN
+  int64_t file_size_ = 0;       /// 日志文件的大小，0 表示不限制
+  bool    direct_io_ = false;   /// 是否使用 O_DIRECT
+
+  vector<char> direct_buffer_;                   /// O_DIRECT 使用的缓冲区，实际使用其中按块对齐的部分
+  char        *direct_buffer_data_     = nullptr;  /// direct_buffer_ 中按块对齐的开始位置
+  int64_t      direct_buffer_capacity_ = 0;        /// direct_buffer_data_ 可以使用的大小
 };
 
 /**
  * @brief 管理所有的日志文件
  * @ingroup CLog
  * @details 日志文件都在某个目录下，使用固定的前缀加上日志文件的第一个LSN作为文件名。
- * 每个日志文件没有最大字节数要求，但是以固定条数的日志为一个文件，这样方便查找。
+ * 每个日志文件按照字节数划分，写满之后切换到下一个文件，下一个文件的名字是它的第一条日志的LSN。
+ * 检查点之前的日志文件不会直接删除，而是清除开头的日志后重命名为空闲文件，需要新文件时重命名回来重用，
+ * 这样切换文件时不需要创建文件和分配空间。
  */
 class LogFileManager
 {
@@ -113,9 +189,11 @@ public:
    * @brief 初始化
    *
    * @param directory 日志文件目录
-   * @param max_entry_number_per_file 一个文件最多存储多少条日志
+   * @param file_size 一个日志文件的大小
+   * @param max_free_files 最多保留多少个空闲文件用于重用，0 表示不重用文件
+   * @param direct_io 写日志时是否使用 O_DIRECT
    */
-  RC init(const char *directory, int max_entry_number_per_file);
+  RC init(const char *directory, int64_t file_size, int max_free_files = 0, bool direct_io = false);
 
   /**
    * @brief 列出所有的日志文件，第一个日志文件包含大于等于start_lsn最小的日志
@@ -126,16 +204,28 @@ public:
   RC list_files(vector<string> &files, LSN start_lsn);
 
   /**
-   * @brief 获取最新的一个日志文件名
-   * @details 如果当前有文件就获取最后一个日志文件，否则创建一个日志文件，也就是第一个日志文件
+   * @brief 打开最新的一个日志文件
+   * @details 如果当前有文件，并且它的日志与 next_lsn 是连续的，就打开最后一个日志文件，
+   * 否则创建一个新的日志文件
+   * @param next_lsn 下一条要写入的日志的LSN
    */
-  RC last_file(LogFileWriter &file_writer);
+  RC last_file(LogFileWriter &file_writer, LSN next_lsn);
 
   /**
-   * @brief 获取一个新的日志文件名
-   * @details 获取下一个日志文件名。通常是上一个日志文件写满了，通过这个接口生成下一个日志文件
+   * @brief 切换到一个新的日志文件
+   * @details 通常是上一个日志文件写满了，通过这个接口生成下一个日志文件。有空闲文件时重命名一个空闲文件来使用
+   * @param first_lsn 新文件中第一条日志的LSN，也是新文件的名字
    */
-  RC next_file(LogFileWriter &file_writer);
+  RC next_file(LogFileWriter &file_writer, LSN first_lsn);
+
+  /**
+   * @brief 回收只包含小于 lsn 的日志的文件
+   * @details 检查点之前的日志在恢复时已经不需要了。空闲文件不超过 max_free_files 时回收文件用于重用，否则删除。
+   * 最后一个日志文件总是保留
+   * @param lsn 检查点的LSN，恢复时从这条日志开始回放
+   * @param removed_num 回收或删除了多少个文件
+   */
+  RC remove_files_before(LSN lsn, int &removed_num);
 
 private:
   /**
@@ -144,12 +234,27 @@ private:
    */
   static RC get_lsn_from_filename(const string &filename, LSN &lsn);
 
+  /**
+   * @brief 把不再需要的日志文件变成空闲文件
+   * @details 先把文件开头清零并刷盘，保证重用时旧的日志不会被当成有效的日志，再重命名
+   */
+  RC recycle_file(const filesystem::path &file_path);
+
+  /// @brief 创建、重命名或删除文件后，sync 日志目录
+  RC sync_directory();
+
 private:
-  static constexpr const char *file_prefix_ = "clog_";
-  static constexpr const char *file_suffix_ = ".log";
+  static constexpr const char *file_prefix_      = "clog_";
+  static constexpr const char *file_suffix_      = ".log";
+  static constexpr const char *free_file_prefix_ = "free_clog_";
 
-  filesystem::path directory_;                  /// 日志文件存放的目录
-  int              max_entry_number_per_file_;  /// 一个文件最大允许存放多少条日志
+  filesystem::path directory_;               /// 日志文件存放的目录
+  int64_t          file_size_      = 0;      /// 一个日志文件的大小
+  int              max_free_files_ = 0;      /// 最多保留多少个空闲文件
+  bool             direct_io_      = false;  /// 写日志时是否使用 O_DIRECT
 
-  map<LSN, filesystem::path> log_files_;  /// 日志文件名和第一个LSN的映射
+  mutex                      lock_;             /// 保护下面的成员，写日志的线程和做检查点的线程都会访问
+  map<LSN, filesystem::path> log_files_;        /// 日志文件名和第一个LSN的映射
+  deque<filesystem::path>    free_files_;       /// 可以重用的空闲文件
+  int64_t                    free_file_seq_ = 0;  /// 空闲文件名中的序号
 };
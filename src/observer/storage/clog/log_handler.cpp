@@ -21,13 +21,12 @@ See the Mulan PSL v2 for more details. */
 
 RC LogHandler::append(LSN &lsn, LogModule::Id module, span<const char> data)
 {
-  vector<char> data_vec(data.begin(), data.end());
-  return append(lsn, module, std::move(data_vec));
+  return _append(lsn, LogModule(module), data);
 }
 
 RC LogHandler::append(LSN &lsn, LogModule::Id module, vector<char> &&data)
 {
-  return _append(lsn, LogModule(module), std::move(data));
+  return _append(lsn, LogModule(module), span<const char>(data.data(), data.size()));
 }
 
 RC LogHandler::create(const char *name, LogHandler *&log_handler)
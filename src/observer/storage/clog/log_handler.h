@@ -34,7 +34,7 @@ class LogEntry;
  * @ingroup CLog
  * @details 该模块负责日志的写入、读取、回放等功能。
  * 会在后台开启一个线程，一直尝试刷新内存中的日志到磁盘。
- * 所有的CLog日志文件都存放在指定的目录下，每个日志文件按照日志条数来划分。
+ * 所有的CLog日志文件都存放在指定的目录下，每个日志文件按照字节数来划分。
  */
 class LogHandler
 {
@@ -96,12 +96,19 @@ public:
 
   virtual LSN current_lsn() const = 0;
 
+  /**
+   * @brief 清理检查点之前的日志
+   * @details 恢复时从检查点开始回放，之前的日志都不再需要了
+   * @param lsn 检查点的LSN
+   */
+  virtual RC purge(LSN lsn) = 0;
+
   static RC create(const char *name, LogHandler *&handler);
 
 private:
   /**
    * @brief 写入一条日志
-   * @details 子类应该重现实现这个函数
+   * @details 子类应该重现实现这个函数。data 只在调用期间有效，需要时子类自己复制一份
    */
-  virtual RC _append(LSN &lsn, LogModule module, vector<char> &&data) = 0;
+  virtual RC _append(LSN &lsn, LogModule module, span<const char> data) = 0;
 };
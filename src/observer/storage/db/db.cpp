@@ -17,9 +17,14 @@ See the Mulan PSL v2 for more details. */
 #include <fcntl.h>
 #include <sys/stat.h>
 
+#include "common/conf/ini.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/chrono.h"
+#include "common/lang/defer.h"
 #include "common/lang/string.h"
 #include "common/log/log.h"
 #include "common/os/path.h"
+#include "common/thread/thread_util.h"
 #include "common/global_context.h"
 #include "storage/common/meta_util.h"
 #include "storage/table/table.h"
@@ -27,11 +32,22 @@ See the Mulan PSL v2 for more details. */
 #include "storage/trx/trx.h"
 #include "storage/clog/disk_log_handler.h"
 #include "storage/clog/integrated_log_replayer.h"
+#include "storage/buffer/page_cleaner.h"
+#include "storage/buffer/read_ahead.h"
 
 using namespace common;
 
 Db::~Db()
 {
+  // 做检查点会访问 buffer pool、事务和日志
+  stop_checkpoint();
+
+  if (buffer_pool_manager_) {
+    // 后台刷脏页会访问表的文件和日志，要最先停止
+    buffer_pool_manager_->stop_page_cleaner();
+    buffer_pool_manager_->stop_read_ahead();
+  }
+
   for (auto &iter : opened_tables_) {
     delete iter.second;
   }
@@ -83,7 +99,17 @@ RC Db::init(const char *name, const char *dbpath, const char *trx_kit_name, cons
 
   storage_engine_ = storage_engine;
 
-  buffer_pool_manager_ = make_unique<BufferPoolManager>();
+  // 页面淘汰策略可以在配置文件的 [BUFFER_POOL] 中通过 REPLACER 指定
+  BPReplacerType replacer_type = BPReplacerType::TWO_Q;
+  if (get_properties() != nullptr) {
+    string replacer_name = get_properties()->get("REPLACER", "2q", "BUFFER_POOL");
+    if (OB_FAIL(bp_replacer_type_from_name(replacer_name, replacer_type))) {
+      LOG_WARN("invalid buffer pool replacer %s, use 2q instead", replacer_name.c_str());
+      replacer_type = BPReplacerType::TWO_Q;
+    }
+  }
+
+  buffer_pool_manager_ = make_unique<BufferPoolManager>(0 /*memory_size*/, replacer_type);
   auto dblwr_buffer    = make_unique<DiskDoubleWriteBuffer>(*buffer_pool_manager_);
 
   const char      *double_write_buffer_filename  = "dblwr.db";
@@ -147,6 +173,24 @@ RC Db::init(const char *name, const char *dbpath, const char *trx_kit_name, cons
     return rc;
   }
 
+  rc = init_page_cleaner();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to start page cleaner. dbpath=%s, rc=%s", dbpath, strrc(rc));
+    return rc;
+  }
+
+  rc = init_read_ahead();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to start read ahead. dbpath=%s, rc=%s", dbpath, strrc(rc));
+    return rc;
+  }
+
+  rc = init_checkpoint();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to start checkpoint thread. dbpath=%s, rc=%s", dbpath, strrc(rc));
+    return rc;
+  }
+
   return rc;
 }
 
@@ -272,8 +316,8 @@ RC Db::sync()
     return rc;
   }
 
-  check_point_lsn_ = current_lsn;
-  rc               = flush_meta();
+  lock_guard guard(checkpoint_lock_);
+  rc = advance_check_point(current_lsn);
   if (OB_FAIL(rc)) {
     LOG_ERROR("Failed to flush meta. db=%s, rc=%d:%s", name_.c_str(), rc, strrc(rc));
     return rc;
@@ -282,6 +326,67 @@ RC Db::sync()
   return rc;
 }
 
+RC Db::checkpoint()
+{
+  lock_guard guard(checkpoint_lock_);
+
+  // 下一次做检查点时，这之前的日志对应的页帧都已经设置了LSN
+  const LSN current_lsn = log_handler_->current_lsn();
+
+  LSN       lsn       = checkpoint_stable_lsn_ + 1;
+  const LSN frame_lsn = buffer_pool_manager_->min_recovery_lsn();
+  if (frame_lsn > 0) {
+    lsn = min(lsn, frame_lsn);
+  }
+  const LSN trx_lsn = trx_kit_->min_recovery_lsn();
+  if (trx_lsn > 0) {
+    lsn = min(lsn, trx_lsn);
+  }
+  checkpoint_stable_lsn_ = current_lsn;
+
+  if (lsn <= check_point_lsn_) {
+    LOG_DEBUG("checkpoint does not advance. db=%s, checkpoint lsn=%ld, lsn=%ld, frame lsn=%ld, trx lsn=%ld",
+              name_.c_str(), check_point_lsn_, lsn, frame_lsn, trx_lsn);
+    return RC::SUCCESS;
+  }
+
+  // 扫描页帧时已经刷新的页面可能还在 double write buffer 中
+  auto dblwr_buffer = static_cast<DiskDoubleWriteBuffer *>(buffer_pool_manager_->get_dblwr_buffer());
+  RC   rc           = dblwr_buffer->flush_page();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to flush double write buffer. db=%s, rc=%s", name_.c_str(), strrc(rc));
+    return rc;
+  }
+
+  rc = advance_check_point(lsn);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to advance checkpoint. db=%s, lsn=%ld, rc=%s", name_.c_str(), lsn, strrc(rc));
+    return rc;
+  }
+
+  LOG_INFO("checkpoint done. db=%s, checkpoint lsn=%ld, current lsn=%ld, frame lsn=%ld, trx lsn=%ld",
+           name_.c_str(), lsn, current_lsn, frame_lsn, trx_lsn);
+  return rc;
+}
+
+RC Db::advance_check_point(LSN lsn)
+{
+  check_point_lsn_ = max(check_point_lsn_, lsn);
+
+  RC rc = flush_meta();
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  // 删除日志文件失败不影响恢复，下次做检查点时还会再删除
+  RC purge_rc = log_handler_->purge(check_point_lsn_);
+  if (OB_FAIL(purge_rc)) {
+    LOG_WARN("failed to purge log files. db=%s, checkpoint lsn=%ld, rc=%s", 
+             name_.c_str(), check_point_lsn_, strrc(purge_rc));
+  }
+  return rc;
+}
+
 RC Db::recover()
 {
   LOG_TRACE("db recover begin. check_point_lsn=%d", check_point_lsn_);
@@ -292,8 +397,15 @@ RC Db::recover()
     return RC::INTERNAL;
   }
 
-  IntegratedLogReplayer log_replayer(*buffer_pool_manager_, unique_ptr<LogReplayer>(trx_log_replayer));
-  RC                    rc = log_handler_->replay(log_replayer, check_point_lsn_ /*start_lsn*/);
+  // 不同页面的日志可以并行回放，默认在当前线程中逐条回放
+  int replay_threads = 0;
+  if (get_properties() != nullptr) {
+    str_to_val(get_properties()->get("REPLAY_THREADS", "0", "CLOG"), replay_threads);
+  }
+
+  IntegratedLogReplayer log_replayer(
+      *buffer_pool_manager_, unique_ptr<LogReplayer>(trx_log_replayer), replay_threads);
+  RC rc = log_handler_->replay(log_replayer, check_point_lsn_ /*start_lsn*/);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to replay log. rc=%s", strrc(rc));
     return rc;
@@ -373,6 +485,8 @@ RC Db::flush_meta()
     return RC::IOERR_WRITE;
   }
 
+  DEFER(close(fd));
+
   string buffer = to_string(check_point_lsn_);
   int    n      = write(fd, buffer.c_str(), buffer.size());
   if (n < 0) {
@@ -383,6 +497,11 @@ RC Db::flush_meta()
     LOG_ERROR("Failed to write db meta file. db=%s, file=%s, buffer size=%ld, write size=%d", 
               name_.c_str(), temp_meta_file_path.c_str(), buffer.size(), n);
     rc = RC::IOERR_WRITE;
+  } else if (fsync(fd) != 0) {
+    // 检查点之前的日志文件会被删除，所以元数据文件要先落盘
+    LOG_ERROR("Failed to sync db meta file. db=%s, file=%s, errno=%s", 
+              name_.c_str(), temp_meta_file_path.c_str(), strerror(errno));
+    rc = RC::IOERR_SYNC;
   } else {
     error_code ec;
     filesystem::rename(temp_meta_file_path, meta_file_path, ec);
@@ -412,6 +531,85 @@ RC Db::init_dblwr_buffer()
   return RC::SUCCESS;
 }
 
+RC Db::init_page_cleaner()
+{
+  BPPageCleanerOptions options;
+  if (get_properties() != nullptr) {
+    str_to_val(get_properties()->get("PAGE_CLEANER_THREADS", "0", "BUFFER_POOL"), options.thread_num);
+    str_to_val(get_properties()->get("FREE_FRAMES_LOW_WATER", "10", "BUFFER_POOL"), options.low_water_percent);
+    str_to_val(get_properties()->get("FREE_FRAMES_HIGH_WATER", "20", "BUFFER_POOL"), options.high_water_percent);
+  }
+
+  return buffer_pool_manager_->start_page_cleaner(options);
+}
+
+RC Db::init_read_ahead()
+{
+  BPReadAheadOptions options;
+  if (get_properties() != nullptr) {
+    str_to_val(get_properties()->get("READ_AHEAD_PAGES", "0", "BUFFER_POOL"), options.pages);
+  }
+
+  return buffer_pool_manager_->start_read_ahead(options);
+}
+
+RC Db::init_checkpoint()
+{
+  if (get_properties() != nullptr) {
+    str_to_val(get_properties()->get("CHECKPOINT_INTERVAL_SEC", "60", "CLOG"), checkpoint_interval_sec_);
+  }
+
+  // 恢复之后还没有新的日志，当前所有日志对应的页帧都已经设置了LSN
+  checkpoint_stable_lsn_ = log_handler_->current_lsn();
+
+  if (checkpoint_interval_sec_ <= 0) {
+    LOG_INFO("checkpoint thread is disabled. db=%s", name_.c_str());
+    return RC::SUCCESS;
+  }
+
+  checkpoint_running_ = true;
+  checkpoint_thread_  = make_unique<thread>(&Db::checkpoint_thread_func, this);
+  LOG_INFO("checkpoint thread started. db=%s, interval=%ds", name_.c_str(), checkpoint_interval_sec_);
+  return RC::SUCCESS;
+}
+
+void Db::stop_checkpoint()
+{
+  if (!checkpoint_thread_) {
+    return;
+  }
+
+  {
+    lock_guard guard(checkpoint_thread_lock_);
+    checkpoint_running_ = false;
+  }
+  checkpoint_cond_.notify_all();
+
+  checkpoint_thread_->join();
+  checkpoint_thread_.reset();
+  LOG_INFO("checkpoint thread stopped. db=%s", name_.c_str());
+}
+
+void Db::checkpoint_thread_func()
+{
+  thread_set_name("Checkpoint");
+
+  unique_lock guard(checkpoint_thread_lock_);
+  while (checkpoint_running_) {
+    checkpoint_cond_.wait_for(guard, chrono::seconds(checkpoint_interval_sec_), [this]() { return !checkpoint_running_; });
+    if (!checkpoint_running_) {
+      break;
+    }
+
+    guard.unlock();
+    RC rc = checkpoint();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to do checkpoint. db=%s, rc=%s", name_.c_str(), strrc(rc));
+    }
+    guard.lock();
+  }
+}
+
 LogHandler        &Db::log_handler() { return *log_handler_; }
 BufferPoolManager &Db::buffer_pool_manager() { return *buffer_pool_manager_; }
 TrxKit            &Db::trx_kit() { return *trx_kit_; }
@@ -20,6 +20,9 @@ See the Mulan PSL v2 for more details. */
 #include "common/lang/unordered_map.h"
 #include "common/lang/memory.h"
 #include "common/lang/span.h"
+#include "common/lang/mutex.h"
+#include "common/lang/condition_variable.h"
+#include "common/lang/thread.h"
 #include "sql/parser/parse_defs.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/clog/disk_log_handler.h"
@@ -91,6 +94,23 @@ public:
    */
   RC sync();
 
+  /**
+   * @brief 做一次模糊检查点(fuzzy checkpoint)
+   * @details 与 sync 不同，不需要刷新所有的脏页，也不要求没有正在进行的事务。
+   * 恢复时需要从下面几个LSN中最小的一个开始回放：
+   * - 所有脏页中最小的 recovery lsn(参考 Frame::recovery_lsn)，更早的修改都已经在磁盘上了；
+   * - 活跃事务中最小的开始LSN，回滚没有提交的事务需要它们所有的日志；
+   * - 上一次检查点时的最大LSN加一。修改页面的线程先写日志再给页帧设置LSN，扫描页帧时可能还没有设置，
+   *   但是一个检查点周期之前写的日志，对应的页帧肯定已经设置过了。
+   * 把检查点LSN记录到元数据文件之前，先让 double write buffer 中的页面落盘，因为扫描页帧时已经不是脏页的页面
+   * 可能还在 double write buffer 中。检查点之前的日志文件会被删除。
+   * 后台线程按照配置文件 [CLOG] CHECKPOINT_INTERVAL_SEC 定期调用。
+   */
+  RC checkpoint();
+
+  /// @brief 恢复时从这个LSN开始回放日志
+  LSN check_point_lsn() const { return check_point_lsn_; }
+
   /// @brief 获取当前数据库的日志处理器
   LogHandler &log_handler();
 
@@ -118,6 +138,23 @@ private:
   /// @brief 初始化数据库的double buffer pool
   RC init_dblwr_buffer();
 
+  /// @brief 按照配置文件 [BUFFER_POOL] 中的参数启动后台刷脏页
+  RC init_page_cleaner();
+
+  /// @brief 按照配置文件 [BUFFER_POOL] 中的参数启动预读
+  RC init_read_ahead();
+
+  /// @brief 按照配置文件 [CLOG] 中的参数启动定期做检查点的线程
+  RC init_checkpoint();
+  void stop_checkpoint();
+  void checkpoint_thread_func();
+
+  /**
+   * @brief 检查点LSN变大时，记录到元数据文件中并删除不再需要的日志文件
+   * @note 调用者需要持有 checkpoint_lock_
+   */
+  RC advance_check_point(LSN lsn);
+
   StorageEngine get_storage_engine()
   {
     StorageEngine engine = StorageEngine::UNKNOWN_ENGINE;
@@ -147,4 +184,12 @@ private:
 
   LSN    check_point_lsn_ = 0;  ///< 当前数据库的检查点LSN。会记录到磁盘中。
   string storage_engine_;
+
+  mutex              checkpoint_lock_;            ///< sync 和 checkpoint 不能同时修改检查点
+  LSN                checkpoint_stable_lsn_ = 0;  ///< 上一次做检查点时的最大LSN，由 checkpoint_lock_ 保护
+  int                checkpoint_interval_sec_ = 60;  ///< 定期做检查点的间隔，0表示不启动后台线程
+  unique_ptr<thread> checkpoint_thread_;
+  bool               checkpoint_running_ = false;  ///< 后台线程是否还要运行，由 checkpoint_thread_lock_ 保护
+  mutex              checkpoint_thread_lock_;
+  condition_variable checkpoint_cond_;
 };
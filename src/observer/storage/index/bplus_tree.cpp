@@ -14,6 +14,7 @@ See the Mulan PSL v2 for more details. */
 //
 
 #include "storage/index/bplus_tree.h"
+#include "common/lang/algorithm.h"
 #include "common/lang/lower_bound.h"
 #include "common/log/log.h"
 #include "common/global_context.h"
@@ -29,11 +30,24 @@ using namespace common;
  */
 #define FIRST_INDEX_PAGE 1
 
+/**
+ * @brief 乐观查找叶子节点时最多重试的次数，超过之后使用加锁的方式查找
+ */
+#define OPTIMISTIC_READ_RETRY_TIMES 8
+
+/**
+ * @brief 内部节点默认最多有多少个子节点
+ * @details 内部节点的键值是变长存储的，这里只按照槽位的大小限制子节点个数，实际能放多少个子节点由空间决定。
+ * 键值很长时仍然按照最长的键值计算，参考 InternalIndexNodeHandler::limited_by_bytes
+ */
 int calc_internal_page_capacity(int attr_length)
 {
-  int item_size = attr_length + sizeof(RID) + sizeof(PageNum);
-  int capacity  = ((int)BP_PAGE_DATA_SIZE - InternalIndexNode::HEADER_SIZE) / item_size;
-  return capacity;
+  int item_size = sizeof(InternalIndexSlot) + attr_length + sizeof(RID);
+  int space     = (int)BP_PAGE_DATA_SIZE - InternalIndexNode::HEADER_SIZE;
+  if (item_size * 8 > space) {
+    return space / item_size;
+  }
+  return space / static_cast<int>(sizeof(InternalIndexSlot));
 }
 
 int calc_leaf_page_capacity(int attr_length)
@@ -107,6 +121,9 @@ bool IndexNodeHandler::is_safe(BplusTreeOperationType op, bool is_root_node)
       return true;
     } break;
     case BplusTreeOperationType::INSERT: {
+      if (!is_leaf()) {
+        return InternalIndexNodeHandler(mtr_, header_, frame_).is_safe(op);
+      }
       return size() < max_size();
     } break;
     case BplusTreeOperationType::DELETE: {
@@ -118,6 +135,9 @@ bool IndexNodeHandler::is_safe(BplusTreeOperationType op, bool is_root_node)
         // 根节点还有子节点，但是如果删除一个子节点后，只剩一个子节点，就要把自己删除，把唯一的子节点变更为根节点
         return size() > 2;
       }
+      if (!is_leaf()) {
+        return InternalIndexNodeHandler(mtr_, header_, frame_).is_safe(op);
+      }
       return size() > min_size();
     } break;
     default: {
@@ -180,6 +200,23 @@ RC IndexNodeHandler::recover_remove_items(int index, int num)
   return RC::SUCCESS;
 }
 
+span<const char> IndexNodeHandler::node_data() const
+{
+  return span<const char>(frame_->data(), static_cast<size_t>(__item_at(size()) - frame_->data()));
+}
+
+RC IndexNodeHandler::recover_node_data(span<const char> node_data)
+{
+  if (node_data.size() > static_cast<size_t>(BP_PAGE_DATA_SIZE)) {
+    LOG_WARN("invalid node data size. size=%d", static_cast<int>(node_data.size()));
+    return RC::INVALID_ARGUMENT;
+  }
+
+  memcpy(frame_->data(), node_data.data(), node_data.size());
+  frame_->mark_dirty();
+  return RC::SUCCESS;
+}
+
 /////////////////////////////////////////////////////////////////////////////////
 LeafIndexNodeHandler::LeafIndexNodeHandler(BplusTreeMiniTransaction &mtr, const IndexFileHeader &header, Frame *frame)
     : IndexNodeHandler(mtr, header, frame), leaf_node_((LeafIndexNode *)frame->data())
@@ -421,34 +458,169 @@ bool LeafIndexNodeHandler::validate(const KeyComparator &comparator, DiskBufferP
 }
 
 /////////////////////////////////////////////////////////////////////////////////
+/**
+ * @brief 去掉末尾的0之后键值的长度
+ */
+static int stripped_key_length(const char *key, int key_length)
+{
+  while (key_length > 0 && key[key_length - 1] == 0) {
+    key_length--;
+  }
+  return key_length;
+}
+
+static int common_prefix_length(const char *key1, const char *key2, int max_length)
+{
+  int length = 0;
+  while (length < max_length && key1[length] == key2[length]) {
+    length++;
+  }
+  return length;
+}
+
+/**
+ * @brief 计算每个键值存储的长度和公共前缀
+ * @details key(0) 不参与公共前缀的计算。至少有两个键值参与计算时才使用公共前缀，
+ * 这样节点实际占用的空间不会超过逻辑空间
+ */
+static int calc_prefix_length(const char *items, int num, int item_size, int key_length, vector<int> &lengths)
+{
+  lengths.resize(num);
+  int prefix_length = 0;
+  for (int i = 0; i < num; i++) {
+    const char *key = items + static_cast<size_t>(i) * item_size;
+    lengths[i]      = stripped_key_length(key, key_length);
+    if (i == 1) {
+      prefix_length = lengths[i];
+    } else if (i > 1) {
+      prefix_length = common_prefix_length(items + item_size, key, std::min(prefix_length, lengths[i]));
+    }
+  }
+  return num >= 3 ? prefix_length : 0;
+}
+
 InternalIndexNodeHandler::InternalIndexNodeHandler(BplusTreeMiniTransaction &mtr, const IndexFileHeader &header, Frame *frame)
     : IndexNodeHandler(mtr, header, frame), internal_node_((InternalIndexNode *)frame->data())
 {}
 
+bool InternalIndexNodeHandler::limited_by_bytes(const IndexFileHeader &header)
+{
+  const int entry_size = static_cast<int>(sizeof(InternalIndexSlot)) + header.key_length;
+  // 键值太长时一个节点放不下几个子节点，按照空间判断不能保证分裂后的节点都能放得下，仍然按照子节点个数判断
+  return entry_size * 8 <= physical_capacity() && header.internal_max_size * entry_size > physical_capacity();
+}
+
+int InternalIndexNodeHandler::physical_capacity()
+{
+  return static_cast<int>(BP_PAGE_DATA_SIZE) - InternalIndexNode::HEADER_SIZE;
+}
+
+int InternalIndexNodeHandler::logical_capacity(const IndexFileHeader &header)
+{
+  const int entry_size = static_cast<int>(sizeof(InternalIndexSlot)) + header.key_length;
+  return 2 * physical_capacity() - 5 * entry_size;
+}
+
+int InternalIndexNodeHandler::logical_min_size(const IndexFileHeader &header)
+{
+  const int entry_size = static_cast<int>(sizeof(InternalIndexSlot)) + header.key_length;
+  return physical_capacity() / 2 - entry_size;
+}
+
+InternalNodeSpace InternalIndexNodeHandler::measure(const IndexFileHeader &header, const char *items, int num)
+{
+  const int   item_size = header.key_length + static_cast<int>(sizeof(PageNum));
+  vector<int> lengths;
+
+  const int prefix_length = calc_prefix_length(items, num, item_size, header.key_length, lengths);
+
+  InternalNodeSpace space;
+  space.item_num     = num;
+  space.logical_size = num * static_cast<int>(sizeof(InternalIndexSlot));
+  for (int length : lengths) {
+    space.logical_size += length;
+  }
+  space.physical_size = space.logical_size - (num >= 3 ? (num - 2) * prefix_length : 0);
+  return space;
+}
+
+bool InternalIndexNodeHandler::can_hold(const IndexFileHeader &header, const InternalNodeSpace &space)
+{
+  if (space.item_num > header.internal_max_size) {
+    return false;
+  }
+  if (!limited_by_bytes(header)) {
+    return true;
+  }
+  return space.logical_size <= logical_capacity(header) && space.physical_size <= physical_capacity();
+}
+
+void InternalIndexNodeHandler::encode(const IndexFileHeader &header, InternalIndexNode *node, const char *items, int num)
+{
+  const int   key_length = header.key_length;
+  const int   item_size  = key_length + static_cast<int>(sizeof(PageNum));
+  vector<int> lengths;
+
+  const int prefix_length = calc_prefix_length(items, num, item_size, key_length, lengths);
+
+  // 键值区从页面末尾开始向前存放：公共前缀、key(0)、key(1)...
+  InternalIndexSlot *slots     = reinterpret_cast<InternalIndexSlot *>(node->array);
+  int                offset    = physical_capacity() - prefix_length;
+  int                key_bytes = 0;
+  memcpy(node->array + offset, items + item_size, prefix_length);
+  node->prefix_offset = static_cast<uint16_t>(offset);
+
+  for (int i = 0; i < num; i++) {
+    const char *item = items + static_cast<size_t>(i) * item_size;
+    const int   skip = (i == 0) ? 0 : prefix_length;
+
+    InternalIndexSlot slot;
+    slot.key_length = static_cast<uint16_t>(lengths[i] - skip);
+    offset -= slot.key_length;
+    slot.key_offset = static_cast<uint16_t>(offset);
+    memcpy(&slot.page_num, item + key_length, sizeof(PageNum));
+    memcpy(&slots[i], &slot, sizeof(slot));
+
+    memcpy(node->array + offset, item + skip, slot.key_length);
+    key_bytes += slot.key_length;
+  }
+
+  node->key_num       = num;
+  node->prefix_length = static_cast<uint16_t>(prefix_length);
+  node->heap_offset   = static_cast<uint16_t>(offset);
+  node->key_bytes     = static_cast<uint16_t>(key_bytes);
+}
+
 string to_string(const InternalIndexNodeHandler &node, const KeyPrinter &printer)
 {
   stringstream ss;
-  ss << to_string((const IndexNodeHandler &)node);
-  ss << ",children:["
-     << "{key:" << printer(node.__key_at(0)) << ","
-     << "value:" << *(PageNum *)node.__value_at(0) << "}";
+  ss << to_string((const IndexNodeHandler &)node) << "prefix length:" << node.internal_node_->prefix_length
+     << ",heap offset:" << node.internal_node_->heap_offset << ",key bytes:" << node.internal_node_->key_bytes;
+  ss << ",children:[";
 
-  for (int i = 1; i < node.size(); i++) {
-    ss << ",{key:" << printer(node.__key_at(i)) << ",value:" << *(PageNum *)node.__value_at(i) << "}";
+  vector<char> key(node.key_size());
+  for (int i = 0; i < node.size(); i++) {
+    node.copy_key_at(i, key.data());
+    ss << (i == 0 ? "" : ",") << "{key:" << printer(key.data()) << ",value:" << node.value_at(i) << "}";
   }
   ss << "]";
   return ss.str();
 }
 
-RC InternalIndexNodeHandler::init_empty() 
+RC InternalIndexNodeHandler::init_empty()
 {
   RC rc = mtr_.logger().internal_init_empty(*this);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to log init empty internal node. rc=%s", strrc(rc));
   }
   IndexNodeHandler::init_empty(false/*leaf*/);
+  internal_node_->prefix_offset = static_cast<uint16_t>(physical_capacity());
+  internal_node_->prefix_length = 0;
+  internal_node_->heap_offset   = static_cast<uint16_t>(physical_capacity());
+  internal_node_->key_bytes     = 0;
   return RC::SUCCESS;
 }
+
 RC InternalIndexNodeHandler::create_new_root(PageNum first_page_num, const char *key, PageNum page_num)
 {
   RC rc = mtr_.logger().internal_create_new_root(*this, first_page_num, span<const char>(key, key_size()), page_num);
@@ -456,12 +628,12 @@ RC InternalIndexNodeHandler::create_new_root(PageNum first_page_num, const char
     LOG_WARN("failed to log create new root. rc=%s", strrc(rc));
   }
 
-  memset(__key_at(0), 0, key_size());
-  memcpy(__value_at(0), &first_page_num, value_size());
-  memcpy(__item_at(1), key, key_size());
-  memcpy(__value_at(1), &page_num, value_size());
-  increase_size(2);
-  return RC::SUCCESS;
+  // 最左边的键值不会被使用，全部是0，存储时不占用空间
+  vector<char> items(2 * item_size(), 0);
+  memcpy(items.data() + key_size(), &first_page_num, value_size());
+  memcpy(items.data() + item_size(), key, key_size());
+  memcpy(items.data() + item_size() + key_size(), &page_num, value_size());
+  return set_items(items);
 }
 
 /**
@@ -475,6 +647,11 @@ RC InternalIndexNodeHandler::insert(const char *key, PageNum page_num, const Key
 {
   int insert_position = -1;
   lookup(comparator, key, nullptr, &insert_position);
+  if (!can_insert(insert_position, key)) {
+    LOG_ERROR("no enough space to insert key into internal node. page num=%d, size=%d", this->page_num(), size());
+    return RC::INTERNAL;
+  }
+
   vector<char> item(key_size() + sizeof(PageNum));
   memcpy(item.data(), key, key_size());
   memcpy(item.data() + key_size(), &page_num, sizeof(PageNum));
@@ -489,33 +666,57 @@ RC InternalIndexNodeHandler::insert(const char *key, PageNum page_num, const Key
 
 /**
  * @brief move half of the items to the other node ends
+ * @details 按照空间判断节点是否已满时，两边的逻辑空间尽量相等，保证分裂后每个节点都还能再插入一个元素
  */
 RC InternalIndexNodeHandler::move_half_to(InternalIndexNodeHandler &other)
 {
-  const int size       = this->size();
-  const int move_index = size / 2;
-  const int move_num   = size - move_index;
-  RC        rc         = other.append(this->__item_at(move_index), size - move_index);
+  const int size = this->size();
+
+  vector<char> items;
+  get_items(items);
+
+  int move_index = size / 2;
+  if (limited_by_bytes(header_)) {
+    vector<int> prefix_sizes(size + 1, 0);
+    for (int i = 0; i < size; i++) {
+      const char *key     = items.data() + static_cast<size_t>(i) * item_size();
+      prefix_sizes[i + 1] = prefix_sizes[i] + static_cast<int>(sizeof(InternalIndexSlot)) +
+                            stripped_key_length(key, key_size());
+    }
+
+    int best_size = prefix_sizes[size];
+    for (int i = 1; i < size; i++) {
+      const int max_half_size = std::max(prefix_sizes[i], prefix_sizes[size] - prefix_sizes[i]);
+      if (max_half_size < best_size) {
+        best_size  = max_half_size;
+        move_index = i;
+      }
+    }
+  }
+
+  const int move_num = size - move_index;
+  const char *move_items = items.data() + static_cast<size_t>(move_index) * item_size();
+  RC rc = other.append(move_items, move_num);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to copy item to new node. rc=%d:%s", rc, strrc(rc));
     return rc;
   }
 
-  mtr_.logger().node_remove_items(*this, move_index, span<const char>(__item_at(move_index), move_num * item_size()), move_num);
-  increase_size(-(size - move_index));
-  return rc;
+  mtr_.logger().node_remove_items(*this, move_index, span<const char>(move_items, static_cast<size_t>(move_num) * item_size()), move_num);
+  return recover_remove_items(move_index, move_num);
 }
 
 /**
  * lookup the first item which key <= item
  * @return unlike the leafNode, the return value is not the insert position,
  * but only the index of child to find.
+ * @note 乐观读时也会调用这个函数，读取的数据可能是不一致的，copy_key_at 会把所有的偏移都限制在页面范围内
  */
 int InternalIndexNodeHandler::lookup(const KeyComparator &comparator, const char *key, bool *found /* = nullptr */,
     int *insert_position /*= nullptr */) const
 {
-  const int size = this->size();
-  if (size == 0) {
+  const int size = std::min(this->size(), physical_capacity() / static_cast<int>(sizeof(InternalIndexSlot)));
+  if (size <= 0) {
     if (insert_position) {
       *insert_position = 1;
     }
@@ -525,44 +726,118 @@ int InternalIndexNodeHandler::lookup(const KeyComparator &comparator, const char
     return 0;
   }
 
-  common::BinaryIterator<char> iter_begin(item_size(), __key_at(1));
-  common::BinaryIterator<char> iter_end(item_size(), __key_at(size));
-  common::BinaryIterator<char> iter = lower_bound(iter_begin, iter_end, key, comparator, found);
-  int                          ret  = static_cast<int>(iter - iter_begin) + 1;
+  // 大多数键值都比较短，避免每次查找都分配内存
+  char         stack_buffer[128];
+  vector<char> heap_buffer;
+  char        *item_key = stack_buffer;
+  if (key_size() > static_cast<int>(sizeof(stack_buffer))) {
+    heap_buffer.resize(key_size());
+    item_key = heap_buffer.data();
+  }
+
+  // 在 [1, size) 中找到第一个不小于 key 的位置
+  int left  = 1;
+  int right = size;
+  while (left < right) {
+    const int middle = left + (right - left) / 2;
+    copy_key_at(middle, item_key);
+    if (comparator(item_key, key) < 0) {
+      left = middle + 1;
+    } else {
+      right = middle;
+    }
+  }
+
+  int result = 1;  // key 与 left 位置的键值比较的结果
+  if (left < size) {
+    copy_key_at(left, item_key);
+    result = comparator(key, item_key);
+  }
+
+  if (found) {
+    *found = (result == 0);
+  }
   if (insert_position) {
-    *insert_position = ret;
+    *insert_position = left;
   }
 
-  if (ret >= size || comparator(key, __key_at(ret)) < 0) {
-    return ret - 1;
+  if (left >= size || result < 0) {
+    return left - 1;
   }
-  return ret;
+  return left;
 }
 
-char *InternalIndexNodeHandler::key_at(int index)
+const char *InternalIndexNodeHandler::key_at(int index)
 {
   assert(index >= 0 && index < size());
-  return __key_at(index);
+  key_buffer_.resize(key_size());
+  copy_key_at(index, key_buffer_.data());
+  return key_buffer_.data();
+}
+
+void InternalIndexNodeHandler::copy_key_at(int index, char *key) const
+{
+  const int capacity   = physical_capacity();
+  const int slot_num   = capacity / static_cast<int>(sizeof(InternalIndexSlot));
+  const int key_length = key_size();
+
+  InternalIndexSlot slot;
+  memcpy(&slot, &slots()[std::clamp(index, 0, slot_num - 1)], sizeof(slot));
+
+  int prefix_length = 0;
+  if (index > 0) {
+    const int prefix_offset = std::min(static_cast<int>(internal_node_->prefix_offset), capacity);
+    prefix_length           = std::min({static_cast<int>(internal_node_->prefix_length), key_length, capacity - prefix_offset});
+    memcpy(key, internal_node_->array + prefix_offset, prefix_length);
+  }
+
+  const int offset = std::min(static_cast<int>(slot.key_offset), capacity);
+  const int length = std::min({static_cast<int>(slot.key_length), key_length - prefix_length, capacity - offset});
+  memcpy(key + prefix_length, internal_node_->array + offset, length);
+  memset(key + prefix_length + length, 0, key_length - prefix_length - length);
 }
 
-void InternalIndexNodeHandler::set_key_at(int index, const char *key)
+RC InternalIndexNodeHandler::set_key_at(int index, const char *key)
 {
   assert(index >= 0 && index < size());
 
-  mtr_.logger().internal_update_key(*this, index, span<const char>(key, key_size()), span<const char>(__key_at(index), key_size()));
-  memcpy(__key_at(index), key, key_size());
+  vector<char> old_key(key_size());
+  copy_key_at(index, old_key.data());
+  RC rc = mtr_.logger().internal_update_key(
+      *this, index, span<const char>(key, key_size()), span<const char>(old_key.data(), key_size()));
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to log update key. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  if (set_key_in_place(index, key)) {
+    return RC::SUCCESS;
+  }
+
+  vector<char> items;
+  get_items(items);
+  memcpy(items.data() + static_cast<size_t>(index) * item_size(), key, key_size());
+  return set_items(items);
 }
 
-PageNum InternalIndexNodeHandler::value_at(int index)
+PageNum InternalIndexNodeHandler::value_at(int index) const
 {
   assert(index >= 0 && index < size());
-  return *(PageNum *)__value_at(index);
+  return slots()[index].page_num;
 }
 
-int InternalIndexNodeHandler::value_index(PageNum page_num)
+PageNum InternalIndexNodeHandler::optimistic_value_at(int index) const
+{
+  const int slot_num = physical_capacity() / static_cast<int>(sizeof(InternalIndexSlot));
+  PageNum   page_num = BP_INVALID_PAGE_NUM;
+  memcpy(&page_num, &slots()[std::clamp(index, 0, slot_num - 1)].page_num, sizeof(page_num));
+  return page_num;
+}
+
+int InternalIndexNodeHandler::value_index(PageNum page_num) const
 {
   for (int i = 0; i < size(); i++) {
-    if (page_num == *(PageNum *)__value_at(i)) {
+    if (page_num == slots()[i].page_num) {
       return i;
     }
   }
@@ -573,8 +848,12 @@ void InternalIndexNodeHandler::remove(int index)
 {
   assert(index >= 0 && index < size());
 
+  vector<char> item(item_size());
+  copy_key_at(index, item.data());
+  memcpy(item.data() + key_size(), &slots()[index].page_num, sizeof(PageNum));
+
   BplusTreeLogger &logger = mtr_.logger();
-  RC rc = logger.node_remove_items(*this, index, span<const char>(__item_at(index), item_size()), 1);
+  RC rc = logger.node_remove_items(*this, index, span<const char>(item.data(), item.size()), 1);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to log remove item. rc=%s. node=%s", strrc(rc), to_string(*this).c_str());
   }
@@ -584,24 +863,30 @@ void InternalIndexNodeHandler::remove(int index)
 
 RC InternalIndexNodeHandler::move_to(InternalIndexNodeHandler &other)
 {
-  RC rc = other.append(__item_at(0), size());
+  vector<char> items;
+  get_items(items);
+
+  RC rc = other.append(items.data(), size());
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to copy items to other node. rc=%d:%s", rc, strrc(rc));
     return rc;
   }
 
-  rc = mtr_.logger().node_remove_items(*this, 0, span<const char>(__item_at(0), size() * item_size()), size());
+  rc = mtr_.logger().node_remove_items(*this, 0, span<const char>(items.data(), items.size()), size());
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to log shrink internal node. rc=%d:%s", rc, strrc(rc));
     return rc;
   }
-  recover_remove_items(0, size());
-  return RC::SUCCESS;
+  return recover_remove_items(0, size());
 }
 
 RC InternalIndexNodeHandler::move_first_to_end(InternalIndexNodeHandler &other)
 {
-  RC rc = other.append(__item_at(0));
+  vector<char> item(item_size());
+  copy_key_at(0, item.data());
+  memcpy(item.data() + key_size(), &slots()[0].page_num, sizeof(PageNum));
+
+  RC rc = other.append(item.data());
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to append item to others.");
     return rc;
@@ -613,19 +898,23 @@ RC InternalIndexNodeHandler::move_first_to_end(InternalIndexNodeHandler &other)
 
 RC InternalIndexNodeHandler::move_last_to_front(InternalIndexNodeHandler &other)
 {
-  RC rc = other.preappend(__item_at(size() - 1));
+  vector<char> item(item_size());
+  copy_key_at(size() - 1, item.data());
+  memcpy(item.data() + key_size(), &slots()[size() - 1].page_num, sizeof(PageNum));
+
+  const char *last_item = item.data();
+  RC rc = other.preappend(last_item);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to preappend to others");
     return rc;
   }
 
-  rc = mtr_.logger().node_remove_items(*this, size() - 1, span<const char>(__item_at(size() - 1), item_size()), 1);
+  rc = mtr_.logger().node_remove_items(*this, size() - 1, span<const char>(last_item, item_size()), 1);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to log shrink internal node. rc=%d:%s", rc, strrc(rc));
     return rc;
   }
-  increase_size(-1);
-  return rc;
+  return recover_remove_items(size() - 1, 1);
 }
 
 RC InternalIndexNodeHandler::insert_items(int index, const char *items, int num)
@@ -636,7 +925,10 @@ RC InternalIndexNodeHandler::insert_items(int index, const char *items, int num)
     return rc;
   }
 
-  recover_insert_items(index, items, num);
+  rc = recover_insert_items(index, items, num);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
 
   LatchMemo &latch_memo = mtr_.latch_memo();
   PageNum this_page_num = this->page_num();
@@ -645,7 +937,8 @@ RC InternalIndexNodeHandler::insert_items(int index, const char *items, int num)
   // 设置所有页面的父页面为当前页面
   // 这里会访问大量的页面，可能会将他们从磁盘加载到内存中而占用大量的buffer pool页面
   for (int i = 0; i < num; i++) {
-    const PageNum page_num = *(const PageNum *)((items + i * item_size()) + key_size());
+    PageNum page_num = BP_INVALID_PAGE_NUM;
+    memcpy(&page_num, items + static_cast<size_t>(i) * item_size() + key_size(), sizeof(page_num));
     rc = latch_memo.get_page(page_num, frame);
     if (OB_FAIL(rc)) {
       LOG_WARN("failed to set child's page num. child page num:%d, this page num=%d, rc=%d:%s",
@@ -675,7 +968,271 @@ RC InternalIndexNodeHandler::preappend(const char *item)
   return this->insert_items(0, item, 1);
 }
 
-char *InternalIndexNodeHandler::__item_at(int index) const { return internal_node_->array + (index * item_size()); }
+void InternalIndexNodeHandler::get_items(vector<char> &items) const
+{
+  const int size = this->size();
+  items.resize(static_cast<size_t>(size) * item_size());
+  for (int i = 0; i < size; i++) {
+    char         *item     = items.data() + static_cast<size_t>(i) * item_size();
+    const PageNum page_num = slots()[i].page_num;
+    copy_key_at(i, item);
+    memcpy(item + key_size(), &page_num, sizeof(page_num));
+  }
+}
+
+RC InternalIndexNodeHandler::set_items(const vector<char> &items)
+{
+  const int               num   = static_cast<int>(items.size() / item_size());
+  const InternalNodeSpace space = measure(header_, items.data(), num);
+  if (space.physical_size > physical_capacity()) {
+    LOG_ERROR("internal node overflow. page num=%d, item num=%d, physical size=%d, capacity=%d",
+              page_num(), num, space.physical_size, physical_capacity());
+    return RC::INTERNAL;
+  }
+
+  encode(header_, internal_node_, items.data(), num);
+  return RC::SUCCESS;
+}
+
+int InternalIndexNodeHandler::logical_size() const
+{
+  const int size = this->size();
+  return size * static_cast<int>(sizeof(InternalIndexSlot)) + internal_node_->key_bytes +
+         std::max(size - 1, 0) * internal_node_->prefix_length;
+}
+
+int InternalIndexNodeHandler::free_space() const
+{
+  return internal_node_->heap_offset - size() * static_cast<int>(sizeof(InternalIndexSlot));
+}
+
+int InternalIndexNodeHandler::stored_key_length(int index, const char *key, int &skip) const
+{
+  const int length = stripped_key_length(key, key_size());
+  if (index == 0) {
+    skip = 0;
+    return length;
+  }
+
+  skip = internal_node_->prefix_length;
+  if (length < skip || memcmp(key, internal_node_->array + internal_node_->prefix_offset, skip) != 0) {
+    return -1;
+  }
+  return length - skip;
+}
+
+uint16_t InternalIndexNodeHandler::append_heap(const char *data, int length)
+{
+  internal_node_->heap_offset -= static_cast<uint16_t>(length);
+  memcpy(internal_node_->array + internal_node_->heap_offset, data, length);
+  return internal_node_->heap_offset;
+}
+
+bool InternalIndexNodeHandler::insert_in_place(int index, const char *item)
+{
+  int       skip   = 0;
+  const int length = stored_key_length(index, item, skip);
+  if (index == 0 || length < 0 || free_space() < static_cast<int>(sizeof(InternalIndexSlot)) + length) {
+    return false;
+  }
+
+  InternalIndexSlot *slots = this->slots();
+  memmove(&slots[index + 1], &slots[index], static_cast<size_t>(size() - index) * sizeof(InternalIndexSlot));
+
+  InternalIndexSlot slot;
+  slot.key_length = static_cast<uint16_t>(length);
+  slot.key_offset = append_heap(item + skip, length);
+  memcpy(&slot.page_num, item + key_size(), sizeof(PageNum));
+  memcpy(&slots[index], &slot, sizeof(slot));
+
+  internal_node_->key_num++;
+  internal_node_->key_bytes += static_cast<uint16_t>(length);
+  return true;
+}
+
+bool InternalIndexNodeHandler::remove_in_place(int index, int num)
+{
+  const int size = this->size();
+  if (num == size) {
+    internal_node_->key_num       = 0;
+    internal_node_->prefix_offset = static_cast<uint16_t>(physical_capacity());
+    internal_node_->prefix_length = 0;
+    internal_node_->heap_offset   = static_cast<uint16_t>(physical_capacity());
+    internal_node_->key_bytes     = 0;
+    return true;
+  }
+
+  // 删除key0之后，新的key0要完整存储，空间不够时重新编码
+  vector<char> first_key;
+  int          first_length = 0;
+  if (index == 0 && internal_node_->prefix_length > 0) {
+    first_key.resize(key_size());
+    copy_key_at(num, first_key.data());
+    first_length = stripped_key_length(first_key.data(), key_size());
+    if (free_space() + num * static_cast<int>(sizeof(InternalIndexSlot)) < first_length) {
+      return false;
+    }
+  }
+
+  InternalIndexSlot *slots = this->slots();
+  for (int i = index; i < index + num; i++) {
+    internal_node_->key_bytes -= slots[i].key_length;
+  }
+  memmove(&slots[index], &slots[index + num], static_cast<size_t>(size - index - num) * sizeof(InternalIndexSlot));
+  internal_node_->key_num -= num;
+
+  if (!first_key.empty()) {
+    internal_node_->key_bytes = static_cast<uint16_t>(internal_node_->key_bytes + first_length - slots[0].key_length);
+    slots[0].key_length = static_cast<uint16_t>(first_length);
+    slots[0].key_offset = append_heap(first_key.data(), first_length);
+  }
+  return true;
+}
+
+bool InternalIndexNodeHandler::set_key_in_place(int index, const char *key)
+{
+  int       skip   = 0;
+  const int length = stored_key_length(index, key, skip);
+  if (length < 0) {
+    return false;
+  }
+
+  // 新的键值不比原来的长时直接覆盖，否则追加到键值区
+  InternalIndexSlot &slot = slots()[index];
+  if (length <= slot.key_length) {
+    memcpy(internal_node_->array + slot.key_offset, key + skip, length);
+  } else if (length <= free_space()) {
+    slot.key_offset = append_heap(key + skip, length);
+  } else {
+    return false;
+  }
+
+  internal_node_->key_bytes = static_cast<uint16_t>(internal_node_->key_bytes + length - slot.key_length);
+  slot.key_length = static_cast<uint16_t>(length);
+  return true;
+}
+
+RC InternalIndexNodeHandler::recover_insert_items(int index, const char *items, int num)
+{
+  if (num == 1 && insert_in_place(index, items)) {
+    return RC::SUCCESS;
+  }
+
+  vector<char> node_items;
+  get_items(node_items);
+  node_items.insert(node_items.begin() + static_cast<size_t>(index) * item_size(),
+      items, items + static_cast<size_t>(num) * item_size());
+  return set_items(node_items);
+}
+
+RC InternalIndexNodeHandler::recover_remove_items(int index, int num)
+{
+  if (remove_in_place(index, num)) {
+    return RC::SUCCESS;
+  }
+
+  vector<char> node_items;
+  get_items(node_items);
+  auto begin = node_items.begin() + static_cast<size_t>(index) * item_size();
+  node_items.erase(begin, begin + static_cast<size_t>(num) * item_size());
+  return set_items(node_items);
+}
+
+span<const char> InternalIndexNodeHandler::node_data() const
+{
+  // 键值区在页面的末尾，需要整个页面
+  return span<const char>(frame_->data(), BP_PAGE_DATA_SIZE);
+}
+
+bool InternalIndexNodeHandler::can_insert(int index, const char *key) const
+{
+  if (!limited_by_bytes(header_)) {
+    return size() < max_size();
+  }
+
+  if (index > 0) {
+    // 所有的 key(1) 之后的键值都以节点的公共前缀开头，新的键值与它的公共部分可以作为插入后的公共前缀。
+    // 原地插入之后节点的公共前缀可能比真实的短，这里算出来的空间只会偏大，放不下时再取出所有的键值精确计算
+    const int length        = stripped_key_length(key, key_size());
+    const int prefix_length = common_prefix_length(
+        key, internal_node_->array + internal_node_->prefix_offset, std::min<int>(internal_node_->prefix_length, length));
+
+    InternalNodeSpace space;
+    space.item_num      = size() + 1;
+    space.logical_size  = logical_size() + static_cast<int>(sizeof(InternalIndexSlot)) + length;
+    space.physical_size = space.logical_size - (space.item_num >= 3 ? (space.item_num - 2) * prefix_length : 0);
+    if (can_hold(header_, space)) {
+      return true;
+    }
+  }
+
+  vector<char> items;
+  get_items(items);
+  items.insert(items.begin() + static_cast<size_t>(index) * item_size(), key, key + key_size());
+  items.insert(items.begin() + static_cast<size_t>(index) * item_size() + key_size(), sizeof(PageNum), 0);
+  return can_hold(header_, measure(header_, items.data(), size() + 1));
+}
+
+bool InternalIndexNodeHandler::can_remove(int index) const
+{
+  if (!limited_by_bytes(header_) || index > 0) {
+    return true;
+  }
+
+  vector<char> items;
+  get_items(items);
+  items.erase(items.begin(), items.begin() + item_size());
+  return can_hold(header_, measure(header_, items.data(), size() - 1));
+}
+
+bool InternalIndexNodeHandler::can_update_key(int index, const char *key) const
+{
+  if (!limited_by_bytes(header_)) {
+    return true;
+  }
+
+  vector<char> items;
+  get_items(items);
+  memcpy(items.data() + static_cast<size_t>(index) * item_size(), key, key_size());
+  return can_hold(header_, measure(header_, items.data(), size()));
+}
+
+bool InternalIndexNodeHandler::can_merge_with(const InternalIndexNodeHandler &right) const
+{
+  if (!limited_by_bytes(header_)) {
+    return size() + right.size() <= max_size();
+  }
+
+  vector<char> items;
+  vector<char> right_items;
+  get_items(items);
+  right.get_items(right_items);
+  items.insert(items.end(), right_items.begin(), right_items.end());
+  return can_hold(header_, measure(header_, items.data(), size() + right.size()));
+}
+
+bool InternalIndexNodeHandler::is_underflow() const
+{
+  if (!limited_by_bytes(header_)) {
+    return size() < min_size();
+  }
+  return logical_size() < logical_min_size(header_);
+}
+
+bool InternalIndexNodeHandler::is_safe(BplusTreeOperationType op) const
+{
+  if (!limited_by_bytes(header_)) {
+    return op == BplusTreeOperationType::INSERT ? size() < max_size() : size() > min_size();
+  }
+
+  // 不知道将要插入或删除哪个键值，按照最长的键值判断
+  const int entry_size = static_cast<int>(sizeof(InternalIndexSlot)) + key_size();
+  if (op == BplusTreeOperationType::INSERT) {
+    return size() < max_size() &&
+           logical_size() + entry_size <= std::min(logical_capacity(header_), physical_capacity());
+  }
+  return logical_size() - entry_size >= logical_min_size(header_);
+}
 
 int InternalIndexNodeHandler::value_size() const { return sizeof(PageNum); }
 
@@ -689,8 +1246,35 @@ bool InternalIndexNodeHandler::validate(const KeyComparator &comparator, DiskBuf
   }
 
   const int node_size = size();
+  const int capacity  = physical_capacity();
+  if (free_space() < 0 || internal_node_->heap_offset > capacity ||
+      internal_node_->prefix_offset + internal_node_->prefix_length > capacity) {
+    LOG_WARN("page number = %d, invalid heap. heap offset=%d, prefix offset=%d, prefix length=%d",
+        page_num(), internal_node_->heap_offset, internal_node_->prefix_offset, internal_node_->prefix_length);
+    return false;
+  }
+
+  int key_bytes = 0;
+  for (int i = 0; i < node_size; i++) {
+    const InternalIndexSlot &slot = slots()[i];
+    if (slot.key_offset < internal_node_->heap_offset || slot.key_offset + slot.key_length > capacity) {
+      LOG_WARN("page number = %d, invalid key offset. index=%d, offset=%d, length=%d",
+          page_num(), i, slot.key_offset, slot.key_length);
+      return false;
+    }
+    key_bytes += slot.key_length;
+  }
+  if (key_bytes != internal_node_->key_bytes) {
+    LOG_WARN("page number = %d, invalid key bytes. expect=%d, actual=%d", page_num(), key_bytes, internal_node_->key_bytes);
+    return false;
+  }
+
+  vector<char> prev_key(key_size());
+  vector<char> key(key_size());
   for (int i = 2; i < node_size; i++) {
-    if (comparator(__key_at(i - 1), __key_at(i)) >= 0) {
+    copy_key_at(i - 1, prev_key.data());
+    copy_key_at(i, key.data());
+    if (comparator(prev_key.data(), key.data()) >= 0) {
       LOG_WARN("page number = %d, invalid key order. id1=%d,id2=%d, this=%s",
           page_num(), i - 1, i, to_string(*this).c_str());
       return false;
@@ -698,7 +1282,7 @@ bool InternalIndexNodeHandler::validate(const KeyComparator &comparator, DiskBuf
   }
 
   for (int i = 0; result && i < node_size; i++) {
-    PageNum page_num = *(PageNum *)__value_at(i);
+    PageNum page_num = value_at(i);
     if (page_num < 0) {
       LOG_WARN("this page num=%d, got invalid child page. page num=%d", this->page_num(), page_num);
     } else {
@@ -746,7 +1330,8 @@ bool InternalIndexNodeHandler::validate(const KeyComparator &comparator, DiskBuf
   }
 
   if (0 != index_in_parent) {
-    int cmp_result = comparator(__key_at(1), parent_node.key_at(index_in_parent));
+    copy_key_at(1, key.data());
+    int cmp_result = comparator(key.data(), parent_node.key_at(index_in_parent));
     if (cmp_result < 0) {
       LOG_WARN("invalid internal node. the second item should be greate than or equal to parent item. "
                "this page num=%d, parent page num=%d, index in parent=%d",
@@ -757,7 +1342,8 @@ bool InternalIndexNodeHandler::validate(const KeyComparator &comparator, DiskBuf
   }
 
   if (index_in_parent < parent_node.size() - 1) {
-    int cmp_result = comparator(__key_at(size() - 1), parent_node.key_at(index_in_parent + 1));
+    copy_key_at(size() - 1, key.data());
+    int cmp_result = comparator(key.data(), parent_node.key_at(index_in_parent + 1));
     if (cmp_result >= 0) {
       LOG_WARN("invalid internal node. last item should be less than the item at the first after item in parent."
                "this page num=%d, parent page num=%d, parent item to compare=%d",
@@ -870,6 +1456,7 @@ RC BplusTreeHandler::create(LogHandler &log_handler,
   file_header->internal_max_size = internal_max_size;
   file_header->leaf_max_size     = leaf_max_size;
   file_header->root_page         = BP_INVALID_PAGE_NUM;
+  file_header->format_version    = IndexFileHeader::FORMAT_VERSION;
 
   // 取消记录日志的原因请参考下面的sync调用的地方。
   // mtr.logger().init_header_page(header_frame, *file_header);
@@ -877,6 +1464,7 @@ RC BplusTreeHandler::create(LogHandler &log_handler,
   header_frame->mark_dirty();
 
   memcpy(&file_header_, pdata, sizeof(file_header_));
+  root_page_num_.store(file_header_.root_page, std::memory_order_release);
   header_dirty_ = false;
 
   mem_pool_item_ = make_unique<common::MemPoolItem>("b+tree");
@@ -944,6 +1532,14 @@ RC BplusTreeHandler::open(LogHandler &log_handler, DiskBufferPool &buffer_pool)
 
   char *pdata = frame->data();
   memcpy(&file_header_, pdata, sizeof(IndexFileHeader));
+  if (file_header_.format_version != IndexFileHeader::FORMAT_VERSION) {
+    LOG_WARN("unsupported index format version. version=%d, expected=%d",
+             file_header_.format_version, IndexFileHeader::FORMAT_VERSION);
+    buffer_pool.unpin_page(frame);
+    return RC::UNIMPLEMENTED;
+  }
+
+  root_page_num_.store(file_header_.root_page, std::memory_order_release);
   header_dirty_     = false;
   disk_buffer_pool_ = &buffer_pool;
   log_handler_      = &log_handler;
@@ -1183,24 +1779,158 @@ bool BplusTreeHandler::validate_tree()
   return true;
 }
 
+RC BplusTreeHandler::tree_height(int &height)
+{
+  height = 0;
+
+  PageNum page_num = file_header_.root_page;
+  while (page_num != BP_INVALID_PAGE_NUM) {
+    Frame *frame = nullptr;
+    RC     rc    = disk_buffer_pool_->get_this_page(page_num, &frame);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to fetch page. page num=%d, rc=%d:%s", page_num, rc, strrc(rc));
+      return rc;
+    }
+
+    height++;
+
+    BplusTreeMiniTransaction mtr(*this);
+    IndexNodeHandler         node(mtr, file_header_, frame);
+    if (node.is_leaf()) {
+      page_num = BP_INVALID_PAGE_NUM;
+    } else {
+      page_num = InternalIndexNodeHandler(mtr, file_header_, frame).value_at(0);
+    }
+    disk_buffer_pool_->unpin_page(frame);
+  }
+  return RC::SUCCESS;
+}
+
 bool BplusTreeHandler::is_empty() const { return file_header_.root_page == BP_INVALID_PAGE_NUM; }
 
 RC BplusTreeHandler::find_leaf(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op, const char *key, Frame *&frame)
 {
-  auto child_page_getter = [this, key](InternalIndexNodeHandler &internal_node) {
-    return internal_node.value_at(internal_node.lookup(key_comparator_, key));
+  auto child_index_getter = [this, key](InternalIndexNodeHandler &internal_node) {
+    return internal_node.lookup(key_comparator_, key);
   };
-  return find_leaf_internal(mtr, op, child_page_getter, frame);
+  return find_leaf_internal(mtr, op, child_index_getter, frame);
 }
 
 RC BplusTreeHandler::left_most_page(BplusTreeMiniTransaction &mtr, Frame *&frame)
 {
-  auto child_page_getter = [](InternalIndexNodeHandler &internal_node) { return internal_node.value_at(0); };
-  return find_leaf_internal(mtr, BplusTreeOperationType::READ, child_page_getter, frame);
+  auto child_index_getter = [](InternalIndexNodeHandler &) { return 0; };
+  return find_leaf_internal(mtr, BplusTreeOperationType::READ, child_index_getter, frame);
+}
+
+RC BplusTreeHandler::optimistic_find_leaf(BplusTreeMiniTransaction &mtr, const char *key, Frame *&frame, uint64_t &version)
+{
+  auto child_index_getter = [this, key](InternalIndexNodeHandler &internal_node) {
+    return key == nullptr ? 0 : internal_node.lookup(key_comparator_, key);
+  };
+
+  // 冲突时从根节点重试，写操作很多的时候，多次冲突后改用加锁的方式查找，避免一直重试
+  LatchMemo &latch_memo = mtr.latch_memo();
+  const int  memo_point = latch_memo.memo_point();
+  for (int i = 0; i < OPTIMISTIC_READ_RETRY_TIMES; i++) {
+    RC rc = optimistic_find_leaf_once(mtr, child_index_getter, frame, version);
+    if (rc != RC::LOCKED_CONCURRENCY_CONFLICT) {
+      return rc;
+    }
+
+    latch_memo.release_to(memo_point);
+    this_thread::yield();
+  }
+
+  LOG_DEBUG("too many conflicts while finding leaf optimistically, fall back to latch crabbing");
+  RC rc = find_leaf_internal(mtr, BplusTreeOperationType::READ, child_index_getter, frame);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  // 拿着读锁时版本号不会变化。再pin一次叶子节点，然后把查找过程中加的锁都释放掉
+  frame->begin_optimistic_read(version);
+  const int leaf_memo_point = latch_memo.memo_point();
+  rc = latch_memo.get_page(frame->page_num(), frame);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to pin leaf page. page num=%d, rc=%s", frame->page_num(), strrc(rc));
+    return rc;
+  }
+  latch_memo.release_to(leaf_memo_point);
+  return RC::SUCCESS;
+}
+
+RC BplusTreeHandler::optimistic_find_leaf_once(BplusTreeMiniTransaction &mtr,
+    const function<int(InternalIndexNodeHandler &)> &child_index_getter, Frame *&frame, uint64_t &version)
+{
+  LatchMemo &latch_memo = mtr.latch_memo();
+
+  const uint64_t root_version = root_version_.load(std::memory_order_acquire);
+  if (root_version & 1) {
+    return RC::LOCKED_CONCURRENCY_CONFLICT;
+  }
+
+  const PageNum root_page_num = root_page_num_.load(std::memory_order_acquire);
+  if (root_version_.load(std::memory_order_acquire) != root_version) {
+    return RC::LOCKED_CONCURRENCY_CONFLICT;
+  }
+  if (root_page_num == BP_INVALID_PAGE_NUM) {
+    return RC::EMPTY;
+  }
+
+  RC rc = latch_memo.get_page(root_page_num, frame);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to fetch root page. page id=%d, rc=%d:%s", root_page_num, rc, strrc(rc));
+    return rc;
+  }
+
+  // 拿到根节点的版本号后再检查一次根节点是否还是这个页面
+  if (!frame->begin_optimistic_read(version) || root_version_.load(std::memory_order_acquire) != root_version) {
+    return RC::LOCKED_CONCURRENCY_CONFLICT;
+  }
+
+  while (true) {
+    IndexNode *node    = reinterpret_cast<IndexNode *>(frame->data());
+    const bool is_leaf = node->is_leaf;
+    if (!frame->validate_optimistic_read(version)) {
+      return RC::LOCKED_CONCURRENCY_CONFLICT;
+    }
+    if (is_leaf) {
+      return RC::SUCCESS;
+    }
+
+    InternalIndexNodeHandler internal_node(mtr, file_header_, frame);
+    const int                size  = internal_node.size();
+    const int                index = (size > 0 && size <= file_header_.internal_max_size) ? child_index_getter(internal_node) : -1;
+    if (index < 0 || index >= file_header_.internal_max_size) {
+      return RC::LOCKED_CONCURRENCY_CONFLICT;
+    }
+
+    PageNum child_page_num = internal_node.optimistic_value_at(index);
+    if (!frame->validate_optimistic_read(version)) {
+      return RC::LOCKED_CONCURRENCY_CONFLICT;
+    }
+
+    Frame         *parent_frame   = frame;
+    const uint64_t parent_version = version;
+    const int      memo_point     = latch_memo.memo_point();
+
+    rc = latch_memo.get_page(child_page_num, frame);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("Failed to load page page_num:%d. rc=%s", child_page_num, strrc(rc));
+      return rc;
+    }
+
+    // 父节点没有变化，说明拿到子节点版本号的时候，子节点还在树中
+    if (!frame->begin_optimistic_read(version) || !parent_frame->validate_optimistic_read(parent_version)) {
+      return RC::LOCKED_CONCURRENCY_CONFLICT;
+    }
+    latch_memo.release_to(memo_point);
+  }
+  return RC::SUCCESS;
 }
 
 RC BplusTreeHandler::find_leaf_internal(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op,
-    const function<PageNum(InternalIndexNodeHandler &)> &child_page_getter, Frame *&frame)
+    const function<int(InternalIndexNodeHandler &)> &child_index_getter, Frame *&frame)
 {
   LatchMemo &latch_memo = mtr.latch_memo();
 
@@ -1225,7 +1955,7 @@ RC BplusTreeHandler::find_leaf_internal(BplusTreeMiniTransaction &mtr, BplusTree
   PageNum    next_page_id;
   for (; !node->is_leaf;) {
     InternalIndexNodeHandler internal_node(mtr, file_header_, frame);
-    next_page_id = child_page_getter(internal_node);
+    next_page_id = internal_node.value_at(child_index_getter(internal_node));
     rc           = crabing_protocal_fetch_page(mtr, op, next_page_id, false /* is_root_node */, frame);
     if (OB_FAIL(rc)) {
       LOG_WARN("Failed to load page page_num:%d. rc=%s", next_page_id, strrc(rc));
@@ -1294,7 +2024,15 @@ RC BplusTreeHandler::insert_entry_into_leaf_node(BplusTreeMiniTransaction &mtr,
     new_index_node.insert(insert_position - leaf_node.size(), key, (const char *)rid);
   }
 
-  return insert_entry_into_parent(mtr, frame, new_frame, new_index_node.key_at(0));
+  // 父节点中的键值只需要能区分两个子节点，使用尽量短的键值，内部节点就能放下更多的子节点
+  MemPoolItem::item_unique_ptr separator = mem_pool_item_->alloc_unique_ptr();
+  if (nullptr == separator) {
+    LOG_WARN("Failed to alloc memory for key. size=%d", file_header_.key_length);
+    return RC::NOMEM;
+  }
+  key_comparator_.shortest_separator(
+      leaf_node.key_at(leaf_node.size() - 1), new_index_node.key_at(0), static_cast<char *>(separator.get()));
+  return insert_entry_into_parent(mtr, frame, new_frame, static_cast<const char *>(separator.get()));
 }
 
 RC BplusTreeHandler::insert_entry_into_parent(BplusTreeMiniTransaction &mtr, Frame *frame, Frame *new_frame, const char *key)
@@ -1349,8 +2087,14 @@ RC BplusTreeHandler::insert_entry_into_parent(BplusTreeMiniTransaction &mtr, Fra
     InternalIndexNodeHandler parent_node(mtr, file_header_, parent_frame);
 
     /// 当前这个父节点还没有满，直接将新节点数据插进入就行了
-    if (parent_node.size() < parent_node.max_size()) {
-      parent_node.insert(key, new_frame->page_num(), key_comparator_);
+    int insert_position = -1;
+    parent_node.lookup(key_comparator_, key, nullptr, &insert_position);
+    if (parent_node.can_insert(insert_position, key)) {
+      rc = parent_node.insert(key, new_frame->page_num(), key_comparator_);
+      if (OB_FAIL(rc)) {
+        LOG_WARN("failed to insert key into internal node. rc=%d:%s", rc, strrc(rc));
+        return rc;
+      }
       new_node_handler.set_parent_page_num(parent_page_num);
 
       frame->mark_dirty();
@@ -1375,12 +2119,16 @@ RC BplusTreeHandler::insert_entry_into_parent(BplusTreeMiniTransaction &mtr, Fra
         // insert into left or right ? decide by key compare result
         InternalIndexNodeHandler new_node(mtr, file_header_, new_parent_frame);
         if (key_comparator_(key, new_node.key_at(0)) > 0) {
-          new_node.insert(key, new_frame->page_num(), key_comparator_);
+          rc = new_node.insert(key, new_frame->page_num(), key_comparator_);
           new_node_handler.set_parent_page_num(new_node.page_num());
         } else {
-          parent_node.insert(key, new_frame->page_num(), key_comparator_);
+          rc = parent_node.insert(key, new_frame->page_num(), key_comparator_);
           new_node_handler.set_parent_page_num(parent_node.page_num());
         }
+        if (OB_FAIL(rc)) {
+          LOG_WARN("failed to insert key into internal node after split. rc=%d:%s", rc, strrc(rc));
+          return rc;
+        }
 
         // disk_buffer_pool_->unpin_page(frame);
         // disk_buffer_pool_->unpin_page(new_frame);
@@ -1434,6 +2182,7 @@ RC BplusTreeHandler::recover_init_header_page(BplusTreeMiniTransaction &mtr, Fra
   IndexFileHeader *file_header = reinterpret_cast<IndexFileHeader *>(frame->data());
   memcpy(file_header, &header, sizeof(IndexFileHeader));
   file_header_ = header;
+  root_page_num_.store(file_header_.root_page, std::memory_order_release);
   header_dirty_ = false;
   frame->mark_dirty();
 
@@ -1451,7 +2200,10 @@ void BplusTreeHandler::update_root_page_num_locked(BplusTreeMiniTransaction &mtr
   IndexFileHeader *file_header = reinterpret_cast<IndexFileHeader *>(frame->data());
   mtr.logger().update_root_page(frame, root_page_num, file_header->root_page);
   file_header->root_page = root_page_num;
+  root_version_.fetch_add(1, std::memory_order_acq_rel);
   file_header_.root_page = root_page_num;
+  root_page_num_.store(root_page_num, std::memory_order_release);
+  root_version_.fetch_add(1, std::memory_order_release);
   header_dirty_          = true;
   frame->mark_dirty();
   LOG_DEBUG("set root page to %d", root_page_num);
@@ -1613,7 +2365,7 @@ RC BplusTreeHandler::coalesce_or_redistribute(BplusTreeMiniTransaction &mtr, Fra
   LatchMemo &latch_memo = mtr.latch_memo();
 
   IndexNodeHandlerType index_node(mtr, file_header_, frame);
-  if (index_node.size() >= index_node.min_size()) {
+  if (!index_node.is_underflow()) {
     return RC::SUCCESS;
   }
 
@@ -1663,7 +2415,8 @@ RC BplusTreeHandler::coalesce_or_redistribute(BplusTreeMiniTransaction &mtr, Fra
   latch_memo.xlatch(neighbor_frame);
 
   IndexNodeHandlerType neighbor_node(mtr, file_header_, neighbor_frame);
-  if (index_node.size() + neighbor_node.size() > index_node.max_size()) {
+  const bool can_merge = (index == 0) ? index_node.can_merge_with(neighbor_node) : neighbor_node.can_merge_with(index_node);
+  if (!can_merge) {
     rc = redistribute<IndexNodeHandlerType>(mtr, neighbor_frame, frame, parent_frame, index);
   } else {
     rc = coalesce<IndexNodeHandlerType>(mtr, neighbor_frame, frame, parent_frame, index);
@@ -1730,29 +2483,72 @@ RC BplusTreeHandler::coalesce(
   return coalesce_or_redistribute<InternalIndexNodeHandler>(mtr, parent_frame);
 }
 
+/**
+ * @brief 重新分配前计算父节点中新的键值，并检查各个节点的空间是否足够
+ * @details 叶子节点移动一个元素后，使用两边键值之间最短的分隔键值。
+ * @param donor 移出元素的节点
+ * @param move_index 移出的元素在 donor 中的位置，0 或者最后一个
+ * @param[out] separator 父节点中新的键值
+ */
+static bool prepare_redistribute(const KeyComparator &comparator, LeafIndexNodeHandler &donor, int move_index,
+    LeafIndexNodeHandler &receiver, InternalIndexNodeHandler &parent, int parent_index, char *separator)
+{
+  const int boundary = (move_index == 0) ? 1 : move_index;
+  comparator.shortest_separator(donor.key_at(boundary - 1), donor.key_at(boundary), separator);
+  return parent.can_update_key(parent_index, separator);
+}
+
+/**
+ * @brief 内部节点的键值是变长的，移动一个元素后，接收的节点和父节点都可能放不下
+ * @details 左边的节点移出最后一个元素时，父节点中的新键值就是这个元素的键值；
+ * 右边的节点移出第一个元素时，父节点中的新键值是它的第二个键值
+ */
+static bool prepare_redistribute(const KeyComparator &comparator, InternalIndexNodeHandler &donor, int move_index,
+    InternalIndexNodeHandler &receiver, InternalIndexNodeHandler &parent, int parent_index, char *separator)
+{
+  const int receive_index = (move_index == 0) ? receiver.size() : 0;
+  donor.copy_key_at(move_index == 0 ? 1 : move_index, separator);
+  return donor.can_remove(move_index) && receiver.can_insert(receive_index, donor.key_at(move_index)) &&
+         parent.can_update_key(parent_index, separator);
+}
+
 template <typename IndexNodeHandlerType>
 RC BplusTreeHandler::redistribute(BplusTreeMiniTransaction &mtr, Frame *neighbor_frame, Frame *frame, Frame *parent_frame, int index)
 {
   InternalIndexNodeHandler parent_node(mtr, file_header_, parent_frame);
   IndexNodeHandlerType     neighbor_node(mtr, file_header_, neighbor_frame);
   IndexNodeHandlerType     node(mtr, file_header_, frame);
-  if (neighbor_node.size() < node.size()) {
+  if (neighbor_node.is_underflow()) {
     LOG_ERROR("got invalid nodes. neighbor node size %d, this node size %d", neighbor_node.size(), node.size());
   }
+
+  MemPoolItem::item_unique_ptr separator = mem_pool_item_->alloc_unique_ptr();
+  if (nullptr == separator) {
+    LOG_WARN("Failed to alloc memory for key. size=%d", file_header_.key_length);
+    return RC::NOMEM;
+  }
+
+  // 键值是变长的，空间不够时不做调整，当前节点暂时比较空也不影响正确性
+  const int move_index   = (index == 0) ? 0 : neighbor_node.size() - 1;
+  const int parent_index = (index == 0) ? index + 1 : index;
+  char     *separator_key = static_cast<char *>(separator.get());
+  if (!prepare_redistribute(key_comparator_, neighbor_node, move_index, node, parent_node, parent_index, separator_key)) {
+    LOG_TRACE("no enough space to redistribute nodes. page num=%d, neighbor page num=%d",
+              frame->page_num(), neighbor_frame->page_num());
+    return RC::SUCCESS;
+  }
+
   if (index == 0) {
     // the neighbor is at right
     neighbor_node.move_first_to_end(node);
-    // neighbor_node.validate(key_comparator_, disk_buffer_pool_, file_id_);
-    // node.validate(key_comparator_, disk_buffer_pool_, file_id_);
-    parent_node.set_key_at(index + 1, neighbor_node.key_at(0));
-    // parent_node.validate(key_comparator_, disk_buffer_pool_, file_id_);
   } else {
     // the neighbor is at left
     neighbor_node.move_last_to_front(node);
-    // neighbor_node.validate(key_comparator_, disk_buffer_pool_, file_id_);
-    // node.validate(key_comparator_, disk_buffer_pool_, file_id_);
-    parent_node.set_key_at(index, node.key_at(0));
-    // parent_node.validate(key_comparator_, disk_buffer_pool_, file_id_);
+  }
+  RC rc = parent_node.set_key_at(parent_index, separator_key);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to update key in parent node. rc=%d:%s", rc, strrc(rc));
+    return rc;
   }
 
   neighbor_frame->mark_dirty();
@@ -1835,10 +2631,7 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
     return RC::INTERNAL;
   }
 
-  inited_        = true;
-  first_emitted_ = false;
-
-  LatchMemo &latch_memo = mtr_.latch_memo();
+  inited_ = true;
 
   // 校验输入的键值是否是合法范围
   if (left_user_key && right_user_key) {
@@ -1852,18 +2645,7 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
   }
 
   if (nullptr == left_user_key) {
-    rc = tree_handler_.left_most_page(mtr_, current_frame_);
-    if (OB_FAIL(rc)) {
-      if (rc == RC::EMPTY) {
-        current_frame_ = nullptr;
-        return RC::SUCCESS;
-      }
-      
-      LOG_WARN("failed to find left most page. rc=%s", strrc(rc));
-      return rc;
-    }
-
-    iter_index_ = 0;
+    resume_key_ = nullptr;
   } else {
 
     char *fixed_left_key = const_cast<char *>(left_user_key);
@@ -1880,52 +2662,19 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
       }
     }
 
-    MemPoolItem::item_unique_ptr left_pkey;
     if (left_inclusive) {
-      left_pkey = tree_handler_.make_key(fixed_left_key, *RID::min());
+      resume_key_ = tree_handler_.make_key(fixed_left_key, *RID::min());
     } else {
-      left_pkey = tree_handler_.make_key(fixed_left_key, *RID::max());
+      resume_key_ = tree_handler_.make_key(fixed_left_key, *RID::max());
     }
 
-    const char *left_key = (const char *)left_pkey.get();
-
     if (fixed_left_key != left_user_key) {
       delete[] fixed_left_key;
       fixed_left_key = nullptr;
     }
-
-    rc = tree_handler_.find_leaf(mtr_, BplusTreeOperationType::READ, left_key, current_frame_);
-    if (rc == RC::EMPTY) {
-      rc             = RC::SUCCESS;
-      current_frame_ = nullptr;
-      return rc;
-    } else if (OB_FAIL(rc)) {
-      LOG_WARN("failed to find left page. rc=%s", strrc(rc));
-      return rc;
-    }
-
-    LeafIndexNodeHandler left_node(mtr_, tree_handler_.file_header_, current_frame_);
-    int                  left_index = left_node.lookup(tree_handler_.key_comparator_, left_key);
-    // lookup 返回的是适合插入的位置，还需要判断一下是否在合适的边界范围内
-    if (left_index >= left_node.size()) {  // 超出了当前页，就需要向后移动一个位置
-      const PageNum next_page_num = left_node.next_page();
-      if (next_page_num == BP_INVALID_PAGE_NUM) {  // 这里已经是最后一页，说明当前扫描，没有数据
-        latch_memo.release();
-        current_frame_ = nullptr;
-        return RC::SUCCESS;
-      }
-
-      rc = latch_memo.get_page(next_page_num, current_frame_);
-      if (OB_FAIL(rc)) {
-        LOG_WARN("failed to fetch next page. page num=%d, rc=%s", next_page_num, strrc(rc));
-        return rc;
-      }
-      latch_memo.slatch(current_frame_);
-
-      left_index = 0;
-    }
-    iter_index_ = left_index;
   }
+  // 左边界的RID是最小值或最大值，lookup 返回的位置就是第一个需要返回的数据
+  resume_inclusive_ = true;
 
   // 没有指定右边界范围，那么就返回右边界最大值
   if (nullptr == right_user_key) {
@@ -1957,89 +2706,172 @@ RC BplusTreeScanner::open(const char *left_user_key, int left_len, bool left_inc
     }
   }
 
-  if (touch_end()) {
-    current_frame_ = nullptr;
+  rc = seek();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to find the first leaf page. rc=%s", strrc(rc));
   }
+  return rc;
+}
 
+RC BplusTreeScanner::seek()
+{
+  LatchMemo             &latch_memo = mtr_.latch_memo();
+  const IndexFileHeader &header     = tree_handler_.file_header_;
+  while (true) {
+    latch_memo.release();
+    current_frame_ = nullptr;
+
+    RC rc = tree_handler_.optimistic_find_leaf(
+        mtr_, static_cast<const char *>(resume_key_.get()), current_frame_, current_version_);
+    if (rc == RC::EMPTY) {
+      current_frame_ = nullptr;
+      return RC::SUCCESS;
+    } else if (OB_FAIL(rc)) {
+      current_frame_ = nullptr;
+      return rc;
+    }
+
+    if (resume_key_ == nullptr) {
+      iter_index_ = 0;
+      return RC::SUCCESS;
+    }
+
+    LeafIndexNodeHandler leaf_node(mtr_, header, current_frame_);
+    const int            size  = leaf_node.size();
+    bool                 found = false;
+    int                  index = 0;
+    if (size >= 0 && size <= header.leaf_max_size) {
+      index = leaf_node.lookup(tree_handler_.key_comparator_, static_cast<const char *>(resume_key_.get()), &found);
+    }
+    if (!current_frame_->validate_optimistic_read(current_version_)) {
+      this_thread::yield();
+      continue;
+    }
+
+    // lookup 返回的是适合插入的位置，超出当前页时 fetch_item 会移动到下一个页面
+    iter_index_ = (found && !resume_inclusive_) ? index + 1 : index;
+    return RC::SUCCESS;
+  }
   return RC::SUCCESS;
 }
 
-void BplusTreeScanner::fetch_item(RID &rid)
+RC BplusTreeScanner::fetch_item(RID &rid)
 {
-  LeafIndexNodeHandler node(mtr_, tree_handler_.file_header_, current_frame_);
-  memcpy(&rid, node.value_at(iter_index_), sizeof(rid));
+  const IndexFileHeader &header = tree_handler_.file_header_;
+  while (current_frame_ != nullptr) {
+    LeafIndexNodeHandler leaf_node(mtr_, header, current_frame_);
+    const int            size = leaf_node.size();
+    if (iter_index_ < size && iter_index_ < header.leaf_max_size) {
+      if (key_buffer_ == nullptr) {
+        key_buffer_ = tree_handler_.mem_pool_item_->alloc_unique_ptr();
+        if (key_buffer_ == nullptr) {
+          LOG_WARN("failed to alloc memory for key");
+          return RC::NOMEM;
+        }
+      }
+
+      memcpy(key_buffer_.get(), leaf_node.optimistic_key_at(iter_index_), header.key_length);
+      memcpy(&rid, leaf_node.optimistic_value_at(iter_index_), sizeof(rid));
+      if (!current_frame_->validate_optimistic_read(current_version_)) {
+        return RC::LOCKED_CONCURRENCY_CONFLICT;
+      }
+
+      if (touch_end(static_cast<const char *>(key_buffer_.get()))) {
+        mtr_.latch_memo().release();
+        current_frame_ = nullptr;
+        return RC::RECORD_EOF;
+      }
+
+      // 记住最后返回的数据，冲突时从它后面重新开始扫描
+      resume_key_.swap(key_buffer_);
+      resume_inclusive_ = false;
+      iter_index_++;
+      return RC::SUCCESS;
+    }
+
+    RC rc = move_to_next_page();
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+  return RC::RECORD_EOF;
 }
 
-bool BplusTreeScanner::touch_end()
+bool BplusTreeScanner::touch_end(const char *key) const
 {
   if (right_key_ == nullptr) {
     return false;
   }
 
-  LeafIndexNodeHandler node(mtr_, tree_handler_.file_header_, current_frame_);
-
-  const char *this_key       = node.key_at(iter_index_);
-  int         compare_result = tree_handler_.key_comparator_(this_key, static_cast<char *>(right_key_.get()));
+  int compare_result = tree_handler_.key_comparator_(key, static_cast<char *>(right_key_.get()));
   return compare_result > 0;
 }
 
-RC BplusTreeScanner::next_entry(RID &rid)
+RC BplusTreeScanner::move_to_next_page()
 {
-  if (nullptr == current_frame_) {
-    return RC::RECORD_EOF;
-  }
-
-  if (!first_emitted_) {
-    fetch_item(rid);
-    first_emitted_ = true;
-    return RC::SUCCESS;
-  }
-
-  iter_index_++;
-
-  LeafIndexNodeHandler node(mtr_, tree_handler_.file_header_, current_frame_);
-  if (iter_index_ < node.size()) {
-    if (touch_end()) {
-      return RC::RECORD_EOF;
-    }
+  LatchMemo &latch_memo = mtr_.latch_memo();
 
-    fetch_item(rid);
-    return RC::SUCCESS;
+  LeafIndexNodeHandler leaf_node(mtr_, tree_handler_.file_header_, current_frame_);
+  const PageNum        next_page_num = leaf_node.next_page();
+  if (!current_frame_->validate_optimistic_read(current_version_)) {
+    return RC::LOCKED_CONCURRENCY_CONFLICT;
   }
 
-  RC      rc            = RC::SUCCESS;
-  PageNum next_page_num = node.next_page();
   if (BP_INVALID_PAGE_NUM == next_page_num) {
-    return RC::RECORD_EOF;
+    latch_memo.release();
+    current_frame_ = nullptr;
+    return RC::SUCCESS;
   }
 
-  LatchMemo &latch_memo = mtr_.latch_memo();
-
   const int memo_point = latch_memo.memo_point();
-  rc                   = latch_memo.get_page(next_page_num, current_frame_);
+  Frame    *next_frame = nullptr;
+  RC        rc         = latch_memo.get_page(next_page_num, next_frame, BPAccessHint::SCAN);
   if (OB_FAIL(rc)) {
     LOG_WARN("failed to get next page. page num=%d, rc=%s", next_page_num, strrc(rc));
     return rc;
   }
 
   /**
-   * 如果这里直接去加锁，那可能会造成死锁
-   * 因为这里访问页面的方式顺序与插入、删除的顺序不一样
-   * 如果加锁失败，就由上层做重试
+   * 与查找叶子节点一样，拿到下一个页面的版本号之后再检查当前页面，当前页面没有变化说明下一个页面还是它的兄弟节点。
+   * 这里不加锁，所以不会与插入、删除时加锁的顺序冲突，也不需要由上层重试
    */
-  bool locked = latch_memo.try_slatch(current_frame_);
-  if (!locked) {
-    return RC::LOCKED_NEED_WAIT;
+  uint64_t next_version = 0;
+  if (!next_frame->begin_optimistic_read(next_version) ||
+      !current_frame_->validate_optimistic_read(current_version_)) {
+    return RC::LOCKED_CONCURRENCY_CONFLICT;
   }
 
   latch_memo.release_to(memo_point);
-  iter_index_ = -1;  // `next` will add 1
-  return next_entry(rid);
+  current_frame_   = next_frame;
+  current_version_ = next_version;
+  iter_index_      = 0;
+  return RC::SUCCESS;
+}
+
+RC BplusTreeScanner::next_entry(RID &rid)
+{
+  while (current_frame_ != nullptr) {
+    RC rc = fetch_item(rid);
+    if (rc != RC::LOCKED_CONCURRENCY_CONFLICT) {
+      return rc;
+    }
+
+    // 读的过程中页面被修改了，从最后返回的数据开始重新查找
+    this_thread::yield();
+    rc = seek();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to seek after conflict. rc=%s", strrc(rc));
+      return rc;
+    }
+  }
+  return RC::RECORD_EOF;
 }
 
 RC BplusTreeScanner::close()
 {
-  inited_ = false;
+  inited_        = false;
+  current_frame_ = nullptr;
+  mtr_.latch_memo().release();
   LOG_TRACE("bplus tree scanner closed");
   return RC::SUCCESS;
 }
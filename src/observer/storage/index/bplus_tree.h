@@ -23,6 +23,7 @@ See the Mulan PSL v2 for more details. */
 #include "common/lang/memory.h"
 #include "common/lang/sstream.h"
 #include "common/lang/functional.h"
+#include "common/lang/vector.h"
 #include "common/log/log.h"
 #include "sql/parser/parse_defs.h"
 #include "storage/buffer/disk_buffer_pool.h"
@@ -105,6 +106,31 @@ public:
     return RID::compare(rid1, rid2);
   }
 
+  /**
+   * @brief 找一个尽量短的分隔键值，满足 left < separator <= right
+   * @details 内部节点中的键值只用来区分左右两个子节点，不需要是一个真实存在的键值(suffix truncation)。
+   * 这里依次尝试 right 的前缀，剩下的部分填0，使用第一个满足条件的前缀。内部节点存储键值时会去掉末尾的0，
+   * 分隔键值越短，内部节点能放下的子节点就越多。
+   * 只依赖比较函数本身，所以对任意类型都是正确的，只是有些类型(比如小端存储的整数)能截掉的部分比较少。
+   * @param left 左边节点中最大的键值
+   * @param right 右边节点中最小的键值
+   * @param[out] separator 与键值的长度相同
+   */
+  void shortest_separator(const char *left, const char *right, char *separator) const
+  {
+    const int key_length = attr_comparator_.attr_length() + static_cast<int>(sizeof(RID));
+    memset(separator, 0, key_length);
+    for (int length = 0; length < key_length; length++) {
+      if (length > 0) {
+        separator[length - 1] = right[length - 1];
+      }
+      if ((*this)(left, separator) < 0 && (*this)(separator, right) <= 0) {
+        return;
+      }
+    }
+    memcpy(separator, right, key_length);
+  }
+
 private:
   AttrComparator attr_comparator_;
 };
@@ -173,12 +199,17 @@ struct IndexFileHeader
     memset(this, 0, sizeof(IndexFileHeader));
     root_page = BP_INVALID_PAGE_NUM;
   }
+
+  /// 当前的页面格式版本。版本1：内部节点使用可以原地修改的槽位格式，参考 InternalIndexNode
+  static constexpr int32_t FORMAT_VERSION = 1;
+
   PageNum  root_page;          ///< 根节点在磁盘中的页号
   int32_t  internal_max_size;  ///< 内部节点最大的键值对数
   int32_t  leaf_max_size;      ///< 叶子节点最大的键值对数
   int32_t  attr_length;        ///< 键值的长度
   int32_t  key_length;         ///< attr length + sizeof(RID)
   AttrType attr_type;          ///< 键值的类型
+  int32_t  format_version;     ///< 页面格式的版本，之前版本创建的索引文件中是0
 
   const string to_string() const
   {
@@ -189,7 +220,8 @@ struct IndexFileHeader
        << "attr_type:" << attr_type_to_string(attr_type) << ","
        << "root_page:" << root_page << ","
        << "internal_max_size:" << internal_max_size << ","
-       << "leaf_max_size:" << leaf_max_size << ";";
+       << "leaf_max_size:" << leaf_max_size << ","
+       << "format_version:" << format_version << ";";
 
     return ss.str();
   }
@@ -236,27 +268,58 @@ struct LeafIndexNode : public IndexNode
   char array[0];
 };
 
+/**
+ * @brief 内部节点中一个子节点的槽位
+ * @ingroup BPlusTree
+ */
+struct InternalIndexSlot
+{
+  uint16_t key_offset;  ///< 键值在 InternalIndexNode::array 中的偏移，位于键值区中
+  uint16_t key_length;  ///< 存储的键值长度，去掉了公共前缀和末尾的0
+  PageNum  page_num;    ///< 子节点的页号
+};
+
 /**
  * @brief internal page of bplus tree
  * @ingroup BPlusTree
  * @code
  * storage format:
- * | common header |
- * | key(0),page_id(0) | key(1), page_id(1) | ... | key(n), page_id(n) |
+ * | common header | prefix offset | prefix length | heap offset | key bytes |
+ * | slot(0) | slot(1) | ... | slot(n) | free space | key(n) | ... | key(1) | key(0) | prefix |
  * @endcode
- * the first key is ignored(key0).
- * so it will waste space, can you fix this?
+ * 槽位从前向后存放，键值区(公共前缀和键值)从页面末尾向前增长，槽位按照键值的顺序排列。
+ * 上面是刚编码完的样子，原地修改之后键值区中的键值就不再有序了。
+ * 键值是变长存储的：
+ * - 存储时去掉键值末尾的0，读取时再补上。分裂叶子节点时会选择尽量短的分隔键值，所以末尾通常有很多0；
+ * - key(1)到key(n)都以公共前缀开头，公共前缀只存储一次，每个键值只存储剩下的部分；
+ * - key(0)在查找时不会使用(最左边节点的key0全是0)，完整存储，不参与公共前缀的计算。
+ * 插入、删除和修改一个键值时原地修改：移动槽位，新的键值追加到键值区。删除或修改后键值区中会留下无用的数据，
+ * 空间不够或者新的键值不以公共前缀开头时，才会重新编码整个节点，同时重新计算公共前缀。
+ * 这个格式记录在 IndexFileHeader::format_version 中。日志中记录的仍然是完整的键值，与页面的存储格式无关。
  */
 struct InternalIndexNode : public IndexNode
 {
-  static constexpr int HEADER_SIZE = IndexNode::HEADER_SIZE;
+  static constexpr int HEADER_SIZE = IndexNode::HEADER_SIZE + 8;
+
+  uint16_t prefix_offset;  ///< 公共前缀在 array 中的偏移
+  uint16_t prefix_length;  ///< 公共前缀的长度
+  uint16_t heap_offset;    ///< 键值区的起始偏移，键值区一直到 array 的末尾
+  uint16_t key_bytes;      ///< 所有槽位指向的键值的长度之和，不包括公共前缀和键值区中无用的数据
 
-  /**
-   * internal node just store order -1 keys and order rids, the last rid is last right child.
-   */
   char array[0];
 };
 
+/**
+ * @brief 内部节点的空间使用情况
+ * @ingroup BPlusTree
+ */
+struct InternalNodeSpace
+{
+  int item_num      = 0;  ///< 子节点个数
+  int logical_size  = 0;  ///< 不考虑公共前缀时需要的空间，即槽位加上去掉末尾0之后的键值
+  int physical_size = 0;  ///< 按照紧凑格式实际占用的空间，不会超过 logical_size
+};
+
 /**
  * @brief IndexNode 仅作为数据在内存或磁盘中的表示
  * @ingroup BPlusTree
@@ -308,8 +371,23 @@ public:
 
   friend string to_string(const IndexNodeHandler &handler);
 
-  RC recover_insert_items(int index, const char *items, int num);
-  RC recover_remove_items(int index, int num);
+  /**
+   * @brief 在指定位置插入或删除元素，不记录日志
+   * @details items 是连续存放的完整元素(键值+值)，与日志中记录的格式相同
+   * @note 需要使用 LeafIndexNodeHandler 或 InternalIndexNodeHandler 调用
+   */
+  virtual RC recover_insert_items(int index, const char *items, int num);
+  virtual RC recover_remove_items(int index, int num);
+
+  /**
+   * @brief 节点头和已经使用的元素，不包含页面中剩余的空间
+   * @note 需要使用 LeafIndexNodeHandler 或 InternalIndexNodeHandler 调用
+   */
+  virtual span<const char> node_data() const;
+  /**
+   * @brief 使用日志中记录的节点数据恢复整个节点
+   */
+  RC recover_node_data(span<const char> node_data);
 
 protected:
   /**
@@ -345,6 +423,19 @@ public:
   char *key_at(int index);
   char *value_at(int index);
 
+  /**
+   * @brief 乐观读使用的访问接口，不检查 index 是否小于 size()
+   * @details 乐观读不加锁，读的过程中其它线程可能正在修改这个节点，size() 随时会变化。
+   * 调用者需要保证 index 小于 max_size()，并且在使用读到的数据之前检查页面的版本
+   */
+  const char *optimistic_key_at(int index) const { return __key_at(index); }
+  const char *optimistic_value_at(int index) const { return __value_at(index); }
+
+  /// @brief 删除元素后是否需要与相邻节点合并或者重新分配
+  bool is_underflow() const { return size() < min_size(); }
+  /// @brief 当前节点(左边)与右边的节点能否合并成一个节点
+  bool can_merge_with(const LeafIndexNodeHandler &right) const { return size() + right.size() <= max_size(); }
+
   /**
    * 查找指定key的插入位置(注意不是key本身)
    * 如果key已经存在，会设置found的值。
@@ -390,17 +481,58 @@ public:
   RC init_empty();
   RC create_new_root(PageNum first_page_num, const char *key, PageNum page_num);
 
-  RC      insert(const char *key, PageNum page_num, const KeyComparator &comparator);
-  char   *key_at(int index);
-  PageNum value_at(int index);
+  /**
+   * @brief 插入一个键值
+   * @details 调用前需要使用 can_insert 检查空间是否足够，空间不够时返回 RC::INTERNAL
+   */
+  RC insert(const char *key, PageNum page_num, const KeyComparator &comparator);
+
+  /**
+   * @brief 返回指定位置的完整键值
+   * @details 节点中存储的键值去掉了公共前缀和末尾的0，这里会还原到当前对象的缓存中，
+   * 返回的内存在下次调用 key_at 之前有效。需要同时访问多个键值时使用 copy_key_at
+   */
+  const char *key_at(int index);
+  /// @brief 把指定位置的完整键值复制到 key 中
+  void    copy_key_at(int index, char *key) const;
+  PageNum value_at(int index) const;
 
   /**
    * 返回指定子节点在当前节点中的索引
    */
-  int  value_index(PageNum page_num);
-  void set_key_at(int index, const char *key);
+  int  value_index(PageNum page_num) const;
+  /**
+   * @brief 修改指定位置的键值
+   * @details 新的键值可能更长，调用前需要使用 can_update_key 检查空间是否足够
+   */
+  RC   set_key_at(int index, const char *key);
   void remove(int index);
 
+  /**
+   * @brief 乐观读使用的访问接口
+   * @details 不加锁读取时 size() 随时会变化，这里会把 index 限制在页面范围内，调用者需要在使用之前检查页面的版本
+   */
+  PageNum optimistic_value_at(int index) const;
+
+  /**
+   * @brief 在指定位置插入一个键值后，节点是否还能放得下
+   * @details 键值是变长存储的，除了子节点个数，还要检查节点的空间
+   */
+  bool can_insert(int index, const char *key) const;
+  /// @brief 删除指定位置的元素后，节点是否还能放得下。删除key0后key1不再使用公共前缀，可能需要更多空间
+  bool can_remove(int index) const;
+  /// @brief 把指定位置的键值修改为 key 后，节点是否还能放得下
+  bool can_update_key(int index, const char *key) const;
+  /// @brief 当前节点(左边)与右边的节点能否合并成一个节点
+  bool can_merge_with(const InternalIndexNodeHandler &right) const;
+  /// @brief 删除元素后是否需要与相邻节点合并或者重新分配
+  bool is_underflow() const;
+  /**
+   * @brief 判断对指定的操作，当前这个非根节点是否安全
+   * @see IndexNodeHandler::is_safe
+   */
+  bool is_safe(BplusTreeOperationType op) const;
+
   /**
    * 与Leaf节点不同，lookup返回指定key应该属于哪个子节点，返回这个子节点在当前节点中的索引
    * 如果想要返回插入位置，就提供 `insert_position` 参数
@@ -426,20 +558,83 @@ public:
 
   friend string to_string(const InternalIndexNodeHandler &handler, const KeyPrinter &printer);
 
+  RC               recover_insert_items(int index, const char *items, int num) override;
+  RC               recover_remove_items(int index, int num) override;
+  span<const char> node_data() const override;
+
+public:
+  /**
+   * @brief 节点是否按照占用的空间而不是子节点个数判断满了或者太空了
+   * @details 键值比较短并且没有指定很小的 internal_max_size 时，按照最长的键值计算一个节点也放不下
+   * internal_max_size 个子节点，这时需要按照空间判断。
+   * 否则按照子节点个数判断，与定长存储时的行为一致。
+   */
+  static bool limited_by_bytes(const IndexFileHeader &header);
+  /// @brief 节点中存放槽位和键值的空间
+  static int physical_capacity();
+  /**
+   * @brief 一个节点最多使用多少逻辑空间(不考虑公共前缀)
+   * @details 公共前缀可以让节点放下超过 physical_capacity 的数据，但是分裂后两个节点各自的公共前缀可能变短，
+   * 所以限制逻辑空间，保证分裂后的每个节点即使没有公共前缀也能放下，并且还能再插入一个元素。
+   */
+  static int logical_capacity(const IndexFileHeader &header);
+  /// @brief 逻辑空间小于这个值时，需要与相邻节点合并或重新分配
+  static int logical_min_size(const IndexFileHeader &header);
+
+  /**
+   * @brief 计算这些元素按照紧凑格式存放时需要的空间
+   * @param items 连续存放的完整元素(键值+子节点页号)
+   */
+  static InternalNodeSpace measure(const IndexFileHeader &header, const char *items, int num);
+  /// @brief 这些元素能不能放到一个节点中
+  static bool can_hold(const IndexFileHeader &header, const InternalNodeSpace &space);
+  /**
+   * @brief 按照紧凑格式把元素写到节点中，不记录日志
+   * @details 只修改元素相关的字段，is_leaf 和 parent 保持不变
+   */
+  static void encode(const IndexFileHeader &header, InternalIndexNode *node, const char *items, int num);
+
 private:
   RC insert_items(int index, const char *items, int num);
   RC append(const char *items, int num);
   RC append(const char *item);
   RC preappend(const char *item);
 
-private:
-  char *__item_at(int index) const override;
+  /// @brief 取出所有元素，每个元素是完整的键值和子节点页号
+  void get_items(vector<char> &items) const;
+  /// @brief 使用这些元素重新编码整个节点
+  RC set_items(const vector<char> &items);
+  /// @brief 逻辑空间的大小，可以直接从节点头计算出来
+  int logical_size() const;
+  /// @brief 槽位和键值区之间的空闲空间
+  int free_space() const;
 
+  /**
+   * @brief 计算键值存放到指定位置时需要存储的部分
+   * @param[out] skip 存储时跳过的长度，即公共前缀的长度
+   * @return 需要存储的长度。key(1)之后的键值不以公共前缀开头时返回-1
+   */
+  int stored_key_length(int index, const char *key, int &skip) const;
+  /// @brief 在键值区追加一个键值，调用前需要保证空间足够
+  uint16_t append_heap(const char *data, int length);
+
+  /// @brief 在指定位置插入一个元素，不重新编码节点。空间不够或者键值不以公共前缀开头时返回 false
+  bool insert_in_place(int index, const char *item);
+  /// @brief 删除指定位置开始的元素，不重新编码节点。删除key0后新的key0放不下时返回 false
+  bool remove_in_place(int index, int num);
+  /// @brief 修改指定位置的键值，不重新编码节点
+  bool set_key_in_place(int index, const char *key);
+
+  const InternalIndexSlot *slots() const { return reinterpret_cast<const InternalIndexSlot *>(internal_node_->array); }
+  InternalIndexSlot *slots() { return reinterpret_cast<InternalIndexSlot *>(internal_node_->array); }
+
+private:
   int value_size() const override;
   int item_size() const override;
 
 private:
   InternalIndexNode *internal_node_ = nullptr;
+  vector<char>       key_buffer_;  ///< key_at 返回的键值
 };
 
 /**
@@ -511,6 +706,12 @@ public:
    */
   bool validate_tree();
 
+  /**
+   * @brief B+树的层数，只有一个叶子节点时是1，空树是0
+   * @note thread unsafe
+   */
+  RC tree_height(int &height);
+
 public:
   const IndexFileHeader &file_header() const { return file_header_; }
   DiskBufferPool        &buffer_pool() const { return *disk_buffer_pool_; }
@@ -562,11 +763,28 @@ protected:
   /**
    * @brief 查找指定的叶子节点
    * @param op 当前想要执行的操作。操作类型不同会在查找的过程中加不同类型的锁
-   * @param child_page_getter 用于获取子节点的函数
+   * @param child_index_getter 用于获取子节点在内部节点中位置的函数
    * @param[out] frame 返回找到的叶子节点
    */
   RC find_leaf_internal(BplusTreeMiniTransaction &mtr, BplusTreeOperationType op,
-      const function<PageNum(InternalIndexNodeHandler &)> &child_page_getter, Frame *&frame);
+      const function<int(InternalIndexNodeHandler &)> &child_index_getter, Frame *&frame);
+
+  /**
+   * @brief 使用乐观锁(Optimistic Lock Coupling)查找叶子节点，只读操作使用
+   * @details 查找的过程中不加锁，只pin住页面。读完一个节点后检查它的版本号，并且拿到子节点的版本号之后
+   * 再检查一次父节点的版本号，保证子节点的页号是有效的。遇到冲突时从根节点重新查找，多次冲突后改用加锁的方式查找。
+   * @param key 查找的键值，为空时查找最左边的叶子节点
+   * @param[out] frame 找到的叶子节点，只是pin住了，没有加锁
+   * @param[out] version 叶子节点的版本号，读叶子节点的数据之后需要使用它检查
+   */
+  RC optimistic_find_leaf(BplusTreeMiniTransaction &mtr, const char *key, Frame *&frame, uint64_t &version);
+
+  /**
+   * @brief 乐观地查找一次叶子节点
+   * @return 遇到冲突时返回 LOCKED_CONCURRENCY_CONFLICT
+   */
+  RC optimistic_find_leaf_once(BplusTreeMiniTransaction &mtr,
+      const function<int(InternalIndexNodeHandler &)> &child_index_getter, Frame *&frame, uint64_t &version);
 
   /**
    * @brief 使用crabing protocol 获取页面
@@ -645,6 +863,11 @@ protected:
   // 这个锁可以使用递归读写锁，但是这里偷懒先不改
   common::SharedMutex root_lock_;
 
+  // 根节点页号的版本号，修改根节点页号的过程中是奇数。乐观读不加 root_lock_，使用它检查根节点有没有变化
+  atomic<uint64_t> root_version_{0};
+  // 与 file_header_.root_page 相同，乐观读不加锁读取根节点页号时使用
+  atomic<PageNum>  root_page_num_{BP_INVALID_PAGE_NUM};
+
   KeyComparator key_comparator_;
   KeyPrinter    key_printer_;
 
@@ -652,6 +875,7 @@ protected:
 
 private:
   friend class BplusTreeScanner;
+  friend class BplusTreeBulkLoader;
   friend class BplusTreeTester;
 };
 
@@ -701,23 +925,45 @@ private:
    */
   RC fix_user_key(const char *user_key, int key_len, bool want_greater, char **fixed_key, bool *should_inclusive);
 
-  void fetch_item(RID &rid);
-
   /**
    * @brief 判断是否到了扫描的结束位置
    */
-  bool touch_end();
+  bool touch_end(const char *key) const;
+
+  /**
+   * @brief 从 resume_key_ 开始重新定位扫描的位置
+   * @details 开始扫描或者乐观读冲突时调用，会重新从根节点查找叶子节点
+   */
+  RC seek();
+
+  /**
+   * @brief 乐观地读取当前位置的数据
+   * @return 读的过程中页面被修改了返回 LOCKED_CONCURRENCY_CONFLICT
+   */
+  RC fetch_item(RID &rid);
+
+  /**
+   * @brief 当前叶子节点已经读完，移动到下一个叶子节点
+   * @return 读的过程中页面被修改了返回 LOCKED_CONCURRENCY_CONFLICT
+   */
+  RC move_to_next_page();
 
 private:
   bool                     inited_ = false;
   BplusTreeHandler        &tree_handler_;
   BplusTreeMiniTransaction mtr_;
 
-  /// 使用左右叶子节点和位置来表示扫描的起始位置和终止位置
-  /// 起始位置和终止位置都是有效的数据
-  Frame *current_frame_ = nullptr;
+  /// 当前扫描的叶子节点，只pin住不加锁，使用 current_version_ 检查读的过程中页面有没有被修改
+  /// 为空表示扫描已经结束
+  Frame   *current_frame_   = nullptr;
+  uint64_t current_version_ = 0;
+
+  /// 冲突时从这个键值重新开始扫描。还没有返回数据时是左边界，之后是最后一次返回的数据的键值
+  /// 为空表示没有左边界
+  common::MemPoolItem::item_unique_ptr resume_key_;
+  bool                                 resume_inclusive_ = true;  /// 重新扫描时是否包含 resume_key_
+  common::MemPoolItem::item_unique_ptr key_buffer_;               /// 读取数据时使用的临时缓存
 
   common::MemPoolItem::item_unique_ptr right_key_;
-  int                                  iter_index_    = -1;
-  bool                                 first_emitted_ = false;
+  int                                  iter_index_ = -1;
 };
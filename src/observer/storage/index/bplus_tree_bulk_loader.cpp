@@ -0,0 +1,680 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "storage/index/bplus_tree_bulk_loader.h"
+#include "common/io/io.h"
+#include "common/lang/algorithm.h"
+#include "common/lang/thread.h"
+#include "common/log/log.h"
+#include "storage/buffer/frame.h"
+
+using namespace common;
+
+/// 每个线程至少排序这么多个键值，数据太少时不值得启动线程
+static constexpr size_t MIN_KEYS_PER_SORT_THREAD = 4096;
+/// 写临时文件时每次写入的数据大小
+static constexpr size_t SPILL_WRITE_SIZE = 1024 * 1024;
+
+///////////////////////////////////////////////////////////////////////////////
+// BplusTreeKeySorter
+BplusTreeKeySorter::BplusTreeKeySorter(const KeyComparator &comparator, int key_length, const string &tmp_file_prefix,
+    const BplusTreeBulkLoadOptions &options)
+    : comparator_(comparator),
+      key_length_(key_length),
+      tmp_file_prefix_(tmp_file_prefix),
+      options_(options),
+      merge_heap_([this](Run *left, Run *right) {
+        return comparator_(left->current(key_length_), right->current(key_length_)) > 0;
+      })
+{}
+
+BplusTreeKeySorter::~BplusTreeKeySorter()
+{
+  for (unique_ptr<Run> &run : runs_) {
+    if (run->fd >= 0) {
+      ::close(run->fd);
+    }
+    ::unlink(run->file_name.c_str());
+  }
+}
+
+RC BplusTreeKeySorter::add(const char *key)
+{
+  if (finished_) {
+    LOG_WARN("cannot add key after finished");
+    return RC::INTERNAL;
+  }
+
+  buffer_.insert(buffer_.end(), key, key + key_length_);
+  key_num_++;
+
+  if (static_cast<int64_t>(buffer_.size() + key_length_) > options_.sort_memory) {
+    return spill();
+  }
+  return RC::SUCCESS;
+}
+
+void BplusTreeKeySorter::sort_in_memory()
+{
+  const size_t key_num = buffer_.size() / key_length_;
+  sorted_keys_.resize(key_num);
+  for (size_t i = 0; i < key_num; i++) {
+    sorted_keys_[i] = buffer_.data() + i * key_length_;
+  }
+
+  auto less = [this](const char *left, const char *right) { return comparator_(left, right) < 0; };
+
+  const size_t thread_num = std::clamp<size_t>(key_num / MIN_KEYS_PER_SORT_THREAD, 1, max(options_.thread_num, 1));
+  if (thread_num == 1) {
+    sort(sorted_keys_.begin(), sorted_keys_.end(), less);
+    return;
+  }
+
+  // 每个线程排序一段数据，然后再两两归并
+  vector<size_t> bounds(thread_num + 1);
+  for (size_t i = 0; i <= thread_num; i++) {
+    bounds[i] = key_num * i / thread_num;
+  }
+
+  auto           begin = sorted_keys_.begin();
+  vector<thread> threads;
+  for (size_t i = 0; i < thread_num; i++) {
+    threads.emplace_back([begin, &bounds, &less, i]() { sort(begin + bounds[i], begin + bounds[i + 1], less); });
+  }
+  for (thread &t : threads) {
+    t.join();
+  }
+
+  for (size_t width = 1; width < thread_num; width *= 2) {
+    threads.clear();
+    for (size_t i = 0; i + width < thread_num; i += 2 * width) {
+      const size_t low  = bounds[i];
+      const size_t mid  = bounds[i + width];
+      const size_t high = bounds[min(i + 2 * width, thread_num)];
+      threads.emplace_back(
+          [begin, low, mid, high, &less]() { inplace_merge(begin + low, begin + mid, begin + high, less); });
+    }
+    for (thread &t : threads) {
+      t.join();
+    }
+  }
+}
+
+RC BplusTreeKeySorter::spill()
+{
+  sort_in_memory();
+
+  auto run       = make_unique<Run>();
+  run->file_name = tmp_file_prefix_ + ".sort." + std::to_string(runs_.size());
+  run->key_num   = static_cast<int64_t>(sorted_keys_.size());
+  run->fd        = ::open(run->file_name.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (run->fd < 0) {
+    LOG_WARN("failed to create sort file. file=%s, errno=%d:%s", run->file_name.c_str(), errno, strerror(errno));
+    return RC::IOERR_OPEN;
+  }
+
+  // 先放到runs_中，出错时也可以在析构函数中删除文件
+  Run *spilled = run.get();
+  runs_.push_back(std::move(run));
+
+  vector<char> write_buffer;
+  write_buffer.reserve(SPILL_WRITE_SIZE + key_length_);
+  for (size_t i = 0; i < sorted_keys_.size(); i++) {
+    write_buffer.insert(write_buffer.end(), sorted_keys_[i], sorted_keys_[i] + key_length_);
+    if (write_buffer.size() >= SPILL_WRITE_SIZE || i + 1 == sorted_keys_.size()) {
+      int ret = writen(spilled->fd, write_buffer.data(), static_cast<int>(write_buffer.size()));
+      if (ret != 0) {
+        LOG_WARN("failed to write sort file. file=%s, ret=%d:%s", spilled->file_name.c_str(), ret, strerror(ret));
+        return RC::IOERR_WRITE;
+      }
+      write_buffer.clear();
+    }
+  }
+
+  if (::lseek(spilled->fd, 0, SEEK_SET) < 0) {
+    LOG_WARN("failed to seek sort file. file=%s, errno=%d:%s", spilled->file_name.c_str(), errno, strerror(errno));
+    return RC::IOERR_SEEK;
+  }
+
+  LOG_INFO("spilled sorted keys to file. file=%s, key num=%ld", spilled->file_name.c_str(), spilled->key_num);
+  buffer_.clear();
+  sorted_keys_.clear();
+  return RC::SUCCESS;
+}
+
+RC BplusTreeKeySorter::finish()
+{
+  if (finished_) {
+    return RC::SUCCESS;
+  }
+  finished_ = true;
+
+  if (runs_.empty()) {
+    sort_in_memory();
+    sorted_index_ = 0;
+    return RC::SUCCESS;
+  }
+
+  RC rc = RC::SUCCESS;
+  if (!buffer_.empty()) {
+    rc = spill();
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+  vector<char>().swap(buffer_);
+  vector<const char *>().swap(sorted_keys_);
+
+  // 排序使用的内存平分给每个临时文件做读缓存
+  const int64_t buffer_key_num =
+      std::clamp<int64_t>(options_.sort_memory / static_cast<int64_t>(runs_.size()) / key_length_, 1, 64 * 1024);
+  for (unique_ptr<Run> &run : runs_) {
+    run->buffer.resize(buffer_key_num * key_length_);
+    rc = advance(*run);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    merge_heap_.push(run.get());
+  }
+
+  LOG_INFO("begin to merge sorted files. file num=%d, key num=%ld", run_num(), key_num_);
+  return RC::SUCCESS;
+}
+
+RC BplusTreeKeySorter::advance(Run &run)
+{
+  run.buffer_index++;
+  if (run.buffer_index < run.buffer_key_num || run.read_num >= run.key_num) {
+    return RC::SUCCESS;
+  }
+
+  const int64_t capacity = static_cast<int64_t>(run.buffer.size()) / key_length_;
+  const int     read_num = static_cast<int>(min(capacity, run.key_num - run.read_num));
+
+  int ret = readn(run.fd, run.buffer.data(), read_num * key_length_);
+  if (ret != 0) {
+    LOG_WARN("failed to read sort file. file=%s, ret=%d", run.file_name.c_str(), ret);
+    return RC::IOERR_READ;
+  }
+
+  run.read_num += read_num;
+  run.buffer_key_num = read_num;
+  run.buffer_index   = 0;
+  return RC::SUCCESS;
+}
+
+RC BplusTreeKeySorter::next(const char *&key)
+{
+  if (!finished_) {
+    LOG_WARN("cannot iterate keys before finished");
+    return RC::INTERNAL;
+  }
+
+  if (runs_.empty()) {
+    if (sorted_index_ >= sorted_keys_.size()) {
+      return RC::RECORD_EOF;
+    }
+    key = sorted_keys_[sorted_index_++];
+    return RC::SUCCESS;
+  }
+
+  // 上次返回的键值到这次调用时才不再使用，现在才可以读取下一个键值，覆盖读缓存
+  if (last_run_ != nullptr) {
+    RC rc = advance(*last_run_);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    if (last_run_->buffer_index < last_run_->buffer_key_num) {
+      merge_heap_.push(last_run_);
+    }
+    last_run_ = nullptr;
+  }
+
+  if (merge_heap_.empty()) {
+    return RC::RECORD_EOF;
+  }
+
+  last_run_ = merge_heap_.top();
+  merge_heap_.pop();
+  key = last_run_->current(key_length_);
+  return RC::SUCCESS;
+}
+
+///////////////////////////////////////////////////////////////////////////////
+// BplusTreeBulkLoader
+BplusTreeBulkLoader::BplusTreeBulkLoader(
+    BplusTreeHandler &tree_handler, const string &tmp_file_prefix, const BplusTreeBulkLoadOptions &options)
+    : tree_handler_(tree_handler),
+      file_header_(tree_handler.file_header()),
+      options_(options),
+      sorter_(tree_handler.key_comparator_, tree_handler.file_header().key_length, tmp_file_prefix, options),
+      key_buffer_(tree_handler.file_header().key_length)
+{}
+
+BplusTreeBulkLoader::~BplusTreeBulkLoader() {}
+
+RC BplusTreeBulkLoader::add(const char *user_key, const RID &rid)
+{
+  memcpy(key_buffer_.data(), user_key, file_header_.attr_length);
+  memcpy(key_buffer_.data() + file_header_.attr_length, &rid, sizeof(rid));
+  return sorter_.add(key_buffer_.data());
+}
+
+RC BplusTreeBulkLoader::finish()
+{
+  if (!tree_handler_.is_empty()) {
+    LOG_WARN("cannot bulk load a tree which is not empty. root page=%d", file_header_.root_page);
+    return RC::INTERNAL;
+  }
+
+  RC rc = sorter_.finish();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to sort keys. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  if (sorter_.key_num() == 0) {
+    return RC::SUCCESS;
+  }
+
+  plan_levels(sorter_.key_num());
+
+  // 叶子节点的键值中已经包含了RID，值就是键值中的RID
+  const char *key = nullptr;
+  while (OB_SUCC(rc = sorter_.next(key))) {
+    rc = append(0 /*level*/, key, key + file_header_.attr_length);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+
+  if (rc != RC::RECORD_EOF) {
+    LOG_WARN("failed to fetch sorted key. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  // 所有数据都添加完了，从下往上依次写每一层的最后一个节点，上面的层可能是这个过程中才创建的
+  for (int level = 0; level < static_cast<int>(levels_.size()); level++) {
+    if (!levels_[level].planned() && levels_[level].node_index > 0) {
+      rc = balance_last_node(level);
+      if (OB_FAIL(rc)) {
+        return rc;
+      }
+    }
+
+    rc = close_node(level, true /*last*/);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+
+  LOG_INFO("bulk load bplus tree done. key num=%ld, sort file num=%d, level num=%d, leaf num=%d, root page=%d",
+      sorter_.key_num(), sorter_.run_num(), static_cast<int>(levels_.size()), levels_[0].node_num,
+      file_header_.root_page);
+  return RC::SUCCESS;
+}
+
+void BplusTreeBulkLoader::plan_levels(int64_t key_num)
+{
+  levels_.clear();
+
+  int64_t item_num = key_num;
+  int     max_size = file_header_.leaf_max_size;
+  while (true) {
+    Level level;
+    level.item_num = item_num;
+    level.node_num = plan_node_num(item_num, max_size);
+    if (levels_.empty()) {
+      level.node.resize(BP_PAGE_DATA_SIZE);
+    }
+    levels_.push_back(std::move(level));
+
+    // 内部节点按照空间判断是否已满时，事先不知道每个节点能放多少个子节点，在添加的过程中再创建这些层
+    if (levels_.back().node_num == 1 || InternalIndexNodeHandler::limited_by_bytes(file_header_)) {
+      break;
+    }
+
+    // 上一层的每个元素对应这一层的一个节点
+    item_num = levels_.back().node_num;
+    max_size = file_header_.internal_max_size;
+  }
+}
+
+int BplusTreeBulkLoader::plan_node_num(int64_t item_num, int max_size) const
+{
+  const int    min_size    = max_size - max_size / 2;  // 与 IndexNodeHandler::min_size 相同
+  const double fill_factor = std::clamp(options_.fill_factor, 0.5, 1.0);
+  const int    target_size = std::clamp(static_cast<int>(max_size * fill_factor), min_size, max_size);
+
+  int64_t node_num = (item_num + target_size - 1) / target_size;
+  if (node_num > 1 && item_num / node_num < min_size) {
+    node_num = max<int64_t>(1, item_num / min_size);
+  }
+  if ((item_num + node_num - 1) / node_num > max_size) {
+    node_num = (item_num + max_size - 1) / max_size;
+  }
+  return static_cast<int>(node_num);
+}
+
+bool BplusTreeBulkLoader::is_full(int level, const char *key)
+{
+  Level    &current  = levels_[level];
+  const int item_num = item_count(level);
+  if (current.planned()) {
+    return item_num >= current.node_size(current.node_index);
+  }
+
+  if (item_num < 2) {
+    return false;
+  }
+  if (item_num >= file_header_.internal_max_size) {
+    return true;
+  }
+
+  const double fill_factor  = std::clamp(options_.fill_factor, 0.5, 1.0);
+  const int    entry_size   = static_cast<int>(sizeof(InternalIndexSlot)) + file_header_.key_length;
+  const int    logical_size = current.logical_size + entry_size;  // 按照最长的键值估计，不需要计算键值的长度
+  if (logical_size <= InternalIndexNodeHandler::physical_capacity() * fill_factor) {
+    return false;
+  }
+
+  // 公共前缀可能让节点放下更多的子节点，需要准确计算
+  vector<char> &items = current.items;
+  items.insert(items.end(), key, key + file_header_.key_length);
+  items.resize(items.size() + sizeof(PageNum));
+  const InternalNodeSpace space = InternalIndexNodeHandler::measure(file_header_, items.data(), item_num + 1);
+  items.resize(items.size() - file_header_.key_length - sizeof(PageNum));
+
+  return space.logical_size > InternalIndexNodeHandler::logical_capacity(file_header_) * fill_factor ||
+         space.physical_size > InternalIndexNodeHandler::physical_capacity() * fill_factor;
+}
+
+RC BplusTreeBulkLoader::allocate_page(PageNum &page_num)
+{
+  BplusTreeMiniTransaction mtr(tree_handler_);
+
+  Frame *frame = nullptr;
+  RC     rc    = mtr.latch_memo().allocate_page(frame);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to allocate page. rc=%s", strrc(rc));
+    return rc;
+  }
+
+  page_num = frame->page_num();
+  return RC::SUCCESS;
+}
+
+RC BplusTreeBulkLoader::append(int level, const char *key, const char *value)
+{
+  RC rc = RC::SUCCESS;
+  if (level == static_cast<int>(levels_.size())) {
+    levels_.emplace_back();
+  }
+
+  if (item_count(level) > 0 && is_full(level, key)) {
+    rc = close_node(level, false /*last*/);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+
+  // close_node 可能会创建新的层，之前的引用可能已经失效了
+  Level     &current = levels_[level];
+  const bool leaf    = (level == 0);
+  if (current.page_num == BP_INVALID_PAGE_NUM) {
+    rc = allocate_page(current.page_num);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+
+  if (!leaf) {
+    // 内部节点按照完整的键值保存，写页面时再编码
+    current.items.insert(current.items.end(), key, key + file_header_.key_length);
+    current.items.insert(current.items.end(), value, value + sizeof(PageNum));
+    current.logical_size += InternalIndexNodeHandler::measure(file_header_, key, 1).logical_size;
+    return RC::SUCCESS;
+  }
+
+  LeafIndexNode *node      = reinterpret_cast<LeafIndexNode *>(current.node.data());
+  const int      item_size = file_header_.key_length + sizeof(RID);
+  if (node->key_num == 0) {
+    node->is_leaf      = true;
+    node->parent       = BP_INVALID_PAGE_NUM;
+    node->next_brother = BP_INVALID_PAGE_NUM;
+  }
+
+  char *item = node->array + static_cast<size_t>(node->key_num) * item_size;
+  memcpy(item, key, file_header_.key_length);
+  memcpy(item + file_header_.key_length, value, sizeof(RID));
+  node->key_num++;
+  return RC::SUCCESS;
+}
+
+RC BplusTreeBulkLoader::close_node(int level, bool last)
+{
+  RC rc = RC::SUCCESS;
+
+  Level     &current = levels_[level];
+  const bool leaf    = (level == 0);
+  const bool is_root = last && current.node_index == 0 && level + 1 == static_cast<int>(levels_.size());
+
+  // 父节点中的键值。每一层最左边的节点使用全0的键值，与 create_new_root 相同
+  vector<char> separator(file_header_.key_length, 0);
+  if (leaf) {
+    const char *first_key = reinterpret_cast<LeafIndexNode *>(current.node.data())->array;
+    if (current.node_index > 0) {
+      tree_handler_.key_comparator_.shortest_separator(current.last_key.data(), first_key, separator.data());
+    }
+  } else {
+    // 内部节点的第一个键值就是它在父节点中的键值
+    memcpy(separator.data(), current.items.data(), file_header_.key_length);
+  }
+
+  // 先把节点加到父节点中，父节点放不下时会先写父节点，再换一个新的父节点
+  const PageNum page_num        = current.page_num;
+  PageNum       parent_page_num = BP_INVALID_PAGE_NUM;
+  if (!is_root) {
+    rc = append(level + 1, separator.data(), reinterpret_cast<const char *>(&page_num));
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    parent_page_num = levels_[level + 1].page_num;
+  }
+
+  Level &node_level = levels_[level];
+  if (leaf) {
+    LeafIndexNode *node = reinterpret_cast<LeafIndexNode *>(node_level.node.data());
+
+    // 下一个叶子节点的页号要先分配好，才能设置兄弟节点
+    PageNum next_page_num = BP_INVALID_PAGE_NUM;
+    if (node_level.node_index + 1 < node_level.node_num) {
+      rc = allocate_page(next_page_num);
+      if (OB_FAIL(rc)) {
+        return rc;
+      }
+    }
+    node->next_brother = next_page_num;
+    node->parent       = parent_page_num;
+
+    rc = write_page(page_num, true /*leaf*/, [&node_level](char *data) {
+      memcpy(data, node_level.node.data(), node_level.node.size());
+    });
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    const int item_size = file_header_.key_length + sizeof(RID);
+    node_level.last_key.assign(node->array + static_cast<size_t>(node->key_num - 1) * item_size,
+        node->array + static_cast<size_t>(node->key_num - 1) * item_size + file_header_.key_length);
+    node->key_num        = 0;
+    node_level.page_num  = next_page_num;
+  } else {
+    rc = write_internal_node(page_num, parent_page_num, node_level.items);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+
+    node_level.prev_page_num        = page_num;
+    node_level.prev_parent_page_num = parent_page_num;
+    node_level.prev_items.swap(node_level.items);
+    node_level.items.clear();
+    node_level.logical_size = 0;
+    node_level.page_num     = BP_INVALID_PAGE_NUM;
+  }
+  node_level.node_index++;
+
+  if (is_root) {
+    BplusTreeMiniTransaction mtr(tree_handler_);
+    tree_handler_.update_root_page_num_locked(mtr, page_num);
+    rc = mtr.commit();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to commit root page update. rc=%s", strrc(rc));
+      return rc;
+    }
+  }
+  return RC::SUCCESS;
+}
+
+RC BplusTreeBulkLoader::balance_last_node(int level)
+{
+  Level &current = levels_[level];
+
+  const int item_size = file_header_.key_length + sizeof(PageNum);
+  const int prev_num  = static_cast<int>(current.prev_items.size() / item_size);
+  const int num       = item_count(level);
+  if (num >= 2 && current.logical_size >= InternalIndexNodeHandler::logical_min_size(file_header_)) {
+    return RC::SUCCESS;
+  }
+
+  // 把上一个节点后面的一些元素移到最后一个节点，两个节点的逻辑空间尽量相等
+  vector<char> items(current.prev_items);
+  items.insert(items.end(), current.items.begin(), current.items.end());
+  const int total_num = prev_num + num;
+
+  int move_index = -1;
+  int best_diff  = 0;
+  for (int i = 2; i < prev_num && total_num - i >= 2; i++) {
+    const InternalNodeSpace left  = InternalIndexNodeHandler::measure(file_header_, items.data(), i);
+    const InternalNodeSpace right = InternalIndexNodeHandler::measure(
+        file_header_, items.data() + static_cast<size_t>(i) * item_size, total_num - i);
+    if (!InternalIndexNodeHandler::can_hold(file_header_, left) ||
+        !InternalIndexNodeHandler::can_hold(file_header_, right)) {
+      continue;
+    }
+
+    const int diff = std::abs(left.logical_size - right.logical_size);
+    if (move_index < 0 || diff < best_diff) {
+      move_index = i;
+      best_diff  = diff;
+    }
+  }
+
+  if (move_index < 0) {
+    return RC::SUCCESS;
+  }
+
+  // 移动过来的子节点已经写到页面中了，需要修改它们的父节点
+  for (int i = move_index; i < prev_num; i++) {
+    PageNum child_page_num = BP_INVALID_PAGE_NUM;
+    memcpy(&child_page_num, items.data() + static_cast<size_t>(i) * item_size + file_header_.key_length, sizeof(PageNum));
+
+    BplusTreeMiniTransaction mtr(tree_handler_);
+
+    Frame *frame = nullptr;
+    RC     rc    = mtr.latch_memo().get_page(child_page_num, frame);
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to get page. page num=%d, rc=%s", child_page_num, strrc(rc));
+      return rc;
+    }
+    mtr.latch_memo().xlatch(frame);
+
+    IndexNodeHandler child_node(mtr, file_header_, frame);
+    rc = child_node.set_parent_page_num(current.page_num);
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+    frame->mark_dirty();
+    rc = mtr.commit();
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to commit parent page update. page num=%d, rc=%s", child_page_num, strrc(rc));
+      return rc;
+    }
+  }
+
+  vector<char> prev_items(items.begin(), items.begin() + static_cast<size_t>(move_index) * item_size);
+  RC rc = write_internal_node(current.prev_page_num, current.prev_parent_page_num, prev_items);
+  if (OB_FAIL(rc)) {
+    return rc;
+  }
+
+  current.items.assign(items.begin() + static_cast<size_t>(move_index) * item_size, items.end());
+  current.logical_size = InternalIndexNodeHandler::measure(file_header_, current.items.data(), total_num - move_index).logical_size;
+  current.prev_items.swap(prev_items);
+  return RC::SUCCESS;
+}
+
+RC BplusTreeBulkLoader::write_internal_node(PageNum page_num, PageNum parent_page_num, const vector<char> &items)
+{
+  const int num = static_cast<int>(items.size() / (file_header_.key_length + sizeof(PageNum)));
+  return write_page(page_num, false /*leaf*/, [this, parent_page_num, &items, num](char *data) {
+    InternalIndexNode *node = reinterpret_cast<InternalIndexNode *>(data);
+    node->is_leaf           = false;
+    node->parent            = parent_page_num;
+    InternalIndexNodeHandler::encode(file_header_, node, items.data(), num);
+  });
+}
+
+RC BplusTreeBulkLoader::write_page(PageNum page_num, bool leaf, const function<void(char *)> &filler)
+{
+  BplusTreeMiniTransaction mtr(tree_handler_);
+
+  Frame *frame = nullptr;
+  RC     rc    = mtr.latch_memo().get_page(page_num, frame);
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to get page. page num=%d, rc=%s", page_num, strrc(rc));
+    return rc;
+  }
+
+  mtr.latch_memo().xlatch(frame);
+  filler(frame->data());
+
+  if (leaf) {
+    LeafIndexNodeHandler node_handler(mtr, file_header_, frame);
+    rc = mtr.logger().node_init_page(node_handler);
+  } else {
+    InternalIndexNodeHandler node_handler(mtr, file_header_, frame);
+    rc = mtr.logger().node_init_page(node_handler);
+  }
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to log node. page num=%d, rc=%s", page_num, strrc(rc));
+    return rc;
+  }
+
+  frame->mark_dirty();
+  rc = mtr.commit();
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to commit node log. page num=%d, rc=%s", page_num, strrc(rc));
+  }
+  return rc;
+}
+
+int BplusTreeBulkLoader::item_count(int level) const
+{
+  const Level &current = levels_[level];
+  if (level == 0) {
+    return reinterpret_cast<const IndexNode *>(current.node.data())->key_num;
+  }
+  return static_cast<int>(current.items.size() / (file_header_.key_length + sizeof(PageNum)));
+}
@@ -0,0 +1,241 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#pragma once
+
+#include "common/lang/functional.h"
+#include "common/lang/memory.h"
+#include "common/lang/queue.h"
+#include "common/lang/string.h"
+#include "common/lang/vector.h"
+#include "common/sys/rc.h"
+#include "common/types.h"
+#include "storage/index/bplus_tree.h"
+
+/**
+ * @brief 批量创建B+树的配置
+ * @ingroup BPlusTree
+ */
+struct BplusTreeBulkLoadOptions
+{
+  double  fill_factor = 0.9;               ///< 叶子节点和内部节点的填充率，会限制在[0.5, 1]之间
+  int64_t sort_memory = 64 * 1024 * 1024;  ///< 排序使用的内存，超过后把排好序的数据写到临时文件中
+  int     thread_num  = 4;                 ///< 排序使用的线程数
+};
+
+/**
+ * @brief 外部排序B+树的键值
+ * @ingroup BPlusTree
+ * @details 键值是定长的(属性值 + RID)。内存中的数据达到 sort_memory 后，多个线程分别排序一部分数据，
+ * 再两两归并，然后写到一个临时文件中。所有数据添加完成后，如果没有写过临时文件就直接在内存中遍历，
+ * 否则对所有临时文件做多路归并。
+ */
+class BplusTreeKeySorter final
+{
+public:
+  /**
+   * @param comparator 键值比较器
+   * @param key_length 键值的长度
+   * @param tmp_file_prefix 临时文件名的前缀
+   */
+  BplusTreeKeySorter(
+      const KeyComparator &comparator, int key_length, const string &tmp_file_prefix, const BplusTreeBulkLoadOptions &options);
+  ~BplusTreeKeySorter();
+
+  RC add(const char *key);
+
+  /**
+   * @brief 所有数据都添加完成，准备按顺序遍历
+   */
+  RC finish();
+
+  /**
+   * @brief 按顺序返回下一个键值
+   * @details 返回的内存在下次调用 next 之前有效
+   * @return RECORD_EOF 表示遍历完成
+   */
+  RC next(const char *&key);
+
+  /// @brief 一共有多少个键值
+  int64_t key_num() const { return key_num_; }
+  /// @brief 写了多少个临时文件
+  int run_num() const { return static_cast<int>(runs_.size()); }
+
+private:
+  /// @brief 使用多个线程排序内存中的数据，结果放在 sorted_keys_ 中
+  void sort_in_memory();
+  /// @brief 把内存中的数据排序后写到一个临时文件中
+  RC spill();
+
+private:
+  /**
+   * @brief 一个排好序的临时文件
+   */
+  struct Run
+  {
+    string       file_name;
+    int          fd       = -1;
+    int64_t      key_num  = 0;  ///< 文件中一共有多少个键值
+    int64_t      read_num = 0;  ///< 已经读到缓存中的键值个数
+    vector<char> buffer;        ///< 读文件的缓存
+    int          buffer_key_num = 0;
+    int          buffer_index   = 0;
+
+    const char *current(int key_length) const { return buffer.data() + static_cast<size_t>(buffer_index) * key_length; }
+  };
+
+  /// @brief 当前的键值用完之后，读下一个键值，必要时从文件中读一批数据
+  RC advance(Run &run);
+
+private:
+  const KeyComparator     &comparator_;
+  int                      key_length_ = 0;
+  string                   tmp_file_prefix_;
+  BplusTreeBulkLoadOptions options_;
+
+  int64_t key_num_ = 0;
+  bool    finished_ = false;
+
+  vector<char>         buffer_;  ///< 还没有写到临时文件中的数据
+  vector<const char *> sorted_keys_;
+  size_t               sorted_index_ = 0;
+
+  vector<unique_ptr<Run>> runs_;
+
+  /// 多路归并时使用的最小堆，按照每个临时文件当前的键值排序
+  priority_queue<Run *, vector<Run *>, function<bool(Run *, Run *)>> merge_heap_;
+  Run *last_run_ = nullptr;  ///< 上次返回的键值所在的文件
+};
+
+/**
+ * @brief 自底向上批量创建B+树
+ * @ingroup BPlusTree
+ * @details 逐条插入数据创建索引时，每条数据都要从根节点查找叶子节点、加锁、记录日志，还可能需要分裂节点。
+ * 批量创建时，先把所有的键值排好序，然后按照填充率依次填满叶子节点，每个节点写满后再把它在父节点中的键值
+ * 加到上一层的节点中，最后一层只有一个节点时就是根节点。
+ * 每个页面只在写满之后记录一条日志(NODE_INIT_PAGE)，日志中是整个节点的数据。
+ *
+ * 因为先知道了一共有多少个键值，就可以提前算出叶子节点这一层有多少个节点，每个节点放多少个元素，保证所有节点
+ * 都不小于 min_size，不会出现最后一个节点太空的情况。内部节点按照子节点个数判断是否已满时也是这样计算的。
+ * 内部节点的键值是变长的，按照空间判断是否已满时(参考 InternalIndexNodeHandler::limited_by_bytes)，
+ * 事先不知道每个节点能放多少个子节点，就按照填充率尽量填满每个节点，最后一个节点太空时再从前一个节点移一些元素过来。
+ * 叶子节点在父节点中的键值是与前一个叶子节点之间最短的分隔键值。
+ * @note 只能在一个空的B+树上使用，并且加载的过程中不能有其它线程访问这个B+树。
+ */
+class BplusTreeBulkLoader final
+{
+public:
+  /**
+   * @param tmp_file_prefix 排序使用的临时文件名的前缀
+   */
+  BplusTreeBulkLoader(BplusTreeHandler &tree_handler, const string &tmp_file_prefix,
+      const BplusTreeBulkLoadOptions &options = BplusTreeBulkLoadOptions());
+  ~BplusTreeBulkLoader();
+
+  /**
+   * @brief 添加一条数据，不需要有序
+   * @note 这里假设user_key的内存大小与attr_length 一致
+   */
+  RC add(const char *user_key, const RID &rid);
+
+  /**
+   * @brief 所有数据都添加完成，排序并创建B+树
+   */
+  RC finish();
+
+private:
+  /**
+   * @brief 正在填充的某一层节点
+   */
+  struct Level
+  {
+    int64_t item_num   = 0;  ///< 这一层一共有多少个元素，事先不知道时是0
+    int     node_num   = 0;  ///< 这一层一共有多少个节点，事先不知道时是0
+    int     node_index = 0;  ///< 当前节点是这一层的第几个节点
+
+    PageNum      page_num = BP_INVALID_PAGE_NUM;  ///< 当前节点的页号，还没有分配时是无效页号
+    vector<char> node;                            ///< 叶子节点的数据，写满后复制到页面中
+    vector<char> last_key;                        ///< 上一个叶子节点中最大的键值，用来计算分隔键值
+
+    vector<char> items;             ///< 内部节点的元素(完整的键值和子节点页号)，写页面时再按照紧凑格式编码
+    int          logical_size = 0;  ///< 内部节点当前使用的逻辑空间
+
+    /// 上一个内部节点，最后一个节点太空时从这里移一些元素过来
+    PageNum      prev_page_num        = BP_INVALID_PAGE_NUM;
+    PageNum      prev_parent_page_num = BP_INVALID_PAGE_NUM;
+    vector<char> prev_items;
+
+    /// @brief 是否事先算好了这一层每个节点放多少个元素
+    bool planned() const { return node_num > 0; }
+
+    /// @brief 第 index 个节点放多少个元素
+    int node_size(int index) const
+    {
+      return static_cast<int>(item_num / node_num + (index < item_num % node_num ? 1 : 0));
+    }
+  };
+
+  /**
+   * @brief 计算每一层有多少个元素和节点
+   * @details 内部节点按照空间判断是否已满时，只计算叶子节点这一层
+   */
+  void plan_levels(int64_t key_num);
+
+  /**
+   * @brief 每个节点放多少个元素
+   * @details 按照填充率计算，但是要保证每个节点的元素都不少于 min_size 也不多于 max_size
+   */
+  int plan_node_num(int64_t item_num, int max_size) const;
+
+  /**
+   * @brief 当前节点再放一个元素是否会超过计划的大小或者填充率
+   */
+  bool is_full(int level, const char *key);
+
+  int item_count(int level) const;
+
+  RC allocate_page(PageNum &page_num);
+
+  /**
+   * @brief 在某一层的当前节点中追加一个元素，当前节点已满时先把它写到页面中
+   * @param key 键值
+   * @param value 叶子节点是RID，内部节点是子节点的页号
+   */
+  RC append(int level, const char *key, const char *value);
+
+  /**
+   * @brief 当前节点已经写满，把它加到上一层的节点中，再写到页面中并记录日志
+   * @param last 是否这一层的最后一个节点。只有一个节点的最上面一层就是根节点
+   */
+  RC close_node(int level, bool last);
+
+  /**
+   * @brief 最后一个内部节点太空时，从前一个节点移一些元素过来
+   * @details 前一个节点已经写到页面中了，需要重写这个页面，并修改移动过来的子节点的父节点
+   */
+  RC balance_last_node(int level);
+
+  RC write_internal_node(PageNum page_num, PageNum parent_page_num, const vector<char> &items);
+
+  /**
+   * @brief 使用 filler 填充页面的数据并记录日志
+   */
+  RC write_page(PageNum page_num, bool leaf, const function<void(char *)> &filler);
+
+private:
+  BplusTreeHandler        &tree_handler_;
+  const IndexFileHeader   &file_header_;
+  BplusTreeBulkLoadOptions options_;
+
+  BplusTreeKeySorter sorter_;
+  vector<char>       key_buffer_;
+
+  vector<Level> levels_;  ///< 第0层是叶子节点
+};
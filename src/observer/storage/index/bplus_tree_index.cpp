@@ -16,6 +16,7 @@ See the Mulan PSL v2 for more details. */
 #include "common/log/log.h"
 #include "storage/table/table.h"
 #include "storage/db/db.h"
+#include "storage/record/record_scanner.h"
 
 BplusTreeIndex::~BplusTreeIndex() noexcept { close(); }
 
@@ -90,6 +91,29 @@ RC BplusTreeIndex::delete_entry(const char *record, const RID *rid)
   return index_handler_.delete_entry(record + field_meta_.offset(), rid);
 }
 
+RC BplusTreeIndex::bulk_load(RecordScanner &scanner, const BplusTreeBulkLoadOptions &options)
+{
+  // 排序的临时文件放在索引文件旁边
+  BplusTreeBulkLoader loader(index_handler_, index_handler_.buffer_pool().filename(), options);
+
+  RC     rc = RC::SUCCESS;
+  Record record;
+  while (OB_SUCC(rc = scanner.next(record))) {
+    rc = loader.add(record.data() + field_meta_.offset(), record.rid());
+    if (OB_FAIL(rc)) {
+      LOG_WARN("failed to add record to bulk loader. index=%s, rc=%s", index_meta_.name(), strrc(rc));
+      return rc;
+    }
+  }
+
+  if (rc != RC::RECORD_EOF) {
+    LOG_WARN("failed to scan records while bulk loading index. index=%s, rc=%s", index_meta_.name(), strrc(rc));
+    return rc;
+  }
+
+  return loader.finish();
+}
+
 IndexScanner *BplusTreeIndex::create_scanner(
     const char *left_key, int left_len, bool left_inclusive, const char *right_key, int right_len, bool right_inclusive)
 {
@@ -15,8 +15,11 @@ See the Mulan PSL v2 for more details. */
 #pragma once
 
 #include "storage/index/bplus_tree.h"
+#include "storage/index/bplus_tree_bulk_loader.h"
 #include "storage/index/index.h"
 
+class RecordScanner;
+
 /**
  * @brief B+树索引
  * @ingroup Index
@@ -34,6 +37,12 @@ public:
   RC insert_entry(const char *record, const RID *rid) override;
   RC delete_entry(const char *record, const RID *rid) override;
 
+  /**
+   * @brief 使用扫描到的所有记录，自底向上批量创建索引
+   * @details 比逐条插入快很多，每个页面只记录一条日志。只能在刚创建的空索引上使用
+   */
+  RC bulk_load(RecordScanner &scanner, const BplusTreeBulkLoadOptions &options);
+
   /**
    * 扫描指定范围的数据
    */
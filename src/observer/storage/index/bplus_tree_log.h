@@ -99,6 +99,12 @@ public:
    */
   RC node_remove_items(IndexNodeHandler &node_handler, int index, span<const char> items, int item_num);
 
+  /**
+   * @brief 记录整个节点的数据
+   * @details 批量创建索引时使用。节点的数据都写好之后再调用，一个页面只记录一条日志
+   */
+  RC node_init_page(IndexNodeHandler &node_handler);
+
   /**
    * @brief 初始化一个空的叶子节点
    */
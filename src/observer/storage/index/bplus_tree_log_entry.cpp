@@ -34,6 +34,7 @@ string LogOperation::to_string() const
     case Type::INTERNAL_UPDATE_KEY: ss << "INTERNAL_UPDATE_KEY"; break;
     case Type::NODE_INSERT: ss << "NODE_INSERT"; break;
     case Type::NODE_REMOVE: ss << "NODE_REMOVE"; break;
+    case Type::NODE_INIT_PAGE: ss << "NODE_INIT_PAGE"; break;
     default: ss << "INVALID"; break;
   }
   return ss.str();
@@ -172,6 +173,10 @@ RC LogEntryHandler::from_buffer(
       rc = NormalOperationLogEntryHandler::deserialize(frame, operation, buffer, handler);
     } break;
 
+    case LogOperation::Type::NODE_INIT_PAGE: {
+      rc = NodeInitPageLogEntryHandler::deserialize(frame, buffer, handler);
+    } break;
+
     default: {
       LOG_ERROR("unknown log operation. operation=%d:%s", operation.index(), operation.to_string().c_str());
       return RC::INTERNAL;
@@ -328,11 +333,18 @@ RC NormalOperationLogEntryHandler::rollback(BplusTreeMiniTransaction &mtr, Bplus
   if (nullptr == frame()) {
     return RC::INTERNAL;
   }
-  IndexNodeHandler node_handler(mtr, tree_handler.file_header(), frame());
+  InternalIndexNodeHandler internal_node(mtr, tree_handler.file_header(), frame());
+  LeafIndexNodeHandler     leaf_node(mtr, tree_handler.file_header(), frame());
+  IndexNodeHandler        *real_handler = nullptr;
+  if (leaf_node.is_leaf()) {
+    real_handler = &leaf_node;
+  } else {
+    real_handler = &internal_node;
+  }
   if (operation_type().type() == LogOperation::Type::NODE_INSERT) {
-    return node_handler.recover_remove_items(index_, item_num_);
+    return real_handler->recover_remove_items(index_, item_num_);
   } else {  // should be NODE_REMOVE
-    return node_handler.recover_insert_items(index_, items_.data(), item_num_);
+    return real_handler->recover_insert_items(index_, items_.data(), item_num_);
   }
 }
 
@@ -354,6 +366,49 @@ RC NormalOperationLogEntryHandler::redo(BplusTreeMiniTransaction &mtr, BplusTree
   }
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// NodeInitPageLogEntryHandler
+NodeInitPageLogEntryHandler::NodeInitPageLogEntryHandler(Frame *frame, span<const char> node_data)
+    : NodeLogEntryHandler(LogOperation::Type::NODE_INIT_PAGE, frame), node_data_(node_data.begin(), node_data.end())
+{}
+
+RC NodeInitPageLogEntryHandler::serialize_body(Serializer &buffer) const
+{
+  if (buffer.write_int32(static_cast<int32_t>(node_data_.size())) < 0 || buffer.write(node_data_) < 0) {
+    return RC::INTERNAL;
+  }
+  return RC::SUCCESS;
+}
+
+string NodeInitPageLogEntryHandler::to_string() const
+{
+  stringstream ss;
+  ss << LogEntryHandler::to_string() << ", node_bytes=" << node_data_.size();
+  return ss.str();
+}
+
+RC NodeInitPageLogEntryHandler::deserialize(Frame *frame, Deserializer &buffer, unique_ptr<LogEntryHandler> &handler)
+{
+  int32_t node_bytes = -1;
+  if (buffer.read_int32(node_bytes) < 0 || node_bytes < 0 || node_bytes > BP_PAGE_DATA_SIZE) {
+    return RC::INTERNAL;
+  }
+
+  vector<char> node_data(node_bytes);
+  if (buffer.read(node_data) < 0) {
+    return RC::INTERNAL;
+  }
+
+  handler = make_unique<NodeInitPageLogEntryHandler>(frame, node_data);
+  return RC::SUCCESS;
+}
+
+RC NodeInitPageLogEntryHandler::redo(BplusTreeMiniTransaction &mtr, BplusTreeHandler &tree_handler)
+{
+  IndexNodeHandler node_handler(mtr, tree_handler.file_header(), frame());
+  return node_handler.recover_node_data(node_data_);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // LeafInitEmptyLogEntryHandler
 LeafInitEmptyLogEntryHandler::LeafInitEmptyLogEntryHandler(Frame *frame)
@@ -550,15 +605,13 @@ RC InternalUpdateKeyLogEntryHandler::rollback(BplusTreeMiniTransaction &mtr, Bpl
     return RC::INTERNAL;
   }
   InternalIndexNodeHandler node_handler(mtr, tree_handler.file_header(), frame());
-  node_handler.set_key_at(index_, old_key_.data());
-  return RC::SUCCESS;
+  return node_handler.set_key_at(index_, old_key_.data());
 }
 
 RC InternalUpdateKeyLogEntryHandler::redo(BplusTreeMiniTransaction &mtr, BplusTreeHandler &tree_handler)
 {
   InternalIndexNodeHandler node_handler(mtr, tree_handler.file_header(), frame());
-  node_handler.set_key_at(index_, key_.data());
-  return RC::SUCCESS;
+  return node_handler.set_key_at(index_, key_.data());
 }
 
 ///////////////////////////////////////////////////////////////////////////////
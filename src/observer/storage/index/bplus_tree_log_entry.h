@@ -50,6 +50,7 @@ public:
     INTERNAL_UPDATE_KEY,       /// 更新内部节点的key
     NODE_INSERT,               /// 在节点中间(也可能是末尾)插入一些元素
     NODE_REMOVE,               /// 在节点中间(也可能是末尾)删除一些元素
+    NODE_INIT_PAGE,            /// 批量创建索引时，一次记录整个节点的数据
 
     MAX_TYPE,
   };
@@ -256,6 +257,34 @@ private:
   vector<char> items_;
 };
 
+/**
+ * @brief 记录整个节点数据的日志处理类
+ * @ingroup CLog
+ * @details 批量创建索引时，节点是一次性填满的，每个页面只记录一条日志，而不是每个元素记录一条。
+ * 只记录节点头和已经使用的元素，不记录页面中剩余的空间。
+ */
+class NodeInitPageLogEntryHandler : public NodeLogEntryHandler
+{
+public:
+  NodeInitPageLogEntryHandler(Frame *frame, span<const char> node_data);
+  virtual ~NodeInitPageLogEntryHandler() = default;
+
+  RC serialize_body(common::Serializer &buffer) const override;
+  /// 批量创建索引失败时，整个索引都会删除，不需要回滚单个页面
+  RC rollback(BplusTreeMiniTransaction &mtr, BplusTreeHandler &tree_handler) override { return RC::SUCCESS; }
+  RC redo(BplusTreeMiniTransaction &mtr, BplusTreeHandler &tree_handler) override;
+
+  string to_string() const override;
+
+  static RC deserialize(Frame *frame, common::Deserializer &buffer, unique_ptr<LogEntryHandler> &handler);
+
+  const char *node_data() const { return node_data_.data(); }
+  int32_t     node_bytes() const { return static_cast<int32_t>(node_data_.size()); }
+
+private:
+  vector<char> node_data_;
+};
+
 /**
  * @brief 叶子节点初始化日志处理类
  * @ingroup CLog
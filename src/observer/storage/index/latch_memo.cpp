@@ -35,11 +35,11 @@ LatchMemo::LatchMemo(DiskBufferPool *buffer_pool) : buffer_pool_(buffer_pool) {}
 
 LatchMemo::~LatchMemo() { this->release(); }
 
-RC LatchMemo::get_page(PageNum page_num, Frame *&frame)
+RC LatchMemo::get_page(PageNum page_num, Frame *&frame, BPAccessHint hint /* = BPAccessHint::NORMAL */)
 {
   frame = nullptr;
 
-  RC rc = buffer_pool_->get_this_page(page_num, &frame);
+  RC rc = buffer_pool_->get_this_page(page_num, &frame, hint);
   if (rc != RC::SUCCESS) {
     return rc;
   }
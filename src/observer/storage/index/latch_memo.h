@@ -17,6 +17,7 @@ See the Mulan PSL v2 for more details. */
 #include "common/sys/rc.h"
 #include "common/lang/deque.h"
 #include "common/lang/vector.h"
+#include "storage/buffer/bp_replacer.h"
 #include "storage/buffer/page.h"
 
 class Frame;
@@ -57,7 +58,11 @@ public:
   LatchMemo(DiskBufferPool *buffer_pool);
   ~LatchMemo();
 
-  RC get_page(PageNum page_num, Frame *&frame);
+  /**
+   * @brief 获取页面并pin住
+   * @param hint 访问方式，扫描叶子节点时使用 BPAccessHint::SCAN，参考 DiskBufferPool::get_this_page
+   */
+  RC get_page(PageNum page_num, Frame *&frame, BPAccessHint hint = BPAccessHint::NORMAL);
 
   /// @brief 分配页面
   RC allocate_page(Frame *&frame);
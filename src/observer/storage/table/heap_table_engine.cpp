@@ -12,6 +12,8 @@ See the Mulan PSL v2 for more details. */
 #include "storage/record/heap_record_scanner.h"
 #include "common/log/log.h"
 #include "storage/index/bplus_tree_index.h"
+#include "common/conf/ini.h"
+#include "common/lang/string.h"
 #include "storage/common/meta_util.h"
 #include "storage/db/db.h"
 
@@ -149,7 +151,7 @@ RC HeapTableEngine::create_index(Trx *trx, const FieldMeta *field_meta, const ch
     return rc;
   }
 
-  // 遍历当前的所有数据，插入这个索引
+  // 遍历当前的所有数据，排序后自底向上批量创建索引
   RecordScanner *scanner = nullptr;
   rc = get_record_scanner(scanner, trx, ReadWriteMode::READ_ONLY);
   if (rc != RC::SUCCESS) {
@@ -158,24 +160,22 @@ RC HeapTableEngine::create_index(Trx *trx, const FieldMeta *field_meta, const ch
     return rc;
   }
 
-  Record record;
-  while (OB_SUCC(rc = scanner->next(record))) {
-    rc = index->insert_entry(record.data(), &record.rid());
-    if (rc != RC::SUCCESS) {
-      LOG_WARN("failed to insert record into index while creating index. table=%s, index=%s, rc=%s",
-               table_meta_->name(), index_name, strrc(rc));
-      return rc;
-    }
+  BplusTreeBulkLoadOptions bulk_load_options;
+  if (common::get_properties() != nullptr) {
+    common::Ini *properties = common::get_properties();
+    common::str_to_val(properties->get("BULK_LOAD_FILL_FACTOR", "0.9", "INDEX"), bulk_load_options.fill_factor);
+    common::str_to_val(properties->get("BULK_LOAD_SORT_MEMORY", "67108864", "INDEX"), bulk_load_options.sort_memory);
+    common::str_to_val(properties->get("BULK_LOAD_SORT_THREADS", "4", "INDEX"), bulk_load_options.thread_num);
   }
-  if (RC::RECORD_EOF == rc) {
-    rc = RC::SUCCESS;
-  } else {
-    LOG_WARN("failed to insert record into index while creating index. table=%s, index=%s, rc=%s",
+
+  rc = index->bulk_load(*scanner, bulk_load_options);
+  scanner->close_scan();
+  delete scanner;
+  if (OB_FAIL(rc)) {
+    LOG_WARN("failed to load records into index while creating index. table=%s, index=%s, rc=%s",
              table_meta_->name(), index_name, strrc(rc));
     return rc;
   }
-  scanner->close_scan();
-  delete scanner;
   LOG_INFO("inserted all records into new index. table=%s, index=%s", table_meta_->name(), index_name);
 
   indexes_.push_back(index);
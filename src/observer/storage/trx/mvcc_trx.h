@@ -39,9 +39,20 @@ public:
 
   LogReplayer *create_log_replayer(Db &db, LogHandler &log_handler) override;
 
+  /**
+   * @brief 活跃事务中最小的开始LSN，参考 MvccTrx::begin_lsn
+   */
+  LSN min_recovery_lsn() override;
+
 public:
   int32_t next_trx_id();
 
+  /**
+   * @brief 保证以后分配的事务ID都大于 trx_id
+   * @details 恢复时使用。提交时分配的事务ID也要考虑进来，否则恢复后新事务的ID可能比已经提交的数据的版本号还小
+   */
+  void advance_trx_id(int32_t trx_id);
+
 public:
   int32_t max_trx_id() const;
 
@@ -95,6 +106,12 @@ public:
 
   int32_t id() const override { return trx_id_; }
 
+  /**
+   * @brief 事务开始时的下一个LSN，事务的日志都不会小于它
+   * @details 提交或回滚之后清零。由事务所在的线程修改，做检查点的线程读取
+   */
+  LSN begin_lsn() const { return begin_lsn_.load(); }
+
 private:
   RC   commit_with_trx_id(int32_t commit_id);
   void trx_fields(Table *table, Field &begin_xid_field, Field &end_xid_field) const;
@@ -111,5 +128,6 @@ private:
   int32_t           trx_id_     = -1;
   bool              started_    = false;
   bool              recovering_ = false;
+  atomic<LSN>       begin_lsn_{0};
   OperationSet      operations_;
 };
@@ -129,6 +129,13 @@ public:
 
   virtual LogReplayer *create_log_replayer(Db &db, LogHandler &log_handler) = 0;
 
+  /**
+   * @brief 活跃事务中最小的开始LSN
+   * @details 做检查点时使用。恢复时要从这里开始回放，才能拿到活跃事务的所有日志，以便回滚没有提交的事务
+   * @return 没有记录日志的活跃事务时返回0
+   */
+  virtual LSN min_recovery_lsn() { return 0; }
+
 public:
   static TrxKit *create(const char *name, Db *db);
 };
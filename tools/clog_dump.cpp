@@ -113,7 +113,7 @@ void dump_file(const filesystem::path &filepath)
 void dump_directory(const filesystem::path &directory)
 {
   LogFileManager log_file_manager;
-  RC             rc = log_file_manager.init(directory.c_str(), 1);
+  RC             rc = log_file_manager.init(directory.c_str(), 0 /*file_size*/);
   if (OB_FAIL(rc)) {
     printf("failed to init log file manager. rc = %s\n", strrc(rc));
     return;
@@ -0,0 +1,143 @@
+/* Copyright (c) 2021 OceanBase and/or its affiliates. All rights reserved.
+miniob is licensed under Mulan PSL v2.
+You can use this software according to the terms and conditions of the Mulan PSL v2.
+You may obtain a copy of Mulan PSL v2 at:
+         http://license.coscl.org.cn/MulanPSL2
+THIS SOFTWARE IS PROVIDED ON AN "AS IS" BASIS, WITHOUT WARRANTIES OF ANY KIND,
+EITHER EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO NON-INFRINGEMENT,
+MERCHANTABILITY OR FIT FOR A PARTICULAR PURPOSE.
+See the Mulan PSL v2 for more details. */
+
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gtest/gtest.h"
+#include "common/io/async_io.h"
+#include "common/lang/atomic.h"
+#include "common/lang/filesystem.h"
+#include "common/lang/thread.h"
+
+using namespace common;
+
+static const size_t BLOCK_SIZE = 4096;
+
+static void fill_block(char *buf, int index) { memset(buf, 'a' + index % 26, BLOCK_SIZE); }
+
+static void test_engine(AsyncIOEngine &engine, const char *file_name)
+{
+  filesystem::remove(file_name);
+  int fd = ::open(file_name, O_RDWR | O_CREAT, 0644);
+  ASSERT_GE(fd, 0);
+
+  const int    block_num = 64;
+  vector<char> write_data(block_num * BLOCK_SIZE);
+  vector<char> read_data(block_num * BLOCK_SIZE);
+  for (int i = 0; i < block_num; i++) {
+    fill_block(write_data.data() + i * BLOCK_SIZE, i);
+  }
+
+  // 一批写请求加上后面的 fsync，fsync 要等前面的写完成
+  AsyncIOBatch batch;
+  for (int i = 0; i < block_num; i++) {
+    batch.add_write(fd, write_data.data() + i * BLOCK_SIZE, BLOCK_SIZE, i * BLOCK_SIZE);
+  }
+  batch.add_fsync(fd);
+  engine.submit(batch);
+  ASSERT_EQ(0, batch.wait());
+
+  // 单个缓冲区的读和多个缓冲区的读
+  batch.clear();
+  for (int i = 0; i < block_num / 2; i++) {
+    batch.add_read(fd, read_data.data() + i * BLOCK_SIZE, BLOCK_SIZE, i * BLOCK_SIZE);
+  }
+  vector<iovec> iovs;
+  for (int i = block_num / 2; i < block_num; i++) {
+    iovs.push_back(iovec{read_data.data() + i * BLOCK_SIZE, BLOCK_SIZE});
+  }
+  batch.add_readv(fd, iovs.data(), static_cast<int>(iovs.size()), block_num / 2 * BLOCK_SIZE);
+  ASSERT_EQ(0, engine.execute(batch));
+  ASSERT_EQ(0, memcmp(write_data.data(), read_data.data(), write_data.size()));
+
+  // 读到文件尾
+  batch.clear();
+  batch.add_read(fd, read_data.data(), BLOCK_SIZE, block_num * BLOCK_SIZE);
+  ASSERT_EQ(-1, engine.execute(batch));
+
+  // 无效的描述符
+  batch.clear();
+  batch.add_read(-1, read_data.data(), BLOCK_SIZE, 0);
+  batch.add_read(fd, read_data.data(), BLOCK_SIZE, 0);
+  ASSERT_EQ(EBADF, engine.execute(batch));
+
+  // 前面一组请求失败了，后面的 fsync 和写都不能执行
+  batch.clear();
+  batch.add_write(-1, write_data.data(), BLOCK_SIZE, 0);
+  batch.add_fsync(fd);
+  batch.add_write(fd, write_data.data(), BLOCK_SIZE, block_num * BLOCK_SIZE);
+  ASSERT_EQ(EBADF, engine.execute(batch));
+  ASSERT_EQ(static_cast<int64_t>(block_num * BLOCK_SIZE), static_cast<int64_t>(filesystem::file_size(file_name)));
+
+  // 多个线程同时提交
+  vector<thread> threads;
+  atomic<int>    failed_num{0};
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&engine, &write_data, fd, &failed_num]() {
+      vector<char> buf(BLOCK_SIZE);
+      for (int i = 0; i < 100; i++) {
+        AsyncIOBatch batch;
+        const int    block = i % block_num;
+        batch.add_read(fd, buf.data(), BLOCK_SIZE, block * BLOCK_SIZE);
+        batch.add_read(fd, buf.data(), BLOCK_SIZE, block * BLOCK_SIZE);
+        if (engine.execute(batch) != 0 || memcmp(buf.data(), write_data.data() + block * BLOCK_SIZE, BLOCK_SIZE) != 0) {
+          failed_num++;
+        }
+      }
+    });
+  }
+  for (thread &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0, failed_num.load());
+
+  ::close(fd);
+  filesystem::remove(file_name);
+}
+
+TEST(AsyncIO, thread_pool)
+{
+  AsyncIOOptions options;
+  options.type       = AsyncIOType::THREAD_POOL;
+  options.thread_num = 4;
+
+  unique_ptr<AsyncIOEngine> engine = AsyncIOEngine::create(options);
+  ASSERT_EQ(AsyncIOType::THREAD_POOL, engine->type());
+  test_engine(*engine, "async_io_thread_pool.data");
+}
+
+TEST(AsyncIO, io_uring)
+{
+  // 内核不支持 io_uring 时会使用线程池，测试的结果应该是一样的
+  AsyncIOOptions options;
+  options.type        = AsyncIOType::IO_URING;
+  options.queue_depth = 16;
+
+  unique_ptr<AsyncIOEngine> engine = AsyncIOEngine::create(options);
+  test_engine(*engine, "async_io_uring.data");
+}
+
+TEST(AsyncIO, type_from_name)
+{
+  AsyncIOType type = AsyncIOType::THREAD_POOL;
+  ASSERT_TRUE(async_io_type_from_name("IO_URING", type));
+  ASSERT_EQ(AsyncIOType::IO_URING, type);
+  ASSERT_TRUE(async_io_type_from_name("thread_pool", type));
+  ASSERT_EQ(AsyncIOType::THREAD_POOL, type);
+  ASSERT_FALSE(async_io_type_from_name("aio", type));
+}
+
+int main(int argc, char **argv)
+{
+  testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
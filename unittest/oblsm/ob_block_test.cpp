@@ -13,10 +13,11 @@ See the Mulan PSL v2 for more details. */
 #include "oblsm/table/ob_block.h"
 #include "oblsm/table/ob_block_builder.h"
 #include "oblsm/util/ob_comparator.h"
+#include "oblsm/util/ob_coding.h"
 
 using namespace oceanbase;
 
-TEST(block_test, DISABLED_block_builder_test_basic)
+TEST(block_test, block_builder_test_basic)
 {
   ObBlockBuilder builder;
   ObDefaultComparator comparator;
@@ -33,7 +34,7 @@ TEST(block_test, DISABLED_block_builder_test_basic)
   ASSERT_EQ(block.size(), 4);
 }
 
-TEST(block_test, DISABLED_block_iterator_test_basic)
+TEST(block_test, block_iterator_test_basic)
 {
   ObBlockBuilder builder;
   ObDefaultComparator comparator;
@@ -48,7 +49,7 @@ TEST(block_test, DISABLED_block_iterator_test_basic)
   ObBlock block(&comparator);
   block.decode(string(block_contents.data(), block_contents.size()));
   ASSERT_EQ(block.size(), 4);
-  BlockIterator iter(&comparator, &block, block.size());
+  BlockIterator iter(&comparator, &block);
   iter.seek_to_first();
   ASSERT_TRUE(iter.valid());
   ASSERT_EQ(iter.key(), "key1");
@@ -59,6 +60,90 @@ TEST(block_test, DISABLED_block_iterator_test_basic)
   }
 }
 
+static string internal_key(const string &user_key, uint64_t seq)
+{
+  string key = user_key;
+  put_numeric<uint64_t>(&key, seq);
+  return key;
+}
+
+static string lookup_key(const string &user_key, uint64_t seq)
+{
+  string key;
+  put_numeric<size_t>(&key, user_key.size() + SEQ_SIZE);
+  key.append(internal_key(user_key, seq));
+  return key;
+}
+
+TEST(block_test, block_prefix_compression_and_seek)
+{
+  ObDefaultComparator comparator;
+  ObBlockBuilder      builder(4);
+  vector<string>      user_keys;
+  // two versions of each key, the newer one first
+  for (int i = 0; i < 50; i++) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "common_prefix_key_%04d", i * 2);
+    user_keys.push_back(buf);
+    ASSERT_EQ(builder.add(internal_key(buf, 10), "new" + to_string(i)), RC::SUCCESS);
+    ASSERT_EQ(builder.add(internal_key(buf, 5), "old" + to_string(i)), RC::SUCCESS);
+  }
+  ASSERT_EQ(builder.last_key(), internal_key(user_keys.back(), 5));
+  string_view block_contents = builder.finish();
+  // the shared prefixes are not stored repeatedly
+  ASSERT_LT(block_contents.size(), 100 * (user_keys[0].size() + SEQ_SIZE));
+
+  ObBlock block(&comparator);
+  ASSERT_EQ(block.decode(string(block_contents.data(), block_contents.size())), RC::SUCCESS);
+  ASSERT_EQ(block.size(), 100);
+  ASSERT_EQ(block.restart_count(), 25);
+
+  BlockIterator iter(&comparator, &block);
+  int           count = 0;
+  for (iter.seek_to_first(); iter.valid(); iter.next(), count++) {
+    ASSERT_EQ(iter.key(), internal_key(user_keys[count / 2], count % 2 == 0 ? 10 : 5));
+  }
+  ASSERT_EQ(count, 100);
+  iter.seek_to_last();
+  ASSERT_TRUE(iter.valid());
+  ASSERT_EQ(iter.key(), internal_key(user_keys.back(), 5));
+
+  for (int i = 0; i < 50; i++) {
+    iter.seek(lookup_key(user_keys[i], 20));
+    ASSERT_TRUE(iter.valid());
+    ASSERT_EQ(iter.value(), "new" + to_string(i));
+    // the newer version is skipped
+    iter.seek(lookup_key(user_keys[i], 7));
+    ASSERT_TRUE(iter.valid());
+    ASSERT_EQ(iter.value(), "old" + to_string(i));
+    // a missing key is positioned at the next key
+    iter.seek(lookup_key(user_keys[i] + "x", 20));
+    if (i == 49) {
+      ASSERT_FALSE(iter.valid());
+    } else {
+      ASSERT_TRUE(iter.valid());
+      ASSERT_EQ(iter.key(), internal_key(user_keys[i + 1], 10));
+    }
+  }
+  iter.seek(lookup_key("a", 20));
+  ASSERT_TRUE(iter.valid());
+  ASSERT_EQ(iter.key(), internal_key(user_keys[0], 10));
+}
+
+TEST(block_test, block_checksum_mismatch)
+{
+  ObDefaultComparator comparator;
+  ObBlockBuilder      builder;
+  builder.add(internal_key("key1", 1), "value1");
+  builder.add(internal_key("key2", 1), "value2");
+  string_view block_contents = builder.finish();
+
+  string data(block_contents.data(), block_contents.size());
+  data[3] ^= 0x1;
+  ObBlock block(&comparator);
+  ASSERT_NE(block.decode(data), RC::SUCCESS);
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
@@ -15,13 +15,13 @@ See the Mulan PSL v2 for more details. */
 
 using namespace oceanbase;
 
-TEST(BloomfilterTest, DISABLED_ConstructorTest) {
+TEST(BloomfilterTest, ConstructorTest) {
     ObBloomfilter bf(4);
     EXPECT_TRUE(bf.empty());
     EXPECT_EQ(bf.object_count(), 0);
 }
 
-TEST(BloomfilterTest, DISABLED_InsertAndContainsTest) {
+TEST(BloomfilterTest, InsertAndContainsTest) {
     ObBloomfilter bf(4);
 
     bf.insert("database");
@@ -34,7 +34,7 @@ TEST(BloomfilterTest, DISABLED_InsertAndContainsTest) {
     EXPECT_EQ(bf.object_count(), 2);
 }
 
-TEST(BloomfilterTest, DISABLED_ClearTest) {
+TEST(BloomfilterTest, ClearTest) {
     ObBloomfilter bf(4);
 
     bf.insert("bloom");
@@ -47,7 +47,7 @@ TEST(BloomfilterTest, DISABLED_ClearTest) {
     EXPECT_EQ(bf.object_count(), 0);
 }
 
-TEST(BloomfilterTest, DISABLED_EmptyTest) {
+TEST(BloomfilterTest, EmptyTest) {
     ObBloomfilter bf(4);
 
     EXPECT_TRUE(bf.empty());
@@ -59,7 +59,7 @@ TEST(BloomfilterTest, DISABLED_EmptyTest) {
     EXPECT_TRUE(bf.empty());
 }
 
-TEST(BloomFilterTest, DISABLED_MultiThreadInsertTest) {
+TEST(BloomFilterTest, MultiThreadInsertTest) {
     ObBloomfilter bloom_filter;
     const size_t thread_count = 10;
     const size_t insertions_per_thread = 1000;
@@ -85,6 +85,38 @@ TEST(BloomFilterTest, DISABLED_MultiThreadInsertTest) {
     EXPECT_FALSE(bloom_filter.contains("non_existent_item"));
 }
 
+TEST(BloomFilterTest, EncodeDecodeTest) {
+    ObBloomfilter bf = ObBloomfilter::create(1000, 10);
+    for (size_t i = 0; i < 1000; ++i) {
+        bf.insert("key" + std::to_string(i));
+    }
+
+    ObBloomfilter decoded;
+    ASSERT_EQ(decoded.decode(bf.encode()), RC::SUCCESS);
+    EXPECT_EQ(decoded.object_count(), 1000);
+    for (size_t i = 0; i < 1000; ++i) {
+        EXPECT_TRUE(decoded.contains("key" + std::to_string(i)));
+    }
+    EXPECT_NE(decoded.decode("bad"), RC::SUCCESS);
+}
+
+TEST(BloomFilterTest, FalsePositiveRateTest) {
+    const size_t  key_count = 10000;
+    ObBloomfilter bf        = ObBloomfilter::create(key_count, 10);
+    for (size_t i = 0; i < key_count; ++i) {
+        bf.insert("key" + std::to_string(i));
+    }
+
+    size_t false_positives = 0;
+    for (size_t i = 0; i < key_count; ++i) {
+        if (bf.contains("other" + std::to_string(i))) {
+            false_positives++;
+        }
+    }
+    // about 1% with 10 bits per key, the blocked layout costs a little more.
+    EXPECT_LT(false_positives, key_count * 3 / 100);
+}
+
 int main(int argc, char **argv)
 {
   ::testing::InitGoogleTest(&argc, argv);
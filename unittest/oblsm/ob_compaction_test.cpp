@@ -70,7 +70,7 @@ bool check_compaction(ObLsm* lsm)
   return true;
 }
 
-TEST_P(ObLsmCompactionTest, DISABLED_oblsm_compaction_test_basic1)
+TEST_P(ObLsmCompactionTest, oblsm_compaction_test_basic1)
 {
   size_t num_entries = GetParam();
   auto data = KeyValueGenerator::generate_data(num_entries);
@@ -100,7 +100,7 @@ void thread_put(ObLsm *db, int start, int end) {
   }
 }
 
-TEST_P(ObLsmCompactionTest, DISABLED_ConcurrentPutAndGetTest) {
+TEST_P(ObLsmCompactionTest, ConcurrentPutAndGetTest) {
   const int num_entries = GetParam();
   const int num_threads = 4;
   const int batch_size = num_entries / num_threads;
@@ -142,6 +142,163 @@ TEST_P(ObLsmCompactionTest, DISABLED_ConcurrentPutAndGetTest) {
   ASSERT_TRUE(check_compaction(db));
 }
 
+TEST_P(ObLsmCompactionTest, RecoverAfterCompactionTest)
+{
+  size_t num_entries = GetParam();
+  auto   data        = KeyValueGenerator::generate_data(num_entries);
+  for (const auto &[key, value] : data) {
+    ASSERT_EQ(db->put(key, value), RC::SUCCESS);
+  }
+  // wait for compaction
+  sleep(1);
+
+  auto get_sstable_ids = [](ObLsm *lsm) {
+    vector<vector<uint32_t>> ids;
+    for (const auto &level : *dynamic_cast<ObLsmImpl *>(lsm)->get_sstables()) {
+      ids.emplace_back();
+      for (const auto &sstable : level) {
+        ids.back().push_back(sstable->sst_id());
+      }
+    }
+    return ids;
+  };
+  vector<vector<uint32_t>> sstable_ids = get_sstable_ids(db);
+  delete db;
+  db = nullptr;
+
+  // the sstables are recovered from the manifest, and the compacted ones are removed from disk.
+  ASSERT_EQ(ObLsm::open(options, path, &db), RC::SUCCESS);
+  EXPECT_EQ(get_sstable_ids(db), sstable_ids);
+  size_t sstable_files = 0;
+  for (const auto &entry : filesystem::directory_iterator(path)) {
+    sstable_files += entry.path().extension() == SSTABLE_SUFFIX ? 1 : 0;
+  }
+  size_t sstable_count = 0;
+  for (const auto &level : sstable_ids) {
+    sstable_count += level.size();
+  }
+  EXPECT_EQ(sstable_files, sstable_count);
+  ASSERT_TRUE(check_compaction(db));
+
+  // all the keys in sstables are readable
+  ObLsmIterator *it = db->new_iterator(ObLsmReadOptions());
+  for (it->seek_to_first(); it->valid(); it->next()) {
+    string value;
+    ASSERT_EQ(db->get(it->key(), &value), RC::SUCCESS);
+    EXPECT_EQ(value, it->value());
+  }
+  delete it;
+}
+
+TEST_P(ObLsmCompactionTest, SnapshotTest)
+{
+  size_t num_entries = GetParam();
+  auto   data        = KeyValueGenerator::generate_data(num_entries);
+  for (const auto &[key, value] : data) {
+    ASSERT_EQ(db->put(key, value), RC::SUCCESS);
+  }
+  map<string, string> values(data.begin(), data.end());
+
+  // the old versions are still visible to the snapshot after they are overwritten and compacted.
+  uint64_t snapshot = db->get_snapshot();
+  for (const auto &[key, value] : data) {
+    ASSERT_EQ(db->put(key, value + "-new"), RC::SUCCESS);
+  }
+  // wait for compaction
+  sleep(1);
+
+  ObLsmReadOptions read_options;
+  read_options.seq  = static_cast<int64_t>(snapshot);
+  ObLsmIterator *it = db->new_iterator(read_options);
+  size_t         count = 0;
+  for (it->seek_to_first(); it->valid(); it->next()) {
+    auto iter = values.find(string(it->key()));
+    ASSERT_NE(iter, values.end());
+    EXPECT_EQ(iter->second, it->value());
+    ++count;
+  }
+  EXPECT_EQ(count, data.size());
+  delete it;
+  db->release_snapshot(snapshot);
+
+  it    = db->new_iterator(ObLsmReadOptions());
+  count = 0;
+  for (it->seek_to_first(); it->valid(); it->next()) {
+    EXPECT_EQ(values[string(it->key())] + "-new", it->value());
+    ++count;
+  }
+  EXPECT_EQ(count, values.size());
+  delete it;
+}
+
+TEST_F(ObLsmCompactionTest, SnapshotVersionsInOneTableTest)
+{
+  // the versions kept for a snapshot are larger than an output table, compact them down twice.
+  delete db;
+  options.table_size            = 1024;
+  options.default_l1_level_size = 4 * 1024;
+  filesystem::remove_all(path);
+  filesystem::create_directory(path);
+  ASSERT_EQ(ObLsm::open(options, path, &db), RC::SUCCESS);
+
+  const string   hot_key  = "hot_key";
+  const uint64_t snapshot = db->get_snapshot();
+  string         last_value;
+  for (int i = 0; i < 500; i++) {
+    last_value = "value_of_" + hot_key + "_" + to_string(i) + string(64, 'x');
+    ASSERT_EQ(db->put(hot_key, last_value), RC::SUCCESS);
+  }
+  // push the versions of the hot key out of the memtables and down the levels
+  for (int i = 0; i < 4000; i++) {
+    ASSERT_EQ(db->put("key" + to_string(i), "value" + to_string(i) + string(64, 'x')), RC::SUCCESS);
+  }
+  // wait for compaction
+  sleep(1);
+
+  ObLsmImpl *lsm_impl = dynamic_cast<ObLsmImpl *>(db);
+  ASSERT_NE(lsm_impl, nullptr);
+  auto sstables = lsm_impl->get_sstables();
+  ASSERT_GT(sstables->size(), 2UL);
+  ASSERT_FALSE(sstables->at(2).empty());
+
+  string value;
+  ASSERT_EQ(db->get(hot_key, &value), RC::SUCCESS);
+  EXPECT_EQ(value, last_value);
+  db->release_snapshot(snapshot);
+}
+
+TEST_P(ObLsmCompactionTest, WriteStallTest)
+{
+  // compaction is throttled, so the writers have to be slowed down and stopped.
+  delete db;
+  options.force_sync_new_log         = false;
+  options.background_write_rate      = 512 * 1024;
+  options.l0_slowdown_writes_trigger = 4;
+  options.l0_stop_writes_trigger     = 6;
+  filesystem::remove_all(path);
+  filesystem::create_directory(path);
+  ASSERT_EQ(ObLsm::open(options, path, &db), RC::SUCCESS);
+
+  size_t num_entries = std::min<size_t>(GetParam(), 10000);
+  auto   data        = KeyValueGenerator::generate_data(num_entries);
+  for (const auto &[key, value] : data) {
+    ASSERT_EQ(db->put(key, value), RC::SUCCESS);
+    EXPECT_LE(dynamic_cast<ObLsmImpl *>(db)->get_sstables()->at(0).size(), options.l0_stop_writes_trigger + 1);
+  }
+
+  ObLsmWriteStallStats stats = db->write_stall_stats();
+  if (num_entries >= 10000) {
+    EXPECT_GT(stats.l0_slowdown_count + stats.l0_stop_count, 0UL);
+    EXPECT_GT(stats.stall_micros, 0UL);
+  }
+
+  for (const auto &[key, value] : data) {
+    string result;
+    ASSERT_EQ(db->get(key, &result), RC::SUCCESS);
+    EXPECT_EQ(result, value);
+  }
+}
+
 INSTANTIATE_TEST_SUITE_P(
     ObLsmCompactionTests,
     ObLsmCompactionTest,
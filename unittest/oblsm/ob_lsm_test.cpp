@@ -23,7 +23,7 @@ class ObLsmTest : public ObLsmTestBase {
 };
 
 // TODO: add update/delete case
-TEST_P(ObLsmTest, DISABLED_oblsm_test_basic1)
+TEST_P(ObLsmTest, oblsm_test_basic1)
 {
   size_t num_entries = GetParam();
   auto data = KeyValueGenerator::generate_data(num_entries);
@@ -59,6 +59,25 @@ TEST_P(ObLsmTest, DISABLED_oblsm_test_basic1)
   delete it2;  
 }
 
+TEST_P(ObLsmTest, get_newest_version)
+{
+  size_t num_entries = GetParam();
+  // every key is written twice, the versions are spread in memtables and sstables.
+  for (int round = 0; round < 2; ++round) {
+    for (size_t i = 0; i < num_entries; ++i) {
+      ASSERT_EQ(db->put("key" + to_string(i), "value" + to_string(i) + "_" + to_string(round)), RC::SUCCESS);
+    }
+  }
+
+  string value;
+  for (size_t i = 0; i < num_entries; ++i) {
+    ASSERT_EQ(db->get("key" + to_string(i), &value), RC::SUCCESS);
+    EXPECT_EQ(value, "value" + to_string(i) + "_1");
+  }
+  EXPECT_EQ(db->get("key_not_exist", &value), RC::NOT_EXIST);
+  EXPECT_EQ(db->get("key" + to_string(num_entries), &value), RC::NOT_EXIST);
+}
+
 void thread_put(ObLsm *db, int start, int end) {
   for (int i = start; i < end; ++i) {
     const std::string key = "key" + std::to_string(i);
@@ -67,7 +86,7 @@ void thread_put(ObLsm *db, int start, int end) {
   }
 }
 
-TEST_P(ObLsmTest, DISABLED_ConcurrentPutAndGetTest) {
+TEST_P(ObLsmTest, ConcurrentPutAndGetTest) {
   const int num_entries = GetParam();
   const int num_threads = 4;
   const int batch_size = num_entries / num_threads;
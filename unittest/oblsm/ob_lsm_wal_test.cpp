@@ -13,6 +13,7 @@ See the Mulan PSL v2 for more details. */
 #include "gtest/gtest.h"
 
 #include "common/lang/filesystem.h"
+#include "common/lang/thread.h"
 #include "oblsm/wal/ob_lsm_wal.h"
 #include "oblsm/include/ob_lsm.h"
 #include "oblsm/include/ob_lsm_options.h"
@@ -20,7 +21,7 @@ See the Mulan PSL v2 for more details. */
 
 using namespace oceanbase;
 
-TEST(wal, DISABLED_basic_test)
+TEST(wal, basic_test)
 {
   filesystem::remove_all("oblsm_tmp");
   filesystem::create_directory("oblsm_tmp");
@@ -53,6 +54,51 @@ TEST(wal, DISABLED_basic_test)
   EXPECT_EQ(p, count);
 }
 
+TEST(wal, group_commit_test)
+{
+  filesystem::remove_all("oblsm_tmp");
+  filesystem::create_directory("oblsm_tmp");
+  auto path    = filesystem::path("oblsm_tmp");
+  auto rw_file = path / "tmp.wal";
+  WAL  wal;
+  EXPECT_EQ(wal.open(rw_file), RC::SUCCESS);
+
+  const int      thread_num = 8;
+  const int      batch_size = 10;
+  const int      count      = 1000;
+  vector<thread> threads;
+  for (int t = 0; t < thread_num; ++t) {
+    threads.emplace_back([&wal, t]() {
+      uint64_t base = static_cast<uint64_t>(t) * count * 2;
+      for (int i = 0; i < count; ++i) {
+        EXPECT_EQ(wal.put(base + i, "key" + std::to_string(base + i), "val", i % 2 == 0 /*sync*/), RC::SUCCESS);
+      }
+      for (int i = count; i < count * 2; i += batch_size) {
+        vector<pair<string, string>> kvs;
+        for (int j = 0; j < batch_size; ++j) {
+          kvs.emplace_back("key" + std::to_string(base + i + j), "val");
+        }
+        EXPECT_EQ(wal.batch_put(base + i, kvs, true /*sync*/), RC::SUCCESS);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  std::vector<WalRecord> records;
+  EXPECT_EQ(wal.recover(rw_file, records), RC::SUCCESS);
+  ASSERT_EQ(records.size(), static_cast<size_t>(thread_num * count * 2));
+  vector<bool> seen(records.size(), false);
+  for (auto &[seq, k, v] : records) {
+    ASSERT_LT(seq, seen.size());
+    EXPECT_FALSE(seen[seq]);
+    seen[seq] = true;
+    EXPECT_EQ(k, "key" + std::to_string(seq));
+    EXPECT_EQ(v, "val");
+  }
+}
+
 TEST(oblsm_wal_test, DISABLED_oblsm_recover_with_small_amount_of_data)
 {
   filesystem::remove_all("oblsm_tmp");
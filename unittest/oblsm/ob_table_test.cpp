@@ -14,10 +14,11 @@ See the Mulan PSL v2 for more details. */
 #include "oblsm/util/ob_comparator.h"
 #include "oblsm/table/ob_sstable_builder.h"
 #include "oblsm/table/ob_sstable.h"
+#include "oblsm/util/ob_coding.h"
 
 using namespace oceanbase;
 
-TEST(table_test, DISABLED_table_test_basic)
+TEST(table_test, table_test_basic)
 {
   ObDefaultComparator comparator;
   shared_ptr<ObMemTable> table = make_shared<ObMemTable>();
@@ -38,8 +39,92 @@ TEST(table_test, DISABLED_table_test_basic)
   }
   delete sst_iter;
 
+  for (size_t i = 0; i < count; i++) {
+    EXPECT_TRUE(sst->may_contain(to_string(i)));
+  }
+  EXPECT_FALSE(sst->may_contain("not_exist_key"));
 }
 
+TEST(table_test, table_test_compression)
+{
+  ObDefaultComparator    comparator;
+  shared_ptr<ObMemTable> table = make_shared<ObMemTable>();
+  uint64_t               seq   = 0;
+  size_t                 count = 5000;
+  for (size_t i = 0; i < count; i++) {
+    string key = "key" + to_string(i);
+    table->put(seq++, key, "value_of_" + key + string(64, 'v'));
+  }
+
+  size_t file_size[2];
+  for (ObCompressionType compression : {ObCompressionType::NONE, ObCompressionType::LZ4}) {
+    ObSSTableBuilder tb(&comparator, nullptr);
+    tb.set_compression(compression);
+    ASSERT_EQ(tb.build(table, "test.sst", 0), RC::SUCCESS);
+    file_size[static_cast<int>(compression)] = tb.file_size();
+
+    shared_ptr<ObSSTable>     sst = tb.get_built_table();
+    unique_ptr<ObLsmIterator> sst_iter(sst->new_iterator());
+    unique_ptr<ObLsmIterator> mem_iter(table->new_iterator());
+    size_t                    n = 0;
+    for (sst_iter->seek_to_first(), mem_iter->seek_to_first(); sst_iter->valid(); sst_iter->next(), mem_iter->next()) {
+      ASSERT_TRUE(mem_iter->valid());
+      ASSERT_EQ(sst_iter->key(), mem_iter->key());
+      ASSERT_EQ(sst_iter->value(), mem_iter->value());
+      n++;
+    }
+    ASSERT_EQ(n, count);
+  }
+  filesystem::remove("test.sst");
+  EXPECT_LT(file_size[1], file_size[0] / 2);
+}
+TEST(table_test, table_test_mmap)
+{
+  ObDefaultComparator    comparator;
+  shared_ptr<ObMemTable> table = make_shared<ObMemTable>();
+  uint64_t               seq   = 0;
+  size_t                 count = 2000;
+  for (size_t i = 0; i < count; i++) {
+    string key = "key" + to_string(i);
+    table->put(seq++, key, "value_of_" + key);
+  }
+
+  ObLRUCache<uint64_t, shared_ptr<ObBlock>> cache(1024 * 1024);
+  ObLsmOptions                              options;
+  options.use_mmap_reads = true;
+  for (ObCompressionType compression : {ObCompressionType::NONE, ObCompressionType::LZ4}) {
+    ObSSTableBuilder tb(&comparator, &cache, options);
+    tb.set_compression(compression);
+    ASSERT_EQ(tb.build(table, "test.sst", static_cast<uint32_t>(compression)), RC::SUCCESS);
+    shared_ptr<ObSSTable> sst = tb.get_built_table();
+    for (size_t i = 0; i < count; i++) {
+      string key = "key" + to_string(i);
+      string lookup_key;
+      put_numeric<uint64_t>(&lookup_key, key.size() + SEQ_SIZE);
+      lookup_key.append(key);
+      put_numeric<uint64_t>(&lookup_key, seq);
+      string value;
+      ASSERT_EQ(sst->get(lookup_key, &value), RC::SUCCESS);
+      ASSERT_EQ(value, "value_of_" + key);
+    }
+    ObLRUCache<uint64_t, shared_ptr<ObBlock>>::Handle handle;
+    ASSERT_EQ(sst->read_block_with_cache(0, handle), RC::SUCCESS);
+    const shared_ptr<ObBlock> &block = handle.value();
+    // the uncompressed blocks reference the mapped file
+    if (compression == ObCompressionType::NONE) {
+      EXPECT_EQ(block->memory_size(), sizeof(ObBlock));
+    } else {
+      EXPECT_GT(block->memory_size(), sizeof(ObBlock));
+    }
+    // the pinned block keeps the mapping alive after the sstable is gone
+    sst.reset();
+    unique_ptr<ObLsmIterator> iter(block->new_iterator());
+    iter->seek_to_first();
+    ASSERT_TRUE(iter->valid());
+    EXPECT_EQ(extract_user_key(iter->key()), "key0");
+  }
+  filesystem::remove("test.sst");
+}
 
 int main(int argc, char **argv)
 {
@@ -13,8 +13,13 @@ See the Mulan PSL v2 for more details. */
 #include <filesystem>
 
 #include "oblsm/util/ob_comparator.h"
+#include "oblsm/util/ob_compression.h"
 #include "oblsm/util/ob_file_reader.h"
 #include "oblsm/util/ob_file_writer.h"
+#include "oblsm/util/ob_rate_limiter.h"
+#include "common/lang/chrono.h"
+#include "common/lang/thread.h"
+#include "common/lang/vector.h"
 #include "common/lang/filesystem.h"
 
 using namespace oceanbase;
@@ -49,6 +54,77 @@ TEST(util_test, DISABLED_rw_file) {
   remove("tmpfile");
 }
 
+TEST(util_test, rate_limiter)
+{
+  const int64_t rate = 1024 * 1024;
+  ObRateLimiter limiter(rate);
+  // the bucket is full at start, it holds the tokens of 100ms.
+  auto start = chrono::steady_clock::now();
+  limiter.request(rate / 10);
+  EXPECT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(50));
+
+  // 4 threads request 0.4s worth of tokens
+  start = chrono::steady_clock::now();
+  vector<thread> threads;
+  for (int i = 0; i < 4; i++) {
+    threads.emplace_back([&limiter]() {
+      for (int j = 0; j < 10; j++) {
+        limiter.request(rate / 100);
+      }
+    });
+  }
+  for (auto &t : threads) {
+    t.join();
+  }
+  auto elapsed = chrono::steady_clock::now() - start;
+  EXPECT_GE(elapsed, chrono::milliseconds(350));
+  EXPECT_LT(elapsed, chrono::milliseconds(1000));
+  EXPECT_EQ(limiter.total_bytes(), rate / 10 + rate / 100 * 40);
+  EXPECT_GT(limiter.total_wait_micros(), 0);
+
+  // unlimited
+  limiter.set_bytes_per_second(0);
+  start = chrono::steady_clock::now();
+  limiter.request(rate * 100);
+  EXPECT_LT(chrono::steady_clock::now() - start, chrono::milliseconds(50));
+}
+
+TEST(util_test, lz4_compression)
+{
+  const ObCompressor *compressor = ObCompressor::get(ObCompressionType::LZ4);
+  ASSERT_NE(compressor, nullptr);
+  ASSERT_EQ(ObCompressor::get(ObCompressionType::NONE), nullptr);
+
+  vector<string> inputs = {"", "a", "abcdefghijklmnop", string(100000, 'x')};
+  // rows with repeated field names and small numbers, like the records of a table
+  string rows;
+  for (int i = 0; i < 2000; i++) {
+    rows += "id=" + to_string(i) + ",name=name_" + to_string(i % 37) + ",score=" + to_string(i * 7 % 100) + ";";
+  }
+  inputs.push_back(rows);
+  string random_bytes;
+  srand(1);
+  for (int i = 0; i < 10000; i++) {
+    random_bytes.push_back(static_cast<char>(rand()));
+  }
+  inputs.push_back(random_bytes);
+
+  for (const string &input : inputs) {
+    string compressed;
+    string output;
+    compressor->compress(input, &compressed);
+    ASSERT_EQ(compressor->decompress(compressed, &output), RC::SUCCESS);
+    ASSERT_EQ(output, input);
+  }
+
+  string compressed;
+  compressor->compress(rows, &compressed);
+  EXPECT_LT(compressed.size(), rows.size() / 2);
+
+  // truncated data is detected
+  string output;
+  EXPECT_NE(compressor->decompress(string_view(compressed.data(), compressed.size() / 2), &output), RC::SUCCESS);
+}
 
 int main(int argc, char **argv)
 {
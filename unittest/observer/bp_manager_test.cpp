@@ -116,7 +116,7 @@ void test_alloc(BPFrameManager &frame_manager)
 TEST(test_frame_manager, test_frame_manager_simple_lru)
 {
   BPFrameManager frame_manager("Test");
-  frame_manager.init(2);
+  frame_manager.init(2, BPReplacerType::LRU);
 
   test_get(frame_manager);
 
@@ -125,6 +125,194 @@ TEST(test_frame_manager, test_frame_manager_simple_lru)
   frame_manager.cleanup();
 }
 
+TEST(test_frame_manager, test_frame_manager_clock_and_2q)
+{
+  for (BPReplacerType type : {BPReplacerType::CLOCK, BPReplacerType::TWO_Q}) {
+    BPFrameManager frame_manager("Test");
+    frame_manager.init(2, type);
+
+    test_get(frame_manager);
+
+    test_alloc(frame_manager);
+
+    frame_manager.cleanup();
+  }
+}
+
+/**
+ * 先访问两次一些热点页面，然后顺序扫描很多页面，每扫描 reaccess_interval 个页面再访问一次热点页面，
+ * 返回扫描结束后还在内存中的热点页面个数
+ */
+int hot_pages_after_scan(BPReplacerType type, int reaccess_interval)
+{
+  // 只使用一个分片，淘汰的顺序就是淘汰策略给出的顺序
+  BPFrameManager frame_manager("Test", 1 /*shard_num*/);
+  frame_manager.init(1, type);
+
+  const int buffer_pool_id = 0;
+  const int hot_page_num   = 16;
+  auto      purger         = [](Frame *) { return RC::SUCCESS; };
+  auto      access         = [&](PageNum page_num, BPAccessHint hint) {
+    Frame *frame = frame_manager.alloc(buffer_pool_id, page_num, hint);
+    while (frame == nullptr) {
+      frame_manager.purge_frames(1, purger);
+      frame = frame_manager.alloc(buffer_pool_id, page_num, hint);
+    }
+    frame->unpin();
+  };
+
+  for (int i = 0; i < 2; i++) {
+    for (PageNum page_num = 0; page_num < hot_page_num; page_num++) {
+      access(page_num, BPAccessHint::NORMAL);
+    }
+  }
+
+  const int scan_page_num = static_cast<int>(frame_manager.total_frame_num()) * 8;
+  for (PageNum page_num = hot_page_num; page_num < hot_page_num + scan_page_num; page_num++) {
+    access(page_num, BPAccessHint::SCAN);
+    if (reaccess_interval > 0 && page_num % reaccess_interval == 0) {
+      for (PageNum hot_page = 0; hot_page < hot_page_num; hot_page++) {
+        Frame *frame = frame_manager.get(buffer_pool_id, hot_page);
+        if (frame != nullptr) {
+          frame->unpin();
+        }
+      }
+    }
+  }
+
+  int hot_num = 0;
+  for (PageNum page_num = 0; page_num < hot_page_num; page_num++) {
+    Frame *frame = frame_manager.get(buffer_pool_id, page_num);
+    if (frame != nullptr) {
+      hot_num++;
+      frame->unpin();
+    }
+  }
+
+  for (Frame *frame : frame_manager.find_list(buffer_pool_id)) {
+    frame_manager.free(buffer_pool_id, frame->page_num(), frame);
+  }
+  EXPECT_EQ(frame_manager.cleanup(), RC::SUCCESS);
+  return hot_num;
+}
+
+TEST(test_frame_manager, test_frame_manager_scan_resistance)
+{
+  // 扫描的页面会把 LRU 中的热点页面全部挤出去
+  EXPECT_EQ(hot_pages_after_scan(BPReplacerType::LRU, 0), 0);
+  // 2Q 中扫描的页面只会进入试用队列，即使热点页面在扫描过程中没有被访问，也不会被淘汰
+  EXPECT_EQ(hot_pages_after_scan(BPReplacerType::TWO_Q, 0), 16);
+  // CLOCK 中扫描的页面没有访问标记，在指针第一次经过时就被淘汰，热点页面只要在指针转一圈之内被访问过就不会被淘汰
+  EXPECT_EQ(hot_pages_after_scan(BPReplacerType::CLOCK, 64), 16);
+}
+
+/**
+ * 先用热点页面占满缓冲池，再换成一组新的热点页面反复访问，最后做一次顺序扫描，
+ * 返回扫描结束后还在内存中的新热点页面个数
+ */
+int new_hot_pages_after_warm_up(BPReplacerType type)
+{
+  BPFrameManager frame_manager("Test", 1 /*shard_num*/);
+  frame_manager.init(1, type);
+
+  const int buffer_pool_id = 0;
+  const int frame_num      = static_cast<int>(frame_manager.total_frame_num());
+  const int hot_page_num   = 16;
+  auto      purger         = [](Frame *) { return RC::SUCCESS; };
+  auto      access         = [&](PageNum page_num, BPAccessHint hint) {
+    Frame *frame = frame_manager.alloc(buffer_pool_id, page_num, hint);
+    while (frame == nullptr) {
+      frame_manager.purge_frames(1, purger);
+      frame = frame_manager.alloc(buffer_pool_id, page_num, hint);
+    }
+    frame->unpin();
+  };
+
+  // 旧的热点页面占满整个缓冲池
+  for (int i = 0; i < 2; i++) {
+    for (PageNum page_num = 0; page_num < frame_num; page_num++) {
+      access(page_num, BPAccessHint::NORMAL);
+    }
+  }
+
+  const PageNum new_hot_page = frame_num;
+  for (int i = 0; i < 4; i++) {
+    for (PageNum page_num = new_hot_page; page_num < new_hot_page + hot_page_num; page_num++) {
+      access(page_num, BPAccessHint::NORMAL);
+    }
+  }
+
+  const PageNum scan_page = new_hot_page + hot_page_num;
+  for (PageNum page_num = scan_page; page_num < scan_page + frame_num * 8; page_num++) {
+    access(page_num, BPAccessHint::SCAN);
+  }
+
+  int hot_num = 0;
+  for (PageNum page_num = new_hot_page; page_num < new_hot_page + hot_page_num; page_num++) {
+    Frame *frame = frame_manager.get(buffer_pool_id, page_num);
+    if (frame != nullptr) {
+      hot_num++;
+      frame->unpin();
+    }
+  }
+
+  for (Frame *frame : frame_manager.find_list(buffer_pool_id)) {
+    frame_manager.free(buffer_pool_id, frame->page_num(), frame);
+  }
+  EXPECT_EQ(frame_manager.cleanup(), RC::SUCCESS);
+  return hot_num;
+}
+
+TEST(test_frame_manager, test_2q_working_set_change)
+{
+  // 试用队列至少保留 1/4 的页帧，新的热点页面在被淘汰之前就会再次被访问，从而进入热队列
+  EXPECT_EQ(new_hot_pages_after_warm_up(BPReplacerType::TWO_Q), 16);
+}
+
+TEST(test_frame_manager, test_2q_victim_order)
+{
+  Frame        frames[4];
+  TwoQReplacer replacer;
+  for (Frame &frame : frames) {
+    replacer.insert(&frame, BPAccessHint::NORMAL);
+  }
+  // 再次访问后进入热队列，扫描访问不会进入热队列
+  replacer.access(&frames[0], BPAccessHint::NORMAL);
+  replacer.access(&frames[2], BPAccessHint::SCAN);
+
+  // 先按加入的顺序淘汰试用队列，再淘汰热队列
+  vector<Frame *> victims;
+  replacer.foreach_victim([&victims](Frame *frame) {
+    victims.push_back(frame);
+    return true;
+  });
+  vector<Frame *> expected = {&frames[1], &frames[2], &frames[3], &frames[0]};
+  ASSERT_EQ(victims, expected);
+
+  // 试用队列中的页帧不超过 1/4 时，先淘汰热队列中最久没有访问的页帧
+  replacer.access(&frames[1], BPAccessHint::NORMAL);
+  replacer.access(&frames[3], BPAccessHint::NORMAL);
+  victims.clear();
+  replacer.foreach_victim([&victims](Frame *frame) {
+    victims.push_back(frame);
+    return true;
+  });
+  expected = {&frames[0], &frames[1], &frames[3], &frames[2]};
+  ASSERT_EQ(victims, expected);
+}
+
+TEST(test_frame_manager, test_replacer_type_from_name)
+{
+  BPReplacerType type = BPReplacerType::LRU;
+  ASSERT_EQ(bp_replacer_type_from_name("clock", type), RC::SUCCESS);
+  ASSERT_EQ(type, BPReplacerType::CLOCK);
+  ASSERT_EQ(bp_replacer_type_from_name("2Q", type), RC::SUCCESS);
+  ASSERT_EQ(type, BPReplacerType::TWO_Q);
+  ASSERT_EQ(bp_replacer_type_from_name("LRU", type), RC::SUCCESS);
+  ASSERT_EQ(type, BPReplacerType::LRU);
+  ASSERT_NE(bp_replacer_type_from_name("fifo", type), RC::SUCCESS);
+}
+
 int main(int argc, char **argv)
 {
 
@@ -19,11 +19,13 @@ See the Mulan PSL v2 for more details. */
 #include "gtest/gtest.h"
 #include "storage/index/bplus_tree_log.h"
 #include "storage/index/bplus_tree.h"
+#include "storage/index/bplus_tree_bulk_loader.h"
 #include "storage/clog/disk_log_handler.h"
 #include "storage/clog/integrated_log_replayer.h"
 #include "common/math/integer_generator.h"
 #include "common/thread/thread_pool_executor.h"
 #include "storage/buffer/double_write_buffer.h"
+#include "storage/trx/vacuous_trx.h"
 
 using namespace std;
 using namespace common;
@@ -156,6 +158,175 @@ TEST(BplusTreeLog, base)
   log_handler2.reset();
 }
 
+TEST(BplusTreeLog, bulk_load)
+{
+  filesystem::path test_directory = "bplus_tree_log_test_dir";
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  const filesystem::path bp_filename  = test_directory / "bplus_tree.bp";
+  const filesystem::path bp_filename2 = test_directory / "bplus_tree2.bp";
+
+  auto bpm = make_unique<BufferPoolManager>();
+  ASSERT_EQ(RC::SUCCESS, bpm->init(make_unique<VacuousDoubleWriteBuffer>()));
+  DiskBufferPool *buffer_pool = nullptr;
+  auto            log_handler = make_unique<DiskLogHandler>();
+  ASSERT_EQ(RC::SUCCESS, bpm->create_file(bp_filename.c_str()));
+  ASSERT_EQ(RC::SUCCESS, bpm->open_file(*log_handler, bp_filename.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  filesystem::path log_directory = test_directory / "clog";
+  ASSERT_EQ(RC::SUCCESS, log_handler->init(log_directory.c_str()));
+
+  IntegratedLogReplayer log_replayer(*bpm);
+  ASSERT_EQ(RC::SUCCESS, log_handler->replay(log_replayer, 0));
+  ASSERT_EQ(RC::SUCCESS, log_handler->start());
+
+  auto bplus_tree = make_unique<BplusTreeHandler>();
+  ASSERT_EQ(RC::SUCCESS, bplus_tree->create(*log_handler, *buffer_pool, AttrType::INTS, 4));
+
+  const int   insert_num = 100000;
+  vector<int> keys(insert_num);
+  for (int i = 0; i < insert_num; i++) {
+    keys[i] = i;
+  }
+
+  random_device rd;
+  mt19937       generator(rd());
+  shuffle(keys.begin(), keys.end(), generator);
+
+  BplusTreeBulkLoader loader(*bplus_tree, bp_filename.string());
+  for (int i : keys) {
+    ASSERT_EQ(RC::SUCCESS, loader.add(reinterpret_cast<const char *>(&i), RID(i, i)));
+  }
+  ASSERT_EQ(RC::SUCCESS, loader.finish());
+
+  // 页面都还没有写到磁盘，复制出来的文件只能依靠日志恢复
+  ASSERT_EQ(log_handler->stop(), RC::SUCCESS);
+  ASSERT_EQ(log_handler->await_termination(), RC::SUCCESS);
+  ASSERT_TRUE(filesystem::copy_file(bp_filename, bp_filename2));
+
+  bplus_tree.reset();
+  bpm.reset();
+  log_handler.reset();
+
+  auto bpm2 = make_unique<BufferPoolManager>();
+  ASSERT_EQ(RC::SUCCESS, bpm2->init(make_unique<VacuousDoubleWriteBuffer>()));
+  auto            log_handler2 = make_unique<DiskLogHandler>();
+  DiskBufferPool *buffer_pool2 = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm2->open_file(*log_handler2, bp_filename2.c_str(), buffer_pool2));
+  ASSERT_NE(nullptr, buffer_pool2);
+  ASSERT_EQ(RC::SUCCESS, log_handler2->init(log_directory.c_str()));
+
+  IntegratedLogReplayer log_replayer2(*bpm2);
+  ASSERT_EQ(RC::SUCCESS, log_handler2->replay(log_replayer2, 0));
+
+  auto tree_handler2 = make_unique<BplusTreeHandler>();
+  ASSERT_EQ(RC::SUCCESS, tree_handler2->open(*log_handler2, *buffer_pool2));
+  ASSERT_TRUE(tree_handler2->validate_tree());
+
+  vector<RID> rids;
+  ASSERT_EQ(RC::SUCCESS, list_all_values(*tree_handler2, rids));
+  ASSERT_EQ(insert_num, rids.size());
+  for (int i = 0; i < insert_num; i++) {
+    ASSERT_EQ(i, rids[i].page_num);
+    ASSERT_EQ(i, rids[i].slot_num);
+  }
+
+  tree_handler2.reset();
+  bpm2.reset();
+  log_handler2.reset();
+}
+
+/*
+ * 使用多个线程回放日志。页面没有写到磁盘，复制出来的文件只能依靠日志恢复：
+ * 不需要分裂的插入只修改一个叶子节点，由回放线程并行回放；分裂会修改多个页面，在分发线程中回放
+ */
+TEST(BplusTreeLog, parallel_replay)
+{
+  filesystem::path test_directory = "bplus_tree_log_test_dir";
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  const filesystem::path bp_filename  = test_directory / "bplus_tree.bp";
+  const filesystem::path bp_filename2 = test_directory / "bplus_tree2.bp";
+
+  auto bpm = make_unique<BufferPoolManager>();
+  ASSERT_EQ(RC::SUCCESS, bpm->init(make_unique<VacuousDoubleWriteBuffer>()));
+  DiskBufferPool *buffer_pool = nullptr;
+  auto            log_handler = make_unique<DiskLogHandler>();
+  ASSERT_EQ(RC::SUCCESS, bpm->create_file(bp_filename.c_str()));
+  ASSERT_EQ(RC::SUCCESS, bpm->open_file(*log_handler, bp_filename.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  filesystem::path log_directory = test_directory / "clog";
+  ASSERT_EQ(RC::SUCCESS, log_handler->init(log_directory.c_str()));
+
+  IntegratedLogReplayer log_replayer(*bpm);
+  ASSERT_EQ(RC::SUCCESS, log_handler->replay(log_replayer, 0));
+  ASSERT_EQ(RC::SUCCESS, log_handler->start());
+
+  auto bplus_tree = make_unique<BplusTreeHandler>();
+  ASSERT_EQ(RC::SUCCESS, bplus_tree->create(*log_handler, *buffer_pool, AttrType::INTS, 4));
+
+  const int   insert_num = 10000;
+  vector<int> keys(insert_num);
+  for (int i = 0; i < insert_num; i++) {
+    keys[i] = i;
+  }
+
+  random_device rd;
+  mt19937       generator(rd());
+  shuffle(keys.begin(), keys.end(), generator);
+
+  for (int i : keys) {
+    RID rid(i, i);
+    ASSERT_EQ(RC::SUCCESS, bplus_tree->insert_entry(reinterpret_cast<const char *>(&i), &rid));
+  }
+  // 删除一半的数据，让叶子节点发生合并
+  for (int i = 0; i < insert_num / 2; i++) {
+    RID rid(keys[i], keys[i]);
+    ASSERT_EQ(RC::SUCCESS, bplus_tree->delete_entry(reinterpret_cast<const char *>(&keys[i]), &rid));
+  }
+
+  ASSERT_EQ(log_handler->stop(), RC::SUCCESS);
+  ASSERT_EQ(log_handler->await_termination(), RC::SUCCESS);
+  ASSERT_TRUE(filesystem::copy_file(bp_filename, bp_filename2));
+
+  bplus_tree.reset();
+  bpm.reset();
+  log_handler.reset();
+
+  auto bpm2 = make_unique<BufferPoolManager>();
+  ASSERT_EQ(RC::SUCCESS, bpm2->init(make_unique<VacuousDoubleWriteBuffer>()));
+  auto            log_handler2 = make_unique<DiskLogHandler>();
+  DiskBufferPool *buffer_pool2 = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm2->open_file(*log_handler2, bp_filename2.c_str(), buffer_pool2));
+  ASSERT_NE(nullptr, buffer_pool2);
+  ASSERT_EQ(RC::SUCCESS, log_handler2->init(log_directory.c_str()));
+
+  IntegratedLogReplayer log_replayer2(*bpm2, make_unique<VacuousTrxLogReplayer>(), 4 /*worker_num*/);
+  ASSERT_EQ(RC::SUCCESS, log_handler2->replay(log_replayer2, 0));
+
+  auto tree_handler2 = make_unique<BplusTreeHandler>();
+  ASSERT_EQ(RC::SUCCESS, tree_handler2->open(*log_handler2, *buffer_pool2));
+  ASSERT_TRUE(tree_handler2->validate_tree());
+
+  sort(keys.begin() + insert_num / 2, keys.end());
+  vector<RID> rids;
+  ASSERT_EQ(RC::SUCCESS, list_all_values(*tree_handler2, rids));
+  ASSERT_EQ(insert_num - insert_num / 2, rids.size());
+  for (size_t i = 0; i < rids.size(); i++) {
+    const int key = keys[insert_num / 2 + i];
+    ASSERT_EQ(key, rids[i].page_num);
+    ASSERT_EQ(key, rids[i].slot_num);
+  }
+
+  tree_handler2.reset();
+  bpm2.reset();
+  log_handler2.reset();
+}
+
 TEST(BplusTreeLog, concurrency)
 {
   filesystem::path test_directory      = "bplus_tree_log_test_dir";
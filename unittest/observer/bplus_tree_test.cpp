@@ -15,6 +15,8 @@ See the Mulan PSL v2 for more details. */
 #include <iostream>
 #include <list>
 #include <filesystem>
+#include <algorithm>
+#include <random>
 
 #include "common/log/log.h"
 #include "common/lang/memory.h"
@@ -22,6 +24,7 @@ See the Mulan PSL v2 for more details. */
 #include "sql/parser/parse_defs.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/index/bplus_tree.h"
+#include "storage/index/bplus_tree_bulk_loader.h"
 #include "storage/clog/vacuous_log_handler.h"
 #include "storage/buffer/double_write_buffer.h"
 #include "gtest/gtest.h"
@@ -518,6 +521,148 @@ TEST(test_bplus_tree, test_internal_index_node_handle)
   }
 }
 
+TEST(test_bplus_tree, test_internal_node_in_place)
+{
+  filesystem::path test_directory("bplus_tree");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directories(test_directory);
+
+  filesystem::path buffer_pool_file = test_directory / "test_internal_node_in_place.bp";
+
+  const int attr_length = 16;
+  VacuousLogHandler log_handler;
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(buffer_pool_file.c_str()));
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, buffer_pool_file.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  BplusTreeHandler tree_handler;
+  ASSERT_EQ(RC::SUCCESS, tree_handler.create(log_handler, *buffer_pool, AttrType::CHARS, attr_length, 100, 100));
+  const IndexFileHeader &header = tree_handler.file_header();
+  ASSERT_EQ(IndexFileHeader::FORMAT_VERSION, header.format_version);
+
+  BplusTreeMiniTransaction mtr(tree_handler);
+  KeyComparator            key_comparator;
+  key_comparator.init(AttrType::CHARS, attr_length);
+
+  const int item_size = header.key_length + static_cast<int>(sizeof(PageNum));
+  auto make_item = [&](char *item, const char *key, PageNum page_num) {
+    memset(item, 0, item_size);
+    memcpy(item, key, strlen(key));
+    memcpy(item + header.key_length, &page_num, sizeof(page_num));
+  };
+  auto make_key = [&](const char *key) {
+    vector<char> key_mem(header.key_length, 0);
+    memcpy(key_mem.data(), key, strlen(key));
+    return key_mem;
+  };
+  auto key_equals = [&](InternalIndexNodeHandler &node, int index, const char *key) {
+    vector<char> expected(header.key_length, 0);
+    memcpy(expected.data(), key, strlen(key));
+    return memcmp(node.key_at(index), expected.data(), header.key_length) == 0;
+  };
+
+  // key(1)之后的键值有公共前缀 "abc-000"
+  const char *keys[] = {"", "abc-0001", "abc-0003", "abc-0005"};
+  vector<char> items(4 * item_size);
+  for (int i = 0; i < 4; i++) {
+    make_item(items.data() + i * item_size, keys[i], i + 1);
+  }
+
+  Frame              frame;
+  InternalIndexNode *raw = reinterpret_cast<InternalIndexNode *>(frame.data());
+  raw->is_leaf           = false;
+  raw->parent            = BP_INVALID_PAGE_NUM;
+  InternalIndexNodeHandler::encode(header, raw, items.data(), 4);
+  ASSERT_EQ(7, raw->prefix_length);
+
+  InternalIndexNodeHandler node(mtr, header, &frame);
+  ASSERT_EQ(4, node.size());
+
+  // 以公共前缀开头的键值原地插入，键值区只增加去掉公共前缀之后的部分
+  uint16_t heap_offset = raw->heap_offset;
+  ASSERT_EQ(RC::SUCCESS, node.insert(make_key("abc-0002").data(), 10, key_comparator));
+  ASSERT_EQ(5, node.size());
+  ASSERT_EQ(heap_offset - 1, raw->heap_offset);
+  ASSERT_EQ(7, raw->prefix_length);
+  ASSERT_TRUE(key_equals(node, 2, "abc-0002"));
+  ASSERT_TRUE(key_equals(node, 3, "abc-0003"));
+  ASSERT_EQ(10, node.value_at(2));
+  ASSERT_EQ(3, node.value_at(3));
+
+  // 删除只移动槽位
+  heap_offset = raw->heap_offset;
+  node.remove(3);
+  ASSERT_EQ(4, node.size());
+  ASSERT_EQ(heap_offset, raw->heap_offset);
+  ASSERT_TRUE(key_equals(node, 3, "abc-0005"));
+
+  // 删除key0之后，新的key0完整存储
+  node.remove(0);
+  ASSERT_EQ(3, node.size());
+  ASSERT_EQ(heap_offset - 8, raw->heap_offset);
+  ASSERT_TRUE(key_equals(node, 0, "abc-0001"));
+  ASSERT_TRUE(key_equals(node, 1, "abc-0002"));
+  ASSERT_EQ(2, node.value_at(0));
+
+  // 不以公共前缀开头的键值需要重新编码整个节点，公共前缀也重新计算
+  ASSERT_EQ(RC::SUCCESS, node.insert(make_key("xyz").data(), 11, key_comparator));
+  ASSERT_EQ(4, node.size());
+  ASSERT_EQ(0, raw->prefix_length);
+  ASSERT_TRUE(key_equals(node, 0, "abc-0001"));
+  ASSERT_TRUE(key_equals(node, 1, "abc-0002"));
+  ASSERT_TRUE(key_equals(node, 2, "abc-0005"));
+  ASSERT_TRUE(key_equals(node, 3, "xyz"));
+
+  // 修改键值
+  ASSERT_EQ(RC::SUCCESS, node.set_key_at(3, make_key("xy").data()));
+  ASSERT_TRUE(key_equals(node, 3, "xy"));
+  ASSERT_EQ(RC::SUCCESS, node.set_key_at(3, make_key("xyz-long").data()));
+  ASSERT_TRUE(key_equals(node, 3, "xyz-long"));
+  ASSERT_EQ(4 * 8, raw->key_bytes);
+}
+
+TEST(test_bplus_tree, test_format_version)
+{
+  filesystem::path test_directory("bplus_tree");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directories(test_directory);
+
+  filesystem::path buffer_pool_file = test_directory / "test_format_version.bp";
+
+  VacuousLogHandler log_handler;
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(buffer_pool_file.c_str()));
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, buffer_pool_file.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  BplusTreeHandler tree_handler;
+  ASSERT_EQ(RC::SUCCESS, tree_handler.create(log_handler, *buffer_pool, AttrType::INTS, 4, ORDER, ORDER));
+
+  // 之前版本创建的索引文件中没有格式版本，内部节点的格式不同，不能打开
+  auto set_format_version = [&](int32_t format_version) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(1 /*header page*/, &frame));
+    reinterpret_cast<IndexFileHeader *>(frame->data())->format_version = format_version;
+    frame->mark_dirty();
+    buffer_pool->unpin_page(frame);
+  };
+
+  set_format_version(0);
+  BplusTreeHandler old_handler;
+  ASSERT_EQ(RC::UNIMPLEMENTED, old_handler.open(log_handler, *buffer_pool));
+
+  set_format_version(IndexFileHeader::FORMAT_VERSION);
+  BplusTreeHandler new_handler;
+  ASSERT_EQ(RC::SUCCESS, new_handler.open(log_handler, *buffer_pool));
+}
+
 TEST(test_bplus_tree, test_chars)
 {
   LoggerFactory::init_default("test_chars.log");
@@ -568,6 +713,116 @@ TEST(test_bplus_tree, test_chars)
   ASSERT_EQ(2, count);
 }
 
+TEST(test_bplus_tree, test_shortest_separator)
+{
+  KeyComparator key_comparator;
+  key_comparator.init(AttrType::CHARS, 8);
+
+  char key_mem[3][sizeof(RID) + 8];
+  auto make_key = [&](char *key, const char *attr, int page_num, int slot_num) {
+    memset(key, 0, sizeof(key_mem[0]));
+    memcpy(key, attr, strlen(attr));
+    RID rid(page_num, slot_num);
+    memcpy(key + 8, &rid, sizeof(rid));
+  };
+
+  // 属性值不同时，分隔键值只保留右边键值的一个前缀，其余部分都是0
+  make_key(key_mem[0], "abcdefg", 1, 1);
+  make_key(key_mem[1], "abcxyz", 2, 2);
+  key_comparator.shortest_separator(key_mem[0], key_mem[1], key_mem[2]);
+  ASSERT_LT(key_comparator(key_mem[0], key_mem[2]), 0);
+  ASSERT_LE(key_comparator(key_mem[2], key_mem[1]), 0);
+  ASSERT_EQ(0, memcmp(key_mem[2], "abcx", 4));
+  for (size_t i = 4; i < sizeof(key_mem[2]); i++) {
+    ASSERT_EQ(0, key_mem[2][i]);
+  }
+
+  // 属性值相同时只能按照RID区分
+  make_key(key_mem[1], "abcdefg", 1, 2);
+  key_comparator.shortest_separator(key_mem[0], key_mem[1], key_mem[2]);
+  ASSERT_LT(key_comparator(key_mem[0], key_mem[2]), 0);
+  ASSERT_LE(key_comparator(key_mem[2], key_mem[1]), 0);
+}
+
+TEST(test_bplus_tree, test_long_chars)
+{
+  LoggerFactory::init_default("test_long_chars.log");
+
+  VacuousLogHandler log_handler;
+
+  filesystem::path test_directory("bplus_tree");
+  filesystem::path buffer_pool_file = test_directory / "long_chars.btree";
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(buffer_pool_file.c_str()));
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, buffer_pool_file.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  // 较长的键值并且有很长的公共前缀，内部节点按照空间判断是否已满
+  const int attr_length = 200;
+  BplusTreeHandler handler;
+  ASSERT_EQ(RC::SUCCESS, handler.create(log_handler, *buffer_pool, AttrType::CHARS, attr_length, -1, 30));
+
+  const int key_num = 1000;
+  auto      make_key = [](char *key, int i) {
+    memset(key, 0, attr_length);
+    snprintf(key, attr_length, "customer-account-%0150d-%08d", 0, i);
+  };
+
+  vector<int> orders(key_num);
+  for (int i = 0; i < key_num; i++) {
+    orders[i] = i;
+  }
+  shuffle(orders.begin(), orders.end(), std::mt19937(key_num));
+
+  char key[attr_length];
+  for (int i : orders) {
+    make_key(key, i);
+    RID rid(i, i);
+    ASSERT_EQ(RC::SUCCESS, handler.insert_entry(key, &rid));
+  }
+  ASSERT_TRUE(handler.validate_tree());
+
+  // 叶子节点的个数超过了 (页面大小 / 键值长度)，前缀压缩和后缀截断之后，一个根节点就可以放下所有的叶子节点
+  int height = 0;
+  ASSERT_EQ(RC::SUCCESS, handler.tree_height(height));
+  ASSERT_EQ(2, height);
+
+  for (int i = 0; i < key_num; i++) {
+    make_key(key, i);
+    list<RID> rids;
+    ASSERT_EQ(RC::SUCCESS, handler.get_entry(key, static_cast<int>(strlen(key)), rids));
+    ASSERT_EQ(1, static_cast<int>(rids.size()));
+    ASSERT_EQ(i, rids.front().page_num);
+  }
+
+  for (int i = 0; i < key_num; i += 2) {
+    make_key(key, orders[i]);
+    RID rid(orders[i], orders[i]);
+    ASSERT_EQ(RC::SUCCESS, handler.delete_entry(key, &rid));
+  }
+  ASSERT_TRUE(handler.validate_tree());
+
+  BplusTreeScanner scanner(handler);
+  ASSERT_EQ(RC::SUCCESS, scanner.open(nullptr, 0, true, nullptr, 0, true));
+  RID rid;
+  RC  rc    = RC::SUCCESS;
+  int count = 0;
+  while (OB_SUCC(rc = scanner.next_entry(rid))) {
+    count++;
+  }
+  ASSERT_EQ(RC::RECORD_EOF, rc);
+  ASSERT_EQ(key_num / 2, count);
+  scanner.close();
+
+  handler.close();
+}
+
 TEST(test_bplus_tree, test_scanner)
 {
   LoggerFactory::init_default("test.log");
@@ -826,6 +1081,105 @@ TEST(test_bplus_tree, test_bplus_tree_insert)
   handler = nullptr;
 }
 
+void test_bulk_load(int key_num, int order, const BplusTreeBulkLoadOptions &options)
+{
+  filesystem::path test_directory("bplus_tree");
+  filesystem::path buffer_pool_file = test_directory / "bulk_load.btree";
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  VacuousLogHandler log_handler;
+
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(buffer_pool_file.c_str()));
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, buffer_pool_file.c_str(), buffer_pool));
+  ASSERT_NE(nullptr, buffer_pool);
+
+  BplusTreeHandler handler;
+  ASSERT_EQ(RC::SUCCESS, handler.create(log_handler, *buffer_pool, AttrType::INTS, sizeof(int), order, order));
+
+  // 键值有重复，按照 (key, rid) 排序
+  vector<int> keys(key_num);
+  for (int i = 0; i < key_num; i++) {
+    keys[i] = i / 2;
+  }
+  shuffle(keys.begin(), keys.end(), std::mt19937(key_num));
+
+  {
+    BplusTreeBulkLoader loader(handler, buffer_pool_file.string(), options);
+    for (int i = 0; i < key_num; i++) {
+      RID rid(keys[i], i);
+      ASSERT_EQ(RC::SUCCESS, loader.add(reinterpret_cast<const char *>(&keys[i]), rid));
+    }
+    ASSERT_EQ(RC::SUCCESS, loader.finish());
+  }
+
+  ASSERT_EQ(key_num == 0, handler.is_empty());
+  ASSERT_TRUE(handler.validate_tree());
+
+  BplusTreeScanner scanner(handler);
+  ASSERT_EQ(RC::SUCCESS, scanner.open(nullptr, 0, true, nullptr, 0, true));
+  RID rid;
+  RC  rc         = RC::SUCCESS;
+  int count      = 0;
+  RID last_rid(-1, -1);
+  while (OB_SUCC(rc = scanner.next_entry(rid))) {
+    ASSERT_EQ(count / 2, rid.page_num);
+    ASSERT_LT(RID::compare(&last_rid, &rid), 0);
+    last_rid = rid;
+    count++;
+  }
+  ASSERT_EQ(RC::RECORD_EOF, rc);
+  ASSERT_EQ(key_num, count);
+  scanner.close();
+
+  // 批量创建之后还可以正常插入和删除
+  for (int i = 0; i < key_num; i += 3) {
+    RID rid(keys[i], i);
+    ASSERT_EQ(RC::SUCCESS, handler.delete_entry(reinterpret_cast<const char *>(&keys[i]), &rid));
+  }
+  for (int i = 0; i < key_num; i += 3) {
+    RID rid(keys[i], i);
+    ASSERT_EQ(RC::SUCCESS, handler.insert_entry(reinterpret_cast<const char *>(&keys[i]), &rid));
+  }
+  ASSERT_TRUE(handler.validate_tree());
+
+  for (int i = 0; i < key_num; i += 7) {
+    list<RID> rids;
+    ASSERT_EQ(RC::SUCCESS, handler.get_entry(reinterpret_cast<const char *>(&keys[i]), sizeof(int), rids));
+    ASSERT_EQ(keys[i] * 2 + 1 < key_num ? 2 : 1, static_cast<int>(rids.size()));
+  }
+
+  handler.close();
+}
+
+TEST(test_bplus_tree, test_bulk_load)
+{
+  LoggerFactory::init_default("test.log");
+
+  BplusTreeBulkLoadOptions options;
+  for (int key_num : {0, 1, ORDER, ORDER + 1, INSERT_NUM, INSERT_NUM + 7}) {
+    for (double fill_factor : {0.5, 0.7, 1.0}) {
+      options.fill_factor = fill_factor;
+      test_bulk_load(key_num, ORDER, options);
+    }
+  }
+
+  // 默认的节点大小，内存中放不下时写临时文件
+  options.fill_factor = 0.9;
+  options.sort_memory = 1000 * (sizeof(int) + sizeof(RID));
+  options.thread_num  = 4;
+  test_bulk_load(100000, -1, options);
+  ASSERT_FALSE(filesystem::exists("bplus_tree/bulk_load.btree.sort.0"));
+
+  // validate_tree 会固定所有的页面，节点数不能超过 buffer pool 的页帧数
+  options.sort_memory = 64 * 1024 * 1024;
+  test_bulk_load(5000, 7, options);
+}
+
 int main(int argc, char **argv)
 {
 
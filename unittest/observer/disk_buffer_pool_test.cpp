@@ -15,10 +15,15 @@ See the Mulan PSL v2 for more details. */
 #include <filesystem>
 
 #include "gtest/gtest.h"
+#include "common/lang/atomic.h"
+#include "common/lang/random.h"
+#include "common/lang/thread.h"
 #include "common/log/log.h"
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/clog/vacuous_log_handler.h"
 #include "storage/buffer/double_write_buffer.h"
+#include "storage/buffer/page_cleaner.h"
+#include "storage/buffer/read_ahead.h"
 
 using namespace std;
 using namespace common;
@@ -105,6 +110,77 @@ TEST(DiskBufferPool, allocate_dispose)
   ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
 }
 
+TEST(DiskBufferPool, extent)
+{
+  filesystem::path directory("buffer_pool");
+  filesystem::remove_all(directory);
+  filesystem::create_directories(directory);
+
+  filesystem::path buffer_pool_filename = directory / "extent.bp";
+
+  BufferPoolManager buffer_pool_manager;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.init(make_unique<VacuousDoubleWriteBuffer>()));
+  VacuousLogHandler log_handler;
+
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.create_file(buffer_pool_filename.c_str()));
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+  ASSERT_NE(buffer_pool, nullptr);
+
+  // 分配的页面跨过两个区，区的位图页不会分配给调用者
+  const int allocate_page_num = BP_EXTENT_PAGES * 2;
+  for (int i = 0; i < allocate_page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    ASSERT_NE(frame, nullptr);
+    ASSERT_NE(frame->page_num() % BP_EXTENT_PAGES, 0);
+    ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+  }
+  ASSERT_EQ(buffer_pool_page_count(buffer_pool), allocate_page_num);
+  ASSERT_EQ(buffer_pool->file_header()->extent_count, 3);
+
+  // 不能释放文件头和区的位图页
+  ASSERT_NE(RC::SUCCESS, buffer_pool->dispose_page(0));
+  ASSERT_NE(RC::SUCCESS, buffer_pool->dispose_page(BP_EXTENT_PAGES));
+  ASSERT_NE(RC::SUCCESS, buffer_pool->dispose_page(BP_EXTENT_PAGES * 3));
+
+  // 释放第1个区中的页面后，新分配的页面会复用它们
+  const int dispose_page_num = 10;
+  for (int i = 1; i <= dispose_page_num; i++) {
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->dispose_page(BP_EXTENT_PAGES + i * 3));
+  }
+  ASSERT_EQ(buffer_pool_page_count(buffer_pool), allocate_page_num - dispose_page_num);
+
+  const PageNum page_count = buffer_pool->file_header()->page_count;
+  for (int i = 1; i <= dispose_page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    ASSERT_EQ(frame->page_num(), BP_EXTENT_PAGES + i * 3);
+    ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+  }
+  ASSERT_EQ(buffer_pool->file_header()->page_count, page_count);
+
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->dispose_page(5));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->dispose_page(BP_EXTENT_PAGES * 2 + 1));
+
+  // 重新打开文件后区的位图和摘要都能正确恢复
+  ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
+  ASSERT_EQ(RC::SUCCESS, buffer_pool_manager.open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+  ASSERT_NE(buffer_pool, nullptr);
+  ASSERT_EQ(buffer_pool_page_count(buffer_pool), allocate_page_num - 2);
+  ASSERT_EQ(buffer_pool->file_header()->allocated_pages, allocate_page_num - 2 + 3);
+
+  Frame *frame = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+  ASSERT_EQ(frame->page_num(), 5);
+  ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+  ASSERT_EQ(frame->page_num(), BP_EXTENT_PAGES * 2 + 1);
+  ASSERT_EQ(buffer_pool->unpin_page(frame), RC::SUCCESS);
+
+  ASSERT_EQ(buffer_pool_manager.close_file(buffer_pool_filename.c_str()), RC::SUCCESS);
+}
+
 TEST(BufferPool, create)
 {
   filesystem::path test_directory("buffer_pool");
@@ -132,6 +208,256 @@ TEST(BufferPool, create)
   ASSERT_EQ(buffer_pool->id(), buffer_pool2->id());
 }
 
+TEST(BufferPool, invalid_file_header)
+{
+  filesystem::path test_directory("buffer_pool");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  VacuousLogHandler log_handler;
+  BufferPoolManager bpm;
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+
+  // 修改文件头中的一个字段，文件应该打不开
+  auto open_modified = [&](const char *name, const function<void(BPFileHeader &)> &modifier) {
+    filesystem::path bp_file = test_directory / name;
+    EXPECT_EQ(RC::SUCCESS, bpm.create_file(bp_file.c_str()));
+
+    Page page;
+    int  fd = ::open(bp_file.c_str(), O_RDWR);
+    EXPECT_EQ(static_cast<ssize_t>(sizeof(page)), ::pread(fd, &page, sizeof(page), 0));
+    modifier(*reinterpret_cast<BPFileHeader *>(page.data));
+    EXPECT_EQ(static_cast<ssize_t>(sizeof(page)), ::pwrite(fd, &page, sizeof(page), 0));
+    ::close(fd);
+
+    DiskBufferPool *buffer_pool = nullptr;
+    return bpm.open_file(log_handler, bp_file.c_str(), buffer_pool);
+  };
+
+  ASSERT_EQ(RC::SUCCESS, open_modified("valid.bp", [](BPFileHeader &) {}));
+  ASSERT_EQ(RC::BUFFERPOOL_INVALID_FILE, open_modified("magic.bp", [](BPFileHeader &header) { header.magic = 0; }));
+  ASSERT_EQ(RC::BUFFERPOOL_INVALID_FILE,
+            open_modified("version.bp", [](BPFileHeader &header) { header.version = BPFileHeader::VERSION + 1; }));
+  ASSERT_EQ(RC::BUFFERPOOL_INVALID_FILE, open_modified("extent_count.bp", [](BPFileHeader &header) {
+    header.extent_count = BPFileHeader::MAX_EXTENT_NUM + 1;
+  }));
+  ASSERT_EQ(RC::BUFFERPOOL_INVALID_FILE,
+            open_modified("page_count.bp", [](BPFileHeader &header) { header.page_count = BP_EXTENT_PAGES + 1; }));
+}
+
+TEST(BufferPool, page_cleaner)
+{
+  filesystem::path test_directory("buffer_pool");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  // 关闭文件时会刷新脏页，日志要比 buffer pool manager 后销毁
+  VacuousLogHandler log_handler;
+  const int         frame_num = DEFAULT_ITEM_NUM_PER_POOL;
+  BufferPoolManager bpm(frame_num * BP_PAGE_SIZE);
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+  ASSERT_EQ(static_cast<size_t>(frame_num), bpm.get_frame_manager().total_frame_num());
+
+  DiskBufferPool   *buffer_pools[2] = {nullptr, nullptr};
+  for (int i = 0; i < 2; i++) {
+    filesystem::path bp_file = test_directory / ("cleaner" + to_string(i) + ".bp");
+    ASSERT_EQ(RC::SUCCESS, bpm.create_file(bp_file.c_str()));
+    ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, bp_file.c_str(), buffer_pools[i]));
+  }
+
+  // 两个文件交替分配页面，写入页号，几乎用完所有的页帧
+  const int     page_num = frame_num - 8;
+  vector<pair<DiskBufferPool *, PageNum>> pages;
+  for (int i = 0; i < page_num; i++) {
+    DiskBufferPool *buffer_pool = buffer_pools[i % 2];
+    Frame          *frame       = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    memcpy(frame->data(), &i, sizeof(i));
+    frame->mark_dirty();
+    pages.emplace_back(buffer_pool, frame->page_num());
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  }
+
+  BPFrameStats stats = bpm.frame_stats();
+  ASSERT_EQ(frame_num, stats.free_frames + stats.clean_frames + stats.dirty_frames);
+  ASSERT_GE(stats.dirty_frames, page_num);
+
+  BPPageCleanerOptions options;
+  options.low_water_percent  = 10;
+  options.high_water_percent = 20;
+  BPPageCleaner cleaner(bpm, options);
+  ASSERT_TRUE(cleaner.below_low_water());
+
+  // 没有启动后台线程，直接在当前线程执行一轮
+  const int high_water = frame_num * options.high_water_percent / 100;
+  ASSERT_EQ(high_water - stats.free_frames, cleaner.run_once());
+  ASSERT_FALSE(cleaner.below_low_water());
+  ASSERT_EQ(0, cleaner.run_once());
+
+  BPPageCleanerStats cleaner_stats = cleaner.stats();
+  ASSERT_EQ(1UL, cleaner_stats.rounds);
+  ASSERT_GE(cleaner_stats.flushed_pages, cleaner_stats.evicted_frames);
+  ASSERT_EQ(static_cast<uint64_t>(high_water - stats.free_frames), cleaner_stats.evicted_frames);
+
+  BPFrameStats stats2 = bpm.frame_stats();
+  ASSERT_EQ(frame_num, stats2.free_frames + stats2.clean_frames + stats2.dirty_frames);
+  ASSERT_EQ(high_water, stats2.free_frames);
+  ASSERT_EQ(stats.dirty_frames - static_cast<int>(cleaner_stats.flushed_pages), stats2.dirty_frames);
+
+  // 被释放的页面可以从磁盘上重新读取
+  for (int i = 0; i < page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, pages[i].first->get_this_page(pages[i].second, &frame));
+    int value = -1;
+    memcpy(&value, frame->data(), sizeof(value));
+    ASSERT_EQ(i, value);
+    ASSERT_EQ(RC::SUCCESS, pages[i].first->unpin_page(frame));
+  }
+}
+
+TEST(BufferPool, read_ahead)
+{
+  filesystem::path test_directory("buffer_pool");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  VacuousLogHandler log_handler;
+  BufferPoolManager bpm(DEFAULT_ITEM_NUM_PER_POOL * BP_PAGE_SIZE);
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+
+  // 在当前线程中同步预读，方便检查结果
+  BPReadAheadOptions options;
+  options.pages      = 16;
+  options.background = false;
+  ASSERT_EQ(RC::SUCCESS, bpm.start_read_ahead(options));
+  BPReadAheader *read_aheader = bpm.read_aheader();
+  ASSERT_NE(nullptr, read_aheader);
+
+  filesystem::path bp_file = test_directory / "read_ahead.bp";
+  DiskBufferPool  *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(bp_file.c_str()));
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, bp_file.c_str(), buffer_pool));
+
+  const int       page_num = 64;
+  vector<PageNum> page_nums;
+  for (int i = 0; i < page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    memcpy(frame->data(), &i, sizeof(i));
+    frame->mark_dirty();
+    page_nums.push_back(frame->page_num());
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  }
+
+  // 中间释放一个页面，预读时要跳过它，并且分成两次读
+  const PageNum disposed_page = page_nums[9];
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->dispose_page(disposed_page));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->purge_all_pages());
+
+  BPFrameManager &frame_manager = bpm.get_frame_manager();
+  Frame          *frame         = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page_nums[0], &frame, BPAccessHint::SCAN));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+
+  BPReadAheadStats stats = read_aheader->stats();
+  ASSERT_EQ(1UL, stats.requests);
+  ASSERT_EQ(2UL, stats.reads);
+  ASSERT_EQ(static_cast<uint64_t>(options.pages), stats.loaded_pages);
+  ASSERT_FALSE(frame_manager.contains(buffer_pool->id(), disposed_page));
+  for (int i = 1; i <= options.pages; i++) {
+    ASSERT_TRUE(frame_manager.contains(buffer_pool->id(), page_nums[i < 9 ? i : i + 1]));
+  }
+
+  // 顺序扫描时，访问到预读的页面中间，就会接着预读后面的页面，除了第一个页面，都不需要访问线程加载
+  for (int i = 0; i < page_num; i++) {
+    if (page_nums[i] == disposed_page) {
+      continue;
+    }
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page_nums[i], &frame, BPAccessHint::SCAN));
+    int value = -1;
+    memcpy(&value, frame->data(), sizeof(value));
+    ASSERT_EQ(i, value);
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  }
+  stats = read_aheader->stats();
+  ASSERT_EQ(static_cast<uint64_t>(page_num - 2), stats.loaded_pages);
+  ASSERT_EQ(0UL, stats.discarded_pages);
+
+  // 没有 SCAN 提示时，连续从磁盘加载两个相邻的页面也会预读
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->purge_all_pages());
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page_nums[20], &frame));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  ASSERT_FALSE(frame_manager.contains(buffer_pool->id(), page_nums[22]));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page_nums[21], &frame));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  ASSERT_TRUE(frame_manager.contains(buffer_pool->id(), page_nums[22]));
+  ASSERT_TRUE(frame_manager.contains(buffer_pool->id(), page_nums[21 + options.pages]));
+
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->close_file());
+}
+
+TEST(BufferPool, concurrent_fetch)
+{
+  filesystem::path test_directory("buffer_pool");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  VacuousLogHandler log_handler;
+  BufferPoolManager bpm(DEFAULT_ITEM_NUM_PER_POOL * BP_PAGE_SIZE);
+  ASSERT_EQ(RC::SUCCESS, bpm.init(make_unique<VacuousDoubleWriteBuffer>()));
+
+  filesystem::path bp_file     = test_directory / "concurrent_fetch.bp";
+  DiskBufferPool  *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm.create_file(bp_file.c_str()));
+  ASSERT_EQ(RC::SUCCESS, bpm.open_file(log_handler, bp_file.c_str(), buffer_pool));
+
+  // 页面比页帧多，访问时会不断地淘汰和加载页面
+  const int       page_num = DEFAULT_ITEM_NUM_PER_POOL * 4;
+  vector<PageNum> page_nums;
+  for (int i = 0; i < page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    memset(frame->data(), 0, BP_PAGE_DATA_SIZE);
+    memcpy(frame->data(), &i, sizeof(i));
+    memcpy(frame->data() + BP_PAGE_DATA_SIZE - sizeof(i), &i, sizeof(i));
+    frame->mark_dirty();
+    page_nums.push_back(frame->page_num());
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  }
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->purge_all_pages());
+
+  // 不加页面锁直接读数据，拿到的页帧必须已经加载完成
+  atomic<int>    mismatch_count{0};
+  vector<thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t]() {
+      mt19937 random(t);
+      for (int n = 0; n < 5000; n++) {
+        const int i     = static_cast<int>(random() % page_num);
+        Frame    *frame = nullptr;
+        if (buffer_pool->get_this_page(page_nums[i], &frame) != RC::SUCCESS) {
+          mismatch_count++;
+          continue;
+        }
+        int head = -1;
+        int tail = -1;
+        memcpy(&head, frame->data(), sizeof(head));
+        memcpy(&tail, frame->data() + BP_PAGE_DATA_SIZE - sizeof(tail), sizeof(tail));
+        if (head != i || tail != i) {
+          mismatch_count++;
+        }
+        buffer_pool->unpin_page(frame);
+      }
+    });
+  }
+  for (thread &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0, mismatch_count.load());
+
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->close_file());
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -180,6 +180,141 @@ TEST(DiskLogHandler, multi_thread)
   ASSERT_EQ(RC::SUCCESS, handler.await_termination());
 }
 
+TEST(DiskLogHandler, group_commit)
+{
+  const char *directory = "test_log_handler_group_commit";
+
+  // 不同的组提交配置下，多个线程同时追加日志并等待日志刷盘
+  for (bool pipelined_sync : {true, false}) {
+    filesystem::remove_all(directory);
+
+    DiskLogHandlerOptions options;
+    options.group_commit_delay_us = 1000;
+    options.group_commit_size     = 8;
+    options.pipelined_sync        = pipelined_sync;
+
+    DiskLogHandler  handler;
+    TestLogReplayer replayer;
+    ASSERT_EQ(RC::SUCCESS, handler.init(directory, options));
+    ASSERT_EQ(RC::SUCCESS, handler.replay(replayer, 0));
+    ASSERT_EQ(RC::SUCCESS, handler.start());
+
+    const int      thread_num = 8;
+    const int      times      = 300;
+    atomic<int>    failed_count(0);
+    vector<thread> threads;
+    for (int t = 0; t < thread_num; t++) {
+      threads.emplace_back([&handler, &failed_count]() {
+        for (int i = 0; i < times; i++) {
+          LSN lsn = 0;
+          if (OB_FAIL(handler.append(lsn, LogModule::Id::TRANSACTION, vector<char>(10))) ||
+              OB_FAIL(handler.wait_lsn(lsn)) || handler.current_flushed_lsn() < lsn) {
+            failed_count++;
+          }
+        }
+      });
+    }
+    for (thread &t : threads) {
+      t.join();
+    }
+
+    ASSERT_EQ(0, failed_count.load());
+    ASSERT_EQ(thread_num * times, handler.current_flushed_lsn());
+    // 多个线程的日志共用一次 sync
+    ASSERT_LT(handler.sync_count(), thread_num * times);
+
+    ASSERT_EQ(RC::SUCCESS, handler.stop());
+    ASSERT_EQ(RC::SUCCESS, handler.await_termination());
+
+    int  count             = 0;
+    auto log_entry_counter = [&count](LogEntry &entry) -> RC {
+      count++;
+      return entry.lsn() == count ? RC::SUCCESS : RC::INTERNAL;
+    };
+    ASSERT_EQ(RC::SUCCESS, handler.iterate(log_entry_counter, 0));
+    ASSERT_EQ(thread_num * times, count);
+  }
+
+  filesystem::remove_all(directory);
+}
+
+TEST(DiskLogHandler, file_rollover)
+{
+  const char *directory = "test_log_handler_file_rollover";
+
+  // 日志文件写满后切换到下一个文件，检查点之前的文件被回收后重用
+  for (bool direct_io : {false, true}) {
+    filesystem::remove_all(directory);
+
+    DiskLogHandlerOptions options;
+    options.file_size      = 16 * 1024;
+    options.recycled_files = 2;
+    options.direct_io      = direct_io;
+
+    DiskLogHandler  handler;
+    TestLogReplayer replayer;
+    ASSERT_EQ(RC::SUCCESS, handler.init(directory, options));
+    ASSERT_EQ(RC::SUCCESS, handler.replay(replayer, 0));
+    ASSERT_EQ(RC::SUCCESS, handler.start());
+
+    const int times = 5000;
+    for (int i = 0; i < times; i++) {
+      LSN lsn = 0;
+      ASSERT_EQ(RC::SUCCESS, handler.append(lsn, LogModule::Id::BUFFER_POOL, vector<char>(i % 100 + 1)));
+      if (i % 1000 == 0) {
+        ASSERT_EQ(RC::SUCCESS, handler.wait_lsn(lsn));
+      }
+    }
+    ASSERT_EQ(RC::SUCCESS, handler.wait_lsn(times));
+
+    vector<string> files;
+    ASSERT_EQ(RC::SUCCESS, handler.file_manager_.list_files(files, 0));
+    ASSERT_GT(static_cast<int>(files.size()), 10);
+    for (const string &file : files) {
+      ASSERT_EQ(options.file_size, static_cast<int64_t>(filesystem::file_size(file)));
+    }
+
+    // 回收检查点之前的文件，新的日志使用回收的文件
+    const LSN check_point_lsn = times / 2;
+    ASSERT_EQ(RC::SUCCESS, handler.purge(check_point_lsn));
+    ASSERT_EQ(options.recycled_files, static_cast<int>(handler.file_manager_.free_files_.size()));
+
+    const int times2 = 1000;
+    for (int i = 0; i < times2; i++) {
+      LSN lsn = 0;
+      ASSERT_EQ(RC::SUCCESS, handler.append(lsn, LogModule::Id::BUFFER_POOL, vector<char>(i % 100 + 1)));
+    }
+    ASSERT_EQ(RC::SUCCESS, handler.stop());
+    ASSERT_EQ(RC::SUCCESS, handler.await_termination());
+    ASSERT_EQ(0, static_cast<int>(handler.file_manager_.free_files_.size()));
+
+    // 重新打开后从检查点开始回放，再追加的日志接在最后一条日志后面
+    DiskLogHandler  handler2;
+    TestLogReplayer replayer2;
+    ASSERT_EQ(RC::SUCCESS, handler2.init(directory, options));
+    ASSERT_EQ(RC::SUCCESS, handler2.replay(replayer2, check_point_lsn));
+    ASSERT_EQ(times + times2 - check_point_lsn + 1, replayer2.count());
+    ASSERT_EQ(times + times2, handler2.current_lsn());
+
+    ASSERT_EQ(RC::SUCCESS, handler2.start());
+    for (int i = 0; i < 10; i++) {
+      LSN lsn = 0;
+      ASSERT_EQ(RC::SUCCESS, handler2.append(lsn, LogModule::Id::BUFFER_POOL, vector<char>(10)));
+    }
+    ASSERT_EQ(RC::SUCCESS, handler2.stop());
+    ASSERT_EQ(RC::SUCCESS, handler2.await_termination());
+
+    LSN  expected_lsn      = check_point_lsn;
+    auto log_entry_checker = [&expected_lsn](LogEntry &entry) -> RC {
+      return entry.lsn() == expected_lsn++ ? RC::SUCCESS : RC::INTERNAL;
+    };
+    ASSERT_EQ(RC::SUCCESS, handler2.iterate(log_entry_checker, check_point_lsn));
+    ASSERT_EQ(times + times2 + 10 + 1, expected_lsn);
+  }
+
+  filesystem::remove_all(directory);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
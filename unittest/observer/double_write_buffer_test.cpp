@@ -16,6 +16,8 @@ See the Mulan PSL v2 for more details. */
 
 #include "gtest/gtest.h"
 
+#include "common/math/crc.h"
+
 #include "storage/buffer/disk_buffer_pool.h"
 #include "storage/buffer/double_write_buffer.h"
 #include "storage/clog/vacuous_log_handler.h"
@@ -201,6 +203,147 @@ TEST(DoubleWriteBuffer, single_file_exception)
   bpm  = nullptr;
 }
 
+TEST(DoubleWriteBuffer, ring)
+{
+  /*
+  使用一个很小的环形缓冲区，
+  加入比缓冲区大很多的页面，同一个页面加入多次
+  检查写回的页面是最新的版本
+  */
+  filesystem::path directory("double_write_buffer_test_ring_dir");
+  filesystem::remove_all(directory);
+  filesystem::create_directories(directory);
+
+  filesystem::path buffer_pool_filename         = directory / "buffer_pool.bp";
+  filesystem::path double_write_buffer_filename = directory / "double_write_buffer.dwb";
+
+  VacuousLogHandler log_handler;
+  auto              bpm                 = make_unique<BufferPoolManager>();
+  const int         max_pages           = 8;
+  auto              double_write_buffer = make_unique<DiskDoubleWriteBuffer>(*bpm, max_pages);
+  ASSERT_EQ(RC::SUCCESS, double_write_buffer->open_file(double_write_buffer_filename.c_str()));
+  DiskDoubleWriteBuffer *dblwr = double_write_buffer.get();
+  ASSERT_EQ(bpm->init(std::move(double_write_buffer)), RC::SUCCESS);
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm->create_file(buffer_pool_filename.c_str()));
+  ASSERT_EQ(RC::SUCCESS, bpm->open_file(log_handler, buffer_pool_filename.c_str(), buffer_pool));
+
+  const int       page_num = 32;
+  vector<PageNum> page_nums;
+  for (int i = 0; i < page_num; i++) {
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+    page_nums.push_back(frame->page_num());
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  }
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->purge_all_pages());
+
+  const int version_num = 3;
+  for (int version = 1; version <= version_num; version++) {
+    for (int i = 0; i < page_num; i++) {
+      Page page;
+      memset(&page, 0, sizeof(page));
+      int value = i * 100 + version;
+      memcpy(page.data, &value, sizeof(value));
+      page.check_sum = crc32(page.data, BP_PAGE_DATA_SIZE);
+      ASSERT_EQ(RC::SUCCESS, dblwr->add_page(buffer_pool, page_nums[i], page));
+
+      // 还没有写回的页面也可以读到最新的版本
+      Page read_page;
+      ASSERT_EQ(RC::SUCCESS, dblwr->read_page(buffer_pool, page_nums[i], read_page));
+      ASSERT_EQ(0, memcmp(&page, &read_page, sizeof(page)));
+    }
+  }
+  ASSERT_EQ(RC::SUCCESS, dblwr->flush_page());
+
+  DoubleWriteBufferStats stats = dblwr->stats();
+  // purge_all_pages 时每个页面加入一次
+  ASSERT_EQ(static_cast<uint64_t>(page_num * (version_num + 1)), stats.added_pages);
+  ASSERT_GT(stats.batches, 0UL);
+  ASSERT_LE(stats.written_pages, stats.added_pages);
+
+  for (int i = 0; i < page_num; i++) {
+    Page page;
+    ASSERT_EQ(RC::BUFFERPOOL_INVALID_PAGE_NUM, dblwr->read_page(buffer_pool, page_nums[i], page));
+
+    Frame *frame = nullptr;
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->get_this_page(page_nums[i], &frame));
+    int value = 0;
+    memcpy(&value, frame->data(), sizeof(value));
+    ASSERT_EQ(i * 100 + version_num, value);
+    ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  }
+}
+
+TEST(DoubleWriteBuffer, stale_copy)
+{
+  /*
+  共享文件中保留了一个页面旧的副本，而原始位置已经写入了更新的版本，
+  模拟异常停止后启动，检查恢复时不会用旧的副本覆盖原始位置的页面
+  */
+  filesystem::path directory("double_write_buffer_test_stale_copy_dir");
+  filesystem::remove_all(directory);
+  filesystem::path src_path = directory / "src";
+  filesystem::path dst_path = directory / "dst";
+  filesystem::create_directories(src_path);
+  filesystem::create_directories(dst_path);
+
+  VacuousLogHandler log_handler;
+  auto              bpm                 = make_unique<BufferPoolManager>();
+  auto              double_write_buffer = make_unique<DiskDoubleWriteBuffer>(*bpm, 8 /*max_pages*/);
+  ASSERT_EQ(RC::SUCCESS, double_write_buffer->open_file((src_path / "double_write_buffer.dwb").c_str()));
+  DiskDoubleWriteBuffer *dblwr = double_write_buffer.get();
+  ASSERT_EQ(bpm->init(std::move(double_write_buffer)), RC::SUCCESS);
+
+  DiskBufferPool *buffer_pool = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm->create_file((src_path / "buffer_pool.bp").c_str()));
+  ASSERT_EQ(RC::SUCCESS, bpm->open_file(log_handler, (src_path / "buffer_pool.bp").c_str(), buffer_pool));
+
+  Frame *frame = nullptr;
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->allocate_page(&frame));
+  const PageNum page_num = frame->page_num();
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->unpin_page(frame));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->purge_all_pages());
+
+  auto make_page = [](LSN lsn, int value) {
+    Page page;
+    memset(&page, 0, sizeof(page));
+    memcpy(page.data, &value, sizeof(value));
+    page.lsn       = lsn;
+    page.check_sum = crc32(page.data, BP_PAGE_DATA_SIZE);
+    return page;
+  };
+
+  // 旧版本经过共享文件写回，副本留在共享文件中
+  Page old_page = make_page(10, 1);
+  ASSERT_EQ(RC::SUCCESS, dblwr->add_page(buffer_pool, page_num, old_page));
+  ASSERT_EQ(RC::SUCCESS, dblwr->flush_page());
+  // 新版本的副本所在的槽位被覆盖了，只有原始位置是新版本
+  Page new_page = make_page(20, 2);
+  ASSERT_EQ(RC::SUCCESS, buffer_pool->write_page(page_num, new_page));
+
+  filesystem::copy(src_path, dst_path, filesystem::copy_options::recursive);
+
+  auto bpm2                 = make_unique<BufferPoolManager>();
+  auto double_write_buffer2 = make_unique<DiskDoubleWriteBuffer>(*bpm2, 8 /*max_pages*/);
+  ASSERT_EQ(RC::SUCCESS, double_write_buffer2->open_file((dst_path / "double_write_buffer.dwb").c_str()));
+  DiskDoubleWriteBuffer *dblwr2 = double_write_buffer2.get();
+  ASSERT_EQ(bpm2->init(std::move(double_write_buffer2)), RC::SUCCESS);
+
+  DiskBufferPool *buffer_pool2 = nullptr;
+  ASSERT_EQ(RC::SUCCESS, bpm2->open_file(log_handler, (dst_path / "buffer_pool.bp").c_str(), buffer_pool2));
+  ASSERT_EQ(RC::SUCCESS, dblwr2->recover());
+
+  ASSERT_EQ(RC::SUCCESS, buffer_pool2->get_this_page(page_num, &frame));
+  ASSERT_EQ(new_page.lsn, frame->page().lsn);
+  ASSERT_EQ(0, memcmp(new_page.data, frame->data(), BP_PAGE_DATA_SIZE));
+  ASSERT_EQ(RC::SUCCESS, buffer_pool2->unpin_page(frame));
+
+  bpm2 = nullptr;
+  bpm  = nullptr;
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
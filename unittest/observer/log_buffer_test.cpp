@@ -18,6 +18,7 @@ See the Mulan PSL v2 for more details. */
 #define protected public
 #include "storage/clog/log_buffer.h"
 #include "storage/clog/log_file.h"
+#include "common/lang/thread.h"
 
 using namespace std;
 using namespace common;
@@ -41,7 +42,9 @@ TEST(LogEntryBuffer, test_append)
   ASSERT_GT(buffer.entry_number(), 0);
 
   LogFileWriter writer;
-  ASSERT_EQ(RC::SUCCESS, writer.open("test_log_entry_buffer.log", end_lsn));
+  // 日志文件正好能放下 end_lsn 之前的日志
+  filesystem::remove("test_log_entry_buffer.log");
+  ASSERT_EQ(RC::SUCCESS, writer.open("test_log_entry_buffer.log", (end_lsn - start_lsn) * (LogHeader::SIZE + 10)));
   int count = 0;
   ASSERT_EQ(RC::SUCCESS, buffer.flush(writer, count));
   ASSERT_EQ(count, 1);
@@ -60,12 +63,85 @@ TEST(LogEntryBuffer, test_append)
 
   ASSERT_EQ(RC::SUCCESS, buffer.append(lsn, LogModule::Id::BUFFER_POOL, vector<char>(10)));
 
-  ASSERT_NE(RC::SUCCESS, buffer.flush(writer, count));
+  ASSERT_EQ(RC::LOG_FILE_FULL, buffer.flush(writer, count));
 
   writer.close();
   filesystem::remove("test_log_entry_buffer.log");
 }
 
+TEST(LogEntryBuffer, concurrent_append)
+{
+  // 多个线程同时追加日志，一个线程刷新日志。日志的总大小是缓冲区的几倍，会绕回并且等待空间
+  const char *filename = "test_log_entry_buffer_concurrent.log";
+  filesystem::remove(filename);
+
+  LogEntryBuffer buffer;
+  ASSERT_EQ(RC::SUCCESS, buffer.init(0));
+
+  const int thread_num = 8;
+  const int times      = 20000;
+  const LSN total      = thread_num * times;
+
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename));
+
+  // 每条日志的数据是线程编号、线程内的序号，以及长度不同的填充
+  vector<thread> threads;
+  for (int t = 0; t < thread_num; t++) {
+    threads.emplace_back([&buffer, t]() {
+      for (int i = 0; i < times; i++) {
+        vector<char> data(sizeof(int) * 2 + i % 200, static_cast<char>(i));
+        memcpy(data.data(), &t, sizeof(t));
+        memcpy(data.data() + sizeof(int), &i, sizeof(i));
+        LSN lsn = 0;
+        ASSERT_EQ(RC::SUCCESS, buffer.append(lsn, LogModule::Id::BUFFER_POOL, data));
+      }
+    });
+  }
+
+  int64_t bytes = 0;
+  while (buffer.flushed_lsn() < total) {
+    int count = 0;
+    ASSERT_EQ(RC::SUCCESS, buffer.flush(writer, count));
+  }
+  for (thread &t : threads) {
+    t.join();
+  }
+  ASSERT_EQ(0, buffer.entry_number());
+  ASSERT_EQ(0, buffer.bytes());
+  ASSERT_EQ(total, buffer.current_lsn());
+  writer.close();
+
+  LogFileReader reader;
+  ASSERT_EQ(RC::SUCCESS, reader.open(filename));
+  LSN         expected_lsn = 1;
+  vector<int> next_seq(thread_num, 0);
+  auto        callback = [&](LogEntry &entry) -> RC {
+    int t = 0, i = 0;
+    memcpy(&t, entry.data(), sizeof(t));
+    memcpy(&i, entry.data() + sizeof(int), sizeof(i));
+    if (entry.lsn() != expected_lsn || t < 0 || t >= thread_num || i != next_seq[t] ||
+        entry.payload_size() != static_cast<int>(sizeof(int) * 2 + i % 200)) {
+      return RC::INTERNAL;
+    }
+    for (int j = sizeof(int) * 2; j < entry.payload_size(); j++) {
+      if (entry.data()[j] != static_cast<char>(i)) {
+        return RC::INTERNAL;
+      }
+    }
+    bytes += entry.total_size();
+    next_seq[t]++;
+    expected_lsn++;
+    return RC::SUCCESS;
+  };
+  ASSERT_EQ(RC::SUCCESS, reader.iterate(callback));
+  ASSERT_EQ(total + 1, expected_lsn);
+  ASSERT_GT(bytes, 2 * buffer.capacity());
+  reader.close();
+
+  filesystem::remove(filename);
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
@@ -59,6 +59,23 @@ TEST(LogEntry, size)
   ASSERT_NE(entry.init(1, LogModule::Id::BPLUS_TREE, std::move(data2)), RC::SUCCESS);
 }
 
+TEST(LogEntry, check_sum)
+{
+  LogEntry     entry;
+  vector<char> data(10, 'a');
+  ASSERT_EQ(RC::SUCCESS, entry.init(1, LogModule::Id::BPLUS_TREE, std::move(data)));
+  ASSERT_EQ(entry.header().check_sum, entry.header().calc_check_sum(entry.data()));
+
+  // 日志头或者数据有任何变化，校验码都不同
+  LogHeader header = entry.header();
+  header.lsn       = 2;
+  ASSERT_NE(header.check_sum, header.calc_check_sum(entry.data()));
+
+  vector<char> data2(entry.data(), entry.data() + entry.payload_size());
+  data2[5] = 'b';
+  ASSERT_NE(entry.header().check_sum, entry.header().calc_check_sum(data2.data()));
+}
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);
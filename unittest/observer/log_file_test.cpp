@@ -27,51 +27,191 @@ See the Mulan PSL v2 for more details. */
 using namespace std;
 using namespace common;
 
+/// 每条测试日志的数据是10个字节
+static const int64_t ENTRY_BYTES = LogHeader::SIZE + 10;
+
+static RC write_entries(LogFileWriter &writer, LSN first_lsn, LSN last_lsn)
+{
+  for (LSN lsn = first_lsn; lsn <= last_lsn; ++lsn) {
+    LogEntry     entry;
+    vector<char> data(10, static_cast<char>(lsn));
+    RC           rc = entry.init(lsn, LogModule::Id::BUFFER_POOL, std::move(data));
+    if (OB_SUCC(rc)) {
+      rc = writer.write(entry);
+    }
+    if (OB_FAIL(rc)) {
+      return rc;
+    }
+  }
+  return RC::SUCCESS;
+}
+
+/// 返回文件中有效日志的条数，并检查日志是连续的
+static int count_entries(const char *filename, LSN first_lsn = 1)
+{
+  LogFileReader reader;
+  if (OB_FAIL(reader.open(filename))) {
+    return -1;
+  }
+
+  LSN  expected_lsn = first_lsn;
+  auto callback     = [&expected_lsn](LogEntry &entry) -> RC {
+    if (entry.lsn() != expected_lsn || entry.payload_size() != 10 || entry.data()[0] != static_cast<char>(entry.lsn())) {
+      return RC::INTERNAL;
+    }
+    expected_lsn++;
+    return RC::SUCCESS;
+  };
+  RC rc = reader.iterate(callback);
+  reader.close();
+  return OB_SUCC(rc) ? static_cast<int>(expected_lsn - first_lsn) : -1;
+}
+
 TEST(LogFileWriter, basic)
 {
   const char *filename = "test_log_file_writer.log";
+  filesystem::remove(filename);
 
   // test LogFileWriter open, close, valid
   LogFileWriter writer;
-  LSN           end_lsn = 1000 - 1;
-  ASSERT_EQ(RC::SUCCESS, writer.open(filename, end_lsn));
+  LSN           end_lsn   = 1000 - 1;
+  int64_t       file_size = end_lsn * ENTRY_BYTES;
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, file_size));
   ASSERT_TRUE(writer.valid());
   ASSERT_FALSE(writer.full());
   ASSERT_EQ(RC::SUCCESS, writer.close());
 
   // test LogFileWriter write
-  ASSERT_EQ(RC::SUCCESS, writer.open(filename, end_lsn));
-
-  LogEntry entry;
-
-  for (LSN lsn = 1; lsn <= end_lsn - 1; ++lsn) {
-    vector<char> data(10);
-    ASSERT_EQ(entry.init(lsn, LogModule::Id::BUFFER_POOL, std::move(data)), RC::SUCCESS);
-    char buf[10];
-    memcpy(buf, entry.data(), 10);
-    ASSERT_EQ(RC::SUCCESS, writer.write(entry));
-    ASSERT_TRUE(writer.valid());
-    ASSERT_FALSE(writer.full());
-  }
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, file_size));
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 1, end_lsn - 1));
+  ASSERT_TRUE(writer.valid());
+  ASSERT_FALSE(writer.full());
+  ASSERT_EQ(ENTRY_BYTES, writer.remain_bytes());
 
   // test LogFileWriter full
-  vector<char> data(10);
-  ASSERT_EQ(entry.init(end_lsn, LogModule::Id::BUFFER_POOL, std::move(data)), RC::SUCCESS);
-  ASSERT_EQ(RC::SUCCESS, writer.write(entry));
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, end_lsn, end_lsn));
   ASSERT_TRUE(writer.valid());
   ASSERT_TRUE(writer.full());
+  ASSERT_EQ(RC::LOG_FILE_FULL, write_entries(writer, end_lsn + 1, end_lsn + 1));
 
   // test LogFileWriter write smaller lsn log
-  data.resize(10);
-  ASSERT_EQ(entry.init(end_lsn - 100, LogModule::Id::BUFFER_POOL, std::move(data)), RC::SUCCESS);
-  ASSERT_NE(RC::SUCCESS, writer.write(entry));
+  ASSERT_EQ(RC::INVALID_ARGUMENT, write_entries(writer, end_lsn - 100, end_lsn - 100));
 
-  data.resize(10);
+  // 重新打开文件时从最后一条日志后面继续写
   writer.close();
-  ASSERT_EQ(RC::SUCCESS, writer.open(filename, end_lsn));
-  ASSERT_EQ(entry.init(end_lsn + 1, LogModule::Id::BUFFER_POOL, std::move(data)), RC::SUCCESS);
-  ASSERT_NE(RC::SUCCESS, writer.write(entry));
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, file_size));
+  ASSERT_EQ(end_lsn, writer.last_lsn());
+  ASSERT_EQ(file_size, writer.offset());
   ASSERT_TRUE(writer.full());
+  ASSERT_EQ(RC::LOG_FILE_FULL, write_entries(writer, end_lsn + 1, end_lsn + 1));
+  writer.close();
+
+  ASSERT_EQ(end_lsn, count_entries(filename));
+  filesystem::remove(filename);
+}
+
+TEST(LogFileWriter, preallocate)
+{
+  const char *filename = "test_log_file_preallocate.log";
+  filesystem::remove(filename);
+
+  const int64_t file_size = 1024 * 1024;
+
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, file_size));
+  ASSERT_EQ(file_size, static_cast<int64_t>(filesystem::file_size(filename)));
+  ASSERT_EQ(0, writer.offset());
+
+  // 预分配的空间中没有有效的日志
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 1, 100));
+  writer.close();
+  ASSERT_EQ(file_size, static_cast<int64_t>(filesystem::file_size(filename)));
+  ASSERT_EQ(100, count_entries(filename));
+
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, file_size));
+  ASSERT_EQ(100, writer.last_lsn());
+  ASSERT_EQ(100 * ENTRY_BYTES, writer.offset());
+  ASSERT_EQ(file_size - 100 * ENTRY_BYTES, writer.remain_bytes());
+  writer.close();
+
+  filesystem::remove(filename);
+}
+
+TEST(LogFileWriter, write_iovs)
+{
+  const char *filename = "test_log_file_write_iovs.log";
+  filesystem::remove(filename);
+
+  // 把多条日志按照文件中的格式拼在一起，分成两段写入
+  LSN          end_lsn = 100;
+  vector<char> data;
+  for (LSN lsn = 1; lsn <= end_lsn; ++lsn) {
+    vector<char> payload(lsn % 20 + 1, 'a');
+    LogHeader    header;
+    header.lsn       = lsn;
+    header.size      = static_cast<int32_t>(payload.size());
+    header.module_id = LogModule(LogModule::Id::BUFFER_POOL).index();
+    header.check_sum = header.calc_check_sum(payload.data());
+    data.insert(data.end(), reinterpret_cast<char *>(&header), reinterpret_cast<char *>(&header) + LogHeader::SIZE);
+    data.insert(data.end(), payload.begin(), payload.end());
+  }
+
+  // 空文件总是可以写入
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, static_cast<int64_t>(data.size()) - 1));
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 1, 1));
+  iovec iovs[2] = {{data.data(), 7}, {data.data() + 7, data.size() - 7}};
+  ASSERT_EQ(RC::LOG_FILE_FULL, writer.write(iovs, 2, 2, end_lsn + 1));
+  writer.close();
+  filesystem::remove(filename);
+
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, static_cast<int64_t>(data.size())));
+  ASSERT_EQ(RC::SUCCESS, writer.write(iovs, 2, 1, end_lsn));
+  ASSERT_EQ(end_lsn, writer.last_lsn());
+  ASSERT_TRUE(writer.full());
+  ASSERT_NE(RC::SUCCESS, writer.write(iovs, 2, 1, end_lsn));
+  ASSERT_EQ(RC::SUCCESS, writer.sync());
+  writer.close();
+
+  LogFileReader reader;
+  ASSERT_EQ(RC::SUCCESS, reader.open(filename));
+  LSN  expected_lsn = 1;
+  auto callback     = [&expected_lsn](LogEntry &entry) -> RC {
+    if (entry.lsn() != expected_lsn || entry.payload_size() != expected_lsn % 20 + 1) {
+      return RC::INTERNAL;
+    }
+    expected_lsn++;
+    return RC::SUCCESS;
+  };
+  ASSERT_EQ(RC::SUCCESS, reader.iterate(callback));
+  ASSERT_EQ(end_lsn + 1, expected_lsn);
+  reader.close();
+
+  filesystem::remove(filename);
+}
+
+TEST(LogFileWriter, direct_io)
+{
+  const char *filename = "test_log_file_direct_io.log";
+  filesystem::remove(filename);
+
+  const int64_t file_size = 1024 * 1024;
+
+  // 日志的大小不是块大小的整数倍，每次写入都要带上最后一个没有写满的块
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, file_size, true /*direct_io*/));
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 1, 150));
+  writer.close();
+  ASSERT_EQ(150, count_entries(filename));
+
+  // 重新打开时读取最后一个块，继续写
+  ASSERT_EQ(RC::SUCCESS, writer.open(filename, file_size, true /*direct_io*/));
+  ASSERT_EQ(150, writer.last_lsn());
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 151, 500));
+  ASSERT_EQ(RC::SUCCESS, writer.sync());
+  writer.close();
+  ASSERT_EQ(500, count_entries(filename));
+  ASSERT_EQ(file_size, static_cast<int64_t>(filesystem::file_size(filename)));
 
   filesystem::remove(filename);
 }
@@ -84,7 +224,7 @@ TEST(LogFileReader, basic)
 
   LogFileWriter writer;
   LSN           end_lsn = 1000 - 1;
-  ASSERT_EQ(RC::SUCCESS, writer.open(log_file, end_lsn));
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file));
   ASSERT_TRUE(writer.valid());
 
   LogEntry entry;
@@ -132,7 +272,7 @@ TEST(LogFileReadWrite, test_read_write)
 
   LogFileWriter writer;
   LSN           end_lsn = 1000 - 1;
-  ASSERT_EQ(RC::SUCCESS, writer.open(log_file, end_lsn));
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file));
   ASSERT_TRUE(writer.valid());
 
   LogEntry entry;
@@ -162,7 +302,7 @@ TEST(LogFileReadWrite, test_read_write)
   writer.close();
   reader.close();
 
-  ASSERT_EQ(RC::SUCCESS, writer.open(log_file, end_lsn));
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file));
 
   for (LSN i = one_lsn + 1; i <= end_lsn; i++) {
     vector<char> data(10);
@@ -178,6 +318,48 @@ TEST(LogFileReadWrite, test_read_write)
   // filesystem::remove(log_file);
 }
 
+TEST(LogFileReader, invalid_tail)
+{
+  const char *log_file = "test_log_file_invalid_tail.log";
+  filesystem::remove(log_file);
+
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file));
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 1, 100));
+  writer.close();
+
+  // 文件尾部是写了一半的日志
+  filesystem::resize_file(log_file, 100 * ENTRY_BYTES + LogHeader::SIZE + 5);
+  ASSERT_EQ(100, count_entries(log_file));
+
+  // 重新打开文件会覆盖写了一半的日志
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file));
+  ASSERT_EQ(100, writer.last_lsn());
+  ASSERT_EQ(100 * ENTRY_BYTES, writer.offset());
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 101, 110));
+  writer.close();
+  ASSERT_EQ(110, count_entries(log_file));
+
+  // 最后一条日志的数据损坏了，校验码不对
+  {
+    fstream fs(log_file, ios::in | ios::out | ios::binary);
+    fs.seekp(110 * ENTRY_BYTES - 1);
+    fs.put('x');
+  }
+  ASSERT_EQ(109, count_entries(log_file));
+
+  // 重用的文件中，新的日志后面是LSN接不上的旧日志
+  ASSERT_EQ(RC::SUCCESS, writer.open(log_file));
+  ASSERT_EQ(109, writer.last_lsn());
+  writer.offset_   = 0;
+  writer.last_lsn_ = 0;
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 1001, 1010));
+  writer.close();
+  ASSERT_EQ(10, count_entries(log_file, 1001));
+
+  filesystem::remove(log_file);
+}
+
 TEST(LogFileManager, get_lsn_from_filename)
 {
   const char *file_prefix = LogFileManager::file_prefix_;
@@ -203,10 +385,10 @@ TEST(LogFileManager, get_lsn_from_filename)
 TEST(LogFileManager, init_not_exists)
 {
   const char *directory                 = "not_exists/not_exists2";
-  int         max_entry_number_per_file = 1000;
+  int64_t     file_size = 64 * 1024;
 
   LogFileManager manager;
-  ASSERT_EQ(RC::SUCCESS, manager.init(directory, max_entry_number_per_file));
+  ASSERT_EQ(RC::SUCCESS, manager.init(directory, file_size));
   ASSERT_TRUE(filesystem::is_directory(directory));
 
   vector<string> files;
@@ -219,12 +401,12 @@ TEST(LogFileManager, init_not_exists)
 TEST(LogFileManager, init_empty_directory)
 {
   const char *directory                 = "empty_directory";
-  int         max_entry_number_per_file = 1000;
+  int64_t     file_size = 64 * 1024;
 
   ASSERT_TRUE(filesystem::create_directory(directory));
 
   LogFileManager manager;
-  ASSERT_EQ(RC::SUCCESS, manager.init(directory, max_entry_number_per_file));
+  ASSERT_EQ(RC::SUCCESS, manager.init(directory, file_size));
   ASSERT_TRUE(filesystem::is_directory(directory));
 
   vector<string> files;
@@ -237,7 +419,7 @@ TEST(LogFileManager, init_empty_directory)
 TEST(LogFileManager, init_with_files)
 {
   const char *directory                 = "init_with_files";
-  int         max_entry_number_per_file = 1000;
+  int64_t     file_size = 64 * 1024;
 
   filesystem::remove_all(directory);
 
@@ -255,7 +437,7 @@ TEST(LogFileManager, init_with_files)
   }
 
   LogFileManager manager;
-  ASSERT_EQ(RC::SUCCESS, manager.init(directory, max_entry_number_per_file));
+  ASSERT_EQ(RC::SUCCESS, manager.init(directory, file_size));
   ASSERT_TRUE(filesystem::is_directory(directory));
 
   vector<string> result_files;
@@ -286,105 +468,225 @@ TEST(LogFileManager, init_with_files)
   ASSERT_EQ(RC::SUCCESS, manager.list_files(result_files, 3010));
   ASSERT_EQ(1, result_files.size());
 
+  // 最后一个文件的大小不限制日志的条数，可能包含任意大的LSN
   ASSERT_EQ(RC::SUCCESS, manager.list_files(result_files, 4000));
-  ASSERT_EQ(0, result_files.size());
+  ASSERT_EQ(1, result_files.size());
 
   ASSERT_EQ(RC::SUCCESS, manager.list_files(result_files, 5000));
-  ASSERT_EQ(0, result_files.size());
+  ASSERT_EQ(1, result_files.size());
 
   ASSERT_TRUE(filesystem::remove_all(directory));
 }
 
+static void create_empty_log_files(const char *directory, const vector<LSN> &lsns, vector<string> *files = nullptr)
+{
+  for (LSN lsn : lsns) {
+    string filename = string(LogFileManager::file_prefix_) + to_string(lsn) + LogFileManager::file_suffix_;
+    if (files != nullptr) {
+      files->push_back(filename);
+    }
+    ofstream ofs(string(directory) + "/" + filename);
+    ofs.close();
+  }
+}
+
+static LSN lsn_of_writer(const LogFileWriter &writer)
+{
+  LSN lsn = -1;
+  LogFileManager::get_lsn_from_filename(filesystem::path(writer.filename()).filename(), lsn);
+  return lsn;
+}
+
 TEST(LogFileManager, last_file)
 {
   // create an empty directory and try to open last file
-  const char *directory                 = "last_file";
-  int         max_entry_number_per_file = 1000;
+  const char *directory = "last_file";
+  int64_t     file_size = 64 * 1024;
 
   filesystem::remove_all(directory);
 
   LogFileManager manager;
-  ASSERT_EQ(RC::SUCCESS, manager.init(directory, max_entry_number_per_file));
+  ASSERT_EQ(RC::SUCCESS, manager.init(directory, file_size));
   ASSERT_TRUE(filesystem::is_directory(directory));
 
+  // 没有日志文件时，使用下一条日志的LSN创建文件
   LogFileWriter writer;
-  ASSERT_EQ(RC::SUCCESS, manager.last_file(writer));
+  ASSERT_EQ(RC::SUCCESS, manager.last_file(writer, 1));
   ASSERT_TRUE(writer.valid());
-
-  // test the lsn of the filename of the writer
-  LSN              lsn = 0;
-  filesystem::path file_path(writer.filename());
-  ASSERT_EQ(RC::SUCCESS, LogFileManager::get_lsn_from_filename(file_path.filename(), lsn));
-  ASSERT_EQ(0, lsn);
+  ASSERT_EQ(1, lsn_of_writer(writer));
+  ASSERT_EQ(file_size, static_cast<int64_t>(filesystem::file_size(writer.filename())));
+  writer.close();
 
   ASSERT_TRUE(filesystem::remove_all(directory));
 
   // create a directory with some files and try to open last file
   ASSERT_TRUE(filesystem::create_directory(directory));
-  LSN            lsns[] = {1000, 2000, 3000};
   vector<string> files;
-  for (LSN lsn : lsns) {
-    stringstream filename_ss;
-    string       filename = string(LogFileManager::file_prefix_) + to_string(lsn) + LogFileManager::file_suffix_;
-    files.push_back(filename);
-    filename_ss << directory << "/" << filename;
-    ofstream ofs(filename_ss.str());
-    ofs.close();
-  }
+  create_empty_log_files(directory, {1000, 2000, 3000}, &files);
 
-  ASSERT_EQ(RC::SUCCESS, manager.init(directory, max_entry_number_per_file));
-  ASSERT_TRUE(filesystem::is_directory(directory));
+  LogFileManager manager2;
+  ASSERT_EQ(RC::SUCCESS, manager2.init(directory, file_size));
 
-  ASSERT_EQ(RC::SUCCESS, manager.last_file(writer));
+  ASSERT_EQ(RC::SUCCESS, manager2.last_file(writer, 3000));
   ASSERT_TRUE(writer.valid());
   ASSERT_EQ(files[2], filesystem::path(writer.filename()).filename());
 
+  // 最后一个文件后面可以接着写日志
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 3000, 3010));
+  ASSERT_EQ(RC::SUCCESS, manager2.last_file(writer, 3011));
+  ASSERT_EQ(3000, lsn_of_writer(writer));
+  ASSERT_EQ(3010, writer.last_lsn());
+
+  // 最后一个文件中的日志和下一条日志接不上，就创建新的文件
+  ASSERT_EQ(RC::SUCCESS, manager2.last_file(writer, 3500));
+  ASSERT_EQ(3500, lsn_of_writer(writer));
+  ASSERT_EQ(0, writer.last_lsn());
+
+  writer.close();
   filesystem::remove_all(directory);
 }
 
 TEST(LogFileManager, next_file)
 {
   // create an empty directory and try to open next file
-  const char *directory                 = "next_file";
-  int         max_entry_number_per_file = 1000;
+  const char *directory = "next_file";
+  int64_t     file_size = 64 * 1024;
 
   filesystem::remove_all(directory);
 
   LogFileManager manager;
-  ASSERT_EQ(RC::SUCCESS, manager.init(directory, max_entry_number_per_file));
+  ASSERT_EQ(RC::SUCCESS, manager.init(directory, file_size));
   ASSERT_TRUE(filesystem::is_directory(directory));
 
   LogFileWriter writer;
-  ASSERT_EQ(RC::SUCCESS, manager.next_file(writer));
+  ASSERT_EQ(RC::SUCCESS, manager.next_file(writer, 1));
   ASSERT_TRUE(writer.valid());
-
-  // test the lsn of the filename of the writer
-  LSN lsn = 0;
-  ASSERT_EQ(RC::SUCCESS, LogFileManager::get_lsn_from_filename(filesystem::path(writer.filename()).filename(), lsn));
-  ASSERT_EQ(0, lsn);
+  ASSERT_EQ(1, lsn_of_writer(writer));
+  writer.close();
 
   ASSERT_TRUE(filesystem::remove_all(directory));
 
   // create a directory with some files and try to open next file
   ASSERT_TRUE(filesystem::create_directory(directory));
-  LSN            lsns[] = {1000, 2000, 3000};
+  create_empty_log_files(directory, {1000, 2000, 3000});
+
+  LogFileManager manager2;
+  ASSERT_EQ(RC::SUCCESS, manager2.init(directory, file_size));
+
+  // 新文件的第一条日志必须在最后一个文件之后
+  ASSERT_EQ(RC::INVALID_ARGUMENT, manager2.next_file(writer, 3000));
+  ASSERT_EQ(RC::SUCCESS, manager2.next_file(writer, 3500));
+  ASSERT_TRUE(writer.valid());
+  ASSERT_EQ(3500, lsn_of_writer(writer));
+
   vector<string> files;
-  for (LSN lsn : lsns) {
-    stringstream filename_ss;
-    string       filename = string(LogFileManager::file_prefix_) + to_string(lsn) + LogFileManager::file_suffix_;
-    files.push_back(filename);
-    filename_ss << directory << "/" << filename;
-    ofstream ofs(filename_ss.str());
-    ofs.close();
+  ASSERT_EQ(RC::SUCCESS, manager2.list_files(files, 0));
+  ASSERT_EQ(4, static_cast<int>(files.size()));
+
+  writer.close();
+  filesystem::remove_all(directory);
+}
+
+TEST(LogFileManager, remove_files_before)
+{
+  const char *directory = "remove_files_before";
+  int64_t     file_size = 64 * 1024;
+
+  filesystem::remove_all(directory);
+  ASSERT_TRUE(filesystem::create_directory(directory));
+  create_empty_log_files(directory, {1, 1000, 2000, 3000});
+
+  LogFileManager manager;
+  ASSERT_EQ(RC::SUCCESS, manager.init(directory, file_size, 1 /*max_free_files*/));
+
+  // 文件 clog_1000 中还有不小于 1500 的日志
+  int removed_num = 0;
+  ASSERT_EQ(RC::SUCCESS, manager.remove_files_before(1500, removed_num));
+  ASSERT_EQ(1, removed_num);
+  ASSERT_EQ(1, static_cast<int>(manager.free_files_.size()));
+
+  vector<string> files;
+  ASSERT_EQ(RC::SUCCESS, manager.list_files(files, 0));
+  ASSERT_EQ(3, static_cast<int>(files.size()));
+  LSN lsn = 0;
+  ASSERT_EQ(RC::SUCCESS, LogFileManager::get_lsn_from_filename(filesystem::path(files[0]).filename(), lsn));
+  ASSERT_EQ(1000, lsn);
+
+  // 最后一个文件总是保留。空闲文件已经够了，其它的文件直接删除
+  ASSERT_EQ(RC::SUCCESS, manager.remove_files_before(10000, removed_num));
+  ASSERT_EQ(2, removed_num);
+  ASSERT_EQ(RC::SUCCESS, manager.list_files(files, 0));
+  ASSERT_EQ(1, static_cast<int>(files.size()));
+  ASSERT_FALSE(filesystem::exists(string(directory) + "/" + LogFileManager::file_prefix_ + "2000" + LogFileManager::file_suffix_));
+  ASSERT_EQ(1, static_cast<int>(manager.free_files_.size()));
+
+  // 重新初始化时可以找到空闲文件
+  LogFileManager manager2;
+  ASSERT_EQ(RC::SUCCESS, manager2.init(directory, file_size, 1 /*max_free_files*/));
+  ASSERT_EQ(1, static_cast<int>(manager2.free_files_.size()));
+  ASSERT_EQ(RC::SUCCESS, manager2.list_files(files, 0));
+  ASSERT_EQ(1, static_cast<int>(files.size()));
+
+  // 下一个文件重用空闲文件
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, manager2.next_file(writer, 4000));
+  ASSERT_EQ(4000, lsn_of_writer(writer));
+  ASSERT_EQ(0, static_cast<int>(manager2.free_files_.size()));
+
+  int file_num = 0;
+  for (const auto &entry : filesystem::directory_iterator(directory)) {
+    (void)entry;
+    file_num++;
   }
+  ASSERT_EQ(2, file_num);
 
-  ASSERT_EQ(RC::SUCCESS, manager.init(directory, max_entry_number_per_file));
-  ASSERT_TRUE(filesystem::is_directory(directory));
+  writer.close();
+  filesystem::remove_all(directory);
+}
 
-  ASSERT_EQ(RC::SUCCESS, manager.next_file(writer));
-  ASSERT_TRUE(writer.valid());
-  ASSERT_EQ(RC::SUCCESS, LogFileManager::get_lsn_from_filename(filesystem::path(writer.filename()).filename(), lsn));
-  ASSERT_EQ(4000, lsn);
+TEST(LogFileManager, reuse_file)
+{
+  const char *directory = "reuse_file";
+  const LSN   entry_num = 100;
+  int64_t     file_size = entry_num * ENTRY_BYTES;
+
+  filesystem::remove_all(directory);
+
+  LogFileManager manager;
+  ASSERT_EQ(RC::SUCCESS, manager.init(directory, file_size, 2 /*max_free_files*/));
+
+  // 写满两个文件
+  LogFileWriter writer;
+  ASSERT_EQ(RC::SUCCESS, manager.last_file(writer, 1));
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, 1, entry_num));
+  ASSERT_TRUE(writer.full());
+  ASSERT_EQ(RC::SUCCESS, manager.next_file(writer, entry_num + 1));
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, entry_num + 1, entry_num * 2));
+  ASSERT_EQ(RC::SUCCESS, manager.next_file(writer, entry_num * 2 + 1));
+
+  // 第一个文件被回收后重用，里面旧的日志不会被读到
+  int removed_num = 0;
+  ASSERT_EQ(RC::SUCCESS, manager.remove_files_before(entry_num + 1, removed_num));
+  ASSERT_EQ(1, removed_num);
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, entry_num * 2 + 1, entry_num * 3));
+  ASSERT_EQ(RC::SUCCESS, manager.next_file(writer, entry_num * 3 + 1));
+  ASSERT_EQ(0, writer.offset());
+  ASSERT_EQ(0, writer.last_lsn());
+  ASSERT_LE(file_size, static_cast<int64_t>(filesystem::file_size(writer.filename())));
+  ASSERT_EQ(0, count_entries(writer.filename(), entry_num * 3 + 1));
+
+  ASSERT_EQ(RC::SUCCESS, write_entries(writer, entry_num * 3 + 1, entry_num * 3 + 10));
+  writer.close();
+  ASSERT_EQ(10, count_entries(writer.filename(), entry_num * 3 + 1));
+
+  // 重新打开时从新写入的日志后面继续写
+  ASSERT_EQ(RC::SUCCESS, manager.last_file(writer, entry_num * 3 + 11));
+  ASSERT_EQ(entry_num * 3 + 10, writer.last_lsn());
+  ASSERT_EQ(10 * ENTRY_BYTES, writer.offset());
+
+  vector<string> files;
+  ASSERT_EQ(RC::SUCCESS, manager.list_files(files, 0));
+  ASSERT_EQ(3, static_cast<int>(files.size()));
 
   writer.close();
   filesystem::remove_all(directory);
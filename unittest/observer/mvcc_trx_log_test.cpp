@@ -26,6 +26,7 @@ See the Mulan PSL v2 for more details. */
 #include "storage/table/table.h"
 #include "storage/record/record.h"
 #include "storage/trx/mvcc_trx.h"
+#include "common/conf/ini.h"
 #include "common/thread/thread_pool_executor.h"
 #include "storage/record/heap_record_scanner.h"
 
@@ -53,6 +54,9 @@ TEST(MvccTrxLog, wal)
   filesystem::create_directories(db_path);
   filesystem::create_directories(db_path2);
 
+  // 使用比较小的日志文件，让日志超过一个文件
+  get_properties()->put("FILE_SIZE_MB", "1", "CLOG");
+
   auto db = make_unique<Db>();
   ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
 
@@ -153,6 +157,7 @@ TEST(MvccTrxLog, wal)
 
   db2.reset();
   db.reset();
+  get_properties()->put("FILE_SIZE_MB", "64", "CLOG");
 }
 
 TEST(MvccTrxLog, wal2)
@@ -176,6 +181,9 @@ TEST(MvccTrxLog, wal2)
   filesystem::create_directories(db_path);
   filesystem::create_directories(db_path2);
 
+  // 使用比较小的日志文件，让日志超过一个文件
+  get_properties()->put("FILE_SIZE_MB", "1", "CLOG");
+
   auto db = make_unique<Db>();
   ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
 
@@ -342,6 +350,7 @@ TEST(MvccTrxLog, wal2)
 
   db2.reset();
   db.reset();
+  get_properties()->put("FILE_SIZE_MB", "64", "CLOG");
 }
 
 TEST(MvccTrxLog, wal_rollback)
@@ -365,6 +374,9 @@ TEST(MvccTrxLog, wal_rollback)
   filesystem::create_directories(db_path);
   filesystem::create_directories(db_path2);
 
+  // 使用比较小的日志文件，让日志超过一个文件
+  get_properties()->put("FILE_SIZE_MB", "1", "CLOG");
+
   auto db = make_unique<Db>();
   ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
 
@@ -468,6 +480,7 @@ TEST(MvccTrxLog, wal_rollback)
 
   db2.reset();
   db.reset();
+  get_properties()->put("FILE_SIZE_MB", "64", "CLOG");
 }
 
 TEST(MvccTrxLog, wal_rollback_half)
@@ -491,6 +504,9 @@ TEST(MvccTrxLog, wal_rollback_half)
   filesystem::create_directories(db_path);
   filesystem::create_directories(db_path2);
 
+  // 使用比较小的日志文件，让日志超过一个文件
+  get_properties()->put("FILE_SIZE_MB", "1", "CLOG");
+
   auto db = make_unique<Db>();
   ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
 
@@ -599,6 +615,7 @@ TEST(MvccTrxLog, wal_rollback_half)
 
   db2.reset();
   db.reset();
+  get_properties()->put("FILE_SIZE_MB", "64", "CLOG");
 }
 
 TEST(MvccTrxLog, wal_rollback_abnormal)
@@ -622,6 +639,9 @@ TEST(MvccTrxLog, wal_rollback_abnormal)
   filesystem::create_directories(db_path);
   filesystem::create_directories(db_path2);
 
+  // 使用比较小的日志文件，让日志超过一个文件
+  get_properties()->put("FILE_SIZE_MB", "1", "CLOG");
+
   auto db = make_unique<Db>();
   ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
 
@@ -727,6 +747,148 @@ TEST(MvccTrxLog, wal_rollback_abnormal)
 
   db2.reset();
   db.reset();
+  get_properties()->put("FILE_SIZE_MB", "64", "CLOG");
+}
+
+TEST(MvccTrxLog, fuzzy_checkpoint)
+{
+  /*
+  插入一批数据并提交，把表的页面刷到磁盘，再开启一个不提交的事务，然后做检查点。
+  检查点不会越过未提交事务的第一条日志，检查点之前的日志文件会被回收。
+  继续插入一批数据，使用复制的文件恢复数据库，检查数据是否一致。
+  */
+  filesystem::path test_directory("mvcc_trx_log_test");
+  filesystem::remove_all(test_directory);
+  filesystem::create_directory(test_directory);
+
+  const char      *dbname           = "test_db";
+  const char      *dbname2          = "test_db2";
+  filesystem::path db_path          = test_directory / dbname;
+  filesystem::path db_path2         = test_directory / dbname2;
+  const char      *trx_kit_name     = "mvcc";
+  const char      *log_handler_name = "disk";
+
+  filesystem::create_directories(db_path);
+  filesystem::create_directories(db_path2);
+
+  // 使用比较小的日志文件，让日志超过一个文件
+  get_properties()->put("FILE_SIZE_MB", "1", "CLOG");
+
+  auto db = make_unique<Db>();
+  ASSERT_EQ(RC::SUCCESS, db->init(dbname, db_path.c_str(), trx_kit_name, log_handler_name));
+
+  const int      table_num = 3;
+  vector<string> table_names;
+  for (int i = 0; i < table_num; i++) {
+    table_names.push_back("table_" + to_string(i));
+  }
+
+  const int               field_num = 4;
+  vector<AttrInfoSqlNode> attr_infos;
+  for (int i = 0; i < field_num; i++) {
+    AttrInfoSqlNode attr_info;
+    attr_info.name   = string("field_") + to_string(i);
+    attr_info.type   = AttrType::INTS;
+    attr_info.length = 4;
+    attr_infos.push_back(attr_info);
+  }
+
+  for (const string &table_name : table_names) {
+    ASSERT_EQ(RC::SUCCESS, db->create_table(table_name.c_str(), attr_infos, {}));
+    ASSERT_EQ(RC::SUCCESS, db->sync());
+  }
+
+  TrxKit &trx_kit     = db->trx_kit();
+  auto    insert_rows = [&](Trx *trx, int value) {
+    for (const string &table_name : table_names) {
+      Table *table = db->find_table(table_name.c_str());
+      ASSERT_NE(table, nullptr);
+
+      vector<Value> values(field_num);
+      for (Value &v : values) {
+        v.set_int(value);
+      }
+
+      Record record;
+      ASSERT_EQ(RC::SUCCESS, table->make_record(values.size(), values.data(), record));
+      ASSERT_EQ(RC::SUCCESS, trx->insert_record(table, record));
+    }
+  };
+  const int rows_per_trx     = 10;
+  auto      insert_committed = [&](int num) {
+    for (int i = 0; i < num; i++) {
+      Trx *trx = trx_kit.create_trx(db->log_handler());
+      ASSERT_NE(trx, nullptr);
+      trx->start_if_need();
+      for (int j = 0; j < rows_per_trx; j++) {
+        insert_rows(trx, i);
+      }
+      ASSERT_EQ(RC::SUCCESS, trx->commit());
+      trx_kit.destroy_trx(trx);
+    }
+  };
+
+  // 日志超过一个文件
+  const int insert_num1 = 300;
+  insert_committed(insert_num1);
+
+  for (const string &table_name : table_names) {
+    ASSERT_EQ(RC::SUCCESS, db->find_table(table_name.c_str())->sync());
+  }
+
+  Trx *open_trx = trx_kit.create_trx(db->log_handler());
+  ASSERT_NE(open_trx, nullptr);
+  open_trx->start_if_need();
+  insert_rows(open_trx, -1);
+
+  // 第一次检查点只是记录当前的LSN，第二次才会推进到未提交事务开始的位置
+  const LSN old_check_point_lsn = db->check_point_lsn();
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_EQ(RC::SUCCESS, db->checkpoint());
+  ASSERT_GT(db->check_point_lsn(), old_check_point_lsn);
+  ASSERT_LE(db->check_point_lsn(), static_cast<MvccTrx *>(open_trx)->begin_lsn());
+  ASSERT_FALSE(filesystem::exists(db_path / "clog" / "clog_1.log"));
+
+  const int insert_num2 = 100;
+  insert_committed(insert_num2);
+
+  DiskLogHandler &log_handler = static_cast<DiskLogHandler &>(db->log_handler());
+  ASSERT_EQ(RC::SUCCESS, log_handler.wait_lsn(log_handler.current_lsn()));
+
+  filesystem::copy(db_path, db_path2, filesystem::copy_options::recursive);
+
+  auto db2 = make_unique<Db>();
+  ASSERT_EQ(RC::SUCCESS, db2->init(dbname2, db_path2.c_str(), trx_kit_name, log_handler_name));
+
+  // 未提交的事务在恢复时回滚
+  Trx *trx = db2->trx_kit().create_trx(db2->log_handler());
+  trx->start_if_need();
+  for (const string &table_name : table_names) {
+    Table *table2 = db2->find_table(table_name.c_str());
+    ASSERT_NE(table2, nullptr);
+
+    RecordScanner *scanner2;
+    ASSERT_EQ(RC::SUCCESS, table2->get_record_scanner(scanner2, nullptr, ReadWriteMode::READ_ONLY));
+    int    visible_count = 0;
+    Record record;
+    RC     rc = RC::SUCCESS;
+    while (OB_SUCC(rc = scanner2->next(record))) {
+      if (OB_SUCC(trx->visit_record(table2, record, ReadWriteMode::READ_ONLY))) {
+        visible_count++;
+      }
+    }
+    delete scanner2;
+
+    ASSERT_EQ((insert_num1 + insert_num2) * rows_per_trx, visible_count);
+  }
+  db2->trx_kit().destroy_trx(trx);
+
+  ASSERT_EQ(RC::SUCCESS, open_trx->rollback());
+  trx_kit.destroy_trx(open_trx);
+
+  db2.reset();
+  db.reset();
+  get_properties()->put("FILE_SIZE_MB", "64", "CLOG");
 }
 
 int main(int argc, char **argv)
@@ -212,14 +212,14 @@ TEST(RecordScanner, test_record_file_iterator)
   delete bpm;
 }
 
-TEST(RecordManager, durability)
+/*
+ * 测试场景：
+ * 1. 创建一个文件，插入一些记录
+ * 2. 随机进行插入、更新、删除操作
+ * 3. 重启数据库，检查记录是否恢复。replay_worker_num 是并行回放日志的线程数
+ */
+void test_durability(int replay_worker_num)
 {
-  /*
-   * 测试场景：
-   * 1. 创建一个文件，插入一些记录
-   * 2. 随机进行插入、更新、删除操作
-   * 3. 重启数据库，检查记录是否恢复
-   */
   filesystem::path directory("record_manager_durability");
   filesystem::remove_all(directory);
   ASSERT_TRUE(filesystem::create_directories(directory));
@@ -345,10 +345,11 @@ TEST(RecordManager, durability)
   ASSERT_EQ(bpm2.open_file(log_handler2, record_manager_file.c_str(), buffer_pool2), RC::SUCCESS);
   ASSERT_NE(buffer_pool2, nullptr);
 
-  IntegratedLogReplayer log_replayer2(bpm2);
+  IntegratedLogReplayer log_replayer2(bpm2, make_unique<VacuousTrxLogReplayer>(), replay_worker_num);
   ASSERT_EQ(log_handler2.init(directory.c_str()), RC::SUCCESS);
   ASSERT_EQ(log_handler2.replay(log_replayer2, 0), RC::SUCCESS);
   ASSERT_EQ(log_handler2.start(), RC::SUCCESS);
+  ASSERT_EQ(log_replayer2.on_done(), RC::SUCCESS);
 
   RecordFileHandler record_file_handler2(StorageFormat::ROW_FORMAT);
   ASSERT_EQ(record_file_handler2.init(*buffer_pool2, log_handler2, nullptr, nullptr), RC::SUCCESS);
@@ -363,6 +364,10 @@ TEST(RecordManager, durability)
   bpm2.close_file(record_manager_file.c_str());
 }
 
+TEST(RecordManager, durability) { test_durability(0); }
+
+TEST(RecordManager, parallel_replay) { test_durability(4); }
+
 int main(int argc, char **argv)
 {
   testing::InitGoogleTest(&argc, argv);